@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batchFit.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../src_prims/utils.h"
+
+namespace ML {
+
+void batchFit(const cumlHandle &handle, int n_models,
+              const std::function<void(const cumlHandle &, int)> &fit,
+              int max_concurrent, std::size_t memory_budget,
+              const std::function<std::size_t(int)> &model_bytes) {
+  ASSERT(max_concurrent > 0, "batchFit: max_concurrent must be > 0");
+  if (n_models <= 0) return;
+  ASSERT(memory_budget == 0 || model_bytes,
+         "batchFit: a memory budget needs the memory estimates of the fits");
+
+  // the fits read the data from other streams
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+
+  int n_workers = std::min(max_concurrent, n_models);
+  cumlHandlePool pool(n_workers, handle.getNumInternalStreams(),
+                      handle.getDeviceAllocator(), handle.getHostAllocator());
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t in_flight = 0;
+  int next = 0;
+  std::exception_ptr error;
+
+  auto worker = [&]() {
+    while (true) {
+      int i;
+      std::size_t bytes = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (error || next >= n_models) return;
+        i = next++;
+        if (memory_budget > 0) bytes = model_bytes(i);
+        cv.wait(lock, [&] {
+          return error || memory_budget == 0 || in_flight == 0 ||
+                 in_flight + bytes <= memory_budget;
+        });
+        // a fit failed while this one waited for memory: skip it before
+        // reserving anything
+        if (error) return;
+        in_flight += bytes;
+      }
+      try {
+        auto lease = pool.checkout();
+        fit(lease.handle(), i);
+        CUDA_CHECK(cudaStreamSynchronize(lease.stream()));
+      } catch (...) {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!error) error = std::current_exception();
+      }
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        in_flight -= bytes;
+      }
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int w = 1; w < n_workers; ++w) workers.emplace_back(worker);
+  worker();
+  for (auto &t : workers) t.join();
+  if (error) std::rethrow_exception(error);
+}
+
+}  // end namespace ML
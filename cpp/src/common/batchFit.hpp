@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "../cuML.hpp"
+
+namespace ML {
+
+/**
+ * @brief Run a batch of independent model fits concurrently.
+ *
+ * Each fit is called from one of up to `max_concurrent` host threads with
+ * a handle leased from a cumlHandlePool which shares the allocators of
+ * `handle`, so that the fits overlap on separate streams. A fit is only
+ * started once the estimated device memory of the fits in flight plus its
+ * own estimate fits within `memory_budget` (a fit larger than the whole
+ * budget runs alone). The work enqueued on `handle`'s stream before the call
+ * is complete before any fit starts, and all the fits are complete on
+ * return.
+ * The first exception thrown by a fit is rethrown once the fits already
+ * started are done; the remaining ones are skipped.
+ *
+ * @param handle          handle whose allocators are used by the fits
+ * @param n_models        number of fits
+ * @param fit             fit(h, i) enqueues fit i on the handle h
+ * @param max_concurrent  maximum number of fits in flight
+ * @param memory_budget   device memory available to the fits in flight, in
+ *                        bytes (0 for no limit)
+ * @param model_bytes     model_bytes(i) estimates the device memory needed
+ *                        by fit i, in bytes (may be empty if there is no
+ *                        budget)
+ */
+void batchFit(const cumlHandle &handle, int n_models,
+              const std::function<void(const cumlHandle &, int)> &fit,
+              int max_concurrent = 4, std::size_t memory_budget = 0,
+              const std::function<std::size_t(int)> &model_bytes = nullptr);
+
+}  // end namespace ML
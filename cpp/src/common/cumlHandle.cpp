@@ -16,6 +16,8 @@
 
 #include "cumlHandle.hpp"
 
+#include <list>
+
 #include "../../src_prims/utils.h"
 
 //TODO: Delete CUBLAS_CHECK and CUSOLVER_CHECK once
@@ -137,8 +139,16 @@
 namespace ML {
 
 cumlHandle::cumlHandle() : _impl(new cumlHandle_impl()) {}
+cumlHandle::cumlHandle(int n_streams)
+  : _impl(new cumlHandle_impl(n_streams)) {}
 cumlHandle::~cumlHandle() {}
 
+int cumlHandle::getDefaultNumInternalStreams() { return 3; }
+
+int cumlHandle::getNumInternalStreams() const {
+  return _impl->getNumInternalStreams();
+}
+
 void cumlHandle::setStream(cudaStream_t stream) { _impl->setStream(stream); }
 
 cudaStream_t cumlHandle::getStream() const { return _impl->getStream(); }
@@ -160,6 +170,14 @@ std::shared_ptr<hostAllocator> cumlHandle::getHostAllocator() const {
   return _impl->getHostAllocator();
 }
 
+void cumlHandle::setGraphCapture(bool enable) {
+  _impl->setGraphCapture(enable);
+}
+
+bool cumlHandle::getGraphCapture() const { return _impl->getGraphCapture(); }
+
+void cumlHandle::clearGraphs() { _impl->clearGraphs(); }
+
 const cumlHandle_impl& cumlHandle::getImpl() const { return *_impl.get(); }
 
 cumlHandle_impl& cumlHandle::getImpl()
@@ -170,19 +188,147 @@ cumlHandle_impl& cumlHandle::getImpl()
 using MLCommon::defaultDeviceAllocator;
 using MLCommon::defaultHostAllocator;
 
-cumlHandle_impl::cumlHandle_impl()
-  : _dev_id([]() -> int {
+namespace detail {
+
+/**
+ * Device allocator in use while a graph is recorded. The buffers come from
+ * the upstream allocator, but are only given back once the graph is
+ * destroyed, as every replay of the graph works in them again.
+ */
+class graphAllocator : public deviceAllocator {
+ public:
+  graphAllocator(std::shared_ptr<deviceAllocator> upstream)
+    : _upstream(upstream) {}
+
+  void* allocate(std::size_t n, cudaStream_t stream) override {
+    void* p = _upstream->allocate(n, stream);
+    _allocations.emplace_back(p, n);
+    return p;
+  }
+
+  void deallocate(void* p, std::size_t n, cudaStream_t stream) override {}
+
+  void release(cudaStream_t stream) {
+    for (auto& a : _allocations) {
+      _upstream->deallocate(a.first, a.second, stream);
+    }
+    _allocations.clear();
+  }
+
+ private:
+  std::shared_ptr<deviceAllocator> _upstream;
+  std::vector<std::pair<void*, std::size_t>> _allocations;
+};
+
+/**
+ * graphs recorded by cumlHandle_impl::launchGraph, by key. At most
+ * MAX_ENTRIES are kept, the least recently launched ones are destroyed first.
+ */
+class graphCache {
+ public:
+  static const size_t MAX_ENTRIES = 64;
+
+  struct entry {
+    /** nullptr if the work could not be captured and is run eagerly */
+    cudaGraphExec_t exec;
+    std::shared_ptr<graphAllocator> allocator;
+    /** recorded after every launch, on the stream of that launch */
+    cudaEvent_t done;
+
+    void launch(cudaStream_t stream) {
+      CUDA_CHECK(cudaGraphLaunch(exec, stream));
+      CUDA_CHECK(cudaEventRecord(done, stream));
+    }
+  };
+
+  ~graphCache() { clear(); }
+
+  /** entry of key, made the most recently used one; nullptr if absent */
+  entry* find(const std::string& key) {
+    auto it = _index.find(key);
+    if (it == _index.end()) return nullptr;
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return &it->second->second;
+  }
+
+  void insert(const std::string& key, const entry& e) {
+    erase_if([&key](const std::string& k) { return k == key; });
+    _lru.emplace_front(key, e);
+    _index[key] = _lru.begin();
+    while (_lru.size() > MAX_ENTRIES) {
+      destroy(_lru.back().second);
+      _index.erase(_lru.back().first);
+      _lru.pop_back();
+    }
+  }
+
+  /** destroys the entries whose key starts with prefix */
+  void erase(const std::string& prefix) {
+    erase_if([&prefix](const std::string& k) {
+      return k.compare(0, prefix.size(), prefix) == 0;
+    });
+  }
+
+  void clear() {
+    for (auto& it : _lru) destroy(it.second);
+    _lru.clear();
+    _index.clear();
+  }
+
+ private:
+  typedef std::list<std::pair<std::string, entry>> list_t;
+
+  template <typename Pred>
+  void erase_if(Pred pred) {
+    for (auto it = _lru.begin(); it != _lru.end();) {
+      if (pred(it->first)) {
+        destroy(it->second);
+        _index.erase(it->first);
+        it = _lru.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  static void destroy(entry& e) {
+    if (e.exec == nullptr) return;
+    // the buffers can only go once the last replay is done with them, on
+    // whichever stream it ran (which may be gone by now: the buffers are
+    // given back on the default stream). No CUDA_CHECK here since this also
+    // runs in the handle's destructor
+    cudaEventSynchronize(e.done);
+    cudaEventDestroy(e.done);
+    cudaGraphExecDestroy(e.exec);
+    e.allocator->release(0);
+  }
+
+  list_t _lru;
+  std::unordered_map<std::string, list_t::iterator> _index;
+};
+
+}  // end namespace detail
+
+cumlHandle_impl::cumlHandle_impl(int n_streams)
+  : _num_streams(n_streams),
+    _dev_id([]() -> int {
       int cur_dev = -1;
       CUDA_CHECK(cudaGetDevice(&cur_dev));
       return cur_dev;
     }()),
     _deviceAllocator(std::make_shared<defaultDeviceAllocator>()),
     _hostAllocator(std::make_shared<defaultHostAllocator>()),
-    _userStream(NULL) {
+    _userStream(NULL),
+    _graphCapture(false),
+    _graphs(new detail::graphCache()) {
+  ASSERT(n_streams >= 0, "cumlHandle: number of streams must be >= 0");
   createResources();
 }
 
-cumlHandle_impl::~cumlHandle_impl() { destroyResources(); }
+cumlHandle_impl::~cumlHandle_impl() {
+  _graphs->clear();
+  destroyResources();
+}
 
 int cumlHandle_impl::getDevice() const { return _dev_id; }
 
@@ -196,7 +342,7 @@ void cumlHandle_impl::setDeviceAllocator(
 }
 
 std::shared_ptr<deviceAllocator> cumlHandle_impl::getDeviceAllocator() const {
-  return _deviceAllocator;
+  return _captureAllocator ? _captureAllocator : _deviceAllocator;
 }
 
 void cumlHandle_impl::setHostAllocator(
@@ -256,18 +402,77 @@ bool cumlHandle_impl::commsInitialized() const
     return (nullptr != _communicator.get());
 }
 
-void cumlHandle_impl::createResources() {
-  cudaStream_t stream;
-  CUDA_CHECK(cudaStreamCreate(&stream));
+void cumlHandle_impl::setGraphCapture(bool enable) { _graphCapture = enable; }
+
+bool cumlHandle_impl::getGraphCapture() const { return _graphCapture; }
+
+void cumlHandle_impl::clearGraphs() const { _graphs->clear(); }
+
+void cumlHandle_impl::eraseGraphs(const std::string& prefix) const {
+  _graphs->erase(prefix);
+}
+
+void cumlHandle_impl::launchGraph(const std::string& key, cudaStream_t stream,
+                                  const std::function<void()>& launch) const {
+  // graphs can't be captured on the legacy default stream, and a call made
+  // while recording an outer graph simply becomes part of it
+  if (!_graphCapture || stream == 0 || _captureAllocator) {
+    launch();
+    return;
+  }
+  detail::graphCache::entry* cached = _graphs->find(key);
+  if (cached != nullptr) {
+    if (cached->exec == nullptr) {
+      launch();
+    } else {
+      cached->launch(stream);
+    }
+    return;
+  }
 
+  auto recorder = std::make_shared<detail::graphAllocator>(_deviceAllocator);
+  _captureAllocator = recorder;
+  CUDA_CHECK(cudaStreamBeginCapture(stream, cudaStreamCaptureModeRelaxed));
+  bool recorded = true;
+  try {
+    launch();
+  } catch (...) {
+    recorded = false;
+  }
+  cudaGraph_t graph = nullptr;
+  cudaError_t status = cudaStreamEndCapture(stream, &graph);
+  _captureAllocator.reset();
+  cudaGraphExec_t exec = nullptr;
+  if (recorded && status == cudaSuccess && graph != nullptr) {
+    status = cudaGraphInstantiate(&exec, graph, nullptr, nullptr, 0);
+    if (status != cudaSuccess) exec = nullptr;
+  }
+  if (graph != nullptr) cudaGraphDestroy(graph);
+
+  if (exec == nullptr) {
+    // nothing was executed while recording: clear the capture error, give
+    // the buffers back and run eagerly. A genuine error is thrown again here
+    // and the key is left out of the cache.
+    cudaGetLastError();
+    recorder->release(stream);
+    launch();
+    _graphs->insert(key, {nullptr, nullptr, nullptr});
+    return;
+  }
+  cudaEvent_t done;
+  CUDA_CHECK(cudaEventCreateWithFlags(&done, cudaEventDisableTiming));
+  _graphs->insert(key, {exec, recorder, done});
+  _graphs->find(key)->launch(stream);
+}
+
+void cumlHandle_impl::createResources() {
   CUBLAS_CHECK(cublasCreate(&_cublas_handle));
 
   CUSOLVER_CHECK(cusolverDnCreate(&_cusolverDn_handle));
 
   CUSPARSE_CHECK(cusparseCreate(&_cusparse_handle));
 
-  _streams.push_back(stream);
-  for (int i = 1; i < _num_streams; ++i) {
+  for (int i = 0; i < _num_streams; ++i) {
     cudaStream_t stream;
     CUDA_CHECK(cudaStreamCreate(&stream));
     _streams.push_back(stream);
@@ -315,6 +520,114 @@ void cumlHandle_impl::destroyResources() {
   }
 }
 
+cumlHandlePool::lease::lease(cumlHandlePool* pool, int idx)
+  : _pool(pool), _idx(idx) {}
+
+cumlHandlePool::lease::lease(lease&& other)
+  : _pool(other._pool), _idx(other._idx) {
+  other._pool = nullptr;
+}
+
+cumlHandlePool::lease& cumlHandlePool::lease::operator=(lease&& other) {
+  if (this != &other) {
+    giveBack();
+    _pool = other._pool;
+    _idx = other._idx;
+    other._pool = nullptr;
+  }
+  return *this;
+}
+
+cumlHandlePool::lease::~lease() { giveBack(); }
+
+cumlHandle& cumlHandlePool::lease::handle() const {
+  ASSERT(_pool != nullptr, "cumlHandlePool: empty lease");
+  return *_pool->_handles[_idx];
+}
+
+cudaStream_t cumlHandlePool::lease::stream() const {
+  return handle().getStream();
+}
+
+void cumlHandlePool::lease::giveBack() {
+  if (_pool != nullptr) {
+    _pool->giveBack(_idx);
+    _pool = nullptr;
+  }
+}
+
+cumlHandlePool::cumlHandlePool(int n_handles, int n_streams,
+                               std::shared_ptr<deviceAllocator> d_allocator,
+                               std::shared_ptr<hostAllocator> h_allocator) {
+  ASSERT(n_handles > 0, "cumlHandlePool: need at least one handle");
+  if (d_allocator == nullptr)
+    d_allocator = std::make_shared<defaultDeviceAllocator>();
+  if (h_allocator == nullptr)
+    h_allocator = std::make_shared<defaultHostAllocator>();
+  for (int i = 0; i < n_handles; ++i) {
+    cudaStream_t stream;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    _streams.push_back(stream);
+    _handles.emplace_back(new cumlHandle(n_streams));
+    _handles.back()->setDeviceAllocator(d_allocator);
+    _handles.back()->setHostAllocator(h_allocator);
+    _handles.back()->setStream(stream);
+    _free.push_back(i);
+  }
+}
+
+cumlHandlePool::~cumlHandlePool() {
+  // deallocate should not throw execeptions which is why CUDA_CHECK is not
+  // used.
+  for (auto s : _streams) cudaStreamSynchronize(s);
+  _handles.clear();
+  for (auto s : _streams) cudaStreamDestroy(s);
+}
+
+cumlHandlePool::lease cumlHandlePool::checkout(cudaStream_t stream) {
+  int idx;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] { return !_free.empty(); });
+    idx = _free.back();
+    _free.pop_back();
+  }
+  lend(idx, stream);
+  return lease(this, idx);
+}
+
+cumlHandlePool::lease cumlHandlePool::tryCheckout(cudaStream_t stream) {
+  int idx;
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    if (_free.empty()) return lease(nullptr, -1);
+    idx = _free.back();
+    _free.pop_back();
+  }
+  lend(idx, stream);
+  return lease(this, idx);
+}
+
+int cumlHandlePool::size() const { return _handles.size(); }
+
+int cumlHandlePool::available() const {
+  std::lock_guard<std::mutex> guard(_mutex);
+  return _free.size();
+}
+
+void cumlHandlePool::lend(int idx, cudaStream_t stream) {
+  _handles[idx]->setStream(stream != nullptr ? stream : _streams[idx]);
+}
+
+void cumlHandlePool::giveBack(int idx) {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _handles[idx]->setStream(_streams[idx]);
+    _free.push_back(idx);
+  }
+  _cv.notify_one();
+}
+
 HandleMap handleMap;
 
 std::pair<cumlHandle_t, cumlError_t> HandleMap::createAndInsertHandle() {
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <functional>
 #include <mutex>
+#include <sstream>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -32,12 +35,16 @@
 
 namespace ML {
 
+namespace detail {
+class graphCache;
+}  // end namespace detail
+
 /**
  * @todo: Add doxygen documentation
  */
 class cumlHandle_impl {
  public:
-  cumlHandle_impl();
+  cumlHandle_impl(int n_streams = cumlHandle::getDefaultNumInternalStreams());
   ~cumlHandle_impl();
   int getDevice() const;
   void setStream(cudaStream_t stream);
@@ -62,9 +69,36 @@ class cumlHandle_impl {
   const MLCommon::cumlCommunicator& getCommunicator() const;
   bool commsInitialized() const;
 
+  void setGraphCapture(bool enable);
+  bool getGraphCapture() const;
+  void clearGraphs() const;
+  /** @brief Destroy the cached graphs whose key starts with `prefix`. */
+  void eraseGraphs(const std::string& prefix) const;
+  /**
+   * @brief Enqueue the work of `launch` on `stream`, through a CUDA graph
+   * cached under `key` if graph capture is enabled.
+   *
+   * On the first call for a key, the work is recorded into a graph, with
+   * every device allocation made through this handle kept alive for the
+   * graph; later calls with the same key replay the graph instead of
+   * calling `launch`. The key must therefore capture everything that is
+   * baked into the launches: shapes, scalars and device pointers. Buffers
+   * owned by a model must be keyed by an id that is never reused rather
+   * than by address, as a freed model's graphs may outlive it (e.g. on
+   * another handle). Work that cannot be captured (e.g. synchronizing
+   * calls) is detected and the key is run eagerly from then on. The least
+   * recently launched graphs are destroyed beyond a fixed number, once
+   * their last launch is done (graphs may be launched on any stream).
+   *
+   * This is const like the other accessors used by the algorithms, but
+   * updates the graph cache: as for the rest of the handle, calls must not
+   * be made from several threads at once.
+   */
+  void launchGraph(const std::string& key, cudaStream_t stream,
+                   const std::function<void()>& launch) const;
+
  private:
-  //TODO: What is the right number?
-  static constexpr int _num_streams = 3;
+  const int _num_streams;
   const int _dev_id;
   std::vector<cudaStream_t> _streams;
   cublasHandle_t _cublas_handle;
@@ -77,6 +111,11 @@ class cumlHandle_impl {
 
   std::shared_ptr<MLCommon::cumlCommunicator> _communicator;
 
+  bool _graphCapture;
+  std::unique_ptr<detail::graphCache> _graphs;
+  /** receives the device allocations while a graph is recorded */
+  mutable std::shared_ptr<deviceAllocator> _captureAllocator;
+
   void createResources();
   void destroyResources();
 };
@@ -129,6 +168,29 @@ extern HandleMap handleMap;
 
 namespace detail {
 
+inline void appendGraphKey(std::ostringstream& oss) {}
+
+template <typename Arg, typename... Args>
+void appendGraphKey(std::ostringstream& oss, const Arg& arg,
+                    const Args&... args) {
+  oss << '|' << arg;
+  appendGraphKey(oss, args...);
+}
+
+/**
+ * @brief Build the key of a cached graph (see cumlHandle_impl::launchGraph)
+ * from the name of the calling function and all of its arguments.
+ */
+template <typename... Args>
+std::string graphKey(const char* name, const Args&... args) {
+  std::ostringstream oss;
+  // scalars are baked into the graph, they must round-trip through the key
+  oss.precision(17);
+  oss << name;
+  appendGraphKey(oss, args...);
+  return oss.str();
+}
+
 /**
  * @todo: Add doxygen documentation
  */
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <cuda_runtime.h>
 
@@ -43,6 +46,15 @@ class cumlHandle {
      *   - HostAllocator: cudaMallocHost
      */
   cumlHandle();
+  /**
+     * @brief construct a cumlHandle with default paramters and the given
+     *        number of internal streams.
+     *
+     * @param[in] n_streams number of internal streams that algorithms can
+     *                      use to overlap their work (0 runs everything on
+     *                      the user stream).
+     */
+  explicit cumlHandle(int n_streams);
   /**
      * @brief releases all resources internally manged by cumlHandle.
      */
@@ -83,6 +95,43 @@ class cumlHandle {
      * @returns the MLCommon::hostAllocator to use for host allocations.
      */
   std::shared_ptr<hostAllocator> getHostAllocator() const;
+  /**
+     * @brief returns the number of internal streams of this handle.
+     */
+  int getNumInternalStreams() const;
+  /**
+     * @brief number of internal streams of the handles created without an
+     *        explicit count.
+     */
+  static int getDefaultNumInternalStreams();
+  /**
+     * @brief enables or disables CUDA graph capture of the fixed-shape calls.
+     *
+     * When enabled, the predict functions that support it record their
+     * kernel sequence into a CUDA graph on the first call for a given set
+     * of shapes, scalars and device pointers, and replay it afterwards.
+     * Graphs hold on to their temporary device buffers until they are
+     * evicted (only the most recently used ones are kept), clearGraphs()
+     * is called or the handle is destroyed. The stream set on this handle
+     * must not be the legacy default stream for graphs to be used.
+     *
+     * The input and output pointers are part of the recorded graph: this
+     * only pays off when the same device buffers are passed again and again
+     * (e.g. a serving loop over preallocated buffers). Calls on fresh
+     * buffers each record, instantiate and later evict a graph of their
+     * own, which is slower than running them directly.
+     *
+     * @param[in] enable    whether to capture and replay graphs
+     */
+  void setGraphCapture(bool enable);
+  /**
+     * @brief returns whether CUDA graph capture is enabled (see setGraphCapture)
+     */
+  bool getGraphCapture() const;
+  /**
+     * @brief destroys all the graphs recorded so far and frees their buffers.
+     */
+  void clearGraphs();
   /**
      * @brief for internal use only.
      */
@@ -95,4 +144,110 @@ private:
     std::unique_ptr<cumlHandle_impl> _impl;
 };
 
+/**
+ * @brief A fixed size pool of cumlHandle's for services which run cuML calls
+ *        from many threads at once.
+ *
+ * A cumlHandle must not be used by two threads at the same time. Instead of
+ * one handle per thread, request threads check a handle out of the pool for
+ * the duration of a request and give it back afterwards, so the number of
+ * handles (and of the cuBLAS/cuSOLVER/cuSPARSE handles and internal streams
+ * they own) is bounded by the peak concurrency rather than by the number of
+ * threads. The library handles stay per handle, as they are bound to a
+ * stream while in use. All the pooled handles share the same allocators,
+ * which must therefore be thread-safe, and each one comes with its own
+ * stream, used as the stream of the handle unless the lease supplies one.
+ */
+class cumlHandlePool {
+ public:
+  /**
+     * @brief RAII lease on a pooled handle, the handle goes back to the pool
+     *        when the lease is destroyed.
+     */
+  class lease {
+   public:
+    lease(lease&& other);
+    lease& operator=(lease&& other);
+    lease(const lease& other) = delete;
+    lease& operator=(const lease& other) = delete;
+    ~lease();
+    /**
+       * @brief whether the lease holds a handle (see tryCheckout()).
+       */
+    explicit operator bool() const { return _pool != nullptr; }
+    /**
+       * @brief the leased handle, valid until the lease is destroyed.
+       */
+    cumlHandle& handle() const;
+    /**
+       * @brief the stream of the leased handle.
+       */
+    cudaStream_t stream() const;
+
+   private:
+    friend class cumlHandlePool;
+    lease(cumlHandlePool* pool, int idx);
+    void giveBack();
+
+    cumlHandlePool* _pool;
+    int _idx;
+  };
+
+  /**
+     * @brief creates all the handles of the pool.
+     *
+     * @param[in] n_handles     number of handles, i.e. maximum number of
+     *                          concurrent leases
+     * @param[in] n_streams     number of internal streams of each handle
+     * @param[in] d_allocator   device allocator shared by all the handles
+     *                          (default: cudaMalloc)
+     * @param[in] h_allocator   host allocator shared by all the handles
+     *                          (default: cudaMallocHost)
+     */
+  cumlHandlePool(int n_handles,
+                 int n_streams = cumlHandle::getDefaultNumInternalStreams(),
+                 std::shared_ptr<deviceAllocator> d_allocator = nullptr,
+                 std::shared_ptr<hostAllocator> h_allocator = nullptr);
+  /**
+     * @brief waits for the work of all the handles and releases them. All the
+     *        leases must have been given back.
+     */
+  ~cumlHandlePool();
+
+  cumlHandlePool(const cumlHandlePool& other) = delete;
+  cumlHandlePool& operator=(const cumlHandlePool& other) = delete;
+
+  /**
+     * @brief checks a handle out of the pool, waiting for one to be given
+     *        back if they are all in use.
+     *
+     * @param[in] stream    stream to order the work of the lease on; by
+     *                      default the pool's own stream for that handle.
+     */
+  lease checkout(cudaStream_t stream = nullptr);
+  /**
+     * @brief like checkout(), but returns an empty lease instead of waiting
+     *        when all the handles are in use.
+     */
+  lease tryCheckout(cudaStream_t stream = nullptr);
+  /**
+     * @brief number of handles in the pool.
+     */
+  int size() const;
+  /**
+     * @brief number of handles currently available.
+     */
+  int available() const;
+
+ private:
+  void giveBack(int idx);
+  void lend(int idx, cudaStream_t stream);
+
+  std::vector<std::unique_ptr<cumlHandle>> _handles;
+  std::vector<cudaStream_t> _streams;
+  std::vector<int> _free;
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
 }  // end namespace ML
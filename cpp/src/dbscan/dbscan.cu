@@ -17,6 +17,7 @@
 #include <common/cumlHandle.hpp>
 #include "dbscan.h"
 #include "dbscan.hpp"
+#include "dbscan_mg.h"
 #include "runner.h"
 #include "utils.h"
 
@@ -43,4 +44,20 @@ void dbscanFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
                                  handle.getStream(), verbose);
 }
 
+void dbscanFitMG(const cumlHandle &handle, float *input, int n_rows,
+                 int n_cols, float eps, int min_pts, int *labels,
+                 size_t max_bytes_per_batch, bool verbose) {
+  dbscanFitMGImpl<float, int64_t>(handle.getImpl(), input, n_rows, n_cols,
+                                  eps, min_pts, labels, max_bytes_per_batch,
+                                  handle.getStream(), verbose);
+}
+
+void dbscanFitMG(const cumlHandle &handle, double *input, int n_rows,
+                 int n_cols, double eps, int min_pts, int *labels,
+                 size_t max_bytes_per_batch, bool verbose) {
+  dbscanFitMGImpl<double, int64_t>(handle.getImpl(), input, n_rows, n_cols,
+                                   eps, min_pts, labels, max_bytes_per_batch,
+                                   handle.getStream(), verbose);
+}
+
 };  // end namespace ML
@@ -43,4 +43,37 @@ void dbscanFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
                bool verbose = false);
 /** @} */
 
+/**
+ * @defgroup DbscanMGCpp C++ implementation of multi-rank Dbscan
+ * @brief Fits a DBSCAN model on a feature matrix distributed across the ranks
+ * of the handle's communicator. Each rank passes its own rows and gets the
+ * labels of these rows back. Space is partitioned across the ranks, points
+ * within eps of a partition border are exchanged as halo, and the clusters
+ * crossing borders are merged through their shared core points. This merge
+ * is a union-find run on the host of every rank over the edges gathered from
+ * all the ranks, one per halo copy of a core point: the core points near the
+ * borders must fit in the host memory of a single rank. The labels are the
+ * ones the single device path gives for the rank ordered concatenation of
+ * the rows, except that a border point within eps of several clusters may be
+ * attached to another of them.
+ * @param[in] handle cuml handle with an initialized communicator
+ * @param[in] input row-major local input feature matrix
+ * @param[in] n_rows number of local samples
+ * @param[in] n_cols number of features in the input feature matrix
+ * @param[in] eps the epsilon value to use for epsilon-neighborhood determination
+ * @param[in] min_pts minimum number of points to determine a cluster
+ * @param[out] labels (size n_rows) output labels of the local samples
+ * @param[in] max_mem_bytes: the maximum number of bytes to be used for each batch of
+ *            the local pairwise distance calculation.
+ * @param[in] verbose: print useful information as algorithm executes
+ * @{
+ */
+void dbscanFitMG(const cumlHandle &handle, float *input, int n_rows,
+                 int n_cols, float eps, int min_pts, int *labels,
+                 size_t max_bytes_per_batch, bool verbose = false);
+void dbscanFitMG(const cumlHandle &handle, double *input, int n_rows,
+                 int n_cols, double eps, int min_pts, int *labels,
+                 size_t max_bytes_per_batch, bool verbose = false);
+/** @} */
+
 }  // namespace ML
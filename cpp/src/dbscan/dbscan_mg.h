@@ -0,0 +1,642 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <thrust/copy.h>
+#include <thrust/count.h>
+#include <thrust/execution_policy.h>
+#include <thrust/fill.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/sort.h>
+#include <thrust/transform.h>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "common/allocatorAdapter.hpp"
+#include "common/cuml_comms_int.hpp"
+#include "dbscan.h"
+#include "linalg/reduce.h"
+
+namespace Dbscan {
+namespace MG {
+
+using namespace MLCommon;
+
+// Resolution of the histogram used to balance the spatial partitions
+static const int N_BINS = 4096;
+
+/** Partition of a coordinate along the split axis, i.e. number of cuts <= v */
+template <typename T>
+HDI int slabOf(T v, const T *cuts, int n_cuts) {
+  int lo = 0, hi = n_cuts;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (cuts[mid] <= v)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/** Position of key in the sorted array keys, -1 if absent */
+DI int64_t findSorted(const int64_t *keys, int64_t n, int64_t key) {
+  int64_t lo = 0, hi = n;
+  while (lo < hi) {
+    int64_t mid = (lo + hi) / 2;
+    if (keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < n && keys[lo] == key ? lo : -1;
+}
+
+template <typename T, typename Index_>
+__global__ void histKernel(int64_t *hist, const T *x, Index_ n, Index_ D,
+                           int axis, T lo, T width) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n) return;
+  int b = width > T(0) ? int((x[i * D + axis] - lo) / width) : 0;
+  b = b < 0 ? 0 : (b >= N_BINS ? N_BINS - 1 : b);
+  atomicAdd((unsigned long long *)(hist + b), 1ULL);
+}
+
+/**
+ * Range of partitions [first, last] within eps of each point along the split
+ * axis, and the partition owning the point. A point is sent to every
+ * partition of its range, so that each partition sees the full
+ * eps-neighborhood of the points it owns.
+ */
+template <typename T, typename Index_>
+__global__ void rangeKernel(int *first, int *last, int *owner, const T *x,
+                            Index_ n, Index_ D, int axis, const T *cuts,
+                            int n_cuts, T eps) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n) return;
+  T v = x[i * D + axis];
+  first[i] = slabOf(v - eps, cuts, n_cuts);
+  last[i] = slabOf(v + eps, cuts, n_cuts);
+  owner[i] = slabOf(v, cuts, n_cuts);
+}
+
+template <typename T, typename Index_>
+__global__ void gatherKernel(T *out, int64_t *out_gid, const T *x,
+                             const Index_ *idx, Index_ n, Index_ D,
+                             int64_t gid_offset) {
+  Index_ e = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (e >= n * D) return;
+  Index_ row = e / D, j = e % D;
+  out[e] = x[idx[row] * D + j];
+  if (j == 0) out_gid[row] = gid_offset + idx[row];
+}
+
+/** Core flag of each row, from its owned copy */
+template <typename Index_>
+__global__ void rowCoreKernel(bool *row_core, const Index_ *sidx,
+                              const int *sdest, const int *owner,
+                              const bool *back_core, Index_ n_send) {
+  Index_ j = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (j >= n_send) return;
+  Index_ i = sidx[j];
+  if (sdest[j] == owner[i]) row_core[i] = back_core[j];
+}
+
+/** Smallest global id of the core points of each local component */
+template <typename Index_>
+__global__ void compCoreKernel(int64_t *comp_core, const int *labels,
+                               const bool *core, const int64_t *gid,
+                               Index_ n) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n || !core[i]) return;
+  atomicMin((unsigned long long *)(comp_core + labels[i] - 1),
+            (unsigned long long)gid[i]);
+}
+
+/**
+ * Component of each point, -1 for noise, with the smallest core point of the
+ * component. Border points are in the component of one of their core
+ * neighbors.
+ */
+template <typename Index_>
+__global__ void compIdKernel(int64_t *comp, int64_t *core_gid,
+                             const int *labels, const int64_t *comp_core,
+                             Index_ n, int64_t comp_offset) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n) return;
+  if (labels[i] == INT_MAX) {
+    comp[i] = -1;
+    core_gid[i] = INT64_MAX;
+    return;
+  }
+  int rep = labels[i] - 1;
+  comp[i] = comp_offset + rep;
+  core_gid[i] = comp_core[rep];
+}
+
+/** Component of the owned copy of each input point */
+template <typename Index_>
+__global__ void ownCopyKernel(int64_t *own_comp, int64_t *own_core,
+                              const Index_ *sidx, const int *sdest,
+                              const int *owner, const int64_t *back_comp,
+                              const int64_t *back_core, Index_ n_send) {
+  Index_ j = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (j >= n_send) return;
+  Index_ i = sidx[j];
+  if (sdest[j] != owner[i]) return;
+  own_comp[i] = back_comp[j];
+  own_core[i] = back_core[j];
+}
+
+/** (component, core gid) pairs of the owned and of a halo copy of a point */
+template <typename Index_>
+__global__ void edgeKernel(int64_t *edges, const Index_ *hpos, Index_ n_edges,
+                           const Index_ *sidx, const int64_t *own_comp,
+                           const int64_t *own_core, const int64_t *back_comp,
+                           const int64_t *back_core) {
+  Index_ e = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (e >= n_edges) return;
+  Index_ j = hpos[e], i = sidx[j];
+  edges[4 * e] = own_comp[i];
+  edges[4 * e + 1] = own_core[i];
+  edges[4 * e + 2] = back_comp[j];
+  edges[4 * e + 3] = back_core[j];
+}
+
+template <typename Index_>
+__global__ void resolveKernel(int64_t *key, const int64_t *own_comp,
+                              const int64_t *own_core, Index_ n,
+                              const int64_t *bcomp, const int64_t *bcore,
+                              int64_t nb) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n) return;
+  int64_t pos = findSorted(bcomp, nb, own_comp[i]);
+  key[i] = pos >= 0 ? bcore[pos] : own_core[i];
+}
+
+template <typename Index_>
+__global__ void labelKernel(int *labels, const int64_t *key, Index_ n,
+                            const int64_t *cluster_keys, int64_t n_clusters) {
+  Index_ i = threadIdx.x + Index_(blockIdx.x) * blockDim.x;
+  if (i >= n) return;
+  labels[i] = key[i] == INT64_MAX
+                ? -1
+                : int(findSorted(cluster_keys, n_clusters, key[i]));
+}
+
+/**
+ * Union-find over the components linked by the halo copies of core points,
+ * run identically on every rank. Returns the sorted component ids and, for
+ * each, the smallest core point global id of its merged component.
+ * edges holds 4 values per halo copy: (component, core gid) of the owned
+ * copy, then of the halo copy.
+ */
+inline void mergeComponents(const std::vector<int64_t> &edges,
+                            std::vector<int64_t> &comps,
+                            std::vector<int64_t> &core) {
+  size_t n_edges = edges.size() / 4;
+  comps.clear();
+  for (size_t e = 0; e < n_edges; e++) {
+    comps.push_back(edges[4 * e]);
+    comps.push_back(edges[4 * e + 2]);
+  }
+  std::sort(comps.begin(), comps.end());
+  comps.erase(std::unique(comps.begin(), comps.end()), comps.end());
+
+  auto index = [&comps](int64_t c) {
+    return std::lower_bound(comps.begin(), comps.end(), c) - comps.begin();
+  };
+  std::vector<int64_t> parent(comps.size()), attr(comps.size(), INT64_MAX);
+  for (size_t c = 0; c < comps.size(); c++) parent[c] = c;
+  auto find = [&parent](int64_t c) {
+    while (parent[c] != c) {
+      parent[c] = parent[parent[c]];
+      c = parent[c];
+    }
+    return c;
+  };
+  for (size_t e = 0; e < n_edges; e++) {
+    int64_t a = index(edges[4 * e]), b = index(edges[4 * e + 2]);
+    attr[a] = std::min(attr[a], edges[4 * e + 1]);
+    attr[b] = std::min(attr[b], edges[4 * e + 3]);
+    a = find(a);
+    b = find(b);
+    if (a != b) parent[std::max(a, b)] = std::min(a, b);
+  }
+  std::vector<int64_t> root_attr(comps.size(), INT64_MAX);
+  for (size_t c = 0; c < comps.size(); c++) {
+    int64_t r = find(c);
+    root_attr[r] = std::min(root_attr[r], attr[c]);
+  }
+  core.resize(comps.size());
+  for (size_t c = 0; c < comps.size(); c++) core[c] = root_attr[find(c)];
+}
+
+/**
+ * Point to point exchange of the values of the point copies: width values per
+ * copy, the copies for rank r at send_displs[r] in sendbuf, the ones from
+ * rank r at recv_displs[r] in recvbuf. sendbuf is complete once the work
+ * queued on stream is; the copies of the calling rank are copied on stream.
+ */
+template <typename V>
+void exchange(const cumlCommunicator &comm, const V *sendbuf,
+              const std::vector<int64_t> &send_counts,
+              const std::vector<int64_t> &send_displs, V *recvbuf,
+              const std::vector<int64_t> &recv_counts,
+              const std::vector<int64_t> &recv_displs, int width, int tag,
+              cudaStream_t stream) {
+  int n_ranks = comm.getSize(), rank = comm.getRank();
+  std::vector<cumlCommunicator::request_t> requests;
+  requests.reserve(2 * n_ranks);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  for (int r = 0; r < n_ranks; r++) {
+    if (r == rank) continue;
+    if (recv_counts[r] > 0) {
+      requests.emplace_back();
+      comm.irecv(recvbuf + recv_displs[r] * width, recv_counts[r] * width, r,
+                 tag, &requests.back());
+    }
+    if (send_counts[r] > 0) {
+      requests.emplace_back();
+      comm.isend(sendbuf + send_displs[r] * width, send_counts[r] * width, r,
+                 tag, &requests.back());
+    }
+  }
+  comm.waitall(requests.size(), requests.data());
+  copy(recvbuf + recv_displs[rank] * width, sendbuf + send_displs[rank] * width,
+       send_counts[rank] * width, stream);
+}
+
+/**
+ * Gathers variable length int64 arrays of all the ranks, in rank order
+ * (device buffers in, host vector out).
+ */
+inline void allgatherHost(const ML::cumlHandle_impl &handle,
+                          const int64_t *local, int n_local,
+                          std::vector<int64_t> &out, cudaStream_t stream) {
+  const cumlCommunicator &comm = handle.getCommunicator();
+  int n_ranks = comm.getSize();
+  device_buffer<int> d_counts(handle.getDeviceAllocator(), stream,
+                              n_ranks + 1);
+  updateDevice(d_counts.data() + n_ranks, &n_local, 1, stream);
+  comm.allgather(d_counts.data() + n_ranks, d_counts.data(), 1, stream);
+  std::vector<int> counts(n_ranks), displs(n_ranks);
+  updateHost(counts.data(), d_counts.data(), n_ranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int total = 0;
+  for (int r = 0; r < n_ranks; r++) {
+    displs[r] = total;
+    total += counts[r];
+  }
+  device_buffer<int64_t> d_all(handle.getDeviceAllocator(), stream, total);
+  comm.allgatherv<int64_t>(local, d_all.data(), counts.data(), displs.data(),
+                           stream);
+  out.resize(total);
+  updateHost(out.data(), d_all.data(), total, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
+
+};  // namespace MG
+};  // namespace Dbscan
+
+namespace ML {
+
+/**
+ * Distributed DBSCAN over the ranks of the handle's communicator, each rank
+ * holding a slice of the rows. The space is cut into one slab per rank along
+ * the dimension of largest extent, at global quantiles so that the slabs are
+ * balanced. Points are sent to the rank owning their slab and, as halo, to
+ * every other rank whose slab is within eps. As the owned points have their
+ * full neighborhood locally, their core flags are exact; they are passed on
+ * to the halo copies. Each rank then labels the clusters of its points, with
+ * only the core points connecting them. Every core-core edge is seen by the
+ * rank owning either end, so merging the components that share a core point,
+ * with a union-find over the halo copies, gives the global clusters. These
+ * are numbered by their smallest core point (as the single device path
+ * does). Border points join the cluster their owned copy was attached to.
+ *
+ * The union-find is not distributed: the edges of all the ranks (32 bytes
+ * per halo copy of a core point) are gathered on the host of every rank and
+ * merged there. This bounds the number of core points within eps of a slab
+ * border to what fits in host memory and a single threaded pass, i.e. a few
+ * hundred million, whatever the number of ranks.
+ */
+template <typename T, typename Index_ = int>
+void dbscanFitMGImpl(const ML::cumlHandle_impl &handle, T *input,
+                     Index_ n_rows, Index_ n_cols, T eps, int min_pts,
+                     int *labels, size_t max_bytes_per_batch,
+                     cudaStream_t stream, bool verbose) {
+  using namespace Dbscan::MG;
+  ML::PUSH_RANGE("ML::Dbscan::FitMG");
+  const MLCommon::cumlCommunicator &comm = handle.getCommunicator();
+  auto allocator = handle.getDeviceAllocator();
+  ML::thrustAllocatorAdapter alloc(allocator, stream);
+  auto exec = thrust::cuda::par(alloc).on(stream);
+  int n_ranks = comm.getSize(), rank = comm.getRank();
+  Index_ D = n_cols;
+  int n_blks = ceildiv<Index_>(n_rows, TPB);
+
+  // global ids are the row positions in the rank ordered concatenation
+  device_buffer<int64_t> d_rows(allocator, stream, n_ranks + 1);
+  int64_t n_local = n_rows;
+  updateDevice(d_rows.data() + n_ranks, &n_local, 1, stream);
+  comm.allgather(d_rows.data() + n_ranks, d_rows.data(), 1, stream);
+  std::vector<int64_t> rows(n_ranks);
+  updateHost(rows.data(), d_rows.data(), n_ranks, stream);
+
+  // split along the dimension of largest global extent
+  device_buffer<T> d_min(allocator, stream, D), d_max(allocator, stream, D);
+  LinAlg::reduce(
+    d_min.data(), input, D, n_rows, std::numeric_limits<T>::max(), true,
+    false, stream, false, MLCommon::Nop<T, int>(),
+    [] __device__(T a, T b) { return a < b ? a : b; });
+  LinAlg::reduce(
+    d_max.data(), input, D, n_rows, std::numeric_limits<T>::lowest(), true,
+    false, stream, false, MLCommon::Nop<T, int>(),
+    [] __device__(T a, T b) { return a > b ? a : b; });
+  comm.allreduce(d_min.data(), d_min.data(), D, cumlCommunicator::MIN, stream);
+  comm.allreduce(d_max.data(), d_max.data(), D, cumlCommunicator::MAX, stream);
+  std::vector<T> h_min(D), h_max(D);
+  updateHost(h_min.data(), d_min.data(), D, stream);
+  updateHost(h_max.data(), d_max.data(), D, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int axis = 0;
+  for (int j = 1; j < D; j++) {
+    if (h_max[j] - h_min[j] > h_max[axis] - h_min[axis]) axis = j;
+  }
+  int64_t n_total = 0;
+  std::vector<int64_t> row_offsets(n_ranks);
+  for (int r = 0; r < n_ranks; r++) {
+    row_offsets[r] = n_total;
+    n_total += rows[r];
+  }
+
+  // slab boundaries at the global quantiles of the split coordinate
+  T lo = h_min[axis], width = (h_max[axis] - h_min[axis]) / N_BINS;
+  device_buffer<int64_t> d_hist(allocator, stream, N_BINS);
+  CUDA_CHECK(
+    cudaMemsetAsync(d_hist.data(), 0, N_BINS * sizeof(int64_t), stream));
+  if (n_rows > 0) {
+    histKernel<<<n_blks, TPB, 0, stream>>>(d_hist.data(), input, n_rows, D,
+                                           axis, lo, width);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  comm.allreduce(d_hist.data(), d_hist.data(), N_BINS, cumlCommunicator::SUM,
+                 stream);
+  std::vector<int64_t> hist(N_BINS);
+  updateHost(hist.data(), d_hist.data(), N_BINS, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int n_cuts = n_ranks - 1;
+  std::vector<T> cuts(std::max(n_cuts, 1), h_max[axis]);
+  int64_t cum = 0;
+  for (int b = 0, r = 0; b < N_BINS && r < n_cuts; b++) {
+    cum += hist[b];
+    while (r < n_cuts && cum * n_ranks >= (r + 1) * n_total)
+      cuts[r++] = lo + (b + 1) * width;
+  }
+  device_buffer<T> d_cuts(allocator, stream, cuts.size());
+  updateDevice(d_cuts.data(), cuts.data(), cuts.size(), stream);
+
+  // destinations of each local point
+  device_buffer<int> first(allocator, stream, n_rows);
+  device_buffer<int> last(allocator, stream, n_rows);
+  device_buffer<int> owner(allocator, stream, n_rows);
+  if (n_rows > 0) {
+    rangeKernel<<<n_blks, TPB, 0, stream>>>(
+      first.data(), last.data(), owner.data(), input, n_rows, D, axis,
+      d_cuts.data(), n_cuts, eps);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  std::vector<int64_t> send_counts(n_ranks), send_displs(n_ranks + 1, 0);
+  const int *f = first.data(), *l = last.data();
+  for (int r = 0; r < n_ranks; r++) {
+    send_counts[r] = thrust::count_if(
+      exec, thrust::counting_iterator<Index_>(0),
+      thrust::counting_iterator<Index_>(n_rows),
+      [f, l, r] __device__(Index_ i) { return f[i] <= r && r <= l[i]; });
+    send_displs[r + 1] = send_displs[r] + send_counts[r];
+  }
+  device_buffer<Index_> sidx(allocator, stream, send_displs[n_ranks]);
+  device_buffer<int> sdest(allocator, stream, send_displs[n_ranks]);
+  for (int r = 0; r < n_ranks; r++) {
+    thrust::copy_if(
+      exec, thrust::counting_iterator<Index_>(0),
+      thrust::counting_iterator<Index_>(n_rows), sidx.data() + send_displs[r],
+      [f, l, r] __device__(Index_ i) { return f[i] <= r && r <= l[i]; });
+    thrust::fill(exec, sdest.data() + send_displs[r],
+                 sdest.data() + send_displs[r + 1], r);
+  }
+  Index_ n_send = send_displs[n_ranks];
+  device_buffer<T> sbuf(allocator, stream, n_send * D);
+  device_buffer<int64_t> sgid(allocator, stream, n_send);
+  if (n_send > 0) {
+    gatherKernel<<<ceildiv<Index_>(n_send * D, TPB), TPB, 0, stream>>>(
+      sbuf.data(), sgid.data(), input, sidx.data(), n_send, D,
+      row_offsets[rank]);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+
+  // exchange the points with their destinations
+  device_buffer<int64_t> d_counts(allocator, stream, n_ranks * (n_ranks + 1));
+  updateDevice(d_counts.data() + n_ranks * n_ranks, send_counts.data(),
+               n_ranks, stream);
+  comm.allgather(d_counts.data() + n_ranks * n_ranks, d_counts.data(),
+                 n_ranks, stream);
+  std::vector<int64_t> all_counts(n_ranks * n_ranks);
+  updateHost(all_counts.data(), d_counts.data(), n_ranks * n_ranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  std::vector<int64_t> recv_counts(n_ranks), recv_displs(n_ranks + 1, 0);
+  for (int s = 0; s < n_ranks; s++) {
+    recv_counts[s] = all_counts[s * n_ranks + rank];
+    recv_displs[s + 1] = recv_displs[s] + recv_counts[s];
+    ASSERT(std::max(recv_counts[s], send_counts[s]) * D * sizeof(T) < INT_MAX,
+           "dbscanFitMG: more than 2GB exchanged between two ranks");
+  }
+  Index_ M = recv_displs[n_ranks];
+  ASSERT(M < INT_MAX, "dbscanFitMG: %ld points on rank %d after partitioning",
+         (long)M, rank);
+  device_buffer<T> x(allocator, stream, M * D);
+  device_buffer<int64_t> gid(allocator, stream, M);
+
+  exchange(comm, sbuf.data(), send_counts, send_displs, x.data(), recv_counts,
+           recv_displs, (int)D, 0, stream);
+  exchange(comm, sgid.data(), send_counts, send_displs, gid.data(),
+           recv_counts, recv_displs, 1, 1, stream);
+  sbuf.release(stream);
+  sgid.release(stream);
+
+  if (verbose) {
+    std::cout << "Rank " << rank << ": " << M << " points after partitioning ("
+              << n_rows << " local rows)" << std::endl;
+  }
+
+  // exact core flags of the owned copies
+  if (max_bytes_per_batch <= 0) max_bytes_per_batch = DEFAULT_MAX_MEM_BYTES;
+  Index_ n_batches =
+    M > 0 ? computeBatchCount<T, Index_>(M, max_bytes_per_batch) : 1;
+  device_buffer<bool> core(allocator, stream, M);
+  if (M > 0) {
+    Index_ batch_size = ceildiv<Index_>(M, n_batches);
+    device_buffer<bool> adj(allocator, stream, (size_t)M * batch_size);
+    device_buffer<int> vd(allocator, stream, batch_size + 1);
+    Dbscan::corePoints<T, Index_>(handle, adj.data(), vd.data(), x.data(), M,
+                                  D, eps, min_pts, 1, batch_size, core.data(),
+                                  stream);
+  }
+
+  // pass them to the ranks holding the rows, and from there to all copies
+  device_buffer<bool> back_flag(allocator, stream, n_send);
+  exchange(comm, core.data(), recv_counts, recv_displs, back_flag.data(),
+           send_counts, send_displs, 1, 2, stream);
+  device_buffer<bool> row_core(allocator, stream, n_rows);
+  device_buffer<bool> send_flag(allocator, stream, n_send);
+  if (n_send > 0) {
+    rowCoreKernel<<<ceildiv<Index_>(n_send, TPB), TPB, 0, stream>>>(
+      row_core.data(), sidx.data(), sdest.data(), owner.data(),
+      back_flag.data(), n_send);
+    CUDA_CHECK(cudaPeekAtLastError());
+    const bool *rc = row_core.data();
+    thrust::transform(exec, sidx.data(), sidx.data() + n_send,
+                      send_flag.data(),
+                      [rc] __device__(Index_ i) { return rc[i]; });
+  }
+  exchange(comm, send_flag.data(), send_counts, send_displs, core.data(),
+           recv_counts, recv_displs, 1, 3, stream);
+  back_flag.release(stream);
+  send_flag.release(stream);
+
+  // local clusters, only connected through core points
+  device_buffer<int> lab(allocator, stream, M);
+  device_buffer<int64_t> comp_core(allocator, stream, M);
+  device_buffer<int64_t> comp(allocator, stream, M);
+  device_buffer<int64_t> comp_core_gid(allocator, stream, M);
+  device_buffer<int64_t> d_m(allocator, stream, n_ranks + 1);
+  int64_t m_local = M;
+  updateDevice(d_m.data() + n_ranks, &m_local, 1, stream);
+  comm.allgather(d_m.data() + n_ranks, d_m.data(), 1, stream);
+  std::vector<int64_t> ms(n_ranks);
+  updateHost(ms.data(), d_m.data(), n_ranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int64_t comp_offset = 0;
+  for (int r = 0; r < rank; r++) comp_offset += ms[r];
+
+  if (M > 0) {
+    size_t workspaceSize = Dbscan::run(
+      handle, x.data(), M, D, eps, min_pts, lab.data(), 1, 1, 2, NULL,
+      n_batches, stream, core.data(), core.data());
+    device_buffer<char> workspace(allocator, stream, workspaceSize);
+    Dbscan::run(handle, x.data(), M, D, eps, min_pts, lab.data(), 1, 1, 2,
+                workspace.data(), n_batches, stream, core.data(), core.data());
+
+    int m_blks = ceildiv<Index_>(M, TPB);
+    thrust::fill(exec, comp_core.data(), comp_core.data() + M, INT64_MAX);
+    compCoreKernel<<<m_blks, TPB, 0, stream>>>(comp_core.data(), lab.data(),
+                                               core.data(), gid.data(), M);
+    compIdKernel<<<m_blks, TPB, 0, stream>>>(comp.data(), comp_core_gid.data(),
+                                             lab.data(), comp_core.data(), M,
+                                             comp_offset);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  x.release(stream);
+
+  // send the components of the copies back to the ranks holding the rows
+  device_buffer<int64_t> back_comp(allocator, stream, n_send);
+  device_buffer<int64_t> back_core(allocator, stream, n_send);
+  exchange(comm, comp.data(), recv_counts, recv_displs, back_comp.data(),
+           send_counts, send_displs, 1, 4, stream);
+  exchange(comm, comp_core_gid.data(), recv_counts, recv_displs,
+           back_core.data(), send_counts, send_displs, 1, 5, stream);
+
+  // link the owned copy of each core row with its halo copies
+  device_buffer<int64_t> own_comp(allocator, stream, n_rows);
+  device_buffer<int64_t> own_core(allocator, stream, n_rows);
+  device_buffer<Index_> hpos(allocator, stream, n_send);
+  Index_ n_edges = 0;
+  if (n_send > 0) {
+    ownCopyKernel<<<ceildiv<Index_>(n_send, TPB), TPB, 0, stream>>>(
+      own_comp.data(), own_core.data(), sidx.data(), sdest.data(),
+      owner.data(), back_comp.data(), back_core.data(), n_send);
+    CUDA_CHECK(cudaPeekAtLastError());
+    const Index_ *si = sidx.data();
+    const int *sd = sdest.data(), *ow = owner.data();
+    const bool *rc = row_core.data();
+    auto end = thrust::copy_if(
+      exec, thrust::counting_iterator<Index_>(0),
+      thrust::counting_iterator<Index_>(n_send), hpos.data(),
+      [si, sd, ow, rc] __device__(Index_ j) {
+        return sd[j] != ow[si[j]] && rc[si[j]];
+      });
+    n_edges = end - hpos.data();
+  }
+  device_buffer<int64_t> d_edges(allocator, stream, 4 * n_edges);
+  if (n_edges > 0) {
+    edgeKernel<<<ceildiv<Index_>(n_edges, TPB), TPB, 0, stream>>>(
+      d_edges.data(), hpos.data(), n_edges, sidx.data(), own_comp.data(),
+      own_core.data(), back_comp.data(), back_core.data());
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  std::vector<int64_t> edges, bcomp, bcore;
+  allgatherHost(handle, d_edges.data(), 4 * n_edges, edges, stream);
+  mergeComponents(edges, bcomp, bcore);
+
+  // resolve the component of each row and number the clusters by their
+  // smallest core point
+  device_buffer<int64_t> d_bcomp(allocator, stream, bcomp.size());
+  device_buffer<int64_t> d_bcore(allocator, stream, bcore.size());
+  updateDevice(d_bcomp.data(), bcomp.data(), bcomp.size(), stream);
+  updateDevice(d_bcore.data(), bcore.data(), bcore.size(), stream);
+  device_buffer<int64_t> key(allocator, stream, n_rows);
+  device_buffer<int64_t> local_keys(allocator, stream, n_rows);
+  Index_ n_local_keys = 0;
+  if (n_rows > 0) {
+    resolveKernel<<<n_blks, TPB, 0, stream>>>(
+      key.data(), own_comp.data(), own_core.data(), n_rows, d_bcomp.data(),
+      d_bcore.data(), (int64_t)bcomp.size());
+    CUDA_CHECK(cudaPeekAtLastError());
+    const int64_t *k = key.data();
+    int64_t offset = row_offsets[rank];
+    auto end = thrust::copy_if(
+      exec, key.data(), key.data() + n_rows,
+      thrust::counting_iterator<int64_t>(0), local_keys.data(),
+      [k, offset] __device__(int64_t i) { return k[i] == offset + i; });
+    n_local_keys = end - local_keys.data();
+  }
+  std::vector<int64_t> cluster_keys;
+  allgatherHost(handle, local_keys.data(), n_local_keys, cluster_keys, stream);
+  std::sort(cluster_keys.begin(), cluster_keys.end());
+  device_buffer<int64_t> d_keys(allocator, stream, cluster_keys.size());
+  updateDevice(d_keys.data(), cluster_keys.data(), cluster_keys.size(),
+               stream);
+  if (n_rows > 0) {
+    labelKernel<<<n_blks, TPB, 0, stream>>>(labels, key.data(), n_rows,
+                                            d_keys.data(),
+                                            (int64_t)cluster_keys.size());
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+
+  if (verbose && rank == 0) {
+    std::cout << "Found " << cluster_keys.size() << " clusters, "
+              << bcomp.size() << " components merged across partitions"
+              << std::endl;
+  }
+  ML::POP_RANGE();
+}
+
+};  // namespace ML
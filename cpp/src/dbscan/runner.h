@@ -57,6 +57,37 @@ void final_relabel(Type* db_cluster, Index_ N, cudaStream_t stream) {
     [MAX_LABEL] __device__(int val) { return val == MAX_LABEL; });
 }
 
+template <typename Index_ = int>
+__global__ void corePointsKernel(bool* core_pts, const int* vd, Index_ n,
+                                 int minPts) {
+  Index_ tid = threadIdx.x + blockDim.x * blockIdx.x;
+  if (tid < n) core_pts[tid] = vd[tid] >= minPts;
+}
+
+/**
+ * Core point flags of all the N points, computed batch by batch from the
+ * vertex degrees, as AdjGraph does for a single batch. For the callers that
+ * need all the flags before labeling (run() itself gets them batch by batch).
+ * @param adj, vd VertexDeg buffers for batchSize points
+ * @param core_pts the output flags (size N)
+ */
+template <typename Type_f, typename Index_ = int>
+void corePoints(const ML::cumlHandle_impl& handle, bool* adj, int* vd,
+                Type_f* x, Index_ N, Index_ D, Type_f eps, int minPts,
+                int algoVd, Index_ batchSize, bool* core_pts,
+                cudaStream_t stream) {
+  for (Index_ startVertexId = 0; startVertexId < N;
+       startVertexId += batchSize) {
+    Index_ nPoints = min(N - startVertexId, batchSize);
+    VertexDeg::run<Type_f, Index_>(handle, adj, vd, x, eps, N, D, algoVd,
+                                   startVertexId, nPoints, stream);
+    int nblks = ceildiv<int>(nPoints, TPB);
+    corePointsKernel<<<nblks, TPB, 0, stream>>>(core_pts + startVertexId, vd,
+                                                nPoints, minPts);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+}
+
 /* @param N number of points
  * @param D dimensionality of the points
  * @param eps epsilon neighborhood criterion
@@ -67,12 +98,21 @@ void final_relabel(Type* db_cluster, Index_ N, cudaStream_t stream) {
  *             If this is a null pointer, then this function will return the workspace size needed.
  *             It is the responsibility of the user to cudaMalloc and cudaFree this buffer!
  * @param stream the cudaStream where to launch the kernels
+ * @param core_pts_out optional output (size N) for the core point flags. When
+ *             given, the raw labels are returned and the sklearn relabeling
+ *             is skipped: core points are labeled with 1 + the smallest vertex
+ *             id of the core points they are connected to, border points with
+ *             the smallest label of their core neighbors, noise points with
+ *             the max of Type.
+ * @param core_pts_in optional input (size N) for the core point flags, used
+ *             instead of the ones computed from the local neighborhoods.
  * @return in case the temp buffer is null, this returns the size needed.
  */
 template <typename Type, typename Type_f, typename Index_ = int>
 size_t run(const ML::cumlHandle_impl& handle, Type_f* x, Index_ N, Index_ D,
            Type_f eps, Type minPts, Type* labels, int algoVd, int algoAdj,
-           int algoCcl, void* workspace, Index_ nBatches, cudaStream_t stream) {
+           int algoCcl, void* workspace, Index_ nBatches, cudaStream_t stream,
+           bool* core_pts_out = nullptr, const bool* core_pts_in = nullptr) {
   const size_t align = 256;
   Index_ batchSize = ceildiv(N, nBatches);
   size_t adjSize = alignTo<size_t>(sizeof(bool) * N * batchSize, align);
@@ -84,7 +124,7 @@ size_t run(const ML::cumlHandle_impl& handle, Type_f* x, Index_ N, Index_ D,
 
   if (workspace == NULL) {
     auto size =
-      adjSize + corePtsSize + 2 * xaSize + mSize + vdSize + exScanSize;
+      adjSize + corePtsSize + 3 * xaSize + mSize + vdSize + exScanSize;
     return size;
   }
   // partition the temporary workspace needed for different stages of dbscan
@@ -95,6 +135,8 @@ size_t run(const ML::cumlHandle_impl& handle, Type_f* x, Index_ N, Index_ D,
   temp += adjSize;
   bool* core_pts = (bool*)temp;
   temp += corePtsSize;
+  bool* all_core_pts = (bool*)temp;
+  temp += xaSize;
   bool* xa = (bool*)temp;
   temp += xaSize;
   bool* fa = (bool*)temp;
@@ -106,6 +148,15 @@ size_t run(const ML::cumlHandle_impl& handle, Type_f* x, Index_ N, Index_ D,
   Type* ex_scan = (Type*)temp;
   temp += exScanSize;
 
+  // Core flags of the points labeled so far. The core points of the later
+  // batches are not known yet: they push their labels to (and take them
+  // from) the core points of the earlier batches when their batch is labeled
+  if (core_pts_in != nullptr) {
+    MLCommon::copy(all_core_pts, core_pts_in, N, stream);
+  } else {
+    CUDA_CHECK(cudaMemsetAsync(all_core_pts, 0, N * sizeof(bool), stream));
+  }
+
   // Running VertexDeg
   MLCommon::Sparse::WeakCCState<Type> state(xa, fa, m);
 
@@ -131,15 +182,22 @@ size_t run(const ML::cumlHandle_impl& handle, Type_f* x, Index_ N, Index_ D,
     AdjGraph::run<Type, Index_>(handle, adj, vd, adj_graph.data(), adjlen,
                                 ex_scan, N, minPts, core_pts, algoAdj, nPoints,
                                 stream);
+    if (core_pts_in == nullptr)
+      MLCommon::copy(all_core_pts + startVertexId, core_pts, nPoints, stream);
     ML::POP_RANGE();
 
+    // Only core points connect clusters, border points join one of them
     ML::PUSH_RANGE("Trace::Dbscan::WeakCC");
     MLCommon::Sparse::weak_cc_batched<Type, TPB>(
       labels, ex_scan, adj_graph.data(), adjlen, N, startVertexId, batchSize,
       &state, stream,
-      [core_pts] __device__(Type tid) { return core_pts[tid]; });
+      [all_core_pts] __device__(Type vid) { return all_core_pts[vid]; });
     ML::POP_RANGE();
   }
+  if (core_pts_out != nullptr) {
+    MLCommon::copy(core_pts_out, all_core_pts, N, stream);
+    return (size_t)0;
+  }
 
   ML::PUSH_RANGE("Trace::Dbscan::FinalRelabel");
   if (algoCcl == 2) final_relabel(labels, N, stream);
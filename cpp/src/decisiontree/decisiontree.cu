@@ -33,12 +33,13 @@ namespace DecisionTree {
  * @param[in] cfg_split_criterion: split criterion; default CRITERION_END,
  *            i.e., GINI for classification or MSE for regression
  * @param[in] cfg_quantile_per_tree: compute quantile per tree; default false
+ * @param[in] cfg_hist_subtraction: histogram subtraction; default true
  */
 void set_tree_params(DecisionTreeParams &params, int cfg_max_depth,
                      int cfg_max_leaves, float cfg_max_features, int cfg_n_bins,
                      int cfg_split_algo, int cfg_min_rows_per_node,
                      bool cfg_bootstrap_features, CRITERION cfg_split_criterion,
-                     bool cfg_quantile_per_tree) {
+                     bool cfg_quantile_per_tree, bool cfg_hist_subtraction) {
   params.max_depth = cfg_max_depth;
   params.max_leaves = cfg_max_leaves;
   params.max_features = cfg_max_features;
@@ -48,6 +49,7 @@ void set_tree_params(DecisionTreeParams &params, int cfg_max_depth,
   params.bootstrap_features = cfg_bootstrap_features;
   params.split_criterion = cfg_split_criterion;
   params.quantile_per_tree = cfg_quantile_per_tree;
+  params.hist_subtraction = cfg_hist_subtraction;
 }
 
 /**
@@ -91,6 +93,7 @@ void print(const DecisionTreeParams params) {
   std::cout << "bootstrap_features: " << params.bootstrap_features << std::endl;
   std::cout << "split_criterion: " << params.split_criterion << std::endl;
   std::cout << "quantile_per_tree: " << params.quantile_per_tree << std::endl;
+  std::cout << "hist_subtraction: " << params.hist_subtraction << std::endl;
 }
 
 /**
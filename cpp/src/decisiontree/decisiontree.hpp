@@ -16,6 +16,7 @@
 
 #pragma once
 #include <common/cumlHandle.hpp>
+#include <vector>
 #include "algo_helper.h"
 
 namespace ML {
@@ -61,6 +62,12 @@ struct DecisionTreeParams {
    * Node split criterion. GINI and Entropy for classification, MSE or MAE for regression.
    */
   CRITERION split_criterion;
+  /**
+   * Whether the GLOBAL_QUANTILE split algorithm derives the histograms of the
+   * larger child of each split as parent - smaller child, instead of building
+   * them from the data. Only meant to be turned off for testing.
+   */
+  bool hist_subtraction;
 };
 
 void set_tree_params(DecisionTreeParams &params, int cfg_max_depth = -1,
@@ -69,7 +76,8 @@ void set_tree_params(DecisionTreeParams &params, int cfg_max_depth = -1,
                      int cfg_min_rows_per_node = 2,
                      bool cfg_bootstrap_features = false,
                      CRITERION cfg_split_criterion = CRITERION_END,
-                     bool cfg_quantile_per_tree = false);
+                     bool cfg_quantile_per_tree = false,
+                     bool cfg_hist_subtraction = true);
 void validity_check(const DecisionTreeParams params);
 void print(const DecisionTreeParams params);
 
@@ -86,6 +94,11 @@ struct TreeNode {
   L prediction;
   Question<T> question;
   T split_metric_val;
+  /**
+   * Class distribution of the (weighted) training rows reaching a leaf,
+   * normalized to sum to one. Empty for internal and regression nodes.
+   */
+  std::vector<float> class_probs;
 };
 
 template <class T, class L>
@@ -142,13 +142,14 @@ void build_treelite_tree(TreeBuilderHandle tree_builder,
           TREELITE_CHECK(TreeliteTreeBuilderSetLeafNode(
             tree_builder, q_node.unique_node_id, q_node.node->prediction));
         } else {
-          std::vector<double> leaf_vector(num_output_group);
-          for (int j = 0; j < num_output_group; j++) {
-            if (q_node.node->prediction == j) {
-              leaf_vector[j] = 1;
-            } else {
-              leaf_vector[j] = 0;
-            }
+          // Leaves carry their class distribution; fall back to a one-hot
+          // vector for trees without one.
+          std::vector<double> leaf_vector(num_output_group, 0.0);
+          const std::vector<float> &probs = q_node.node->class_probs;
+          if (probs.size() == num_output_group) {
+            leaf_vector.assign(probs.begin(), probs.end());
+          } else {
+            leaf_vector[q_node.node->prediction] = 1;
           }
           TREELITE_CHECK(TreeliteTreeBuilderSetLeafVectorNode(
             tree_builder, q_node.unique_node_id, leaf_vector.data(),
@@ -215,7 +216,9 @@ void DecisionTreeBase<T, L>::plant(
   const int n_sampled_rows, int unique_labels, int maxdepth, int max_leaf_nodes,
   const float colper, int n_bins, int split_algo_flag,
   int cfg_min_rows_per_node, bool cfg_bootstrap_features,
-  CRITERION cfg_split_criterion, bool quantile_per_tree,
+  CRITERION cfg_split_criterion, bool quantile_per_tree, uint64_t cfg_seed,
+  int cfg_treeid, const T *cfg_sample_weight, const T *cfg_class_weight,
+  bool cfg_hist_subtraction,
   std::shared_ptr<TemporaryMemory<T, L>> in_tempmem) {
   split_algo = split_algo_flag;
   dinfo.NLocalrows = nrows;
@@ -228,20 +231,37 @@ void DecisionTreeBase<T, L>::plant(
   min_rows_per_node = cfg_min_rows_per_node;
   bootstrap_features = cfg_bootstrap_features;
   split_criterion = cfg_split_criterion;
+  seed = cfg_seed;
+  treeid = cfg_treeid;
+  sample_weight = cfg_sample_weight;
+  class_weight = cfg_class_weight;
+  hist_subtraction = cfg_hist_subtraction;
+  bool weighted = (sample_weight != nullptr) || (class_weight != nullptr);
+  ASSERT(!weighted || split_algo == SPLIT_ALGO::GLOBAL_QUANTILE,
+         "Sample and class weights are only supported by the GLOBAL_QUANTILE "
+         "split algorithm\n");
 
   //Bootstrap features
+  std::seed_seq seeds{(uint32_t)seed, (uint32_t)(seed >> 32),
+                      (uint32_t)treeid};
+  std::mt19937 rng(seeds);
   feature_selector.resize(dinfo.Ncols);
   if (bootstrap_features) {
-    srand(n_bins);
+    std::uniform_int_distribution<unsigned int> coldist(0, dinfo.Ncols - 1);
     for (int i = 0; i < dinfo.Ncols; i++) {
-      feature_selector.push_back(rand() % dinfo.Ncols);
+      feature_selector[i] = coldist(rng);
     }
   } else {
     std::iota(feature_selector.begin(), feature_selector.end(), 0);
   }
 
-  std::random_shuffle(feature_selector.begin(), feature_selector.end());
-  feature_selector.resize((int)(colper * dinfo.Ncols));
+  std::shuffle(feature_selector.begin(), feature_selector.end(), rng);
+  ncols_sampled = std::max(1, (int)(colper * dinfo.Ncols));
+  // The level algorithm draws ncols_sampled columns per node on device;
+  // the other split algorithms use the same columns for the whole tree.
+  if (split_algo != SPLIT_ALGO::GLOBAL_QUANTILE) {
+    feature_selector.resize(ncols_sampled);
+  }
 
   if (split_algo == SPLIT_ALGO::HIST) {
     cudaDeviceProp prop;
@@ -262,9 +282,12 @@ void DecisionTreeBase<T, L>::plant(
 
   if (in_tempmem != nullptr) {
     tempmem = in_tempmem;
+    ASSERT(!weighted || tempmem->weighted,
+           "Temporary memory was not allocated for weighted fit\n");
   } else {
     tempmem = std::make_shared<TemporaryMemory<T, L>>(
-      handle, nrows, ncols, unique_labels, n_bins, split_algo, maxdepth);
+      handle, nrows, ncols, unique_labels, n_bins, split_algo, maxdepth,
+      weighted);
     quantile_per_tree = true;
   }
   if (split_algo == SPLIT_ALGO::GLOBAL_QUANTILE && quantile_per_tree) {
@@ -335,6 +358,7 @@ TreeNode<T, L> *DecisionTreeBase<T, L>::grow_tree(
   if (condition) {
     if (typeid(L) == typeid(int)) {  // classification
       node->prediction = get_class_hist(split_info[0].hist);
+      node->class_probs = get_class_probs(split_info[0].hist);
     } else {  // regression (typeid(L) == typeid(T))
       node->prediction = split_info[0].predict;
     }
@@ -446,7 +470,8 @@ void DecisionTreeBase<T, L>::base_fit(
   const ML::cumlHandle &handle, const T *data, const int ncols, const int nrows,
   const L *labels, unsigned int *rowids, const int n_sampled_rows,
   int unique_labels, TreeNode<T, L> *&root, DecisionTreeParams &tree_params,
-  bool is_classifier, std::shared_ptr<TemporaryMemory<T, L>> in_tempmem) {
+  bool is_classifier, std::shared_ptr<TemporaryMemory<T, L>> in_tempmem,
+  uint64_t seed, int treeid, const T *sample_weight, const T *class_weight) {
   prepare_fit_timer.reset();
   const char *CRITERION_NAME[] = {"GINI", "ENTROPY", "MSE", "MAE", "END"};
   CRITERION default_criterion =
@@ -477,7 +502,8 @@ void DecisionTreeBase<T, L>::base_fit(
         tree_params.max_leaves, tree_params.max_features, tree_params.n_bins,
         tree_params.split_algo, tree_params.min_rows_per_node,
         tree_params.bootstrap_features, tree_params.split_criterion,
-        tree_params.quantile_per_tree, in_tempmem);
+        tree_params.quantile_per_tree, seed, treeid, sample_weight,
+        class_weight, tree_params.hist_subtraction, in_tempmem);
 }
 
 template <typename T>
@@ -486,9 +512,11 @@ void DecisionTreeClassifier<T>::fit(
   const int *labels, unsigned int *rowids, const int n_sampled_rows,
   const int unique_labels, TreeMetaDataNode<T, int> *&tree,
   DecisionTreeParams tree_params,
-  std::shared_ptr<TemporaryMemory<T, int>> in_tempmem) {
+  std::shared_ptr<TemporaryMemory<T, int>> in_tempmem, uint64_t seed,
+  int treeid, const T *sample_weight, const T *class_weight) {
   this->base_fit(handle, data, ncols, nrows, labels, rowids, n_sampled_rows,
-                 unique_labels, tree->root, tree_params, true, in_tempmem);
+                 unique_labels, tree->root, tree_params, true, in_tempmem, seed,
+                 treeid, sample_weight, class_weight);
   this->set_metadata(tree);
 }
 
@@ -537,9 +565,11 @@ void DecisionTreeRegressor<T>::fit(
   const ML::cumlHandle &handle, const T *data, const int ncols, const int nrows,
   const T *labels, unsigned int *rowids, const int n_sampled_rows,
   TreeMetaDataNode<T, T> *&tree, DecisionTreeParams tree_params,
-  std::shared_ptr<TemporaryMemory<T, T>> in_tempmem) {
+  std::shared_ptr<TemporaryMemory<T, T>> in_tempmem, uint64_t seed,
+  int treeid, const T *sample_weight) {
   this->base_fit(handle, data, ncols, nrows, labels, rowids, n_sampled_rows, 1,
-                 tree->root, tree_params, false, in_tempmem);
+                 tree->root, tree_params, false, in_tempmem, seed, treeid,
+                 sample_weight, nullptr);
   this->set_metadata(tree);
 }
 
@@ -591,10 +621,11 @@ TreeNode<T, int> *DecisionTreeClassifier<T>::grow_deep_tree(
   int leaf_cnt = 0;
   int depth_cnt = 0;
   TreeNode<T, int> *root = grow_deep_tree_classification(
-    data, labels, rowids, feature_selector, n_sampled_rows, nrows,
-    this->n_unique_labels, this->nbins, this->treedepth, this->maxleaves,
-    this->min_rows_per_node, this->split_criterion, depth_cnt, leaf_cnt,
-    tempmem);
+    data, labels, rowids, this->sample_weight, this->class_weight,
+    feature_selector, this->ncols_sampled, this->seed, this->treeid,
+    this->hist_subtraction, n_sampled_rows, nrows, this->n_unique_labels,
+    this->nbins, this->treedepth, this->maxleaves, this->min_rows_per_node,
+    this->split_criterion, depth_cnt, leaf_cnt, tempmem);
   this->depth_counter = depth_cnt;
   this->leaf_counter = leaf_cnt;
   return root;
@@ -609,9 +640,11 @@ TreeNode<T, T> *DecisionTreeRegressor<T>::grow_deep_tree(
   int leaf_cnt = 0;
   int depth_cnt = 0;
   TreeNode<T, T> *root = grow_deep_tree_regression(
-    data, labels, rowids, feature_selector, n_sampled_rows, nrows, this->nbins,
-    this->treedepth, this->maxleaves, this->min_rows_per_node,
-    this->split_criterion, depth_cnt, leaf_cnt, tempmem);
+    data, labels, rowids, this->sample_weight, feature_selector,
+    this->ncols_sampled, this->seed, this->treeid, this->hist_subtraction,
+    n_sampled_rows, nrows, this->nbins, this->treedepth, this->maxleaves,
+    this->min_rows_per_node, this->split_criterion, depth_cnt, leaf_cnt,
+    tempmem);
   this->depth_counter = depth_cnt;
   this->leaf_counter = leaf_cnt;
   return root;
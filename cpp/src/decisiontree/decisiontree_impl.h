@@ -23,6 +23,7 @@
 #include <common/cumlHandle.hpp>
 #include <map>
 #include <numeric>
+#include <random>
 #include <vector>
 #include "algo_helper.h"
 #include "decisiontree.hpp"
@@ -85,6 +86,13 @@ class DecisionTreeBase {
   bool bootstrap_features;
   CRITERION split_criterion;
   std::vector<unsigned int> feature_selector;
+  int ncols_sampled;  // columns considered per node by the level algorithm
+  uint64_t seed = 0;
+  int treeid = 0;
+  bool hist_subtraction = true;  // used by the level algorithm only
+  // Optional device weights; used by the level algorithm only.
+  const T *sample_weight = nullptr;
+  const T *class_weight = nullptr;
   MLCommon::TimerCPU prepare_fit_timer;
 
   void split_branch(const T *data, MetricQuestion<T> &ques,
@@ -99,7 +107,10 @@ class DecisionTreeBase {
              int split_algo_flag = SPLIT_ALGO::GLOBAL_QUANTILE,
              int cfg_min_rows_per_node = 2, bool cfg_bootstrap_features = false,
              CRITERION cfg_split_criterion = CRITERION::CRITERION_END,
-             bool cfg_quantile_per_tree = false,
+             bool cfg_quantile_per_tree = false, uint64_t cfg_seed = 0,
+             int cfg_treeid = 0, const T *cfg_sample_weight = nullptr,
+             const T *cfg_class_weight = nullptr,
+             bool cfg_hist_subtraction = true,
              std::shared_ptr<TemporaryMemory<T, L>> in_tempmem = nullptr);
   void init_depth_zero(const L *labels, std::vector<unsigned int> &colselector,
                        const unsigned int *rowids, const int n_sampled_rows,
@@ -125,7 +136,9 @@ class DecisionTreeBase {
                 const int n_sampled_rows, int unique_labels,
                 TreeNode<T, L> *&root, DecisionTreeParams &tree_params,
                 bool is_classifier,
-                std::shared_ptr<TemporaryMemory<T, L>> in_tempmem);
+                std::shared_ptr<TemporaryMemory<T, L>> in_tempmem,
+                uint64_t seed, int treeid, const T *sample_weight,
+                const T *class_weight);
 
  public:
   // Printing utility for high level tree info.
@@ -154,11 +167,14 @@ class DecisionTreeClassifier : public DecisionTreeBase<T, int> {
   // Expects column major T dataset, integer labels
   // data, labels are both device ptr.
   // Assumption: labels are all mapped to contiguous numbers starting from 0 during preprocessing. Needed for gini hist impl.
+  // sample_weight (nrows) and class_weight (unique_labels) are optional device ptrs.
   void fit(const ML::cumlHandle &handle, const T *data, const int ncols,
            const int nrows, const int *labels, unsigned int *rowids,
            const int n_sampled_rows, const int unique_labels,
            TreeMetaDataNode<T, int> *&tree, DecisionTreeParams tree_params,
-           std::shared_ptr<TemporaryMemory<T, int>> in_tempmem = nullptr);
+           std::shared_ptr<TemporaryMemory<T, int>> in_tempmem = nullptr,
+           uint64_t seed = 0, int treeid = 0,
+           const T *sample_weight = nullptr, const T *class_weight = nullptr);
 
  private:
   /* depth is used to distinguish between root and other tree nodes for computations */
@@ -181,7 +197,9 @@ class DecisionTreeRegressor : public DecisionTreeBase<T, T> {
            const int nrows, const T *labels, unsigned int *rowids,
            const int n_sampled_rows, TreeMetaDataNode<T, T> *&tree,
            DecisionTreeParams tree_params,
-           std::shared_ptr<TemporaryMemory<T, T>> in_tempmem = nullptr);
+           std::shared_ptr<TemporaryMemory<T, T>> in_tempmem = nullptr,
+           uint64_t seed = 0, int treeid = 0,
+           const T *sample_weight = nullptr);
 
  private:
   /* depth is used to distinguish between root and other tree nodes for computations */
@@ -69,6 +69,26 @@ float EntropyFunctor::exec(std::vector<int> &hist, int nrows) {
   return (-1 * eval);
 }
 
+float GiniFunctor::exec(std::vector<float> &hist, float nrows) {
+  float gval = 1.0;
+  for (int i = 0; i < hist.size(); i++) {
+    float prob = hist[i] / nrows;
+    gval -= prob * prob;
+  }
+  return gval;
+}
+
+float EntropyFunctor::exec(std::vector<float> &hist, float nrows) {
+  float eval = 0.0;
+  for (int i = 0; i < hist.size(); i++) {
+    if (hist[i] > 0.0f) {
+      float prob = hist[i] / nrows;
+      eval += prob * logf(prob);
+    }
+  }
+  return (-1 * eval);
+}
+
 __global__ void gini_kernel(const int *__restrict__ labels, const int nrows,
                             const int nmax, int *histout) {
   int tid = threadIdx.x + blockIdx.x * blockDim.x;
@@ -67,10 +67,12 @@ struct AbsFunctor {
 
 struct GiniFunctor {
   static float exec(std::vector<int>& hist, int nrows);
+  static float exec(std::vector<float>& hist, float nrows);
   static float max_val(int nclass);
 };
 
 struct EntropyFunctor {
   static float exec(std::vector<int>& hist, int nrows);
+  static float exec(std::vector<float>& hist, float nrows);
   static float max_val(int nclass);
 };
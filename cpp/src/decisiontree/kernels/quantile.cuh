@@ -15,10 +15,17 @@
  */
 
 #pragma once
+#include <common/cuml_comms_int.hpp>
+#include <algorithm>
+#include <numeric>
 #include "col_condenser.cuh"
 #include "cub/cub.cuh"
 #include "quantile.h"
 
+/* Per rank sketch resolution, in cut points per final bin, used when merging
+   quantiles across ranks. */
+#define QUANTILE_SKETCH_OVERSAMPLE 8
+
 __global__ void set_sorting_offset(const int nrows, const int ncols,
                                    int *offsets) {
   int tid = threadIdx.x + blockIdx.x * blockDim.x;
@@ -40,16 +47,26 @@ __global__ void get_all_quantiles(const T *__restrict__ data, T *quantile,
   return;
 }
 
-template <typename T, typename L>
-void preprocess_quantile(const T *data, const unsigned int *rowids,
-                         const int n_sampled_rows, const int ncols,
-                         const int rowoffset, const int nbins,
-                         std::shared_ptr<TemporaryMemory<T, L>> tempmem) {
+/**
+ * @brief Compute nbins quantile cut points per column, as the sorted values at
+ *   every (nrows / nbins)-th position. The last cut point is the column max.
+ * @param[in] d_keys_in: column major data (nrows x ncols). Device pointer.
+ * @param[in] nrows: number of rows; must be at least nbins.
+ * @param[in] ncols: number of columns.
+ * @param[in] nbins: number of cut points per column.
+ * @param[out] d_quantile: nbins cut points per column. Device pointer.
+ * @param[in] handle: cuML handle providing the device allocator.
+ * @param[in] stream: cuda stream.
+ */
+template <typename T>
+void compute_quantiles(const T *d_keys_in, const int nrows, const int ncols,
+                       const int nbins, T *d_quantile,
+                       const ML::cumlHandle_impl &handle, cudaStream_t stream) {
   /*
 	// Dynamically determine batch_cols (number of columns processed per loop iteration) from the available device memory.
 	size_t free_mem, total_mem;
 	CUDA_CHECK(cudaMemGetInfo(&free_mem, &total_mem));
-	int max_ncols = free_mem / (2 * n_sampled_rows * sizeof(T));
+	int max_ncols = free_mem / (2 * nrows * sizeof(T));
 	int batch_cols = (max_ncols > ncols) ? ncols : max_ncols;
 	ASSERT(max_ncols != 0, "Cannot preprocess quantiles due to insufficient device memory.");
 	*/
@@ -59,27 +76,14 @@ void preprocess_quantile(const T *data, const unsigned int *rowids,
   int threads = 128;
   MLCommon::device_buffer<int> *d_offsets;
   MLCommon::device_buffer<T> *d_keys_out;
-  const T *d_keys_in;
   int blocks;
-  if (tempmem->temp_data != nullptr) {
-    T *d_keys_out = tempmem->temp_data->data();
-    unsigned int *colids = nullptr;
-    blocks = MLCommon::ceildiv(ncols * n_sampled_rows, threads);
-    allcolsampler_kernel<<<blocks, threads, 0, tempmem->stream>>>(
-      data, rowids, colids, n_sampled_rows, ncols, rowoffset,
-      d_keys_out);  // d_keys_in already allocated for all ncols
-    CUDA_CHECK(cudaGetLastError());
-    d_keys_in = d_keys_out;
-  } else {
-    d_keys_in = data;
-  }
 
-  d_offsets = new MLCommon::device_buffer<int>(
-    tempmem->ml_handle.getDeviceAllocator(), tempmem->stream, batch_cols + 1);
+  d_offsets = new MLCommon::device_buffer<int>(handle.getDeviceAllocator(),
+                                               stream, batch_cols + 1);
 
   blocks = MLCommon::ceildiv(batch_cols + 1, threads);
-  set_sorting_offset<<<blocks, threads, 0, tempmem->stream>>>(
-    n_sampled_rows, batch_cols, d_offsets->data());
+  set_sorting_offset<<<blocks, threads, 0, stream>>>(nrows, batch_cols,
+                                                     d_offsets->data());
   CUDA_CHECK(cudaGetLastError());
 
   // Determine temporary device storage requirements
@@ -91,19 +95,18 @@ void preprocess_quantile(const T *data, const unsigned int *rowids,
   int last_batch_size =
     ncols - batch_cols * (batch_cnt - 1);  // number of columns in last batch
   int batch_items =
-    n_sampled_rows * batch_cols;  // used to determine d_temp_storage size
+    nrows * batch_cols;  // used to determine d_temp_storage size
 
-  d_keys_out = new MLCommon::device_buffer<T>(
-    tempmem->ml_handle.getDeviceAllocator(), tempmem->stream, batch_items);
+  d_keys_out = new MLCommon::device_buffer<T>(handle.getDeviceAllocator(),
+                                              stream, batch_items);
   CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortKeys(
     d_temp_storage, temp_storage_bytes, d_keys_in, d_keys_out->data(),
     batch_items, batch_cols, d_offsets->data(), d_offsets->data() + 1, 0,
-    8 * sizeof(T), tempmem->stream));
+    8 * sizeof(T), stream));
 
   // Allocate temporary storage
-  d_temp_storage =
-    new MLCommon::device_buffer<char>(tempmem->ml_handle.getDeviceAllocator(),
-                                      tempmem->stream, temp_storage_bytes);
+  d_temp_storage = new MLCommon::device_buffer<char>(
+    handle.getDeviceAllocator(), stream, temp_storage_bytes);
 
   // Compute quantiles for cur_batch_cols columns per loop iteration.
   for (int batch = 0; batch < batch_cnt; batch++) {
@@ -111,32 +114,139 @@ void preprocess_quantile(const T *data, const unsigned int *rowids,
                            ? last_batch_size
                            : batch_cols;  // properly handle the last batch
 
-    int batch_offset = batch * n_sampled_rows * batch_cols;
+    int batch_offset = batch * nrows * batch_cols;
     int quantile_offset = batch * nbins * batch_cols;
 
     // Run sorting operation
     CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortKeys(
       (void *)d_temp_storage->data(), temp_storage_bytes,
-      &d_keys_in[batch_offset], d_keys_out->data(), n_sampled_rows * batch_cols,
+      &d_keys_in[batch_offset], d_keys_out->data(), nrows * batch_cols,
       cur_batch_cols, d_offsets->data(), d_offsets->data() + 1, 0,
-      8 * sizeof(T), tempmem->stream));
+      8 * sizeof(T), stream));
 
     blocks = MLCommon::ceildiv(cur_batch_cols * nbins, threads);
-    get_all_quantiles<<<blocks, threads, 0, tempmem->stream>>>(
-      d_keys_out->data(), &tempmem->d_quantile->data()[quantile_offset],
-      n_sampled_rows, cur_batch_cols, nbins);
+    get_all_quantiles<<<blocks, threads, 0, stream>>>(
+      d_keys_out->data(), &d_quantile[quantile_offset], nrows, cur_batch_cols,
+      nbins);
 
     CUDA_CHECK(cudaGetLastError());
-    CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
+    CUDA_CHECK(cudaStreamSynchronize(stream));
   }
-  MLCommon::updateHost(tempmem->h_quantile->data(), tempmem->d_quantile->data(),
-                       nbins * ncols, tempmem->stream);
-  d_keys_out->release(tempmem->stream);
-  d_offsets->release(tempmem->stream);
-  d_temp_storage->release(tempmem->stream);
+  d_keys_out->release(stream);
+  d_offsets->release(stream);
+  d_temp_storage->release(stream);
   delete d_keys_out;
   delete d_offsets;
   delete d_temp_storage;
+}
+
+template <typename T, typename L>
+void preprocess_quantile(const T *data, const unsigned int *rowids,
+                         const int n_sampled_rows, const int ncols,
+                         const int rowoffset, const int nbins,
+                         std::shared_ptr<TemporaryMemory<T, L>> tempmem) {
+  int threads = 128;
+  const T *d_keys_in;
+  int blocks;
+  if (tempmem->temp_data != nullptr) {
+    T *d_keys_out = tempmem->temp_data->data();
+    unsigned int *colids = nullptr;
+    blocks = MLCommon::ceildiv(ncols * n_sampled_rows, threads);
+    allcolsampler_kernel<<<blocks, threads, 0, tempmem->stream>>>(
+      data, rowids, colids, n_sampled_rows, ncols, rowoffset,
+      d_keys_out);  // d_keys_in already allocated for all ncols
+    CUDA_CHECK(cudaGetLastError());
+    d_keys_in = d_keys_out;
+  } else {
+    d_keys_in = data;
+  }
+
+  compute_quantiles(d_keys_in, n_sampled_rows, ncols, nbins,
+                    tempmem->d_quantile->data(), tempmem->ml_handle,
+                    tempmem->stream);
+  MLCommon::updateHost(tempmem->h_quantile->data(), tempmem->d_quantile->data(),
+                       nbins * ncols, tempmem->stream);
 
   return;
 }
+
+/**
+ * @brief Compute quantile cut points that are identical on all the ranks of
+ *   the handle's communicator, for data whose rows are partitioned across
+ *   ranks. Every rank sorts its local rows into a sketch of
+ *   nbins * QUANTILE_SKETCH_OVERSAMPLE cut points per column; the sketches
+ *   are allgathered and merged with each point weighted by the number of
+ *   local rows it stands for.
+ * @param[in] data: local column major data (n_local_rows x ncols). Device pointer.
+ * @param[in] n_local_rows: number of rows on this rank.
+ * @param[in] ncols: number of columns.
+ * @param[in] nbins: number of cut points per column.
+ * @param[in,out] tempmem: d_quantile and h_quantile receive the global cut points.
+ */
+template <typename T, typename L>
+void preprocess_quantile_mg(const T *data, const int n_local_rows,
+                            const int ncols, const int nbins,
+                            std::shared_ptr<TemporaryMemory<T, L>> tempmem) {
+  const ML::cumlHandle_impl &handle = tempmem->ml_handle;
+  const MLCommon::cumlCommunicator &comm = handle.getCommunicator();
+  cudaStream_t stream = tempmem->stream;
+  int nranks = comm.getSize();
+
+  // Sketch size has to agree across ranks for the allgather
+  MLCommon::device_buffer<int> d_rows(handle.getDeviceAllocator(), stream,
+                                      nranks + 1);
+  MLCommon::updateDevice(d_rows.data() + nranks, &n_local_rows, 1, stream);
+  comm.allgather(d_rows.data() + nranks, d_rows.data(), 1, stream);
+  std::vector<int> h_rows(nranks);
+  MLCommon::updateHost(h_rows.data(), d_rows.data(), nranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int min_rows = *std::min_element(h_rows.begin(), h_rows.end());
+  ASSERT(min_rows >= nbins,
+         "Every rank needs at least n_bins = %d rows, got %d", nbins,
+         min_rows);
+  int sketch = std::min(nbins * QUANTILE_SKETCH_OVERSAMPLE, min_rows);
+
+  MLCommon::device_buffer<T> d_sketch(handle.getDeviceAllocator(), stream,
+                                      sketch * ncols * (nranks + 1));
+  T *d_local_sketch = d_sketch.data() + sketch * ncols * nranks;
+  compute_quantiles(data, n_local_rows, ncols, sketch, d_local_sketch, handle,
+                    stream);
+  comm.allgather(d_local_sketch, d_sketch.data(), sketch * ncols, stream);
+  std::vector<T> h_sketch(sketch * ncols * nranks);
+  MLCommon::updateHost(h_sketch.data(), d_sketch.data(), h_sketch.size(),
+                       stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  d_rows.release(stream);
+  d_sketch.release(stream);
+
+  // Weighted merge; identical on every rank as all inputs are identical
+  double total_rows = std::accumulate(h_rows.begin(), h_rows.end(), 0.0);
+  std::vector<std::pair<T, double>> points(sketch * nranks);
+  T *h_quantile = tempmem->h_quantile->data();
+  for (int col = 0; col < ncols; col++) {
+    for (int r = 0; r < nranks; r++) {
+      double weight = (double)h_rows[r] / sketch;
+      for (int i = 0; i < sketch; i++) {
+        T value = h_sketch[(r * ncols + col) * sketch + i];
+        points[r * sketch + i] = std::make_pair(value, weight);
+      }
+    }
+    std::sort(points.begin(), points.end());
+    double cumulative = 0.0;
+    int bin = 0;
+    for (int i = 0; i < points.size() && bin < nbins; i++) {
+      cumulative += points[i].second;
+      while (bin < nbins && cumulative >= (bin + 1) * total_rows / nbins) {
+        h_quantile[col * nbins + bin] = points[i].first;
+        bin++;
+      }
+    }
+    // Guard against rounding in the cumulative sum: last bin is the max
+    for (; bin < nbins; bin++) {
+      h_quantile[col * nbins + bin] = points.back().first;
+    }
+  }
+  MLCommon::updateDevice(tempmem->d_quantile->data(), h_quantile,
+                         nbins * ncols, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
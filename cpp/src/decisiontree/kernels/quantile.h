@@ -21,3 +21,8 @@ void preprocess_quantile(const T *data, const unsigned int *rowids,
                          const int n_sampled_rows, const int ncols,
                          const int rowoffset, const int nbins,
                          std::shared_ptr<TemporaryMemory<T, L>> tempmem);
+
+template <typename T, typename L>
+void preprocess_quantile_mg(const T *data, const int n_local_rows,
+                            const int ncols, const int nbins,
+                            std::shared_ptr<TemporaryMemory<T, L>> tempmem);
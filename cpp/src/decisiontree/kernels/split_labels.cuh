@@ -17,6 +17,7 @@
 #pragma once
 #include <utils.h>
 #include <algorithm>
+#include <numeric>
 #include "../algo_helper.h"
 #include "cub/cub.cuh"
 #include "metric.cuh"
@@ -71,14 +72,27 @@ __global__ void flag_kernel_quantile(T* column, char* leftflag, char* rightflag,
   return;
 }
 
-/* node_hist[i] holds the # times label i appear in current data. The vector is computed during gini
-   computation. */
-int get_class_hist(std::vector<int>& node_hist) {
+/* node_hist[i] holds the # times label i appear in current data (or their total weight when
+   fitting with weights). The vector is computed during gini computation. */
+template <typename V>
+int get_class_hist(std::vector<V>& node_hist) {
   int classval =
     std::max_element(node_hist.begin(), node_hist.end()) - node_hist.begin();
   return classval;
 }
 
+/* Normalizes a leaf's class histogram (counts or weights) into the class
+   distribution stored in the tree for probability outputs. */
+template <typename V>
+std::vector<float> get_class_probs(const std::vector<V>& node_hist) {
+  std::vector<float> probs(node_hist.begin(), node_hist.end());
+  float total = std::accumulate(probs.begin(), probs.end(), 0.0f);
+  if (total > 0.0f) {
+    for (int i = 0; i < probs.size(); i++) probs[i] /= total;
+  }
+  return probs;
+}
+
 template <typename T, typename L>
 void make_split(T* column, MetricQuestion<T>& ques, const int nrows,
                 int& nrowsleft, int& nrowsright, unsigned int* rowids,
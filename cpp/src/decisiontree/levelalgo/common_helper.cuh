@@ -32,6 +32,17 @@ void setup_sampling(unsigned int *flagsptr, unsigned int *sample_cnt,
   CUDA_CHECK(cudaGetLastError());
 }
 
+template <typename T>
+void setup_weights(const unsigned int *sample_cnt, const int *class_labels,
+                   const T *sample_weight, const T *class_weight,
+                   const int nrows, T *weights, cudaStream_t &stream) {
+  int threads = 256;
+  int blocks = MLCommon::ceildiv(nrows, threads);
+  setup_weights_kernel<<<blocks, threads, 0, stream>>>(
+    sample_cnt, class_labels, sample_weight, class_weight, nrows, weights);
+  CUDA_CHECK(cudaGetLastError());
+}
+
 //This function call the split kernel
 template <typename T, typename L>
 void make_level_split(const T *data, const int nrows, const int ncols,
@@ -47,6 +58,60 @@ void make_level_split(const T *data, const int nrows, const int ncols,
   CUDA_CHECK(cudaGetLastError());
 }
 
+// Histogram subtraction setup for the two children of a node being split.
+// Children of the pair_id-th split node get node ids 2 * pair_id and
+// 2 * pair_id + 1 at next level. Only the child with fewer samples is built
+// from the data; the other is derived from the parent histogram.
+inline void setup_subtraction_pair(int *derive_from,
+                                   const unsigned int pair_id,
+                                   const int parent_id,
+                                   const unsigned int left_cnt,
+                                   const unsigned int right_cnt) {
+  if (left_cnt <= right_cnt) {
+    derive_from[2 * pair_id] = -1;
+    derive_from[2 * pair_id + 1] = parent_id;
+  } else {
+    derive_from[2 * pair_id] = parent_id;
+    derive_from[2 * pair_id + 1] = -1;
+  }
+}
+
+//This function calls the histogram subtraction kernel
+template <typename V>
+void subtract_histograms(const V *parent_hist, const int *derive_from,
+                         const unsigned char *colflags, const int ncols,
+                         const int n_nodes, const int n_parent_nodes,
+                         const int nodesz, V *hist, cudaStream_t &stream) {
+  int threads = 256;
+  int blocks = MLCommon::ceildiv(ncols * n_nodes * nodesz, threads);
+  subtract_hist_kernel<<<blocks, threads, 0, stream>>>(
+    parent_hist, derive_from, colflags, ncols, n_nodes, n_parent_nodes, nodesz,
+    hist);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+// Draws the per node column sample of the current level on device and, below
+// the root, marks which sampled columns can use histogram subtraction.
+inline void sample_level_columns(const int *nodeids, const int *derive_from,
+                                 const unsigned char *parent_colflags,
+                                 const int n_nodes, const int ncols,
+                                 const int ncols_sampled, const uint64_t seed,
+                                 const int treeid, unsigned char *colflags,
+                                 cudaStream_t &stream) {
+  int threads = 128;
+  int blocks = MLCommon::ceildiv(n_nodes, threads);
+  sample_columns_kernel<<<blocks, threads, 0, stream>>>(
+    nodeids, n_nodes, ncols, ncols_sampled, seed, treeid, colflags);
+  CUDA_CHECK(cudaGetLastError());
+  if (derive_from != nullptr) {
+    threads = 256;
+    blocks = MLCommon::ceildiv(n_nodes * ncols, threads);
+    derive_colflags_kernel<<<blocks, threads, 0, stream>>>(
+      derive_from, parent_colflags, n_nodes, ncols, colflags);
+    CUDA_CHECK(cudaGetLastError());
+  }
+}
+
 // Converts flat sparse tree generated to recursive format.
 template <typename T, typename L>
 ML::DecisionTree::TreeNode<T, L> *go_recursive_sparse(
@@ -58,6 +123,7 @@ ML::DecisionTree::TreeNode<T, L> *go_recursive_sparse(
   node->question.value = sparsetree[idx].quesval;
   node->prediction = sparsetree[idx].prediction;
   if (sparsetree[idx].colid == -1) {
+    node->class_probs.swap(sparsetree[idx].class_probs);
     return node;
   }
   node->left = go_recursive_sparse(sparsetree, sparsetree[idx].left_child_id);
@@ -15,8 +15,13 @@
  */
 #pragma once
 #include "cuda_utils.h"
+#include "random/rng_impl.h"
 #define LEAF 0xFFFFFFFF
 #define PUSHRIGHT 0x00000001
+//Per node column flags used with per node feature subsampling
+#define COLSKIP 0x00
+#define COLBUILD 0x01
+#define COLDERIVE 0x02
 //Setup how many times a sample is being used.
 //This is due to bootstrap nature of Random Forest.
 __global__ void setup_counts_kernel(unsigned int* sample_cnt,
@@ -40,6 +45,22 @@ __global__ void setup_flags_kernel(const unsigned int* __restrict__ sample_cnt,
     flags[tid] = local_flag;
   }
 }
+//Per row weight: bootstrap count times sample weight and class weight.
+//class_labels and class_weight are nullptr for regression.
+template <typename T>
+__global__ void setup_weights_kernel(
+  const unsigned int* __restrict__ sample_cnt,
+  const int* __restrict__ class_labels, const T* __restrict__ sample_weight,
+  const T* __restrict__ class_weight, const int nrows, T* weights) {
+  int threadid = threadIdx.x + blockIdx.x * blockDim.x;
+  for (int tid = threadid; tid < nrows; tid += blockDim.x * gridDim.x) {
+    T local_weight = (T)sample_cnt[tid];
+    if (sample_weight != nullptr) local_weight *= sample_weight[tid];
+    if (class_weight != nullptr)
+      local_weight *= class_weight[class_labels[tid]];
+    weights[tid] = local_weight;
+  }
+}
 
 // This make actual split. A split is done using bits.
 //Least significant Bit 0 means left and 1 means right.
@@ -78,6 +99,88 @@ __global__ void split_level_kernel(
   }
 }
 
+// Histogram subtraction: a node whose derive_from entry is a valid parent id
+// gets its histogram as parent - sibling. Siblings are stored next to each
+// other (node ids 2k, 2k + 1), so the sibling of nodeid is nodeid ^ 1.
+// nodesz is the number of histogram elements per node and column.
+// With per node column sampling, only the columns flagged COLDERIVE are
+// subtracted.
+template <typename V>
+__global__ void subtract_hist_kernel(const V* __restrict__ parent_hist,
+                                     const int* __restrict__ derive_from,
+                                     const unsigned char* __restrict__ colflags,
+                                     const int ncols, const int n_nodes,
+                                     const int n_parent_nodes, const int nodesz,
+                                     V* hist) {
+  unsigned int threadid = threadIdx.x + blockIdx.x * blockDim.x;
+  unsigned int colsz = n_nodes * nodesz;
+  for (unsigned int tid = threadid; tid < ncols * colsz;
+       tid += gridDim.x * blockDim.x) {
+    unsigned int colcnt = tid / colsz;
+    unsigned int nodeid = (tid % colsz) / nodesz;
+    unsigned int binoff = tid % nodesz;
+    int parentid = derive_from[nodeid];
+    bool derive = (colflags == nullptr)
+                    ? (parentid != -1)
+                    : (colflags[nodeid * ncols + colcnt] == COLDERIVE);
+    if (derive) {
+      V parent_val =
+        parent_hist[colcnt * n_parent_nodes * nodesz + parentid * nodesz +
+                    binoff];
+      V sibling_val = hist[colcnt * colsz + (nodeid ^ 1) * nodesz + binoff];
+      hist[tid] = parent_val - sibling_val;
+    }
+  }
+}
+
+// Draws the columns considered by every node at the current level. Each node
+// uses its own Philox subsequence keyed by (treeid, nodeid), nodeid being the
+// node position in the sparse tree, so that the selection is reproducible for a
+// given seed. Floyd's algorithm picks exactly ncols_sampled distinct columns.
+__global__ void sample_columns_kernel(const int* __restrict__ nodeids,
+                                      const int n_nodes, const int ncols,
+                                      const int ncols_sampled,
+                                      const uint64_t seed, const int treeid,
+                                      unsigned char* colflags) {
+  int nodeid = threadIdx.x + blockIdx.x * blockDim.x;
+  if (nodeid >= n_nodes) return;
+  unsigned char* nodeflags = &colflags[nodeid * ncols];
+  for (int colcnt = 0; colcnt < ncols; colcnt++) {
+    nodeflags[colcnt] = COLSKIP;
+  }
+  uint64_t subsequence =
+    ((uint64_t)treeid << 32) | (unsigned int)nodeids[nodeid];
+  MLCommon::Random::detail::PhiloxGenerator gen(seed, subsequence, 0);
+  for (int j = ncols - ncols_sampled; j < ncols; j++) {
+    uint32_t val;
+    gen.next(val);
+    int colcnt = val % (j + 1);
+    if (nodeflags[colcnt] != COLSKIP) colcnt = j;
+    nodeflags[colcnt] = COLBUILD;
+  }
+}
+
+// A sampled column of a derived node can be subtracted only when both the
+// parent and the sibling histograms have it; otherwise it is built from data.
+// Siblings are never derived, so their flags are not modified here.
+__global__ void derive_colflags_kernel(
+  const int* __restrict__ derive_from,
+  const unsigned char* __restrict__ parent_colflags, const int n_nodes,
+  const int ncols, unsigned char* colflags) {
+  int threadid = threadIdx.x + blockIdx.x * blockDim.x;
+  for (int tid = threadid; tid < n_nodes * ncols;
+       tid += gridDim.x * blockDim.x) {
+    int nodeid = tid / ncols;
+    int colcnt = tid % ncols;
+    int parentid = derive_from[nodeid];
+    if (parentid != -1 && colflags[tid] == COLBUILD &&
+        parent_colflags[parentid * ncols + colcnt] != COLSKIP &&
+        colflags[(nodeid ^ 1) * ncols + colcnt] == COLBUILD) {
+      colflags[tid] = COLDERIVE;
+    }
+  }
+}
+
 struct GainIdxPair {
   float gain;
   int idx;
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #pragma once
+#include <vector>
 /* sparse node same tree node in Decsion Tree.
 * This however used an index instead of pointer to left child
 * Right child index is left_child_id + 1
@@ -25,4 +26,5 @@ struct SparseTreeNode {
   T quesval;
   T best_metric_val;
   int left_child_id = -1;
+  std::vector<float> class_probs;
 };
@@ -26,7 +26,13 @@
 This is the driver function for building classification tree 
 level by level using a simple for loop.
 At each level; following steps are involved.
-1. Compute histograms for all nodes, all cols and all bins.
+0. If max_features < 1, draw the columns considered by each node.
+   With sample or class weights, per row weights are set up once and
+   weighted histograms are built next to the row counts.
+1. Compute histograms for all nodes, all cols and all bins. Below the root,
+   only the smaller child of each split is built from the data; its sibling
+   is derived as parent - child from the previous level histograms, unless
+   hist_subtraction is off.
 2. Find best split col and bin for each node.
 3. Check info gain and then leaf out nodes as needed.
 4. make split.
@@ -34,11 +40,13 @@ At each level; following steps are involved.
 template <typename T>
 ML::DecisionTree::TreeNode<T, int>* grow_deep_tree_classification(
   const T* data, const int* labels, unsigned int* rowids,
-  const std::vector<unsigned int>& feature_selector, int n_sampled_rows,
-  const int nrows, const int n_unique_labels, const int nbins,
-  const int maxdepth, const int maxleaves, const int min_rows_per_node,
-  const ML::CRITERION split_cr, int& depth_cnt, int& leaf_cnt,
-  std::shared_ptr<TemporaryMemory<T, int>> tempmem) {
+  const T* sample_weight, const T* class_weight,
+  const std::vector<unsigned int>& feature_selector, const int ncols_sampled,
+  const uint64_t seed, const int treeid, const bool hist_subtraction,
+  int n_sampled_rows, const int nrows, const int n_unique_labels,
+  const int nbins, const int maxdepth, const int maxleaves,
+  const int min_rows_per_node, const ML::CRITERION split_cr, int& depth_cnt,
+  int& leaf_cnt, std::shared_ptr<TemporaryMemory<T, int>> tempmem) {
   const int ncols = feature_selector.size();
   MLCommon::updateDevice(tempmem->d_colids->data(), feature_selector.data(),
                          feature_selector.size(), tempmem->stream);
@@ -47,22 +55,33 @@ ML::DecisionTree::TreeNode<T, int>* grow_deep_tree_classification(
   unsigned int* sample_cnt = tempmem->d_sample_cnt->data();
   setup_sampling(flagsptr, sample_cnt, rowids, nrows, n_sampled_rows,
                  tempmem->stream);
+  if (tempmem->weighted) {
+    setup_weights(sample_cnt, labels, sample_weight, class_weight, nrows,
+                  tempmem->d_sample_weight->data(), tempmem->stream);
+  }
   std::vector<int> histvec(n_unique_labels, 0);
+  std::vector<float> whistvec;
   T initial_metric;
   if (split_cr == ML::CRITERION::GINI) {
-    initial_metric_classification<T, GiniFunctor>(labels, sample_cnt, nrows,
-                                                  n_unique_labels, histvec,
-                                                  initial_metric, tempmem);
+    initial_metric_classification<T, GiniFunctor>(
+      labels, sample_cnt, nrows, n_unique_labels, histvec, whistvec,
+      initial_metric, tempmem);
   } else {
-    initial_metric_classification<T, EntropyFunctor>(labels, sample_cnt, nrows,
-                                                     n_unique_labels, histvec,
-                                                     initial_metric, tempmem);
+    initial_metric_classification<T, EntropyFunctor>(
+      labels, sample_cnt, nrows, n_unique_labels, histvec, whistvec,
+      initial_metric, tempmem);
   }
   size_t total_nodes = pow(2, (maxdepth + 1)) - 1;
 
   std::vector<std::vector<int>> sparse_histstate;
   sparse_histstate.resize(total_nodes, std::vector<int>(n_unique_labels));
   sparse_histstate[0] = histvec;
+  //Weighted class histograms, empty when fitting without weights
+  std::vector<std::vector<float>> sparse_whiststate;
+  if (tempmem->weighted) {
+    sparse_whiststate.resize(total_nodes, std::vector<float>(n_unique_labels));
+    sparse_whiststate[0] = whistvec;
+  }
 
   std::vector<SparseTreeNode<T, int>> sparsetree;
   sparsetree.reserve(total_nodes);
@@ -89,6 +108,12 @@ ML::DecisionTree::TreeNode<T, int>* grow_deep_tree_classification(
   unsigned int* h_new_node_flags = tempmem->h_new_node_flags->data();
   unsigned int* d_new_node_flags = tempmem->d_new_node_flags->data();
   unsigned int* d_colids = tempmem->d_colids->data();
+  int* h_derive_from = tempmem->h_derive_from->data();
+  int* d_derive_from = tempmem->d_derive_from->data();
+  int n_nodes_prev = 0;
+  int* h_nodeids = tempmem->h_nodeids->data();
+  int* d_nodeids = tempmem->d_nodeids->data();
+  bool sample_cols = (ncols_sampled < ncols);
 
   for (int depth = 0; (depth < maxdepth) && (n_nodes_nextitr != 0); depth++) {
     depth_cnt = depth + 1;
@@ -100,42 +125,80 @@ ML::DecisionTree::TreeNode<T, int>* grow_deep_tree_classification(
       "Max node limit reached. Requested nodes %d > %d max nodes at depth %d\n",
       n_nodes, tempmem->max_nodes_per_level, depth);
 
+    int* derive_from =
+      (depth == 0 || !hist_subtraction) ? nullptr : d_derive_from;
+    unsigned char* colflags = nullptr;
+    if (sample_cols) {
+      for (int i = 0; i < n_nodes; i++) {
+        h_nodeids[i] = sparsesize + sparse_nodelist[i];
+      }
+      MLCommon::updateDevice(d_nodeids, h_nodeids, n_nodes, tempmem->stream);
+      colflags = tempmem->d_colflags->data();
+      sample_level_columns(d_nodeids, derive_from,
+                           tempmem->d_colflags_parent->data(), n_nodes, ncols,
+                           ncols_sampled, seed, treeid, colflags,
+                           tempmem->stream);
+    }
+
+    // Below the root, build histograms of the smaller children only and
+    // derive their siblings.
     get_histogram_classification(data, labels, flagsptr, sample_cnt, nrows,
                                  ncols, n_unique_labels, nbins, n_nodes,
-                                 tempmem, d_histogram);
+                                 tempmem, d_histogram, derive_from,
+                                 tempmem->d_histogram_parent->data(),
+                                 n_nodes_prev, colflags);
 
     float* infogain = tempmem->h_outgain->data();
     if (split_cr == ML::CRITERION::GINI) {
       get_best_split_classification<T, GiniFunctor, GiniDevFunctor>(
         h_histogram, d_histogram, feature_selector, d_colids, nbins,
         n_unique_labels, n_nodes, depth, min_rows_per_node, infogain,
-        sparse_histstate, sparsetree, sparsesize, sparse_nodelist,
-        h_split_colidx, h_split_binidx, d_split_colidx, d_split_binidx,
-        tempmem);
+        sparse_histstate, sparse_whiststate, sparsetree, sparsesize,
+        sparse_nodelist, h_split_colidx, h_split_binidx, d_split_colidx,
+        d_split_binidx, tempmem);
     } else {
       get_best_split_classification<T, EntropyFunctor, EntropyDevFunctor>(
         h_histogram, d_histogram, feature_selector, d_colids, nbins,
         n_unique_labels, n_nodes, depth, min_rows_per_node, infogain,
-        sparse_histstate, sparsetree, sparsesize, sparse_nodelist,
-        h_split_colidx, h_split_binidx, d_split_colidx, d_split_binidx,
-        tempmem);
+        sparse_histstate, sparse_whiststate, sparsetree, sparsesize,
+        sparse_nodelist, h_split_colidx, h_split_binidx, d_split_colidx,
+        d_split_binidx, tempmem);
     }
 
     CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
 
-    leaf_eval_classification(
-      infogain, depth, maxdepth, maxleaves, h_new_node_flags, sparsetree,
-      sparsesize, sparse_histstate, n_nodes_nextitr, sparse_nodelist, leaf_cnt);
+    leaf_eval_classification(infogain, depth, maxdepth, maxleaves,
+                             h_new_node_flags, sparsetree, sparsesize,
+                             sparse_histstate, sparse_whiststate,
+                             n_nodes_nextitr, sparse_nodelist, leaf_cnt,
+                             h_derive_from);
 
     MLCommon::updateDevice(d_new_node_flags, h_new_node_flags, n_nodes,
                            tempmem->stream);
+    MLCommon::updateDevice(d_derive_from, h_derive_from, n_nodes_nextitr,
+                           tempmem->stream);
 
     make_level_split(data, nrows, ncols, nbins, n_nodes, d_split_colidx,
                      d_split_binidx, d_new_node_flags, flagsptr, tempmem);
+
+    // Histograms of this level become the parent histograms of next level
+    std::swap(tempmem->d_histogram, tempmem->d_histogram_parent);
+    d_histogram = tempmem->d_histogram->data();
+    if (tempmem->weighted) {
+      std::swap(tempmem->d_whistogram, tempmem->d_whistogram_parent);
+    }
+    std::swap(tempmem->d_colflags, tempmem->d_colflags_parent);
+    n_nodes_prev = n_nodes;
   }
 
   for (int i = sparsesize_nextitr; i < sparsetree.size(); i++) {
-    sparsetree[i].prediction = get_class_hist(sparse_histstate[i]);
+    if (tempmem->weighted) {
+      sparsetree[i].prediction = get_class_hist(sparse_whiststate[i]);
+      sparsetree[i].class_probs = get_class_probs(sparse_whiststate[i]);
+    } else {
+      sparsetree[i].prediction = get_class_hist(sparse_histstate[i]);
+      sparsetree[i].class_probs = get_class_probs(sparse_histstate[i]);
+    }
   }
   return go_recursive_sparse(sparsetree);
 }
@@ -26,8 +26,14 @@
 This is the driver function for building regression tree 
 level by level using a simple for loop.
 At each level; following steps are involved.
+0. If max_features < 1, draw the columns considered by each node.
+   With sample weights, per row weights are set up once and sums of
+   weights are built next to the row counts.
 1. Set up parent node mean and counts
-2. Compute means and counts for all nodes, all cols and all bins.
+2. Compute means and counts for all nodes, all cols and all bins. Below the
+   root, only the smaller child of each split is built from the data; its
+   sibling is derived as parent - child from the previous level sums/counts,
+   unless hist_subtraction is off.
 3. Find best split col and bin for each node.
 4. Check info gain and then leaf out nodes as needed.
 5. make split.
@@ -35,8 +41,10 @@ At each level; following steps are involved.
 template <typename T>
 ML::DecisionTree::TreeNode<T, T>* grow_deep_tree_regression(
   const T* data, const T* labels, unsigned int* rowids,
-  const std::vector<unsigned int>& feature_selector, const int n_sampled_rows,
-  const int nrows, const int nbins, int maxdepth, const int maxleaves,
+  const T* sample_weight, const std::vector<unsigned int>& feature_selector,
+  const int ncols_sampled, const uint64_t seed, const int treeid,
+  const bool hist_subtraction, const int n_sampled_rows, const int nrows,
+  const int nbins, int maxdepth, const int maxleaves,
   const int min_rows_per_node, const ML::CRITERION split_cr, int& depth_cnt,
   int& leaf_cnt, std::shared_ptr<TemporaryMemory<T, T>> tempmem) {
   const int ncols = feature_selector.size();
@@ -47,16 +55,22 @@ ML::DecisionTree::TreeNode<T, T>* grow_deep_tree_regression(
   unsigned int* sample_cnt = tempmem->d_sample_cnt->data();
   setup_sampling(flagsptr, sample_cnt, rowids, nrows, n_sampled_rows,
                  tempmem->stream);
+  if (tempmem->weighted) {
+    setup_weights(sample_cnt, (const int*)nullptr, sample_weight,
+                  (const T*)nullptr, nrows, tempmem->d_sample_weight->data(),
+                  tempmem->stream);
+  }
 
   T mean;
   T initial_metric;
   unsigned int count;
+  T wcount;
   if (split_cr == ML::CRITERION::MSE) {
-    initial_metric_regression<T, SquareFunctor>(labels, sample_cnt, nrows, mean,
-                                                count, initial_metric, tempmem);
+    initial_metric_regression<T, SquareFunctor>(
+      labels, sample_cnt, nrows, mean, count, wcount, initial_metric, tempmem);
   } else {
-    initial_metric_regression<T, AbsFunctor>(labels, sample_cnt, nrows, mean,
-                                             count, initial_metric, tempmem);
+    initial_metric_regression<T, AbsFunctor>(
+      labels, sample_cnt, nrows, mean, count, wcount, initial_metric, tempmem);
   }
 
   size_t total_nodes = pow(2, (maxdepth + 1)) - 1;
@@ -67,6 +81,12 @@ ML::DecisionTree::TreeNode<T, T>* grow_deep_tree_regression(
   sparse_countstate.resize(total_nodes, 0);
   sparse_meanstate[0] = mean;
   sparse_countstate[0] = count;
+  //Sums of weights, empty when fitting without weights
+  std::vector<T> sparse_wcountstate;
+  if (tempmem->weighted) {
+    sparse_wcountstate.resize(total_nodes, 0.0);
+    sparse_wcountstate[0] = wcount;
+  }
   std::vector<SparseTreeNode<T, T>> sparsetree;
   sparsetree.reserve(total_nodes);
   SparseTreeNode<T, T> sparsenode;
@@ -95,6 +115,12 @@ ML::DecisionTree::TreeNode<T, T>* grow_deep_tree_regression(
   unsigned int* h_new_node_flags = tempmem->h_new_node_flags->data();
   unsigned int* d_new_node_flags = tempmem->d_new_node_flags->data();
   unsigned int* d_colids = tempmem->d_colids->data();
+  int* h_derive_from = tempmem->h_derive_from->data();
+  int* d_derive_from = tempmem->d_derive_from->data();
+  int n_nodes_prev = 0;
+  int* h_nodeids = tempmem->h_nodeids->data();
+  int* d_nodeids = tempmem->d_nodeids->data();
+  bool sample_cols = (ncols_sampled < ncols);
 
   for (int depth = 0; (depth < maxdepth) && (n_nodes_nextitr != 0); depth++) {
     depth_cnt = depth + 1;
@@ -106,36 +132,69 @@ ML::DecisionTree::TreeNode<T, T>* grow_deep_tree_regression(
       n_nodes <= tempmem->max_nodes_per_level,
       "Max node limit reached. Requested nodes %d > %d max nodes at depth %d\n",
       n_nodes, tempmem->max_nodes_per_level, depth);
-    init_parent_value(sparse_meanstate, sparse_countstate, sparse_nodelist,
-                      sparsesize, depth, tempmem);
+
+    int* derive_from =
+      (depth == 0 || !hist_subtraction) ? nullptr : d_derive_from;
+    unsigned char* colflags = nullptr;
+    if (sample_cols) {
+      for (int i = 0; i < n_nodes; i++) {
+        h_nodeids[i] = sparsesize + sparse_nodelist[i];
+      }
+      MLCommon::updateDevice(d_nodeids, h_nodeids, n_nodes, tempmem->stream);
+      colflags = tempmem->d_colflags->data();
+      sample_level_columns(d_nodeids, derive_from,
+                           tempmem->d_colflags_parent->data(), n_nodes, ncols,
+                           ncols_sampled, seed, treeid, colflags,
+                           tempmem->stream);
+    }
+    init_parent_value(sparse_meanstate, sparse_countstate, sparse_wcountstate,
+                      sparse_nodelist, sparsesize, depth, tempmem);
 
     if (split_cr == ML::CRITERION::MSE) {
       get_mse_regression<T, SquareFunctor>(
         data, labels, flagsptr, sample_cnt, nrows, ncols, nbins, n_nodes,
-        tempmem, d_mseout, d_predout, d_count);
+        tempmem, d_mseout, d_predout, d_count, derive_from,
+        tempmem->d_predout_parent->data(), tempmem->d_count_parent->data(),
+        n_nodes_prev, colflags);
     } else {
-      get_mse_regression<T, AbsFunctor>(data, labels, flagsptr, sample_cnt,
-                                        nrows, ncols, nbins, n_nodes, tempmem,
-                                        d_mseout, d_predout, d_count);
+      get_mse_regression<T, AbsFunctor>(
+        data, labels, flagsptr, sample_cnt, nrows, ncols, nbins, n_nodes,
+        tempmem, d_mseout, d_predout, d_count, derive_from,
+        tempmem->d_predout_parent->data(), tempmem->d_count_parent->data(),
+        n_nodes_prev, colflags);
     }
 
     float* infogain = tempmem->h_outgain->data();
     get_best_split_regression(
       h_mseout, d_mseout, h_predout, d_predout, h_count, d_count,
       feature_selector, d_colids, nbins, n_nodes, depth, min_rows_per_node,
-      sparsesize, infogain, sparse_meanstate, sparse_countstate, sparsetree,
-      sparse_nodelist, h_split_colidx, h_split_binidx, d_split_colidx,
-      d_split_binidx, tempmem);
+      sparsesize, infogain, sparse_meanstate, sparse_countstate,
+      sparse_wcountstate, sparsetree, sparse_nodelist, h_split_colidx,
+      h_split_binidx, d_split_colidx, d_split_binidx, tempmem);
 
     CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
     leaf_eval_regression(infogain, depth, maxdepth, maxleaves, h_new_node_flags,
                          sparsetree, sparsesize, sparse_meanstate,
-                         n_nodes_nextitr, sparse_nodelist, leaf_cnt);
+                         sparse_countstate, n_nodes_nextitr, sparse_nodelist,
+                         leaf_cnt, h_derive_from);
 
     MLCommon::updateDevice(d_new_node_flags, h_new_node_flags, n_nodes,
                            tempmem->stream);
+    MLCommon::updateDevice(d_derive_from, h_derive_from, n_nodes_nextitr,
+                           tempmem->stream);
     make_level_split(data, nrows, ncols, nbins, n_nodes, d_split_colidx,
                      d_split_binidx, d_new_node_flags, flagsptr, tempmem);
+
+    // Sums and counts of this level become the parent ones of next level
+    std::swap(tempmem->d_predout, tempmem->d_predout_parent);
+    std::swap(tempmem->d_count, tempmem->d_count_parent);
+    d_predout = tempmem->d_predout->data();
+    d_count = tempmem->d_count->data();
+    if (tempmem->weighted) {
+      std::swap(tempmem->d_wcount, tempmem->d_wcount_parent);
+    }
+    std::swap(tempmem->d_colflags, tempmem->d_colflags_parent);
+    n_nodes_prev = n_nodes;
   }
   for (int i = sparsesize_nextitr; i < sparsetree.size(); i++) {
     sparsetree[i].prediction = sparse_meanstate[i];
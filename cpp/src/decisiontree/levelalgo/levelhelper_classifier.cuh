@@ -18,7 +18,8 @@
 template <typename T, typename F>
 void initial_metric_classification(
   const int *labels, unsigned int *sample_cnt, const int nrows,
-  const int n_unique_labels, std::vector<int> &histvec, T &initial_metric,
+  const int n_unique_labels, std::vector<int> &histvec,
+  std::vector<float> &whistvec, T &initial_metric,
   std::shared_ptr<TemporaryMemory<T, int>> tempmem) {
   CUDA_CHECK(cudaMemsetAsync(tempmem->d_parent_hist->data(), 0,
                              n_unique_labels * sizeof(unsigned int),
@@ -35,7 +36,25 @@ void initial_metric_classification(
   CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
   histvec.assign(tempmem->h_parent_hist->data(),
                  tempmem->h_parent_hist->data() + n_unique_labels);
-  initial_metric = F::exec(histvec, nrows);
+  if (!tempmem->weighted) {
+    initial_metric = F::exec(histvec, nrows);
+    return;
+  }
+  CUDA_CHECK(cudaMemsetAsync(tempmem->d_parent_whist->data(), 0,
+                             n_unique_labels * sizeof(float), tempmem->stream));
+  sample_weight_histogram_kernel<<<blocks, 128, sizeof(float) * n_unique_labels,
+                                   tempmem->stream>>>(
+    labels, tempmem->d_sample_weight->data(), nrows, n_unique_labels,
+    tempmem->d_parent_whist->data());
+  CUDA_CHECK(cudaGetLastError());
+  MLCommon::updateHost(tempmem->h_parent_whist->data(),
+                       tempmem->d_parent_whist->data(), n_unique_labels,
+                       tempmem->stream);
+  CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
+  whistvec.assign(tempmem->h_parent_whist->data(),
+                  tempmem->h_parent_whist->data() + n_unique_labels);
+  float total_weight = std::accumulate(whistvec.begin(), whistvec.end(), 0.0f);
+  initial_metric = F::exec(whistvec, total_weight);
 }
 
 template <typename T>
@@ -43,25 +62,50 @@ void get_histogram_classification(
   const T *data, const int *labels, unsigned int *flags,
   unsigned int *sample_cnt, const int nrows, const int ncols,
   const int n_unique_labels, const int nbins, const int n_nodes,
-  std::shared_ptr<TemporaryMemory<T, int>> tempmem, unsigned int *histout) {
+  std::shared_ptr<TemporaryMemory<T, int>> tempmem, unsigned int *histout,
+  const int *derive_from = nullptr, const unsigned int *parent_hist = nullptr,
+  const int n_parent_nodes = 0, const unsigned char *colflags = nullptr) {
   size_t histcount = ncols * nbins * n_unique_labels * n_nodes;
   CUDA_CHECK(cudaMemsetAsync(histout, 0, histcount * sizeof(unsigned int),
                              tempmem->stream));
+  //Weighted histograms live next to the counts in tempmem
+  const T *weights = nullptr;
+  float *whistout = nullptr;
+  size_t shmem_elem = sizeof(int);
+  if (tempmem->weighted) {
+    weights = tempmem->d_sample_weight->data();
+    whistout = tempmem->d_whistogram->data();
+    shmem_elem += sizeof(float);
+    CUDA_CHECK(cudaMemsetAsync(whistout, 0, histcount * sizeof(float),
+                               tempmem->stream));
+  }
   int node_batch = min(n_nodes, tempmem->max_nodes_class);
-  size_t shmem = nbins * n_unique_labels * sizeof(int) * node_batch;
+  size_t shmem = nbins * n_unique_labels * shmem_elem * node_batch;
   int threads = 256;
   int blocks = MLCommon::ceildiv(nrows, threads);
 
   if ((n_nodes == node_batch)) {
     get_hist_kernel<<<blocks, threads, shmem, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
-      n_unique_labels, nbins, n_nodes, tempmem->d_quantile->data(), histout);
+      n_unique_labels, nbins, n_nodes, tempmem->d_quantile->data(),
+      derive_from, colflags, weights, histout, whistout);
   } else {
     get_hist_kernel_global<<<blocks, threads, 0, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
-      n_unique_labels, nbins, n_nodes, tempmem->d_quantile->data(), histout);
+      n_unique_labels, nbins, n_nodes, tempmem->d_quantile->data(),
+      derive_from, colflags, weights, histout, whistout);
   }
   CUDA_CHECK(cudaGetLastError());
+  if (derive_from != nullptr) {
+    subtract_histograms(parent_hist, derive_from, colflags, ncols, n_nodes,
+                        n_parent_nodes, nbins * n_unique_labels, histout,
+                        tempmem->stream);
+    if (tempmem->weighted) {
+      subtract_histograms(tempmem->d_whistogram_parent->data(), derive_from,
+                          colflags, ncols, n_nodes, n_parent_nodes,
+                          nbins * n_unique_labels, whistout, tempmem->stream);
+    }
+  }
 }
 template <typename T, typename F, typename DF>
 void get_best_split_classification(
@@ -70,6 +114,7 @@ void get_best_split_classification(
   const int nbins, const int n_unique_labels, const int n_nodes,
   const int depth, const int min_rpn, float *gain,
   std::vector<std::vector<int>> &sparse_histstate,
+  std::vector<std::vector<float>> &sparse_whiststate,
   std::vector<SparseTreeNode<T, int>> &sparsetree, const int sparsesize,
   std::vector<int> &sparse_nodelist, int *split_colidx, int *split_binidx,
   int *d_split_colidx, int *d_split_binidx,
@@ -79,6 +124,7 @@ void get_best_split_classification(
   size_t histcount = ncols * nbins * n_unique_labels * n_nodes;
   bool use_gpu_flag = false;
   if (n_nodes > 512) use_gpu_flag = true;
+  bool weighted = tempmem->weighted;
 
   memset(gain, 0, n_nodes * sizeof(float));
   int sparsetree_sz = sparsetree.size();
@@ -99,6 +145,16 @@ void get_best_split_classification(
     d_parent_metric = tempmem->d_parent_metric->data();
     d_child_best_metric = tempmem->d_child_best_metric->data();
     d_outgain = tempmem->d_outgain->data();
+    float *d_whist = nullptr, *d_parent_whist = nullptr;
+    float *d_child_whist = nullptr, *h_parent_whist = nullptr;
+    float *h_child_whist = nullptr;
+    if (weighted) {
+      d_whist = tempmem->d_whistogram->data();
+      d_parent_whist = tempmem->d_parent_whist->data();
+      d_child_whist = tempmem->d_child_whist->data();
+      h_parent_whist = tempmem->h_parent_whist->data();
+      h_child_whist = tempmem->h_child_whist->data();
+    }
     for (int nodecnt = 0; nodecnt < n_nodes; nodecnt++) {
       int sparse_nodeid = sparse_nodelist[nodecnt];
       int parentid = sparsesize + sparse_nodeid;
@@ -107,22 +163,40 @@ void get_best_split_classification(
       for (int j = 0; j < n_unique_labels; j++) {
         h_parent_hist[nodecnt * n_unique_labels + j] = parent_hist[j];
       }
+      if (weighted) {
+        std::vector<float> &parent_whist = sparse_whiststate[parentid];
+        for (int j = 0; j < n_unique_labels; j++) {
+          h_parent_whist[nodecnt * n_unique_labels + j] = parent_whist[j];
+        }
+      }
     }
 
     MLCommon::updateDevice(d_parent_hist, h_parent_hist,
                            n_nodes * n_unique_labels, tempmem->stream);
     MLCommon::updateDevice(d_parent_metric, h_parent_metric, n_nodes,
                            tempmem->stream);
+    if (weighted) {
+      MLCommon::updateDevice(d_parent_whist, h_parent_whist,
+                             n_nodes * n_unique_labels, tempmem->stream);
+    }
     int threads = 64;
     size_t shmemsz = (threads + 2) * 2 * n_unique_labels * sizeof(int);
+    if (weighted) {
+      shmemsz += (threads + 2) * 2 * n_unique_labels * sizeof(float);
+    }
     get_best_split_classification_kernel<T, DF>
       <<<n_nodes, threads, shmemsz, tempmem->stream>>>(
         d_hist, d_parent_hist, d_parent_metric, d_colids, nbins, ncols, n_nodes,
         n_unique_labels, min_rpn, d_outgain, d_split_colidx, d_split_binidx,
-        d_child_hist, d_child_best_metric);
+        d_child_hist, d_child_best_metric, d_whist, d_parent_whist,
+        d_child_whist);
     CUDA_CHECK(cudaGetLastError());
     MLCommon::updateHost(h_child_hist, d_child_hist,
                          2 * n_nodes * n_unique_labels, tempmem->stream);
+    if (weighted) {
+      MLCommon::updateHost(h_child_whist, d_child_whist,
+                           2 * n_nodes * n_unique_labels, tempmem->stream);
+    }
     MLCommon::updateHost(h_outgain, d_outgain, n_nodes, tempmem->stream);
     MLCommon::updateHost(h_child_best_metric, d_child_best_metric, 2 * n_nodes,
                          tempmem->stream);
@@ -155,9 +229,22 @@ void get_best_split_classification(
       sparsetree.push_back(rightnode);
       sparse_histstate[curr_node.left_child_id] = tmp_histleft;
       sparse_histstate[curr_node.left_child_id + 1] = tmp_histright;
+      if (weighted) {
+        float *child_whist = &h_child_whist[n_unique_labels * nodecnt * 2];
+        sparse_whiststate[curr_node.left_child_id].assign(
+          child_whist, child_whist + n_unique_labels);
+        sparse_whiststate[curr_node.left_child_id + 1].assign(
+          child_whist + n_unique_labels, child_whist + 2 * n_unique_labels);
+      }
     }
   } else {
     MLCommon::updateHost(hist, d_hist, histcount, tempmem->stream);
+    float *whist = nullptr;
+    if (weighted) {
+      whist = tempmem->h_whistogram->data();
+      MLCommon::updateHost(whist, tempmem->d_whistogram->data(), histcount,
+                           tempmem->stream);
+    }
     CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
 
     for (int nodecnt = 0; nodecnt < n_nodes; nodecnt++) {
@@ -169,6 +256,8 @@ void get_best_split_classification(
       int best_bin_id = 0;
       std::vector<int> besthist_left(n_unique_labels);
       std::vector<int> besthist_right(n_unique_labels);
+      std::vector<float> bestwhist_left(n_unique_labels);
+      std::vector<float> bestwhist_right(n_unique_labels);
 
       for (int colid = 0; colid < ncols; colid++) {
         int coloffset = colid * nbins * n_unique_labels * n_nodes;
@@ -193,8 +282,33 @@ void get_best_split_classification(
           if (tmp_lnrows == 0 || tmp_rnrows == 0 || totalrows < min_rpn)
             continue;
 
-          float tmp_gini_left = F::exec(tmp_histleft, tmp_lnrows);
-          float tmp_gini_right = F::exec(tmp_histright, tmp_rnrows);
+          float tmp_gini_left, tmp_gini_right;
+          float left_frac = tmp_lnrows * 1.0f / totalrows;
+          float right_frac = tmp_rnrows * 1.0f / totalrows;
+          std::vector<float> tmp_whistleft, tmp_whistright;
+          if (weighted) {
+            std::vector<float> &parent_whist = sparse_whiststate[parentid];
+            tmp_whistleft.resize(n_unique_labels);
+            tmp_whistright.resize(n_unique_labels);
+            float tmp_lweight = 0.0f;
+            float tmp_rweight = 0.0f;
+            for (int j = 0; j < n_unique_labels; j++) {
+              int histid = coloffset + binoffset + nodeoffset + j;
+              tmp_whistleft[j] = whist[histid];
+              tmp_whistright[j] =
+                std::max(parent_whist[j] - tmp_whistleft[j], 0.0f);
+              tmp_lweight += tmp_whistleft[j];
+              tmp_rweight += tmp_whistright[j];
+            }
+            if (tmp_lweight <= 0.0f || tmp_rweight <= 0.0f) continue;
+            tmp_gini_left = F::exec(tmp_whistleft, tmp_lweight);
+            tmp_gini_right = F::exec(tmp_whistright, tmp_rweight);
+            left_frac = tmp_lweight / (tmp_lweight + tmp_rweight);
+            right_frac = tmp_rweight / (tmp_lweight + tmp_rweight);
+          } else {
+            tmp_gini_left = F::exec(tmp_histleft, tmp_lnrows);
+            tmp_gini_right = F::exec(tmp_histright, tmp_rnrows);
+          }
 
           float max_value = F::max_val(n_unique_labels);
 
@@ -205,8 +319,8 @@ void get_best_split_classification(
                  "gini right value %f not in [0.0, %f]", tmp_gini_right,
                  max_value);
 
-          float impurity = (tmp_lnrows * 1.0f / totalrows) * tmp_gini_left +
-                           (tmp_rnrows * 1.0f / totalrows) * tmp_gini_right;
+          float impurity =
+            left_frac * tmp_gini_left + right_frac * tmp_gini_right;
           float info_gain = sparsetree[parentid].best_metric_val - impurity;
 
           // Compute best information col_gain so far
@@ -216,6 +330,8 @@ void get_best_split_classification(
             best_col_id = colselector[colid];
             besthist_left = tmp_histleft;
             besthist_right = tmp_histright;
+            bestwhist_left = tmp_whistleft;
+            bestwhist_right = tmp_whistright;
             bestmetric[0] = tmp_gini_left;
             bestmetric[1] = tmp_gini_right;
           }
@@ -237,6 +353,10 @@ void get_best_split_classification(
       sparsetree.push_back(rightnode);
       sparse_histstate[curr_node.left_child_id] = besthist_left;
       sparse_histstate[curr_node.left_child_id + 1] = besthist_right;
+      if (weighted) {
+        sparse_whiststate[curr_node.left_child_id] = bestwhist_left;
+        sparse_whiststate[curr_node.left_child_id + 1] = bestwhist_right;
+      }
     }
     MLCommon::updateDevice(d_split_binidx, split_binidx, n_nodes,
                            tempmem->stream);
@@ -250,7 +370,8 @@ void leaf_eval_classification(
   float *gain, int curr_depth, const int max_depth, const int max_leaves,
   unsigned int *new_node_flags, std::vector<SparseTreeNode<T, int>> &sparsetree,
   const int sparsesize, std::vector<std::vector<int>> &sparse_hist,
-  int &n_nodes_next, std::vector<int> &sparse_nodelist, int &tree_leaf_cnt) {
+  std::vector<std::vector<float>> &sparse_whist, int &n_nodes_next,
+  std::vector<int> &sparse_nodelist, int &tree_leaf_cnt, int *derive_from) {
   std::vector<int> tmp_sparse_nodelist(sparse_nodelist);
   sparse_nodelist.clear();
 
@@ -267,11 +388,29 @@ void leaf_eval_classification(
     if (condition) {
       node_flag = 0xFFFFFFFF;
       sparsetree[sparsesize + sparse_nodeid].colid = -1;
-      sparsetree[sparsesize + sparse_nodeid].prediction =
-        get_class_hist(nodehist);
+      //Weighted majority class when fitting with weights
+      SparseTreeNode<T, int> &leaf = sparsetree[sparsesize + sparse_nodeid];
+      if (sparse_whist.empty()) {
+        leaf.prediction = get_class_hist(nodehist);
+        leaf.class_probs = get_class_probs(nodehist);
+      } else {
+        std::vector<float> &nodewhist =
+          sparse_whist[sparsesize + sparse_nodeid];
+        leaf.prediction = get_class_hist(nodewhist);
+        leaf.class_probs = get_class_probs(nodewhist);
+      }
     } else {
       sparse_nodelist.push_back(2 * i);
       sparse_nodelist.push_back(2 * i + 1);
+      int left_id = sparsetree[sparsesize + sparse_nodeid].left_child_id;
+      std::vector<int> &lefthist = sparse_hist[left_id];
+      std::vector<int> &righthist = sparse_hist[left_id + 1];
+      unsigned int left_cnt =
+        std::accumulate(lefthist.begin(), lefthist.end(), 0);
+      unsigned int right_cnt =
+        std::accumulate(righthist.begin(), righthist.end(), 0);
+      setup_subtraction_pair(derive_from, non_leaf_counter, i, left_cnt,
+                             right_cnt);
       node_flag = non_leaf_counter;
       non_leaf_counter++;
     }
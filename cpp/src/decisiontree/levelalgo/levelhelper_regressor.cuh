@@ -18,7 +18,7 @@
 template <typename T, typename F>
 void initial_metric_regression(const T *labels, unsigned int *sample_cnt,
                                const int nrows, T &mean, unsigned int &count,
-                               T &initial_metric,
+                               T &wcount, T &initial_metric,
                                std::shared_ptr<TemporaryMemory<T, T>> tempmem) {
   CUDA_CHECK(
     cudaMemsetAsync(tempmem->d_mseout->data(), 0, sizeof(T), tempmem->stream));
@@ -26,17 +26,28 @@ void initial_metric_regression(const T *labels, unsigned int *sample_cnt,
     cudaMemsetAsync(tempmem->d_predout->data(), 0, sizeof(T), tempmem->stream));
   CUDA_CHECK(cudaMemsetAsync(tempmem->d_count->data(), 0, sizeof(unsigned int),
                              tempmem->stream));
+  const T *weights = nullptr;
+  T *d_wcount = nullptr;
+  if (tempmem->weighted) {
+    weights = tempmem->d_sample_weight->data();
+    d_wcount = tempmem->d_wcount->data();
+    CUDA_CHECK(cudaMemsetAsync(d_wcount, 0, sizeof(T), tempmem->stream));
+  }
   int threads = 128;
   int blocks = MLCommon::ceildiv(nrows, threads);
 
   pred_kernel_level<<<blocks, threads, 0, tempmem->stream>>>(
-    labels, sample_cnt, nrows, tempmem->d_predout->data(),
-    tempmem->d_count->data());
+    labels, sample_cnt, nrows, weights, tempmem->d_predout->data(),
+    tempmem->d_count->data(), d_wcount);
   CUDA_CHECK(cudaGetLastError());
   mse_kernel_level<T, F><<<blocks, threads, 0, tempmem->stream>>>(
-    labels, sample_cnt, nrows, tempmem->d_predout->data(),
-    tempmem->d_count->data(), tempmem->d_mseout->data());
+    labels, sample_cnt, nrows, weights, tempmem->d_predout->data(),
+    tempmem->d_count->data(), d_wcount, tempmem->d_mseout->data());
   CUDA_CHECK(cudaGetLastError());
+  if (tempmem->weighted) {
+    MLCommon::updateHost(tempmem->h_wcount->data(), d_wcount, 1,
+                         tempmem->stream);
+  }
   MLCommon::updateHost(tempmem->h_count->data(), tempmem->d_count->data(), 1,
                        tempmem->stream);
   MLCommon::updateHost(tempmem->h_predout->data(), tempmem->d_predout->data(),
@@ -45,8 +56,9 @@ void initial_metric_regression(const T *labels, unsigned int *sample_cnt,
                        tempmem->stream);
   CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
   count = tempmem->h_count->data()[0];
-  mean = tempmem->h_predout->data()[0] / count;
-  initial_metric = tempmem->h_mseout->data()[0] / count;
+  wcount = tempmem->weighted ? tempmem->h_wcount->data()[0] : (T)count;
+  mean = tempmem->h_predout->data()[0] / wcount;
+  initial_metric = tempmem->h_mseout->data()[0] / wcount;
 }
 
 template <typename T, typename F>
@@ -54,7 +66,12 @@ void get_mse_regression(const T *data, const T *labels, unsigned int *flags,
                         unsigned int *sample_cnt, const int nrows,
                         const int ncols, const int nbins, const int n_nodes,
                         std::shared_ptr<TemporaryMemory<T, T>> tempmem,
-                        T *d_mseout, T *d_predout, unsigned int *d_count) {
+                        T *d_mseout, T *d_predout, unsigned int *d_count,
+                        const int *derive_from = nullptr,
+                        const T *parent_predout = nullptr,
+                        const unsigned int *parent_count = nullptr,
+                        const int n_parent_nodes = 0,
+                        const unsigned char *colflags = nullptr) {
   size_t predcount = ncols * nbins * n_nodes;
   CUDA_CHECK(
     cudaMemsetAsync(d_mseout, 0, 2 * predcount * sizeof(T), tempmem->stream));
@@ -62,10 +79,23 @@ void get_mse_regression(const T *data, const T *labels, unsigned int *flags,
     cudaMemsetAsync(d_predout, 0, predcount * sizeof(T), tempmem->stream));
   CUDA_CHECK(cudaMemsetAsync(d_count, 0, predcount * sizeof(unsigned int),
                              tempmem->stream));
+  //Sums of weights live next to the counts in tempmem
+  const T *weights = nullptr;
+  T *d_wcount = nullptr;
+  const T *d_parent_wcount = nullptr;
+  size_t pernode_pred = nbins * (sizeof(unsigned int) + sizeof(T));
+  if (tempmem->weighted) {
+    weights = tempmem->d_sample_weight->data();
+    d_wcount = tempmem->d_wcount->data();
+    d_parent_wcount = tempmem->d_parent_wcount->data();
+    pernode_pred += nbins * sizeof(T);
+    CUDA_CHECK(
+      cudaMemsetAsync(d_wcount, 0, predcount * sizeof(T), tempmem->stream));
+  }
 
   int node_batch_pred = min(n_nodes, tempmem->max_nodes_pred);
   int node_batch_mse = min(n_nodes, tempmem->max_nodes_mse);
-  size_t shmempred = nbins * (sizeof(unsigned int) + sizeof(T)) * n_nodes;
+  size_t shmempred = pernode_pred * n_nodes;
   size_t shmemmse = shmempred + 2 * nbins * n_nodes * sizeof(T);
 
   int threads = 256;
@@ -74,25 +104,42 @@ void get_mse_regression(const T *data, const T *labels, unsigned int *flags,
   if ((n_nodes == node_batch_pred)) {
     get_pred_kernel<<<blocks, threads, shmempred, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
-      nbins, n_nodes, tempmem->d_quantile->data(), d_predout, d_count);
+      nbins, n_nodes, tempmem->d_quantile->data(), derive_from, colflags,
+      weights, d_predout, d_count, d_wcount);
   } else {
     get_pred_kernel_global<<<blocks, threads, 0, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
-      nbins, n_nodes, tempmem->d_quantile->data(), d_predout, d_count);
+      nbins, n_nodes, tempmem->d_quantile->data(), derive_from, colflags,
+      weights, d_predout, d_count, d_wcount);
   }
   CUDA_CHECK(cudaGetLastError());
+  // Sums and counts are additive; the mse pass below depends on per node
+  // bin means, so it still goes over the rows of every node.
+  if (derive_from != nullptr) {
+    subtract_histograms(parent_predout, derive_from, colflags, ncols, n_nodes,
+                        n_parent_nodes, nbins, d_predout, tempmem->stream);
+    subtract_histograms(parent_count, derive_from, colflags, ncols, n_nodes,
+                        n_parent_nodes, nbins, d_count, tempmem->stream);
+    if (tempmem->weighted) {
+      subtract_histograms(tempmem->d_wcount_parent->data(), derive_from,
+                          colflags, ncols, n_nodes, n_parent_nodes, nbins,
+                          d_wcount, tempmem->stream);
+    }
+  }
   if ((n_nodes == node_batch_mse)) {
     get_mse_kernel<T, F><<<blocks, threads, shmemmse, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
       nbins, n_nodes, tempmem->d_quantile->data(),
       tempmem->d_parent_pred->data(), tempmem->d_parent_count->data(),
-      d_predout, d_count, d_mseout);
+      d_predout, d_count, colflags, weights, d_parent_wcount, d_wcount,
+      d_mseout);
   } else {
     get_mse_kernel_global<T, F><<<blocks, threads, 0, tempmem->stream>>>(
       data, labels, flags, sample_cnt, tempmem->d_colids->data(), nrows, ncols,
       nbins, n_nodes, tempmem->d_quantile->data(),
       tempmem->d_parent_pred->data(), tempmem->d_parent_count->data(),
-      d_predout, d_count, d_mseout);
+      d_predout, d_count, colflags, weights, d_parent_wcount, d_wcount,
+      d_mseout);
   }
   CUDA_CHECK(cudaGetLastError());
 }
@@ -105,6 +152,7 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
                                const int min_rpn, const int sparsesize,
                                float *gain, std::vector<T> &sparse_meanstate,
                                std::vector<unsigned int> &sparse_countstate,
+                               std::vector<T> &sparse_wcountstate,
                                std::vector<SparseTreeNode<T, T>> &sparsetree,
                                std::vector<int> &sparse_nodelist,
                                int *split_colidx, int *split_binidx,
@@ -115,6 +163,7 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
   size_t predcount = ncols * nbins * n_nodes;
   bool use_gpu_flag = false;
   if (n_nodes > 512) use_gpu_flag = true;
+  bool weighted = tempmem->weighted;
 
   memset(gain, 0, n_nodes * sizeof(float));
   int sparsetree_sz = sparsetree.size();
@@ -134,6 +183,14 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
     T *d_childmean = tempmem->d_child_pred->data();
     unsigned int *d_childcount = tempmem->d_child_count->data();
     T *d_childmetric = tempmem->d_child_best_metric->data();
+    T *d_wcount = nullptr, *d_parentwcount = nullptr, *d_childwcount = nullptr;
+    T *h_childwcount = nullptr;
+    if (weighted) {
+      d_wcount = tempmem->d_wcount->data();
+      d_parentwcount = tempmem->d_parent_wcount->data();
+      d_childwcount = tempmem->d_child_wcount->data();
+      h_childwcount = tempmem->h_child_wcount->data();
+    }
 
     for (int nodecnt = 0; nodecnt < n_nodes; nodecnt++) {
       int sparse_nodeid = sparse_nodelist[nodecnt];
@@ -148,7 +205,8 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
     get_best_split_regression_kernel<<<n_nodes, threads, 0, tempmem->stream>>>(
       d_mseout, d_predout, d_count, d_parentmean, d_parentcount, d_parentmetric,
       d_colids, nbins, ncols, n_nodes, min_rpn, d_outgain, d_split_colidx,
-      d_split_binidx, d_childmean, d_childcount, d_childmetric);
+      d_split_binidx, d_childmean, d_childcount, d_childmetric, d_wcount,
+      d_parentwcount, d_childwcount);
     CUDA_CHECK(cudaGetLastError());
 
     MLCommon::updateHost(h_childmetric, d_childmetric, 2 * n_nodes,
@@ -158,6 +216,10 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
                          tempmem->stream);
     MLCommon::updateHost(h_childcount, d_childcount, 2 * n_nodes,
                          tempmem->stream);
+    if (weighted) {
+      MLCommon::updateHost(h_childwcount, d_childwcount, 2 * n_nodes,
+                           tempmem->stream);
+    }
     MLCommon::updateHost(split_binidx, d_split_binidx, n_nodes,
                          tempmem->stream);
     MLCommon::updateHost(split_colidx, d_split_colidx, n_nodes,
@@ -177,6 +239,12 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
       sparse_countstate[curr_node.left_child_id] = h_childcount[nodecnt * 2];
       sparse_countstate[curr_node.left_child_id + 1] =
         h_childcount[nodecnt * 2 + 1];
+      if (weighted) {
+        sparse_wcountstate[curr_node.left_child_id] =
+          h_childwcount[nodecnt * 2];
+        sparse_wcountstate[curr_node.left_child_id + 1] =
+          h_childwcount[nodecnt * 2 + 1];
+      }
       SparseTreeNode<T, T> leftnode, rightnode;
       leftnode.best_metric_val = h_childmetric[nodecnt * 2];
       rightnode.best_metric_val = h_childmetric[nodecnt * 2 + 1];
@@ -188,6 +256,12 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
     MLCommon::updateHost(mseout, d_mseout, 2 * predcount, tempmem->stream);
     MLCommon::updateHost(predout, d_predout, predcount, tempmem->stream);
     MLCommon::updateHost(count, d_count, predcount, tempmem->stream);
+    T *wcount = nullptr;
+    if (weighted) {
+      wcount = tempmem->h_wcount->data();
+      MLCommon::updateHost(wcount, tempmem->d_wcount->data(), predcount,
+                           tempmem->stream);
+    }
     CUDA_CHECK(cudaStreamSynchronize(tempmem->stream));
     for (int nodecnt = 0; nodecnt < n_nodes; nodecnt++) {
       T bestmetric_left = 0;
@@ -202,8 +276,12 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
       T bestmean_right = 0;
       unsigned int bestcount_left = 0;
       unsigned int bestcount_right = 0;
+      T bestwcount_left = 0;
+      T bestwcount_right = 0;
       T parent_mean = sparse_meanstate[parentid];
       unsigned int parent_count = sparse_countstate[parentid];
+      T parent_weight =
+        weighted ? sparse_wcountstate[parentid] : (T)parent_count;
       for (int colid = 0; colid < ncols; colid++) {
         int coloff_mse = colid * nbins * 2 * n_nodes;
         int coloff_pred = colid * nbins * n_nodes;
@@ -218,17 +296,22 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
           unsigned int totalrows = tmp_lnrows + tmp_rnrows;
           if (tmp_lnrows == 0 || tmp_rnrows == 0 || totalrows < min_rpn)
             continue;
+          T tmp_lweight = weighted
+                            ? wcount[coloff_pred + binoff_pred + nodeoff_pred]
+                            : (T)tmp_lnrows;
+          T tmp_rweight = parent_weight - tmp_lweight;
+          if (tmp_lweight <= (T)0 || tmp_rweight <= (T)0) continue;
           T tmp_meanleft = predout[coloff_pred + binoff_pred + nodeoff_pred];
-          T tmp_meanright = parent_mean * parent_count - tmp_meanleft;
-          tmp_meanleft /= tmp_lnrows;
-          tmp_meanright /= tmp_rnrows;
+          T tmp_meanright = parent_mean * parent_weight - tmp_meanleft;
+          tmp_meanleft /= tmp_lweight;
+          tmp_meanright /= tmp_rweight;
           T tmp_mse_left =
-            mseout[coloff_mse + binoff_mse + nodeoff_mse] / tmp_lnrows;
+            mseout[coloff_mse + binoff_mse + nodeoff_mse] / tmp_lweight;
           T tmp_mse_right =
-            mseout[coloff_mse + binoff_mse + nodeoff_mse + 1] / tmp_rnrows;
+            mseout[coloff_mse + binoff_mse + nodeoff_mse + 1] / tmp_rweight;
 
-          T impurity = (tmp_lnrows * 1.0 / totalrows) * tmp_mse_left +
-                       (tmp_rnrows * 1.0 / totalrows) * tmp_mse_right;
+          T impurity = (tmp_lweight / parent_weight) * tmp_mse_left +
+                       (tmp_rweight / parent_weight) * tmp_mse_right;
           float info_gain =
             (float)(sparsetree[parentid].best_metric_val - impurity);
 
@@ -241,6 +324,8 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
             bestmean_right = tmp_meanright;
             bestcount_left = tmp_lnrows;
             bestcount_right = tmp_rnrows;
+            bestwcount_left = tmp_lweight;
+            bestwcount_right = tmp_rweight;
             bestmetric_left = tmp_mse_left;
             bestmetric_right = tmp_mse_right;
           }
@@ -258,6 +343,10 @@ void get_best_split_regression(T *mseout, T *d_mseout, T *predout, T *d_predout,
       sparse_meanstate[curr_node.left_child_id + 1] = bestmean_right;
       sparse_countstate[curr_node.left_child_id] = bestcount_left;
       sparse_countstate[curr_node.left_child_id + 1] = bestcount_right;
+      if (weighted) {
+        sparse_wcountstate[curr_node.left_child_id] = bestwcount_left;
+        sparse_wcountstate[curr_node.left_child_id + 1] = bestwcount_right;
+      }
       SparseTreeNode<T, T> leftnode, rightnode;
       leftnode.best_metric_val = bestmetric_left;
       rightnode.best_metric_val = bestmetric_right;
@@ -276,8 +365,9 @@ void leaf_eval_regression(float *gain, int curr_depth, const int max_depth,
                           const int max_leaves, unsigned int *new_node_flags,
                           std::vector<SparseTreeNode<T, T>> &sparsetree,
                           const int sparsesize, std::vector<T> &sparse_mean,
+                          std::vector<unsigned int> &sparse_count,
                           int &n_nodes_next, std::vector<int> &sparse_nodelist,
-                          int &tree_leaf_cnt) {
+                          int &tree_leaf_cnt, int *derive_from) {
   std::vector<int> tmp_sparse_nodelist(sparse_nodelist);
   sparse_nodelist.clear();
 
@@ -298,6 +388,9 @@ void leaf_eval_regression(float *gain, int curr_depth, const int max_depth,
     } else {
       sparse_nodelist.push_back(2 * i);
       sparse_nodelist.push_back(2 * i + 1);
+      int left_id = sparsetree[sparsesize + sparse_nodeid].left_child_id;
+      setup_subtraction_pair(derive_from, non_leaf_counter, i,
+                             sparse_count[left_id], sparse_count[left_id + 1]);
       node_flag = non_leaf_counter;
       non_leaf_counter++;
     }
@@ -311,6 +404,7 @@ void leaf_eval_regression(float *gain, int curr_depth, const int max_depth,
 template <typename T>
 void init_parent_value(std::vector<T> &sparse_meanstate,
                        std::vector<unsigned int> &sparse_countstate,
+                       std::vector<T> &sparse_wcountstate,
                        std::vector<int> &sparse_nodelist, const int sparsesize,
                        const int depth,
                        std::shared_ptr<TemporaryMemory<T, T>> tempmem) {
@@ -326,4 +420,12 @@ void init_parent_value(std::vector<T> &sparse_meanstate,
                          tempmem->stream);
   MLCommon::updateDevice(tempmem->d_parent_count->data(), h_count, n_nodes,
                          tempmem->stream);
+  if (tempmem->weighted) {
+    T *h_wcount = tempmem->h_wcount->data();
+    for (int i = 0; i < n_nodes; i++) {
+      h_wcount[i] = sparse_wcountstate[sparsesize + sparse_nodelist[i]];
+    }
+    MLCommon::updateDevice(tempmem->d_parent_wcount->data(), h_wcount,
+                           n_nodes, tempmem->stream);
+  }
 }
@@ -42,7 +42,32 @@ __global__ void sample_count_histogram_kernel(
   return;
 }
 
+template <typename T>
+__global__ void sample_weight_histogram_kernel(
+  const int* __restrict__ labels, const T* __restrict__ weights,
+  const int nrows, const int nmax, float* histout) {
+  int threadid = threadIdx.x + blockIdx.x * blockDim.x;
+  extern __shared__ float shmemwhist[];
+  for (int tid = threadIdx.x; tid < nmax; tid += blockDim.x) {
+    shmemwhist[tid] = 0.0f;
+  }
+
+  __syncthreads();
+
+  for (int tid = threadid; tid < nrows; tid += blockDim.x * gridDim.x) {
+    atomicAdd(&shmemwhist[labels[tid]], (float)weights[tid]);
+  }
+
+  __syncthreads();
+
+  for (int tid = threadIdx.x; tid < nmax; tid += blockDim.x) {
+    atomicAdd(&histout[tid], shmemwhist[tid]);
+  }
+  return;
+}
+
 //This kernel does histograms for all bins, all cols and all nodes at a given level
+//With weights, the weighted histogram is built next to the counts.
 template <typename T>
 __global__ void get_hist_kernel(
   const T* __restrict__ data, const int* __restrict__ labels,
@@ -50,17 +75,27 @@ __global__ void get_hist_kernel(
   const unsigned int* __restrict__ sample_cnt,
   const unsigned int* __restrict__ colids, const int nrows, const int ncols,
   const int n_unique_labels, const int nbins, const int n_nodes,
-  const T* __restrict__ quantile, unsigned int* histout) {
+  const T* __restrict__ quantile, const int* __restrict__ derive_from,
+  const unsigned char* __restrict__ colflags, const T* __restrict__ weights,
+  unsigned int* histout, float* whistout) {
   extern __shared__ unsigned int shmemhist[];
+  float* shmemwhist = (float*)(shmemhist + nbins * n_nodes * n_unique_labels);
   unsigned int local_flag = LEAF;
   int local_label = -1;
   int local_cnt;
+  float local_weight = 0.0f;
   int tid = threadIdx.x + blockIdx.x * blockDim.x;
 
   if (tid < nrows) {
     local_flag = flags[tid];
     local_label = labels[tid];
     local_cnt = sample_cnt[tid];
+    if (weights != nullptr) local_weight = weights[tid];
+  }
+  //Skip rows of nodes derived by histogram subtraction
+  if (colflags == nullptr && derive_from != nullptr && local_flag != LEAF &&
+      derive_from[local_flag] != -1) {
+    local_flag = LEAF;
   }
 
   for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
@@ -68,11 +103,14 @@ __global__ void get_hist_kernel(
     for (unsigned int i = threadIdx.x; i < nbins * n_nodes * n_unique_labels;
          i += blockDim.x) {
       shmemhist[i] = 0;
+      if (weights != nullptr) shmemwhist[i] = 0.0f;
     }
     __syncthreads();
 
-    //Check if leaf
-    if (local_flag != LEAF) {
+    //Check if leaf or column not built for this node
+    if (local_flag != LEAF &&
+        (colflags == nullptr ||
+         colflags[local_flag * ncols + colcnt] == COLBUILD)) {
       T local_data = data[tid + colid * nrows];
 
 #pragma unroll(8)
@@ -80,8 +118,9 @@ __global__ void get_hist_kernel(
         T quesval = quantile[colid * nbins + binid];
         if (local_data <= quesval) {
           unsigned int nodeoff = local_flag * nbins * n_unique_labels;
-          atomicAdd(&shmemhist[nodeoff + binid * n_unique_labels + local_label],
-                    local_cnt);
+          unsigned int histid = nodeoff + binid * n_unique_labels + local_label;
+          atomicAdd(&shmemhist[histid], local_cnt);
+          if (weights != nullptr) atomicAdd(&shmemwhist[histid], local_weight);
         }
       }
     }
@@ -91,6 +130,7 @@ __global__ void get_hist_kernel(
          i += blockDim.x) {
       unsigned int offset = colcnt * nbins * n_nodes * n_unique_labels;
       atomicAdd(&histout[offset + i], shmemhist[i]);
+      if (weights != nullptr) atomicAdd(&whistout[offset + i], shmemwhist[i]);
     }
     __syncthreads();
   }
@@ -107,7 +147,9 @@ __global__ void get_hist_kernel_global(
   const unsigned int* __restrict__ sample_cnt,
   const unsigned int* __restrict__ colids, const int nrows, const int ncols,
   const int n_unique_labels, const int nbins, const int n_nodes,
-  const T* __restrict__ quantile, unsigned int* histout) {
+  const T* __restrict__ quantile, const int* __restrict__ derive_from,
+  const unsigned char* __restrict__ colflags, const T* __restrict__ weights,
+  unsigned int* histout, float* whistout) {
   unsigned int local_flag;
   int local_label;
   int local_cnt;
@@ -117,10 +159,16 @@ __global__ void get_hist_kernel_global(
     local_flag = flags[tid];
     local_label = labels[tid];
     local_cnt = sample_cnt[tid];
+    if (colflags == nullptr && derive_from != nullptr && local_flag != LEAF &&
+        derive_from[local_flag] != -1) {
+      continue;
+    }
     for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
       unsigned int colid = colids[colcnt];
-      //Check if leaf
-      if (local_flag != LEAF) {
+      //Check if leaf or column not built for this node
+      if (local_flag != LEAF &&
+          (colflags == nullptr ||
+           colflags[local_flag * ncols + colcnt] == COLBUILD)) {
         T local_data = data[tid + colid * nrows];
         //Loop over nbins
 
@@ -130,9 +178,11 @@ __global__ void get_hist_kernel_global(
           if (local_data <= quesval) {
             unsigned int coloff = colcnt * nbins * n_nodes * n_unique_labels;
             unsigned int nodeoff = local_flag * nbins * n_unique_labels;
-            atomicAdd(&histout[coloff + nodeoff + binid * n_unique_labels +
-                               local_label],
-                      local_cnt);
+            unsigned int histid =
+              coloff + nodeoff + binid * n_unique_labels + local_label;
+            atomicAdd(&histout[histid], local_cnt);
+            if (weights != nullptr)
+              atomicAdd(&whistout[histid], (float)weights[tid]);
           }
         }
       }
@@ -149,6 +199,14 @@ struct GiniDevFunctor {
     }
     return gval;
   }
+  static DI float exec(float* hist, float nrows, int n_unique_labels) {
+    float gval = 1.0;
+    for (int i = 0; i < n_unique_labels; i++) {
+      float prob = hist[i] / nrows;
+      gval -= prob * prob;
+    }
+    return gval;
+  }
 };
 
 struct EntropyDevFunctor {
@@ -162,9 +220,21 @@ struct EntropyDevFunctor {
     }
     return (-1 * eval);
   }
+  static DI float exec(float* hist, float nrows, int n_unique_labels) {
+    float eval = 0.0;
+    for (int i = 0; i < n_unique_labels; i++) {
+      if (hist[i] > 0.0f) {
+        float prob = hist[i] / nrows;
+        eval += prob * logf(prob);
+      }
+    }
+    return (-1 * eval);
+  }
 };
 //This is device equialent of best split finding reduction.
 //Only kicks in when number of node is more than 512. otherwise we use CPU.
+//With weights (whist != nullptr) the impurity is computed on the weighted
+//histograms, while the row counts still decide empty splits and min_rpn.
 template <typename T, typename F>
 __global__ void get_best_split_classification_kernel(
   const unsigned int* __restrict__ hist,
@@ -173,7 +243,8 @@ __global__ void get_best_split_classification_kernel(
   const int nbins, const int ncols, const int n_nodes,
   const int n_unique_labels, const int min_rpn, float* outgain,
   int* best_col_id, int* best_bin_id, unsigned int* child_hist,
-  T* child_best_metric) {
+  T* child_best_metric, const float* __restrict__ whist,
+  const float* __restrict__ parent_whist, float* child_whist) {
   extern __shared__ unsigned int shmem_split_eval[];
   __shared__ int best_nrows[2];
   __shared__ GainIdxPair shared_pair;
@@ -188,11 +259,22 @@ __global__ void get_best_split_classification_kernel(
     &shmem_split_eval[2 * n_unique_labels * blockDim.x];
   unsigned int* parent_hist_local =
     &shmem_split_eval[2 * n_unique_labels * (blockDim.x + 1)];
+  float* shmem_wsplit_eval =
+    (float*)&shmem_split_eval[2 * n_unique_labels * (blockDim.x + 2)];
+  float* tmp_whistleft = &shmem_wsplit_eval[threadIdx.x * n_unique_labels];
+  float* tmp_whistright = &shmem_wsplit_eval[threadIdx.x * n_unique_labels +
+                                             blockDim.x * n_unique_labels];
+  float* best_split_whist =
+    &shmem_wsplit_eval[2 * n_unique_labels * blockDim.x];
+  float* parent_whist_local =
+    &shmem_wsplit_eval[2 * n_unique_labels * (blockDim.x + 1)];
+  __shared__ float best_wrows[2];
 
   for (unsigned int nodeid = blockIdx.x; nodeid < n_nodes;
        nodeid += gridDim.x) {
     if (threadIdx.x < 2) {
       best_nrows[threadIdx.x] = 0;
+      best_wrows[threadIdx.x] = 0.0f;
     }
 
     int nodeoffset = nodeid * nbins * n_unique_labels;
@@ -200,6 +282,8 @@ __global__ void get_best_split_classification_kernel(
 
     for (int j = threadIdx.x; j < n_unique_labels; j += blockDim.x) {
       parent_hist_local[j] = parent_hist[nodeid * n_unique_labels + j];
+      if (whist != nullptr)
+        parent_whist_local[j] = parent_whist[nodeid * n_unique_labels + j];
     }
 
     __syncthreads();
@@ -222,12 +306,33 @@ __global__ void get_best_split_classification_kernel(
       int totalrows = tmp_lnrows + tmp_rnrows;
       if (tmp_lnrows == 0 || tmp_rnrows == 0 || totalrows < min_rpn) continue;
 
-      float tmp_gini_left = F::exec(tmp_histleft, tmp_lnrows, n_unique_labels);
-      float tmp_gini_right =
-        F::exec(tmp_histright, tmp_rnrows, n_unique_labels);
-
-      float impurity = (tmp_lnrows * 1.0f / totalrows) * tmp_gini_left +
-                       (tmp_rnrows * 1.0f / totalrows) * tmp_gini_right;
+      float impurity;
+      if (whist != nullptr) {
+        float tmp_lweight = 0.0f;
+        float tmp_rweight = 0.0f;
+        for (int j = 0; j < n_unique_labels; j++) {
+          tmp_whistleft[j] = whist[coloffset + binoffset + nodeoffset + j];
+          tmp_lweight += tmp_whistleft[j];
+          tmp_whistright[j] =
+            fmaxf(parent_whist_local[j] - tmp_whistleft[j], 0.0f);
+          tmp_rweight += tmp_whistright[j];
+        }
+        if (tmp_lweight <= 0.0f || tmp_rweight <= 0.0f) continue;
+        float totalweight = tmp_lweight + tmp_rweight;
+        float tmp_gini_left =
+          F::exec(tmp_whistleft, tmp_lweight, n_unique_labels);
+        float tmp_gini_right =
+          F::exec(tmp_whistright, tmp_rweight, n_unique_labels);
+        impurity = (tmp_lweight / totalweight) * tmp_gini_left +
+                   (tmp_rweight / totalweight) * tmp_gini_right;
+      } else {
+        float tmp_gini_left =
+          F::exec(tmp_histleft, tmp_lnrows, n_unique_labels);
+        float tmp_gini_right =
+          F::exec(tmp_histright, tmp_rnrows, n_unique_labels);
+        impurity = (tmp_lnrows * 1.0f / totalrows) * tmp_gini_left +
+                   (tmp_rnrows * 1.0f / totalrows) * tmp_gini_right;
+      }
       float info_gain = parent_metric_local - impurity;
       if (info_gain > tid_pair.gain) {
         tid_pair.gain = info_gain;
@@ -262,17 +367,33 @@ __global__ void get_best_split_classification_kernel(
         atomicAdd(&best_nrows[0], val_left);
         best_split_hist[j + n_unique_labels] = val_right;
         atomicAdd(&best_nrows[1], val_right);
+        if (whist != nullptr) {
+          float wval_left = whist[coloffset + binoffset + nodeoffset + j];
+          float wval_right = fmaxf(parent_whist_local[j] - wval_left, 0.0f);
+          best_split_whist[j] = wval_left;
+          atomicAdd(&best_wrows[0], wval_left);
+          best_split_whist[j + n_unique_labels] = wval_right;
+          atomicAdd(&best_wrows[1], wval_right);
+        }
       }
       __syncthreads();
 
       for (int j = threadIdx.x; j < 2 * n_unique_labels; j += blockDim.x) {
         child_hist[2 * n_unique_labels * nodeid + j] = best_split_hist[j];
+        if (whist != nullptr)
+          child_whist[2 * n_unique_labels * nodeid + j] = best_split_whist[j];
       }
 
       if (threadIdx.x < 2) {
-        child_best_metric[2 * nodeid + threadIdx.x] =
-          F::exec(&best_split_hist[threadIdx.x * n_unique_labels],
-                  best_nrows[threadIdx.x], n_unique_labels);
+        if (whist != nullptr) {
+          child_best_metric[2 * nodeid + threadIdx.x] =
+            F::exec(&best_split_whist[threadIdx.x * n_unique_labels],
+                    best_wrows[threadIdx.x], n_unique_labels);
+        } else {
+          child_best_metric[2 * nodeid + threadIdx.x] =
+            F::exec(&best_split_hist[threadIdx.x * n_unique_labels],
+                    best_nrows[threadIdx.x], n_unique_labels);
+        }
       }
     }
   }
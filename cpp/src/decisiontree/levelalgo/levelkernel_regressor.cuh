@@ -20,14 +20,17 @@
 template <typename T>
 __global__ void pred_kernel_level(const T *__restrict__ labels,
                                   const unsigned int *__restrict__ sample_cnt,
-                                  const int nrows, T *predout,
-                                  unsigned int *countout) {
+                                  const int nrows,
+                                  const T *__restrict__ weights, T *predout,
+                                  unsigned int *countout, T *wcountout) {
   int threadid = threadIdx.x + blockIdx.x * blockDim.x;
   __shared__ T shmempred;
   __shared__ unsigned int shmemcnt;
+  __shared__ T shmemwcnt;
   if (threadIdx.x == 0) {
     shmempred = 0;
     shmemcnt = 0;
+    shmemwcnt = 0;
   }
   __syncthreads();
 
@@ -35,13 +38,20 @@ __global__ void pred_kernel_level(const T *__restrict__ labels,
     T label = labels[tid];
     unsigned int count = sample_cnt[tid];
     atomicAdd(&shmemcnt, count);
-    atomicAdd(&shmempred, label * count);
+    if (weights != nullptr) {
+      T weight = weights[tid];
+      atomicAdd(&shmemwcnt, weight);
+      atomicAdd(&shmempred, label * weight);
+    } else {
+      atomicAdd(&shmempred, label * count);
+    }
   }
   __syncthreads();
 
   if (threadIdx.x == 0) {
     atomicAdd(predout, shmempred);
     atomicAdd(countout, shmemcnt);
+    if (weights != nullptr) atomicAdd(wcountout, shmemwcnt);
   }
   return;
 }
@@ -49,19 +59,23 @@ __global__ void pred_kernel_level(const T *__restrict__ labels,
 template <typename T, typename F>
 __global__ void mse_kernel_level(const T *__restrict__ labels,
                                  const unsigned int *__restrict__ sample_cnt,
-                                 const int nrows, const T *predout,
-                                 const unsigned int *count, T *mseout) {
+                                 const int nrows,
+                                 const T *__restrict__ weights,
+                                 const T *predout, const unsigned int *count,
+                                 const T *wcount, T *mseout) {
   int threadid = threadIdx.x + blockIdx.x * blockDim.x;
   __shared__ T shmemmse;
   if (threadIdx.x == 0) shmemmse = 0;
   __syncthreads();
 
-  T mean = predout[0] / count[0];
+  T mean = predout[0];
+  mean /= (weights != nullptr) ? wcount[0] : (T)count[0];
   for (int tid = threadid; tid < nrows; tid += blockDim.x * gridDim.x) {
     T label = labels[tid];
-    unsigned int local_count = sample_cnt[tid];
+    T local_weight =
+      (weights != nullptr) ? weights[tid] : (T)sample_cnt[tid];
     T value = F::exec(label - mean);
-    atomicAdd(&shmemmse, local_count * value);
+    atomicAdd(&shmemmse, local_weight * value);
   }
 
   __syncthreads();
@@ -80,21 +94,35 @@ __global__ void get_pred_kernel(const T *__restrict__ data,
                                 const unsigned int *__restrict__ colids,
                                 const int nrows, const int ncols,
                                 const int nbins, const int n_nodes,
-                                const T *__restrict__ quantile, T *predout,
-                                unsigned int *countout) {
+                                const T *__restrict__ quantile,
+                                const int *__restrict__ derive_from,
+                                const unsigned char *__restrict__ colflags,
+                                const T *__restrict__ weights, T *predout,
+                                unsigned int *countout, T *wcountout) {
   extern __shared__ char shmem_pred_kernel[];
   T *shmempred = (T *)shmem_pred_kernel;
+  T *shmemwcount = (T *)(&shmem_pred_kernel[nbins * n_nodes * sizeof(T)]);
+  //Weighted counts sit between the sums and the counts when present
+  int count_off =
+    (weights != nullptr) ? 2 * nbins * n_nodes : nbins * n_nodes;
   unsigned int *shmemcount =
-    (unsigned int *)(&shmem_pred_kernel[nbins * n_nodes * sizeof(T)]);
+    (unsigned int *)(&shmem_pred_kernel[count_off * sizeof(T)]);
   unsigned int local_flag = LEAF;
   T local_label;
   int local_cnt;
+  T local_weight;
   int tid = threadIdx.x + blockIdx.x * blockDim.x;
 
   if (tid < nrows) {
     local_flag = flags[tid];
     local_label = labels[tid];
     local_cnt = sample_cnt[tid];
+    local_weight = (weights != nullptr) ? weights[tid] : (T)local_cnt;
+  }
+  //Skip rows of nodes derived by histogram subtraction
+  if (colflags == nullptr && derive_from != nullptr && local_flag != LEAF &&
+      derive_from[local_flag] != -1) {
+    local_flag = LEAF;
   }
 
   for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
@@ -102,11 +130,14 @@ __global__ void get_pred_kernel(const T *__restrict__ data,
     for (unsigned int i = threadIdx.x; i < nbins * n_nodes; i += blockDim.x) {
       shmempred[i] = (T)0;
       shmemcount[i] = 0;
+      if (weights != nullptr) shmemwcount[i] = (T)0;
     }
     __syncthreads();
 
-    //Check if leaf
-    if (local_flag != LEAF) {
+    //Check if leaf or column not built for this node
+    if (local_flag != LEAF &&
+        (colflags == nullptr ||
+         colflags[local_flag * ncols + colcnt] == COLBUILD)) {
       T local_data = data[tid + colid * nrows];
 
 #pragma unroll(8)
@@ -114,8 +145,10 @@ __global__ void get_pred_kernel(const T *__restrict__ data,
         T quesval = quantile[colid * nbins + binid];
         if (local_data <= quesval) {
           unsigned int nodeoff = local_flag * nbins;
-          atomicAdd(&shmempred[nodeoff + binid], local_label * local_cnt);
+          atomicAdd(&shmempred[nodeoff + binid], local_label * local_weight);
           atomicAdd(&shmemcount[nodeoff + binid], local_cnt);
+          if (weights != nullptr)
+            atomicAdd(&shmemwcount[nodeoff + binid], local_weight);
         }
       }
     }
@@ -125,6 +158,7 @@ __global__ void get_pred_kernel(const T *__restrict__ data,
       unsigned int offset = colcnt * nbins * n_nodes;
       atomicAdd(&predout[offset + i], shmempred[i]);
       atomicAdd(&countout[offset + i], shmemcount[i]);
+      if (weights != nullptr) atomicAdd(&wcountout[offset + i], shmemwcount[i]);
     }
     __syncthreads();
   }
@@ -140,29 +174,41 @@ __global__ void get_mse_kernel(
   const int nbins, const int n_nodes, const T *__restrict__ quantile,
   const T *__restrict__ parentpred,
   const unsigned int *__restrict__ parentcount, const T *__restrict__ predout,
-  const unsigned int *__restrict__ countout, T *mseout) {
+  const unsigned int *__restrict__ countout,
+  const unsigned char *__restrict__ colflags, const T *__restrict__ weights,
+  const T *__restrict__ parentwcount, const T *__restrict__ wcountout,
+  T *mseout) {
   extern __shared__ char shmem_mse_kernel[];
   T *shmem_predout = (T *)(shmem_mse_kernel);
   T *shmem_mse = (T *)(shmem_mse_kernel + n_nodes * nbins * sizeof(T));
+  T *shmem_wcountout =
+    (T *)(shmem_mse_kernel + 3 * n_nodes * nbins * sizeof(T));
+  int count_off =
+    (weights != nullptr) ? 4 * nbins * n_nodes : 3 * nbins * n_nodes;
   unsigned int *shmem_countout =
-    (unsigned int *)(shmem_mse_kernel + 3 * n_nodes * nbins * sizeof(T));
+    (unsigned int *)(shmem_mse_kernel + count_off * sizeof(T));
 
   unsigned int local_flag = LEAF;
   T local_label;
-  int local_cnt;
+  T local_weight;
   int tid = threadIdx.x + blockIdx.x * blockDim.x;
   T parent_pred;
-  unsigned int parent_count;
+  T parent_count;
 
   if (tid < nrows) {
     local_flag = flags[tid];
   }
 
   if (local_flag != LEAF) {
-    parent_count = parentcount[local_flag];
     parent_pred = parentpred[local_flag];
     local_label = labels[tid];
-    local_cnt = sample_cnt[tid];
+    if (weights != nullptr) {
+      parent_count = parentwcount[local_flag];
+      local_weight = weights[tid];
+    } else {
+      parent_count = (T)parentcount[local_flag];
+      local_weight = (T)sample_cnt[tid];
+    }
   }
 
   for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
@@ -170,7 +216,11 @@ __global__ void get_mse_kernel(
     unsigned int coloff = colcnt * nbins * n_nodes;
     for (unsigned int i = threadIdx.x; i < nbins * n_nodes; i += blockDim.x) {
       shmem_predout[i] = predout[i + coloff];
-      shmem_countout[i] = countout[i + coloff];
+      if (weights != nullptr) {
+        shmem_wcountout[i] = wcountout[i + coloff];
+      } else {
+        shmem_countout[i] = countout[i + coloff];
+      }
     }
 
     for (unsigned int i = threadIdx.x; i < 2 * nbins * n_nodes;
@@ -179,24 +229,28 @@ __global__ void get_mse_kernel(
     }
     __syncthreads();
 
-    //Check if leaf
-    if (local_flag != LEAF) {
+    //Check if leaf or column not sampled for this node
+    if (local_flag != LEAF &&
+        (colflags == nullptr ||
+         colflags[local_flag * ncols + colcnt] != COLSKIP)) {
       T local_data = data[tid + colid * nrows];
 #pragma unroll(8)
       for (unsigned int binid = 0; binid < nbins; binid++) {
         T quesval = quantile[colid * nbins + binid];
         unsigned int nodeoff = local_flag * nbins;
         T local_pred = shmem_predout[nodeoff + binid];
-        unsigned int local_count = shmem_countout[nodeoff + binid];
+        T local_count = (weights != nullptr)
+                          ? shmem_wcountout[nodeoff + binid]
+                          : (T)shmem_countout[nodeoff + binid];
         if (local_data <= quesval) {
           T leftmean = local_pred / local_count;
           atomicAdd(&shmem_mse[2 * (nodeoff + binid)],
-                    local_cnt * F::exec(local_label - leftmean));
+                    local_weight * F::exec(local_label - leftmean));
         } else {
           T rightmean = parent_pred * parent_count - local_pred;
           rightmean = rightmean / (parent_count - local_count);
           atomicAdd(&shmem_mse[2 * (nodeoff + binid) + 1],
-                    local_cnt * F::exec(local_label - rightmean));
+                    local_weight * F::exec(local_label - rightmean));
         }
       }
     }
@@ -219,20 +273,31 @@ __global__ void get_pred_kernel_global(
   const unsigned int *__restrict__ sample_cnt,
   const unsigned int *__restrict__ colids, const int nrows, const int ncols,
   const int nbins, const int n_nodes, const T *__restrict__ quantile,
-  T *predout, unsigned int *countout) {
+  const int *__restrict__ derive_from,
+  const unsigned char *__restrict__ colflags, const T *__restrict__ weights,
+  T *predout, unsigned int *countout, T *wcountout) {
   unsigned int local_flag = LEAF;
   T local_label;
   int local_cnt;
+  T local_weight;
   int threadid = threadIdx.x + blockIdx.x * blockDim.x;
 
   for (int tid = threadid; tid < nrows; tid += blockDim.x * gridDim.x) {
     local_flag = flags[tid];
-    //Check if leaf
+    //Check if leaf or derived by histogram subtraction
+    if (colflags == nullptr && derive_from != nullptr && local_flag != LEAF &&
+        derive_from[local_flag] != -1) {
+      local_flag = LEAF;
+    }
     if (local_flag != LEAF) {
       local_label = labels[tid];
       local_cnt = sample_cnt[tid];
+      local_weight = (weights != nullptr) ? weights[tid] : (T)local_cnt;
 
       for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
+        if (colflags != nullptr &&
+            colflags[local_flag * ncols + colcnt] != COLBUILD)
+          continue;
         unsigned int colid = colids[colcnt];
         unsigned int coloffset = colcnt * nbins * n_nodes;
         T local_data = data[tid + colid * nrows];
@@ -243,8 +308,10 @@ __global__ void get_pred_kernel_global(
           if (local_data <= quesval) {
             unsigned int nodeoff = local_flag * nbins;
             atomicAdd(&predout[coloffset + nodeoff + binid],
-                      local_label * local_cnt);
+                      local_label * local_weight);
             atomicAdd(&countout[coloffset + nodeoff + binid], local_cnt);
+            if (weights != nullptr)
+              atomicAdd(&wcountout[coloffset + nodeoff + binid], local_weight);
           }
         }
       }
@@ -263,24 +330,35 @@ __global__ void get_mse_kernel_global(
   const int nbins, const int n_nodes, const T *__restrict__ quantile,
   const T *__restrict__ parentpred,
   const unsigned int *__restrict__ parentcount, const T *__restrict__ predout,
-  const unsigned int *__restrict__ countout, T *mseout) {
+  const unsigned int *__restrict__ countout,
+  const unsigned char *__restrict__ colflags, const T *__restrict__ weights,
+  const T *__restrict__ parentwcount, const T *__restrict__ wcountout,
+  T *mseout) {
   unsigned int local_flag = LEAF;
   T local_label;
-  int local_cnt;
+  T local_weight;
   int threadid = threadIdx.x + blockIdx.x * blockDim.x;
   T parent_pred;
-  unsigned int parent_count;
+  T parent_count;
 
   for (int tid = threadid; tid < nrows; tid += gridDim.x * blockDim.x) {
     local_flag = flags[tid];
     local_label = labels[tid];
-    local_cnt = sample_cnt[tid];
 
     if (local_flag != LEAF) {
-      parent_count = parentcount[local_flag];
       parent_pred = parentpred[local_flag];
+      if (weights != nullptr) {
+        parent_count = parentwcount[local_flag];
+        local_weight = weights[tid];
+      } else {
+        parent_count = (T)parentcount[local_flag];
+        local_weight = (T)sample_cnt[tid];
+      }
 
       for (unsigned int colcnt = 0; colcnt < ncols; colcnt++) {
+        if (colflags != nullptr &&
+            colflags[local_flag * ncols + colcnt] == COLSKIP)
+          continue;
         unsigned int colid = colids[colcnt];
         unsigned int coloff = colcnt * nbins * n_nodes;
         T local_data = data[tid + colid * nrows];
@@ -289,16 +367,18 @@ __global__ void get_mse_kernel_global(
           T quesval = quantile[colid * nbins + binid];
           unsigned int nodeoff = local_flag * nbins;
           T local_pred = predout[coloff + nodeoff + binid];
-          unsigned int local_count = countout[coloff + nodeoff + binid];
+          T local_count = (weights != nullptr)
+                            ? wcountout[coloff + nodeoff + binid]
+                            : (T)countout[coloff + nodeoff + binid];
           if (local_data <= quesval) {
             T leftmean = local_pred / local_count;
             atomicAdd(&mseout[2 * (coloff + nodeoff + binid)],
-                      local_cnt * F::exec(local_label - leftmean));
+                      local_weight * F::exec(local_label - leftmean));
           } else {
             T rightmean = parent_pred * parent_count - local_pred;
             rightmean = rightmean / (parent_count - local_count);
             atomicAdd(&mseout[2 * (coloff + nodeoff + binid) + 1],
-                      local_cnt * F::exec(local_label - rightmean));
+                      local_weight * F::exec(local_label - rightmean));
           }
         }
       }
@@ -306,6 +386,8 @@ __global__ void get_mse_kernel_global(
   }
 }
 //This is device version of best split in case, used when more than 512 nodes.
+//With weights (wcount != nullptr) means and impurities use the sums of
+//weights, while the row counts still decide empty splits and min_rpn.
 template <typename T>
 __global__ void get_best_split_regression_kernel(
   const T *__restrict__ mseout, const T *__restrict__ predout,
@@ -314,7 +396,9 @@ __global__ void get_best_split_regression_kernel(
   const T *__restrict__ parentmetric, const unsigned int *__restrict__ colids,
   const int nbins, const int ncols, const int n_nodes, const int min_rpn,
   float *outgain, int *best_col_id, int *best_bin_id, T *child_mean,
-  unsigned int *child_count, T *child_best_metric) {
+  unsigned int *child_count, T *child_best_metric,
+  const T *__restrict__ wcount, const T *__restrict__ parentwcount,
+  T *child_wcount) {
   typedef cub::BlockReduce<GainIdxPair, 64> BlockReduce;
   __shared__ typename BlockReduce::TempStorage temp_storage;
 
@@ -322,6 +406,8 @@ __global__ void get_best_split_regression_kernel(
        nodeid += gridDim.x) {
     T parent_mean = parentmean[nodeid];
     unsigned int parent_count = parentcount[nodeid];
+    T parent_weight =
+      (wcount != nullptr) ? parentwcount[nodeid] : (T)parent_count;
     T parent_metric = parentmetric[nodeid];
     int nodeoffset = nodeid * nbins;
     GainIdxPair tid_pair;
@@ -335,15 +421,15 @@ __global__ void get_best_split_regression_kernel(
       unsigned int tmp_rnrows = parent_count - tmp_lnrows;
       unsigned int totalrows = tmp_lnrows + tmp_rnrows;
       if (tmp_lnrows == 0 || tmp_rnrows == 0 || totalrows < min_rpn) continue;
-      T tmp_meanleft = predout[threadoffset];
-      T tmp_meanright = parent_mean * parent_count - tmp_meanleft;
-      tmp_meanleft /= tmp_lnrows;
-      tmp_meanright /= tmp_rnrows;
-      T tmp_mse_left = mseout[2 * threadoffset] / tmp_lnrows;
-      T tmp_mse_right = mseout[2 * threadoffset + 1] / tmp_rnrows;
-
-      T impurity = (tmp_lnrows * 1.0 / totalrows) * tmp_mse_left +
-                   (tmp_rnrows * 1.0 / totalrows) * tmp_mse_right;
+      T tmp_lweight =
+        (wcount != nullptr) ? wcount[threadoffset] : (T)tmp_lnrows;
+      T tmp_rweight = parent_weight - tmp_lweight;
+      if (tmp_lweight <= (T)0 || tmp_rweight <= (T)0) continue;
+      T tmp_mse_left = mseout[2 * threadoffset] / tmp_lweight;
+      T tmp_mse_right = mseout[2 * threadoffset + 1] / tmp_rweight;
+
+      T impurity = (tmp_lweight / parent_weight) * tmp_mse_left +
+                   (tmp_rweight / parent_weight) * tmp_mse_right;
       float info_gain = (float)(parent_metric - impurity);
 
       if (info_gain > tid_pair.gain) {
@@ -367,13 +453,20 @@ __global__ void get_best_split_regression_kernel(
         child_count[2 * nodeid] = tmp_lnrows;
         unsigned int tmp_rnrows = parent_count - tmp_lnrows;
         child_count[2 * nodeid + 1] = tmp_rnrows;
+        T tmp_lweight =
+          (wcount != nullptr) ? wcount[threadoffset] : (T)tmp_lnrows;
+        T tmp_rweight = parent_weight - tmp_lweight;
+        if (wcount != nullptr) {
+          child_wcount[2 * nodeid] = tmp_lweight;
+          child_wcount[2 * nodeid + 1] = tmp_rweight;
+        }
         T tmp_meanleft = predout[threadoffset];
-        child_mean[2 * nodeid] = tmp_meanleft / tmp_lnrows;
+        child_mean[2 * nodeid] = tmp_meanleft / tmp_lweight;
         child_mean[2 * nodeid + 1] =
-          (parent_mean * parent_count - tmp_meanleft) / tmp_rnrows;
-        child_best_metric[2 * nodeid] = mseout[2 * threadoffset] / tmp_lnrows;
+          (parent_mean * parent_weight - tmp_meanleft) / tmp_rweight;
+        child_best_metric[2 * nodeid] = mseout[2 * threadoffset] / tmp_lweight;
         child_best_metric[2 * nodeid + 1] =
-          mseout[2 * threadoffset + 1] / tmp_rnrows;
+          mseout[2 * threadoffset + 1] / tmp_rweight;
       }
     }
   }
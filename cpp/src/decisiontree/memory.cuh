@@ -23,11 +23,13 @@
 template <class T, class L>
 TemporaryMemory<T, L>::TemporaryMemory(const ML::cumlHandle_impl& handle, int N,
                                        int Ncols, int n_unique, int n_bins,
-                                       const int split_algo, int depth)
+                                       const int split_algo, int depth,
+                                       bool cfg_weighted)
   : ml_handle(handle) {
   //Assign Stream from cumlHandle
   stream = ml_handle.getStream();
   splitalgo = split_algo;
+  weighted = cfg_weighted;
 
   cudaDeviceProp prop;
   CUDA_CHECK(cudaGetDeviceProperties(&prop, ml_handle.getDevice()));
@@ -233,9 +235,28 @@ void TemporaryMemory<T, L>::LevelMemAllocator(int nrows, int ncols,
     ml_handle.getDeviceAllocator(), stream, nrows);
   d_colids = new MLCommon::device_buffer<unsigned int>(
     ml_handle.getDeviceAllocator(), stream, ncols);
+  h_derive_from = new MLCommon::host_buffer<int>(ml_handle.getHostAllocator(),
+                                                 stream, 2 * maxnodes);
+  d_derive_from = new MLCommon::device_buffer<int>(
+    ml_handle.getDeviceAllocator(), stream, 2 * maxnodes);
+  d_colflags = new MLCommon::device_buffer<unsigned char>(
+    ml_handle.getDeviceAllocator(), stream, maxnodes * ncols);
+  d_colflags_parent = new MLCommon::device_buffer<unsigned char>(
+    ml_handle.getDeviceAllocator(), stream, maxnodes * ncols);
+  h_nodeids = new MLCommon::host_buffer<int>(ml_handle.getHostAllocator(),
+                                             stream, maxnodes);
+  d_nodeids = new MLCommon::device_buffer<int>(ml_handle.getDeviceAllocator(),
+                                               stream, maxnodes);
+
+  if (weighted) {
+    d_sample_weight = new MLCommon::device_buffer<T>(
+      ml_handle.getDeviceAllocator(), stream, nrows);
+    totalmem += nrows * sizeof(T);
+  }
 
   totalmem += nrows * 2 * sizeof(unsigned int);
-  totalmem += maxnodes * 3 * sizeof(int);
+  totalmem += maxnodes * 6 * sizeof(int);
+  totalmem += 2 * maxnodes * ncols * sizeof(unsigned char);
   totalmem += maxnodes * sizeof(float);
   totalmem += 3 * maxnodes * sizeof(T);
   totalmem += ncols * sizeof(int);
@@ -248,6 +269,10 @@ void TemporaryMemory<T, L>::LevelMemAllocator(int nrows, int ncols,
       ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
     d_count = new MLCommon::device_buffer<unsigned int>(
       ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
+    d_predout_parent = new MLCommon::device_buffer<T>(
+      ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
+    d_count_parent = new MLCommon::device_buffer<unsigned int>(
+      ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
     d_parent_pred = new MLCommon::device_buffer<T>(
       ml_handle.getDeviceAllocator(), stream, maxnodes);
     d_parent_count = new MLCommon::device_buffer<unsigned int>(
@@ -267,10 +292,27 @@ void TemporaryMemory<T, L>::LevelMemAllocator(int nrows, int ncols,
     h_child_count = new MLCommon::host_buffer<unsigned int>(
       ml_handle.getHostAllocator(), stream, 2 * maxnodes);
 
-    totalmem += 3 * nbins * ncols * maxnodes * sizeof(T);
-    totalmem += nbins * ncols * maxnodes * sizeof(unsigned int);
+    totalmem += 4 * nbins * ncols * maxnodes * sizeof(T);
+    totalmem += 2 * nbins * ncols * maxnodes * sizeof(unsigned int);
     totalmem += 3 * maxnodes * sizeof(T);
     totalmem += 3 * maxnodes * sizeof(unsigned int);
+
+    if (weighted) {
+      d_wcount = new MLCommon::device_buffer<T>(
+        ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
+      d_wcount_parent = new MLCommon::device_buffer<T>(
+        ml_handle.getDeviceAllocator(), stream, nbins * ncols * maxnodes);
+      h_wcount = new MLCommon::host_buffer<T>(ml_handle.getHostAllocator(),
+                                              stream, nbins * ncols * maxnodes);
+      d_parent_wcount = new MLCommon::device_buffer<T>(
+        ml_handle.getDeviceAllocator(), stream, maxnodes);
+      d_child_wcount = new MLCommon::device_buffer<T>(
+        ml_handle.getDeviceAllocator(), stream, 2 * maxnodes);
+      h_child_wcount = new MLCommon::host_buffer<T>(
+        ml_handle.getHostAllocator(), stream, 2 * maxnodes);
+      totalmem += 2 * nbins * ncols * maxnodes * sizeof(T);
+      totalmem += 3 * maxnodes * sizeof(T);
+    }
   }
 
   //Classification
@@ -278,6 +320,8 @@ void TemporaryMemory<T, L>::LevelMemAllocator(int nrows, int ncols,
     size_t histcount = ncols * nbins * n_unique * maxnodes;
     d_histogram = new MLCommon::device_buffer<unsigned int>(
       ml_handle.getDeviceAllocator(), stream, histcount);
+    d_histogram_parent = new MLCommon::device_buffer<unsigned int>(
+      ml_handle.getDeviceAllocator(), stream, histcount);
     h_histogram = new MLCommon::host_buffer<unsigned int>(
       ml_handle.getHostAllocator(), stream, histcount);
     h_parent_hist = new MLCommon::host_buffer<unsigned int>(
@@ -288,16 +332,38 @@ void TemporaryMemory<T, L>::LevelMemAllocator(int nrows, int ncols,
       ml_handle.getDeviceAllocator(), stream, maxnodes * n_unique);
     d_child_hist = new MLCommon::device_buffer<unsigned int>(
       ml_handle.getDeviceAllocator(), stream, 2 * maxnodes * n_unique);
-    totalmem += histcount * sizeof(unsigned int);
+    totalmem += 2 * histcount * sizeof(unsigned int);
     totalmem += n_unique * maxnodes * 3 * sizeof(unsigned int);
+
+    if (weighted) {
+      d_whistogram = new MLCommon::device_buffer<float>(
+        ml_handle.getDeviceAllocator(), stream, histcount);
+      d_whistogram_parent = new MLCommon::device_buffer<float>(
+        ml_handle.getDeviceAllocator(), stream, histcount);
+      h_whistogram = new MLCommon::host_buffer<float>(
+        ml_handle.getHostAllocator(), stream, histcount);
+      h_parent_whist = new MLCommon::host_buffer<float>(
+        ml_handle.getHostAllocator(), stream, maxnodes * n_unique);
+      h_child_whist = new MLCommon::host_buffer<float>(
+        ml_handle.getHostAllocator(), stream, 2 * maxnodes * n_unique);
+      d_parent_whist = new MLCommon::device_buffer<float>(
+        ml_handle.getDeviceAllocator(), stream, maxnodes * n_unique);
+      d_child_whist = new MLCommon::device_buffer<float>(
+        ml_handle.getDeviceAllocator(), stream, 2 * maxnodes * n_unique);
+      totalmem += 2 * histcount * sizeof(float);
+      totalmem += n_unique * maxnodes * 3 * sizeof(float);
+    }
   }
   //Calculate Max nodes in shared memory.
   if (typeid(L) == typeid(int)) {
-    max_nodes_class = max_shared_mem / (nbins * n_unique * sizeof(int));
+    size_t pernode_class = nbins * n_unique * sizeof(int);
+    if (weighted) pernode_class += nbins * n_unique * sizeof(float);
+    max_nodes_class = max_shared_mem / pernode_class;
     max_nodes_class /= 2;  // For occupancy purposes.
   }
   if (typeid(L) == typeid(T)) {
     size_t pernode_pred = nbins * (sizeof(T) + sizeof(unsigned int));
+    if (weighted) pernode_pred += nbins * sizeof(T);
     max_nodes_pred = max_shared_mem / pernode_pred;
     max_nodes_mse = max_shared_mem / (pernode_pred + 2 * nbins * sizeof(T));
     max_nodes_pred /= 2;  // For occupancy purposes.
@@ -324,6 +390,12 @@ void TemporaryMemory<T, L>::LevelMemCleaner() {
   d_quantile->release(stream);
   d_sample_cnt->release(stream);
   d_colids->release(stream);
+  h_derive_from->release(stream);
+  d_derive_from->release(stream);
+  d_colflags->release(stream);
+  d_colflags_parent->release(stream);
+  h_nodeids->release(stream);
+  d_nodeids->release(stream);
   delete h_new_node_flags;
   delete d_new_node_flags;
   delete h_split_colidx;
@@ -341,20 +413,48 @@ void TemporaryMemory<T, L>::LevelMemCleaner() {
   delete d_quantile;
   delete d_sample_cnt;
   delete d_colids;
+  delete h_derive_from;
+  delete d_derive_from;
+  delete d_colflags;
+  delete d_colflags_parent;
+  delete h_nodeids;
+  delete d_nodeids;
+  if (weighted) {
+    d_sample_weight->release(stream);
+    delete d_sample_weight;
+  }
   //Classification
   if (typeid(L) == typeid(int)) {
     h_histogram->release(stream);
     d_histogram->release(stream);
+    d_histogram_parent->release(stream);
     h_parent_hist->release(stream);
     h_child_hist->release(stream);
     d_parent_hist->release(stream);
     d_child_hist->release(stream);
     delete d_histogram;
+    delete d_histogram_parent;
     delete h_histogram;
     delete h_parent_hist;
     delete h_child_hist;
     delete d_parent_hist;
     delete d_child_hist;
+    if (weighted) {
+      d_whistogram->release(stream);
+      d_whistogram_parent->release(stream);
+      h_whistogram->release(stream);
+      h_parent_whist->release(stream);
+      h_child_whist->release(stream);
+      d_parent_whist->release(stream);
+      d_child_whist->release(stream);
+      delete d_whistogram;
+      delete d_whistogram_parent;
+      delete h_whistogram;
+      delete h_parent_whist;
+      delete h_child_whist;
+      delete d_parent_whist;
+      delete d_child_whist;
+    }
   }
   //Regression
   if (typeid(L) == typeid(T)) {
@@ -363,6 +463,8 @@ void TemporaryMemory<T, L>::LevelMemCleaner() {
     d_mseout->release(stream);
     d_predout->release(stream);
     d_count->release(stream);
+    d_predout_parent->release(stream);
+    d_count_parent->release(stream);
     h_mseout->release(stream);
     h_predout->release(stream);
     h_count->release(stream);
@@ -371,8 +473,24 @@ void TemporaryMemory<T, L>::LevelMemCleaner() {
     delete d_mseout;
     delete d_predout;
     delete d_count;
+    delete d_predout_parent;
+    delete d_count_parent;
     delete h_mseout;
     delete h_predout;
     delete h_count;
+    if (weighted) {
+      d_wcount->release(stream);
+      d_wcount_parent->release(stream);
+      h_wcount->release(stream);
+      d_parent_wcount->release(stream);
+      d_child_wcount->release(stream);
+      h_child_wcount->release(stream);
+      delete d_wcount;
+      delete d_wcount_parent;
+      delete h_wcount;
+      delete d_parent_wcount;
+      delete d_child_wcount;
+      delete h_child_wcount;
+    }
   }
 }
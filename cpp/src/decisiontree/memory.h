@@ -75,6 +75,38 @@ struct TemporaryMemory {
   MLCommon::device_buffer<unsigned int> *d_flags = nullptr;
   MLCommon::device_buffer<unsigned int> *d_histogram = nullptr;
   MLCommon::host_buffer<unsigned int> *h_histogram = nullptr;
+  // Previous level histograms, kept on device for histogram subtraction
+  MLCommon::device_buffer<unsigned int> *d_histogram_parent = nullptr;
+  // Per node parent id at previous level if the node histogram is derived
+  // as parent - sibling, -1 if it is built from the data.
+  MLCommon::host_buffer<int> *h_derive_from = nullptr;
+  MLCommon::device_buffer<int> *d_derive_from = nullptr;
+  // Per node and column flags (COLSKIP, COLBUILD, COLDERIVE) for per node
+  // feature subsampling, for current and previous level.
+  MLCommon::device_buffer<unsigned char> *d_colflags = nullptr;
+  MLCommon::device_buffer<unsigned char> *d_colflags_parent = nullptr;
+  // Sparse tree ids of the nodes at current level, used to seed the sampling
+  MLCommon::host_buffer<int> *h_nodeids = nullptr;
+  MLCommon::device_buffer<int> *d_nodeids = nullptr;
+  // Per row weight: bootstrap count times sample weight and class weight
+  MLCommon::device_buffer<T> *d_sample_weight = nullptr;
+  // Weighted class histograms (classification) and sums of weights
+  // (regression) next to the row counts. Only allocated when fitting with
+  // sample or class weights; the row counts still drive the split structure.
+  bool weighted = false;
+  MLCommon::device_buffer<float> *d_whistogram = nullptr;
+  MLCommon::device_buffer<float> *d_whistogram_parent = nullptr;
+  MLCommon::host_buffer<float> *h_whistogram = nullptr;
+  MLCommon::host_buffer<float> *h_parent_whist = nullptr;
+  MLCommon::host_buffer<float> *h_child_whist = nullptr;
+  MLCommon::device_buffer<float> *d_parent_whist = nullptr;
+  MLCommon::device_buffer<float> *d_child_whist = nullptr;
+  MLCommon::device_buffer<T> *d_wcount = nullptr;
+  MLCommon::device_buffer<T> *d_wcount_parent = nullptr;
+  MLCommon::host_buffer<T> *h_wcount = nullptr;
+  MLCommon::device_buffer<T> *d_parent_wcount = nullptr;
+  MLCommon::device_buffer<T> *d_child_wcount = nullptr;
+  MLCommon::host_buffer<T> *h_child_wcount = nullptr;
   MLCommon::host_buffer<int> *h_split_colidx = nullptr;
   MLCommon::host_buffer<int> *h_split_binidx = nullptr;
   MLCommon::device_buffer<int> *d_split_colidx = nullptr;
@@ -99,6 +131,8 @@ struct TemporaryMemory {
   MLCommon::device_buffer<unsigned int> *d_child_count = nullptr;
   MLCommon::device_buffer<unsigned int> *d_count = nullptr;
   MLCommon::host_buffer<unsigned int> *h_count = nullptr;
+  MLCommon::device_buffer<T> *d_predout_parent = nullptr;
+  MLCommon::device_buffer<unsigned int> *d_count_parent = nullptr;
   MLCommon::host_buffer<T> *h_child_pred = nullptr;
   MLCommon::host_buffer<unsigned int> *h_child_count = nullptr;
 
@@ -108,7 +142,8 @@ struct TemporaryMemory {
   int max_nodes_per_level = 0;
 
   TemporaryMemory(const ML::cumlHandle_impl &handle, int N, int Ncols,
-                  int n_unique, int n_bins, const int split_algo, int depth);
+                  int n_unique, int n_bins, const int split_algo, int depth,
+                  bool cfg_weighted = false);
   ~TemporaryMemory();
   void NodeMemAllocator(int N, int Ncols, int n_unique, int n_bins,
                         const int split_algo);
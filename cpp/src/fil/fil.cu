@@ -21,11 +21,13 @@
 #include <thrust/host_vector.h>
 #include <treelite/tree.h>
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <limits>
 #include <utility>
 
 #include "common.cuh"
+#include "common/cumlHandle.hpp"
 #include "fil.h"
 
 namespace ML {
@@ -78,7 +80,8 @@ __global__ void transform_k(float* preds, size_t n, output_t output,
 
 struct forest {
   forest()
-    : depth_(0),
+    : generation_(next_generation()),
+      depth_(0),
       ntrees_(0),
       cols_(0),
       algo_(algo_t::NAIVE),
@@ -177,6 +180,13 @@ struct forest {
                                        h.getStream());
   }
 
+  /** never reused, unlike the address: identifies the forest in graph keys */
+  static uint64_t next_generation() {
+    static std::atomic<uint64_t> counter(0);
+    return counter++;
+  }
+
+  uint64_t generation_;
   int ntrees_;
   int depth_;
   int cols_;
@@ -362,13 +372,20 @@ void from_treelite(const cumlHandle& handle, forest_t* pforest,
 }
 
 void free(const cumlHandle& h, forest_t f) {
+  // the graphs recorded for this forest point to its nodes. Those of other
+  // handles are never launched again, as no other forest has its generation
+  h.getImpl().eraseGraphs(
+    ML::detail::graphKey("fil::predict", f->generation_) + "|");
   f->free(h);
   delete f;
 }
 
 void predict(const cumlHandle& h, forest_t f, float* preds, const float* data,
              size_t n) {
-  f->predict(h, preds, data, n);
+  auto key =
+    ML::detail::graphKey("fil::predict", f->generation_, preds, data, n);
+  h.getImpl().launchGraph(key, h.getStream(),
+                          [&]() { f->predict(h, preds, data, n); });
 }
 
 }  // namespace fil
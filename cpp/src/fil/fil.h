@@ -123,6 +123,21 @@ struct treelite_params_t {
   float threshold;
 };
 
+/** model_format_t is the format of a model file read by parse_model */
+enum model_format_t {
+  /** XGBoost binary model, as written by Booster.save_model() */
+  XGBOOST_BINARY,
+  /** XGBoost JSON model, as written by Booster.save_model("*.json") */
+  XGBOOST_JSON,
+  /** LightGBM text model, as written by Booster.save_model() */
+  LIGHTGBM_TEXT
+};
+
+struct parsed_model;
+
+/** parsed_model_t is a model read from a file, not yet laid out as FIL nodes */
+typedef parsed_model* parsed_model_t;
+
 /** init_dense uses params to initialize the forest stored in pf
  *  @param h cuML handle used by this function
  *  @param pf pointer to where to store the newly created forest
@@ -140,6 +155,53 @@ void init_dense(const cumlHandle& h, forest_t* pf,
 void from_treelite(const cumlHandle& handle, forest_t* pforest,
                    ModelHandle model, const treelite_params_t* tl_params);
 
+/** parse_model reads an XGBoost or LightGBM model file directly, without
+ *  building a treelite model; the trees are parsed in parallel
+ *  @param pmodel pointer to where to store the parsed model, to be freed with
+ *      free_parsed_model()
+ *  @param params the forest parameters; all of them but nodes are filled in,
+ *      the nodes are written by write_nodes()
+ *  @param filename path to the model file
+ *  @param format format of the model file
+ *  @param tl_params additional parameters for the forest, as in from_treelite()
+ *  @param n_threads number of threads parsing the trees, 0 for the OpenMP
+ *      default
+ */
+void parse_model(parsed_model_t* pmodel, forest_params_t* params,
+                 const char* filename, model_format_t format,
+                 const treelite_params_t* tl_params, int n_threads = 0);
+
+/** parsed_model_num_nodes returns the number of dense nodes of the forest,
+ *  i.e. the size of the array to pass to write_nodes() */
+size_t parsed_model_num_nodes(parsed_model_t model);
+
+/** write_nodes writes the nodes of a parsed model, in the layout expected by
+ *  init_dense(), into a preallocated host array (which may be pinned)
+ *  @param model the parsed model
+ *  @param nodes array of parsed_model_num_nodes(model) nodes
+ *  @param n_threads number of threads writing the trees, 0 for the OpenMP
+ *      default
+ */
+void write_nodes(parsed_model_t model, dense_node_t* nodes, int n_threads = 0);
+
+/** free_parsed_model deletes a parsed model */
+void free_parsed_model(parsed_model_t model);
+
+/** from_file initializes the forest from an XGBoost or LightGBM model file
+ *  without going through treelite; the nodes are written to a buffer from the
+ *  host allocator of the handle (pinned by default) and copied from there
+ *  @param handle cuML handle used by this function
+ *  @param pforest pointer to where to store the newly created forest
+ *  @param filename path to the model file
+ *  @param format format of the model file
+ *  @param tl_params additional parameters for the forest
+ *  @param n_threads number of threads parsing the trees, 0 for the OpenMP
+ *      default
+ */
+void from_file(const cumlHandle& handle, forest_t* pforest,
+               const char* filename, model_format_t format,
+               const treelite_params_t* tl_params, int n_threads = 0);
+
 /** free deletes forest and all resources held by it; after this, forest is no longer usable 
  *  @param h cuML handle used by this function
  *  @param f the forest to free; not usable after the call to this function
@@ -154,6 +216,8 @@ void free(const cumlHandle& h, forest_t f);
  *  @param data array of size n * cols (cols is the number of columns 
  *      for the forest f) from which to predict
  *  @param n number of data rows
+ *  With graph capture enabled on h (see cumlHandle::setGraphCapture), a graph
+ *  is recorded per (forest, preds, data, n): pass stable buffers.
  */
 void predict(const cumlHandle& h, forest_t f, float* preds, const float* data,
              size_t n);
@@ -0,0 +1,778 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file model_loaders.cpp reads XGBoost and LightGBM model files straight
+    into FIL nodes, without going through treelite */
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../../src_prims/common/host_buffer.hpp"
+#include "../../src_prims/utils.h"
+#include "fil.h"
+
+namespace ML {
+namespace fil {
+
+/** sparse_tree is a tree as stored in the model file, with its nodes already
+    converted to the FIL encoding */
+struct sparse_tree {
+  std::vector<dense_node_t> nodes;
+  // children of the inner nodes, -1 for leaves
+  std::vector<int> left, right;
+  int root = 0;
+  int depth = 0;
+
+  void resize(int n) {
+    nodes.resize(n, dense_node_t{0, 0});
+    left.resize(n, -1);
+    right.resize(n, -1);
+  }
+
+  void set_leaf(int i, float output) {
+    dense_node_init(&nodes[i], output, 0, 0, false, true);
+    left[i] = right[i] = -1;
+  }
+
+  // FIL goes to the left child if the feature is < threshold
+  void set_split(int i, int fid, float threshold, bool default_left, int l,
+                 int r) {
+    ASSERT(l >= 0 && r >= 0, "node index out of range");
+    dense_node_init(&nodes[i], 0, threshold, fid, default_left, false);
+    left[i] = l;
+    right[i] = r;
+  }
+};
+
+struct parsed_model {
+  forest_params_t params;
+  std::vector<sparse_tree> trees;
+};
+
+namespace {
+
+int thread_count(int n_threads) {
+  return n_threads > 0 ? n_threads : omp_get_max_threads();
+}
+
+/** runs f(0), ..., f(n - 1) in parallel and rethrows the first exception */
+template <typename F>
+void parallel_for(int n, int n_threads, F f) {
+  std::exception_ptr error;
+#pragma omp parallel for num_threads(thread_count(n_threads)) schedule(dynamic)
+  for (int i = 0; i < n; ++i) {
+    try {
+      f(i);
+    } catch (...) {
+#pragma omp critical
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+std::string read_file(const char* filename) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  ASSERT(in.good(), "cannot open model file %s", filename);
+  in.seekg(0, std::ios::end);
+  std::string data(size_t(in.tellg()), '\0');
+  in.seekg(0, std::ios::beg);
+  in.read(&data[0], data.size());
+  ASSERT(!in.fail(), "error reading model file %s", filename);
+  return data;
+}
+
+/** computes the depth of the tree; like the treelite import, rejects trees
+    deeper than FIL can use, which most likely contain cycles */
+int tree_depth(const sparse_tree& tree) {
+  const int RECURSION_LIMIT = 500;
+  int n = tree.nodes.size(), depth = 0;
+  std::vector<std::pair<int, int>> stack(1, std::make_pair(tree.root, 0));
+  while (!stack.empty()) {
+    int i = stack.back().first, d = stack.back().second;
+    stack.pop_back();
+    ASSERT(i >= 0 && i < n, "node index out of range");
+    if (tree.left[i] < 0) {
+      depth = std::max(depth, d);
+      continue;
+    }
+    ASSERT(d < RECURSION_LIMIT,
+           "recursion depth limit reached, might be a cycle in the tree");
+    stack.push_back(std::make_pair(tree.left[i], d + 1));
+    stack.push_back(std::make_pair(tree.right[i], d + 1));
+  }
+  return depth;
+}
+
+/** writes the tree in the dense layout: the children of the node at position
+    i are at positions 2 * i + 1 and 2 * i + 2 */
+void write_tree(const sparse_tree& tree, dense_node_t* out, int depth) {
+  std::fill(out, out + (1 << (depth + 1)) - 1, dense_node_t{0, 0});
+  std::vector<std::pair<int, int>> stack(1, std::make_pair(tree.root, 0));
+  while (!stack.empty()) {
+    int i = stack.back().first, pos = stack.back().second;
+    stack.pop_back();
+    out[pos] = tree.nodes[i];
+    if (tree.left[i] < 0) continue;
+    stack.push_back(std::make_pair(tree.left[i], 2 * pos + 1));
+    stack.push_back(std::make_pair(tree.right[i], 2 * pos + 2));
+  }
+}
+
+/** fills in the output parameters the same way as the treelite import */
+void set_output(forest_params_t* params, const treelite_params_t* tl_params,
+                bool average, const std::string& pred_transform) {
+  params->algo = tl_params->algo;
+  params->threshold = tl_params->threshold;
+  params->output = output_t::RAW;
+  if (tl_params->output_class) {
+    params->output = output_t(params->output | output_t::THRESHOLD);
+  }
+  if (average) params->output = output_t(params->output | output_t::AVG);
+  if (pred_transform == "sigmoid") {
+    params->output = output_t(params->output | output_t::SIGMOID);
+  } else if (pred_transform != "identity") {
+    ASSERT(false, "%s: unsupported prediction transform",
+           pred_transform.c_str());
+  }
+}
+
+// ------------------------------ XGBoost --------------------------------- //
+
+/** prediction transform and global bias of an XGBoost objective; as in
+    treelite, base_score is converted to a margin for logistic objectives */
+std::string xgboost_objective(const std::string& objective, float base_score,
+                              float* global_bias) {
+  ASSERT(objective.compare(0, 6, "multi:") != 0,
+         "multi-class classification not supported");
+  if (objective == "binary:logistic" || objective == "reg:logistic") {
+    *global_bias = -logf(1.0f / base_score - 1.0f);
+    return "sigmoid";
+  }
+  *global_bias = base_score;
+  if (objective == "count:poisson" || objective == "reg:gamma" ||
+      objective == "reg:tweedie") {
+    return "exponential";
+  }
+  return "identity";
+}
+
+// the layouts of the parameter blocks in the XGBoost binary format
+struct xgb_learner_param {
+  float base_score;
+  unsigned num_feature;
+  int num_class;
+  int contain_extra_attrs;
+  int contain_eval_metrics;
+  int reserved[29];
+};
+
+struct xgb_gbtree_param {
+  int num_trees;
+  int num_roots;
+  int num_feature;
+  int pad_32bit;
+  int64_t num_pbuffer_deprecated;
+  int num_output_group;
+  int size_leaf_vector;
+  int reserved[32];
+};
+
+struct xgb_tree_param {
+  int num_roots;
+  int num_nodes;
+  int num_deleted;
+  int max_depth;
+  int num_feature;
+  int size_leaf_vector;
+  int reserved[31];
+};
+
+struct xgb_node {
+  int parent;
+  int cleft;
+  int cright;
+  // split feature, with default_left in the highest bit
+  unsigned sindex;
+  // leaf value or split condition
+  float info;
+};
+
+struct xgb_node_stat {
+  float loss_chg;
+  float sum_hess;
+  float base_weight;
+  int leaf_child_cnt;
+};
+
+/** bounds-checked reader of the XGBoost binary format */
+struct byte_reader {
+  const char* p;
+  const char* end;
+
+  void skip(size_t bytes) {
+    ASSERT(size_t(end - p) >= bytes, "unexpected end of XGBoost model");
+    p += bytes;
+  }
+  template <typename T>
+  void read(T* out, size_t n = 1) {
+    const char* from = p;
+    skip(sizeof(T) * n);
+    memcpy(out, from, sizeof(T) * n);
+  }
+  std::string read_string() {
+    uint64_t len;
+    read(&len);
+    const char* from = p;
+    skip(len);
+    return std::string(from, len);
+  }
+};
+
+/** model_info holds the forest-wide parameters found in a model file */
+struct model_info {
+  int cols = 0;
+  float global_bias = 0;
+  bool average = false;
+  std::string pred_transform = "identity";
+};
+
+void parse_xgboost_binary(const std::string& data, int n_threads,
+                          model_info* info, std::vector<sparse_tree>* trees) {
+  ASSERT(data.compare(0, 4, "bs64") != 0,
+         "base64-encoded XGBoost models are not supported");
+  byte_reader r{data.data(), data.data() + data.size()};
+  if (data.compare(0, 4, "binf") == 0) r.skip(4);
+  xgb_learner_param learner;
+  r.read(&learner);
+  std::string objective = r.read_string();
+  std::string booster = r.read_string();
+  ASSERT(booster == "gbtree", "%s: unsupported XGBoost booster",
+         booster.c_str());
+  xgb_gbtree_param gbtree;
+  r.read(&gbtree);
+  ASSERT(learner.num_class <= 1 && gbtree.num_output_group <= 1,
+         "multi-class classification not supported");
+  info->cols = learner.num_feature;
+  info->pred_transform =
+    xgboost_objective(objective, learner.base_score, &info->global_bias);
+
+  // the trees have different sizes: find where each of them starts, then
+  // decode them in parallel
+  std::vector<const char*> starts(gbtree.num_trees);
+  for (int t = 0; t < gbtree.num_trees; ++t) {
+    starts[t] = r.p;
+    xgb_tree_param tp;
+    r.read(&tp);
+    ASSERT(tp.num_roots == 1, "multi-root trees not supported");
+    ASSERT(tp.num_nodes > 0, "a tree must have a root");
+    r.skip(size_t(tp.num_nodes) * (sizeof(xgb_node) + sizeof(xgb_node_stat)));
+    if (tp.size_leaf_vector != 0) {
+      uint64_t len;
+      r.read(&len);
+      r.skip(len * sizeof(float));
+    }
+  }
+
+  trees->resize(gbtree.num_trees);
+  parallel_for(gbtree.num_trees, n_threads, [&](int t) {
+    byte_reader tr{starts[t], r.end};
+    xgb_tree_param tp;
+    tr.read(&tp);
+    std::vector<xgb_node> nodes(tp.num_nodes);
+    tr.read(nodes.data(), nodes.size());
+    sparse_tree& tree = (*trees)[t];
+    tree.resize(tp.num_nodes);
+    for (int i = 0; i < tp.num_nodes; ++i) {
+      const xgb_node& n = nodes[i];
+      if (n.cleft == -1) {
+        tree.set_leaf(i, n.info);
+      } else {
+        // XGBoost goes left if the feature is < split condition, as FIL does
+        tree.set_split(i, n.sindex & ((1U << 31) - 1U), n.info,
+                       (n.sindex >> 31) != 0, n.cleft, n.cright);
+      }
+    }
+    tree.depth = tree_depth(tree);
+  });
+}
+
+/** minimal JSON scanner: it only locates values and decodes the few kinds
+    needed from an XGBoost model, skipping everything else without building
+    a document */
+struct json_reader {
+  const char* p;
+  const char* end;
+
+  void skip_ws() {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+      ++p;
+  }
+  void expect(char c) {
+    skip_ws();
+    ASSERT(p < end && *p == c, "invalid XGBoost JSON model: expected '%c'", c);
+    ++p;
+  }
+  /** consumes c if it is the next character */
+  bool accept(char c) {
+    skip_ws();
+    if (p < end && *p == c) {
+      ++p;
+      return true;
+    }
+    return false;
+  }
+  std::string parse_string() {
+    expect('"');
+    std::string s;
+    while (p < end && *p != '"') {
+      // keep escaped characters as they are, none of the names needed has any
+      if (*p == '\\') s.push_back(*p++);
+      ASSERT(p < end, "invalid XGBoost JSON model: unterminated string");
+      s.push_back(*p++);
+    }
+    expect('"');
+    return s;
+  }
+  void skip_value() {
+    skip_ws();
+    ASSERT(p < end, "invalid XGBoost JSON model: missing value");
+    if (*p == '"') {
+      parse_string();
+    } else if (*p == '{' || *p == '[') {
+      // strings are skipped as a whole, so brackets in them are ignored
+      int level = 0;
+      do {
+        if (*p == '"') {
+          parse_string();
+          continue;
+        }
+        if (*p == '{' || *p == '[') ++level;
+        if (*p == '}' || *p == ']') --level;
+        ++p;
+      } while (level > 0 && p < end);
+      ASSERT(level == 0, "invalid XGBoost JSON model: unbalanced brackets");
+    } else {
+      while (p < end && *p != ',' && *p != '}' && *p != ']') ++p;
+    }
+  }
+  /** calls f(key) for every member of an object; f has to consume the value
+      and returns false if it did not, in which case the value is skipped */
+  template <typename F>
+  void for_each_member(F f) {
+    expect('{');
+    if (accept('}')) return;
+    do {
+      std::string key = parse_string();
+      expect(':');
+      if (!f(key)) skip_value();
+    } while (accept(','));
+    expect('}');
+  }
+  /** moves to the value of the member key of the current object */
+  void find_member(const char* key) {
+    bool found = false;
+    const char* value = nullptr;
+    for_each_member([&](const std::string& k) {
+      if (found || k != key) return false;
+      found = true;
+      skip_ws();
+      value = p;
+      return false;
+    });
+    ASSERT(found, "invalid XGBoost JSON model: %s not found", key);
+    p = value;
+  }
+  /** a number, which XGBoost may also store as a string */
+  template <typename T>
+  T parse_number() {
+    skip_ws();
+    bool quoted = accept('"');
+    char* next;
+    T value;
+    if (std::is_same<T, float>::value) {
+      value = strtof(p, &next);
+    } else {
+      value = T(strtod(p, &next));
+    }
+    ASSERT(next != p, "invalid XGBoost JSON model: expected a number");
+    p = next;
+    if (quoted) expect('"');
+    return value;
+  }
+  /** an array of numbers or booleans */
+  template <typename T>
+  void parse_array(std::vector<T>* out) {
+    out->clear();
+    expect('[');
+    if (accept(']')) return;
+    do {
+      skip_ws();
+      if (p < end && (*p == 't' || *p == 'f')) {
+        bool b = *p == 't';
+        skip_value();
+        out->push_back(T(b));
+      } else {
+        out->push_back(parse_number<T>());
+      }
+    } while (accept(','));
+    expect(']');
+  }
+};
+
+void parse_xgboost_json(const std::string& data, int n_threads,
+                        model_info* info, std::vector<sparse_tree>* trees) {
+  json_reader root{data.data(), data.data() + data.size()};
+  root.find_member("learner");
+  json_reader learner = root;
+
+  // forest-wide parameters
+  float base_score = 0.5f;
+  std::string objective;
+  json_reader r = learner;
+  r.find_member("learner_model_param");
+  r.for_each_member([&](const std::string& key) {
+    if (key == "base_score") {
+      base_score = r.parse_number<float>();
+    } else if (key == "num_feature") {
+      info->cols = r.parse_number<int>();
+    } else if (key == "num_class") {
+      ASSERT(r.parse_number<int>() <= 1,
+             "multi-class classification not supported");
+    } else {
+      return false;
+    }
+    return true;
+  });
+  r = learner;
+  r.find_member("objective");
+  r.find_member("name");
+  objective = r.parse_string();
+  info->pred_transform =
+    xgboost_objective(objective, base_score, &info->global_bias);
+
+  // locate the trees, then decode them in parallel
+  r = learner;
+  r.find_member("gradient_booster");
+  json_reader booster = r;
+  booster.find_member("name");
+  std::string name = booster.parse_string();
+  ASSERT(name == "gbtree", "%s: unsupported XGBoost booster", name.c_str());
+  r.find_member("model");
+  r.find_member("trees");
+  std::vector<const char*> starts;
+  r.expect('[');
+  if (!r.accept(']')) {
+    do {
+      r.skip_ws();
+      starts.push_back(r.p);
+      r.skip_value();
+    } while (r.accept(','));
+    r.expect(']');
+  }
+
+  int ntrees = starts.size();
+  trees->resize(ntrees);
+  parallel_for(ntrees, n_threads, [&](int t) {
+    json_reader tr{starts[t], root.end};
+    std::vector<int> left, right, fid, split_type;
+    std::vector<float> cond;
+    std::vector<char> default_left;
+    tr.for_each_member([&](const std::string& key) {
+      if (key == "left_children") {
+        tr.parse_array(&left);
+      } else if (key == "right_children") {
+        tr.parse_array(&right);
+      } else if (key == "split_indices") {
+        tr.parse_array(&fid);
+      } else if (key == "split_conditions") {
+        tr.parse_array(&cond);
+      } else if (key == "default_left") {
+        tr.parse_array(&default_left);
+      } else if (key == "split_type") {
+        tr.parse_array(&split_type);
+      } else {
+        return false;
+      }
+      return true;
+    });
+    int n = left.size();
+    ASSERT(n > 0, "a tree must have a root");
+    ASSERT(right.size() == left.size() && fid.size() == left.size() &&
+             cond.size() == left.size() && default_left.size() == left.size(),
+           "invalid XGBoost JSON model: inconsistent tree arrays");
+    sparse_tree& tree = (*trees)[t];
+    tree.resize(n);
+    for (int i = 0; i < n; ++i) {
+      if (left[i] == -1) {
+        tree.set_leaf(i, cond[i]);
+        continue;
+      }
+      ASSERT(split_type.empty() || split_type[i] == 0,
+             "only numerical split nodes are supported");
+      tree.set_split(i, fid[i], cond[i], default_left[i] != 0, left[i],
+                     right[i]);
+    }
+    tree.depth = tree_depth(tree);
+  });
+}
+
+// ------------------------------ LightGBM -------------------------------- //
+
+/** calls f(key, value_begin, value_end) for every "key=value" line of
+    [begin, end); lines without '=' get an empty value */
+template <typename F>
+void for_each_line(const char* begin, const char* end, F f) {
+  while (begin < end) {
+    const char* eol = std::find(begin, end, '\n');
+    const char* line_end = eol;
+    if (line_end > begin && line_end[-1] == '\r') --line_end;
+    const char* eq = std::find(begin, line_end, '=');
+    std::string key(begin, eq);
+    f(key, eq == line_end ? line_end : eq + 1, line_end);
+    begin = eol + (eol < end);
+  }
+}
+
+/** parses the space-separated numbers of [begin, end) */
+template <typename T>
+void parse_text_array(const char* begin, const char* end,
+                      std::vector<T>* out) {
+  out->clear();
+  const char* p = begin;
+  while (true) {
+    while (p < end && *p == ' ') ++p;
+    if (p >= end) break;
+    char* next;
+    double value = strtod(p, &next);
+    ASSERT(next != p && next <= end,
+           "invalid LightGBM model: expected a number");
+    out->push_back(T(value));
+    p = next;
+  }
+}
+
+/** prediction transform of a LightGBM objective, as in treelite */
+std::string lightgbm_objective(const std::string& objective) {
+  std::string name = objective.substr(0, objective.find(' '));
+  if (name == "binary") {
+    // "binary sigmoid:<alpha>"
+    size_t pos = objective.find("sigmoid:");
+    ASSERT(pos == std::string::npos ||
+             strtod(objective.c_str() + pos + 8, nullptr) == 1.0,
+           "sigmoid_alpha not supported");
+    return "sigmoid";
+  }
+  if (name == "xentropy" || name == "cross_entropy") return "sigmoid";
+  ASSERT(name != "multiclass" && name != "multiclassova",
+         "multi-class classification not supported");
+  if (name == "regression" || name == "regression_l1" || name == "huber" ||
+      name == "fair" || name == "quantile" || name == "mape" ||
+      name == "lambdarank" || name == "rank_xendcg") {
+    return "identity";
+  }
+  if (name == "poisson" || name == "gamma" || name == "tweedie") {
+    return "exponential";
+  }
+  return name;
+}
+
+void parse_lightgbm_text(const std::string& data, int n_threads,
+                         model_info* info, std::vector<sparse_tree>* trees) {
+  const char* begin = data.data();
+  const char* end = begin + data.size();
+
+  // the sections of the trees, one per "Tree=" line
+  std::vector<std::pair<const char*, const char*>> sections;
+  const char* header_end = end;
+  for (const char* line = begin; line < end;) {
+    const char* eol = std::find(line, end, '\n');
+    if (strncmp(line, "Tree=", 5) == 0) {
+      if (sections.empty()) header_end = line;
+      if (!sections.empty()) sections.back().second = line;
+      sections.push_back(std::make_pair(line, end));
+    } else if (strncmp(line, "end of trees", 12) == 0) {
+      if (!sections.empty()) sections.back().second = line;
+      break;
+    }
+    line = eol + (eol < end);
+  }
+
+  // forest-wide parameters
+  std::string objective;
+  for_each_line(begin, header_end, [&](const std::string& key, const char* v,
+                                       const char* v_end) {
+    if (key == "max_feature_idx") {
+      info->cols = atoi(std::string(v, v_end).c_str()) + 1;
+    } else if (key == "num_class" || key == "num_tree_per_iteration") {
+      ASSERT(atoi(std::string(v, v_end).c_str()) <= 1,
+             "multi-class classification not supported");
+    } else if (key == "objective") {
+      objective.assign(v, v_end);
+    } else if (key == "average_output") {
+      info->average = true;
+    }
+  });
+  info->pred_transform = lightgbm_objective(objective);
+
+  int ntrees = sections.size();
+  trees->resize(ntrees);
+  parallel_for(ntrees, n_threads, [&](int t) {
+    int num_leaves = 0;
+    std::vector<int> fid, decision_type, left, right;
+    std::vector<double> threshold, leaf_value;
+    for_each_line(sections[t].first, sections[t].second,
+                  [&](const std::string& key, const char* v,
+                      const char* v_end) {
+                    if (key == "num_leaves") {
+                      num_leaves = atoi(std::string(v, v_end).c_str());
+                    } else if (key == "split_feature") {
+                      parse_text_array(v, v_end, &fid);
+                    } else if (key == "threshold") {
+                      parse_text_array(v, v_end, &threshold);
+                    } else if (key == "decision_type") {
+                      parse_text_array(v, v_end, &decision_type);
+                    } else if (key == "left_child") {
+                      parse_text_array(v, v_end, &left);
+                    } else if (key == "right_child") {
+                      parse_text_array(v, v_end, &right);
+                    } else if (key == "leaf_value") {
+                      parse_text_array(v, v_end, &leaf_value);
+                    }
+                  });
+    ASSERT(num_leaves > 0, "a tree must have a root");
+    int n_inner = num_leaves - 1;
+    size_t n_splits = n_inner;
+    ASSERT(leaf_value.size() == n_splits + 1 && fid.size() == n_splits &&
+             threshold.size() == n_splits &&
+             decision_type.size() == n_splits && left.size() == n_splits &&
+             right.size() == n_splits,
+           "invalid LightGBM model: inconsistent tree arrays");
+    // inner nodes keep their indices, leaf l becomes node n_inner + l
+    auto child = [n_inner](int c) { return c >= 0 ? c : n_inner + ~c; };
+    sparse_tree& tree = (*trees)[t];
+    tree.resize(n_inner + num_leaves);
+    for (int i = 0; i < n_inner; ++i) {
+      ASSERT((decision_type[i] & 1) == 0,
+             "only numerical split nodes are supported");
+      // LightGBM goes left if the feature is <= threshold, which is < the
+      // next representable float
+      float thresh = std::nextafterf(float(threshold[i]),
+                                     std::numeric_limits<float>::infinity());
+      tree.set_split(i, fid[i], thresh, (decision_type[i] & 2) != 0,
+                     child(left[i]), child(right[i]));
+    }
+    for (int l = 0; l < num_leaves; ++l) {
+      tree.set_leaf(n_inner + l, float(leaf_value[l]));
+    }
+    tree.depth = tree_depth(tree);
+  });
+}
+
+void parse(parsed_model* model, forest_params_t* params,
+           const char* filename, model_format_t format,
+           const treelite_params_t* tl_params, int n_threads) {
+  std::string data = read_file(filename);
+  model_info info;
+  switch (format) {
+    case model_format_t::XGBOOST_BINARY:
+      parse_xgboost_binary(data, n_threads, &info, &model->trees);
+      break;
+    case model_format_t::XGBOOST_JSON:
+      parse_xgboost_json(data, n_threads, &info, &model->trees);
+      break;
+    case model_format_t::LIGHTGBM_TEXT:
+      parse_lightgbm_text(data, n_threads, &info, &model->trees);
+      break;
+    default:
+      ASSERT(false, "format should be XGBOOST_BINARY, XGBOOST_JSON or "
+                    "LIGHTGBM_TEXT");
+  }
+  set_output(params, tl_params, info.average, info.pred_transform);
+  params->cols = info.cols;
+  params->global_bias = info.global_bias;
+  params->ntrees = model->trees.size();
+  params->depth = 0;
+  for (const sparse_tree& tree : model->trees)
+    params->depth = std::max(params->depth, tree.depth);
+  params->nodes = nullptr;
+  model->params = *params;
+}
+
+}  // namespace
+
+void parse_model(parsed_model_t* pmodel, forest_params_t* params,
+                 const char* filename, model_format_t format,
+                 const treelite_params_t* tl_params, int n_threads) {
+  parsed_model* model = new parsed_model;
+  try {
+    parse(model, params, filename, format, tl_params, n_threads);
+  } catch (...) {
+    delete model;
+    throw;
+  }
+  *pmodel = model;
+}
+
+size_t parsed_model_num_nodes(parsed_model_t model) {
+  return size_t(model->params.ntrees) *
+         ((size_t(1) << (model->params.depth + 1)) - 1);
+}
+
+void write_nodes(parsed_model_t model, dense_node_t* nodes, int n_threads) {
+  size_t tree_nodes = (size_t(1) << (model->params.depth + 1)) - 1;
+  parallel_for(model->params.ntrees, n_threads, [&](int t) {
+    write_tree(model->trees[t], nodes + t * tree_nodes, model->params.depth);
+  });
+}
+
+void free_parsed_model(parsed_model_t model) { delete model; }
+
+void from_file(const cumlHandle& handle, forest_t* pforest,
+               const char* filename, model_format_t format,
+               const treelite_params_t* tl_params, int n_threads) {
+  parsed_model model;
+  forest_params_t params;
+  parse(&model, &params, filename, format, tl_params, n_threads);
+  cudaStream_t stream = handle.getStream();
+  MLCommon::host_buffer<dense_node_t> nodes(
+    handle.getHostAllocator(), stream, parsed_model_num_nodes(&model));
+  write_nodes(&model, nodes.data(), n_threads);
+  // the trees are not needed any more
+  std::vector<sparse_tree>().swap(model.trees);
+  params.nodes = nodes.data();
+  init_dense(handle, pforest, &params);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
+
+}  // namespace fil
+}  // namespace ML
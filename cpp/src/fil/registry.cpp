@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file registry.cpp model registry on top of the FIL interface */
+
+#include "registry.h"
+#include "../../src_prims/utils.h"
+
+namespace ML {
+namespace fil {
+
+loaded_forest::loaded_forest(const cumlHandle& h, const std::string& name,
+                             int version, const forest_params_t* params)
+  : handle_(h), name_(name), version_(version) {
+  init_dense(h, &forest_, params);
+}
+
+loaded_forest::~loaded_forest() {
+  for (auto& se : events_) {
+    CUDA_CHECK_NO_THROW(cudaEventSynchronize(se.second));
+    CUDA_CHECK_NO_THROW(cudaEventDestroy(se.second));
+  }
+  free(handle_, forest_);
+}
+
+void loaded_forest::predict(const cumlHandle& h, float* preds,
+                            const float* data, size_t n) {
+  fil::predict(h, forest_, preds, data, n);
+  // the forest may be freed from another thread and stream, which has to
+  // wait for this prediction first
+  cudaStream_t stream = h.getStream();
+  std::lock_guard<std::mutex> guard(mutex_);
+  cudaEvent_t event = nullptr;
+  for (auto& se : events_) {
+    if (se.first == stream) event = se.second;
+  }
+  if (event == nullptr) {
+    CUDA_CHECK(cudaEventCreateWithFlags(&event, cudaEventDisableTiming));
+    events_.push_back(std::make_pair(stream, event));
+  }
+  CUDA_CHECK(cudaEventRecord(event, stream));
+}
+
+struct forest_registry::entry {
+  int version = -1;
+  // the nodes are in nodes, params.nodes is not used
+  forest_params_t params;
+  // nodes in host memory, null if dropped; shared with the loads in progress
+  std::shared_ptr<const std::vector<dense_node_t>> nodes;
+  // size of the nodes in device memory
+  size_t bytes = 0;
+  // source file, empty if published from nodes
+  std::string filename;
+  model_format_t format;
+  treelite_params_t tl_params;
+  // the version held by the registry, nullptr if evicted
+  forest_ref loaded;
+  // position in lru_, if loaded
+  std::list<std::string>::iterator lru;
+};
+
+namespace {
+
+void read_nodes(std::vector<dense_node_t>* nodes, forest_params_t* params,
+                const char* filename, model_format_t format,
+                const treelite_params_t* tl_params) {
+  parsed_model_t model;
+  parse_model(&model, params, filename, format, tl_params);
+  try {
+    nodes->resize(parsed_model_num_nodes(model));
+    write_nodes(model, nodes->data());
+  } catch (...) {
+    free_parsed_model(model);
+    throw;
+  }
+  free_parsed_model(model);
+}
+
+}  // namespace
+
+forest_registry::forest_registry(const cumlHandle& h,
+                                 const registry_params_t& params)
+  : handle_(h), params_(params) {}
+
+forest_registry::~forest_registry() {
+  // forests still referenced are freed by their last reference, the others
+  // once the lock is released
+  std::map<std::string, std::unique_ptr<entry>> models;
+  std::lock_guard<std::mutex> guard(mutex_);
+  models.swap(models_);
+}
+
+void forest_registry::publish(const std::string& name, int version,
+                              const forest_params_t* params) {
+  ASSERT(params->depth >= 0, "depth must be non-negative");
+  ASSERT(params->ntrees >= 0, "ntrees must be non-negative");
+  size_t num_nodes =
+    size_t(params->ntrees) * ((size_t(1) << (params->depth + 1)) - 1);
+  std::unique_ptr<entry> e(new entry);
+  e->version = version;
+  e->params = *params;
+  e->nodes.reset(new std::vector<dense_node_t>(params->nodes,
+                                               params->nodes + num_nodes));
+  e->bytes = num_nodes * sizeof(dense_node_t);
+  forest_ref forest = build(name, *e);
+  swap_in(name, std::move(e), forest);
+}
+
+void forest_registry::publish(const std::string& name, int version,
+                              const char* filename, model_format_t format,
+                              const treelite_params_t* tl_params) {
+  // parsing and loading are the slow parts, and are done outside of the lock
+  std::unique_ptr<entry> e(new entry);
+  e->version = version;
+  std::shared_ptr<std::vector<dense_node_t>> nodes(
+    new std::vector<dense_node_t>);
+  read_nodes(nodes.get(), &e->params, filename, format, tl_params);
+  e->nodes = nodes;
+  e->bytes = nodes->size() * sizeof(dense_node_t);
+  e->filename = filename;
+  e->format = format;
+  e->tl_params = *tl_params;
+  forest_ref forest = build(name, *e);
+  swap_in(name, std::move(e), forest);
+}
+
+void forest_registry::swap_in(const std::string& name,
+                              std::unique_ptr<entry> e, forest_ref forest) {
+  // declared first, so that the forests are freed after the lock is released
+  std::vector<forest_ref> released;
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = models_.find(name);
+  if (it != models_.end()) {
+    ASSERT(e->version > it->second->version,
+           "%s: version %d is not newer than version %d", name.c_str(),
+           e->version, it->second->version);
+    // the old version leaves the budget, references to it keep it alive
+    if (it->second->loaded) released.push_back(evict(it->second.get()));
+    install(name, e.get(), forest, &released);
+    it->second = std::move(e);
+  } else {
+    install(name, e.get(), forest, &released);
+    models_[name] = std::move(e);
+  }
+}
+
+void forest_registry::remove(const std::string& name) {
+  std::vector<forest_ref> released;
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = models_.find(name);
+  ASSERT(it != models_.end(), "%s: no such model", name.c_str());
+  if (it->second->loaded) released.push_back(evict(it->second.get()));
+  models_.erase(it);
+}
+
+forest_ref forest_registry::get(const std::string& name) {
+  for (;;) {
+    entry spec;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto it = models_.find(name);
+      ASSERT(it != models_.end(), "%s: no such model", name.c_str());
+      entry* e = it->second.get();
+      if (e->loaded) {
+        lru_.splice(lru_.begin(), lru_, e->lru);
+        return e->loaded;
+      }
+      spec = *e;
+    }
+    // reparsing and copying to the device are done outside of the lock, so
+    // that the other models stay available meanwhile
+    forest_ref forest = build(name, spec);
+    std::vector<forest_ref> released;
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = models_.find(name);
+    // the model was removed or replaced meanwhile: start over
+    if (it == models_.end() || it->second->version != spec.version) continue;
+    entry* e = it->second.get();
+    if (e->loaded) {
+      // loaded by another thread meanwhile, ours is freed after the lock
+      lru_.splice(lru_.begin(), lru_, e->lru);
+      return e->loaded;
+    }
+    install(name, e, forest, &released);
+    return forest;
+  }
+}
+
+void forest_registry::predict(const cumlHandle& h, const std::string& name,
+                              float* preds, const float* data, size_t n) {
+  get(name)->predict(h, preds, data, n);
+}
+
+int forest_registry::version(const std::string& name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = models_.find(name);
+  return it != models_.end() ? it->second->version : -1;
+}
+
+bool forest_registry::is_loaded(const std::string& name) const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = models_.find(name);
+  return it != models_.end() && it->second->loaded != nullptr;
+}
+
+size_t forest_registry::device_bytes() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return device_bytes_;
+}
+
+size_t forest_registry::size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return models_.size();
+}
+
+forest_ref forest_registry::build(const std::string& name, const entry& e) {
+  ASSERT(params_.device_budget == 0 || e.bytes <= params_.device_budget,
+         "%s: the model (%zu bytes) exceeds the device budget (%zu bytes)",
+         name.c_str(), e.bytes, params_.device_budget);
+  std::shared_ptr<const std::vector<dense_node_t>> nodes = e.nodes;
+  forest_params_t params = e.params;
+  if (!nodes) {
+    // dropped at eviction
+    std::shared_ptr<std::vector<dense_node_t>> parsed(
+      new std::vector<dense_node_t>);
+    read_nodes(parsed.get(), &params, e.filename.c_str(), e.format,
+               &e.tl_params);
+    ASSERT(parsed->size() * sizeof(dense_node_t) == e.bytes,
+           "%s: model file %s changed since it was published", name.c_str(),
+           e.filename.c_str());
+    nodes = parsed;
+  }
+  params.nodes = nodes->data();
+  return forest_ref(new loaded_forest(handle_, name, e.version, &params));
+}
+
+void forest_registry::install(const std::string& name, entry* e,
+                              const forest_ref& forest,
+                              std::vector<forest_ref>* released) {
+  make_room(e->bytes, released);
+  e->loaded = forest;
+  lru_.push_front(name);
+  e->lru = lru_.begin();
+  device_bytes_ += e->bytes;
+  if (params_.evict == EVICT_DROP && !e->filename.empty()) e->nodes.reset();
+}
+
+forest_ref forest_registry::evict(entry* e) {
+  lru_.erase(e->lru);
+  device_bytes_ -= e->bytes;
+  return std::move(e->loaded);
+}
+
+void forest_registry::make_room(size_t bytes,
+                                std::vector<forest_ref>* released) {
+  if (params_.device_budget == 0) return;
+  while (!lru_.empty() && device_bytes_ + bytes > params_.device_budget) {
+    released->push_back(evict(models_[lru_.back()].get()));
+  }
+}
+
+}  // namespace fil
+}  // namespace ML
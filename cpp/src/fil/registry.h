@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file registry.h Serving many FIL models from one process. */
+
+#pragma once
+
+#include <cuda_runtime.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "fil.h"
+
+namespace ML {
+namespace fil {
+
+/** evict_t defines what happens to a model evicted from device memory */
+enum evict_t {
+  /** keep the nodes in host memory; reloading only copies them back */
+  EVICT_TO_HOST,
+  /** keep nothing; a model published from a file is parsed again when it is
+      needed. Models published from nodes are always kept in host memory. */
+  EVICT_DROP
+};
+
+/** registry_params_t are the parameters of a forest_registry */
+struct registry_params_t {
+  // device_budget is the maximum number of bytes of tree nodes the registry
+  // keeps in device memory, 0 for no limit
+  size_t device_budget;
+  // evict defines what happens to the least recently used models evicted to
+  // stay within device_budget
+  evict_t evict;
+};
+
+class forest_registry;
+
+/** loaded_forest is a version of a model loaded in device memory. It stays
+    valid while a reference to it is held, even after the registry evicts it or
+    replaces it with a newer version: the forest is freed when the last
+    reference goes away, once the predictions issued through it completed. */
+class loaded_forest {
+ public:
+  ~loaded_forest();
+
+  loaded_forest(const loaded_forest& other) = delete;
+  loaded_forest& operator=(const loaded_forest& other) = delete;
+
+  /** predict is fil::predict() on this version of the model; the work is
+   *  ordered on the stream of h, and the forest is kept until it completes
+   *  @param h cuML handle used by this function
+   *  @param preds array of size n in GPU memory to store predictions into
+   *  @param data array of size n * cols in GPU memory
+   *  @param n number of data rows
+   */
+  void predict(const cumlHandle& h, float* preds, const float* data,
+               size_t n);
+
+  /** name of the model */
+  const std::string& name() const { return name_; }
+  /** version of the model */
+  int version() const { return version_; }
+  /** the underlying forest; unlike predict(), using it directly does not keep
+      the forest alive until the work completes */
+  forest_t forest() const { return forest_; }
+
+ private:
+  friend class forest_registry;
+  loaded_forest(const cumlHandle& h, const std::string& name, int version,
+                const forest_params_t* params);
+
+  const cumlHandle& handle_;
+  std::string name_;
+  int version_;
+  forest_t forest_ = nullptr;
+  // the last prediction issued on each stream
+  std::vector<std::pair<cudaStream_t, cudaEvent_t>> events_;
+  std::mutex mutex_;
+};
+
+/** forest_ref is a reference-counted handle to a loaded model version */
+typedef std::shared_ptr<loaded_forest> forest_ref;
+
+/** forest_registry owns models keyed by name, each in its latest version, and
+    keeps the most recently used ones in device memory within a budget. The
+    least recently used models are evicted when loading another one would
+    exceed the budget, and reloaded on demand. Publishing a new version swaps
+    it in atomically: new references get the new version, while references
+    obtained earlier keep the old one alive. All the methods are thread-safe.
+
+    Parsing, loading and freeing forests happen outside of the registry lock,
+    so that a slow (re)load does not block the other models.
+
+    Evicted or replaced versions still referenced are not counted in the
+    budget, which only covers the versions held by the registry; neither are
+    the versions being loaded, until they are swapped in. */
+class forest_registry {
+ public:
+  /** @param h cuML handle used to load and free the forests; it must outlive
+   *      the registry and all the references obtained from it
+   *  @param params budget and eviction policy
+   */
+  forest_registry(const cumlHandle& h, const registry_params_t& params);
+  ~forest_registry();
+
+  forest_registry(const forest_registry& other) = delete;
+  forest_registry& operator=(const forest_registry& other) = delete;
+
+  /** publish adds a model, or replaces it with a newer version; the nodes
+   *  are copied, and the model is loaded in device memory
+   *  @param name name of the model
+   *  @param version version of the model, larger than the current one
+   *  @param params the forest, as for init_dense()
+   */
+  void publish(const std::string& name, int version,
+               const forest_params_t* params);
+
+  /** publish adds a model from a file, or replaces it with a newer version,
+   *  as with from_file()
+   *  @param name name of the model
+   *  @param version version of the model, larger than the current one
+   *  @param filename path to the model file, which has to stay readable if
+   *      models are evicted with EVICT_DROP
+   *  @param format format of the model file
+   *  @param tl_params additional parameters for the forest
+   */
+  void publish(const std::string& name, int version, const char* filename,
+               model_format_t format, const treelite_params_t* tl_params);
+
+  /** remove removes a model; references to it stay valid */
+  void remove(const std::string& name);
+
+  /** get returns the current version of a model, loading it in device memory
+      if it was evicted, and marks it as the most recently used */
+  forest_ref get(const std::string& name);
+
+  /** predict is get(name)->predict(h, preds, data, n) */
+  void predict(const cumlHandle& h, const std::string& name, float* preds,
+               const float* data, size_t n);
+
+  /** version returns the current version of a model, or -1 if it is not
+      registered */
+  int version(const std::string& name) const;
+
+  /** is_loaded returns whether a model is currently in device memory */
+  bool is_loaded(const std::string& name) const;
+
+  /** device_bytes returns the device memory used by the loaded models */
+  size_t device_bytes() const;
+
+  /** size returns the number of registered models */
+  size_t size() const;
+
+ private:
+  struct entry;
+
+  // build, which parses and copies to the device, runs without the lock;
+  // the other methods run under it and hand the forests they drop to the
+  // caller in released, to be freed once the lock is released
+  forest_ref build(const std::string& name, const entry& e);
+  void install(const std::string& name, entry* e, const forest_ref& forest,
+               std::vector<forest_ref>* released);
+  forest_ref evict(entry* e);
+  void make_room(size_t bytes, std::vector<forest_ref>* released);
+  void swap_in(const std::string& name, std::unique_ptr<entry> e,
+               forest_ref forest);
+
+  const cumlHandle& handle_;
+  registry_params_t params_;
+  std::map<std::string, std::unique_ptr<entry>> models_;
+  // names of the loaded models, the most recently used first
+  std::list<std::string> lru_;
+  size_t device_bytes_ = 0;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace fil
+}  // namespace ML
@@ -40,18 +40,68 @@ void olsFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
+void olsFitChunked(const cumlHandle &handle, const float *input, int n_rows,
+                   int n_cols, const float *labels, float *coef,
+                   float *intercept, bool fit_intercept, int algo,
+                   int batch_rows) {
+  olsFitChunked(handle.getImpl(), input, n_rows, n_cols, labels, coef,
+                intercept, fit_intercept, algo, batch_rows, true, false,
+                handle.getStream());
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+}
+
+void olsFitChunked(const cumlHandle &handle, const double *input, int n_rows,
+                   int n_cols, const double *labels, double *coef,
+                   double *intercept, bool fit_intercept, int algo,
+                   int batch_rows) {
+  olsFitChunked(handle.getImpl(), input, n_rows, n_cols, labels, coef,
+                intercept, fit_intercept, algo, batch_rows, true, false,
+                handle.getStream());
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+}
+
+void olsFitChunkedMG(const cumlHandle &handle, const float *input,
+                     int n_local_rows, int n_cols, const float *labels,
+                     float *coef, float *intercept, bool fit_intercept,
+                     int algo, int batch_rows) {
+  olsFitChunked(handle.getImpl(), input, n_local_rows, n_cols, labels, coef,
+                intercept, fit_intercept, algo, batch_rows, true, true,
+                handle.getStream());
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+}
+
+void olsFitChunkedMG(const cumlHandle &handle, const double *input,
+                     int n_local_rows, int n_cols, const double *labels,
+                     double *coef, double *intercept, bool fit_intercept,
+                     int algo, int batch_rows) {
+  olsFitChunked(handle.getImpl(), input, n_local_rows, n_cols, labels, coef,
+                intercept, fit_intercept, algo, batch_rows, true, true,
+                handle.getStream());
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+}
+
 void olsPredict(const cumlHandle &handle, const float *input, int n_rows,
                 int n_cols, const float *coef, float intercept, float *preds) {
-  olsPredict(handle.getImpl(), input, n_rows, n_cols, coef, intercept, preds,
-             handle.getStream());
+  const auto &h = handle.getImpl();
+  cudaStream_t stream = handle.getStream();
+  auto key = ML::detail::graphKey("olsPredict<float>", input, n_rows, n_cols,
+                                  coef, intercept, preds);
+  h.launchGraph(key, stream, [&]() {
+    olsPredict(h, input, n_rows, n_cols, coef, intercept, preds, stream);
+  });
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
 void olsPredict(const cumlHandle &handle, const double *input, int n_rows,
                 int n_cols, const double *coef, double intercept,
                 double *preds) {
-  olsPredict(handle.getImpl(), input, n_rows, n_cols, coef, intercept, preds,
-             handle.getStream());
+  const auto &h = handle.getImpl();
+  cudaStream_t stream = handle.getStream();
+  auto key = ML::detail::graphKey("olsPredict<double>", input, n_rows, n_cols,
+                                  coef, intercept, preds);
+  h.launchGraph(key, stream, [&]() {
+    olsPredict(h, input, n_rows, n_cols, coef, intercept, preds, stream);
+  });
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
@@ -71,19 +121,47 @@ void ridgeFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
+void ridgeFitSweep(const cumlHandle &handle, float *input, int n_rows,
+                   int n_cols, float *labels, const float *alpha, int n_alpha,
+                   float *coef, float *intercept, bool fit_intercept,
+                   bool normalize, int algo) {
+  ridgeFitSweep(handle.getImpl(), input, n_rows, n_cols, labels, alpha,
+                n_alpha, coef, intercept, fit_intercept, normalize,
+                handle.getStream(), algo);
+}
+
+void ridgeFitSweep(const cumlHandle &handle, double *input, int n_rows,
+                   int n_cols, double *labels, const double *alpha,
+                   int n_alpha, double *coef, double *intercept,
+                   bool fit_intercept, bool normalize, int algo) {
+  ridgeFitSweep(handle.getImpl(), input, n_rows, n_cols, labels, alpha,
+                n_alpha, coef, intercept, fit_intercept, normalize,
+                handle.getStream(), algo);
+}
+
 void ridgePredict(const cumlHandle &handle, const float *input, int n_rows,
                   int n_cols, const float *coef, float intercept,
                   float *preds) {
-  ridgePredict(handle.getImpl(), input, n_rows, n_cols, coef, intercept, preds,
-               handle.getStream());
+  const auto &h = handle.getImpl();
+  cudaStream_t stream = handle.getStream();
+  auto key = ML::detail::graphKey("ridgePredict<float>", input, n_rows, n_cols,
+                                  coef, intercept, preds);
+  h.launchGraph(key, stream, [&]() {
+    ridgePredict(h, input, n_rows, n_cols, coef, intercept, preds, stream);
+  });
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
 void ridgePredict(const cumlHandle &handle, const double *input, int n_rows,
                   int n_cols, const double *coef, double intercept,
                   double *preds) {
-  ridgePredict(handle.getImpl(), input, n_rows, n_cols, coef, intercept, preds,
-               handle.getStream());
+  const auto &h = handle.getImpl();
+  cudaStream_t stream = handle.getStream();
+  auto key = ML::detail::graphKey("ridgePredict<double>", input, n_rows, n_cols,
+                                  coef, intercept, preds);
+  h.launchGraph(key, stream, [&]() {
+    ridgePredict(h, input, n_rows, n_cols, coef, intercept, preds, stream);
+  });
   CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
 }
 
@@ -110,15 +188,28 @@ void qnFit(const cumlHandle &cuml_handle, double *X, double *y, int N, int D,
 void qnPredict(const cumlHandle &cuml_handle, float *X, int N, int D, int C,
                bool fit_intercept, float *params, bool X_col_major,
                int loss_type, float *preds) {
-  qnPredict(cuml_handle.getImpl(), X, N, D, C, fit_intercept, params,
-            X_col_major, loss_type, preds, cuml_handle.getStream());
+  const auto &h = cuml_handle.getImpl();
+  cudaStream_t stream = cuml_handle.getStream();
+  auto key = ML::detail::graphKey("qnPredict<float>", X, N, D, C, fit_intercept,
+                                  params, X_col_major, loss_type, preds);
+  h.launchGraph(key, stream, [&]() {
+    qnPredict(h, X, N, D, C, fit_intercept, params, X_col_major, loss_type,
+              preds, stream);
+  });
 }
 
 void qnPredict(const cumlHandle &cuml_handle, double *X, int N, int D, int C,
                bool fit_intercept, double *params, bool X_col_major,
                int loss_type, double *preds) {
-  qnPredict(cuml_handle.getImpl(), X, N, D, C, fit_intercept, params,
-            X_col_major, loss_type, preds, cuml_handle.getStream());
+  const auto &h = cuml_handle.getImpl();
+  cudaStream_t stream = cuml_handle.getStream();
+  auto key = ML::detail::graphKey("qnPredict<double>", X, N, D, C,
+                                  fit_intercept, params, X_col_major, loss_type,
+                                  preds);
+  h.launchGraph(key, stream, [&]() {
+    qnPredict(h, X, N, D, C, fit_intercept, params, X_col_major, loss_type,
+              preds, stream);
+  });
 }
 
 }  // namespace GLM
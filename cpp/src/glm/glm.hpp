@@ -29,7 +29,8 @@ namespace GLM {
  * @param intercept     device pointer to hold the solution for bias term of size 1
  * @param fit_intercept if true, fit intercept
  * @param normalize     if true, normalize data to zero mean, unit variance
- * @param algo          specifies which solver to use (0: SVD, 1: Eigendecomposition, 2: QR-decomposition)
+ * @param algo          specifies which solver to use (0: SVD, 1: Eigendecomposition, 2: QR-decomposition,
+ *                      3: normal equations accumulated over row chunks, 4: TSQR over row chunks)
  * @{
  */
 void olsFit(const cumlHandle &handle, float *input, int n_rows, int n_cols,
@@ -40,6 +41,44 @@ void olsFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
             bool normalize, int algo = 0);
 /** @} */
 
+/**
+ * @defgroup Functions fit an ordinary least squares model on a matrix that
+ * does not fit in device memory, by streaming it in chunks of batch_rows rows.
+ * Device memory use is O(n_cols^2) beyond one chunk.
+ * @param input         host or device pointer to feature matrix n_rows x n_cols (col major)
+ * @param n_rows        number of rows of the feature matrix
+ * @param n_cols        number of columns of the feature matrix
+ * @param labels        host or device pointer to label vector of length n_rows
+ * @param coef          device pointer to hold the solution for weights of size n_cols
+ * @param intercept     host pointer to hold the solution for bias term of size 1
+ * @param fit_intercept if true, fit intercept
+ * @param algo          3: normal equations solved by Cholesky, with an eigendecomposition
+ *                      fallback for singular systems, 4: TSQR (for ill-conditioned inputs)
+ * @param batch_rows    number of rows copied to the device at a time
+ * @{
+ */
+void olsFitChunked(const cumlHandle &handle, const float *input, int n_rows,
+                   int n_cols, const float *labels, float *coef,
+                   float *intercept, bool fit_intercept, int algo = 3,
+                   int batch_rows = 1 << 16);
+void olsFitChunked(const cumlHandle &handle, const double *input, int n_rows,
+                   int n_cols, const double *labels, double *coef,
+                   double *intercept, bool fit_intercept, int algo = 3,
+                   int batch_rows = 1 << 16);
+
+/* Multi-rank variant over the communicator of handle: every rank passes its
+   local rows, the per-rank states are merged, and every rank gets the model
+   fitted on all of the rows. */
+void olsFitChunkedMG(const cumlHandle &handle, const float *input,
+                     int n_local_rows, int n_cols, const float *labels,
+                     float *coef, float *intercept, bool fit_intercept,
+                     int algo = 3, int batch_rows = 1 << 16);
+void olsFitChunkedMG(const cumlHandle &handle, const double *input,
+                     int n_local_rows, int n_cols, const double *labels,
+                     double *coef, double *intercept, bool fit_intercept,
+                     int algo = 3, int batch_rows = 1 << 16);
+/** @} */
+
 /**
  * @defgroup Functions fit a ridge regression model (l2 regularized least squares)
  * @param input         device pointer to feature matrix n_rows x n_cols
@@ -66,6 +105,34 @@ void ridgeFit(const cumlHandle &handle, double *input, int n_rows, int n_cols,
               int algo = 0);
 /** @} */
 
+/**
+ * @defgroup Functions fit one ridge regression model per regularization
+ * strength, sharing the preprocessing and the decomposition of the data
+ * @param input         device pointer to feature matrix n_rows x n_cols
+ * @param n_rows        number of rows of the feature matrix
+ * @param n_cols        number of columns of the feature matrix
+ * @param labels        device pointer to label vector of length n_rows
+ * @param alpha         host pointer to the n_alpha regularization strengths
+ * @param n_alpha       number of models
+ * @param coef          device pointer to hold the weights of the models,
+ *                      model i at coef + i * n_cols
+ * @param intercept     host pointer to hold the bias terms of the models
+ * @param fit_intercept if true, fit intercept
+ * @param normalize     if true, normalize data to zero mean, unit variance
+ * @param algo          specifies which solver to use (0: SVD, 1: Eigendecomposition)
+ * @{
+ */
+void ridgeFitSweep(const cumlHandle &handle, float *input, int n_rows,
+                   int n_cols, float *labels, const float *alpha, int n_alpha,
+                   float *coef, float *intercept, bool fit_intercept,
+                   bool normalize, int algo = 0);
+
+void ridgeFitSweep(const cumlHandle &handle, double *input, int n_rows,
+                   int n_cols, double *labels, const double *alpha,
+                   int n_alpha, double *coef, double *intercept,
+                   bool fit_intercept, bool normalize, int algo = 0);
+/** @} */
+
 /**
  * @defgroup Functions to make predictions with a fitted ordinary least squares and ridge regression model
  * @param input         device pointer to feature matrix n_rows x n_cols
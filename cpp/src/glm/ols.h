@@ -30,6 +30,7 @@
 #include "common/cumlHandle.hpp"
 #include "common/device_buffer.hpp"
 #include "ml_utils.h"
+#include "ols_streaming.h"
 #include "preprocess.h"
 
 namespace ML {
@@ -47,7 +48,8 @@ using namespace MLCommon;
  * @param intercept     device pointer to hold the solution for bias term of size 1
  * @param fit_intercept if true, fit intercept
  * @param normalize     if true, normalize data to zero mean, unit variance
- * @param algo          specifies which solver to use (0: SVD, 1: Eigendecomposition, 2: QR-decomposition)
+ * @param algo          specifies which solver to use (0: SVD, 1: Eigendecomposition, 2: QR-decomposition,
+ *                      3: normal equations accumulated over row chunks, 4: TSQR over row chunks)
  * @{
  */
 template <typename math_t>
@@ -62,6 +64,16 @@ void olsFit(const cumlHandle_impl &handle, math_t *input, int n_rows,
   ASSERT(n_cols > 0, "olsFit: number of columns cannot be less than one");
   ASSERT(n_rows > 1, "olsFit: number of rows cannot be less than two");
 
+  // the chunked solvers neither modify the input nor need a copy of it, and
+  // handle the intercept themselves; normalization does not change their
+  // solution
+  if (algo == 3 || algo == 4) {
+    int batch_rows = std::max(OLS_STREAM_CHUNK_ELEMS / (n_cols + 2), 1);
+    olsFitChunked(handle, input, n_rows, n_cols, labels, coef, intercept,
+                  fit_intercept, algo, batch_rows, false, false, stream);
+    return;
+  }
+
   device_buffer<math_t> mu_input(allocator, stream);
   device_buffer<math_t> norm2_input(allocator, stream);
   device_buffer<math_t> mu_labels(allocator, stream);
@@ -86,8 +98,6 @@ void olsFit(const cumlHandle_impl &handle, math_t *input, int n_rows,
   } else if (algo == 2) {
     LinAlg::lstsqQR(input, n_rows, n_cols, labels, coef, cusolver_handle,
                     cublas_handle, allocator, stream);
-  } else if (algo == 3) {
-    ASSERT(false, "olsFit: no algorithm with this id has been implemented");
   } else {
     ASSERT(false, "olsFit: no algorithm with this id has been implemented");
   }
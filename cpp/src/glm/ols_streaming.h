@@ -0,0 +1,587 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <linalg/cublas_wrappers.h>
+#include <linalg/cusolver_wrappers.h>
+#include <linalg/eig.h>
+#include <linalg/eltwise.h>
+#include <linalg/gemm.h>
+#include <linalg/gemv.h>
+#include <linalg/lstsq.h>
+#include <matrix/matrix.h>
+#include <stats/mean.h>
+#include <stats/mean_center.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "common/cumlHandle.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "ml_utils.h"
+
+namespace ML {
+namespace GLM {
+
+using namespace MLCommon;
+
+/** number of elements of the per-chunk device workspace used by olsFit */
+#define OLS_STREAM_CHUNK_ELEMS (1 << 24)
+
+static const int OLS_STREAM_TPB = 256;
+
+/**
+ * Copies n_rows rows of the column major matrix input (leading dimension
+ * ld_in) into out (leading dimension ld_out), followed by n_ones columns of
+ * ones and the labels as the last column.
+ */
+template <typename math_t>
+__global__ void olsGatherChunkKernel(math_t *out, int ld_out,
+                                     const math_t *input, int ld_in,
+                                     const math_t *labels, int n_rows,
+                                     int n_cols, int n_ones) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  int j = blockIdx.y;
+  if (i >= n_rows) return;
+  math_t v;
+  if (j < n_cols) {
+    v = input[i + size_t(j) * ld_in];
+  } else if (j < n_cols + n_ones) {
+    v = math_t(1);
+  } else {
+    v = labels[i];
+  }
+  out[i + size_t(j) * ld_out] = v;
+}
+
+template <typename math_t>
+void olsGatherChunk(math_t *out, int ld_out, const math_t *input, int ld_in,
+                    const math_t *labels, int n_rows, int n_cols, int n_ones,
+                    cudaStream_t stream) {
+  ASSERT(n_cols + n_ones + 1 <= 65535,
+         "olsFit: streaming solvers support at most 65534 columns");
+  dim3 grid(ceildiv(n_rows, OLS_STREAM_TPB), n_cols + n_ones + 1);
+  olsGatherChunkKernel<<<grid, OLS_STREAM_TPB, 0, stream>>>(
+    out, ld_out, input, ld_in, labels, n_rows, n_cols, n_ones);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+/**
+ * Pairwise update of the upper triangle of centered co-moments (Chan et al.):
+ * C += C_other + weight * (mu_other - mu) (mu_other - mu)^T
+ */
+template <typename math_t>
+__global__ void comomentMergeKernel(math_t *comoment, const math_t *mean,
+                                    const math_t *other_comoment,
+                                    const math_t *other_mean, math_t weight,
+                                    int len) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  int j = blockIdx.y;
+  if (i >= len || i > j) return;
+  math_t di = other_mean[i] - mean[i];
+  math_t dj = other_mean[j] - mean[j];
+  comoment[i + j * len] += other_comoment[i + j * len] + weight * di * dj;
+}
+
+template <typename math_t>
+__global__ void meanMergeKernel(math_t *mean, const math_t *other_mean,
+                                math_t frac, int len) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  if (i >= len) return;
+  mean[i] += frac * (other_mean[i] - mean[i]);
+}
+
+template <typename math_t>
+DI math_t normalEqGram(const math_t *mean, const math_t *comoment,
+                       math_t n_seen, int ld, int r, int c,
+                       bool fit_intercept) {
+  math_t g = r <= c ? comoment[r + c * ld] : comoment[c + r * ld];
+  if (!fit_intercept) g += n_seen * mean[r] * mean[c];
+  return g;
+}
+
+/**
+ * Builds the symmetrically equilibrated system S X^T X S and S X^T y from the
+ * accumulated moments, with S = diag(X^T X)^(-1/2). Block column n_cols of
+ * the grid writes the right hand side and the scaling.
+ */
+template <typename math_t>
+__global__ void normalEqBuildKernel(math_t *A, math_t *b, math_t *scale,
+                                    const math_t *mean, const math_t *comoment,
+                                    math_t n_seen, int n_cols,
+                                    bool fit_intercept) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  int j = blockIdx.y;
+  int ld = n_cols + 1;
+  if (i >= n_cols) return;
+  math_t gii = normalEqGram(mean, comoment, n_seen, ld, i, i, fit_intercept);
+  math_t si = gii > math_t(0) ? math_t(1) / mySqrt(gii) : math_t(1);
+  if (j == n_cols) {
+    b[i] = si *
+           normalEqGram(mean, comoment, n_seen, ld, i, n_cols, fit_intercept);
+    scale[i] = si;
+    return;
+  }
+  math_t gjj = normalEqGram(mean, comoment, n_seen, ld, j, j, fit_intercept);
+  math_t sj = gjj > math_t(0) ? math_t(1) / mySqrt(gjj) : math_t(1);
+  A[i + j * n_cols] =
+    si * sj * normalEqGram(mean, comoment, n_seen, ld, i, j, fit_intercept);
+}
+
+/**
+ * Accumulates the normal equations of a least squares problem over row
+ * chunks. Each chunk [X y] is centered on its own mean and its co-moments
+ * are merged into the running ones pairwise, which avoids the cancellation
+ * of forming X^T X - n mu mu^T from raw sums. The state is
+ * O((n_cols + 1)^2) regardless of the number of rows, and the states of
+ * several ranks merge the same way the chunks do.
+ */
+template <typename math_t>
+class NormalEqAccumulator {
+ public:
+  NormalEqAccumulator(const cumlHandle_impl &handle, int n_cols,
+                      cudaStream_t stream)
+    : handle(handle),
+      n_cols(n_cols),
+      n_aug(n_cols + 1),
+      n_seen(0),
+      stream(stream),
+      mean(handle.getDeviceAllocator(), stream, n_cols + 1),
+      comoment(handle.getDeviceAllocator(), stream,
+               (n_cols + 1) * (n_cols + 1)),
+      chunk_mean(handle.getDeviceAllocator(), stream, n_cols + 1),
+      chunk_comoment(handle.getDeviceAllocator(), stream,
+                     (n_cols + 1) * (n_cols + 1)),
+      workspace(handle.getDeviceAllocator(), stream) {
+    ASSERT(n_cols > 0, "olsFit: number of columns cannot be less than one");
+    CUDA_CHECK(
+      cudaMemsetAsync(mean.data(), 0, sizeof(math_t) * n_aug, stream));
+    CUDA_CHECK(cudaMemsetAsync(comoment.data(), 0,
+                               sizeof(math_t) * n_aug * n_aug, stream));
+  }
+
+  /**
+   * @param input  device pointer to n_rows rows of the feature matrix, col
+   *               major with leading dimension ld
+   * @param labels device pointer to the n_rows matching labels
+   */
+  void update(const math_t *input, int ld, const math_t *labels,
+              int n_rows) {
+    if (n_rows == 0) return;
+    workspace.resize(size_t(n_rows) * n_aug, stream);
+    olsGatherChunk(workspace.data(), n_rows, input, ld, labels, n_rows,
+                   n_cols, 0, stream);
+    Stats::mean(chunk_mean.data(), workspace.data(), n_aug, n_rows, false,
+                false, stream);
+    Stats::meanCenter(workspace.data(), workspace.data(), chunk_mean.data(),
+                      n_aug, n_rows, false, true, stream);
+    math_t one = math_t(1), zero = math_t(0);
+    CUBLAS_CHECK(LinAlg::cublassyrk(
+      handle.getCublasHandle(), CUBLAS_FILL_MODE_UPPER, CUBLAS_OP_T, n_aug,
+      n_rows, &one, workspace.data(), n_rows, &zero, chunk_comoment.data(),
+      n_aug, stream));
+    merge(chunk_mean.data(), chunk_comoment.data(), n_rows);
+  }
+
+  /** Merges the states of all the ranks of the handle's communicator, in
+   *  rank order, so that every rank ends up with identical moments. */
+  void merge_mg() {
+    const MLCommon::cumlCommunicator &comm = handle.getCommunicator();
+    auto allocator = handle.getDeviceAllocator();
+    int n_ranks = comm.getSize();
+    int len = n_aug + n_aug * n_aug;
+
+    device_buffer<int64_t> d_count(allocator, stream, 1);
+    device_buffer<int64_t> d_counts(allocator, stream, n_ranks);
+    device_buffer<math_t> d_state(allocator, stream, len);
+    device_buffer<math_t> d_states(allocator, stream, size_t(n_ranks) * len);
+    int64_t count = n_seen;
+    updateDevice(d_count.data(), &count, 1, stream);
+    copy(d_state.data(), mean.data(), n_aug, stream);
+    copy(d_state.data() + n_aug, comoment.data(), n_aug * n_aug, stream);
+    comm.allgather(d_count.data(), d_counts.data(), 1, stream);
+    comm.allgather(d_state.data(), d_states.data(), len, stream);
+
+    std::vector<int64_t> counts(n_ranks);
+    updateHost(counts.data(), d_counts.data(), n_ranks, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+
+    n_seen = 0;
+    CUDA_CHECK(
+      cudaMemsetAsync(mean.data(), 0, sizeof(math_t) * n_aug, stream));
+    CUDA_CHECK(cudaMemsetAsync(comoment.data(), 0,
+                               sizeof(math_t) * n_aug * n_aug, stream));
+    for (int r = 0; r < n_ranks; r++) {
+      const math_t *state = d_states.data() + size_t(r) * len;
+      merge(state, state + n_aug, counts[r]);
+    }
+  }
+
+  /**
+   * Solves the accumulated normal equations by Cholesky. A numerically
+   * singular system (rank deficient X) falls back to the pseudo-inverse from
+   * an eigendecomposition of the same small system.
+   * @param coef      device pointer to hold the n_cols weights
+   * @param intercept host pointer to hold the bias term
+   */
+  void solve(math_t *coef, math_t *intercept, bool fit_intercept) {
+    ASSERT(n_seen > 1, "olsFit: number of rows cannot be less than two");
+    auto allocator = handle.getDeviceAllocator();
+    auto cusolver_handle = handle.getcusolverDnHandle();
+    auto cublas_handle = handle.getCublasHandle();
+    int n = n_cols;
+
+    device_buffer<math_t> A(allocator, stream, n * n);
+    device_buffer<math_t> L(allocator, stream, n * n);
+    device_buffer<math_t> b(allocator, stream, n);
+    device_buffer<math_t> scale(allocator, stream, n);
+    device_buffer<int> d_info(allocator, stream, 1);
+    dim3 grid(ceildiv(n, OLS_STREAM_TPB), n + 1);
+    normalEqBuildKernel<<<grid, OLS_STREAM_TPB, 0, stream>>>(
+      A.data(), b.data(), scale.data(), mean.data(), comoment.data(),
+      math_t(n_seen), n, fit_intercept);
+    CUDA_CHECK(cudaPeekAtLastError());
+    copy(L.data(), A.data(), n * n, stream);
+
+    int lwork;
+    CUSOLVER_CHECK(LinAlg::cusolverDnpotrf_bufferSize(
+      cusolver_handle, CUBLAS_FILL_MODE_LOWER, n, L.data(), n, &lwork));
+    device_buffer<math_t> work(allocator, stream, lwork);
+    CUSOLVER_CHECK(LinAlg::cusolverDnpotrf(
+      cusolver_handle, CUBLAS_FILL_MODE_LOWER, n, L.data(), n, work.data(),
+      lwork, d_info.data(), stream));
+
+    int info;
+    std::vector<math_t> pivots(n);
+    updateHost(&info, d_info.data(), 1, stream);
+    CUDA_CHECK(cudaMemcpy2DAsync(pivots.data(), sizeof(math_t), L.data(),
+                                 sizeof(math_t) * (n + 1), sizeof(math_t), n,
+                                 cudaMemcpyDeviceToHost, stream));
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+
+    // diag(A) is one after equilibration, so the smallest squared pivot of
+    // the factor is a cheap lower bound on the reciprocal condition number
+    math_t eps = std::numeric_limits<math_t>::epsilon();
+    bool use_cholesky = info == 0;
+    if (use_cholesky) {
+      math_t min_pivot = std::abs(pivots[0]);
+      for (int i = 1; i < n; i++) {
+        min_pivot = std::min(min_pivot, std::abs(pivots[i]));
+      }
+      use_cholesky = min_pivot * min_pivot > math_t(n) * eps;
+    }
+
+    if (use_cholesky) {
+      CUSOLVER_CHECK(LinAlg::cusolverDnpotrs(
+        cusolver_handle, CUBLAS_FILL_MODE_LOWER, n, 1, L.data(), n, b.data(),
+        n, d_info.data(), stream));
+      copy(coef, b.data(), n, stream);
+    } else {
+      device_buffer<math_t> V(allocator, stream, n * n);
+      device_buffer<math_t> w(allocator, stream, n);
+      device_buffer<math_t> tmp(allocator, stream, n);
+      LinAlg::eigDC(A.data(), n, n, V.data(), w.data(), cusolver_handle,
+                    stream, allocator);
+      LinAlg::gemv(V.data(), n, n, b.data(), tmp.data(), true, cublas_handle,
+                   stream);
+      std::vector<math_t> w_h(n);
+      updateHost(w_h.data(), w.data(), n, stream);
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      // eigenvalues are in ascending order
+      math_t cutoff = w_h[n - 1] * math_t(n) * eps;
+      for (int i = 0; i < n; i++) {
+        w_h[i] = w_h[i] > cutoff ? math_t(1) / w_h[i] : math_t(0);
+      }
+      updateDevice(w.data(), w_h.data(), n, stream);
+      LinAlg::eltwiseMultiply(tmp.data(), tmp.data(), w.data(), n, stream);
+      LinAlg::gemv(V.data(), n, n, tmp.data(), coef, false, cublas_handle,
+                   stream);
+    }
+    LinAlg::eltwiseMultiply(coef, coef, scale.data(), n, stream);
+
+    if (fit_intercept) {
+      // intercept = mu_y - mu_x . coef
+      device_buffer<math_t> d_dot(allocator, stream, 1);
+      LinAlg::gemm(mean.data(), 1, n, coef, d_dot.data(), 1, 1, CUBLAS_OP_N,
+                   CUBLAS_OP_N, cublas_handle, stream);
+      math_t dot, mu_y;
+      updateHost(&dot, d_dot.data(), 1, stream);
+      updateHost(&mu_y, mean.data() + n, 1, stream);
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      *intercept = mu_y - dot;
+    } else {
+      *intercept = math_t(0);
+    }
+  }
+
+ private:
+  void merge(const math_t *other_mean, const math_t *other_comoment,
+             int64_t n_other) {
+    if (n_other == 0) return;
+    double na = double(n_seen), nb = double(n_other);
+    math_t weight = math_t(na * nb / (na + nb));
+    math_t frac = math_t(nb / (na + nb));
+    dim3 grid(ceildiv(n_aug, OLS_STREAM_TPB), n_aug);
+    comomentMergeKernel<<<grid, OLS_STREAM_TPB, 0, stream>>>(
+      comoment.data(), mean.data(), other_comoment, other_mean, weight, n_aug);
+    CUDA_CHECK(cudaPeekAtLastError());
+    meanMergeKernel<<<ceildiv(n_aug, OLS_STREAM_TPB), OLS_STREAM_TPB, 0,
+                      stream>>>(mean.data(), other_mean, frac, n_aug);
+    CUDA_CHECK(cudaPeekAtLastError());
+    n_seen += n_other;
+  }
+
+  const cumlHandle_impl &handle;
+  int n_cols, n_aug;
+  int64_t n_seen;
+  cudaStream_t stream;
+  device_buffer<math_t> mean, comoment, chunk_mean, chunk_comoment;
+  device_buffer<math_t> workspace;
+};
+
+/**
+ * Communication-avoiding tall-skinny QR of [X 1 y] over row chunks. The
+ * running R factor is stacked on top of each new chunk and refactorized, so
+ * only the (n_cols + 2)^2 triangle is kept between chunks. The R factors of
+ * several ranks are reduced by one more QR of their stack. X is never formed
+ * into X^T X, so the conditioning of the problem is not squared.
+ */
+template <typename math_t>
+class TsqrAccumulator {
+ public:
+  TsqrAccumulator(const cumlHandle_impl &handle, int n_cols,
+                  cudaStream_t stream)
+    : handle(handle),
+      n_cols(n_cols),
+      n_aug(n_cols + 2),
+      has_r(false),
+      stream(stream),
+      R(handle.getDeviceAllocator(), stream, (n_cols + 2) * (n_cols + 2)),
+      workspace(handle.getDeviceAllocator(), stream),
+      tau(handle.getDeviceAllocator(), stream, n_cols + 2),
+      work(handle.getDeviceAllocator(), stream),
+      d_info(handle.getDeviceAllocator(), stream, 1) {
+    ASSERT(n_cols > 0, "olsFit: number of columns cannot be less than one");
+    CUDA_CHECK(
+      cudaMemsetAsync(R.data(), 0, sizeof(math_t) * n_aug * n_aug, stream));
+  }
+
+  /** same arguments as NormalEqAccumulator::update */
+  void update(const math_t *input, int ld, const math_t *labels,
+              int n_rows) {
+    if (n_rows == 0) return;
+    int r = has_r ? n_aug : 0;
+    // pad with zero rows so that the stack is never wider than tall
+    int m = std::max(r + n_rows, n_aug);
+    workspace.resize(size_t(m) * n_aug, stream);
+    if (m > r + n_rows) {
+      CUDA_CHECK(cudaMemsetAsync(workspace.data(), 0,
+                                 sizeof(math_t) * m * n_aug, stream));
+    }
+    if (has_r) {
+      CUDA_CHECK(cudaMemcpy2DAsync(
+        workspace.data(), sizeof(math_t) * m, R.data(), sizeof(math_t) * n_aug,
+        sizeof(math_t) * n_aug, n_aug, cudaMemcpyDeviceToDevice, stream));
+    }
+    olsGatherChunk(workspace.data() + r, m, input, ld, labels, n_rows, n_cols,
+                   1, stream);
+    factorize(m);
+  }
+
+  /** Reduces the R factors of all the ranks of the handle's communicator. */
+  void merge_mg() {
+    const MLCommon::cumlCommunicator &comm = handle.getCommunicator();
+    auto allocator = handle.getDeviceAllocator();
+    int n_ranks = comm.getSize();
+    int len = n_aug * n_aug;
+
+    device_buffer<math_t> gathered(allocator, stream, size_t(n_ranks) * len);
+    comm.allgather(R.data(), gathered.data(), len, stream);
+
+    int m = n_ranks * n_aug;
+    workspace.resize(size_t(m) * n_aug, stream);
+    for (int r = 0; r < n_ranks; r++) {
+      CUDA_CHECK(cudaMemcpy2DAsync(
+        workspace.data() + r * n_aug, sizeof(math_t) * m,
+        gathered.data() + size_t(r) * len, sizeof(math_t) * n_aug,
+        sizeof(math_t) * n_aug, n_aug, cudaMemcpyDeviceToDevice, stream));
+    }
+    factorize(m);
+  }
+
+  /**
+   * Back substitution on the leading block of R. A numerically singular
+   * triangle (rank deficient X) falls back to an SVD of that block.
+   * @param coef      device pointer to hold the n_cols weights
+   * @param intercept host pointer to hold the bias term
+   */
+  void solve(math_t *coef, math_t *intercept, bool fit_intercept) {
+    ASSERT(has_r, "olsFit: number of rows cannot be less than two");
+    auto allocator = handle.getDeviceAllocator();
+    auto cusolver_handle = handle.getcusolverDnHandle();
+    auto cublas_handle = handle.getCublasHandle();
+
+    // QR is column sequential: the leading k x k block of R and the first k
+    // entries of its last column are the R factor and Q^T y of the first k
+    // columns of [X 1] alone
+    int k = fit_intercept ? n_cols + 1 : n_cols;
+    device_buffer<math_t> Rk(allocator, stream, k * k);
+    device_buffer<math_t> rhs(allocator, stream, k);
+    device_buffer<math_t> sol(allocator, stream, k);
+    CUDA_CHECK(cudaMemcpy2DAsync(Rk.data(), sizeof(math_t) * k, R.data(),
+                                 sizeof(math_t) * n_aug, sizeof(math_t) * k,
+                                 k, cudaMemcpyDeviceToDevice, stream));
+    copy(rhs.data(), R.data() + (n_aug - 1) * n_aug, k, stream);
+
+    std::vector<math_t> diag(k);
+    CUDA_CHECK(cudaMemcpy2DAsync(diag.data(), sizeof(math_t), Rk.data(),
+                                 sizeof(math_t) * (k + 1), sizeof(math_t), k,
+                                 cudaMemcpyDeviceToHost, stream));
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    math_t max_diag = math_t(0), min_diag = std::numeric_limits<math_t>::max();
+    for (int i = 0; i < k; i++) {
+      max_diag = std::max(max_diag, std::abs(diag[i]));
+      min_diag = std::min(min_diag, std::abs(diag[i]));
+    }
+    math_t eps = std::numeric_limits<math_t>::epsilon();
+
+    if (k == 1 || min_diag > max_diag * math_t(k) * eps) {
+      const math_t one = 1;
+      CUBLAS_CHECK(LinAlg::cublastrsm(
+        cublas_handle, CUBLAS_SIDE_LEFT, CUBLAS_FILL_MODE_UPPER, CUBLAS_OP_N,
+        CUBLAS_DIAG_NON_UNIT, k, 1, &one, Rk.data(), k, rhs.data(), k,
+        stream));
+      copy(sol.data(), rhs.data(), k, stream);
+    } else {
+      LinAlg::lstsqSVD(Rk.data(), k, k, rhs.data(), sol.data(),
+                       cusolver_handle, cublas_handle, allocator, stream);
+    }
+
+    copy(coef, sol.data(), n_cols, stream);
+    if (fit_intercept) {
+      updateHost(intercept, sol.data() + n_cols, 1, stream);
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+    } else {
+      *intercept = math_t(0);
+    }
+  }
+
+ private:
+  /** QR of the m x n_aug stack in the workspace, keeping its R factor */
+  void factorize(int m) {
+    auto cusolver_handle = handle.getcusolverDnHandle();
+    int lwork;
+    CUSOLVER_CHECK(LinAlg::cusolverDngeqrf_bufferSize(
+      cusolver_handle, m, n_aug, workspace.data(), m, &lwork));
+    work.resize(lwork, stream);
+    CUSOLVER_CHECK(LinAlg::cusolverDngeqrf(
+      cusolver_handle, m, n_aug, workspace.data(), m, tau.data(), work.data(),
+      lwork, d_info.data(), stream));
+    CUDA_CHECK(
+      cudaMemsetAsync(R.data(), 0, sizeof(math_t) * n_aug * n_aug, stream));
+    Matrix::copyUpperTriangular(workspace.data(), R.data(), m, n_aug, stream);
+    has_r = true;
+  }
+
+  const cumlHandle_impl &handle;
+  int n_cols, n_aug;
+  bool has_r;
+  cudaStream_t stream;
+  device_buffer<math_t> R, workspace, tau, work;
+  device_buffer<int> d_info;
+};
+
+/**
+ * Feeds an n_rows x n_cols column major matrix to an accumulator in chunks
+ * of batch_rows rows. With stage set, each chunk is first copied into a
+ * device buffer, so input and labels may also be host pointers.
+ */
+template <typename math_t, typename AccumT>
+void olsAccumulateChunks(AccumT &acc, const math_t *input, int n_rows,
+                         int n_cols, const math_t *labels, int batch_rows,
+                         bool stage, const cumlHandle_impl &handle,
+                         cudaStream_t stream) {
+  ASSERT(batch_rows > 0, "olsFit: batch_rows must be positive");
+  device_buffer<math_t> x_chunk(handle.getDeviceAllocator(), stream);
+  device_buffer<math_t> y_chunk(handle.getDeviceAllocator(), stream);
+  if (stage) {
+    x_chunk.resize(size_t(std::min(batch_rows, n_rows)) * n_cols, stream);
+    y_chunk.resize(std::min(batch_rows, n_rows), stream);
+  }
+  for (int start = 0; start < n_rows; start += batch_rows) {
+    int rows = std::min(batch_rows, n_rows - start);
+    if (stage) {
+      CUDA_CHECK(cudaMemcpy2DAsync(
+        x_chunk.data(), sizeof(math_t) * rows, input + start,
+        sizeof(math_t) * n_rows, sizeof(math_t) * rows, n_cols,
+        cudaMemcpyDefault, stream));
+      copy(y_chunk.data(), labels + start, rows, stream);
+      acc.update(x_chunk.data(), rows, y_chunk.data(), rows);
+    } else {
+      acc.update(input + start, n_rows, labels + start, rows);
+    }
+  }
+}
+
+/**
+ * @defgroup Functions fit an ordinary least squares model over row chunks,
+ * with O(n_cols^2) device memory beyond one chunk
+ * @param input         pointer to feature matrix n_rows x n_cols (col major),
+ *                      on the device, or on the host when stage is set
+ * @param n_rows        number of (local) rows of the feature matrix
+ * @param n_cols        number of columns of the feature matrix
+ * @param labels        pointer to label vector of length n_rows
+ * @param coef          device pointer to hold the solution for weights of size n_cols
+ * @param intercept     host pointer to hold the solution for bias term of size 1
+ * @param fit_intercept if true, fit intercept
+ * @param algo          3: normal equations (Cholesky), 4: TSQR
+ * @param batch_rows    number of rows processed at a time
+ * @param stage         copy each chunk to the device before processing it
+ * @param multi_rank    merge the accumulated state over the communicator of
+ *                      the handle before solving; every rank gets the model
+ * @{
+ */
+template <typename math_t>
+void olsFitChunked(const cumlHandle_impl &handle, const math_t *input,
+                   int n_rows, int n_cols, const math_t *labels, math_t *coef,
+                   math_t *intercept, bool fit_intercept, int algo,
+                   int batch_rows, bool stage, bool multi_rank,
+                   cudaStream_t stream) {
+  ASSERT(multi_rank || n_rows > 1,
+         "olsFit: number of rows cannot be less than two");
+  if (algo == 3) {
+    NormalEqAccumulator<math_t> acc(handle, n_cols, stream);
+    olsAccumulateChunks(acc, input, n_rows, n_cols, labels, batch_rows, stage,
+                        handle, stream);
+    if (multi_rank) acc.merge_mg();
+    acc.solve(coef, intercept, fit_intercept);
+  } else if (algo == 4) {
+    TsqrAccumulator<math_t> acc(handle, n_cols, stream);
+    olsAccumulateChunks(acc, input, n_rows, n_cols, labels, batch_rows, stage,
+                        handle, stream);
+    if (multi_rank) acc.merge_mg();
+    acc.solve(coef, intercept, fit_intercept);
+  } else {
+    ASSERT(false, "olsFit: algo %d is not a streaming solver", algo);
+  }
+}
+/** @} */
+
+};  // namespace GLM
+};  // namespace ML
+// end namespace ML
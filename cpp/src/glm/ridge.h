@@ -21,13 +21,16 @@
 #include <linalg/norm.h>
 #include <linalg/subtract.h>
 #include <linalg/svd.h>
+#include <linalg/unary_op.h>
 #include <matrix/math.h>
 #include <matrix/matrix.h>
 #include <stats/mean.h>
 #include <stats/mean_center.h>
 #include <stats/stddev.h>
 #include <stats/sum.h>
+#include <vector>
 #include "common/cumlHandle.hpp"
+#include "common/device_buffer.hpp"
 #include "ml_utils.h"
 #include "preprocess.h"
 
@@ -192,6 +195,134 @@ void ridgeFit(const cumlHandle_impl &handle, math_t *input, int n_rows,
   }
 }
 
+/**
+ * Scales U^T b by the ridge filter factors s / (s^2 + alpha) of every alpha.
+ * The output is the n_cols x n_alpha column major matrix of the solutions in
+ * the basis of the right singular vectors.
+ */
+template <typename math_t>
+__global__ void ridgeSweepFactorsKernel(math_t *out, const math_t *S,
+                                        const math_t *Utb,
+                                        const math_t *alpha, int n_cols,
+                                        int n_alpha) {
+  int len = n_cols * n_alpha;
+  for (int idx = blockIdx.x * blockDim.x + threadIdx.x; idx < len;
+       idx += gridDim.x * blockDim.x) {
+    int j = idx % n_cols;
+    math_t s = S[j];
+    out[idx] = s == math_t(0)
+                 ? math_t(0)
+                 : s * Utb[j] / (s * s + alpha[idx / n_cols]);
+  }
+}
+
+/**
+ * @brief Fit one ridge model per regularization strength on the same data.
+ *
+ * The centering/normalization and the decomposition of the input are done
+ * once for all the models, and all the solutions come from a single gemm
+ * with the right singular vectors: w(alpha) = V * diag(s / (s^2 + alpha)) *
+ * U^T * b. The input and labels are restored on return.
+ *
+ * @param input         device pointer to feature matrix n_rows x n_cols
+ * @param n_rows        number of rows of the feature matrix
+ * @param n_cols        number of columns of the feature matrix
+ * @param labels        device pointer to label vector of length n_rows
+ * @param alpha         host pointer to the n_alpha regularization strengths
+ * @param n_alpha       number of models
+ * @param coef          device pointer to the weights of the models, model i
+ *                      at coef + i * n_cols (size n_cols * n_alpha)
+ * @param intercept     host pointer to the bias terms of the models (size
+ *                      n_alpha)
+ * @param fit_intercept if true, fit intercept
+ * @param normalize     if true, normalize data to zero mean, unit variance
+ * @param algo          specifies which solver to use (0: SVD, 1:
+ *                      Eigendecomposition)
+ */
+template <typename math_t>
+void ridgeFitSweep(const cumlHandle_impl &handle, math_t *input, int n_rows,
+                   int n_cols, math_t *labels, const math_t *alpha,
+                   int n_alpha, math_t *coef, math_t *intercept,
+                   bool fit_intercept, bool normalize, cudaStream_t stream,
+                   int algo = 0) {
+  auto cublasH = handle.getCublasHandle();
+  auto cusolverH = handle.getcusolverDnHandle();
+  auto allocator = handle.getDeviceAllocator();
+
+  ASSERT(n_cols > 0,
+         "ridgeFitSweep: number of columns cannot be less than one");
+  ASSERT(n_rows > 1, "ridgeFitSweep: number of rows cannot be less than two");
+  ASSERT(n_alpha > 0, "ridgeFitSweep: need at least one alpha");
+  ASSERT(algo == 0 || algo == 1 || n_cols == 1,
+         "ridgeFitSweep: no algorithm with this id has been implemented");
+
+  device_buffer<math_t> mu_input(allocator, stream, fit_intercept ? n_cols : 0);
+  device_buffer<math_t> mu_labels(allocator, stream, fit_intercept ? 1 : 0);
+  device_buffer<math_t> norm2_input(allocator, stream,
+                                    fit_intercept && normalize ? n_cols : 0);
+  if (fit_intercept) {
+    preProcessData(handle, input, n_rows, n_cols, labels, intercept,
+                   mu_input.data(), mu_labels.data(), norm2_input.data(),
+                   fit_intercept, normalize, stream);
+  }
+
+  device_buffer<math_t> U(allocator, stream, n_rows * n_cols);
+  device_buffer<math_t> V(allocator, stream, n_cols * n_cols);
+  device_buffer<math_t> S(allocator, stream, n_cols);
+  if (algo == 0 || n_cols == 1) {
+    LinAlg::svdQR(input, n_rows, n_cols, S.data(), U.data(), V.data(), true,
+                  true, true, cusolverH, cublasH, allocator, stream);
+  } else {
+    LinAlg::svdEig(input, n_rows, n_cols, S.data(), U.data(), V.data(), true,
+                   cublasH, cusolverH, stream, allocator);
+  }
+  Matrix::setSmallValuesZero(S.data(), n_cols, stream, math_t(1e-10));
+
+  math_t alp = math_t(1);
+  math_t beta = math_t(0);
+  device_buffer<math_t> Utb(allocator, stream, n_cols);
+  LinAlg::gemm(U.data(), n_rows, n_cols, labels, Utb.data(), n_cols, 1,
+               CUBLAS_OP_T, CUBLAS_OP_N, alp, beta, cublasH, stream);
+
+  device_buffer<math_t> d_alpha(allocator, stream, n_alpha);
+  device_buffer<math_t> factors(allocator, stream, n_cols * n_alpha);
+  updateDevice(d_alpha.data(), alpha, n_alpha, stream);
+  int nblks = std::min(ceildiv(n_cols * n_alpha, 256), 1024);
+  ridgeSweepFactorsKernel<math_t><<<nblks, 256, 0, stream>>>(
+    factors.data(), S.data(), Utb.data(), d_alpha.data(), n_cols, n_alpha);
+  CUDA_CHECK(cudaPeekAtLastError());
+  LinAlg::gemm(V.data(), n_cols, n_cols, factors.data(), coef, n_cols, n_alpha,
+               CUBLAS_OP_N, CUBLAS_OP_N, alp, beta, cublasH, stream);
+
+  if (fit_intercept) {
+    if (normalize) {
+      Matrix::matrixVectorBinaryMult(input, norm2_input.data(), n_rows,
+                                     n_cols, false, true, stream);
+      // the models are the rows of a row major n_alpha x n_cols matrix
+      Matrix::matrixVectorBinaryDivSkipZero(coef, norm2_input.data(), n_alpha,
+                                            n_cols, true, true, stream, true);
+    }
+    // intercept_i = mu_labels - mu_input . coef_i, for all the models at once
+    device_buffer<math_t> d_intercept(allocator, stream, n_alpha);
+    LinAlg::gemm(coef, n_cols, n_alpha, mu_input.data(), d_intercept.data(),
+                 n_alpha, 1, CUBLAS_OP_T, CUBLAS_OP_N, alp, beta, cublasH,
+                 stream);
+    const math_t *mu_y = mu_labels.data();
+    LinAlg::unaryOp(
+      d_intercept.data(), d_intercept.data(), n_alpha,
+      [mu_y] __device__(math_t v) { return *mu_y - v; }, stream);
+    updateHost(intercept, d_intercept.data(), n_alpha, stream);
+
+    Stats::meanAdd(input, input, mu_input.data(), n_cols, n_rows, false, true,
+                   stream);
+    Stats::meanAdd(labels, labels, mu_labels.data(), 1, n_rows, false, true,
+                   stream);
+  } else {
+    std::fill(intercept, intercept + n_alpha, math_t(0));
+  }
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
+
 /**
  * @defgroup Functions to make predictions with a fitted ordinary least squares and ridge regression model
  * @param input         device pointer to feature matrix n_rows x n_cols
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gmm_impl.cuh"
+
+namespace ML {
+namespace gmm {
+
+// ----------------------------- fit ---------------------------------//
+
+void fit(const ML::cumlHandle &handle, const GMMParams &params, const float *X,
+         int n_samples, int n_features, float *weights, float *means,
+         float *covariances, float &lower_bound, int &n_iter) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  fit(h, params, X, n_samples, n_features, weights, means, covariances,
+      lower_bound, n_iter);
+}
+
+void fit(const ML::cumlHandle &handle, const GMMParams &params,
+         const double *X, int n_samples, int n_features, double *weights,
+         double *means, double *covariances, double &lower_bound,
+         int &n_iter) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  fit(h, params, X, n_samples, n_features, weights, means, covariances,
+      lower_bound, n_iter);
+}
+
+// ----------------------------- predict ---------------------------------//
+
+void predict(const ML::cumlHandle &handle, const GMMParams &params,
+             const float *weights, const float *means,
+             const float *covariances, const float *X, int n_samples,
+             int n_features, int *labels) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  predict(h, params, weights, means, covariances, X, n_samples, n_features,
+          labels);
+}
+
+void predict(const ML::cumlHandle &handle, const GMMParams &params,
+             const double *weights, const double *means,
+             const double *covariances, const double *X, int n_samples,
+             int n_features, int *labels) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  predict(h, params, weights, means, covariances, X, n_samples, n_features,
+          labels);
+}
+
+// -------------------------- predict_proba ------------------------------//
+
+void predict_proba(const ML::cumlHandle &handle, const GMMParams &params,
+                   const float *weights, const float *means,
+                   const float *covariances, const float *X, int n_samples,
+                   int n_features, float *probs) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  predict_proba(h, params, weights, means, covariances, X, n_samples,
+                n_features, probs);
+}
+
+void predict_proba(const ML::cumlHandle &handle, const GMMParams &params,
+                   const double *weights, const double *means,
+                   const double *covariances, const double *X, int n_samples,
+                   int n_features, double *probs) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  predict_proba(h, params, weights, means, covariances, X, n_samples,
+                n_features, probs);
+}
+
+// -------------------------- score_samples ------------------------------//
+
+void score_samples(const ML::cumlHandle &handle, const GMMParams &params,
+                   const float *weights, const float *means,
+                   const float *covariances, const float *X, int n_samples,
+                   int n_features, float *log_prob) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  score_samples(h, params, weights, means, covariances, X, n_samples,
+                n_features, log_prob);
+}
+
+void score_samples(const ML::cumlHandle &handle, const GMMParams &params,
+                   const double *weights, const double *means,
+                   const double *covariances, const double *X, int n_samples,
+                   int n_features, double *log_prob) {
+  const ML::cumlHandle_impl &h = handle.getImpl();
+  ML::detail::streamSyncer _(h);
+
+  score_samples(h, params, weights, means, covariances, X, n_samples,
+                n_features, log_prob);
+}
+
+};  // end namespace gmm
+};  // end namespace ML
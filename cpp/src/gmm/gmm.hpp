@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cuML.hpp>
+
+namespace ML {
+
+namespace gmm {
+
+struct GMMParams {
+  enum CovarianceType { Full, Diag, Spherical };
+
+  // The number of mixture components (default:1).
+  int n_components = 1;
+
+  /*
+   * Parametrization of the component covariances:
+   *  - CovarianceType::Full: each component has its own general covariance
+   * matrix, stored as n_components x n_features x n_features.
+   *  - CovarianceType::Diag: each component has its own diagonal covariance,
+   * stored as n_components x n_features.
+   *  - CovarianceType::Spherical: each component has its own single variance,
+   * stored as n_components values.
+   */
+  CovarianceType covariance_type = Full;
+
+  // Convergence threshold on the gain of the per-sample average
+  // log-likelihood between two EM iterations.
+  double tol = 1e-3;
+
+  // Non-negative regularization added to the diagonal of the covariances.
+  double reg_covar = 1e-6;
+
+  // Maximum number of EM iterations.
+  int max_iter = 100;
+
+  // Maximum number of iterations of the k-means run used for initialization.
+  int init_max_iter = 100;
+
+  // Seed to the random number generator of the k-means initialization.
+  int seed = 0;
+
+  // Number of samples processed at once in the E and M steps. The memory
+  // used by the full covariance E-step is n_components x batch_size x
+  // n_features, the batch size is reduced when this would get too large.
+  int batch_size = 1 << 15;
+
+  // verbosity mode.
+  int verbose = 0;
+};
+
+/**
+ * @brief Fit a Gaussian mixture model with the EM algorithm, initialized
+ * from a k-means clustering of the data.
+ *
+ * @param[in]  handle        The handle to the cuML library context that
+ * manages the CUDA resources.
+ * @param[in]  params        Parameters for the mixture model.
+ * @param[in]  X             Training instances (device pointer, row-major,
+ * n_samples x n_features).
+ * @param[in]  n_samples     Number of samples in the input X.
+ * @param[in]  n_features    Number of features of each sample.
+ * @param[out] weights       Mixture weights (device pointer, n_components).
+ * @param[out] means         Component means (device pointer, row-major,
+ * n_components x n_features).
+ * @param[out] covariances   Component covariances (device pointer), laid out
+ * according to params.covariance_type. Full covariance matrices are
+ * symmetric, so their storage order does not matter.
+ * @param[out] lower_bound   Per-sample average log-likelihood of the data
+ * at the last E-step.
+ * @param[out] n_iter        Number of EM iterations run.
+ */
+void fit(const ML::cumlHandle &handle, const GMMParams &params, const float *X,
+         int n_samples, int n_features, float *weights, float *means,
+         float *covariances, float &lower_bound, int &n_iter);
+
+void fit(const ML::cumlHandle &handle, const GMMParams &params,
+         const double *X, int n_samples, int n_features, double *weights,
+         double *means, double *covariances, double &lower_bound,
+         int &n_iter);
+
+/**
+ * @brief Predict the most likely component of each sample in X.
+ *
+ * @param[in]  handle        The handle to the cuML library context that
+ * manages the CUDA resources.
+ * @param[in]  params        Parameters for the mixture model.
+ * @param[in]  weights       Mixture weights, as returned by fit.
+ * @param[in]  means         Component means, as returned by fit.
+ * @param[in]  covariances   Component covariances, as returned by fit.
+ * @param[in]  X             New data (device pointer, row-major).
+ * @param[in]  n_samples     Number of samples in the input X.
+ * @param[in]  n_features    Number of features of each sample.
+ * @param[out] labels        Index of the component of each sample.
+ */
+void predict(const ML::cumlHandle &handle, const GMMParams &params,
+             const float *weights, const float *means,
+             const float *covariances, const float *X, int n_samples,
+             int n_features, int *labels);
+
+void predict(const ML::cumlHandle &handle, const GMMParams &params,
+             const double *weights, const double *means,
+             const double *covariances, const double *X, int n_samples,
+             int n_features, int *labels);
+
+/**
+ * @brief Posterior probability of each component given each sample.
+ *
+ * Parameters are the same as for predict, the output probs is a row-major
+ * n_samples x n_components matrix (device pointer).
+ */
+void predict_proba(const ML::cumlHandle &handle, const GMMParams &params,
+                   const float *weights, const float *means,
+                   const float *covariances, const float *X, int n_samples,
+                   int n_features, float *probs);
+
+void predict_proba(const ML::cumlHandle &handle, const GMMParams &params,
+                   const double *weights, const double *means,
+                   const double *covariances, const double *X, int n_samples,
+                   int n_features, double *probs);
+
+/**
+ * @brief Log-likelihood of each sample under the mixture model.
+ *
+ * Parameters are the same as for predict, the output log_prob holds
+ * n_samples values (device pointer).
+ */
+void score_samples(const ML::cumlHandle &handle, const GMMParams &params,
+                   const float *weights, const float *means,
+                   const float *covariances, const float *X, int n_samples,
+                   int n_features, float *log_prob);
+
+void score_samples(const ML::cumlHandle &handle, const GMMParams &params,
+                   const double *weights, const double *means,
+                   const double *covariances, const double *X, int n_samples,
+                   int n_features, double *log_prob);
+
+};  // end namespace gmm
+};  // end namespace ML
@@ -0,0 +1,638 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <common/cumlHandle.hpp>
+#include <common/device_buffer.hpp>
+#include <cuda_utils.h>
+#include <linalg/batched_dense.h>
+#include <linalg/cublas_wrappers.h>
+#include <linalg/cusolver_wrappers.h>
+#include <linalg/eltwise.h>
+#include <stats/mean.h>
+#include <stats/mean_center.h>
+#include <thrust/device_ptr.h>
+#include <thrust/execution_policy.h>
+#include <thrust/fill.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "../kmeans/sg_impl.cuh"
+#include "gmm.hpp"
+
+namespace ML {
+namespace gmm {
+namespace detail {
+
+using namespace MLCommon;
+
+static const int GMM_TPB = 256;
+// Upper bound on the elements of the per-component projections of a batch
+static const size_t GMM_PROJ_ELEMS = size_t(1) << 25;
+
+inline bool isFull(const GMMParams &params) {
+  return params.covariance_type == GMMParams::Full;
+}
+
+inline size_t covarianceSize(const GMMParams &params, int n_features) {
+  size_t k = params.n_components, d = n_features;
+  switch (params.covariance_type) {
+    case GMMParams::Full:
+      return k * d * d;
+    case GMMParams::Diag:
+      return k * d;
+    default:
+      return k;
+  }
+}
+
+/**
+ * Number of rows processed per batch. The full covariance E-step projects
+ * each row of the batch with every component, so the batch is shrunk to
+ * keep that buffer bounded.
+ */
+inline int batchRows(const GMMParams &params, int n_samples, int n_features) {
+  size_t nb = std::min(params.batch_size, n_samples);
+  if (isFull(params)) {
+    size_t per_row = size_t(params.n_components) * n_features;
+    nb = std::min(nb, std::max(GMM_PROJ_ELEMS / per_row, size_t(1)));
+  }
+  return int(nb);
+}
+
+/**
+ * Precision factors of the components. For full covariances these are the
+ * inverses of the lower Cholesky factors, Z = L^{-1} (so that C^{-1} = Z^T Z)
+ * together with Z * mean; for diagonal and spherical covariances these are
+ * the inverse variances. half_log_det holds 0.5 * log|C| per component.
+ */
+template <typename DataT>
+struct GMMFactors {
+  GMMFactors(std::shared_ptr<deviceAllocator> allocator,
+             const GMMParams &params, int n_features, cudaStream_t stream)
+    : precisions(allocator, stream, covarianceSize(params, n_features)),
+      prec_means(allocator, stream,
+                 isFull(params) ? params.n_components * n_features : 0),
+      half_log_det(allocator, stream, params.n_components) {}
+
+  device_buffer<DataT> precisions;
+  device_buffer<DataT> prec_means;
+  device_buffer<DataT> half_log_det;
+};
+
+template <typename DataT>
+__global__ void gmmLowerInverseKernel(DataT *Z, const DataT *L,
+                                      DataT *half_log_det, int d) {
+  const DataT *Lc = L + (size_t)blockIdx.x * d * d;
+  DataT *Zc = Z + (size_t)blockIdx.x * d * d;
+  // forward substitution, one column of the identity per thread
+  for (int j = threadIdx.x; j < d; j += blockDim.x) {
+    for (int i = 0; i < j; i++) Zc[i + j * d] = DataT(0);
+    for (int i = j; i < d; i++) {
+      DataT acc = i == j ? DataT(1) : DataT(0);
+      for (int l = j; l < i; l++) acc -= Lc[i + l * d] * Zc[l + j * d];
+      Zc[i + j * d] = acc / Lc[i + i * d];
+    }
+  }
+  if (threadIdx.x == 0) {
+    DataT s = DataT(0);
+    for (int i = 0; i < d; i++) s += myLog(Lc[i + i * d]);
+    half_log_det[blockIdx.x] = s;
+  }
+}
+
+template <typename DataT>
+__global__ void gmmDiagPrecisionKernel(DataT *precisions, DataT *half_log_det,
+                                       const DataT *cov, int k, int d,
+                                       bool spherical) {
+  int c = threadIdx.x + blockIdx.x * blockDim.x;
+  if (c >= k) return;
+  if (spherical) {
+    precisions[c] = DataT(1) / cov[c];
+    half_log_det[c] = DataT(0.5) * d * myLog(cov[c]);
+    return;
+  }
+  DataT s = DataT(0);
+  for (int j = 0; j < d; j++) {
+    DataT v = cov[(size_t)c * d + j];
+    precisions[(size_t)c * d + j] = DataT(1) / v;
+    s += myLog(v);
+  }
+  half_log_det[c] = DataT(0.5) * s;
+}
+
+/**
+ * log(w_c) + log N(x_i | mean_c, C_c) for full covariances, from the
+ * projections Y_c = Z_c * x_i^T of the batch (Mahalanobis distance is
+ * ||Y_c - Z_c * mean_c||^2)
+ */
+template <typename DataT>
+__global__ void gmmFullLogProbKernel(DataT *lp, const DataT *proj,
+                                     const DataT *prec_means,
+                                     const DataT *weights,
+                                     const DataT *half_log_det, int nb, int d,
+                                     int k) {
+  size_t idx = threadIdx.x + (size_t)blockIdx.x * blockDim.x;
+  if (idx >= (size_t)nb * k) return;
+  int i = idx / k, c = idx % k;
+  const DataT *y = proj + ((size_t)c * nb + i) * d;
+  const DataT *zm = prec_means + (size_t)c * d;
+  DataT s = DataT(0);
+  for (int j = 0; j < d; j++) {
+    DataT diff = y[j] - zm[j];
+    s += diff * diff;
+  }
+  const DataT log_2pi = DataT(1.8378770664093453);
+  lp[idx] = myLog(weights[c]) - DataT(0.5) * (d * log_2pi + s) -
+            half_log_det[c];
+}
+
+template <typename DataT>
+__global__ void gmmDiagLogProbKernel(DataT *lp, const DataT *X,
+                                     const DataT *means,
+                                     const DataT *precisions,
+                                     const DataT *weights,
+                                     const DataT *half_log_det, int nb, int d,
+                                     int k, bool spherical) {
+  size_t idx = threadIdx.x + (size_t)blockIdx.x * blockDim.x;
+  if (idx >= (size_t)nb * k) return;
+  int i = idx / k, c = idx % k;
+  const DataT *x = X + (size_t)i * d;
+  const DataT *mu = means + (size_t)c * d;
+  DataT s = DataT(0);
+  for (int j = 0; j < d; j++) {
+    DataT diff = x[j] - mu[j];
+    s += diff * diff * (spherical ? precisions[c] : precisions[c * d + j]);
+  }
+  const DataT log_2pi = DataT(1.8378770664093453);
+  lp[idx] = myLog(weights[c]) - DataT(0.5) * (d * log_2pi + s) -
+            half_log_det[c];
+}
+
+/**
+ * One warp per row of the nb x k weighted log-probabilities: computes the
+ * row log-sum-exp, optionally turns the row into responsibilities in place
+ * and adds the log-sum-exp to the log-likelihood accumulator.
+ */
+template <typename DataT>
+__global__ void gmmResponsibilityKernel(DataT *lp, DataT *row_lse,
+                                        double *ll_sum, int nb, int k,
+                                        bool normalize) {
+  int lane = threadIdx.x % WarpSize;
+  int row = (threadIdx.x + blockIdx.x * blockDim.x) / WarpSize;
+  if (row >= nb) return;
+  DataT *r = lp + (size_t)row * k;
+  DataT m = r[0];
+  for (int c = lane; c < k; c += WarpSize) m = r[c] > m ? r[c] : m;
+  for (int off = WarpSize / 2; off > 0; off /= 2) {
+    DataT o = shfl_xor(m, off);
+    m = o > m ? o : m;
+  }
+  DataT s = DataT(0);
+  for (int c = lane; c < k; c += WarpSize) s += myExp(r[c] - m);
+  for (int off = WarpSize / 2; off > 0; off /= 2) s += shfl_xor(s, off);
+  DataT lse = m + myLog(s);
+  if (normalize) {
+    for (int c = lane; c < k; c += WarpSize) r[c] = myExp(r[c] - lse);
+  }
+  if (lane == 0) {
+    if (row_lse != nullptr) row_lse[row] = lse;
+    if (ll_sum != nullptr) myAtomicAdd(ll_sum, double(lse));
+  }
+}
+
+template <typename DataT>
+__global__ void gmmArgmaxKernel(int *labels, const DataT *lp, int nb, int k) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  if (i >= nb) return;
+  const DataT *r = lp + (size_t)i * k;
+  int best = 0;
+  for (int c = 1; c < k; c++) best = r[c] > r[best] ? c : best;
+  labels[i] = best;
+}
+
+template <typename DataT>
+__global__ void gmmOneHotKernel(DataT *resp, const int *labels, int nb,
+                                int k) {
+  size_t idx = threadIdx.x + (size_t)blockIdx.x * blockDim.x;
+  if (idx >= (size_t)nb * k) return;
+  resp[idx] = labels[idx / k] == int(idx % k) ? DataT(1) : DataT(0);
+}
+
+// proj_c[i, :] = resp[i, c] * X[i, :] for every component c
+template <typename DataT>
+__global__ void gmmScaleRowsKernel(DataT *proj, const DataT *X,
+                                   const DataT *resp, int nb, int d, int k) {
+  size_t idx = threadIdx.x + (size_t)blockIdx.x * blockDim.x;
+  size_t len = (size_t)nb * d;
+  if (idx >= len * k) return;
+  int c = idx / len;
+  size_t r = idx % len;
+  proj[idx] = X[r] * resp[(r / d) * k + c];
+}
+
+template <typename DataT>
+__global__ void gmmMeansKernel(DataT *weights, DataT *means, const DataT *nk,
+                               const DataT *s1, int k, int d, int n,
+                               DataT eps) {
+  int idx = threadIdx.x + blockIdx.x * blockDim.x;
+  if (idx >= k * d) return;
+  int c = idx / d;
+  DataT nc = nk[c] + eps;
+  means[idx] = s1[idx] / nc;
+  if (idx % d == 0) weights[c] = nc / n;
+}
+
+template <typename DataT>
+__global__ void gmmFullCovKernel(DataT *cov, const DataT *s2,
+                                 const DataT *means, const DataT *nk, int k,
+                                 int d, DataT reg, DataT eps) {
+  size_t idx = threadIdx.x + (size_t)blockIdx.x * blockDim.x;
+  if (idx >= (size_t)k * d * d) return;
+  int c = idx / (d * d);
+  int r = idx % (d * d);
+  int i = r % d, j = r / d;
+  const DataT *mu = means + (size_t)c * d;
+  DataT v = s2[idx] / (nk[c] + eps) - mu[i] * mu[j];
+  cov[idx] = i == j ? v + reg : v;
+}
+
+template <typename DataT>
+__global__ void gmmDiagCovKernel(DataT *cov, const DataT *s2,
+                                 const DataT *means, const DataT *nk, int k,
+                                 int d, DataT reg, DataT eps, bool spherical) {
+  int c = threadIdx.x + blockIdx.x * blockDim.x;
+  if (c >= k) return;
+  DataT nc = nk[c] + eps, s = DataT(0);
+  for (int j = 0; j < d; j++) {
+    DataT mu = means[(size_t)c * d + j];
+    DataT v = s2[(size_t)c * d + j] / nc - mu * mu;
+    v = v > DataT(0) ? v : DataT(0);
+    if (spherical)
+      s += v;
+    else
+      cov[(size_t)c * d + j] = v + reg;
+  }
+  if (spherical) cov[c] = s / d + reg;
+}
+
+/**
+ * @brief Cholesky factorize the covariances and compute the precision
+ * factors. The factorization of all the components is a single batched
+ * kernel for n_features <= BATCHED_MAX_DIM, else a loop of cuSOLVER calls.
+ */
+template <typename DataT>
+void computeFactors(const ML::cumlHandle_impl &handle, const GMMParams &params,
+                    const DataT *means, const DataT *covariances,
+                    int n_features, GMMFactors<DataT> &factors,
+                    cudaStream_t stream) {
+  int k = params.n_components, d = n_features;
+  if (!isFull(params)) {
+    bool spherical = params.covariance_type == GMMParams::Spherical;
+    gmmDiagPrecisionKernel<<<ceildiv(k, GMM_TPB), GMM_TPB, 0, stream>>>(
+      factors.precisions.data(), factors.half_log_det.data(), covariances, k,
+      d, spherical);
+    CUDA_CHECK(cudaGetLastError());
+    return;
+  }
+
+  auto allocator = handle.getDeviceAllocator();
+  device_buffer<DataT> chol(allocator, stream, (size_t)k * d * d);
+  device_buffer<int> info(allocator, stream, k);
+  copy(chol.data(), covariances, (size_t)k * d * d, stream);
+  if (d <= LinAlg::BATCHED_MAX_DIM) {
+    LinAlg::batchedCholesky(chol.data(), d, k, info.data(), stream);
+  } else {
+    cusolverDnHandle_t cusolverH = handle.getcusolverDnHandle();
+    int lwork;
+    CUSOLVER_CHECK(LinAlg::cusolverDnpotrf_bufferSize(
+      cusolverH, CUBLAS_FILL_MODE_LOWER, d, chol.data(), d, &lwork));
+    device_buffer<DataT> work(allocator, stream, lwork);
+    for (int c = 0; c < k; c++) {
+      CUSOLVER_CHECK(LinAlg::cusolverDnpotrf(
+        cusolverH, CUBLAS_FILL_MODE_LOWER, d, chol.data() + (size_t)c * d * d,
+        d, work.data(), lwork, info.data() + c, stream));
+    }
+  }
+  std::vector<int> info_h(k);
+  updateHost(info_h.data(), info.data(), k, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  for (int c = 0; c < k; c++) {
+    ASSERT(info_h[c] == 0,
+           "GMM: the covariance of component %d is not positive definite, "
+           "try increasing reg_covar",
+           c);
+  }
+
+  gmmLowerInverseKernel<<<k, std::min(d, GMM_TPB), 0, stream>>>(
+    factors.precisions.data(), chol.data(), factors.half_log_det.data(), d);
+  CUDA_CHECK(cudaGetLastError());
+
+  // Z_c * mean_c for all the components at once
+  DataT one = 1, zero = 0;
+  CUBLAS_CHECK(LinAlg::cublasgemmStridedBatched(
+    handle.getCublasHandle(), CUBLAS_OP_N, CUBLAS_OP_N, d, 1, d, &one,
+    factors.precisions.data(), d, (long long)d * d, means, d, d, &zero,
+    factors.prec_means.data(), d, d, k, stream));
+}
+
+/**
+ * @brief Weighted log-probabilities log(w_c) + log N(x_i | mean_c, C_c) of
+ * a batch of rows (nb x n_components, row-major). For full covariances the
+ * rows are projected by all the precision factors with one strided batched
+ * GEMM into proj (n_components x nb x n_features).
+ */
+template <typename DataT>
+void estimateLogProb(const ML::cumlHandle_impl &handle,
+                     const GMMParams &params, const DataT *weights,
+                     const DataT *means, const GMMFactors<DataT> &factors,
+                     const DataT *X, int nb, int n_features, DataT *lp,
+                     DataT *proj, cudaStream_t stream) {
+  int k = params.n_components, d = n_features;
+  int n_blks = ceildiv<size_t>((size_t)nb * k, GMM_TPB);
+  if (isFull(params)) {
+    DataT one = 1, zero = 0;
+    CUBLAS_CHECK(LinAlg::cublasgemmStridedBatched(
+      handle.getCublasHandle(), CUBLAS_OP_N, CUBLAS_OP_N, d, nb, d, &one,
+      factors.precisions.data(), d, (long long)d * d, X, d, 0, &zero, proj, d,
+      (long long)d * nb, k, stream));
+    gmmFullLogProbKernel<<<n_blks, GMM_TPB, 0, stream>>>(
+      lp, proj, factors.prec_means.data(), weights,
+      factors.half_log_det.data(), nb, d, k);
+  } else {
+    bool spherical = params.covariance_type == GMMParams::Spherical;
+    gmmDiagLogProbKernel<<<n_blks, GMM_TPB, 0, stream>>>(
+      lp, X, means, factors.precisions.data(), weights,
+      factors.half_log_det.data(), nb, d, k, spherical);
+  }
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename DataT>
+void responsibilities(DataT *lp, DataT *row_lse, double *ll_sum, int nb, int k,
+                      bool normalize, cudaStream_t stream) {
+  int n_blks = ceildiv<size_t>((size_t)nb * WarpSize, GMM_TPB);
+  gmmResponsibilityKernel<<<n_blks, GMM_TPB, 0, stream>>>(lp, row_lse, ll_sum,
+                                                          nb, k, normalize);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+/**
+ * @brief Accumulate the sufficient statistics of a batch: nk += resp^T 1,
+ * s1 += resp^T X and the second moments s2 (per component X^T diag(r_c) X
+ * for full covariances, resp^T (X o X) otherwise).
+ */
+template <typename DataT>
+void accumulateStats(const ML::cumlHandle_impl &handle,
+                     const GMMParams &params, const DataT *X,
+                     const DataT *resp, int nb, int n_features,
+                     const DataT *ones, DataT *proj, DataT *nk, DataT *s1,
+                     DataT *s2, cudaStream_t stream) {
+  int k = params.n_components, d = n_features;
+  cublasHandle_t cublasH = handle.getCublasHandle();
+  DataT one = 1;
+  CUBLAS_CHECK(LinAlg::cublasgemv(cublasH, CUBLAS_OP_N, k, nb, &one, resp, k,
+                                  ones, 1, &one, nk, 1, stream));
+  CUBLAS_CHECK(LinAlg::cublasgemm(cublasH, CUBLAS_OP_N, CUBLAS_OP_T, d, k, nb,
+                                  &one, X, d, resp, k, &one, s1, d, stream));
+  if (isFull(params)) {
+    size_t len = (size_t)nb * d * k;
+    gmmScaleRowsKernel<<<ceildiv<size_t>(len, GMM_TPB), GMM_TPB, 0, stream>>>(
+      proj, X, resp, nb, d, k);
+    CUDA_CHECK(cudaGetLastError());
+    CUBLAS_CHECK(LinAlg::cublasgemmStridedBatched(
+      cublasH, CUBLAS_OP_N, CUBLAS_OP_T, d, d, nb, &one, X, d, 0, proj, d,
+      (long long)d * nb, &one, s2, d, (long long)d * d, k, stream));
+  } else {
+    LinAlg::eltwiseMultiply(proj, X, X, nb * d, stream);
+    CUBLAS_CHECK(LinAlg::cublasgemm(cublasH, CUBLAS_OP_N, CUBLAS_OP_T, d, k,
+                                    nb, &one, proj, d, resp, k, &one, s2, d,
+                                    stream));
+  }
+}
+
+template <typename DataT>
+void mStep(const GMMParams &params, const DataT *nk, const DataT *s1,
+           const DataT *s2, int n_samples, int n_features, DataT *weights,
+           DataT *means, DataT *covariances, cudaStream_t stream) {
+  int k = params.n_components, d = n_features;
+  // keeps empty components finite, as the reference implementation
+  DataT eps = 10 * std::numeric_limits<DataT>::epsilon();
+  DataT reg = DataT(params.reg_covar);
+  gmmMeansKernel<<<ceildiv(k * d, GMM_TPB), GMM_TPB, 0, stream>>>(
+    weights, means, nk, s1, k, d, n_samples, eps);
+  if (isFull(params)) {
+    size_t len = (size_t)k * d * d;
+    gmmFullCovKernel<<<ceildiv<size_t>(len, GMM_TPB), GMM_TPB, 0, stream>>>(
+      covariances, s2, means, nk, k, d, reg, eps);
+  } else {
+    bool spherical = params.covariance_type == GMMParams::Spherical;
+    gmmDiagCovKernel<<<ceildiv(k, GMM_TPB), GMM_TPB, 0, stream>>>(
+      covariances, s2, means, nk, k, d, reg, eps, spherical);
+  }
+  CUDA_CHECK(cudaGetLastError());
+}
+
+/**
+ * @brief Batched evaluation of a fitted model; any of labels, probs and
+ * log_prob may be null.
+ */
+template <typename DataT>
+void estimate(const ML::cumlHandle_impl &handle, const GMMParams &params,
+              const DataT *weights, const DataT *means,
+              const DataT *covariances, const DataT *X, int n_samples,
+              int n_features, int *labels, DataT *probs, DataT *log_prob) {
+  cudaStream_t stream = handle.getStream();
+  auto allocator = handle.getDeviceAllocator();
+  int k = params.n_components, d = n_features;
+  ASSERT(k > 0, "GMM: n_components must be > 0");
+  ASSERT(n_samples > 0 && n_features > 0, "GMM: empty input");
+
+  GMMFactors<DataT> factors(allocator, params, d, stream);
+  computeFactors(handle, params, means, covariances, d, factors, stream);
+
+  int nb = batchRows(params, n_samples, d);
+  device_buffer<DataT> lp(allocator, stream, (size_t)nb * k);
+  device_buffer<DataT> proj(allocator, stream,
+                            isFull(params) ? (size_t)nb * d * k : 0);
+  for (int off = 0; off < n_samples; off += nb) {
+    int cur = std::min(nb, n_samples - off);
+    DataT *lp_b = probs != nullptr ? probs + (size_t)off * k : lp.data();
+    estimateLogProb(handle, params, weights, means, factors,
+                    X + (size_t)off * d, cur, d, lp_b, proj.data(), stream);
+    if (labels != nullptr) {
+      gmmArgmaxKernel<<<ceildiv(cur, GMM_TPB), GMM_TPB, 0, stream>>>(
+        labels + off, lp_b, cur, k);
+      CUDA_CHECK(cudaGetLastError());
+    }
+    if (probs != nullptr || log_prob != nullptr) {
+      DataT *lse_b = log_prob != nullptr ? log_prob + off : nullptr;
+      responsibilities(lp_b, lse_b, (double *)nullptr, cur, k,
+                       probs != nullptr, stream);
+    }
+  }
+}
+
+};  // end namespace detail
+
+/**
+ * @brief EM fit of a Gaussian mixture. Each iteration is a single streaming
+ * pass over the data in row batches: the E-step of a batch (log-probabilities
+ * and responsibilities) is immediately followed by the accumulation of its
+ * sufficient statistics, so only the statistics of the M-step live across
+ * batches. The data is shifted by its mean before accumulating the second
+ * moments to limit cancellation in C = E[x x^T] - mean mean^T.
+ */
+template <typename DataT>
+void fit(const ML::cumlHandle_impl &handle, const GMMParams &params,
+         const DataT *X, int n_samples, int n_features, DataT *weights,
+         DataT *means, DataT *covariances, DataT &lower_bound, int &n_iter) {
+  using namespace MLCommon;
+  cudaStream_t stream = handle.getStream();
+  auto allocator = handle.getDeviceAllocator();
+  int k = params.n_components, d = n_features;
+
+  ASSERT(k > 0, "GMM: n_components must be > 0");
+  ASSERT(n_samples >= k, "GMM: n_samples=%d should be >= n_components=%d",
+         n_samples, k);
+  ASSERT(n_features > 0, "GMM: n_features must be > 0");
+  ASSERT(params.reg_covar >= 0, "GMM: reg_covar must be non-negative");
+  ASSERT(params.max_iter > 0, "GMM: max_iter must be > 0");
+  ASSERT(memory_type(X) == cudaMemoryTypeDevice,
+         "input data must be device accessible");
+
+  // initial responsibilities from a k-means clustering
+  kmeans::KMeansParams km_params;
+  km_params.n_clusters = k;
+  km_params.max_iter = params.init_max_iter;
+  km_params.seed = params.seed;
+  km_params.verbose = params.verbose;
+  device_buffer<DataT> centroids(allocator, stream, (size_t)k * d);
+  device_buffer<int> labels(allocator, stream, n_samples);
+  DataT inertia;
+  int km_iter;
+  kmeans::fit(handle, km_params, X, n_samples, d, centroids.data(), inertia,
+              km_iter);
+  kmeans::predict(handle, km_params, centroids.data(), X, n_samples, d,
+                  labels.data(), inertia);
+  centroids.release(stream);
+
+  int nb = detail::batchRows(params, n_samples, d);
+  size_t cov_len = detail::covarianceSize(params, d);
+  device_buffer<DataT> shift(allocator, stream, d);
+  device_buffer<DataT> xs(allocator, stream, (size_t)nb * d);
+  device_buffer<DataT> resp(allocator, stream, (size_t)nb * k);
+  device_buffer<DataT> proj(
+    allocator, stream, detail::isFull(params) ? (size_t)nb * d * k : nb * d);
+  device_buffer<DataT> ones(allocator, stream, nb);
+  device_buffer<DataT> nk(allocator, stream, k);
+  device_buffer<DataT> s1(allocator, stream, (size_t)k * d);
+  device_buffer<DataT> s2(allocator, stream,
+                          detail::isFull(params) ? cov_len : (size_t)k * d);
+  device_buffer<double> ll_sum(allocator, stream, 1);
+  detail::GMMFactors<DataT> factors(allocator, params, d, stream);
+
+  thrust::fill(thrust::cuda::par.on(stream),
+               thrust::device_pointer_cast(ones.data()),
+               thrust::device_pointer_cast(ones.data() + nb), DataT(1));
+  Stats::mean(shift.data(), X, d, n_samples, false, true, stream);
+
+  double lb = 0.0;
+  n_iter = 0;
+  for (int iter = 0; iter <= params.max_iter; iter++) {
+    bool init = iter == 0;
+    CUDA_CHECK(cudaMemsetAsync(nk.data(), 0, nk.size() * sizeof(DataT),
+                               stream));
+    CUDA_CHECK(cudaMemsetAsync(s1.data(), 0, s1.size() * sizeof(DataT),
+                               stream));
+    CUDA_CHECK(cudaMemsetAsync(s2.data(), 0, s2.size() * sizeof(DataT),
+                               stream));
+    CUDA_CHECK(cudaMemsetAsync(ll_sum.data(), 0, sizeof(double), stream));
+
+    for (int off = 0; off < n_samples; off += nb) {
+      int cur = std::min(nb, n_samples - off);
+      Stats::meanCenter(xs.data(), X + (size_t)off * d, shift.data(), d, cur,
+                        true, true, stream);
+      if (init) {
+        int n_blks = ceildiv<size_t>((size_t)cur * k, detail::GMM_TPB);
+        detail::gmmOneHotKernel<<<n_blks, detail::GMM_TPB, 0, stream>>>(
+          resp.data(), labels.data() + off, cur, k);
+        CUDA_CHECK(cudaGetLastError());
+      } else {
+        detail::estimateLogProb(handle, params, weights, means, factors,
+                                xs.data(), cur, d, resp.data(), proj.data(),
+                                stream);
+        detail::responsibilities(resp.data(), (DataT *)nullptr, ll_sum.data(),
+                                 cur, k, true, stream);
+      }
+      detail::accumulateStats(handle, params, xs.data(), resp.data(), cur, d,
+                              ones.data(), proj.data(), nk.data(), s1.data(),
+                              s2.data(), stream);
+    }
+
+    detail::mStep(params, nk.data(), s1.data(), s2.data(), n_samples, d,
+                  weights, means, covariances, stream);
+    detail::computeFactors(handle, params, means, covariances, d, factors,
+                           stream);
+
+    if (!init) {
+      double ll;
+      updateHost(&ll, ll_sum.data(), 1, stream);
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      double prev = lb;
+      lb = ll / n_samples;
+      n_iter = iter;
+      LOG(params.verbose, "GMM.fit: iteration %d, lower bound %f\n", iter, lb);
+      if (iter > 1 && std::abs(lb - prev) < params.tol) break;
+    }
+  }
+  lower_bound = DataT(lb);
+
+  // back to the original coordinates
+  Stats::meanAdd(means, means, shift.data(), d, k, true, true, stream);
+}
+
+template <typename DataT>
+void predict(const ML::cumlHandle_impl &handle, const GMMParams &params,
+             const DataT *weights, const DataT *means,
+             const DataT *covariances, const DataT *X, int n_samples,
+             int n_features, int *labels) {
+  detail::estimate(handle, params, weights, means, covariances, X, n_samples,
+                   n_features, labels, (DataT *)nullptr, (DataT *)nullptr);
+}
+
+template <typename DataT>
+void predict_proba(const ML::cumlHandle_impl &handle, const GMMParams &params,
+                   const DataT *weights, const DataT *means,
+                   const DataT *covariances, const DataT *X, int n_samples,
+                   int n_features, DataT *probs) {
+  detail::estimate(handle, params, weights, means, covariances, X, n_samples,
+                   n_features, (int *)nullptr, probs, (DataT *)nullptr);
+}
+
+template <typename DataT>
+void score_samples(const ML::cumlHandle_impl &handle, const GMMParams &params,
+                   const DataT *weights, const DataT *means,
+                   const DataT *covariances, const DataT *X, int n_samples,
+                   int n_features, DataT *log_prob) {
+  detail::estimate(handle, params, weights, means, covariances, X, n_samples,
+                   n_features, (int *)nullptr, (DataT *)nullptr, log_prob);
+}
+
+};  // end namespace gmm
+};  // end namespace ML
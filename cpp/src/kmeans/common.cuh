@@ -24,6 +24,7 @@
 #include <matrix/gather.h>
 #include <random/permute.h>
 #include <random/rng.h>
+#include <random/weighted_sampler.h>
 #include <random>
 
 #include <ml_cuda_utils.h>
@@ -429,10 +430,9 @@ void kmeansPlusPlus(const cumlHandle_impl &handle, const KMeansParams &params,
       execution_policy, weights.begin(), weights.end(), prob.begin(),
       [] __device__(int weight) { return static_cast<DataT>(weight); });
 
-  MLCommon::host_buffer<DataT> h_prob(handle.getHostAllocator(), stream);
-  h_prob.resize(n_pot_centroids, stream);
-
-  std::mt19937 gen(params.seed);
+  MLCommon::Random::WeightedSampler<DataT, int> sampler(
+      handle.getDeviceAllocator(), stream, params.seed);
+  MLCommon::device_buffer<int> d_cIdx(handle.getDeviceAllocator(), stream, 1);
 
   // reset buffer to store the chosen centroid
   centroidsRawData.resize(n_clusters * n_features, stream);
@@ -453,13 +453,14 @@ void kmeansPlusPlus(const cumlHandle_impl &handle, const KMeansParams &params,
   for (int iter = 0; iter < n_clusters; iter++) {
     LOG(params.verbose, "KMeans++ - Iteraton %d/%d\n", iter, n_clusters);
 
-    MLCommon::copy(h_prob.data(), prob.data(), prob.numElements(), stream);
+    // draw the next centroid on device, only its index comes back to host
+    sampler.build(prob.data(), 1, n_pot_centroids, stream);
+    sampler.sample(d_cIdx.data(), 1, stream);
+    int cIdx;
+    MLCommon::copy(&cIdx, d_cIdx.data(), 1, stream);
     CUDA_CHECK(cudaStreamSynchronize(stream));
-
-    std::discrete_distribution<> d(h_prob.begin(), h_prob.end());
-    // d(gen) returns random # between [0...n_pot_centroids], mod is  unncessary
-    // but just placing it to avoid untested behaviors
-    int cIdx = d(gen) % n_pot_centroids;
+    // all the weights are zero (e.g. duplicated points), pick the first one
+    if (cIdx < 0) cIdx = 0;
 
     LOG(params.verbose,
         "Chosing centroid-%d randomly from %d potential centroids\n", cIdx,
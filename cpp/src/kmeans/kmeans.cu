@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "common/batchFit.hpp"
 #include "sg_impl.cuh"
 
 namespace ML {
@@ -60,11 +61,57 @@ void fit(const ML::cumlHandle &handle, const KMeansParams &params,
   fit(h, params, X, n_samples, n_features, centroids, inertia, n_iter);
 }
 
+// ----------------------------- fitSweep ----------------------------//
+
+template <typename DataT>
+void fitSweepImpl(const ML::cumlHandle &handle, const KMeansParams *params,
+                  int n_models, const DataT *X, int n_samples, int n_features,
+                  DataT **centroids, DataT *inertia, int *n_iter,
+                  int max_concurrent, size_t memory_budget) {
+  // dominant device allocations of a fit: the nearest centroid and distance
+  // of every sample, the distances of a batch of samples to the centroids
+  // and the candidate centroids of the initialization
+  auto model_bytes = [=](int i) -> size_t {
+    size_t k = params[i].n_clusters;
+    size_t batch = std::min(params[i].batch_size, n_samples);
+    size_t candidates = k * std::max(params[i].oversampling_factor, 1);
+    return n_samples * (sizeof(cub::KeyValuePair<int, DataT>) + sizeof(int)) +
+           batch * k * sizeof(DataT) +
+           (candidates + 2 * k) * n_features * sizeof(DataT);
+  };
+  ML::batchFit(handle, n_models,
+               [&](const ML::cumlHandle &h, int i) {
+                 fit(h, params[i], X, n_samples, n_features, centroids[i],
+                     inertia[i], n_iter[i]);
+               },
+               max_concurrent, memory_budget, model_bytes);
+}
+
+void fitSweep(const ML::cumlHandle &handle, const KMeansParams *params,
+              int n_models, const float *X, int n_samples, int n_features,
+              float **centroids, float *inertia, int *n_iter,
+              int max_concurrent, size_t memory_budget) {
+  fitSweepImpl(handle, params, n_models, X, n_samples, n_features, centroids,
+               inertia, n_iter, max_concurrent, memory_budget);
+}
+
+void fitSweep(const ML::cumlHandle &handle, const KMeansParams *params,
+              int n_models, const double *X, int n_samples, int n_features,
+              double **centroids, double *inertia, int *n_iter,
+              int max_concurrent, size_t memory_budget) {
+  fitSweepImpl(handle, params, n_models, X, n_samples, n_features, centroids,
+               inertia, n_iter, max_concurrent, memory_budget);
+}
+
 // ----------------------------- predict ---------------------------------//
 
 void predict(const ML::cumlHandle &handle, const KMeansParams &params,
              const float *centroids, const float *X, int n_samples,
              int n_features, int *labels, float &inertia) {
+  if (params.backend == KMeansParams::Host) {
+    predict(params, centroids, X, n_samples, n_features, labels, inertia);
+    return;
+  }
   const ML::cumlHandle_impl &h = handle.getImpl();
   ML::detail::streamSyncer _(h);
 
@@ -74,6 +121,10 @@ void predict(const ML::cumlHandle &handle, const KMeansParams &params,
 void predict(const ML::cumlHandle &handle, const KMeansParams &params,
              const double *centroids, const double *X, int n_samples,
              int n_features, int *labels, double &inertia) {
+  if (params.backend == KMeansParams::Host) {
+    predict(params, centroids, X, n_samples, n_features, labels, inertia);
+    return;
+  }
   const ML::cumlHandle_impl &h = handle.getImpl();
   ML::detail::streamSyncer _(h);
 
@@ -84,6 +135,10 @@ void predict(const ML::cumlHandle &handle, const KMeansParams &params,
 void transform(const ML::cumlHandle &handle, const KMeansParams &params,
                const float *centroids, const float *X, int n_samples,
                int n_features, int metric, float *X_new) {
+  if (params.backend == KMeansParams::Host) {
+    transform(params, centroids, X, n_samples, n_features, metric, X_new);
+    return;
+  }
   const ML::cumlHandle_impl &h = handle.getImpl();
   ML::detail::streamSyncer _(h);
 
@@ -93,6 +148,10 @@ void transform(const ML::cumlHandle &handle, const KMeansParams &params,
 void transform(const ML::cumlHandle &handle, const KMeansParams &params,
                const double *centroids, const double *X, int n_samples,
                int n_features, int metric, double *X_new) {
+  if (params.backend == KMeansParams::Host) {
+    transform(params, centroids, X, n_samples, n_features, metric, X_new);
+    return;
+  }
   const ML::cumlHandle_impl &h = handle.getImpl();
   ML::detail::streamSyncer _(h);
 
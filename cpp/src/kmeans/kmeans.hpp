@@ -25,6 +25,8 @@ namespace kmeans {
 struct KMeansParams {
   enum InitMethod { KMeansPlusPlus, Random, Array };
 
+  enum Backend { Device, Host };
+
   // The number of clusters to form as well as the number of centroids to
   // generate (default:8).
   int n_clusters = 8;
@@ -61,6 +63,15 @@ struct KMeansParams {
   int batch_size = 1 << 15;
 
   bool inertia_check = false;
+
+  /*
+   * Where predict and transform run, defaults to the GPU:
+   *  - Backend::Device: inputs and outputs must be device accessible.
+   *  - Backend::Host: the computation runs on the CPU threads (OpenMP) and
+   * inputs and outputs must be host accessible. The results match the device
+   * version up to floating point rounding.
+   */
+  Backend backend = Device;
 };
 
 /**
@@ -123,6 +134,42 @@ void fit(const ML::cumlHandle &handle, const KMeansParams &params,
          const double *X, int n_samples, int n_features, double *centroids,
          double &inertia, int &n_iter);
 
+/**
+ * @brief Compute one k-means clustering per parameter set (e.g. a sweep over
+ * n_clusters) on the same data, running up to max_concurrent fits at once on
+ * separate streams.
+ *
+ * The fits run on handles which share the allocators of `handle`, see
+ * ML::batchFit. Fits using a random initialization may not reproduce the
+ * centroids of the same fits run one after the other.
+ *
+ * @param[in]     handle          The handle to the cuML library context that
+ * manages the CUDA resources.
+ * @param[in]     params          Parameters of each KMeans model (n_models).
+ * @param[in]     n_models        Number of models to fit.
+ * @param[in]     X               Training instances to cluster, row-major, in
+ * device accessible memory.
+ * @param[in]     n_samples       Number of samples in the input X.
+ * @param[in]     n_features      Number of features or the dimensions of each
+ * sample.
+ * @param[in|out] centroids       Host array of n_models device pointers, the
+ * centroids of model i (see fit()) are at centroids[i].
+ * @param[out]    inertia         Host array of the n_models inertias.
+ * @param[out]    n_iter          Host array of the n_models iteration counts.
+ * @param[in]     max_concurrent  Maximum number of fits running at once.
+ * @param[in]     memory_budget   Device memory available to the running fits
+ * in bytes, based on an estimate of the memory of each fit (0: no limit).
+ */
+void fitSweep(const ML::cumlHandle &handle, const KMeansParams *params,
+              int n_models, const float *X, int n_samples, int n_features,
+              float **centroids, float *inertia, int *n_iter,
+              int max_concurrent = 4, size_t memory_budget = 0);
+
+void fitSweep(const ML::cumlHandle &handle, const KMeansParams *params,
+              int n_models, const double *X, int n_samples, int n_features,
+              double **centroids, double *inertia, int *n_iter,
+              int max_concurrent = 4, size_t memory_budget = 0);
+
 /**
  * @brief Predict the closest cluster each sample in X belongs to.
  *
@@ -177,5 +224,31 @@ void transform(const ML::cumlHandle &handle, const KMeansParams &params,
                const double *centroids, const double *X, int n_samples,
                int n_features, int metric, double *X_new);
 
+/**
+ * @brief Predict the closest cluster each sample in X belongs to, on the CPU
+ * and without a cuML handle, whatever params.backend. See predict above for
+ * the parameters, which must all be in host memory here.
+ */
+void predict(const KMeansParams &params, const float *centroids,
+             const float *X, int n_samples, int n_features, int *labels,
+             float &inertia);
+
+void predict(const KMeansParams &params, const double *centroids,
+             const double *X, int n_samples, int n_features, int *labels,
+             double &inertia);
+
+/**
+ * @brief Transform X to a cluster-distance space on the CPU and without a
+ * cuML handle, whatever params.backend. See transform above for the
+ * parameters, which must all be in host memory here.
+ */
+void transform(const KMeansParams &params, const float *centroids,
+               const float *X, int n_samples, int n_features, int metric,
+               float *X_new);
+
+void transform(const KMeansParams &params, const double *centroids,
+               const double *X, int n_samples, int n_features, int metric,
+               double *X_new);
+
 };  // end namespace kmeans
 };  // end namespace ML
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "distance/distance_host.h"
+#include "kmeans.hpp"
+#include "selection/knn_host.h"
+#include "utils.h"
+
+namespace ML {
+namespace kmeans {
+
+namespace {
+
+template <typename DataT>
+void predictHost(const KMeansParams &params, const DataT *centroids,
+                 const DataT *X, int n_samples, int n_features, int *labels,
+                 DataT &inertia) {
+  auto n_clusters = params.n_clusters;
+  ASSERT(n_clusters > 0 && centroids != nullptr, "no clusters exist");
+  auto metric = static_cast<MLCommon::Distance::DistanceType>(params.metric);
+
+  // same batching of the samples as the device version
+  int batchSize = std::max(1, std::min(params.batch_size, n_samples));
+  std::vector<DataT> distance((size_t)batchSize * n_clusters);
+  std::vector<DataT> minDistance(batchSize);
+  DataT cost = DataT(0);
+  for (int dIdx = 0; dIdx < n_samples; dIdx += batchSize) {
+    int ns = std::min(batchSize, n_samples - dIdx);
+    MLCommon::Distance::pairwiseDistanceHost<DataT, int>(
+      X + (size_t)dIdx * n_features, centroids, distance.data(), ns,
+      n_clusters, n_features, metric);
+    // the closest centroid, the first one in case of ties
+    MLCommon::Selection::selectKHost<DataT, int>(
+      minDistance.data(), labels + dIdx, distance.data(), 1, ns, n_clusters);
+    const DataT *md = minDistance.data();
+#pragma omp parallel for reduction(+ : cost)
+    for (int i = 0; i < ns; ++i) cost += md[i];
+  }
+  inertia = cost;
+}
+
+template <typename DataT>
+void transformHost(const KMeansParams &params, const DataT *centroids,
+                   const DataT *X, int n_samples, int n_features,
+                   int transform_metric, DataT *X_new) {
+  ASSERT(params.n_clusters > 0 && centroids != nullptr, "no clusters exist");
+  auto metric = static_cast<MLCommon::Distance::DistanceType>(transform_metric);
+  MLCommon::Distance::pairwiseDistanceHost<DataT, int>(
+    X, centroids, X_new, n_samples, params.n_clusters, n_features, metric);
+}
+
+}  // namespace
+
+void predict(const KMeansParams &params, const float *centroids,
+             const float *X, int n_samples, int n_features, int *labels,
+             float &inertia) {
+  predictHost(params, centroids, X, n_samples, n_features, labels, inertia);
+}
+
+void predict(const KMeansParams &params, const double *centroids,
+             const double *X, int n_samples, int n_features, int *labels,
+             double &inertia) {
+  predictHost(params, centroids, X, n_samples, n_features, labels, inertia);
+}
+
+void transform(const KMeansParams &params, const float *centroids,
+               const float *X, int n_samples, int n_features, int metric,
+               float *X_new) {
+  transformHost(params, centroids, X, n_samples, n_features, metric, X_new);
+}
+
+void transform(const KMeansParams &params, const double *centroids,
+               const double *X, int n_samples, int n_features, int metric,
+               double *X_new) {
+  transformHost(params, centroids, X, n_samples, n_features, metric, X_new);
+}
+
+};  // end namespace kmeans
+};  // end namespace ML
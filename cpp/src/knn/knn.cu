@@ -15,16 +15,20 @@
  */
 
 #include "common/cumlHandle.hpp"
+#include "common/device_buffer.hpp"
 
 #include "knn.hpp"
 
 #include "ml_mg_utils.h"
 
 #include "selection/knn.h"
+#include "selection/knn_compressed.h"
+#include "selection/radius_neighbors.h"
 
 #include <cuda_runtime.h>
 #include "cuda_utils.h"
 
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -54,6 +58,21 @@ void brute_force_knn(cumlHandle &handle, float **input, int *sizes,
                                        handle.getImpl().getStream());
 }
 
+void brute_force_knn_host(cumlHandle &handle, const float *input,
+                          long n_index, int D, float *search_items, int n,
+                          long *res_I, float *res_D, int k,
+                          size_t max_tile_bytes) {
+  const cumlHandle_impl &h = handle.getImpl();
+  cudaStream_t stream = h.getStream();
+  cudaStream_t copy_stream =
+    h.getNumInternalStreams() > 0 ? h.getInternalStream(0) : stream;
+  long tile_rows = std::max<long>(1, max_tile_bytes / (D * sizeof(float)));
+  MLCommon::Selection::brute_force_knn_host(
+    input, n_index, D, search_items, n, res_I, res_D, k,
+    h.getDeviceAllocator(), h.getHostAllocator(), stream, copy_stream,
+    tile_rows);
+}
+
 /**
    * @brief A flat C++ API function that chunks a host array up into
    * some number of different devices
@@ -72,12 +91,86 @@ void chunk_host_array(cumlHandle &handle, const float *ptr, int n, int D,
                               handle.getImpl().getStream());
 }
 
+void knn_classify(cumlHandle &handle, int *out, float *probs, float **input,
+                  int *sizes, int n_params, int D, const int *y,
+                  int n_classes, float *search_items, int n, int k,
+                  bool distance_weighted, int batch_size) {
+  ASSERT(n_classes > 0, "knn_classify: n_classes must be > 0");
+  ASSERT(batch_size > 0, "knn_classify: batch_size must be > 0");
+  const cumlHandle_impl &h = handle.getImpl();
+  cudaStream_t stream = h.getStream();
+  int nb = std::min(n, batch_size);
+
+  MLCommon::device_buffer<long> knn_I(h.getDeviceAllocator(), stream,
+                                      (size_t)nb * k);
+  MLCommon::device_buffer<float> knn_D(h.getDeviceAllocator(), stream,
+                                       (size_t)nb * k);
+  // the votes need a scratch area when the probabilities are not requested
+  MLCommon::device_buffer<float> votes(h.getDeviceAllocator(), stream,
+                                       probs == nullptr ? (size_t)nb * n_classes
+                                                        : 0);
+
+  for (int off = 0; off < n; off += nb) {
+    int cur = std::min(nb, n - off);
+    float *probs_b =
+      probs == nullptr ? votes.data() : probs + (size_t)off * n_classes;
+    MLCommon::Selection::brute_force_knn(input, sizes, n_params, D,
+                                         search_items + (size_t)off * D, cur,
+                                         knn_I.data(), knn_D.data(), k, stream);
+    MLCommon::Selection::knn_classify(out + off, probs_b, knn_I.data(),
+                                      knn_D.data(), y, cur, n_classes, k,
+                                      distance_weighted, stream);
+  }
+}
+
+void knn_regress(cumlHandle &handle, float *out, float **input, int *sizes,
+                 int n_params, int D, const float *y, float *search_items,
+                 int n, int k, bool distance_weighted, int batch_size) {
+  ASSERT(batch_size > 0, "knn_regress: batch_size must be > 0");
+  const cumlHandle_impl &h = handle.getImpl();
+  cudaStream_t stream = h.getStream();
+  int nb = std::min(n, batch_size);
+
+  MLCommon::device_buffer<long> knn_I(h.getDeviceAllocator(), stream,
+                                      (size_t)nb * k);
+  MLCommon::device_buffer<float> knn_D(h.getDeviceAllocator(), stream,
+                                       (size_t)nb * k);
+
+  for (int off = 0; off < n; off += nb) {
+    int cur = std::min(nb, n - off);
+    MLCommon::Selection::brute_force_knn(input, sizes, n_params, D,
+                                         search_items + (size_t)off * D, cur,
+                                         knn_I.data(), knn_D.data(), k, stream);
+    MLCommon::Selection::knn_regress(out + off, knn_I.data(), knn_D.data(), y,
+                                     cur, k, distance_weighted, stream);
+  }
+}
+
+long radius_neighbors(cumlHandle &handle, float **input, int *sizes,
+                      int n_params, int D, float *search_items, int n,
+                      float eps, long *indptr, long *indices,
+                      float *distances, int batch_size) {
+  ASSERT(eps >= 0, "radius_neighbors: eps must be >= 0");
+  const cumlHandle_impl &h = handle.getImpl();
+  return MLCommon::Selection::radius_neighbors<float, long>(
+    input, sizes, n_params, D, search_items, n, eps, indptr, indices,
+    distances, h.getDeviceAllocator(), h.getStream(), batch_size);
+}
+
 /**
 	 * Build a kNN object for training and querying a k-nearest neighbors model.
 	 * @param D 	number of features in each vector
 	 */
-kNN::kNN(const cumlHandle &handle, int D, bool verbose)
-  : D(D), total_n(0), indices(0), verbose(verbose), owner(false) {
+kNN::kNN(const cumlHandle &handle, int D, bool verbose, kNNStorage storage)
+  : D(D),
+    total_n(0),
+    indices(0),
+    verbose(verbose),
+    owner(false),
+    storage(storage),
+    compressed(nullptr),
+    rerank_rows(nullptr),
+    rerank_candidates(0) {
   this->handle = const_cast<cumlHandle *>(&handle);
   sizes = nullptr;
   ptrs = nullptr;
@@ -99,6 +192,7 @@ kNN::~kNN() {
 
   delete ptrs;
   delete sizes;
+  delete compressed;
 }
 
 void kNN::reset() {
@@ -106,6 +200,15 @@ void kNN::reset() {
     this->indices = 0;
     this->total_n = 0;
   }
+  delete compressed;
+  compressed = nullptr;
+}
+
+void kNN::set_rerank(const float *host_rows, int n_candidates) {
+  ASSERT(host_rows == nullptr || (n_candidates > 0 && n_candidates <= 1024),
+         "kNN: n_candidates must be in [1, 1024]");
+  rerank_rows = host_rows;
+  rerank_candidates = n_candidates;
 }
 
 /**
@@ -133,6 +236,24 @@ void kNN::fit(float **input, int *sizes, int N) {
   for (int i = 0; i < N; i++) {
     this->ptrs[i] = input[i];
     this->sizes[i] = sizes[i];
+    this->total_n += sizes[i];
+  }
+
+  if (storage != KNN_STORAGE_FLOAT32) {
+    const cumlHandle_impl &h = handle->getImpl();
+    MLCommon::Selection::KnnStorage code =
+      storage == KNN_STORAGE_FLOAT16 ? MLCommon::Selection::KnnStorageFp16
+                                     : MLCommon::Selection::KnnStorageInt8;
+    compressed = new MLCommon::Selection::CompressedKnnIndex(
+      h.getDeviceAllocator(), h.getStream(), code, total_n, D);
+    MLCommon::Selection::compressKnnIndex(*compressed, input, sizes, N,
+                                          h.getStream());
+    CUDA_CHECK(cudaStreamSynchronize(h.getStream()));
+    // only the codes are searched from now on
+    if (this->owner) {
+      for (int i = 0; i < N; i++) CUDA_CHECK(cudaFree(this->ptrs[i]));
+      this->owner = false;
+    }
   }
 }
 
@@ -145,6 +266,14 @@ void kNN::fit(float **input, int *sizes, int N) {
 	 * @param k			   number of neighbors to query
 	 */
 void kNN::search(float *search_items, int n, long *res_I, float *res_D, int k) {
+  if (compressed != nullptr) {
+    const cumlHandle_impl &h = handle->getImpl();
+    MLCommon::Selection::compressedKnn(
+      *compressed, search_items, n, res_I, res_D, k, rerank_rows,
+      std::max(k, rerank_candidates), h.getDeviceAllocator(),
+      h.getHostAllocator(), h.getStream());
+    return;
+  }
   MLCommon::Selection::brute_force_knn(ptrs, sizes, indices, D, search_items, n,
                                        res_I, res_D, k,
                                        handle->getImpl().getStream());
@@ -28,6 +28,12 @@
 
 #include <iostream>
 
+namespace MLCommon {
+namespace Selection {
+struct CompressedKnnIndex;
+};  // namespace Selection
+};  // namespace MLCommon
+
 namespace ML {
 
 /**
@@ -50,6 +56,32 @@ void brute_force_knn(cumlHandle &handle, float **input, int *sizes,
                      int n_params, int D, float *search_items, int n,
                      long *res_I, float *res_D, int k);
 
+/**
+   * @brief Flat C++ API function to perform a brute force knn over an
+   * index that lives in host memory (pageable, pinned or memory-mapped),
+   * so that its size is not bound by the device memory. The index is
+   * streamed through the device in tiles of at most max_tile_bytes with
+   * double-buffered pinned transfers, on an internal stream of the handle
+   * when it has one, while a running top-k per query is kept on device.
+   *
+   * @param handle the cuml handle to use
+   * @param input host pointer to the row-major index
+   * @param n_index number of rows in input
+   * @param D the dimensionality of the arrays
+   * @param search_items array of items to search of dimensionality D
+   * (device)
+   * @param n number of rows in search_items
+   * @param res_I the resulting index array of size n * k
+   * @param res_D the resulting distance array of size n * k
+   * @param k the number of nearest neighbors to return
+   * @param max_tile_bytes the size of one index tile, two of them are
+   * allocated on device and in pinned host memory
+   */
+void brute_force_knn_host(cumlHandle &handle, const float *input,
+                          long n_index, int D, float *search_items, int n,
+                          long *res_I, float *res_D, int k,
+                          size_t max_tile_bytes = size_t(1) << 28);
+
 /**
    * @brief A flat C++ API function that chunks a host array up into
    * some number of different devices
@@ -65,6 +97,100 @@ void brute_force_knn(cumlHandle &handle, float **input, int *sizes,
 void chunk_host_array(cumlHandle &handle, const float *ptr, int n, int D,
                       int *devices, float **output, int *sizes, int n_chunks);
 
+/**
+   * @brief Flat C++ API function to classify a set of query rows by a
+   * (optionally inverse distance weighted) vote of the labels of their
+   * k nearest neighbors. The neighbor search and the vote run on device
+   * one chunk of queries at a time, so that the n x k intermediates stay
+   * bounded by batch_size x k.
+   *
+   * @param handle the cuml handle to use
+   * @param out the predicted class of each query, size n (device)
+   * @param probs optional class probabilities, row-major n x n_classes
+   * (device), may be null
+   * @param input an array of pointers to the input arrays
+   * @param sizes an array of sizes of input arrays
+   * @param n_params array size of input and sizes
+   * @param D the dimensionality of the arrays
+   * @param y the labels of the rows of the input arrays, taken in order
+   * and encoded as 0 .. n_classes - 1 (device)
+   * @param n_classes the number of classes
+   * @param search_items array of items to classify of dimensionality D
+   * @param n number of rows in search_items
+   * @param k the number of nearest neighbors to use
+   * @param distance_weighted weigh the votes by the inverse distance
+   * @param batch_size the number of queries processed at once
+   */
+void knn_classify(cumlHandle &handle, int *out, float *probs, float **input,
+                  int *sizes, int n_params, int D, const int *y,
+                  int n_classes, float *search_items, int n, int k,
+                  bool distance_weighted = false, int batch_size = 1 << 15);
+
+/**
+   * @brief Flat C++ API function to predict a target for a set of query
+   * rows as the (optionally inverse distance weighted) mean of the targets
+   * of their k nearest neighbors, computed on device in chunks of queries.
+   *
+   * @param handle the cuml handle to use
+   * @param out the predicted target of each query, size n (device)
+   * @param input an array of pointers to the input arrays
+   * @param sizes an array of sizes of input arrays
+   * @param n_params array size of input and sizes
+   * @param D the dimensionality of the arrays
+   * @param y the targets of the rows of the input arrays, taken in order
+   * (device)
+   * @param search_items array of items to query of dimensionality D
+   * @param n number of rows in search_items
+   * @param k the number of nearest neighbors to use
+   * @param distance_weighted weigh the targets by the inverse distance
+   * @param batch_size the number of queries processed at once
+   */
+void knn_regress(cumlHandle &handle, float *out, float **input, int *sizes,
+                 int n_params, int D, const float *y, float *search_items,
+                 int n, int k, bool distance_weighted = false,
+                 int batch_size = 1 << 15);
+
+/**
+   * @brief Flat C++ API function to find, for each query row, all the rows
+   * of a series of input arrays within a radius eps, returned as a CSR
+   * matrix. The search runs in two passes with bounded workspace: when
+   * indices is null, only indptr is filled and the total number of
+   * neighbors (nnz) is returned. A second call with the same indptr and
+   * indices and distances of size nnz fills the neighbor lists, each
+   * sorted by index.
+   *
+   * @param handle the cuml handle to use
+   * @param input an array of pointers to the input arrays, on the device
+   * of the handle
+   * @param sizes an array of sizes of input arrays
+   * @param n_params array size of input and sizes
+   * @param D the dimensionality of the arrays
+   * @param search_items array of items to search of dimensionality D
+   * @param n number of rows in search_items
+   * @param eps the radius of the neighborhoods
+   * @param indptr the CSR row offsets, size n + 1 (device)
+   * @param indices the neighbor indices, as row positions in the input
+   * arrays taken in order, size nnz (device), or null for the first pass
+   * @param distances the squared L2 distances of the neighbors, size nnz
+   * (device)
+   * @param batch_size the number of queries processed at once
+   * @return the number of neighbors over all the queries
+   */
+long radius_neighbors(cumlHandle &handle, float **input, int *sizes,
+                      int n_params, int D, float *search_items, int n,
+                      float eps, long *indptr, long *indices,
+                      float *distances, int batch_size = 1 << 11);
+
+/** Storage of the rows of a kNN index */
+enum kNNStorage {
+  /** the fp32 input arrays are searched in place */
+  KNN_STORAGE_FLOAT32 = 0,
+  /** fp16 codes of the rows, scaled per dimension (2x smaller) */
+  KNN_STORAGE_FLOAT16,
+  /** int8 scalar quantization of the rows, scaled per dimension (4x smaller) */
+  KNN_STORAGE_INT8,
+};
+
 class kNN {
   float **ptrs;
   int *sizes;
@@ -75,18 +201,37 @@ class kNN {
   bool verbose;
   bool owner;
 
+  kNNStorage storage;
+  MLCommon::Selection::CompressedKnnIndex *compressed;
+  const float *rerank_rows;
+  int rerank_candidates;
+
   cumlHandle *handle;
 
  public:
   /**
 	     * Build a kNN object for training and querying a k-nearest neighbors model.
 	     * @param D     number of features in each vector
+	     * @param storage  storage of the index rows. With a compressed storage
+	     *                 the inputs are encoded on the device of the handle at
+	     *                 fit time, and need not be kept afterwards.
 	     */
-  kNN(const cumlHandle &handle, int D, bool verbose = false);
+  kNN(const cumlHandle &handle, int D, bool verbose = false,
+      kNNStorage storage = KNN_STORAGE_FLOAT32);
   ~kNN();
 
   void reset();
 
+  /**
+     * Re-rank the neighbors found in a compressed index with exact fp32
+     * distances to the original rows, retained in host memory.
+     * @param host_rows     the fitted rows in host memory (row-major, in the
+     *                      order of the fitted arrays), or null to disable
+     * @param n_candidates  number of candidates re-ranked per query, at least
+     *                      the k of the searches and at most 1024
+     */
+  void set_rerank(const float *host_rows, int n_candidates);
+
   /**
      * Search the kNN for the k-nearest neighbors of a set of query vectors
      * @param search_items set of vectors to query for neighbors
@@ -15,6 +15,8 @@
  */
 
 // #include "metrics.h"
+#include <algorithm>
+#include <vector>
 #include "cuda_utils.h"
 #include "metrics.hpp"
 #include "metrics/adjustedRandIndex.h"
@@ -22,6 +24,8 @@
 #include "metrics/randIndex.h"
 #include "metrics/silhouetteScore.h"
 #include "metrics/vMeasure.h"
+#include "score/fusedMetrics.h"
+#include "score/rankingMetrics.h"
 #include "score/scores.h"
 
 namespace ML {
@@ -29,11 +33,80 @@ namespace ML {
 namespace Metrics {
 
 float r2_score_py(const cumlHandle &handle, float *y, float *y_hat, int n) {
-  return MLCommon::Score::r2_score(y, y_hat, n, handle.getStream());
+  return MLCommon::Score::r2_score((const float *)y, (const float *)y_hat, n,
+                                   handle.getDeviceAllocator(),
+                                   handle.getStream());
 }
 
 double r2_score_py(const cumlHandle &handle, double *y, double *y_hat, int n) {
-  return MLCommon::Score::r2_score(y, y_hat, n, handle.getStream());
+  return MLCommon::Score::r2_score((const double *)y, (const double *)y_hat, n,
+                                   handle.getDeviceAllocator(),
+                                   handle.getStream());
+}
+
+template <typename T>
+void regressionMetricsImpl(const cumlHandle &handle, const T *y,
+                           const T *y_hat, int n, int k, double *mse,
+                           double *mae, double *r2, double *median_ae) {
+  std::vector<MLCommon::Score::RegressionStats> stats(k);
+  MLCommon::Score::regressionStats(stats.data(), median_ae, y, y_hat, n, k, n,
+                                   handle.getDeviceAllocator(),
+                                   handle.getStream());
+  for (int j = 0; j < k; ++j) {
+    if (mse != nullptr) mse[j] = stats[j].mse();
+    if (mae != nullptr) mae[j] = stats[j].mae();
+    if (r2 != nullptr) r2[j] = stats[j].r2();
+  }
+}
+
+void regressionMetrics(const cumlHandle &handle, const float *y,
+                       const float *y_hat, int n, int k, double *mse,
+                       double *mae, double *r2, double *median_ae) {
+  regressionMetricsImpl(handle, y, y_hat, n, k, mse, mae, r2, median_ae);
+}
+
+void regressionMetrics(const cumlHandle &handle, const double *y,
+                       const double *y_hat, int n, int k, double *mse,
+                       double *mae, double *r2, double *median_ae) {
+  regressionMetricsImpl(handle, y, y_hat, n, k, mse, mae, r2, median_ae);
+}
+
+void classificationMetrics(const cumlHandle &handle, const int *y,
+                           const int *y_pred, int n, int k, int n_classes,
+                           const float *probs, double *accuracy,
+                           unsigned long long *confusion, double *log_loss) {
+  std::vector<MLCommon::Score::ClassificationStats> stats(k);
+  MLCommon::Score::classificationStats(
+    stats.data(), y, y_pred, n, k, n, n_classes, probs,
+    size_t(n) * n_classes, 1e-15f, handle.getDeviceAllocator(),
+    handle.getStream());
+  size_t nc2 = size_t(n_classes) * n_classes;
+  for (int j = 0; j < k; ++j) {
+    if (accuracy != nullptr) accuracy[j] = stats[j].accuracy();
+    if (confusion != nullptr) {
+      std::copy(stats[j].confusion.begin(), stats[j].confusion.end(),
+                confusion + j * nc2);
+    }
+    if (log_loss != nullptr && probs != nullptr)
+      log_loss[j] = stats[j].log_loss();
+  }
+}
+
+void rankingScores(const cumlHandle &handle, const int *y,
+                   const float *scores, int n, int k, double *roc_auc,
+                   double *average_precision) {
+  MLCommon::Score::rankingScores(roc_auc, average_precision, y, scores, n, k,
+                                 n, handle.getDeviceAllocator(),
+                                 handle.getStream());
+}
+
+void calibrationCurve(const cumlHandle &handle, const int *y,
+                      const float *probs, int n, int k, int n_bins,
+                      double *prob_true, double *prob_pred,
+                      unsigned long long *counts) {
+  MLCommon::Score::calibrationCurve(prob_true, prob_pred, counts, y, probs, n,
+                                    k, n, n_bins, handle.getDeviceAllocator(),
+                                    handle.getStream());
 }
 
 double randIndex(const cumlHandle &handle, const double *y, const double *y_hat,
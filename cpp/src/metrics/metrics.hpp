@@ -58,6 +58,89 @@ float r2_score_py(const cumlHandle &handle, float *y, float *y_hat, int n);
 */
 double r2_score_py(const cumlHandle &handle, double *y, double *y_hat, int n);
 
+/**
+* Calculates the regression metrics of k vectors of predictions against the
+* same labels, in a single pass over the data
+*
+* @param handle: cumlHandle
+* @param y: Array of ground-truth response variables, n elements
+* @param y_hat: Arrays of predicted response variables, k x n elements
+* @param n: Number of elements in y and in each prediction vector
+* @param k: Number of prediction vectors
+* @param mse: Mean squared errors (k values on host, or nullptr)
+* @param mae: Mean absolute errors (k values on host, or nullptr)
+* @param r2: R-squared values (k values on host, or nullptr)
+* @param median_ae: Median absolute errors (k values on host, or nullptr to
+*        skip them and their n x k temporary buffer)
+*/
+void regressionMetrics(const cumlHandle &handle, const float *y,
+                       const float *y_hat, int n, int k, double *mse,
+                       double *mae, double *r2, double *median_ae);
+void regressionMetrics(const cumlHandle &handle, const double *y,
+                       const double *y_hat, int n, int k, double *mse,
+                       double *mae, double *r2, double *median_ae);
+
+/**
+* Calculates the classification metrics of k vectors of predicted labels
+* against the same true labels, in a single pass over the data
+*
+* @param handle: cumlHandle
+* @param y: Array of true labels in [0, n_classes), n elements
+* @param y_pred: Arrays of predicted labels, k x n elements
+* @param n: Number of elements in y and in each prediction vector
+* @param k: Number of prediction vectors
+* @param n_classes: Number of classes
+* @param probs: Predicted probabilities, k row-major n x n_classes matrices,
+*        or nullptr
+* @param accuracy: Accuracies (k values on host, or nullptr)
+* @param confusion: Confusion matrices, k row-major n_classes x n_classes
+*        matrices of counts with the true labels as rows (host, or nullptr)
+* @param log_loss: Log-losses (k values on host, or nullptr); requires probs
+*/
+void classificationMetrics(const cumlHandle &handle, const int *y,
+                           const int *y_pred, int n, int k, int n_classes,
+                           const float *probs, double *accuracy,
+                           unsigned long long *confusion, double *log_loss);
+
+/**
+* Calculates the exact area under the ROC curve and the average precision of
+* k score vectors against the same binary labels, with ties handled as by
+* sklearn
+*
+* @param handle: cumlHandle
+* @param y: Array of labels, n elements; nonzero labels are positive
+* @param scores: Arrays of scores, k x n elements
+* @param n: Number of elements in y and in each score vector
+* @param k: Number of score vectors
+* @param roc_auc: Areas under the ROC curve (k values on host, or nullptr)
+* @param average_precision: Average precisions (k values on host, or nullptr)
+*/
+void rankingScores(const cumlHandle &handle, const int *y,
+                   const float *scores, int n, int k, double *roc_auc,
+                   double *average_precision);
+
+/**
+* Calculates the calibration curves of k vectors of predicted probabilities,
+* over n_bins uniform bins of [0, 1]
+*
+* @param handle: cumlHandle
+* @param y: Array of labels, n elements; nonzero labels are positive
+* @param probs: Arrays of predicted probabilities, k x n elements
+* @param n: Number of elements in y and in each probability vector
+* @param k: Number of probability vectors
+* @param n_bins: Number of bins
+* @param prob_true: Fractions of positives per bin (k x n_bins values on host,
+*        0 for the empty bins)
+* @param prob_pred: Mean probabilities per bin (k x n_bins values on host, 0
+*        for the empty bins)
+* @param counts: Number of samples per bin (k x n_bins values on host, or
+*        nullptr)
+*/
+void calibrationCurve(const cumlHandle &handle, const int *y,
+                      const float *probs, int n, int k, int n_bins,
+                      double *prob_true, double *prob_pred,
+                      unsigned long long *counts);
+
 /**
 * Calculates the "rand index"
 *
@@ -146,9 +146,11 @@ void postprocess_labels(int n_rows, std::vector<int>& labels,
  * @param[in] cfg_bootstrap: bootstrapping; default true
  * @param[in] cfg_rows_sample: rows sample; default 1.0f
  * @param[in] cfg_n_streams: No of parallel CUDA for training forest
+ * @param[in] cfg_seed: seed for row and feature sampling
  */
 void set_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
-                   float cfg_rows_sample, int cfg_n_streams) {
+                   float cfg_rows_sample, int cfg_n_streams,
+                   uint64_t cfg_seed) {
   params.n_trees = cfg_n_trees;
   params.bootstrap = cfg_bootstrap;
   params.rows_sample = cfg_rows_sample;
@@ -160,6 +162,7 @@ void set_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
   if (cfg_n_trees < params.n_streams) params.n_streams = cfg_n_trees;
   set_tree_params(params.tree_params);  // use default tree params
   if (params.tree_params.split_algo == 0) params.n_streams = 1;
+  params.seed = cfg_seed;
 }
 
 /**
@@ -170,10 +173,12 @@ void set_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
  * @param[in] cfg_rows_sample: rows sample
  * @param[in] cfg_n_streams: No of parallel CUDA for training forest
  * @param[in] cfg_tree_params: tree parameters
+ * @param[in] cfg_seed: seed for row and feature sampling
  */
 void set_all_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
                        float cfg_rows_sample, int cfg_n_streams,
-                       DecisionTree::DecisionTreeParams cfg_tree_params) {
+                       DecisionTree::DecisionTreeParams cfg_tree_params,
+                       uint64_t cfg_seed) {
   params.n_trees = cfg_n_trees;
   params.bootstrap = cfg_bootstrap;
   params.rows_sample = cfg_rows_sample;
@@ -182,6 +187,7 @@ void set_all_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
   set_tree_params(params.tree_params);  // use input tree params
   params.tree_params = cfg_tree_params;
   if (params.tree_params.split_algo == 0) params.n_streams = 1;
+  params.seed = cfg_seed;
 }
 
 /**
@@ -205,6 +211,7 @@ void print(const RF_params rf_params) {
   std::cout << "bootstrap: " << rf_params.bootstrap << std::endl;
   std::cout << "rows_sample: " << rf_params.rows_sample << std::endl;
   std::cout << "n_streams: " << rf_params.n_streams << std::endl;
+  std::cout << "seed: " << rf_params.seed << std::endl;
   DecisionTree::print(rf_params.tree_params);
 }
 
@@ -317,11 +324,16 @@ void build_treelite_forest(ModelHandle* model,
  *   needed for current gini impl. in decision tree
  * @param[in] n_unique_labels: #unique label values (known during preprocessing)
  * @param[in] rf_params: Random Forest training hyper parameter struct.
+ * @param[in] sample_weight: optional per sample weights (n_rows); nullptr for
+ *   unit weights. Only used by the GLOBAL_QUANTILE split algorithm. Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels), multiplied
+ *   with the sample weights; nullptr for unit weights. Device pointer.
  * @{
  */
 void fit(const cumlHandle& user_handle, RandomForestClassifierF*& forest,
          float* input, int n_rows, int n_cols, int* labels, int n_unique_labels,
-         RF_params rf_params) {
+         RF_params rf_params, const float* sample_weight,
+         const float* class_weight) {
   ASSERT(!forest->trees, "Cannot fit an existing forest.");
   forest->trees =
     new DecisionTree::TreeMetaDataNode<float, int>[rf_params.n_trees];
@@ -333,12 +345,13 @@ void fit(const cumlHandle& user_handle, RandomForestClassifierF*& forest,
   std::shared_ptr<rfClassifier<float>> rf_classifier =
     std::make_shared<rfClassifier<float>>(rf_params);
   rf_classifier->fit(user_handle, input, n_rows, n_cols, labels,
-                     n_unique_labels, forest);
+                     n_unique_labels, forest, sample_weight, class_weight);
 }
 
 void fit(const cumlHandle& user_handle, RandomForestClassifierD*& forest,
          double* input, int n_rows, int n_cols, int* labels,
-         int n_unique_labels, RF_params rf_params) {
+         int n_unique_labels, RF_params rf_params, const double* sample_weight,
+         const double* class_weight) {
   ASSERT(!forest->trees, "Cannot fit an existing forest.");
   forest->trees =
     new DecisionTree::TreeMetaDataNode<double, int>[rf_params.n_trees];
@@ -350,7 +363,118 @@ void fit(const cumlHandle& user_handle, RandomForestClassifierD*& forest,
   std::shared_ptr<rfClassifier<double>> rf_classifier =
     std::make_shared<rfClassifier<double>>(rf_params);
   rf_classifier->fit(user_handle, input, n_rows, n_cols, labels,
-                     n_unique_labels, forest);
+                     n_unique_labels, forest, sample_weight, class_weight);
+}
+/** @} */
+
+/**
+ * @defgroup Random Forest Classification - Multi-rank fit function
+ * @brief Build a random forest classifier from data partitioned by rows
+ *   across the ranks of the handle's communicator. Quantiles are computed
+ *   over all the ranks, each rank fits rf_params.n_trees trees on its local
+ *   rows, and the trees of all the ranks are merged into forest on every rank.
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ * @param[in,out] forest: CPU pointer to RandomForestMetaData object. User allocated.
+ * @param[in] input: local train data (n_local_rows samples, n_cols features) in
+ *   column major format, excluding labels. Device pointer.
+ * @param[in] n_local_rows: number of training data samples on this rank.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: 1D array of target features (int only), with one label per
+ *   local training sample, mapped to [0, n_unique_labels) consistently on all the
+ *   ranks. Device pointer.
+ * @param[in] n_unique_labels: #unique label values over all the ranks.
+ * @param[in] rf_params: Random Forest training hyper parameter struct; the same on
+ *   every rank. Requires the GLOBAL_QUANTILE split algorithm.
+ * @param[in] sample_weight: optional per sample weights (n_local_rows). Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels). Device pointer.
+ * @{
+ */
+void fit_mg(const cumlHandle& user_handle, RandomForestClassifierF*& forest,
+            float* input, int n_local_rows, int n_cols, int* labels,
+            int n_unique_labels, RF_params rf_params,
+            const float* sample_weight, const float* class_weight) {
+  ASSERT(!forest->trees, "Cannot fit an existing forest.");
+  forest->trees =
+    new DecisionTree::TreeMetaDataNode<float, int>[rf_params.n_trees];
+  for (int i = 0; i < rf_params.n_trees; i++) {
+    forest->trees[i].root = nullptr;
+  }
+  forest->rf_params = rf_params;
+
+  std::shared_ptr<rfClassifier<float>> rf_classifier =
+    std::make_shared<rfClassifier<float>>(rf_params);
+  rf_classifier->fit_mg(user_handle, input, n_local_rows, n_cols, labels,
+                        n_unique_labels, forest, sample_weight, class_weight);
+}
+
+void fit_mg(const cumlHandle& user_handle, RandomForestClassifierD*& forest,
+            double* input, int n_local_rows, int n_cols, int* labels,
+            int n_unique_labels, RF_params rf_params,
+            const double* sample_weight, const double* class_weight) {
+  ASSERT(!forest->trees, "Cannot fit an existing forest.");
+  forest->trees =
+    new DecisionTree::TreeMetaDataNode<double, int>[rf_params.n_trees];
+  for (int i = 0; i < rf_params.n_trees; i++) {
+    forest->trees[i].root = nullptr;
+  }
+  forest->rf_params = rf_params;
+
+  std::shared_ptr<rfClassifier<double>> rf_classifier =
+    std::make_shared<rfClassifier<double>>(rf_params);
+  rf_classifier->fit_mg(user_handle, input, n_local_rows, n_cols, labels,
+                        n_unique_labels, forest, sample_weight, class_weight);
+}
+/** @} */
+
+/**
+ * @defgroup Random Forest Classification - Warm-start fit function
+ * @brief Add trees fitted on new data to a fitted random forest classifier.
+ *   rf_params.n_trees new trees are fitted and appended to the existing ones,
+ *   which are not refitted; with a positive max_trees, the oldest trees are
+ *   then dropped so that at most max_trees remain. n_cols, n_unique_labels
+ *   and the split criterion have to be the ones of the forest. The quantiles
+ *   cached in forest are reused when the binning parameters match. The
+ *   forest takes rf_params, with the new number of trees, and its treelite
+ *   export holds the updated set of trees.
+ * @param[in] user_handle: cumlHandle
+ * @param[in,out] forest: CPU pointer to a fitted RandomForestMetaData object.
+ * @param[in] input: new train data (n_rows samples, n_cols features) in column
+ *   major format, excluding labels. Device pointer.
+ * @param[in] n_rows: number of new training data samples.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: 1D array of target features (int only), with one label per
+ *   training sample, mapped to [0, n_unique_labels) as for the existing trees.
+ *   Device pointer.
+ * @param[in] n_unique_labels: #unique label values of the forest.
+ * @param[in] rf_params: Random Forest training hyper parameter struct of the new
+ *   trees.
+ * @param[in] max_trees: maximum number of trees kept, 0 for no limit.
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels). Device pointer.
+ * @{
+ */
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestClassifierF*& forest, float* input, int n_rows,
+                    int n_cols, int* labels, int n_unique_labels,
+                    RF_params rf_params, int max_trees,
+                    const float* sample_weight, const float* class_weight) {
+  std::shared_ptr<rfClassifier<float>> rf_classifier =
+    std::make_shared<rfClassifier<float>>(rf_params);
+  rf_classifier->fit_warm_start(user_handle, input, n_rows, n_cols, labels,
+                                n_unique_labels, forest, max_trees,
+                                sample_weight, class_weight);
+}
+
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestClassifierD*& forest, double* input, int n_rows,
+                    int n_cols, int* labels, int n_unique_labels,
+                    RF_params rf_params, int max_trees,
+                    const double* sample_weight, const double* class_weight) {
+  std::shared_ptr<rfClassifier<double>> rf_classifier =
+    std::make_shared<rfClassifier<double>>(rf_params);
+  rf_classifier->fit_warm_start(user_handle, input, n_rows, n_cols, labels,
+                                n_unique_labels, forest, max_trees,
+                                sample_weight, class_weight);
 }
 /** @} */
 
@@ -424,6 +548,43 @@ void predictGetAll(const cumlHandle& user_handle,
 }
 /** @} */
 
+/**
+ * @defgroup Random Forest Classification - Predict probabilities function
+ * @brief Predict class probabilities for input data as the average of the
+ *   leaf class distributions across the trees of the forest.
+ * @param[in] user_handle: cumlHandle.
+ * @param[in] forest: CPU pointer to RandomForestMetaData object.
+ *   The user should have previously called fit to build the random forest.
+ * @param[in] input: test data (n_rows samples, n_cols features) in row major format. GPU pointer.
+ * @param[in] n_rows: number of  data samples.
+ * @param[in] n_cols: number of features (excluding target feature).
+ * @param[in] n_unique_labels: number of unique label values the forest was fitted on.
+ * @param[in, out] probs: n_rows x n_unique_labels class probabilities in row major format.
+ *   GPU pointer, user allocated.
+ * @{
+ */
+void predict_proba(const cumlHandle& user_handle,
+                   const RandomForestClassifierF* forest, const float* input,
+                   int n_rows, int n_cols, int n_unique_labels, float* probs) {
+  ASSERT(forest->trees, "Cannot predict! No trees in the forest.");
+  std::shared_ptr<rfClassifier<float>> rf_classifier =
+    std::make_shared<rfClassifier<float>>(forest->rf_params);
+  rf_classifier->predict_proba(user_handle, input, n_rows, n_cols,
+                               n_unique_labels, probs, forest);
+}
+
+void predict_proba(const cumlHandle& user_handle,
+                   const RandomForestClassifierD* forest, const double* input,
+                   int n_rows, int n_cols, int n_unique_labels,
+                   double* probs) {
+  ASSERT(forest->trees, "Cannot predict! No trees in the forest.");
+  std::shared_ptr<rfClassifier<double>> rf_classifier =
+    std::make_shared<rfClassifier<double>>(forest->rf_params);
+  rf_classifier->predict_proba(user_handle, input, n_rows, n_cols,
+                               n_unique_labels, probs, forest);
+}
+/** @} */
+
 /**
  * @defgroup Random Forest Classification - Score function
  * @brief Predict target feature for input data and validate against ref_labels.
@@ -470,14 +631,15 @@ RF_params set_rf_class_obj(int max_depth, int max_leaves, float max_features,
                            int n_bins, int split_algo, int min_rows_per_node,
                            bool bootstrap_features, bool bootstrap, int n_trees,
                            float rows_sample, CRITERION split_criterion,
-                           bool quantile_per_tree, int cfg_n_streams) {
+                           bool quantile_per_tree, int cfg_n_streams,
+                           uint64_t cfg_seed) {
   DecisionTree::DecisionTreeParams tree_params;
   DecisionTree::set_tree_params(
     tree_params, max_depth, max_leaves, max_features, n_bins, split_algo,
     min_rows_per_node, bootstrap_features, split_criterion, quantile_per_tree);
   RF_params rf_params;
   set_all_rf_params(rf_params, n_trees, bootstrap, rows_sample, cfg_n_streams,
-                    tree_params);
+                    tree_params, cfg_seed);
   return rf_params;
 }
 
@@ -493,11 +655,13 @@ RF_params set_rf_class_obj(int max_depth, int max_leaves, float max_features,
  * @param[in] labels: 1D array of target features (float or double), with one label per
  *   training sample. Device pointer.
  * @param[in] rf_params: Random Forest training hyper parameter struct.
+ * @param[in] sample_weight: optional per sample weights (n_rows); nullptr for
+ *   unit weights. Only used by the GLOBAL_QUANTILE split algorithm. Device pointer.
  * @{
  */
 void fit(const cumlHandle& user_handle, RandomForestRegressorF*& forest,
          float* input, int n_rows, int n_cols, float* labels,
-         RF_params rf_params) {
+         RF_params rf_params, const float* sample_weight) {
   ASSERT(!forest->trees, "Cannot fit an existing forest.");
   forest->trees =
     new DecisionTree::TreeMetaDataNode<float, float>[rf_params.n_trees];
@@ -508,12 +672,67 @@ void fit(const cumlHandle& user_handle, RandomForestRegressorF*& forest,
 
   std::shared_ptr<rfRegressor<float>> rf_regressor =
     std::make_shared<rfRegressor<float>>(rf_params);
-  rf_regressor->fit(user_handle, input, n_rows, n_cols, labels, forest);
+  rf_regressor->fit(user_handle, input, n_rows, n_cols, labels, forest,
+                    sample_weight);
 }
 
 void fit(const cumlHandle& user_handle, RandomForestRegressorD*& forest,
          double* input, int n_rows, int n_cols, double* labels,
-         RF_params rf_params) {
+         RF_params rf_params, const double* sample_weight) {
+  ASSERT(!forest->trees, "Cannot fit an existing forest.");
+  forest->trees =
+    new DecisionTree::TreeMetaDataNode<double, double>[rf_params.n_trees];
+  for (int i = 0; i < rf_params.n_trees; i++) {
+    forest->trees[i].root = nullptr;
+  }
+  forest->rf_params = rf_params;
+
+  std::shared_ptr<rfRegressor<double>> rf_regressor =
+    std::make_shared<rfRegressor<double>>(rf_params);
+  rf_regressor->fit(user_handle, input, n_rows, n_cols, labels, forest,
+                    sample_weight);
+}
+/** @} */
+
+/**
+ * @defgroup Random Forest Regression - Multi-rank fit function
+ * @brief Build a random forest regressor from data partitioned by rows
+ *   across the ranks of the handle's communicator. Quantiles are computed
+ *   over all the ranks, each rank fits rf_params.n_trees trees on its local
+ *   rows, and the trees of all the ranks are merged into forest on every rank.
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ * @param[in,out] forest: CPU pointer to RandomForestMetaData object. User allocated.
+ * @param[in] input: local train data (n_local_rows samples, n_cols features) in
+ *   column major format, excluding labels. Device pointer.
+ * @param[in] n_local_rows: number of training data samples on this rank.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: 1D array of target features (float or double), with one label
+ *   per local training sample. Device pointer.
+ * @param[in] rf_params: Random Forest training hyper parameter struct; the same on
+ *   every rank. Requires the GLOBAL_QUANTILE split algorithm.
+ * @param[in] sample_weight: optional per sample weights (n_local_rows). Device pointer.
+ * @{
+ */
+void fit_mg(const cumlHandle& user_handle, RandomForestRegressorF*& forest,
+            float* input, int n_local_rows, int n_cols, float* labels,
+            RF_params rf_params, const float* sample_weight) {
+  ASSERT(!forest->trees, "Cannot fit an existing forest.");
+  forest->trees =
+    new DecisionTree::TreeMetaDataNode<float, float>[rf_params.n_trees];
+  for (int i = 0; i < rf_params.n_trees; i++) {
+    forest->trees[i].root = nullptr;
+  }
+  forest->rf_params = rf_params;
+
+  std::shared_ptr<rfRegressor<float>> rf_regressor =
+    std::make_shared<rfRegressor<float>>(rf_params);
+  rf_regressor->fit_mg(user_handle, input, n_local_rows, n_cols, labels, forest,
+                       sample_weight);
+}
+
+void fit_mg(const cumlHandle& user_handle, RandomForestRegressorD*& forest,
+            double* input, int n_local_rows, int n_cols, double* labels,
+            RF_params rf_params, const double* sample_weight) {
   ASSERT(!forest->trees, "Cannot fit an existing forest.");
   forest->trees =
     new DecisionTree::TreeMetaDataNode<double, double>[rf_params.n_trees];
@@ -524,7 +743,47 @@ void fit(const cumlHandle& user_handle, RandomForestRegressorD*& forest,
 
   std::shared_ptr<rfRegressor<double>> rf_regressor =
     std::make_shared<rfRegressor<double>>(rf_params);
-  rf_regressor->fit(user_handle, input, n_rows, n_cols, labels, forest);
+  rf_regressor->fit_mg(user_handle, input, n_local_rows, n_cols, labels, forest,
+                       sample_weight);
+}
+/** @} */
+
+/**
+ * @defgroup Random Forest Regression - Warm-start fit function
+ * @brief Add trees fitted on new data to a fitted random forest regressor,
+ *   as for classification.
+ * @param[in] user_handle: cumlHandle
+ * @param[in,out] forest: CPU pointer to a fitted RandomForestMetaData object.
+ * @param[in] input: new train data (n_rows samples, n_cols features) in column
+ *   major format, excluding labels. Device pointer.
+ * @param[in] n_rows: number of new training data samples.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: 1D array of target features (float or double), with one
+ *   label per training sample. Device pointer.
+ * @param[in] rf_params: Random Forest training hyper parameter struct of the new
+ *   trees.
+ * @param[in] max_trees: maximum number of trees kept, 0 for no limit.
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
+ * @{
+ */
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestRegressorF*& forest, float* input, int n_rows,
+                    int n_cols, float* labels, RF_params rf_params,
+                    int max_trees, const float* sample_weight) {
+  std::shared_ptr<rfRegressor<float>> rf_regressor =
+    std::make_shared<rfRegressor<float>>(rf_params);
+  rf_regressor->fit_warm_start(user_handle, input, n_rows, n_cols, labels,
+                               forest, max_trees, sample_weight);
+}
+
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestRegressorD*& forest, double* input, int n_rows,
+                    int n_cols, double* labels, RF_params rf_params,
+                    int max_trees, const double* sample_weight) {
+  std::shared_ptr<rfRegressor<double>> rf_regressor =
+    std::make_shared<rfRegressor<double>>(rf_params);
+  rf_regressor->fit_warm_start(user_handle, input, n_rows, n_cols, labels,
+                               forest, max_trees, sample_weight);
 }
 /** @} */
 
@@ -17,6 +17,8 @@
 #pragma once
 #include <treelite/c_api.h>
 #include <map>
+#include <memory>
+#include <vector>
 #include "decisiontree/decisiontree.hpp"
 
 namespace ML {
@@ -72,14 +74,21 @@ struct RF_params {
    */
   int n_streams;
   DecisionTree::DecisionTreeParams tree_params;
+  /**
+   * Seed for the random number generators used for row and feature sampling.
+   * Together with the tree id it keys the per node feature sampling, so
+   * forests fitted with the same seed and parameters are identical.
+   */
+  uint64_t seed;
 };
 
 void set_rf_params(RF_params& params, int cfg_n_trees = 1,
                    bool cfg_bootstrap = true, float cfg_rows_sample = 1.0f,
-                   int cfg_n_streams = 4);
+                   int cfg_n_streams = 4, uint64_t cfg_seed = 0);
 void set_all_rf_params(RF_params& params, int cfg_n_trees, bool cfg_bootstrap,
                        float cfg_rows_sample, int cfg_n_streams,
-                       DecisionTree::DecisionTreeParams cfg_tree_params);
+                       DecisionTree::DecisionTreeParams cfg_tree_params,
+                       uint64_t cfg_seed = 0);
 void validity_check(const RF_params rf_params);
 void print(const RF_params rf_params);
 
@@ -93,11 +102,37 @@ void preprocess_labels(int n_rows, std::vector<int>& labels,
 void postprocess_labels(int n_rows, std::vector<int>& labels,
                         std::map<int, int>& labels_map, bool verbose = false);
 
+template <class T>
+struct FlatForest;
+
 template <class T, class L>
 struct RandomForestMetaData {
   DecisionTree::TreeMetaDataNode<T, L>* trees;
   RF_params rf_params;
   //TODO can add prepare, train time, if needed
+
+  // Training state kept for warm-start fits.
+  /**
+   * Quantiles shared by the whole forest (GLOBAL_QUANTILE split algorithm
+   * without quantile_per_tree), n_bins per column, column after column, as
+   * computed by the last fit; empty otherwise.
+   */
+  std::vector<T> quantiles;
+  /**
+   * Number of columns of the data the forest was fitted on.
+   */
+  int n_cols = 0;
+  /**
+   * Number of trees fitted so far, including the ones dropped since; the
+   * tree ids of a warm-start fit start there.
+   */
+  int n_fitted_trees = 0;
+
+  /**
+   * Device copy of the trees of a classifier, built by the first
+   * predict_proba call and freed with the forest. Fits reset it.
+   */
+  mutable std::shared_ptr<FlatForest<T>> flat_forest;
 };
 
 template <class T, class L>
@@ -121,10 +156,50 @@ typedef RandomForestMetaData<double, int> RandomForestClassifierD;
 
 void fit(const cumlHandle& user_handle, RandomForestClassifierF*& forest,
          float* input, int n_rows, int n_cols, int* labels, int n_unique_labels,
-         RF_params rf_params);
+         RF_params rf_params, const float* sample_weight = nullptr,
+         const float* class_weight = nullptr);
 void fit(const cumlHandle& user_handle, RandomForestClassifierD*& forest,
          double* input, int n_rows, int n_cols, int* labels,
-         int n_unique_labels, RF_params rf_params);
+         int n_unique_labels, RF_params rf_params,
+         const double* sample_weight = nullptr,
+         const double* class_weight = nullptr);
+
+/* Multi-rank fit over the communicator of user_handle: every rank passes its
+   local rows and fits rf_params.n_trees trees on them, using quantiles
+   computed over all the ranks; the ranks may fit different numbers of trees.
+   On return forest holds the trees of all the ranks, in rank order, on every
+   rank. */
+void fit_mg(const cumlHandle& user_handle, RandomForestClassifierF*& forest,
+            float* input, int n_local_rows, int n_cols, int* labels,
+            int n_unique_labels, RF_params rf_params,
+            const float* sample_weight = nullptr,
+            const float* class_weight = nullptr);
+void fit_mg(const cumlHandle& user_handle, RandomForestClassifierD*& forest,
+            double* input, int n_local_rows, int n_cols, int* labels,
+            int n_unique_labels, RF_params rf_params,
+            const double* sample_weight = nullptr,
+            const double* class_weight = nullptr);
+
+/* Warm-start fit: fit rf_params.n_trees new trees on (input, labels) and
+   append them to the trees of forest, which stay as they are. If max_trees is
+   positive, the oldest trees are then dropped so that at most max_trees
+   remain. The quantiles cached by the previous fit are reused when the
+   binning parameters match, otherwise they are computed on the new data.
+   The new trees get the tree ids following all the trees fitted so far, so
+   they sample other rows and features than the existing ones. n_cols,
+   n_unique_labels and the split criterion have to match the forest. */
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestClassifierF*& forest, float* input, int n_rows,
+                    int n_cols, int* labels, int n_unique_labels,
+                    RF_params rf_params, int max_trees = 0,
+                    const float* sample_weight = nullptr,
+                    const float* class_weight = nullptr);
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestClassifierD*& forest, double* input, int n_rows,
+                    int n_cols, int* labels, int n_unique_labels,
+                    RF_params rf_params, int max_trees = 0,
+                    const double* sample_weight = nullptr,
+                    const double* class_weight = nullptr);
 
 void predict(const cumlHandle& user_handle,
              const RandomForestClassifierF* forest, const float* input,
@@ -142,6 +217,13 @@ void predictGetAll(const cumlHandle& user_handle,
                    int n_rows, int n_cols, int* predictions,
                    bool verbose = false);
 
+void predict_proba(const cumlHandle& user_handle,
+                   const RandomForestClassifierF* forest, const float* input,
+                   int n_rows, int n_cols, int n_unique_labels, float* probs);
+void predict_proba(const cumlHandle& user_handle,
+                   const RandomForestClassifierD* forest, const double* input,
+                   int n_rows, int n_cols, int n_unique_labels, double* probs);
+
 RF_metrics score(const cumlHandle& user_handle,
                  const RandomForestClassifierF* forest, const float* input,
                  const int* ref_labels, int n_rows, int n_cols,
@@ -155,7 +237,8 @@ RF_params set_rf_class_obj(int max_depth, int max_leaves, float max_features,
                            int n_bins, int split_algo, int min_rows_per_node,
                            bool bootstrap_features, bool bootstrap, int n_trees,
                            float rows_sample, CRITERION split_criterion,
-                           bool quantile_per_tree, int cfg_n_streams);
+                           bool quantile_per_tree, int cfg_n_streams,
+                           uint64_t cfg_seed = 0);
 
 // ----------------------------- Regression ----------------------------------- //
 
@@ -164,10 +247,27 @@ typedef RandomForestMetaData<double, double> RandomForestRegressorD;
 
 void fit(const cumlHandle& user_handle, RandomForestRegressorF*& forest,
          float* input, int n_rows, int n_cols, float* labels,
-         RF_params rf_params);
+         RF_params rf_params, const float* sample_weight = nullptr);
 void fit(const cumlHandle& user_handle, RandomForestRegressorD*& forest,
          double* input, int n_rows, int n_cols, double* labels,
-         RF_params rf_params);
+         RF_params rf_params, const double* sample_weight = nullptr);
+
+void fit_mg(const cumlHandle& user_handle, RandomForestRegressorF*& forest,
+            float* input, int n_local_rows, int n_cols, float* labels,
+            RF_params rf_params, const float* sample_weight = nullptr);
+void fit_mg(const cumlHandle& user_handle, RandomForestRegressorD*& forest,
+            double* input, int n_local_rows, int n_cols, double* labels,
+            RF_params rf_params, const double* sample_weight = nullptr);
+
+/* Warm-start fit, as for classification. */
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestRegressorF*& forest, float* input, int n_rows,
+                    int n_cols, float* labels, RF_params rf_params,
+                    int max_trees = 0, const float* sample_weight = nullptr);
+void fit_warm_start(const cumlHandle& user_handle,
+                    RandomForestRegressorD*& forest, double* input, int n_rows,
+                    int n_cols, double* labels, RF_params rf_params,
+                    int max_trees = 0, const double* sample_weight = nullptr);
 
 void predict(const cumlHandle& user_handle,
              const RandomForestRegressorF* forest, const float* input,
@@ -17,10 +17,14 @@
 #define omp_get_thread_num() 0
 #endif
 #include "../decisiontree/kernels/quantile.h"
+#include <common/cuml_comms_int.hpp>
+#include <numeric>
+#include <queue>
 #include "../decisiontree/memory.h"
 #include "random/permute.h"
 #include "random/rng.h"
 #include "randomforest_impl.h"
+#include "tree_serialization.h"
 #include "score/scores.h"
 
 namespace ML {
@@ -47,14 +51,31 @@ int rf<T, L>::get_ntrees() {
   return rf_params.n_trees;
 }
 
-void random_uniformInt(int treeid, unsigned int* data, int len, int n_rows,
-                       const int num_sms, cudaStream_t stream) {
-  uint64_t offset = 0;
-  srand(treeid * 1000);
-  MLCommon::Random::randImpl(
-    offset, data, len,
-    [=] __device__(unsigned int val, int idx) { return (val % n_rows); }, 256,
-    4 * num_sms, MLCommon::Random::GeneratorType::GenKiss99, stream);
+// Philox subsequences of the bootstrap samples; the per node column sampler
+// of the level algorithm uses (treeid << 32 | nodeid), below this bit.
+const uint64_t BOOTSTRAP_SUBSEQUENCE = 1ull << 63;
+
+// Draws the bootstrap row ids of a tree: row i is the i-th number of the
+// Philox subsequence of the tree, so the sample only depends on (seed, treeid)
+// and not on the launch configuration.
+__global__ void bootstrap_rows_kernel(unsigned int* rows, const int len,
+                                      const int n_rows, const uint64_t seed,
+                                      const int treeid) {
+  uint64_t subsequence = BOOTSTRAP_SUBSEQUENCE | (unsigned int)treeid;
+  for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < len;
+       i += blockDim.x * gridDim.x) {
+    MLCommon::Random::detail::PhiloxGenerator gen(seed, subsequence, i);
+    uint32_t val;
+    gen.next(val);
+    rows[i] = val % n_rows;
+  }
+}
+
+void random_uniformInt(int treeid, uint64_t seed, unsigned int* data, int len,
+                       int n_rows, const int num_sms, cudaStream_t stream) {
+  bootstrap_rows_kernel<<<4 * num_sms, 256, 0, stream>>>(data, len, n_rows,
+                                                         seed, treeid);
+  CUDA_CHECK(cudaGetLastError());
 }
 /**
  * @brief Sample row IDs for tree fitting and bootstrap if requested.
@@ -78,8 +99,8 @@ void rf<T, L>::prepare_fit_per_tree(
   size_t temp_storage_bytes, const int num_sms, const cudaStream_t stream,
   std::shared_ptr<deviceAllocator> device_allocator) {
   if (rf_params.bootstrap) {
-    random_uniformInt(tree_id, selected_rows, n_sampled_rows, n_rows, num_sms,
-                      stream);
+    random_uniformInt(tree_id, rf_params.seed, selected_rows, n_sampled_rows,
+                      n_rows, num_sms, stream);
 
     if (temp_storage_bytes != 0) {
       CUDA_CHECK(cub::DeviceRadixSort::SortKeys(
@@ -97,8 +118,10 @@ void rf<T, L>::prepare_fit_per_tree(
     thrust::sequence(thrust::cuda::par.on(stream), inkeys->data(),
                      inkeys->data() + n_rows);
     int* perms = nullptr;
+    // Like the bootstrap samples, the permutation only depends on
+    // (seed, treeid)
     MLCommon::Random::permute(perms, outkeys->data(), inkeys->data(), 1, n_rows,
-                              false, stream);
+                              false, rf_params.seed, tree_id, stream);
     // outkeys has more rows than selected_rows; doing the shuffling before the
     // resize to differentiate the per-tree rows sample.
     if (temp_storage_bytes != 0) {
@@ -138,6 +161,274 @@ void rf<T, L>::error_checking(const T* input, L* predictions, int n_rows,
   }
 }
 
+/**
+ * @brief Switch this object to multi-rank fitting over the communicator of
+ *   user_handle. Each rank fits rf_params.n_trees trees on its local rows;
+ *   the counts may differ between ranks. The trees of a rank are numbered
+ *   after the trees of the lower ranks, so that the merged forest has tree
+ *   ids 0 to the total number of trees.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ */
+template <typename T, typename L>
+void rf<T, L>::setup_multi_rank(const cumlHandle& user_handle) {
+  const cumlHandle_impl& handle = user_handle.getImpl();
+  ASSERT(handle.commsInitialized(),
+         "Multi-rank RF fit needs a handle with an initialized communicator");
+  ASSERT(rf_params.tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE &&
+           !rf_params.tree_params.quantile_per_tree,
+         "Multi-rank RF fit needs the GLOBAL_QUANTILE split algorithm with "
+         "quantiles shared by the whole forest\n");
+  multi_rank = true;
+
+  // Exclusive scan of the number of trees of every rank
+  const MLCommon::cumlCommunicator& comm = handle.getCommunicator();
+  cudaStream_t stream = handle.getStream();
+  int nranks = comm.getSize();
+  int rank = comm.getRank();
+  MLCommon::device_buffer<int> d_n_trees(handle.getDeviceAllocator(), stream,
+                                         nranks + 1);
+  MLCommon::updateDevice(d_n_trees.data() + nranks, &rf_params.n_trees, 1,
+                         stream);
+  comm.allgather(d_n_trees.data() + nranks, d_n_trees.data(), 1, stream);
+  std::vector<int> h_n_trees(nranks);
+  MLCommon::updateHost(h_n_trees.data(), d_n_trees.data(), nranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  d_n_trees.release(stream);
+  treeid_offset =
+    std::accumulate(h_n_trees.begin(), h_n_trees.begin() + rank, 0);
+}
+
+/**
+ * @brief Gather the trees fitted by every rank into forest, in rank order, so
+ *   that all the ranks end up with the same merged forest.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ * @param[in, out] forest: local forest in, merged forest out.
+ */
+template <typename T, typename L>
+void rf<T, L>::merge_forest_mg(const cumlHandle& user_handle,
+                               RandomForestMetaData<T, L>*& forest) {
+  const cumlHandle_impl& handle = user_handle.getImpl();
+  const MLCommon::cumlCommunicator& comm = handle.getCommunicator();
+  cudaStream_t stream = handle.getStream();
+  int nranks = comm.getSize();
+  int rank = comm.getRank();
+
+  std::vector<char> h_local;
+  int n_local_trees = rf_params.n_trees;
+  append_bytes(h_local, &n_local_trees, 1);
+  for (int i = 0; i < n_local_trees; i++) {
+    pack_tree(&forest->trees[i], h_local);
+  }
+
+  // Exchange the serialized sizes, then the forests themselves
+  int local_bytes = h_local.size();
+  MLCommon::device_buffer<int> d_bytes(handle.getDeviceAllocator(), stream,
+                                       nranks + 1);
+  MLCommon::updateDevice(d_bytes.data() + nranks, &local_bytes, 1, stream);
+  comm.allgather(d_bytes.data() + nranks, d_bytes.data(), 1, stream);
+  std::vector<int> h_bytes(nranks), displs(nranks);
+  MLCommon::updateHost(h_bytes.data(), d_bytes.data(), nranks, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  int total_bytes = 0;
+  for (int r = 0; r < nranks; r++) {
+    displs[r] = total_bytes;
+    total_bytes += h_bytes[r];
+  }
+
+  MLCommon::device_buffer<char> d_all(handle.getDeviceAllocator(), stream,
+                                      total_bytes + local_bytes);
+  MLCommon::updateDevice(d_all.data() + total_bytes, h_local.data(),
+                         local_bytes, stream);
+  comm.allgatherv<char>(d_all.data() + total_bytes, d_all.data(),
+                        h_bytes.data(), displs.data(), stream);
+  std::vector<char> h_all(total_bytes);
+  MLCommon::updateHost(h_all.data(), d_all.data(), total_bytes, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  d_bytes.release(stream);
+  d_all.release(stream);
+
+  int total_trees = 0;
+  for (int r = 0; r < nranks; r++) {
+    int n_trees;
+    read_bytes(&h_all[displs[r]], &n_trees, 1);
+    total_trees += n_trees;
+  }
+  DecisionTree::TreeMetaDataNode<T, L>* merged =
+    new DecisionTree::TreeMetaDataNode<T, L>[total_trees];
+  int tree_id = 0;
+  for (int r = 0; r < nranks; r++) {
+    int n_trees;
+    const char* buffer = read_bytes(&h_all[displs[r]], &n_trees, 1);
+    for (int i = 0; i < n_trees; i++, tree_id++) {
+      if (r == rank) {
+        // Local trees are kept as they are
+        merged[tree_id] = forest->trees[i];
+      } else {
+        buffer = unpack_tree(buffer, &merged[tree_id]);
+      }
+    }
+  }
+  delete[] forest->trees;
+  forest->trees = merged;
+  forest->flat_forest.reset();
+  forest->rf_params.n_trees = total_trees;
+  forest->n_fitted_trees = total_trees;
+}
+
+/**
+ * @brief Delete the nodes of a tree.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] node: root of the (sub)tree, may be nullptr.
+ */
+template <typename T, typename L>
+void delete_tree_nodes(DecisionTree::TreeNode<T, L>* node) {
+  if (node == nullptr) return;
+  delete_tree_nodes(node->left);
+  delete_tree_nodes(node->right);
+  delete node;
+}
+
+/**
+ * @brief Number of classes of the leaves of a classification tree, 0 if the
+ *   tree is empty.
+ */
+template <typename T>
+int n_leaf_classes(const DecisionTree::TreeMetaDataNode<T, int>* tree) {
+  const DecisionTree::TreeNode<T, int>* node = tree->root;
+  if (node == nullptr) return 0;
+  while (node->left != nullptr) node = node->left;
+  return node->class_probs.size();
+}
+
+/**
+ * @brief Prepare a warm-start fit of new trees for forest: check that the new
+ *   data has the columns of the forest and that the new trees predict the
+ *   same kind of values, reuse the cached quantiles if they were computed
+ *   with the same binning, and number the new trees after all the trees
+ *   fitted so far.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] forest: forest the new trees are added to.
+ * @param[in] n_cols: number of columns of the new data.
+ */
+template <typename T, typename L>
+void rf<T, L>::setup_warm_start(const RandomForestMetaData<T, L>* forest,
+                                int n_cols) {
+  ASSERT(forest->trees != nullptr, "Cannot warm start an empty forest.");
+  ASSERT(forest->n_cols == n_cols,
+         "Warm start on %d columns, the forest was fitted on %d.", n_cols,
+         forest->n_cols);
+  // The criterion sets what the leaves predict (e.g. mean or median)
+  const char* CRITERION_NAME[] = {"GINI", "ENTROPY", "MSE", "MAE", "END"};
+  const DecisionTree::DecisionTreeParams& tree_params = rf_params.tree_params;
+  CRITERION default_criterion =
+    rf_type == RF_type::CLASSIFICATION ? CRITERION::GINI : CRITERION::MSE;
+  auto criterion = [default_criterion](CRITERION c) {
+    return c == CRITERION::CRITERION_END ? default_criterion : c;
+  };
+  CRITERION new_criterion = criterion(tree_params.split_criterion);
+  CRITERION old_criterion =
+    criterion(forest->rf_params.tree_params.split_criterion);
+  ASSERT(new_criterion == old_criterion,
+         "Warm start with the %s criterion, the forest was fitted with %s.",
+         CRITERION_NAME[new_criterion], CRITERION_NAME[old_criterion]);
+  reuse_quantiles =
+    tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE &&
+    !tree_params.quantile_per_tree &&
+    forest->quantiles.size() == (size_t)tree_params.n_bins * n_cols;
+  // Forests fitted before the count was kept used ids [0, n_trees)
+  treeid_offset = std::max(forest->n_fitted_trees, forest->rf_params.n_trees);
+}
+
+/**
+ * @brief Append the trees of new_trees to forest, then drop the oldest trees
+ *   of forest so that at most max_trees remain. new_trees is left empty.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in, out] forest: forest to extend.
+ * @param[in, out] new_trees: newly fitted trees, with their quantiles.
+ * @param[in] max_trees: maximum number of trees to keep, 0 for no limit.
+ */
+template <typename T, typename L>
+void rf<T, L>::append_trees(RandomForestMetaData<T, L>* forest,
+                            RandomForestMetaData<T, L>* new_trees,
+                            int max_trees) {
+  int n_old = forest->rf_params.n_trees;
+  int n_new = new_trees->rf_params.n_trees;
+  int n_drop = max_trees > 0 ? std::max(0, n_old + n_new - max_trees) : 0;
+  DecisionTree::TreeMetaDataNode<T, L>* merged =
+    new DecisionTree::TreeMetaDataNode<T, L>[n_old + n_new - n_drop];
+  for (int i = 0; i < n_drop; i++) {
+    delete_tree_nodes(forest->trees[i].root);
+  }
+  for (int i = n_drop; i < n_old; i++) {
+    merged[i - n_drop] = forest->trees[i];
+  }
+  for (int i = 0; i < n_new; i++) {
+    merged[n_old - n_drop + i] = new_trees->trees[i];
+  }
+  delete[] forest->trees;
+  delete[] new_trees->trees;
+  new_trees->trees = nullptr;
+  forest->trees = merged;
+  forest->flat_forest.reset();
+  // The forest takes the parameters of the last fit
+  forest->rf_params = rf_params;
+  forest->rf_params.n_trees = n_old + n_new - n_drop;
+  forest->quantiles.swap(new_trees->quantiles);
+  forest->n_cols = new_trees->n_cols;
+  forest->n_fitted_trees = new_trees->n_fitted_trees;
+}
+
+/**
+ * @brief Set the quantiles shared by the whole forest up in the temporary
+ *   memory of every stream, and cache them in forest: they are either reused
+ *   from forest for a warm start, or computed on input (over all the ranks
+ *   for a multi-rank fit).
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] input: train data, column major. Device pointer.
+ * @param[in] n_rows: number of training data samples.
+ * @param[in] n_cols: number of features.
+ * @param[in, out] tempmem: temporary memory of the rf_params.n_streams streams.
+ * @param[in, out] forest: forest being fitted.
+ */
+template <typename T, typename L>
+void rf<T, L>::forest_quantiles(const T* input, int n_rows, int n_cols,
+                                std::shared_ptr<TemporaryMemory<T, L>>* tempmem,
+                                RandomForestMetaData<T, L>* forest) {
+  int n_bins = rf_params.tree_params.n_bins;
+  size_t n_quantiles = (size_t)n_bins * n_cols;
+  if (reuse_quantiles) {
+    memcpy((void*)(tempmem[0]->h_quantile->data()),
+           (void*)(forest->quantiles.data()), n_quantiles * sizeof(T));
+    MLCommon::updateDevice(tempmem[0]->d_quantile->data(),
+                           tempmem[0]->h_quantile->data(), n_quantiles,
+                           tempmem[0]->stream);
+  } else if (multi_rank) {
+    preprocess_quantile_mg(input, n_rows, n_cols, n_bins, tempmem[0]);
+  } else {
+    preprocess_quantile(input, nullptr, n_rows, n_cols, n_rows, n_bins,
+                        tempmem[0]);
+  }
+  // h_quantile is filled asynchronously
+  CUDA_CHECK(cudaStreamSynchronize(tempmem[0]->stream));
+  for (int i = 1; i < rf_params.n_streams; i++) {
+    CUDA_CHECK(cudaMemcpyAsync(
+      tempmem[i]->d_quantile->data(), tempmem[0]->d_quantile->data(),
+      n_quantiles * sizeof(T), cudaMemcpyDeviceToDevice, tempmem[i]->stream));
+    memcpy((void*)(tempmem[i]->h_quantile->data()),
+           (void*)(tempmem[0]->h_quantile->data()), n_quantiles * sizeof(T));
+  }
+  const T* h_quantile = tempmem[0]->h_quantile->data();
+  forest->quantiles.assign(h_quantile, h_quantile + n_quantiles);
+}
+
 /**
  * @brief Construct rfClassifier object.
  * @tparam T: data type for input data (float or double).
@@ -181,13 +472,24 @@ const DecisionTree::DecisionTreeClassifier<T>* rfClassifier<T>::get_trees_ptr()
 				  needed for current gini impl in decision tree
  * @param[in] n_unique_labels: #unique label values (known during preprocessing)
  * @param[in] forest: CPU point to RandomForestMetaData struct.
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels), multiplied
+ *   with the sample weights. Device pointer.
  */
 template <typename T>
 void rfClassifier<T>::fit(const cumlHandle& user_handle, const T* input,
                           int n_rows, int n_cols, int* labels,
                           int n_unique_labels,
-                          RandomForestMetaData<T, int>*& forest) {
+                          RandomForestMetaData<T, int>*& forest,
+                          const T* sample_weight, const T* class_weight) {
   this->error_checking(input, labels, n_rows, n_cols, false);
+  forest->flat_forest.reset();
+  bool weighted = (sample_weight != nullptr) || (class_weight != nullptr);
+  ASSERT(
+    !weighted ||
+      this->rf_params.tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE,
+    "Sample and class weights are only supported by the GLOBAL_QUANTILE "
+    "split algorithm\n");
 
   int n_sampled_rows = this->rf_params.rows_sample * n_rows;
   int n_streams = this->rf_params.n_streams;
@@ -235,22 +537,12 @@ void rfClassifier<T>::fit(const cumlHandle& user_handle, const T* input,
       local_handle[i].getImpl(), n_rows, n_cols, n_unique_labels,
       this->rf_params.tree_params.n_bins,
       this->rf_params.tree_params.split_algo,
-      this->rf_params.tree_params.max_depth);
+      this->rf_params.tree_params.max_depth, weighted);
   }
   //Preprocess once only per forest
   if ((this->rf_params.tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE) &&
       !(this->rf_params.tree_params.quantile_per_tree)) {
-    preprocess_quantile(input, nullptr, n_rows, n_cols, n_rows,
-                        this->rf_params.tree_params.n_bins, tempmem[0]);
-    for (int i = 1; i < n_streams; i++) {
-      CUDA_CHECK(cudaMemcpyAsync(
-        tempmem[i]->d_quantile->data(), tempmem[0]->d_quantile->data(),
-        this->rf_params.tree_params.n_bins * n_cols * sizeof(T),
-        cudaMemcpyDeviceToDevice, tempmem[i]->stream));
-      memcpy((void*)(tempmem[i]->h_quantile->data()),
-             (void*)(tempmem[0]->h_quantile->data()),
-             this->rf_params.tree_params.n_bins * n_cols * sizeof(T));
-    }
+    this->forest_quantiles(input, n_rows, n_cols, tempmem, forest);
   }
 
 #pragma omp parallel for num_threads(n_streams)
@@ -266,9 +558,10 @@ void rfClassifier<T>::fit(const cumlHandle& user_handle, const T* input,
     } else {
       rowids = selected_rows[stream_id]->data();
     }
+    int treeid = this->treeid_offset + i;
     this->prepare_fit_per_tree(
-      i, n_rows, n_sampled_rows, selected_rows[stream_id]->data(), selected_ptr,
-      temp_storage_ptr, temp_storage_bytes[stream_id],
+      treeid, n_rows, n_sampled_rows, selected_rows[stream_id]->data(),
+      selected_ptr, temp_storage_ptr, temp_storage_bytes[stream_id],
       tempmem[stream_id]->num_sms, local_handle[stream_id].getStream(),
       local_handle[stream_id].getDeviceAllocator());
 
@@ -283,8 +576,11 @@ void rfClassifier<T>::fit(const cumlHandle& user_handle, const T* input,
     DecisionTree::TreeMetaDataNode<T, int>* tree_ptr = &(forest->trees[i]);
     trees[i].fit(local_handle[stream_id], input, n_cols, n_rows, labels, rowids,
                  n_sampled_rows, n_unique_labels, tree_ptr,
-                 this->rf_params.tree_params, tempmem[stream_id]);
+                 this->rf_params.tree_params, tempmem[stream_id],
+                 this->rf_params.seed, treeid, sample_weight, class_weight);
   }
+  forest->n_fitted_trees = this->treeid_offset + this->rf_params.n_trees;
+  forest->n_cols = n_cols;
   //Cleanup
   for (int i = 0; i < n_streams; i++) {
     selected_rows[i]->release(stream);
@@ -307,6 +603,81 @@ void rfClassifier<T>::fit(const cumlHandle& user_handle, const T* input,
   CUDA_CHECK(cudaStreamSynchronize(user_handle.getStream()));
 }
 
+/**
+ * @brief Multi-rank fit: fit rf_params.n_trees trees on the local rows with
+ *   quantiles computed over all the ranks, then merge the trees of all the
+ *   ranks into forest.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ * @param[in] input: local train data (n_local_rows samples, n_cols features) in
+ *   column major format. Device pointer.
+ * @param[in] n_local_rows: number of training data samples on this rank.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: n_local_rows labels, mapped to [0, n_unique_labels) consistently
+ *   on all the ranks. Device pointer.
+ * @param[in] n_unique_labels: #unique label values over all the ranks.
+ * @param[in, out] forest: CPU point to RandomForestMetaData struct.
+ * @param[in] sample_weight: optional per sample weights (n_local_rows). Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels). Device pointer.
+ */
+template <typename T>
+void rfClassifier<T>::fit_mg(const cumlHandle& user_handle, const T* input,
+                             int n_local_rows, int n_cols, int* labels,
+                             int n_unique_labels,
+                             RandomForestMetaData<T, int>*& forest,
+                             const T* sample_weight, const T* class_weight) {
+  this->setup_multi_rank(user_handle);
+  fit(user_handle, input, n_local_rows, n_cols, labels, n_unique_labels, forest,
+      sample_weight, class_weight);
+  this->merge_forest_mg(user_handle, forest);
+}
+
+/**
+ * @brief Warm-start fit: fit rf_params.n_trees new trees, numbered after the
+ *   trees already fitted for forest and reusing its cached quantiles when the
+ *   binning matches, append them to forest and drop its oldest trees beyond
+ *   max_trees.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] user_handle: cumlHandle
+ * @param[in] input: new train data (n_rows samples, n_cols features) in column
+ *   major format. Device pointer.
+ * @param[in] n_rows: number of new training data samples.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: n_rows labels, mapped to [0, n_unique_labels) as for the
+ *   existing trees. Device pointer.
+ * @param[in] n_unique_labels: #unique label values of the forest.
+ * @param[in, out] forest: CPU pointer to a fitted RandomForestMetaData struct.
+ * @param[in] max_trees: maximum number of trees kept, 0 for no limit.
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
+ * @param[in] class_weight: optional per class weights (n_unique_labels). Device pointer.
+ */
+template <typename T>
+void rfClassifier<T>::fit_warm_start(const cumlHandle& user_handle,
+                                     const T* input, int n_rows, int n_cols,
+                                     int* labels, int n_unique_labels,
+                                     RandomForestMetaData<T, int>*& forest,
+                                     int max_trees, const T* sample_weight,
+                                     const T* class_weight) {
+  this->setup_warm_start(forest, n_cols);
+  int n_classes = n_leaf_classes(&forest->trees[0]);
+  ASSERT(n_classes == 0 || n_classes == n_unique_labels,
+         "Warm start with %d classes, the forest has %d", n_unique_labels,
+         n_classes);
+  RandomForestMetaData<T, int> new_trees;
+  new_trees.rf_params = this->rf_params;
+  new_trees.trees =
+    new DecisionTree::TreeMetaDataNode<T, int>[this->rf_params.n_trees];
+  for (int i = 0; i < this->rf_params.n_trees; i++) {
+    new_trees.trees[i].root = nullptr;
+  }
+  new_trees.quantiles = forest->quantiles;
+  new_trees.n_cols = forest->n_cols;
+  RandomForestMetaData<T, int>* new_trees_ptr = &new_trees;
+  fit(user_handle, input, n_rows, n_cols, labels, n_unique_labels,
+      new_trees_ptr, sample_weight, class_weight);
+  this->append_trees(forest, &new_trees, max_trees);
+}
+
 /**
  * @brief Predict target feature for input data; n-ary classification for single feature supported.
  * @tparam T: data type for input data (float or double).
@@ -418,6 +789,199 @@ void rfClassifier<T>::predictGetAll(const cumlHandle& user_handle,
   CUDA_CHECK(cudaStreamSynchronize(stream));
 }
 
+/* Node of a classification forest flattened for device traversal. The right
+   child of an internal node is stored at left_child_id + 1. Leaves have
+   colid -1 and left_child_id is the offset of their class distribution. */
+template <typename T>
+struct FlatTreeNode {
+  int colid;
+  T quesval;
+  int left_child_id;
+};
+
+/**
+ * @brief Flatten the trees of a classification forest breadth first, so that
+ *   siblings are adjacent, and gather the leaf class distributions.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] forest: CPU pointer to a fitted RandomForestMetaData object.
+ * @param[in] n_unique_labels: number of classes the forest was fitted on.
+ * @param[out] nodes: flattened nodes of all the trees.
+ * @param[out] roots: index of the root of every tree in nodes.
+ * @param[out] leaf_probs: n_unique_labels probabilities per leaf.
+ */
+template <typename T>
+void flatten_forest(const RandomForestMetaData<T, int>* forest,
+                    int n_unique_labels, std::vector<FlatTreeNode<T>>& nodes,
+                    std::vector<int>& roots, std::vector<float>& leaf_probs) {
+  typedef std::pair<const DecisionTree::TreeNode<T, int>*, int> NodeId;
+  for (int i = 0; i < forest->rf_params.n_trees; i++) {
+    ASSERT(forest->trees[i].root != nullptr, "Cannot predict w/ empty tree!");
+    std::queue<NodeId> node_queue;
+    roots.push_back(nodes.size());
+    node_queue.push(NodeId(forest->trees[i].root, nodes.size()));
+    nodes.resize(nodes.size() + 1);
+
+    while (!node_queue.empty()) {
+      const DecisionTree::TreeNode<T, int>* node = node_queue.front().first;
+      int flat_id = node_queue.front().second;
+      node_queue.pop();
+      FlatTreeNode<T> flat;
+      if (node->left == nullptr && node->right == nullptr) {
+        ASSERT(node->class_probs.size() == n_unique_labels,
+               "Leaf class distribution has %d classes, expected %d",
+               (int)node->class_probs.size(), n_unique_labels);
+        flat.colid = -1;
+        flat.quesval = 0;
+        flat.left_child_id = leaf_probs.size();
+        leaf_probs.insert(leaf_probs.end(), node->class_probs.begin(),
+                          node->class_probs.end());
+      } else {
+        flat.colid = node->question.column;
+        flat.quesval = node->question.value;
+        flat.left_child_id = nodes.size();
+        node_queue.push(NodeId(node->left, nodes.size()));
+        node_queue.push(NodeId(node->right, nodes.size() + 1));
+        nodes.resize(nodes.size() + 2);
+      }
+      nodes[flat_id] = flat;
+    }
+  }
+}
+
+/* Device copy of a flattened classification forest, cached on the forest.
+   trees, n_trees and n_classes identify the forest it was built from. The
+   buffers belong to the default stream, which outlives the streams of the
+   handles the forest is used with. */
+template <typename T>
+struct FlatForest {
+  FlatForest(std::shared_ptr<deviceAllocator> allocator, size_t n_nodes,
+             size_t n_roots, size_t n_leaf_probs)
+    : nodes(allocator, 0, n_nodes),
+      roots(allocator, 0, n_roots),
+      leaf_probs(allocator, 0, n_leaf_probs) {}
+
+  const DecisionTree::TreeMetaDataNode<T, int>* trees = nullptr;
+  int n_trees = 0;
+  int n_classes = 0;
+  MLCommon::device_buffer<FlatTreeNode<T>> nodes;
+  MLCommon::device_buffer<int> roots;
+  MLCommon::device_buffer<float> leaf_probs;
+};
+
+/**
+ * @brief Return the device copy of the flattened forest cached on forest,
+ *   building it first if there is none or it was built for other trees.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] forest: CPU pointer to a fitted RandomForestMetaData object.
+ * @param[in] n_unique_labels: number of classes the forest was fitted on.
+ * @param[in] handle: cumlHandle_impl providing the device allocator.
+ * @param[in] stream: stream the copies are issued on.
+ */
+template <typename T>
+std::shared_ptr<FlatForest<T>> get_flat_forest(
+  const RandomForestMetaData<T, int>* forest, int n_unique_labels,
+  const cumlHandle_impl& handle, cudaStream_t stream) {
+  std::shared_ptr<FlatForest<T>> flat = std::atomic_load(&forest->flat_forest);
+  if (flat != nullptr && flat->trees == forest->trees &&
+      flat->n_trees == forest->rf_params.n_trees &&
+      flat->n_classes == n_unique_labels) {
+    return flat;
+  }
+
+  std::vector<FlatTreeNode<T>> h_nodes;
+  std::vector<int> h_roots;
+  std::vector<float> h_leaf_probs;
+  flatten_forest(forest, n_unique_labels, h_nodes, h_roots, h_leaf_probs);
+
+  flat = std::make_shared<FlatForest<T>>(handle.getDeviceAllocator(),
+                                         h_nodes.size(), h_roots.size(),
+                                         h_leaf_probs.size());
+  flat->trees = forest->trees;
+  flat->n_trees = forest->rf_params.n_trees;
+  flat->n_classes = n_unique_labels;
+  MLCommon::updateDevice(flat->nodes.data(), h_nodes.data(), h_nodes.size(),
+                         stream);
+  MLCommon::updateDevice(flat->roots.data(), h_roots.data(), h_roots.size(),
+                         stream);
+  MLCommon::updateDevice(flat->leaf_probs.data(), h_leaf_probs.data(),
+                         h_leaf_probs.size(), stream);
+  // Host vectors are read by the asynchronous copies above
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  // Concurrent calls may both build a copy; either one is kept
+  std::atomic_store(&forest->flat_forest, flat);
+  return flat;
+}
+
+/* One thread per row: walks every tree of the flattened forest and averages
+   the class distributions of the leaves reached. */
+template <typename T>
+__global__ void predict_proba_kernel(const T* input, const int n_rows,
+                                     const int n_cols,
+                                     const FlatTreeNode<T>* nodes,
+                                     const int* roots, const int n_trees,
+                                     const float* leaf_probs,
+                                     const int n_classes, T* probs) {
+  int row = threadIdx.x + blockIdx.x * blockDim.x;
+  if (row >= n_rows) return;
+  const T* x = input + (size_t)row * n_cols;
+  T* out = probs + (size_t)row * n_classes;
+  for (int j = 0; j < n_classes; j++) out[j] = 0;
+
+  for (int i = 0; i < n_trees; i++) {
+    FlatTreeNode<T> node = nodes[roots[i]];
+    while (node.colid != -1) {
+      int next = node.left_child_id + (x[node.colid] > node.quesval ? 1 : 0);
+      node = nodes[next];
+    }
+    const float* leaf = leaf_probs + node.left_child_id;
+    for (int j = 0; j < n_classes; j++) out[j] += leaf[j];
+  }
+
+  T scale = T(1) / n_trees;
+  for (int j = 0; j < n_classes; j++) out[j] *= scale;
+}
+
+/**
+ * @brief Predict class probabilities for input data, averaging the leaf class
+ *   distributions of all the trees. Runs entirely on the device; the
+ *   flattened trees are uploaded by the first call and cached on the forest.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] user_handle: cumlHandle.
+ * @param[in] input: test data (n_rows samples, n_cols features) in row major format. GPU pointer.
+ * @param[in] n_rows: number of  data samples.
+ * @param[in] n_cols: number of features (excluding target feature).
+ * @param[in] n_unique_labels: number of classes the forest was fitted on.
+ * @param[in, out] probs: n_rows x n_unique_labels class probabilities in row major format.
+ *   GPU pointer, user allocated.
+ */
+template <typename T>
+void rfClassifier<T>::predict_proba(
+  const cumlHandle& user_handle, const T* input, int n_rows, int n_cols,
+  int n_unique_labels, T* probs,
+  const RandomForestMetaData<T, int>* forest) const {
+  ASSERT(probs != nullptr,
+         "Error! User has not allocated memory for probabilities.");
+  ASSERT((n_rows > 0), "Invalid n_rows %d", n_rows);
+  ASSERT((n_cols > 0), "Invalid n_cols %d", n_cols);
+  ASSERT((n_unique_labels > 0), "Invalid n_unique_labels %d",
+         n_unique_labels);
+  ASSERT(is_dev_ptr(input) && is_dev_ptr(probs),
+         "RF Error: Expected both input and probabilities to be GPU pointers");
+
+  const cumlHandle_impl& handle = user_handle.getImpl();
+  cudaStream_t stream = handle.getStream();
+
+  std::shared_ptr<FlatForest<T>> flat =
+    get_flat_forest(forest, n_unique_labels, handle, stream);
+
+  int threads = 128;
+  int blocks = MLCommon::ceildiv(n_rows, threads);
+  predict_proba_kernel<<<blocks, threads, 0, stream>>>(
+    input, n_rows, n_cols, flat->nodes.data(), flat->roots.data(),
+    flat->n_trees, flat->leaf_probs.data(), n_unique_labels, probs);
+  CUDA_CHECK(cudaGetLastError());
+}
+
 /**
  * @brief Predict target feature for input data and validate against ref_labels.
  * @tparam T: data type for input data (float or double).
@@ -489,12 +1053,20 @@ const DecisionTree::DecisionTreeRegressor<T>* rfRegressor<T>::get_trees_ptr()
  * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
  * @param[in] labels: 1D array of target features (float or double), with one label per training sample. Device pointer.
  * @param[in, out] forest: CPU pointer to RandomForestMetaData struct
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
  */
 template <typename T>
 void rfRegressor<T>::fit(const cumlHandle& user_handle, const T* input,
                          int n_rows, int n_cols, T* labels,
-                         RandomForestMetaData<T, T>*& forest) {
+                         RandomForestMetaData<T, T>*& forest,
+                         const T* sample_weight) {
   this->error_checking(input, labels, n_rows, n_cols, false);
+  bool weighted = (sample_weight != nullptr);
+  ASSERT(
+    !weighted ||
+      this->rf_params.tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE,
+    "Sample weights are only supported by the GLOBAL_QUANTILE split "
+    "algorithm\n");
 
   int n_sampled_rows = this->rf_params.rows_sample * n_rows;
   int n_streams = this->rf_params.n_streams;
@@ -543,22 +1115,12 @@ void rfRegressor<T>::fit(const cumlHandle& user_handle, const T* input,
       local_handle[i].getImpl(), n_rows, n_cols, 1,
       this->rf_params.tree_params.n_bins,
       this->rf_params.tree_params.split_algo,
-      this->rf_params.tree_params.max_depth);
+      this->rf_params.tree_params.max_depth, weighted);
   }
   //Preprocess once only per forest
   if ((this->rf_params.tree_params.split_algo == SPLIT_ALGO::GLOBAL_QUANTILE) &&
       !(this->rf_params.tree_params.quantile_per_tree)) {
-    preprocess_quantile(input, nullptr, n_rows, n_cols, n_rows,
-                        this->rf_params.tree_params.n_bins, tempmem[0]);
-    for (int i = 1; i < n_streams; i++) {
-      CUDA_CHECK(cudaMemcpyAsync(
-        tempmem[i]->d_quantile->data(), tempmem[0]->d_quantile->data(),
-        this->rf_params.tree_params.n_bins * n_cols * sizeof(T),
-        cudaMemcpyDeviceToDevice, tempmem[i]->stream));
-      memcpy((void*)(tempmem[i]->h_quantile->data()),
-             (void*)(tempmem[0]->h_quantile->data()),
-             this->rf_params.tree_params.n_bins * n_cols * sizeof(T));
-    }
+    this->forest_quantiles(input, n_rows, n_cols, tempmem, forest);
   }
 
 #pragma omp parallel for num_threads(n_streams)
@@ -574,9 +1136,10 @@ void rfRegressor<T>::fit(const cumlHandle& user_handle, const T* input,
     } else {
       rowids = selected_rows[stream_id]->data();
     }
+    int treeid = this->treeid_offset + i;
     this->prepare_fit_per_tree(
-      i, n_rows, n_sampled_rows, selected_rows[stream_id]->data(), selected_ptr,
-      temp_storage_ptr, temp_storage_bytes[stream_id],
+      treeid, n_rows, n_sampled_rows, selected_rows[stream_id]->data(),
+      selected_ptr, temp_storage_ptr, temp_storage_bytes[stream_id],
       tempmem[stream_id]->num_sms, local_handle[stream_id].getStream(),
       local_handle[stream_id].getDeviceAllocator());
 
@@ -590,8 +1153,11 @@ void rfRegressor<T>::fit(const cumlHandle& user_handle, const T* input,
     DecisionTree::TreeMetaDataNode<T, T>* tree_ptr = &(forest->trees[i]);
     trees[i].fit(local_handle[stream_id], input, n_cols, n_rows, labels, rowids,
                  n_sampled_rows, tree_ptr, this->rf_params.tree_params,
-                 tempmem[stream_id]);
+                 tempmem[stream_id], this->rf_params.seed, treeid,
+                 sample_weight);
   }
+  forest->n_fitted_trees = this->treeid_offset + this->rf_params.n_trees;
+  forest->n_cols = n_cols;
   //Cleanup
   for (int i = 0; i < n_streams; i++) {
     selected_rows[i]->release(stream);
@@ -614,6 +1180,68 @@ void rfRegressor<T>::fit(const cumlHandle& user_handle, const T* input,
   CUDA_CHECK(cudaStreamSynchronize(user_handle.getStream()));
 }
 
+/**
+ * @brief Multi-rank fit: fit rf_params.n_trees trees on the local rows with
+ *   quantiles computed over all the ranks, then merge the trees of all the
+ *   ranks into forest.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] user_handle: cumlHandle with an initialized communicator.
+ * @param[in] input: local train data (n_local_rows samples, n_cols features) in
+ *   column major format. Device pointer.
+ * @param[in] n_local_rows: number of training data samples on this rank.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: n_local_rows target values. Device pointer.
+ * @param[in, out] forest: CPU point to RandomForestMetaData struct.
+ * @param[in] sample_weight: optional per sample weights (n_local_rows). Device pointer.
+ */
+template <typename T>
+void rfRegressor<T>::fit_mg(const cumlHandle& user_handle, const T* input,
+                            int n_local_rows, int n_cols, T* labels,
+                            RandomForestMetaData<T, T>*& forest,
+                            const T* sample_weight) {
+  this->setup_multi_rank(user_handle);
+  fit(user_handle, input, n_local_rows, n_cols, labels, forest, sample_weight);
+  this->merge_forest_mg(user_handle, forest);
+}
+
+/**
+ * @brief Warm-start fit: fit rf_params.n_trees new trees, numbered after the
+ *   trees already fitted for forest and reusing its cached quantiles when the
+ *   binning matches, append them to forest and drop its oldest trees beyond
+ *   max_trees.
+ * @tparam T: data type for input data (float or double).
+ * @param[in] user_handle: cumlHandle
+ * @param[in] input: new train data (n_rows samples, n_cols features) in column
+ *   major format. Device pointer.
+ * @param[in] n_rows: number of new training data samples.
+ * @param[in] n_cols: number of features (i.e., columns) excluding target feature.
+ * @param[in] labels: n_rows target values. Device pointer.
+ * @param[in, out] forest: CPU pointer to a fitted RandomForestMetaData struct.
+ * @param[in] max_trees: maximum number of trees kept, 0 for no limit.
+ * @param[in] sample_weight: optional per sample weights (n_rows). Device pointer.
+ */
+template <typename T>
+void rfRegressor<T>::fit_warm_start(const cumlHandle& user_handle,
+                                    const T* input, int n_rows, int n_cols,
+                                    T* labels,
+                                    RandomForestMetaData<T, T>*& forest,
+                                    int max_trees, const T* sample_weight) {
+  this->setup_warm_start(forest, n_cols);
+  RandomForestMetaData<T, T> new_trees;
+  new_trees.rf_params = this->rf_params;
+  new_trees.trees =
+    new DecisionTree::TreeMetaDataNode<T, T>[this->rf_params.n_trees];
+  for (int i = 0; i < this->rf_params.n_trees; i++) {
+    new_trees.trees[i].root = nullptr;
+  }
+  new_trees.quantiles = forest->quantiles;
+  new_trees.n_cols = forest->n_cols;
+  RandomForestMetaData<T, T>* new_trees_ptr = &new_trees;
+  fit(user_handle, input, n_rows, n_cols, labels, new_trees_ptr,
+      sample_weight);
+  this->append_trees(forest, &new_trees, max_trees);
+}
+
 /**
  * @brief Predict target feature for input data; regression for single feature supported.
  * @tparam T: data type for input data (float or double).
@@ -38,6 +38,25 @@ class rf {
   void error_checking(const T* input, L* predictions, int n_rows, int n_cols,
                       bool is_predict) const;
 
+  // Multi-rank fit state: quantiles are merged over the handle's
+  // communicator and tree ids are offset by the exclusive scan of the
+  // per-rank tree counts.
+  bool multi_rank = false;
+  int treeid_offset = 0;
+  void setup_multi_rank(const cumlHandle& user_handle);
+  void merge_forest_mg(const cumlHandle& user_handle,
+                       RandomForestMetaData<T, L>*& forest);
+
+  // Warm-start fit state: the quantiles cached in the forest are reused
+  // and tree ids are offset by the number of trees fitted so far.
+  bool reuse_quantiles = false;
+  void setup_warm_start(const RandomForestMetaData<T, L>* forest, int n_cols);
+  void append_trees(RandomForestMetaData<T, L>* forest,
+                    RandomForestMetaData<T, L>* new_trees, int max_trees);
+  void forest_quantiles(const T* input, int n_rows, int n_cols,
+                        std::shared_ptr<TemporaryMemory<T, L>>* tempmem,
+                        RandomForestMetaData<T, L>* forest);
+
  public:
   rf(RF_params cfg_rf_params, int cfg_rf_type = RF_type::CLASSIFICATION);
 
@@ -56,7 +75,18 @@ class rfClassifier : public rf<T, int> {
 
   void fit(const cumlHandle& user_handle, const T* input, int n_rows,
            int n_cols, int* labels, int n_unique_labels,
-           RandomForestMetaData<T, int>*& forest);
+           RandomForestMetaData<T, int>*& forest,
+           const T* sample_weight = nullptr, const T* class_weight = nullptr);
+  void fit_mg(const cumlHandle& user_handle, const T* input, int n_local_rows,
+              int n_cols, int* labels, int n_unique_labels,
+              RandomForestMetaData<T, int>*& forest,
+              const T* sample_weight = nullptr,
+              const T* class_weight = nullptr);
+  void fit_warm_start(const cumlHandle& user_handle, const T* input,
+                      int n_rows, int n_cols, int* labels, int n_unique_labels,
+                      RandomForestMetaData<T, int>*& forest, int max_trees,
+                      const T* sample_weight = nullptr,
+                      const T* class_weight = nullptr);
   void predict(const cumlHandle& user_handle, const T* input, int n_rows,
                int n_cols, int* predictions,
                const RandomForestMetaData<T, int>* forest,
@@ -65,6 +95,9 @@ class rfClassifier : public rf<T, int> {
                      int n_cols, int* predictions,
                      const RandomForestMetaData<T, int>* forest,
                      bool verbose = false);
+  void predict_proba(const cumlHandle& user_handle, const T* input, int n_rows,
+                     int n_cols, int n_unique_labels, T* probs,
+                     const RandomForestMetaData<T, int>* forest) const;
   RF_metrics score(const cumlHandle& user_handle, const T* input,
                    const int* ref_labels, int n_rows, int n_cols,
                    int* predictions, const RandomForestMetaData<T, int>* forest,
@@ -82,7 +115,15 @@ class rfRegressor : public rf<T, T> {
   ~rfRegressor();
 
   void fit(const cumlHandle& user_handle, const T* input, int n_rows,
-           int n_cols, T* labels, RandomForestMetaData<T, T>*& forest);
+           int n_cols, T* labels, RandomForestMetaData<T, T>*& forest,
+           const T* sample_weight = nullptr);
+  void fit_mg(const cumlHandle& user_handle, const T* input, int n_local_rows,
+              int n_cols, T* labels, RandomForestMetaData<T, T>*& forest,
+              const T* sample_weight = nullptr);
+  void fit_warm_start(const cumlHandle& user_handle, const T* input,
+                      int n_rows, int n_cols, T* labels,
+                      RandomForestMetaData<T, T>*& forest, int max_trees,
+                      const T* sample_weight = nullptr);
   void predict(const cumlHandle& user_handle, const T* input, int n_rows,
                int n_cols, T* predictions,
                const RandomForestMetaData<T, T>* forest,
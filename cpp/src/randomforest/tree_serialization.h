@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+#include <cstring>
+#include <queue>
+#include <vector>
+#include "decisiontree/decisiontree.hpp"
+
+namespace ML {
+
+/* Serialized tree node exchanged between ranks; the right child of an
+   internal node is at left_child_id + 1. */
+template <typename T, typename L>
+struct PackedTreeNode {
+  int colid;
+  int left_child_id;
+  int n_class_probs;
+  T quesval;
+  T split_metric_val;
+  L prediction;
+};
+
+template <typename V>
+void append_bytes(std::vector<char>& buffer, const V* data, int n) {
+  const char* bytes = reinterpret_cast<const char*>(data);
+  buffer.insert(buffer.end(), bytes, bytes + n * sizeof(V));
+}
+
+template <typename V>
+const char* read_bytes(const char* buffer, V* data, int n) {
+  memcpy((void*)data, buffer, n * sizeof(V));
+  return buffer + n * sizeof(V);
+}
+
+/**
+ * @brief Append a tree, nodes in breadth first order, to a byte buffer.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] tree: tree to serialize.
+ * @param[in, out] buffer: host byte buffer to append to.
+ */
+template <typename T, typename L>
+void pack_tree(const DecisionTree::TreeMetaDataNode<T, L>* tree,
+               std::vector<char>& buffer) {
+  std::vector<PackedTreeNode<T, L>> nodes;
+  std::vector<float> class_probs;
+  std::queue<const DecisionTree::TreeNode<T, L>*> node_queue;
+  node_queue.push(tree->root);
+  while (!node_queue.empty()) {
+    const DecisionTree::TreeNode<T, L>* node = node_queue.front();
+    node_queue.pop();
+    PackedTreeNode<T, L> packed;
+    packed.quesval = node->question.value;
+    packed.split_metric_val = node->split_metric_val;
+    packed.prediction = node->prediction;
+    packed.n_class_probs = node->class_probs.size();
+    class_probs.insert(class_probs.end(), node->class_probs.begin(),
+                       node->class_probs.end());
+    if (node->left == nullptr && node->right == nullptr) {
+      packed.colid = -1;
+      packed.left_child_id = -1;
+    } else {
+      packed.colid = node->question.column;
+      // Children get the next two ids after the nodes already queued
+      packed.left_child_id = nodes.size() + node_queue.size() + 1;
+      node_queue.push(node->left);
+      node_queue.push(node->right);
+    }
+    nodes.push_back(packed);
+  }
+  int header[4] = {(int)nodes.size(), (int)class_probs.size(),
+                   tree->depth_counter, tree->leaf_counter};
+  append_bytes(buffer, header, 4);
+  append_bytes(buffer, &tree->prepare_time, 1);
+  append_bytes(buffer, &tree->train_time, 1);
+  append_bytes(buffer, nodes.data(), nodes.size());
+  append_bytes(buffer, class_probs.data(), class_probs.size());
+}
+
+/**
+ * @brief Rebuild a tree serialized by pack_tree.
+ * @tparam T: data type for input data (float or double).
+ * @tparam L: data type for labels (int type for classification, T type for regression).
+ * @param[in] buffer: start of the serialized tree.
+ * @param[out] tree: tree to populate.
+ * @return pointer past the serialized tree.
+ */
+template <typename T, typename L>
+const char* unpack_tree(const char* buffer,
+                        DecisionTree::TreeMetaDataNode<T, L>* tree) {
+  int header[4];
+  buffer = read_bytes(buffer, header, 4);
+  tree->depth_counter = header[2];
+  tree->leaf_counter = header[3];
+  buffer = read_bytes(buffer, &tree->prepare_time, 1);
+  buffer = read_bytes(buffer, &tree->train_time, 1);
+  std::vector<PackedTreeNode<T, L>> nodes(header[0]);
+  std::vector<float> class_probs(header[1]);
+  buffer = read_bytes(buffer, nodes.data(), header[0]);
+  buffer = read_bytes(buffer, class_probs.data(), header[1]);
+
+  std::vector<DecisionTree::TreeNode<T, L>*> ptrs(nodes.size());
+  for (int i = 0; i < nodes.size(); i++) {
+    ptrs[i] = new DecisionTree::TreeNode<T, L>();
+  }
+  int probs_offset = 0;
+  for (int i = 0; i < nodes.size(); i++) {
+    DecisionTree::TreeNode<T, L>* node = ptrs[i];
+    node->prediction = nodes[i].prediction;
+    node->split_metric_val = nodes[i].split_metric_val;
+    node->question.column = nodes[i].colid;
+    node->question.value = nodes[i].quesval;
+    node->class_probs.assign(
+      class_probs.begin() + probs_offset,
+      class_probs.begin() + probs_offset + nodes[i].n_class_probs);
+    probs_offset += nodes[i].n_class_probs;
+    if (nodes[i].colid != -1) {
+      node->left = ptrs[nodes[i].left_child_id];
+      node->right = ptrs[nodes[i].left_child_id + 1];
+    }
+  }
+  tree->root = ptrs[0];
+  return buffer;
+}
+
+}  //End namespace ML
@@ -20,6 +20,7 @@
 #include "common/device_buffer.hpp"
 #include "cuda_utils.h"
 #include "distance/cosine.h"
+#include "distance/distance_type.h"
 #include "distance/euclidean.h"
 #include "distance/l1.h"
 
@@ -28,22 +29,6 @@ namespace Distance {
 
 typedef cutlass::Shape<8, 128, 128> OutputTile_8x128x128;
 
-/** enum to tell how to compute euclidean distance */
-enum DistanceType {
-  /** evaluate as dist_ij = sum(x_ik^2) + sum(y_ij)^2 - 2*sum(x_ik * y_jk) */
-  EucExpandedL2 = 0,
-  /** same as above, but inside the epilogue, perform square root operation */
-  EucExpandedL2Sqrt,
-  /** cosine distance */
-  EucExpandedCosine,
-  /** L1 distance */
-  EucUnexpandedL1,
-  /** evaluate as dist_ij += (x_ik - y-jk)^2 */
-  EucUnexpandedL2,
-  /** same as above, but inside the epilogue, perform square root operation */
-  EucUnexpandedL2Sqrt,
-};
-
 namespace {
 template <DistanceType distanceType, typename InType, typename AccType,
           typename OutType, typename OutputTile_, typename FinalLambda,
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "distance/distance_type.h"
+#include "utils.h"
+
+namespace MLCommon {
+namespace Distance {
+
+namespace detail {
+
+/** rows of x and of y processed together by one task of the host loops */
+static const int HostTileRows = 16;
+static const int HostTileCols = 64;
+
+/** copies a column-major rows x cols matrix to row-major order */
+template <typename Type, typename Index_>
+void toRowMajorHost(std::vector<Type> &out, const Type *in, Index_ rows,
+                    Index_ cols) {
+  out.resize((size_t)rows * cols);
+#pragma omp parallel for schedule(static)
+  for (Index_ i = 0; i < rows; ++i) {
+    for (Index_ c = 0; c < cols; ++c)
+      out[(size_t)i * cols + c] = in[i + (size_t)c * rows];
+  }
+}
+
+/** squared (or, with take_sqrt, plain) L2 norms of the rows of x */
+template <typename Type, typename Index_>
+void rowNormsHost(std::vector<Type> &out, const Type *x, Index_ rows,
+                  Index_ cols, bool take_sqrt) {
+  out.resize(rows);
+#pragma omp parallel for schedule(static)
+  for (Index_ i = 0; i < rows; ++i) {
+    const Type *xi = x + (size_t)i * cols;
+    Type acc = Type(0);
+#pragma omp simd reduction(+ : acc)
+    for (Index_ c = 0; c < cols; ++c) acc += xi[c] * xi[c];
+    out[i] = take_sqrt ? std::sqrt(acc) : acc;
+  }
+}
+
+/**
+ * Evaluates dist(i, j) = fin_op(sum_c acc_op(x[i][c], y[j][c]), i, j) for
+ * all the rows of the row-major x and y. The output is split into tiles of
+ * HostTileRows x HostTileCols which are spread over the OpenMP threads, so
+ * that a tile of y stays in cache while it is reused by the rows of x, and
+ * the reduction over the features is a unit-stride loop the compiler can
+ * vectorize.
+ */
+template <typename Type, typename Index_, typename AccOp, typename FinOp>
+void distanceTilesHost(const Type *x, const Type *y, Type *dist, Index_ m,
+                       Index_ n, Index_ k, bool isRowMajor, AccOp acc_op,
+                       FinOp fin_op) {
+  const Index_ mTiles = (m + HostTileRows - 1) / HostTileRows;
+  const Index_ nTiles = (n + HostTileCols - 1) / HostTileCols;
+#pragma omp parallel for collapse(2) schedule(static)
+  for (Index_ ti = 0; ti < mTiles; ++ti) {
+    for (Index_ tj = 0; tj < nTiles; ++tj) {
+      const Index_ i0 = ti * HostTileRows, j0 = tj * HostTileCols;
+      const Index_ i1 = std::min<Index_>(m, i0 + HostTileRows);
+      const Index_ j1 = std::min<Index_>(n, j0 + HostTileCols);
+      for (Index_ i = i0; i < i1; ++i) {
+        const Type *xi = x + (size_t)i * k;
+        for (Index_ j = j0; j < j1; ++j) {
+          const Type *yj = y + (size_t)j * k;
+          Type acc = Type(0);
+#pragma omp simd reduction(+ : acc)
+          for (Index_ c = 0; c < k; ++c) acc += acc_op(xi[c], yj[c]);
+          size_t out = isRowMajor ? (size_t)i * n + j : i + (size_t)j * m;
+          dist[out] = fin_op(acc, i, j);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Host (OpenMP) counterpart of pairwiseDistance: computes the
+ * distance between every row of x and every row of y, with the same
+ * definition of each metric as the device version (in particular,
+ * EucExpandedCosine yields the cosine similarity and the expanded L2
+ * metrics are evaluated as |x|^2 + |y|^2 - 2 x.y).
+ * @tparam Type input/output data type
+ * @tparam Index_ index type
+ * @param x first set of points, m x k (host)
+ * @param y second set of points, n x k (host)
+ * @param dist output distance matrix, m x n (host)
+ * @param m number of points in x
+ * @param n number of points in y
+ * @param k dimensionality
+ * @param metric distance metric
+ * @param isRowMajor whether the matrices are row-major or col-major
+ */
+template <typename Type, typename Index_ = int>
+void pairwiseDistanceHost(const Type *x, const Type *y, Type *dist, Index_ m,
+                          Index_ n, Index_ k, DistanceType metric,
+                          bool isRowMajor = true) {
+  if (m <= 0 || n <= 0) return;
+  std::vector<Type> xRow, yRow;
+  if (!isRowMajor) {
+    detail::toRowMajorHost(xRow, x, m, k);
+    detail::toRowMajorHost(yRow, y, n, k);
+    x = xRow.data();
+    y = yRow.data();
+  }
+
+  std::vector<Type> xn, yn;
+  auto dot = [](Type a, Type b) { return a * b; };
+  switch (metric) {
+    case DistanceType::EucExpandedL2:
+    case DistanceType::EucExpandedL2Sqrt: {
+      bool take_sqrt = metric == DistanceType::EucExpandedL2Sqrt;
+      detail::rowNormsHost(xn, x, m, k, false);
+      detail::rowNormsHost(yn, y, n, k, false);
+      const Type *pxn = xn.data(), *pyn = yn.data();
+      detail::distanceTilesHost(
+        x, y, dist, m, n, k, isRowMajor, dot,
+        [=](Type acc, Index_ i, Index_ j) {
+          Type d = pxn[i] + pyn[j] - Type(2) * acc;
+          return take_sqrt ? std::sqrt(d) : d;
+        });
+      break;
+    }
+    case DistanceType::EucExpandedCosine: {
+      detail::rowNormsHost(xn, x, m, k, true);
+      detail::rowNormsHost(yn, y, n, k, true);
+      const Type *pxn = xn.data(), *pyn = yn.data();
+      detail::distanceTilesHost(x, y, dist, m, n, k, isRowMajor, dot,
+                                [=](Type acc, Index_ i, Index_ j) {
+                                  return acc / (pxn[i] * pyn[j]);
+                                });
+      break;
+    }
+    case DistanceType::EucUnexpandedL1:
+      detail::distanceTilesHost(
+        x, y, dist, m, n, k, isRowMajor,
+        [](Type a, Type b) { return a > b ? a - b : b - a; },
+        [](Type acc, Index_ i, Index_ j) { return acc; });
+      break;
+    case DistanceType::EucUnexpandedL2:
+    case DistanceType::EucUnexpandedL2Sqrt: {
+      bool take_sqrt = metric == DistanceType::EucUnexpandedL2Sqrt;
+      detail::distanceTilesHost(
+        x, y, dist, m, n, k, isRowMajor,
+        [](Type a, Type b) { return (a - b) * (a - b); },
+        [=](Type acc, Index_ i, Index_ j) {
+          return take_sqrt ? std::sqrt(acc) : acc;
+        });
+      break;
+    }
+    default:
+      THROW("Unknown distance metric '%d'!", metric);
+  };
+}
+
+};  // end namespace Distance
+};  // end namespace MLCommon
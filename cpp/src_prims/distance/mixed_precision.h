@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cublas_v2.h>
+#include <cuda_fp16.h>
+#if defined(CUDART_VERSION) && CUDART_VERSION >= 11000
+#include <cuda_bf16.h>
+#endif
+#include <cfloat>
+#include <limits>
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "distance/distance.h"
+#include "linalg/cublas_wrappers.h"
+#include "linalg/norm.h"
+
+namespace MLCommon {
+namespace Distance {
+
+/** input precision of the GEMM inside the expanded distance computations */
+enum GemmPrecision {
+  /** fp32 inputs, through the cutlass SGEMM path of pairwiseDistance */
+  GemmFp32 = 0,
+  /** fp16 inputs with fp32 accumulation, on tensor cores */
+  GemmFp16,
+  /** bf16 inputs with fp32 accumulation, on tensor cores (CUDA 11+) */
+  GemmBf16,
+};
+
+/** unit roundoff of the GEMM inputs for the given precision */
+inline float gemmUnitRoundoff(GemmPrecision precision) {
+  switch (precision) {
+    case GemmFp16:
+      return 1.f / 2048.f;
+    case GemmBf16:
+      return 1.f / 256.f;
+    default:
+      return std::numeric_limits<float>::epsilon() / 2.f;
+  }
+}
+
+namespace {
+
+DI void toReduced(__half &out, float v) { out = __float2half_rn(v); }
+#if defined(CUDART_VERSION) && CUDART_VERSION >= 11000
+DI void toReduced(__nv_bfloat16 &out, float v) { out = __float2bfloat16_rn(v); }
+#endif
+
+template <typename ReducedT>
+__global__ void toReducedKernel(ReducedT *out, const float *in, size_t len) {
+  size_t i = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (i < len) toReduced(out[i], in[i]);
+}
+
+/**
+ * First order bound on the error of xn + yn - 2 x.y when the dot product is
+ * computed from inputs rounded with unit roundoff u and all the sums of
+ * length k are accumulated in fp32. xn and yn are the squared norms.
+ */
+DI float mixedL2ErrorBound(float xn, float yn, float u, int k) {
+  float e32 = k * (FLT_EPSILON / 2.f);
+  float nxy = mySqrt(xn) * mySqrt(yn);
+  return 1.1f * (2.f * (2.f * u + u * u + e32) * nxy + e32 * (xn + yn));
+}
+
+template <DistanceType distanceType>
+__global__ void mixedExpandedEpilogueKernel(float *dist, const float *x_norm,
+                                            const float *y_norm, int m,
+                                            int n) {
+  size_t idx = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (idx >= size_t(m) * n) return;
+  int i = idx / n, j = idx % n;
+  float dot = dist[idx];
+  if (distanceType == EucExpandedCosine) {
+    dist[idx] = dot / (mySqrt(x_norm[i]) * mySqrt(y_norm[j]));
+  } else {
+    // rounding can make the expansion slightly negative for close points
+    float d = max(x_norm[i] + y_norm[j] - 2.f * dot, 0.f);
+    dist[idx] = distanceType == EucExpandedL2Sqrt ? mySqrt(d) : d;
+  }
+}
+
+template <typename Lambda, typename Index_>
+__global__ void epsilonRefineKernel(bool *adj, const float *dots,
+                                    const float *a, const float *b,
+                                    const float *a_norm, const float *b_norm,
+                                    int m, int n, int k, float eps, float u,
+                                    Lambda fused_op) {
+  size_t idx = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (idx >= size_t(m) * n) return;
+  int i = idx / n, j = idx % n;
+  float d = a_norm[i] + b_norm[j] - 2.f * dots[idx];
+  float bound = mixedL2ErrorBound(a_norm[i], b_norm[j], u, k);
+  bool in_neigh;
+  if (d + bound <= eps) {
+    in_neigh = true;
+  } else if (d - bound > eps) {
+    in_neigh = false;
+  } else {
+    // too close to the threshold for the reduced precision result to decide
+    float acc = 0.f;
+    for (int l = 0; l < k; l++) {
+      float diff = a[size_t(i) * k + l] - b[size_t(j) * k + l];
+      acc += diff * diff;
+    }
+    in_neigh = acc <= eps;
+  }
+  adj[idx] = in_neigh;
+  fused_op(Index_(idx), in_neigh);
+}
+
+template <typename IdxT>
+__global__ void refineKnnKernel(const float *queries, const float *index,
+                                int dim, const IdxT *cand_idx, int n_cand,
+                                int k, IdxT *out_idx, float *out_dist,
+                                bool enable_sqrt) {
+  extern __shared__ char smem[];
+  IdxT *s_idx = (IdxT *)smem;
+  float *s_dist = (float *)(s_idx + n_cand);
+  int row = blockIdx.x;
+  const float *q = queries + size_t(row) * dim;
+  for (int c = threadIdx.x; c < n_cand; c += blockDim.x) {
+    IdxT id = cand_idx[size_t(row) * n_cand + c];
+    float acc = FLT_MAX;
+    // negative ids pad candidate lists that are shorter than n_cand
+    if (id >= 0) {
+      const float *p = index + size_t(id) * dim;
+      acc = 0.f;
+      for (int l = 0; l < dim; l++) {
+        float diff = q[l] - p[l];
+        acc += diff * diff;
+      }
+    }
+    s_idx[c] = id;
+    s_dist[c] = acc;
+  }
+  __syncthreads();
+  // the output slot of a candidate is its rank under (distance, id, slot)
+  for (int c = threadIdx.x; c < n_cand; c += blockDim.x) {
+    float d = s_dist[c];
+    IdxT id = s_idx[c];
+    int rank = 0;
+    for (int o = 0; o < n_cand; o++) {
+      float od = s_dist[o];
+      IdxT oid = s_idx[o];
+      rank += od < d || (od == d && (oid < id || (oid == id && o < c)));
+    }
+    if (rank < k) {
+      out_idx[size_t(row) * k + rank] = id;
+      out_dist[size_t(row) * k + rank] = enable_sqrt ? mySqrt(d) : d;
+    }
+  }
+}
+
+}  // anonymous namespace
+
+/**
+ * @brief Computes the squared row norms of x and y in fp32 and the dot
+ * products between their rows in reduced precision with fp32 accumulation
+ * @param x first set of points (row major)
+ * @param y second set of points (row major)
+ * @param dots output dot products (row major m x n)
+ * @param x_norm output squared norms of the rows of x
+ * @param y_norm output squared norms of the rows of y (unused if x == y)
+ * @param m number of points in x
+ * @param n number of points in y
+ * @param k dimensionality
+ * @param precision input precision of the GEMM, GemmFp16 or GemmBf16
+ * @param workspace temporary buffer, resized as needed
+ * @param cublasH cublas handle
+ * @param stream cuda stream
+ */
+inline void mixedPrecisionDots(const float *x, const float *y, float *dots,
+                               float *x_norm, float *y_norm, int m, int n,
+                               int k, GemmPrecision precision,
+                               device_buffer<char> &workspace,
+                               cublasHandle_t cublasH, cudaStream_t stream) {
+  ASSERT(precision == GemmFp16 || precision == GemmBf16,
+         "mixedPrecisionDots: precision must be GemmFp16 or GemmBf16");
+#if !defined(CUDART_VERSION) || CUDART_VERSION < 11000
+  ASSERT(precision != GemmBf16,
+         "mixedPrecisionDots: bf16 inputs need CUDA 11 or newer");
+#endif
+  bool same = x == y;
+  // __half and __nv_bfloat16 are both 2 bytes wide
+  size_t x_len = size_t(m) * k, y_len = same ? 0 : size_t(n) * k;
+  workspace.resize((x_len + y_len) * 2, stream);
+  void *xr = workspace.data();
+  void *yr = same ? xr : (void *)(workspace.data() + x_len * 2);
+
+  LinAlg::rowNorm(x_norm, x, k, m, LinAlg::L2Norm, true, stream);
+  if (!same) LinAlg::rowNorm(y_norm, y, k, n, LinAlg::L2Norm, true, stream);
+
+  static const int TPB = 256;
+  cudaDataType_t in_type = CUDA_R_16F;
+  if (precision == GemmFp16) {
+    toReducedKernel<<<ceildiv<size_t>(x_len, TPB), TPB, 0, stream>>>(
+      (__half *)xr, x, x_len);
+    if (!same) {
+      toReducedKernel<<<ceildiv<size_t>(y_len, TPB), TPB, 0, stream>>>(
+        (__half *)yr, y, y_len);
+    }
+  }
+#if defined(CUDART_VERSION) && CUDART_VERSION >= 11000
+  if (precision == GemmBf16) {
+    in_type = CUDA_R_16BF;
+    toReducedKernel<<<ceildiv<size_t>(x_len, TPB), TPB, 0, stream>>>(
+      (__nv_bfloat16 *)xr, x, x_len);
+    if (!same) {
+      toReducedKernel<<<ceildiv<size_t>(y_len, TPB), TPB, 0, stream>>>(
+        (__nv_bfloat16 *)yr, y, y_len);
+    }
+  }
+#endif
+  CUDA_CHECK(cudaPeekAtLastError());
+
+  // row major dots (m x n) is the column major n x m product y * x^T
+  float alpha = 1.f, beta = 0.f;
+  CUBLAS_CHECK(cublasSetStream(cublasH, stream));
+  CUBLAS_CHECK(cublasGemmEx(cublasH, CUBLAS_OP_T, CUBLAS_OP_N, n, m, k, &alpha,
+                            yr, in_type, k, xr, in_type, k, &beta, dots,
+                            CUDA_R_32F, n,
+#if defined(CUDART_VERSION) && CUDART_VERSION >= 11000
+                            CUBLAS_COMPUTE_32F,
+#else
+                            CUDA_R_32F,
+#endif
+                            CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+}
+
+/**
+ * @brief pairwiseDistance with a per call choice of the GEMM input precision
+ * @param x first set of points (row major)
+ * @param y second set of points (row major)
+ * @param dist output distance matrix (row major m x n)
+ * @param m number of points in x
+ * @param n number of points in y
+ * @param k dimensionality
+ * @param workspace temporary buffer, resized as needed
+ * @param metric distance metric. Reduced precisions support the expanded
+ *  metrics (EucExpandedL2, EucExpandedL2Sqrt and EucExpandedCosine)
+ * @param precision input precision of the GEMM
+ * @param cublasH cublas handle, used by the reduced precisions
+ * @param stream cuda stream
+ *
+ * @note with GemmFp16 the inputs must be within the fp16 range (65504).
+ *  The distances have a relative error of about the unit roundoff of the
+ *  precision (gemmUnitRoundoff); use the refinement prims below where exact
+ *  comparisons matter.
+ */
+inline void pairwiseDistanceMixed(const float *x, const float *y, float *dist,
+                                  int m, int n, int k,
+                                  device_buffer<char> &workspace,
+                                  DistanceType metric, GemmPrecision precision,
+                                  cublasHandle_t cublasH, cudaStream_t stream) {
+  if (precision == GemmFp32) {
+    pairwiseDistance<float, int>(x, y, dist, m, n, k, workspace, metric,
+                                 stream);
+    return;
+  }
+  ASSERT(metric == EucExpandedL2 || metric == EucExpandedL2Sqrt ||
+           metric == EucExpandedCosine,
+         "pairwiseDistanceMixed: metric '%d' has no reduced precision path",
+         metric);
+  device_buffer<float> norms(workspace.getAllocator(), stream, m + n);
+  float *x_norm = norms.data(), *y_norm = x == y ? x_norm : x_norm + m;
+  mixedPrecisionDots(x, y, dist, x_norm, y_norm, m, n, k, precision,
+                     workspace, cublasH, stream);
+
+  static const int TPB = 256;
+  size_t len = size_t(m) * n;
+  int nblks = ceildiv<size_t>(len, TPB);
+  switch (metric) {
+    case EucExpandedL2:
+      mixedExpandedEpilogueKernel<EucExpandedL2>
+        <<<nblks, TPB, 0, stream>>>(dist, x_norm, y_norm, m, n);
+      break;
+    case EucExpandedL2Sqrt:
+      mixedExpandedEpilogueKernel<EucExpandedL2Sqrt>
+        <<<nblks, TPB, 0, stream>>>(dist, x_norm, y_norm, m, n);
+      break;
+    default:
+      mixedExpandedEpilogueKernel<EucExpandedCosine>
+        <<<nblks, TPB, 0, stream>>>(dist, x_norm, y_norm, m, n);
+  }
+  CUDA_CHECK(cudaPeekAtLastError());
+  norms.release(stream);
+}
+
+/**
+ * @brief epsilon_neighborhood on squared L2 distances with a reduced
+ * precision GEMM. Pairs whose approximate distance is within the error bound
+ * of eps are recomputed exactly in fp32, so adj is the same as with the fp32
+ * EucUnexpandedL2 path.
+ * @param a row-major input matrix a
+ * @param b row-major input matrix b
+ * @param adj a boolean output adjacency matrix
+ * @param m number of points in a
+ * @param n number of points in b
+ * @param k dimensionality
+ * @param eps the (squared) epsilon value to filter the squared distances by
+ * @param precision input precision of the GEMM, GemmFp16 or GemmBf16
+ * @param workspace temporary buffer, resized as needed
+ * @param cublasH cublas handle
+ * @param stream cuda stream
+ * @param fused_op functor taking the output index into adj and a boolean
+ *  denoting whether or not the inputs are part of the epsilon neighborhood
+ */
+template <typename Lambda, typename Index_ = int>
+void epsilonNeighborhoodMixed(const float *a, const float *b, bool *adj,
+                              int m, int n, int k, float eps,
+                              GemmPrecision precision,
+                              device_buffer<char> &workspace,
+                              cublasHandle_t cublasH, cudaStream_t stream,
+                              Lambda fused_op) {
+  auto allocator = workspace.getAllocator();
+  device_buffer<float> norms(allocator, stream, m + n);
+  device_buffer<float> dots(allocator, stream, size_t(m) * n);
+  float *a_norm = norms.data(), *b_norm = a == b ? a_norm : a_norm + m;
+  mixedPrecisionDots(a, b, dots.data(), a_norm, b_norm, m, n, k, precision,
+                     workspace, cublasH, stream);
+
+  static const int TPB = 256;
+  int nblks = ceildiv<size_t>(size_t(m) * n, TPB);
+  epsilonRefineKernel<Lambda, Index_><<<nblks, TPB, 0, stream>>>(
+    adj, dots.data(), a, b, a_norm, b_norm, m, n, k, eps,
+    gemmUnitRoundoff(precision), fused_op);
+  CUDA_CHECK(cudaPeekAtLastError());
+  dots.release(stream);
+  norms.release(stream);
+}
+
+/**
+ * @brief Re-ranks approximate nearest neighbor candidates with exact fp32
+ * squared L2 distances. Searching n_cand > k candidates in reduced precision
+ * (e.g. a float16 faiss index, or pairwiseDistanceMixed followed by a top-k)
+ * and refining them here keeps the neighbors whose order the reduced
+ * precision could not resolve, ties at the k-th neighbor included; ties in
+ * the exact distance are broken by the smaller index.
+ * @param queries row-major query points (n_queries x dim)
+ * @param index row-major indexed points, which the candidate ids refer to
+ * @param n_queries number of queries
+ * @param dim dimensionality
+ * @param cand_idx candidate ids per query (n_queries x n_cand), negative ids
+ *  are ignored
+ * @param n_cand number of candidates per query
+ * @param k number of neighbors to return, k <= n_cand
+ * @param out_idx output neighbor ids (n_queries x k), sorted by distance
+ * @param out_dist output distances (n_queries x k)
+ * @param enable_sqrt whether to return L2 rather than squared L2 distances
+ * @param stream cuda stream
+ */
+template <typename IdxT>
+void refineKnnCandidates(const float *queries, const float *index,
+                         int n_queries, int dim, const IdxT *cand_idx,
+                         int n_cand, int k, IdxT *out_idx, float *out_dist,
+                         bool enable_sqrt, cudaStream_t stream) {
+  ASSERT(k <= n_cand, "refineKnnCandidates: k cannot exceed n_cand");
+  size_t smem = n_cand * (sizeof(IdxT) + sizeof(float));
+  ASSERT(smem <= 48 * 1024, "refineKnnCandidates: too many candidates (%d)",
+         n_cand);
+  static const int TPB = 128;
+  refineKnnKernel<IdxT><<<n_queries, TPB, smem, stream>>>(
+    queries, index, dim, cand_idx, n_cand, k, out_idx, out_dist, enable_sqrt);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+};  // end namespace Distance
+};  // end namespace MLCommon
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cuda_utils.h"
+
+namespace MLCommon {
+namespace LinAlg {
+
+/**
+ * Batched factorizations and solvers for many small dense matrices. All the
+ * matrices of a batch are column-major, have the same shape and are stored
+ * back to back (strided batched layout, stride = rows * cols). Each matrix is
+ * processed by one thread block entirely in shared memory, so the whole batch
+ * is handled by a single kernel launch. Intended for dimensions up to
+ * BATCHED_MAX_DIM, for larger matrices use the cuSOLVER based prims.
+ */
+static const int BATCHED_MAX_DIM = 64;
+static const int BATCHED_TPB = 128;
+
+inline void batchedCheckSmem(size_t smem_bytes) {
+  ASSERT(smem_bytes <= 48 * 1024,
+         "batched linalg: %zu bytes of shared memory needed per matrix, at "
+         "most 48KB are supported",
+         smem_bytes);
+}
+
+template <typename math_t>
+DI void batchedLoad(math_t *dst, const math_t *src, int len) {
+  for (int i = threadIdx.x; i < len; i += blockDim.x) dst[i] = src[i];
+}
+
+template <typename math_t>
+DI void batchedStore(math_t *dst, const math_t *src, int len) {
+  for (int i = threadIdx.x; i < len; i += blockDim.x) dst[i] = src[i];
+}
+
+template <typename math_t>
+__global__ void batchedCholeskyKernel(math_t *A, int n, int *info) {
+  extern __shared__ char smem[];
+  __shared__ int failed;
+  math_t *a = (math_t *)smem;
+  math_t *A_b = A + (size_t)blockIdx.x * n * n;
+  batchedLoad(a, A_b, n * n);
+  if (threadIdx.x == 0) failed = 0;
+  __syncthreads();
+
+  for (int k = 0; k < n; k++) {
+    if (threadIdx.x == 0) {
+      math_t d = a[k + k * n];
+      if (d <= math_t(0))
+        failed = k + 1;
+      else
+        a[k + k * n] = mySqrt(d);
+    }
+    __syncthreads();
+    if (failed) break;
+    math_t dkk = a[k + k * n];
+    for (int i = k + 1 + threadIdx.x; i < n; i += blockDim.x)
+      a[i + k * n] /= dkk;
+    __syncthreads();
+    // Rank one update of the trailing lower triangle
+    int m = n - k - 1;
+    for (int idx = threadIdx.x; idx < m * m; idx += blockDim.x) {
+      int i = k + 1 + idx % m;
+      int j = k + 1 + idx / m;
+      if (i >= j) a[i + j * n] -= a[i + k * n] * a[j + k * n];
+    }
+    __syncthreads();
+  }
+
+  for (int idx = threadIdx.x; idx < n * n; idx += blockDim.x) {
+    A_b[idx] = (idx % n >= idx / n) ? a[idx] : math_t(0);
+  }
+  if (threadIdx.x == 0) info[blockIdx.x] = failed;
+}
+
+/**
+ * @brief Batched in-place Cholesky factorization A = L * L^T of symmetric
+ * positive definite matrices. Only the lower triangle of A is read; on exit
+ * A holds L with a zeroed upper triangle.
+ * @param A: batch_size n x n matrices (device pointer)
+ * @param n: dimension of the matrices
+ * @param batch_size: number of matrices
+ * @param info: batch_size status values (device pointer); 0 on success, k + 1
+ * if the leading minor of order k + 1 is not positive definite
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedCholesky(math_t *A, int n, int batch_size, int *info,
+                     cudaStream_t stream) {
+  ASSERT(n > 0 && n <= BATCHED_MAX_DIM, "batchedCholesky: invalid n %d", n);
+  size_t smem = n * n * sizeof(math_t);
+  batchedCheckSmem(smem);
+  batchedCholeskyKernel<<<batch_size, BATCHED_TPB, smem, stream>>>(A, n, info);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename math_t>
+__global__ void batchedCholeskySolveKernel(const math_t *L, math_t *B, int n,
+                                           int nrhs) {
+  extern __shared__ char smem[];
+  math_t *l = (math_t *)smem;
+  math_t *b = l + n * n;
+  math_t *B_b = B + (size_t)blockIdx.x * n * nrhs;
+  batchedLoad(l, L + (size_t)blockIdx.x * n * n, n * n);
+  batchedLoad(b, B_b, n * nrhs);
+  __syncthreads();
+
+  // Forward substitution L * Y = B
+  for (int k = 0; k < n; k++) {
+    for (int r = threadIdx.x; r < nrhs; r += blockDim.x)
+      b[k + r * n] /= l[k + k * n];
+    __syncthreads();
+    int m = n - k - 1;
+    for (int idx = threadIdx.x; idx < m * nrhs; idx += blockDim.x) {
+      int i = k + 1 + idx % m;
+      int r = idx / m;
+      b[i + r * n] -= l[i + k * n] * b[k + r * n];
+    }
+    __syncthreads();
+  }
+  // Backward substitution L^T * X = Y
+  for (int k = n - 1; k >= 0; k--) {
+    for (int r = threadIdx.x; r < nrhs; r += blockDim.x)
+      b[k + r * n] /= l[k + k * n];
+    __syncthreads();
+    for (int idx = threadIdx.x; idx < k * nrhs; idx += blockDim.x) {
+      int i = idx % k;
+      int r = idx / k;
+      b[i + r * n] -= l[k + i * n] * b[k + r * n];
+    }
+    __syncthreads();
+  }
+  batchedStore(B_b, b, n * nrhs);
+}
+
+/**
+ * @brief Batched solve of A * X = B given the Cholesky factors of A
+ * @param L: batch_size n x n lower Cholesky factors from batchedCholesky
+ * (device pointer)
+ * @param B: batch_size n x nrhs right hand sides, overwritten with X
+ * (device pointer)
+ * @param n: dimension of the matrices
+ * @param nrhs: number of right hand sides
+ * @param batch_size: number of systems
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedCholeskySolve(const math_t *L, math_t *B, int n, int nrhs,
+                          int batch_size, cudaStream_t stream) {
+  ASSERT(n > 0 && n <= BATCHED_MAX_DIM, "batchedCholeskySolve: invalid n %d",
+         n);
+  size_t smem = (n * n + n * nrhs) * sizeof(math_t);
+  batchedCheckSmem(smem);
+  batchedCholeskySolveKernel<<<batch_size, BATCHED_TPB, smem, stream>>>(
+    L, B, n, nrhs);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename math_t>
+__global__ void batchedLUKernel(math_t *A, int *pivots, int n, int *info) {
+  extern __shared__ char smem[];
+  __shared__ int failed, pivot;
+  math_t *a = (math_t *)smem;
+  math_t *A_b = A + (size_t)blockIdx.x * n * n;
+  batchedLoad(a, A_b, n * n);
+  if (threadIdx.x == 0) failed = 0;
+  __syncthreads();
+
+  for (int k = 0; k < n; k++) {
+    if (threadIdx.x == 0) {
+      int p = k;
+      math_t max_val = myAbs(a[k + k * n]);
+      for (int i = k + 1; i < n; i++) {
+        math_t val = myAbs(a[i + k * n]);
+        if (val > max_val) {
+          max_val = val;
+          p = i;
+        }
+      }
+      if (max_val == math_t(0) && failed == 0) failed = k + 1;
+      pivot = p;
+      pivots[blockIdx.x * n + k] = p;
+    }
+    __syncthreads();
+    int p = pivot;
+    if (p != k) {
+      for (int j = threadIdx.x; j < n; j += blockDim.x)
+        swap(a[k + j * n], a[p + j * n]);
+    }
+    __syncthreads();
+    math_t akk = a[k + k * n];
+    if (akk != math_t(0)) {
+      for (int i = k + 1 + threadIdx.x; i < n; i += blockDim.x)
+        a[i + k * n] /= akk;
+    }
+    __syncthreads();
+    int m = n - k - 1;
+    for (int idx = threadIdx.x; idx < m * m; idx += blockDim.x) {
+      int i = k + 1 + idx % m;
+      int j = k + 1 + idx / m;
+      a[i + j * n] -= a[i + k * n] * a[k + j * n];
+    }
+    __syncthreads();
+  }
+
+  batchedStore(A_b, a, n * n);
+  if (threadIdx.x == 0) info[blockIdx.x] = failed;
+}
+
+/**
+ * @brief Batched in-place LU factorization with partial pivoting P * A = L * U
+ * @param A: batch_size n x n matrices, overwritten with the unit lower
+ * triangular L (below the diagonal) and U (device pointer)
+ * @param pivots: batch_size * n pivot indices (device pointer); row k was
+ * swapped with row pivots[k] (0-based) at step k
+ * @param n: dimension of the matrices
+ * @param batch_size: number of matrices
+ * @param info: batch_size status values (device pointer); 0 on success, k + 1
+ * if U(k, k) is exactly zero for the first such k. As with getrf the
+ * factorization is still completed; U is then singular and batchedLUSolve
+ * leaves the right hand sides of that matrix unchanged
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedLU(math_t *A, int *pivots, int n, int batch_size, int *info,
+               cudaStream_t stream) {
+  ASSERT(n > 0 && n <= BATCHED_MAX_DIM, "batchedLU: invalid n %d", n);
+  size_t smem = n * n * sizeof(math_t);
+  batchedCheckSmem(smem);
+  batchedLUKernel<<<batch_size, BATCHED_TPB, smem, stream>>>(A, pivots, n,
+                                                             info);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename math_t>
+__global__ void batchedLUSolveKernel(const math_t *LU, const int *pivots,
+                                     const int *info, math_t *B, int n,
+                                     int nrhs) {
+  // U has a zero on its diagonal, the back substitution would divide by it
+  if (info[blockIdx.x] != 0) return;
+  extern __shared__ char smem[];
+  math_t *lu = (math_t *)smem;
+  math_t *b = lu + n * n;
+  math_t *B_b = B + (size_t)blockIdx.x * n * nrhs;
+  const int *piv = pivots + blockIdx.x * n;
+  batchedLoad(lu, LU + (size_t)blockIdx.x * n * n, n * n);
+  batchedLoad(b, B_b, n * nrhs);
+  __syncthreads();
+
+  // Row interchanges, in factorization order
+  for (int r = threadIdx.x; r < nrhs; r += blockDim.x) {
+    for (int k = 0; k < n; k++) {
+      if (piv[k] != k) swap(b[k + r * n], b[piv[k] + r * n]);
+    }
+  }
+  __syncthreads();
+  // Forward substitution with the unit lower factor
+  for (int k = 0; k < n; k++) {
+    int m = n - k - 1;
+    for (int idx = threadIdx.x; idx < m * nrhs; idx += blockDim.x) {
+      int i = k + 1 + idx % m;
+      int r = idx / m;
+      b[i + r * n] -= lu[i + k * n] * b[k + r * n];
+    }
+    __syncthreads();
+  }
+  // Backward substitution with the upper factor
+  for (int k = n - 1; k >= 0; k--) {
+    for (int r = threadIdx.x; r < nrhs; r += blockDim.x)
+      b[k + r * n] /= lu[k + k * n];
+    __syncthreads();
+    for (int idx = threadIdx.x; idx < k * nrhs; idx += blockDim.x) {
+      int i = idx % k;
+      int r = idx / k;
+      b[i + r * n] -= lu[i + k * n] * b[k + r * n];
+    }
+    __syncthreads();
+  }
+  batchedStore(B_b, b, n * nrhs);
+}
+
+/**
+ * @brief Batched solve of A * X = B given the LU factorization of A
+ * @param LU: batch_size n x n factors from batchedLU (device pointer)
+ * @param pivots: batch_size * n pivot indices from batchedLU (device pointer)
+ * @param info: batch_size status values from batchedLU (device pointer); the
+ * systems of singular matrices (info != 0) are skipped
+ * @param B: batch_size n x nrhs right hand sides, overwritten with X
+ * (device pointer)
+ * @param n: dimension of the matrices
+ * @param nrhs: number of right hand sides
+ * @param batch_size: number of systems
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedLUSolve(const math_t *LU, const int *pivots, const int *info,
+                    math_t *B, int n, int nrhs, int batch_size,
+                    cudaStream_t stream) {
+  ASSERT(n > 0 && n <= BATCHED_MAX_DIM, "batchedLUSolve: invalid n %d", n);
+  size_t smem = (n * n + n * nrhs) * sizeof(math_t);
+  batchedCheckSmem(smem);
+  batchedLUSolveKernel<<<batch_size, BATCHED_TPB, smem, stream>>>(
+    LU, pivots, info, B, n, nrhs);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename math_t>
+__global__ void batchedEigJacobiKernel(const math_t *A, math_t *eig_vectors,
+                                       math_t *eig_vals, int n, math_t tol,
+                                       int sweeps) {
+  extern __shared__ char smem[];
+  __shared__ math_t off_norm, norm, c, s;
+  math_t *a = (math_t *)smem;
+  math_t *d = a + n * n;
+  int *order = (int *)(d + n);
+  // The eigenvectors are accumulated in place in the output: each thread
+  // only updates its own row of V, so they need no shared memory
+  math_t *v = eig_vectors + (size_t)blockIdx.x * n * n;
+  batchedLoad(a, A + (size_t)blockIdx.x * n * n, n * n);
+  for (int idx = threadIdx.x; idx < n * n; idx += blockDim.x)
+    v[idx] = (idx % n == idx / n) ? math_t(1) : math_t(0);
+  if (threadIdx.x == 0) norm = math_t(0);
+  __syncthreads();
+  math_t partial = math_t(0);
+  for (int idx = threadIdx.x; idx < n * n; idx += blockDim.x)
+    partial += a[idx] * a[idx];
+  myAtomicAdd(&norm, partial);
+
+  for (int sweep = 0; sweep < sweeps; sweep++) {
+    if (threadIdx.x == 0) off_norm = math_t(0);
+    __syncthreads();
+    partial = math_t(0);
+    for (int idx = threadIdx.x; idx < n * n; idx += blockDim.x)
+      if (idx % n != idx / n) partial += a[idx] * a[idx];
+    myAtomicAdd(&off_norm, partial);
+    __syncthreads();
+    if (off_norm <= tol * tol * norm) break;
+
+    // One cyclic sweep of Jacobi rotations
+    for (int p = 0; p < n - 1; p++) {
+      for (int q = p + 1; q < n; q++) {
+        if (threadIdx.x == 0) {
+          math_t apq = a[p + q * n];
+          if (apq == math_t(0)) {
+            c = math_t(1);
+            s = math_t(0);
+          } else {
+            math_t tau = (a[q + q * n] - a[p + p * n]) / (2 * apq);
+            math_t t = (tau >= math_t(0) ? math_t(1) : math_t(-1)) /
+                       (myAbs(tau) + mySqrt(1 + tau * tau));
+            c = 1 / mySqrt(1 + t * t);
+            s = t * c;
+          }
+        }
+        __syncthreads();
+        math_t cr = c, sr = s;
+        if (sr == math_t(0)) {
+          // c and s are rewritten by the next rotation
+          __syncthreads();
+          continue;
+        }
+        // A * J and V * J update columns p and q
+        for (int i = threadIdx.x; i < n; i += blockDim.x) {
+          math_t aip = a[i + p * n], aiq = a[i + q * n];
+          a[i + p * n] = cr * aip - sr * aiq;
+          a[i + q * n] = sr * aip + cr * aiq;
+          math_t vip = v[i + p * n], viq = v[i + q * n];
+          v[i + p * n] = cr * vip - sr * viq;
+          v[i + q * n] = sr * vip + cr * viq;
+        }
+        __syncthreads();
+        // J^T * A updates rows p and q
+        for (int j = threadIdx.x; j < n; j += blockDim.x) {
+          math_t apj = a[p + j * n], aqj = a[q + j * n];
+          a[p + j * n] = cr * apj - sr * aqj;
+          a[q + j * n] = sr * apj + cr * aqj;
+        }
+        __syncthreads();
+      }
+    }
+  }
+
+  // Ascending eigenvalues, as returned by the cuSOLVER based prims
+  for (int i = threadIdx.x; i < n; i += blockDim.x) d[i] = a[i * (n + 1)];
+  __syncthreads();
+  if (threadIdx.x == 0) {
+    for (int i = 0; i < n; i++) order[i] = i;
+    for (int i = 1; i < n; i++) {
+      int key = order[i];
+      int j = i - 1;
+      while (j >= 0 && d[order[j]] > d[key]) {
+        order[j + 1] = order[j];
+        j--;
+      }
+      order[j + 1] = key;
+    }
+  }
+  // a is free now, it holds V while its columns are reordered
+  batchedLoad(a, v, n * n);
+  __syncthreads();
+  math_t *vals_b = eig_vals + (size_t)blockIdx.x * n;
+  for (int i = threadIdx.x; i < n; i += blockDim.x) vals_b[i] = d[order[i]];
+  for (int idx = threadIdx.x; idx < n * n; idx += blockDim.x)
+    v[idx] = a[idx % n + order[idx / n] * n];
+}
+
+/**
+ * @brief Batched eigen decomposition of symmetric matrices with the cyclic
+ * Jacobi method
+ * @param A: batch_size n x n symmetric matrices (device pointer)
+ * @param eig_vectors: batch_size n x n eigenvector matrices, one eigenvector
+ * per column (device pointer); also the workspace of the rotations, so that
+ * only A takes shared memory and n can go up to BATCHED_MAX_DIM in double
+ * @param eig_vals: batch_size * n eigenvalues in ascending order per matrix
+ * (device pointer)
+ * @param n: dimension of the matrices
+ * @param batch_size: number of matrices
+ * @param tol: convergence threshold on the off-diagonal Frobenius norm,
+ * relative to the Frobenius norm of the input
+ * @param sweeps: maximum number of Jacobi sweeps
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedEigJacobi(const math_t *A, math_t *eig_vectors, math_t *eig_vals,
+                      int n, int batch_size, math_t tol, int sweeps,
+                      cudaStream_t stream) {
+  ASSERT(n > 0 && n <= BATCHED_MAX_DIM, "batchedEigJacobi: invalid n %d", n);
+  size_t smem = (n * n + n) * sizeof(math_t) + n * sizeof(int);
+  batchedCheckSmem(smem);
+  // One thread per row or column of a rotation
+  int threads = ceildiv(n, 32) * 32;
+  batchedEigJacobiKernel<<<batch_size, threads, smem, stream>>>(
+    A, eig_vectors, eig_vals, n, tol, sweeps);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+template <typename math_t>
+__global__ void batchedLstsqKernel(const math_t *A, const math_t *B,
+                                   math_t *X, int m, int n, int nrhs,
+                                   int *info) {
+  extern __shared__ char smem[];
+  __shared__ math_t alpha, beta;
+  __shared__ int failed;
+  math_t *a = (math_t *)smem;
+  math_t *b = a + m * n;
+  math_t *v = b + m * nrhs;
+  batchedLoad(a, A + (size_t)blockIdx.x * m * n, m * n);
+  batchedLoad(b, B + (size_t)blockIdx.x * m * nrhs, m * nrhs);
+  if (threadIdx.x == 0) failed = 0;
+  __syncthreads();
+
+  // Householder QR, applying Q^T to the right hand sides on the fly
+  for (int k = 0; k < n; k++) {
+    if (threadIdx.x == 0) {
+      math_t x0 = a[k + k * m];
+      math_t sigma = math_t(0);
+      for (int i = k + 1; i < m; i++) sigma += a[i + k * m] * a[i + k * m];
+      math_t xnorm = mySqrt(x0 * x0 + sigma);
+      if (xnorm == math_t(0)) {
+        alpha = x0;
+        beta = math_t(0);
+        v[k] = math_t(0);
+      } else {
+        alpha = x0 >= math_t(0) ? -xnorm : xnorm;
+        v[k] = x0 - alpha;
+        beta = 2 / (v[k] * v[k] + sigma);
+      }
+    }
+    for (int i = k + 1 + threadIdx.x; i < m; i += blockDim.x)
+      v[i] = a[i + k * m];
+    __syncthreads();
+    // H = I - beta * v * v^T on the trailing columns of A and on B
+    for (int j = k + 1 + threadIdx.x; j < n + nrhs; j += blockDim.x) {
+      math_t *col = j < n ? a + j * m : b + (j - n) * m;
+      math_t dot = math_t(0);
+      for (int i = k; i < m; i++) dot += v[i] * col[i];
+      dot *= beta;
+      for (int i = k; i < m; i++) col[i] -= dot * v[i];
+    }
+    if (threadIdx.x == 0) {
+      a[k + k * m] = alpha;
+      if (alpha == math_t(0) && failed == 0) failed = k + 1;
+    }
+    __syncthreads();
+  }
+
+  // Back substitution R * X = (Q^T * B)[0:n]
+  for (int k = n - 1; k >= 0; k--) {
+    for (int r = threadIdx.x; r < nrhs; r += blockDim.x)
+      b[k + r * m] /= a[k + k * m];
+    __syncthreads();
+    for (int idx = threadIdx.x; idx < k * nrhs; idx += blockDim.x) {
+      int i = idx % k;
+      int r = idx / k;
+      b[i + r * m] -= a[i + k * m] * b[k + r * m];
+    }
+    __syncthreads();
+  }
+  math_t *X_b = X + (size_t)blockIdx.x * n * nrhs;
+  for (int idx = threadIdx.x; idx < n * nrhs; idx += blockDim.x)
+    X_b[idx] = b[idx % n + (idx / n) * m];
+  if (threadIdx.x == 0) info[blockIdx.x] = failed;
+}
+
+/**
+ * @brief Batched linear least squares min ||A * X - B|| with Householder QR
+ * @param A: batch_size m x n matrices with m >= n (device pointer)
+ * @param B: batch_size m x nrhs right hand sides (device pointer)
+ * @param X: batch_size n x nrhs solutions (device pointer)
+ * @param m: number of rows of the matrices
+ * @param n: number of columns of the matrices
+ * @param nrhs: number of right hand sides
+ * @param batch_size: number of problems
+ * @param info: batch_size status values (device pointer); 0 on success, k + 1
+ * if column k is linearly dependent on the previous ones (R(k, k) == 0)
+ * @param stream: cuda stream
+ */
+template <typename math_t>
+void batchedLstsq(const math_t *A, const math_t *B, math_t *X, int m, int n,
+                  int nrhs, int batch_size, int *info, cudaStream_t stream) {
+  ASSERT(n > 0 && m >= n, "batchedLstsq: invalid shape %d x %d", m, n);
+  size_t smem = (m * n + m * nrhs + m) * sizeof(math_t);
+  batchedCheckSmem(smem);
+  batchedLstsqKernel<<<batch_size, BATCHED_TPB, smem, stream>>>(A, B, X, m, n,
+                                                                nrhs, info);
+  CUDA_CHECK(cudaGetLastError());
+}
+
+};  // namespace LinAlg
+};  // namespace MLCommon
@@ -181,6 +181,44 @@ inline cublasStatus_t cublasgemm(cublasHandle_t handle,
 }
 /** @} */
 
+/**
+ * @defgroup gemmStridedBatched cublas gemmStridedBatched calls
+ * @{
+ */
+template <typename T>
+cublasStatus_t cublasgemmStridedBatched(
+  cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+  int m, int n, int k, const T *alfa, const T *A, int lda, long long strideA,
+  const T *B, int ldb, long long strideB, const T *beta, T *C, int ldc,
+  long long strideC, int batchCount, cudaStream_t stream);
+
+template <>
+inline cublasStatus_t cublasgemmStridedBatched(
+  cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+  int m, int n, int k, const float *alfa, const float *A, int lda,
+  long long strideA, const float *B, int ldb, long long strideB,
+  const float *beta, float *C, int ldc, long long strideC, int batchCount,
+  cudaStream_t stream) {
+  CUBLAS_CHECK(cublasSetStream(handle, stream));
+  return cublasSgemmStridedBatched(handle, transA, transB, m, n, k, alfa, A,
+                                   lda, strideA, B, ldb, strideB, beta, C, ldc,
+                                   strideC, batchCount);
+}
+
+template <>
+inline cublasStatus_t cublasgemmStridedBatched(
+  cublasHandle_t handle, cublasOperation_t transA, cublasOperation_t transB,
+  int m, int n, int k, const double *alfa, const double *A, int lda,
+  long long strideA, const double *B, int ldb, long long strideB,
+  const double *beta, double *C, int ldc, long long strideC, int batchCount,
+  cudaStream_t stream) {
+  CUBLAS_CHECK(cublasSetStream(handle, stream));
+  return cublasDgemmStridedBatched(handle, transA, transB, m, n, k, alfa, A,
+                                   lda, strideA, B, ldb, strideB, beta, C, ldc,
+                                   strideC, batchCount);
+}
+/** @} */
+
 /**
  * @defgroup geam cublas geam calls
  * @{
@@ -18,6 +18,7 @@
 
 #include <cooperative_groups.h>
 #include <memory>
+#include <random>
 #include "cuda_utils.h"
 #include "vectorized.h"
 
@@ -115,6 +116,27 @@ struct permute_impl_t<Type, IntType, IdxType, TPB, rowMajor, 1> {
   }
 };
 
+template <typename Type, typename IntType, typename IdxType, int TPB>
+void permuteAffine(IntType* perms, Type* out, const Type* in, IntType D,
+                   IntType N, bool rowMajor, IdxType a, IdxType b,
+                   cudaStream_t stream) {
+  auto nblks = ceildiv(N, TPB);
+
+  // always keep 'a' to be coprime to N
+  while (gcd(a, N) != 1) a = (a + 1) % N;
+
+  if (rowMajor) {
+    permute_impl_t<Type, IntType, IdxType, TPB, true,
+                   (16 / sizeof(Type) > 0) ? 16 / sizeof(Type)
+                                           : 1>::permuteImpl(perms, out, in, N,
+                                                             D, nblks, a, b,
+                                                             stream);
+  } else {
+    permute_impl_t<Type, IntType, IdxType, TPB, false, 1>::permuteImpl(
+      perms, out, in, N, D, nblks, a, b, stream);
+  }
+}
+
 /**
  * @brief Generate permutations of the input array. Pretty useful primitive for
  * shuffling the input datasets in ML algos. See note at the end for some of its
@@ -142,23 +164,32 @@ template <typename Type, typename IntType = int, typename IdxType = int,
           int TPB = 256>
 void permute(IntType* perms, Type* out, const Type* in, IntType D, IntType N,
              bool rowMajor, cudaStream_t stream) {
-  auto nblks = ceildiv(N, TPB);
-
-  // always keep 'a' to be coprime to N
   IdxType a = rand() % N;
-  while (gcd(a, N) != 1) a = (a + 1) % N;
   IdxType b = rand() % N;
+  permuteAffine<Type, IntType, IdxType, TPB>(perms, out, in, D, N, rowMajor,
+                                             a, b, stream);
+}
 
-  if (rowMajor) {
-    permute_impl_t<Type, IntType, IdxType, TPB, true,
-                   (16 / sizeof(Type) > 0) ? 16 / sizeof(Type)
-                                           : 1>::permuteImpl(perms, out, in, N,
-                                                             D, nblks, a, b,
-                                                             stream);
-  } else {
-    permute_impl_t<Type, IntType, IdxType, TPB, false, 1>::permuteImpl(
-      perms, out, in, N, D, nblks, a, b, stream);
-  }
+/**
+ * @brief Same as above, except that the permutation is drawn from seed and
+ * subsequence instead of rand(), so that it can be reproduced and does not
+ * depend on the other users of rand()
+ * @param seed the seed of the permutation
+ * @param subsequence picks one of the permutations of a seed, e.g. one per
+ * tree of a forest
+ */
+template <typename Type, typename IntType = int, typename IdxType = int,
+          int TPB = 256>
+void permute(IntType* perms, Type* out, const Type* in, IntType D, IntType N,
+             bool rowMajor, uint64_t seed, uint64_t subsequence,
+             cudaStream_t stream) {
+  std::seed_seq seq{uint32_t(seed), uint32_t(seed >> 32),
+                    uint32_t(subsequence), uint32_t(subsequence >> 32)};
+  std::mt19937_64 gen(seq);
+  IdxType a = gen() % N;
+  IdxType b = gen() % N;
+  permuteAffine<Type, IntType, IdxType, TPB>(perms, out, in, D, N, rowMajor,
+                                             a, b, stream);
 }
 
 };  // end namespace Random
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <thrust/copy.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <thrust/scan.h>
+#include <thrust/system/cuda/execution_policy.h>
+#include <algorithm>
+#include <cmath>
+#include <cub/cub.cuh>
+#include <memory>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "rng_impl.h"
+
+namespace MLCommon {
+namespace Random {
+
+/** maps a flat position in a row-major matrix to its row */
+template <typename IdxT>
+struct RowOfPosition {
+  IdxT n_cols;
+  HDI IdxT operator()(IdxT pos) const { return pos / n_cols; }
+};
+
+/** maps a row to the flat position of its first element */
+template <typename IdxT>
+struct StartOfRow {
+  IdxT n_cols;
+  HDI IdxT operator()(IdxT row) const { return row * n_cols; }
+};
+
+/**
+ * Draws the samples with replacement from the per-row CDFs. Sample j of row
+ * r uses the Philox subsequence r * n_samples + j, so that the result does
+ * not depend on the launch configuration.
+ */
+template <typename WeightT, typename IdxT>
+__global__ void weightedSampleKernel(IdxT *out, const WeightT *cdf,
+                                     IdxT n_rows, IdxT n_items, IdxT n_samples,
+                                     uint64_t seed, uint64_t offset) {
+  const size_t len = (size_t)n_rows * n_samples;
+  const size_t stride = (size_t)gridDim.x * blockDim.x;
+  for (size_t g = (size_t)blockIdx.x * blockDim.x + threadIdx.x; g < len;
+       g += stride) {
+    const WeightT *row = cdf + (g / n_samples) * n_items;
+    WeightT total = row[n_items - 1];
+    if (!(total > WeightT(0))) {
+      out[g] = IdxT(-1);
+      continue;
+    }
+    detail::PhiloxGenerator gen(seed, g, offset);
+    WeightT u;
+    gen.next(u);
+    // u lies in (0, 1], look for the first item whose CDF reaches u * total.
+    // Items of zero weight repeat the previous CDF value and are never hit.
+    WeightT target = u * total;
+    IdxT lo = 0, hi = n_items - 1;
+    while (lo < hi) {
+      IdxT mid = lo + (hi - lo) / 2;
+      if (row[mid] < target)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    out[g] = lo;
+  }
+}
+
+/**
+ * Computes the Efraimidis-Spirakis keys -log(u) / w of all the items, along
+ * with their positions within their row. The smallest n_samples keys of a
+ * row form a weighted sample without replacement of that row.
+ */
+template <typename WeightT, typename IdxT>
+__global__ void weightedKeysKernel(WeightT *keys, IdxT *items,
+                                   const WeightT *weights, IdxT n_rows,
+                                   IdxT n_items, uint64_t seed,
+                                   uint64_t offset) {
+  const size_t len = (size_t)n_rows * n_items;
+  const size_t stride = (size_t)gridDim.x * blockDim.x;
+  for (size_t g = (size_t)blockIdx.x * blockDim.x + threadIdx.x; g < len;
+       g += stride) {
+    detail::PhiloxGenerator gen(seed, g, offset);
+    WeightT u, w = weights[g];
+    gen.next(u);
+    keys[g] = w > WeightT(0) ? -myLog(u) / w : WeightT(INFINITY);
+    items[g] = IdxT(g % n_items);
+  }
+}
+
+/** copies the first n_samples sorted items of each row to the output */
+template <typename IdxT>
+__global__ void weightedHeadKernel(IdxT *out, const IdxT *items, IdxT n_rows,
+                                   IdxT n_items, IdxT n_samples) {
+  const size_t len = (size_t)n_rows * n_samples;
+  const size_t stride = (size_t)gridDim.x * blockDim.x;
+  for (size_t g = (size_t)blockIdx.x * blockDim.x + threadIdx.x; g < len;
+       g += stride) {
+    out[g] = items[(g / n_samples) * n_items + g % n_samples];
+  }
+}
+
+/**
+ * @brief Weighted sampling from a batch of independent discrete
+ * distributions, one per row of a row-major weight matrix.
+ *
+ * `build` computes the prefix sums of the weights of every row once, after
+ * which `sample` draws any number of indices per row with replacement in a
+ * single launch, at the cost of a binary search per draw. The weights need
+ * not be normalized. `sampleWithoutReplacement` sorts exponential keys of
+ * the weights within each row instead (see Rng::sampleWithoutReplacement),
+ * so it reads the weight matrix passed to `build`, which must stay valid.
+ *
+ * The random numbers come from a counter-based generator: every draw is
+ * addressed by (seed, position of the draw, number of earlier calls), so
+ * results are reproducible for a given seed and sequence of calls.
+ *
+ * @tparam WeightT weight type (float or double)
+ * @tparam IdxT index type
+ */
+template <typename WeightT, typename IdxT = int>
+class WeightedSampler {
+ public:
+  /**
+   * @param allocator device allocator for the CDF and the sort workspaces
+   * @param stream cuda stream
+   * @param seed random seed
+   */
+  WeightedSampler(std::shared_ptr<deviceAllocator> allocator,
+                  cudaStream_t stream, uint64_t seed)
+    : allocator(allocator),
+      cdf(allocator, stream),
+      seed(seed),
+      offset(0),
+      weights(nullptr),
+      n_rows(0),
+      n_items(0) {
+    int dev;
+    CUDA_CHECK(cudaGetDevice(&dev));
+    cudaDeviceProp props;
+    CUDA_CHECK(cudaGetDeviceProperties(&props, dev));
+    nBlocks = 4 * props.multiProcessorCount;
+  }
+
+  /**
+   * @brief (Re)build the sampler for a new set of distributions. The random
+   * sequence carries on from the previous calls.
+   * @param w row-major n_rows x n_items matrix of non-negative weights
+   * @param rows number of distributions
+   * @param items number of items of each distribution
+   * @param stream cuda stream
+   */
+  void build(const WeightT *w, IdxT rows, IdxT items, cudaStream_t stream) {
+    ASSERT(rows >= 0 && items > 0,
+           "WeightedSampler: need at least one item per distribution");
+    weights = w;
+    n_rows = rows;
+    n_items = items;
+    size_t len = (size_t)rows * items;
+    cdf.resize(len, stream);
+    auto keys = thrust::make_transform_iterator(
+      thrust::make_counting_iterator<size_t>(0),
+      RowOfPosition<size_t>{(size_t)items});
+    thrust::inclusive_scan_by_key(thrust::cuda::par.on(stream), keys,
+                                  keys + len, w, cdf.data());
+  }
+
+  /**
+   * @brief Draw n_samples indices with replacement from every distribution
+   * @param out row-major n_rows x n_samples output indices (device). Rows
+   * whose weights sum to zero get -1.
+   * @param n_samples number of draws per distribution
+   * @param stream cuda stream
+   */
+  void sample(IdxT *out, IdxT n_samples, cudaStream_t stream) {
+    if (n_rows == 0 || n_samples <= 0) return;
+    weightedSampleKernel<WeightT, IdxT><<<nBlocks, NumThreads, 0, stream>>>(
+      out, cdf.data(), n_rows, n_items, n_samples, seed, offset);
+    CUDA_CHECK(cudaPeekAtLastError());
+    advance();
+  }
+
+  /**
+   * @brief Draw n_samples distinct indices from every distribution, with
+   * probabilities proportional to the weights at each successive draw
+   * @param out row-major n_rows x n_samples output indices (device). Items
+   * of zero weight are only picked once all the others are exhausted.
+   * @param n_samples number of draws per distribution, at most n_items
+   * @param stream cuda stream
+   */
+  void sampleWithoutReplacement(IdxT *out, IdxT n_samples,
+                                cudaStream_t stream) {
+    ASSERT(n_samples <= n_items,
+           "WeightedSampler: cannot draw more than n_items without "
+           "replacement");
+    if (n_rows == 0 || n_samples <= 0) return;
+    size_t len = (size_t)n_rows * n_items;
+    device_buffer<WeightT> keys(allocator, stream, len);
+    device_buffer<WeightT> sortedKeys(allocator, stream, len);
+    device_buffer<IdxT> items(allocator, stream, len);
+    device_buffer<IdxT> sortedItems(allocator, stream, len);
+    device_buffer<int> segments(allocator, stream, n_rows + 1);
+    weightedKeysKernel<WeightT, IdxT><<<nBlocks, NumThreads, 0, stream>>>(
+      keys.data(), items.data(), weights, n_rows, n_items, seed, offset);
+    CUDA_CHECK(cudaPeekAtLastError());
+    advance();
+
+    int *seg = segments.data();
+    auto segIt = thrust::make_transform_iterator(
+      thrust::make_counting_iterator<int>(0), StartOfRow<int>{(int)n_items});
+    thrust::copy(thrust::cuda::par.on(stream), segIt, segIt + n_rows + 1,
+                 seg);
+    size_t worksize;
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairs(
+      nullptr, worksize, keys.data(), sortedKeys.data(), items.data(),
+      sortedItems.data(), (int)len, (int)n_rows, seg, seg + 1, 0,
+      sizeof(WeightT) * 8, stream));
+    device_buffer<char> workspace(allocator, stream, worksize);
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairs(
+      workspace.data(), worksize, keys.data(), sortedKeys.data(),
+      items.data(), sortedItems.data(), (int)len, (int)n_rows, seg, seg + 1,
+      0, sizeof(WeightT) * 8, stream));
+
+    weightedHeadKernel<IdxT><<<nBlocks, NumThreads, 0, stream>>>(
+      out, sortedItems.data(), n_rows, n_items, n_samples);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+
+ private:
+  /** moves the Philox offset past the numbers consumed by the last call */
+  void advance() {
+    // curand uses 2 32b uint's to generate one double
+    offset += std::max<uint64_t>(1, sizeof(WeightT) / sizeof(float));
+  }
+
+  std::shared_ptr<deviceAllocator> allocator;
+  /** per-row inclusive prefix sums of the weights */
+  device_buffer<WeightT> cdf;
+  uint64_t seed;
+  /** number of random numbers consumed in each Philox subsequence so far */
+  uint64_t offset;
+  const WeightT *weights;
+  IdxT n_rows, n_items;
+  /** number of blocks to launch */
+  int nBlocks;
+
+  static const int NumThreads = 256;
+};
+
+};  // end namespace Random
+};  // end namespace MLCommon
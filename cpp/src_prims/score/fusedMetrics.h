@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cub/cub.cuh>
+#include <memory>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "utils.h"
+
+namespace MLCommon {
+namespace Score {
+
+/**
+ * @brief Mergeable partial result of the regression metrics of one vector of
+ * predictions. Besides the error sums, it holds the mean and the sum of
+ * squared deviations of the labels, updated with Welford's method and merged
+ * with Chan's formula, so that the results of disjoint parts of the data
+ * combine without a second pass and without cancellation.
+ */
+struct RegressionStats {
+  double count;
+  double sum_abs_err;
+  double sum_sq_err;
+  double mean_y;
+  double m2_y;
+
+  HDI RegressionStats()
+    : count(0), sum_abs_err(0), sum_sq_err(0), mean_y(0), m2_y(0) {}
+
+  /** adds a sample of label y and prediction error err */
+  HDI void add(double y, double err) {
+    count += 1;
+    sum_abs_err += err < 0 ? -err : err;
+    sum_sq_err += err * err;
+    double delta = y - mean_y;
+    mean_y += delta / count;
+    m2_y += delta * (y - mean_y);
+  }
+
+  /** merges the partial result of another part of the data */
+  HDI void merge(const RegressionStats &other) {
+    if (other.count == 0) return;
+    double n = count + other.count;
+    double delta = other.mean_y - mean_y;
+    mean_y += delta * (other.count / n);
+    m2_y += other.m2_y + delta * delta * (count * other.count / n);
+    count = n;
+    sum_abs_err += other.sum_abs_err;
+    sum_sq_err += other.sum_sq_err;
+  }
+
+  /** mean absolute error */
+  double mae() const { return sum_abs_err / count; }
+  /** mean squared error */
+  double mse() const { return sum_sq_err / count; }
+  /** coefficient of determination */
+  double r2() const { return 1.0 - sum_sq_err / m2_y; }
+};
+
+/**
+ * @brief Mergeable partial result of the classification metrics of one
+ * vector of predicted labels.
+ */
+struct ClassificationStats {
+  int n_classes = 0;
+  double count = 0;
+  // n_classes x n_classes, row-major: row is the true label, column the
+  // predicted one
+  std::vector<unsigned long long> confusion;
+  // sum of the negative log-likelihoods of the true labels, if probabilities
+  // were given
+  double sum_log_loss = 0;
+
+  /** merges the partial result of another part of the data */
+  void merge(const ClassificationStats &other) {
+    ASSERT(n_classes == other.n_classes,
+           "ClassificationStats: merging different numbers of classes");
+    count += other.count;
+    sum_log_loss += other.sum_log_loss;
+    for (size_t i = 0; i < confusion.size(); ++i)
+      confusion[i] += other.confusion[i];
+  }
+
+  /** fraction of the samples whose label is predicted correctly */
+  double accuracy() const {
+    unsigned long long correct = 0;
+    for (int c = 0; c < n_classes; ++c) correct += confusion[c * n_classes + c];
+    return correct / count;
+  }
+  /** mean negative log-likelihood of the true labels */
+  double log_loss() const { return sum_log_loss / count; }
+};
+
+namespace detail {
+
+struct MergeRegressionStats {
+  HDI RegressionStats operator()(RegressionStats a,
+                                 const RegressionStats &b) const {
+    a.merge(b);
+    return a;
+  }
+};
+
+/** blocks per prediction vector: enough to fill the device, no more */
+inline int metricsBlocks(size_t n, int k, int tpb) {
+  int blocks = int(std::min<size_t>(ceildiv<size_t>(n, tpb), 1024));
+  return std::max(1, std::min(blocks, std::max(1, 1024 / std::max(k, 1))));
+}
+
+template <typename T, int TPB>
+__global__ void regressionStatsKernel(const T *y, const T *y_hat, int n,
+                                      int ld, RegressionStats *partials,
+                                      T *abs_err) {
+  const T *pred = y_hat + size_t(blockIdx.y) * ld;
+  RegressionStats s;
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x) {
+    // the error in the precision of the data, as the host references do
+    T err = pred[i] - y[i];
+    s.add(y[i], err);
+    if (abs_err != nullptr) abs_err[size_t(blockIdx.y) * n + i] = myAbs(err);
+  }
+  typedef cub::BlockReduce<RegressionStats, TPB> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp;
+  s = BlockReduce(temp).Reduce(s, MergeRegressionStats());
+  if (threadIdx.x == 0) partials[blockIdx.y * gridDim.x + blockIdx.x] = s;
+}
+
+template <typename L, typename T, int TPB>
+__global__ void classificationStatsKernel(const L *y, const L *y_pred, int n,
+                                          int ld, int n_classes,
+                                          const T *probs, size_t ld_probs,
+                                          T eps, bool smem_confusion,
+                                          unsigned long long *confusion,
+                                          double *sum_log_loss) {
+  extern __shared__ unsigned int smem[];
+  int nc2 = n_classes * n_classes;
+  const L *pred = y_pred + size_t(blockIdx.y) * ld;
+  unsigned long long *conf = confusion + size_t(blockIdx.y) * nc2;
+  if (smem_confusion) {
+    for (int i = threadIdx.x; i < nc2; i += TPB) smem[i] = 0;
+    __syncthreads();
+  }
+  const T *p = probs != nullptr ? probs + blockIdx.y * ld_probs : nullptr;
+  double loss = 0;
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x) {
+    L yi = y[i], pi = pred[i];
+    bool valid = yi >= 0 && yi < n_classes;
+    if (valid && pi >= 0 && pi < n_classes) {
+      int cell = int(yi) * n_classes + int(pi);
+      if (smem_confusion) {
+        atomicAdd(smem + cell, 1u);
+      } else {
+        atomicAdd(conf + cell, 1ull);
+      }
+    }
+    if (p != nullptr) {
+      T prob = valid ? p[size_t(i) * n_classes + int(yi)] : eps;
+      prob = prob < eps ? eps : (prob > T(1) - eps ? T(1) - eps : prob);
+      loss -= myLog(prob);
+    }
+  }
+  if (smem_confusion) {
+    __syncthreads();
+    for (int i = threadIdx.x; i < nc2; i += TPB) {
+      if (smem[i] != 0) atomicAdd(conf + i, (unsigned long long)smem[i]);
+    }
+  }
+  if (p != nullptr) {
+    typedef cub::BlockReduce<double, TPB> BlockReduce;
+    __shared__ typename BlockReduce::TempStorage temp;
+    loss = BlockReduce(temp).Sum(loss);
+    if (threadIdx.x == 0) atomicAdd(sum_log_loss + blockIdx.y, loss);
+  }
+}
+
+template <typename T, int TPB>
+__global__ void countMatchesKernel(const T *a, const T *b, int n,
+                                   unsigned long long *count) {
+  unsigned long long c = 0;
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x)
+    c += a[i] == b[i];
+  typedef cub::BlockReduce<unsigned long long, TPB> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp;
+  c = BlockReduce(temp).Sum(c);
+  if (threadIdx.x == 0) atomicAdd(count, c);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Computes the regression metrics of k vectors of predictions against
+ * one vector of labels in a single pass over the data: MSE, MAE and R^2 come
+ * from mergeable per-block partial results, and the median absolute error,
+ * if requested, from a segmented sort of the absolute errors written by the
+ * same pass.
+ * @tparam T data type
+ * @param[out] stats k partial results (host), one per prediction vector;
+ * they can be merged with the results of other parts of the data
+ * @param[out] median_abs_err k median absolute errors (host), or nullptr to
+ * skip them and their n x k temporary buffer. Medians do not merge.
+ * @param[in] y labels (device), n elements
+ * @param[in] y_hat predictions (device), k vectors of n elements
+ * @param[in] n number of samples, > 0
+ * @param[in] k number of prediction vectors
+ * @param[in] ld distance between two prediction vectors, >= n
+ * @param[in] d_alloc device allocator
+ * @param[in] stream cuda stream
+ */
+template <typename T>
+void regressionStats(RegressionStats *stats, double *median_abs_err,
+                     const T *y, const T *y_hat, int n, int k, int ld,
+                     std::shared_ptr<deviceAllocator> d_alloc,
+                     cudaStream_t stream) {
+  ASSERT(n > 0, "regressionStats: n must be positive");
+  ASSERT(ld >= n, "regressionStats: ld must be at least n");
+  if (k <= 0) return;
+  const int TPB = 256;
+  int blocks = detail::metricsBlocks(n, k, TPB);
+  device_buffer<RegressionStats> partials(d_alloc, stream, blocks * k);
+  device_buffer<T> abs_err(d_alloc, stream,
+                           median_abs_err != nullptr ? size_t(n) * k : 0);
+  dim3 grid(blocks, k);
+  detail::regressionStatsKernel<T, TPB><<<grid, TPB, 0, stream>>>(
+    y, y_hat, n, ld, partials.data(),
+    median_abs_err != nullptr ? abs_err.data() : nullptr);
+  CUDA_CHECK(cudaGetLastError());
+  std::vector<RegressionStats> h_partials(blocks * k);
+  updateHost(h_partials.data(), partials.data(), blocks * k, stream);
+
+  if (median_abs_err != nullptr) {
+    // only the middle elements of the sorted errors are copied back
+    device_buffer<T> sorted(d_alloc, stream, size_t(n) * k);
+    std::vector<int> h_offsets(k + 1);
+    for (int j = 0; j <= k; ++j) h_offsets[j] = j * n;
+    device_buffer<int> offsets(d_alloc, stream, k + 1);
+    updateDevice(offsets.data(), h_offsets.data(), k + 1, stream);
+    size_t temp_bytes = 0;
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortKeys(
+      nullptr, temp_bytes, abs_err.data(), sorted.data(), n * k, k,
+      offsets.data(), offsets.data() + 1, 0, 8 * sizeof(T), stream));
+    device_buffer<char> temp(d_alloc, stream, temp_bytes);
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortKeys(
+      temp.data(), temp_bytes, abs_err.data(), sorted.data(), n * k, k,
+      offsets.data(), offsets.data() + 1, 0, 8 * sizeof(T), stream));
+    int lo = (n - 1) / 2;
+    std::vector<T> middle(2 * k);
+    for (int j = 0; j < k; ++j) {
+      updateHost(middle.data() + 2 * j, sorted.data() + size_t(j) * n + lo,
+                 n % 2 == 1 ? 1 : 2, stream);
+    }
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    for (int j = 0; j < k; ++j) {
+      median_abs_err[j] =
+        n % 2 == 1 ? double(middle[2 * j])
+                   : (double(middle[2 * j]) + double(middle[2 * j + 1])) / 2;
+    }
+  } else {
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  for (int j = 0; j < k; ++j) {
+    stats[j] = RegressionStats();
+    for (int b = 0; b < blocks; ++b) stats[j].merge(h_partials[j * blocks + b]);
+  }
+}
+
+/**
+ * @brief Computes the classification metrics of k vectors of predicted labels
+ * against one vector of true labels in a single pass over the data: the
+ * confusion matrix (hence the accuracy) and, if the predicted probabilities
+ * are given, the log-loss. The confusion matrix is accumulated in shared
+ * memory when it fits.
+ * @tparam L label type
+ * @tparam T probability type
+ * @param[out] stats k partial results (host), one per prediction vector;
+ * they can be merged with the results of other parts of the data
+ * @param[in] y true labels (device), n elements in [0, n_classes). Samples
+ * with a label out of range are not in the confusion matrix, count as
+ * misclassified and have the log-loss of probability eps.
+ * @param[in] y_pred predicted labels (device), k vectors of n elements
+ * @param[in] n number of samples, > 0
+ * @param[in] k number of prediction vectors
+ * @param[in] ld distance between two vectors of predicted labels, >= n
+ * @param[in] n_classes number of classes
+ * @param[in] probs predicted probabilities (device), k row-major n x
+ * n_classes matrices, or nullptr to skip the log-loss
+ * @param[in] ld_probs distance between two matrices of probabilities
+ * @param[in] eps probabilities are clipped to [eps, 1 - eps]
+ * @param[in] d_alloc device allocator
+ * @param[in] stream cuda stream
+ */
+template <typename L, typename T = float>
+void classificationStats(ClassificationStats *stats, const L *y,
+                         const L *y_pred, int n, int k, int ld, int n_classes,
+                         const T *probs, size_t ld_probs, T eps,
+                         std::shared_ptr<deviceAllocator> d_alloc,
+                         cudaStream_t stream) {
+  ASSERT(n > 0, "classificationStats: n must be positive");
+  ASSERT(ld >= n, "classificationStats: ld must be at least n");
+  ASSERT(n_classes > 0, "classificationStats: n_classes must be positive");
+  if (k <= 0) return;
+  const int TPB = 256;
+  size_t nc2 = size_t(n_classes) * n_classes;
+  device_buffer<unsigned long long> confusion(d_alloc, stream, nc2 * k);
+  device_buffer<double> sum_log_loss(d_alloc, stream, k);
+  CUDA_CHECK(cudaMemsetAsync(confusion.data(), 0,
+                             nc2 * k * sizeof(unsigned long long), stream));
+  CUDA_CHECK(cudaMemsetAsync(sum_log_loss.data(), 0, k * sizeof(double),
+                             stream));
+  size_t smem = nc2 * sizeof(unsigned int);
+  bool smem_confusion = smem <= 32 * 1024;
+  dim3 grid(detail::metricsBlocks(n, k, TPB), k);
+  detail::classificationStatsKernel<L, T, TPB>
+    <<<grid, TPB, smem_confusion ? smem : 0, stream>>>(
+      y, y_pred, n, ld, n_classes, probs, ld_probs, eps, smem_confusion,
+      confusion.data(), sum_log_loss.data());
+  CUDA_CHECK(cudaGetLastError());
+
+  std::vector<double> h_log_loss(k);
+  updateHost(h_log_loss.data(), sum_log_loss.data(), k, stream);
+  for (int j = 0; j < k; ++j) {
+    stats[j].n_classes = n_classes;
+    stats[j].count = n;
+    stats[j].sum_log_loss = 0;
+    stats[j].confusion.resize(nc2);
+    updateHost(stats[j].confusion.data(), confusion.data() + j * nc2, nc2,
+               stream);
+  }
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  if (probs != nullptr) {
+    for (int j = 0; j < k; ++j) stats[j].sum_log_loss = h_log_loss[j];
+  }
+}
+
+/**
+ * @brief Counts the positions where two device arrays are equal, without
+ * temporary arrays.
+ */
+template <typename T>
+unsigned long long countMatches(const T *a, const T *b, int n,
+                                std::shared_ptr<deviceAllocator> d_alloc,
+                                cudaStream_t stream) {
+  if (n <= 0) return 0;
+  const int TPB = 256;
+  device_buffer<unsigned long long> count(d_alloc, stream, 1);
+  CUDA_CHECK(
+    cudaMemsetAsync(count.data(), 0, sizeof(unsigned long long), stream));
+  detail::countMatchesKernel<T, TPB>
+    <<<detail::metricsBlocks(n, 1, TPB), TPB, 0, stream>>>(a, b, n,
+                                                           count.data());
+  CUDA_CHECK(cudaGetLastError());
+  unsigned long long h_count;
+  updateHost(&h_count, count.data(), 1, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  return h_count;
+}
+
+}  // namespace Score
+}  // namespace MLCommon
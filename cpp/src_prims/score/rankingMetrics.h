@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <limits.h>
+#include <algorithm>
+#include <cub/cub.cuh>
+#include <memory>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "score/fusedMetrics.h"
+#include "utils.h"
+
+namespace MLCommon {
+namespace Score {
+
+/**
+ * @brief Mergeable histogram of the scores of the positive and the negative
+ * samples, for the approximate ranking metrics of data seen in chunks. The
+ * bins split [lo, hi] uniformly; scores out of the range fall in the first
+ * or the last bin. The metrics treat each bin as a group of tied scores, so
+ * they are exact when there are no more distinct scores than bins, and
+ * otherwise converge to the exact values as the bins get narrower.
+ */
+struct ScoreHistogram {
+  double lo, hi;
+  int n_bins;
+  std::vector<unsigned long long> positives, negatives;
+
+  ScoreHistogram(double lo = 0.0, double hi = 1.0, int n_bins = 1000)
+    : lo(lo), hi(hi), n_bins(n_bins), positives(n_bins), negatives(n_bins) {
+    ASSERT(n_bins > 0, "ScoreHistogram: n_bins must be positive");
+    ASSERT(hi > lo, "ScoreHistogram: the range must not be empty");
+  }
+
+  void merge(const ScoreHistogram &other) {
+    ASSERT(lo == other.lo && hi == other.hi && n_bins == other.n_bins,
+           "ScoreHistogram: merging histograms with different bins");
+    for (int b = 0; b < n_bins; ++b) {
+      positives[b] += other.positives[b];
+      negatives[b] += other.negatives[b];
+    }
+  }
+
+  /** area under the ROC curve */
+  double roc_auc() const {
+    double tp = 0, fp = 0, area = 0;
+    for (int b = n_bins - 1; b >= 0; --b) {
+      area += negatives[b] * (2 * tp + positives[b]);
+      tp += positives[b];
+      fp += negatives[b];
+    }
+    ASSERT(tp > 0 && fp > 0, "roc_auc: only one class is present");
+    return area / (2 * tp * fp);
+  }
+
+  /** average precision, the area under the precision-recall curve */
+  double average_precision() const {
+    double tp = 0, fp = 0, sum = 0;
+    for (int b = n_bins - 1; b >= 0; --b) {
+      tp += positives[b];
+      fp += negatives[b];
+      if (positives[b] > 0) sum += positives[b] * tp / (tp + fp);
+    }
+    ASSERT(tp > 0, "average_precision: there are no positive samples");
+    return sum / tp;
+  }
+};
+
+namespace detail {
+
+/** positive labels and heads of the groups of tied scores, once sorted */
+template <typename T>
+__global__ void rankingTiesKernel(const T *sorted, const unsigned char *labels,
+                                  int n, int ld, int *cum_pos, int *heads) {
+  int seg = blockIdx.y * ld;
+  for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < n;
+       i += blockDim.x * gridDim.x) {
+    int idx = seg + i;
+    cum_pos[idx] = labels[idx];
+    heads[idx] = i == 0 || sorted[idx] != sorted[idx - 1] ? idx : seg;
+  }
+}
+
+/** ROC and precision-recall areas, one trapezoid per group of tied scores;
+ *  heads holds the first index of the group of each element, and cum_pos the
+ *  number of positives up to each element */
+template <typename T, int TPB>
+__global__ void rankingAreasKernel(const T *sorted, const int *cum_pos,
+                                   const int *heads, int n, int ld,
+                                   double *roc_area, double *ap_sum) {
+  int seg = blockIdx.y * ld;
+  int base = seg > 0 ? cum_pos[seg - 1] : 0;
+  double roc = 0, ap = 0;
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x) {
+    int idx = seg + i;
+    if (i < n - 1 && sorted[idx] == sorted[idx + 1]) continue;
+    // the last element of the previous group, seg - 1 if there is none
+    int prev = heads[idx] - 1;
+    double tp = cum_pos[idx] - base, fp = i + 1 - tp;
+    double tp_prev = prev >= seg ? cum_pos[prev] - base : 0;
+    double fp_prev = prev - seg + 1 - tp_prev;
+    roc += (fp - fp_prev) * (tp + tp_prev);
+    ap += (tp - tp_prev) * tp / (tp + fp);
+  }
+  typedef cub::BlockReduce<double, TPB> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp;
+  roc = BlockReduce(temp).Sum(roc);
+  __syncthreads();
+  ap = BlockReduce(temp).Sum(ap);
+  if (threadIdx.x == 0) {
+    atomicAdd(roc_area + blockIdx.y, roc);
+    atomicAdd(ap_sum + blockIdx.y, ap);
+  }
+}
+
+template <typename L>
+__global__ void rankingLabelsKernel(const L *y, int n, int ld,
+                                    unsigned char *labels) {
+  unsigned char *out = labels + blockIdx.y * ld;
+  for (int i = threadIdx.x + blockIdx.x * blockDim.x; i < n;
+       i += blockDim.x * gridDim.x)
+    out[i] = y[i] != L(0);
+}
+
+/** per-bin counts of the positive and negative samples, in shared memory
+ *  when the histogram fits */
+template <typename L, typename T, int TPB>
+__global__ void scoreHistogramKernel(const L *y, const T *scores, int n,
+                                     int ld, double lo, double scale,
+                                     int n_bins, bool smem_hist,
+                                     unsigned long long *positives,
+                                     unsigned long long *negatives) {
+  extern __shared__ unsigned int smem[];
+  const T *s = scores + size_t(blockIdx.y) * ld;
+  unsigned long long *pos = positives + size_t(blockIdx.y) * n_bins;
+  unsigned long long *neg = negatives + size_t(blockIdx.y) * n_bins;
+  if (smem_hist) {
+    for (int b = threadIdx.x; b < 2 * n_bins; b += TPB) smem[b] = 0;
+    __syncthreads();
+  }
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x) {
+    double v = (s[i] - lo) * scale;
+    // NaN scores are not counted
+    if (!(v == v)) continue;
+    int b = v < 0 ? 0 : (v >= n_bins ? n_bins - 1 : int(v));
+    bool positive = y[i] != L(0);
+    if (smem_hist) {
+      atomicAdd(smem + (positive ? b : n_bins + b), 1u);
+    } else {
+      atomicAdd((positive ? pos : neg) + b, 1ull);
+    }
+  }
+  if (smem_hist) {
+    __syncthreads();
+    for (int b = threadIdx.x; b < n_bins; b += TPB) {
+      if (smem[b] != 0) atomicAdd(pos + b, (unsigned long long)smem[b]);
+      if (smem[n_bins + b] != 0)
+        atomicAdd(neg + b, (unsigned long long)smem[n_bins + b]);
+    }
+  }
+}
+
+/** per-bin counts, positives and sums of the predicted probabilities */
+template <typename L, typename T, int TPB>
+__global__ void calibrationKernel(const L *y, const T *probs, int n, int ld,
+                                  int n_bins, bool smem_hist,
+                                  unsigned long long *counts,
+                                  unsigned long long *positives,
+                                  double *sum_probs) {
+  extern __shared__ double smem_sums[];
+  unsigned int *smem_counts = (unsigned int *)(smem_sums + n_bins);
+  const T *p = probs + size_t(blockIdx.y) * ld;
+  size_t offset = size_t(blockIdx.y) * n_bins;
+  if (smem_hist) {
+    for (int b = threadIdx.x; b < n_bins; b += TPB) {
+      smem_sums[b] = 0;
+      smem_counts[b] = 0;
+      smem_counts[n_bins + b] = 0;
+    }
+    __syncthreads();
+  }
+  for (int i = threadIdx.x + blockIdx.x * TPB; i < n; i += TPB * gridDim.x) {
+    T prob = p[i];
+    if (!(prob == prob)) continue;
+    int b = prob <= T(0) ? 0 : min(int(prob * n_bins), n_bins - 1);
+    unsigned int positive = y[i] != L(0);
+    if (smem_hist) {
+      atomicAdd(smem_sums + b, double(prob));
+      atomicAdd(smem_counts + b, 1u);
+      atomicAdd(smem_counts + n_bins + b, positive);
+    } else {
+      atomicAdd(sum_probs + offset + b, double(prob));
+      atomicAdd(counts + offset + b, 1ull);
+      atomicAdd(positives + offset + b, (unsigned long long)positive);
+    }
+  }
+  if (smem_hist) {
+    __syncthreads();
+    for (int b = threadIdx.x; b < n_bins; b += TPB) {
+      if (smem_counts[b] == 0) continue;
+      atomicAdd(sum_probs + offset + b, smem_sums[b]);
+      atomicAdd(counts + offset + b, (unsigned long long)smem_counts[b]);
+      atomicAdd(positives + offset + b,
+                (unsigned long long)smem_counts[n_bins + b]);
+    }
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Computes the exact area under the ROC curve and the average
+ * precision (the area under the precision-recall curve, as a step function)
+ * of k score vectors against one vector of binary labels. Each score vector
+ * is sorted with a segmented radix sort, the positives are counted with a
+ * scan, and every group of tied scores contributes one trapezoid, so tied
+ * scores are handled as by sklearn's roc_auc_score and
+ * average_precision_score. Several score vectors are sorted at once, as
+ * long as they span fewer than INT_MAX elements.
+ * @tparam L label type
+ * @tparam T score type
+ * @param[out] roc_auc k ROC-AUC values (host), or nullptr
+ * @param[out] average_precision k average precisions (host), or nullptr
+ * @param[in] y labels (device), n elements; nonzero labels are positive.
+ * Both classes have to be present.
+ * @param[in] scores scores (device), k vectors of n elements; NaN scores are
+ * not supported
+ * @param[in] n number of samples, > 0
+ * @param[in] k number of score vectors
+ * @param[in] ld distance between two score vectors, >= n
+ * @param[in] d_alloc device allocator
+ * @param[in] stream cuda stream
+ */
+template <typename L, typename T>
+void rankingScores(double *roc_auc, double *average_precision, const L *y,
+                   const T *scores, int n, int k, int ld,
+                   std::shared_ptr<deviceAllocator> d_alloc,
+                   cudaStream_t stream) {
+  ASSERT(n > 0, "rankingScores: n must be positive");
+  ASSERT(ld >= n, "rankingScores: ld must be at least n");
+  if (k <= 0) return;
+  const int TPB = 256;
+  // score vectors sorted at once, within the int offsets of cub
+  int batch = std::min<size_t>(k, size_t(INT_MAX - n) / ld + 1);
+  size_t span = size_t(batch - 1) * ld + n;
+  device_buffer<T> sorted(d_alloc, stream, span);
+  device_buffer<unsigned char> labels(d_alloc, stream, span);
+  device_buffer<unsigned char> sorted_labels(d_alloc, stream, span);
+  device_buffer<int> cum_pos(d_alloc, stream, span);
+  device_buffer<int> heads(d_alloc, stream, span);
+  device_buffer<double> areas(d_alloc, stream, 2 * batch);
+  std::vector<int> h_offsets(2 * batch);
+  for (int j = 0; j < batch; ++j) {
+    h_offsets[j] = j * ld;
+    h_offsets[batch + j] = j * ld + n;
+  }
+  device_buffer<int> offsets(d_alloc, stream, 2 * batch);
+  updateDevice(offsets.data(), h_offsets.data(), 2 * batch, stream);
+
+  // the labels are the same for all score vectors
+  CUDA_CHECK(cudaMemsetAsync(labels.data(), 0, span, stream));
+  int blocks = detail::metricsBlocks(n, batch, TPB);
+  detail::rankingLabelsKernel<L>
+    <<<dim3(blocks, batch), TPB, 0, stream>>>(y, n, ld, labels.data());
+  CUDA_CHECK(cudaGetLastError());
+
+  size_t sort_bytes = 0, sum_bytes = 0, max_bytes = 0;
+  CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+    nullptr, sort_bytes, scores, sorted.data(), labels.data(),
+    sorted_labels.data(), span, batch, offsets.data(),
+    offsets.data() + batch, 0, 8 * sizeof(T), stream));
+  CUDA_CHECK(cub::DeviceScan::InclusiveSum(nullptr, sum_bytes, cum_pos.data(),
+                                           cum_pos.data(), span, stream));
+  CUDA_CHECK(cub::DeviceScan::InclusiveScan(nullptr, max_bytes, heads.data(),
+                                            heads.data(), cub::Max(), span,
+                                            stream));
+  size_t temp_bytes = std::max(sort_bytes, std::max(sum_bytes, max_bytes));
+  device_buffer<char> temp(d_alloc, stream, temp_bytes);
+
+  int n_pos = 0;
+  std::vector<double> h_areas(2 * batch);
+  for (int j0 = 0; j0 < k; j0 += batch) {
+    int bk = std::min(batch, k - j0);
+    int bspan = (bk - 1) * ld + n;
+    if (ld > n || j0 == 0) {
+      // the gaps between score vectors are scanned too, and must not carry
+      // counts or heads
+      CUDA_CHECK(
+        cudaMemsetAsync(cum_pos.data(), 0, bspan * sizeof(int), stream));
+      CUDA_CHECK(cudaMemsetAsync(heads.data(), 0, bspan * sizeof(int), stream));
+    }
+    size_t bytes = temp.size();
+    CUDA_CHECK(cub::DeviceSegmentedRadixSort::SortPairsDescending(
+      temp.data(), bytes, scores + size_t(j0) * ld, sorted.data(),
+      labels.data(), sorted_labels.data(), bspan, bk, offsets.data(),
+      offsets.data() + batch, 0, 8 * sizeof(T), stream));
+    dim3 grid(detail::metricsBlocks(n, bk, TPB), bk);
+    detail::rankingTiesKernel<T><<<grid, TPB, 0, stream>>>(
+      sorted.data(), sorted_labels.data(), n, ld, cum_pos.data(),
+      heads.data());
+    CUDA_CHECK(cudaGetLastError());
+    bytes = temp.size();
+    CUDA_CHECK(cub::DeviceScan::InclusiveSum(
+      temp.data(), bytes, cum_pos.data(), cum_pos.data(), bspan, stream));
+    bytes = temp.size();
+    CUDA_CHECK(cub::DeviceScan::InclusiveScan(temp.data(), bytes,
+                                              heads.data(), heads.data(),
+                                              cub::Max(), bspan, stream));
+    CUDA_CHECK(
+      cudaMemsetAsync(areas.data(), 0, 2 * batch * sizeof(double), stream));
+    detail::rankingAreasKernel<T, TPB><<<grid, TPB, 0, stream>>>(
+      sorted.data(), cum_pos.data(), heads.data(), n, ld, areas.data(),
+      areas.data() + batch);
+    CUDA_CHECK(cudaGetLastError());
+    if (j0 == 0) updateHost(&n_pos, cum_pos.data() + n - 1, 1, stream);
+    updateHost(h_areas.data(), areas.data(), 2 * batch, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    double pos = n_pos, neg = n - n_pos;
+    ASSERT(n_pos > 0 && n_pos < n, "rankingScores: only one class is present");
+    for (int j = 0; j < bk; ++j) {
+      if (roc_auc != nullptr) roc_auc[j0 + j] = h_areas[j] / (2 * pos * neg);
+      if (average_precision != nullptr)
+        average_precision[j0 + j] = h_areas[batch + j] / pos;
+    }
+  }
+}
+
+/**
+ * @brief Accumulates the scores of k score vectors into k histograms, for
+ * the approximate ranking metrics of data streamed in chunks: one call per
+ * chunk, with a single pass over the data and no sort.
+ * @tparam L label type
+ * @tparam T score type
+ * @param[inout] hists k histograms (host), all with the same bins; the counts
+ * of this chunk are added to them
+ * @param[in] y labels (device), n elements; nonzero labels are positive
+ * @param[in] scores scores (device), k vectors of n elements
+ * @param[in] n number of samples in the chunk
+ * @param[in] k number of score vectors
+ * @param[in] ld distance between two score vectors, >= n
+ * @param[in] d_alloc device allocator
+ * @param[in] stream cuda stream
+ */
+template <typename L, typename T>
+void scoreHistogram(ScoreHistogram *hists, const L *y, const T *scores, int n,
+                    int k, int ld, std::shared_ptr<deviceAllocator> d_alloc,
+                    cudaStream_t stream) {
+  ASSERT(ld >= n, "scoreHistogram: ld must be at least n");
+  if (n <= 0 || k <= 0) return;
+  const ScoreHistogram &h = hists[0];
+  for (int j = 1; j < k; ++j) {
+    ASSERT(hists[j].lo == h.lo && hists[j].hi == h.hi &&
+             hists[j].n_bins == h.n_bins,
+           "scoreHistogram: the histograms have different bins");
+  }
+  const int TPB = 256;
+  size_t nb = size_t(h.n_bins) * k;
+  device_buffer<unsigned long long> counts(d_alloc, stream, 2 * nb);
+  CUDA_CHECK(cudaMemsetAsync(counts.data(), 0,
+                             2 * nb * sizeof(unsigned long long), stream));
+  size_t smem = 2 * h.n_bins * sizeof(unsigned int);
+  bool smem_hist = smem <= 32 * 1024;
+  dim3 grid(detail::metricsBlocks(n, k, TPB), k);
+  detail::scoreHistogramKernel<L, T, TPB>
+    <<<grid, TPB, smem_hist ? smem : 0, stream>>>(
+      y, scores, n, ld, h.lo, h.n_bins / (h.hi - h.lo), h.n_bins, smem_hist,
+      counts.data(), counts.data() + nb);
+  CUDA_CHECK(cudaGetLastError());
+  std::vector<unsigned long long> h_counts(2 * nb);
+  updateHost(h_counts.data(), counts.data(), 2 * nb, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  for (int j = 0; j < k; ++j) {
+    for (int b = 0; b < h.n_bins; ++b) {
+      hists[j].positives[b] += h_counts[j * h.n_bins + b];
+      hists[j].negatives[b] += h_counts[nb + j * h.n_bins + b];
+    }
+  }
+}
+
+/**
+ * @brief Computes the calibration curves of k vectors of predicted
+ * probabilities: for each of n_bins uniform bins of [0, 1], the fraction of
+ * positive samples and the mean predicted probability. Bin b holds the
+ * probabilities in [b / n_bins, (b + 1) / n_bins), and the last bin also
+ * holds 1.
+ * @tparam L label type
+ * @tparam T probability type
+ * @param[out] prob_true k x n_bins fractions of positives (host), 0 for the
+ * empty bins
+ * @param[out] prob_pred k x n_bins mean probabilities (host), 0 for the
+ * empty bins
+ * @param[out] counts k x n_bins sample counts (host), or nullptr
+ * @param[in] y labels (device), n elements; nonzero labels are positive
+ * @param[in] probs predicted probabilities (device), k vectors of n elements
+ * @param[in] n number of samples
+ * @param[in] k number of probability vectors
+ * @param[in] ld distance between two probability vectors, >= n
+ * @param[in] n_bins number of bins
+ * @param[in] d_alloc device allocator
+ * @param[in] stream cuda stream
+ */
+template <typename L, typename T>
+void calibrationCurve(double *prob_true, double *prob_pred,
+                      unsigned long long *counts, const L *y, const T *probs,
+                      int n, int k, int ld, int n_bins,
+                      std::shared_ptr<deviceAllocator> d_alloc,
+                      cudaStream_t stream) {
+  ASSERT(ld >= n, "calibrationCurve: ld must be at least n");
+  ASSERT(n_bins > 0, "calibrationCurve: n_bins must be positive");
+  if (k <= 0) return;
+  const int TPB = 256;
+  size_t nb = size_t(n_bins) * k;
+  device_buffer<unsigned long long> d_counts(d_alloc, stream, 2 * nb);
+  device_buffer<double> d_sums(d_alloc, stream, nb);
+  CUDA_CHECK(cudaMemsetAsync(d_counts.data(), 0,
+                             2 * nb * sizeof(unsigned long long), stream));
+  CUDA_CHECK(cudaMemsetAsync(d_sums.data(), 0, nb * sizeof(double), stream));
+  if (n > 0) {
+    size_t smem = n_bins * (sizeof(double) + 2 * sizeof(unsigned int));
+    bool smem_hist = smem <= 32 * 1024;
+    dim3 grid(detail::metricsBlocks(n, k, TPB), k);
+    detail::calibrationKernel<L, T, TPB>
+      <<<grid, TPB, smem_hist ? smem : 0, stream>>>(
+        y, probs, n, ld, n_bins, smem_hist, d_counts.data(),
+        d_counts.data() + nb, d_sums.data());
+    CUDA_CHECK(cudaGetLastError());
+  }
+  std::vector<unsigned long long> h_counts(2 * nb);
+  std::vector<double> h_sums(nb);
+  updateHost(h_counts.data(), d_counts.data(), 2 * nb, stream);
+  updateHost(h_sums.data(), d_sums.data(), nb, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  for (size_t b = 0; b < nb; ++b) {
+    double count = h_counts[b];
+    prob_true[b] = count > 0 ? h_counts[nb + b] / count : 0.0;
+    prob_pred[b] = count > 0 ? h_sums[b] / count : 0.0;
+    if (counts != nullptr) counts[b] = h_counts[b];
+  }
+}
+
+}  // namespace Score
+}  // namespace MLCommon
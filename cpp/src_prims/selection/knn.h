@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "common/host_buffer.hpp"
 #include "cuda_utils.h"
 
 #include <faiss/Heap.h>
@@ -25,7 +28,13 @@
 #include <faiss/gpu/IndexProxy.h>
 #include <faiss/gpu/StandardGpuResources.h>
 
+#include <thrust/fill.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include <cfloat>
+#include <cstring>
 #include <iostream>
+#include <memory>
 
 namespace MLCommon {
 namespace Selection {
@@ -190,5 +199,264 @@ void brute_force_knn(float **input, int *sizes, int n_params, IntType D,
   delete result_I;
 };
 
+/**
+ * Merges, for each row, the k nearest neighbors found so far with the
+ * kb nearest neighbors of a new tile (both sorted by distance) into the
+ * k nearest of both. Tile indices are shifted by b_offset, and negative
+ * indices mark empty slots. On ties the neighbors found so far come first.
+ */
+template <typename value_t>
+__global__ void knn_merge_sorted_kernel(value_t *outD, long *outI,
+                                        const value_t *aD, const long *aI,
+                                        const value_t *bD, const long *bI,
+                                        int kb, long b_offset, int n_rows,
+                                        int k) {
+  int row = threadIdx.x + blockIdx.x * blockDim.x;
+  if (row >= n_rows) return;
+  aD += (size_t)row * k;
+  aI += (size_t)row * k;
+  bD += (size_t)row * kb;
+  bI += (size_t)row * kb;
+  outD += (size_t)row * k;
+  outI += (size_t)row * k;
+  int ia = 0, ib = 0;
+  for (int j = 0; j < k; j++) {
+    bool has_a = ia < k && aI[ia] >= 0, has_b = ib < kb && bI[ib] >= 0;
+    if (has_a && (!has_b || aD[ia] <= bD[ib])) {
+      outD[j] = aD[ia];
+      outI[j] = aI[ia++];
+    } else if (has_b) {
+      outD[j] = bD[ib];
+      outI[j] = bI[ib++] + b_offset;
+    } else {
+      outD[j] = FLT_MAX;
+      outI[j] = -1;
+    }
+  }
+}
+
+/**
+ * @brief Search the k nearest neighbors of a set of device query vectors
+ * in an index that lives in host memory (pageable, pinned or memory-mapped).
+ *
+ * The index is streamed through the device in tiles of tile_rows rows with
+ * two pinned staging buffers: while the brute force search runs on tile t
+ * in stream, tile t + 1 is packed into pinned memory on the host and its
+ * transfer is issued in copy_stream. A running top-k per query is merged
+ * with the result of each tile on device, so the device memory used is
+ * 2 x tile_rows x D for the tiles and 4 x n x k for the results, whatever
+ * the size of the index.
+ *
+ * @param index host pointer to the row-major index, n_index x D
+ * @param n_index number of rows in the index
+ * @param D number of cols in index and search_items
+ * @param search_items set of vectors to query for neighbors (device)
+ * @param n number of items in search_items
+ * @param res_I pointer to device memory for returning k nearest indices
+ * @param res_D pointer to device memory for returning k nearest distances
+ * @param k number of neighbors to query
+ * @param d_alloc device allocator for the tiles and intermediate results
+ * @param h_alloc host allocator for the pinned staging buffers
+ * @param stream the cuda stream used for the search
+ * @param copy_stream the cuda stream used for the host to device transfers
+ * @param tile_rows number of index rows transferred at once
+ */
+template <typename IntType = int>
+void brute_force_knn_host(const float *index, long n_index, IntType D,
+                          float *search_items, IntType n, long *res_I,
+                          float *res_D, IntType k,
+                          std::shared_ptr<deviceAllocator> d_alloc,
+                          std::shared_ptr<hostAllocator> h_alloc,
+                          cudaStream_t stream, cudaStream_t copy_stream,
+                          long tile_rows) {
+  constexpr int TPB = 256;
+  ASSERT(tile_rows > 0, "brute_force_knn_host: tile_rows must be > 0");
+  ASSERT(k <= 1024, "brute_force_knn_host: k must be <= 1024");
+  ASSERT_DEVICE_MEM(search_items, "search items");
+  ASSERT_DEVICE_MEM(res_I, "output index array");
+  ASSERT_DEVICE_MEM(res_D, "output distance array");
+  if (n == 0) return;
+  tile_rows = std::min(tile_rows, std::max(n_index, 1L));
+  size_t tile_len = tile_rows * D, res_len = size_t(n) * k;
+
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  faiss::gpu::StandardGpuResources gpu_res;
+  gpu_res.noTempMemory();
+  gpu_res.setCudaMallocWarning(false);
+  gpu_res.setDefaultStream(device, stream);
+
+  device_buffer<float> tile0(d_alloc, stream, tile_len);
+  device_buffer<float> tile1(d_alloc, stream, tile_len);
+  host_buffer<float> pinned0(h_alloc, stream, tile_len);
+  host_buffer<float> pinned1(h_alloc, stream, tile_len);
+  float *tiles[2] = {tile0.data(), tile1.data()};
+  float *pinned[2] = {pinned0.data(), pinned1.data()};
+  device_buffer<float> tile_D(d_alloc, stream, res_len);
+  device_buffer<long> tile_I(d_alloc, stream, res_len);
+  device_buffer<float> tmp_D(d_alloc, stream, res_len);
+  device_buffer<long> tmp_I(d_alloc, stream, res_len);
+  float *cur_D = res_D, *nxt_D = tmp_D.data();
+  long *cur_I = res_I, *nxt_I = tmp_I.data();
+  auto exec = thrust::cuda::par.on(stream);
+  thrust::fill(exec, cur_D, cur_D + res_len, FLT_MAX);
+  thrust::fill(exec, cur_I, cur_I + res_len, -1L);
+
+  cudaEvent_t copied[2], consumed[2];
+  for (int b = 0; b < 2; b++) {
+    CUDA_CHECK(cudaEventCreateWithFlags(&copied[b], cudaEventDisableTiming));
+    CUDA_CHECK(cudaEventCreateWithFlags(&consumed[b], cudaEventDisableTiming));
+  }
+  // the staging buffers must not be reused before the previous work
+  // on the stream (including their allocation) is done
+  CUDA_CHECK(cudaEventRecord(consumed[0], stream));
+  CUDA_CHECK(cudaEventRecord(consumed[1], stream));
+
+  long n_tiles = ceildiv(n_index, tile_rows);
+  for (long t = 0; t < n_tiles; t++) {
+    int b = t % 2;
+    long offset = t * tile_rows;
+    long rows = std::min(tile_rows, n_index - offset);
+    // pinned[b] is free once the transfer of tile t - 2 has completed, the
+    // packing of tile t then overlaps with the search on tile t - 1
+    if (t >= 2) CUDA_CHECK(cudaEventSynchronize(copied[b]));
+    std::memcpy(pinned[b], index + offset * D, rows * D * sizeof(float));
+    CUDA_CHECK(cudaStreamWaitEvent(copy_stream, consumed[b], 0));
+    CUDA_CHECK(cudaMemcpyAsync(tiles[b], pinned[b], rows * D * sizeof(float),
+                               cudaMemcpyHostToDevice, copy_stream));
+    CUDA_CHECK(cudaEventRecord(copied[b], copy_stream));
+    CUDA_CHECK(cudaStreamWaitEvent(stream, copied[b], 0));
+
+    int kb = std::min<long>(k, rows);
+    faiss::gpu::bruteForceKnn(&gpu_res, faiss::METRIC_L2, tiles[b], rows,
+                              search_items, n, D, kb, tile_D.data(),
+                              tile_I.data());
+    knn_merge_sorted_kernel<<<ceildiv<int>(n, TPB), TPB, 0, stream>>>(
+      nxt_D, nxt_I, cur_D, cur_I, tile_D.data(), tile_I.data(), kb, offset, n,
+      k);
+    CUDA_CHECK(cudaPeekAtLastError());
+    CUDA_CHECK(cudaEventRecord(consumed[b], stream));
+    std::swap(cur_D, nxt_D);
+    std::swap(cur_I, nxt_I);
+  }
+  if (cur_D != res_D) {
+    copy(res_D, cur_D, res_len, stream);
+    copy(res_I, cur_I, res_len, stream);
+  }
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  for (int b = 0; b < 2; b++) {
+    CUDA_CHECK(cudaEventDestroy(copied[b]));
+    CUDA_CHECK(cudaEventDestroy(consumed[b]));
+  }
+}
+
+/**
+ * Voting weight of the neighbor j of a row. With distance weighting the
+ * weight is the inverse euclidean distance, except for rows having exact
+ * matches where only the exact matches vote.
+ */
+DI float knn_neighbor_weight(const float *dists, int j, bool distance_weighted,
+                             bool has_exact) {
+  if (!distance_weighted) return 1.f;
+  if (has_exact) return dists[j] == 0.f ? 1.f : 0.f;
+  return 1.f / sqrtf(dists[j]);
+}
+
+DI bool knn_row_has_exact(const long *idx, const float *dists, int k) {
+  for (int j = 0; j < k; j++)
+    if (idx[j] >= 0 && dists[j] == 0.f) return true;
+  return false;
+}
+
+template <typename LabelT>
+__global__ void knn_class_vote_kernel(int *out, float *probs,
+                                      const long *knn_indices,
+                                      const float *knn_dists, const LabelT *y,
+                                      int n_rows, int n_classes, int k,
+                                      bool distance_weighted) {
+  int row = threadIdx.x + blockIdx.x * blockDim.x;
+  if (row >= n_rows) return;
+  const long *idx = knn_indices + (size_t)row * k;
+  const float *dists = knn_dists + (size_t)row * k;
+  float *p = probs + (size_t)row * n_classes;
+  for (int c = 0; c < n_classes; c++) p[c] = 0.f;
+
+  bool has_exact = distance_weighted && knn_row_has_exact(idx, dists, k);
+  float total = 0.f;
+  for (int j = 0; j < k; j++) {
+    if (idx[j] < 0) continue;
+    float w = knn_neighbor_weight(dists, j, distance_weighted, has_exact);
+    p[int(y[idx[j]])] += w;
+    total += w;
+  }
+
+  int best = 0;
+  for (int c = 1; c < n_classes; c++) best = p[c] > p[best] ? c : best;
+  if (total > 0.f) {
+    for (int c = 0; c < n_classes; c++) p[c] /= total;
+  }
+  if (out != nullptr) out[row] = best;
+}
+
+template <typename ValueT>
+__global__ void knn_regress_kernel(ValueT *out, const long *knn_indices,
+                                   const float *knn_dists, const ValueT *y,
+                                   int n_rows, int k, bool distance_weighted) {
+  int row = threadIdx.x + blockIdx.x * blockDim.x;
+  if (row >= n_rows) return;
+  const long *idx = knn_indices + (size_t)row * k;
+  const float *dists = knn_dists + (size_t)row * k;
+
+  bool has_exact = distance_weighted && knn_row_has_exact(idx, dists, k);
+  ValueT acc = ValueT(0), total = ValueT(0);
+  for (int j = 0; j < k; j++) {
+    if (idx[j] < 0) continue;
+    ValueT w = knn_neighbor_weight(dists, j, distance_weighted, has_exact);
+    acc += w * y[idx[j]];
+    total += w;
+  }
+  out[row] = total > ValueT(0) ? acc / total : ValueT(0);
+}
+
+/**
+ * @brief Majority (optionally inverse distance weighted) vote of the labels
+ * of the nearest neighbors of each row, computed on device.
+ * @param out predicted class of each row, size n_rows (may be null)
+ * @param probs class probabilities, row-major n_rows x n_classes
+ * @param knn_indices neighbor indices, row-major n_rows x k, negative
+ * indices are ignored
+ * @param knn_dists squared L2 distances of the neighbors, n_rows x k
+ * @param y labels of the indexed points, encoded as 0 .. n_classes - 1
+ * @param n_rows number of query rows
+ * @param n_classes number of classes
+ * @param k number of neighbors per row
+ * @param distance_weighted weigh the votes by the inverse distance
+ * @param stream cuda stream
+ */
+template <typename LabelT, int TPB = 256>
+void knn_classify(int *out, float *probs, const long *knn_indices,
+                  const float *knn_dists, const LabelT *y, int n_rows,
+                  int n_classes, int k, bool distance_weighted,
+                  cudaStream_t stream) {
+  knn_class_vote_kernel<<<ceildiv(n_rows, TPB), TPB, 0, stream>>>(
+    out, probs, knn_indices, knn_dists, y, n_rows, n_classes, k,
+    distance_weighted);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+/**
+ * @brief Mean (optionally inverse distance weighted) of the targets of the
+ * nearest neighbors of each row, computed on device. Parameters are the
+ * same as for knn_classify, y holds the regression targets.
+ */
+template <typename ValueT, int TPB = 256>
+void knn_regress(ValueT *out, const long *knn_indices, const float *knn_dists,
+                 const ValueT *y, int n_rows, int k, bool distance_weighted,
+                 cudaStream_t stream) {
+  knn_regress_kernel<<<ceildiv(n_rows, TPB), TPB, 0, stream>>>(
+    out, knn_indices, knn_dists, y, n_rows, k, distance_weighted);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
 };  // namespace Selection
 };  // namespace MLCommon
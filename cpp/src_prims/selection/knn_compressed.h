@@ -0,0 +1,453 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cuda_fp16.h>
+#include <thrust/fill.h>
+#include <thrust/system/cuda/execution_policy.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "common/host_buffer.hpp"
+#include "cuda_utils.h"
+#include "distance/mixed_precision.h"
+#include "linalg/reduce.h"
+#include "selection/knn.h"
+
+namespace MLCommon {
+namespace Selection {
+
+/** storage of the rows of a compressed kNN index */
+enum KnnStorage {
+  /** 2 bytes per value, fp16 codes of the scaled values */
+  KnnStorageFp16 = 0,
+  /** 1 byte per value, int8 scalar quantization of the scaled values */
+  KnnStorageInt8,
+};
+
+/**
+ * A kNN index stored as per-dimension affine codes. Value j of a row is
+ * decoded as offset[j] + scale[j] * code, where the codes are fp16 values
+ * in [-1, 1] or int8 values in [-127, 127]. offset and scale map the range
+ * of each dimension over the indexed rows onto the range of the codes.
+ */
+struct CompressedKnnIndex {
+  CompressedKnnIndex(std::shared_ptr<deviceAllocator> allocator,
+                     cudaStream_t stream, KnnStorage storage, long n_rows,
+                     int D)
+    : storage(storage),
+      n_rows(n_rows),
+      D(D),
+      codes(allocator, stream, n_rows * D * codeBytes(storage)),
+      scale(allocator, stream, D),
+      offset(allocator, stream, D) {}
+
+  /** number of bytes of a single code */
+  static size_t codeBytes(KnnStorage storage) {
+    return storage == KnnStorageFp16 ? sizeof(__half) : sizeof(int8_t);
+  }
+
+  KnnStorage storage;
+  long n_rows;
+  int D;
+  /** row-major n_rows x D codes */
+  device_buffer<char> codes;
+  device_buffer<float> scale;
+  device_buffer<float> offset;
+};
+
+namespace {
+
+DI void encodeValue(__half &out, float v) {
+  out = __float2half_rn(v < -1.f ? -1.f : (v > 1.f ? 1.f : v));
+}
+DI void encodeValue(int8_t &out, float v) {
+  v = rintf(v);
+  out = int8_t(v < -127.f ? -127.f : (v > 127.f ? 127.f : v));
+}
+DI float decodeValue(__half c) { return __half2float(c); }
+DI float decodeValue(int8_t c) { return float(c); }
+
+template <typename CodeT>
+__global__ void encodeRowsKernel(CodeT *codes, const float *x,
+                                 const float *scale, const float *offset,
+                                 size_t len, int D) {
+  size_t i = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (i >= len) return;
+  int j = i % D;
+  encodeValue(codes[i], (x[i] - offset[j]) / scale[j]);
+}
+
+template <typename CodeT>
+__global__ void decodeRowsKernel(float *x, const CodeT *codes,
+                                 const float *scale, const float *offset,
+                                 size_t len, int D) {
+  size_t i = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (i >= len) return;
+  int j = i % D;
+  x[i] = offset[j] + scale[j] * decodeValue(codes[i]);
+}
+
+template <typename T>
+__global__ void affineFromRangeKernel(T *scale, T *offset, const T *mins,
+                                      const T *maxs, int D, T code_max) {
+  int j = threadIdx.x + blockIdx.x * blockDim.x;
+  if (j >= D) return;
+  T half_range = (maxs[j] - mins[j]) / T(2);
+  offset[j] = mins[j] + half_range;
+  scale[j] = half_range > T(0) ? half_range / code_max : T(1);
+}
+
+template <typename IdxT>
+__global__ void localCandidatesKernel(IdxT *local, const IdxT *cand,
+                                      size_t len) {
+  size_t i = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (i < len) local[i] = cand[i] >= 0 ? IdxT(i) : IdxT(-1);
+}
+
+template <typename IdxT>
+__global__ void globalCandidatesKernel(IdxT *out, const IdxT *local,
+                                       const IdxT *cand, size_t len) {
+  size_t i = threadIdx.x + size_t(blockIdx.x) * blockDim.x;
+  if (i < len) out[i] = local[i] >= 0 ? cand[local[i]] : IdxT(-1);
+}
+
+void encodeRows(char *codes, const float *x, const float *scale,
+                const float *offset, size_t len, int D, KnnStorage storage,
+                cudaStream_t stream) {
+  static const int TPB = 256;
+  int nblks = ceildiv<size_t>(len, TPB);
+  if (storage == KnnStorageFp16) {
+    encodeRowsKernel<__half>
+      <<<nblks, TPB, 0, stream>>>((__half *)codes, x, scale, offset, len, D);
+  } else {
+    encodeRowsKernel<int8_t>
+      <<<nblks, TPB, 0, stream>>>((int8_t *)codes, x, scale, offset, len, D);
+  }
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+struct MinOp {
+  DI float operator()(float a, float b) const { return a < b ? a : b; }
+};
+struct MaxOp {
+  DI float operator()(float a, float b) const { return a > b ? a : b; }
+};
+
+/** per-dimension reduction of row-major n_rows x D values */
+template <typename ReduceOp>
+void reduceColumns(float *out, const float *x, int D, int n_rows, float init,
+                   bool inplace, ReduceOp op, cudaStream_t stream) {
+  LinAlg::reduce(out, x, D, n_rows, init, true, false, stream, inplace,
+                 Nop<float, int>(), op);
+}
+
+/** the device of a device pointer, current if it cannot be told */
+int ownerDevice(const void *ptr, int current) {
+  cudaPointerAttributes att;
+  if (cudaPointerGetAttributes(&att, ptr) != cudaSuccess) {
+    cudaGetLastError();
+    return current;
+  }
+  return att.device > -1 ? att.device : current;
+}
+
+/**
+ * Per-dimension minima then maxima of the rows of a chunk that lives on
+ * another device, taken on that device; only the 2 x D bounds are copied to
+ * bounds, on the current device.
+ */
+void chunkBoundsOnOwner(float *bounds, const float *x, int n_rows, int D,
+                        int owner) {
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  CUDA_CHECK(cudaSetDevice(owner));
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  float *tmp;
+  CUDA_CHECK(cudaMalloc(&tmp, 2 * D * sizeof(float)));
+  reduceColumns(tmp, x, D, n_rows, FLT_MAX, false, MinOp(), stream);
+  reduceColumns(tmp + D, x, D, n_rows, -FLT_MAX, false, MaxOp(), stream);
+  CUDA_CHECK(cudaMemcpyPeerAsync(bounds, device, tmp, owner,
+                                 2 * D * sizeof(float), stream));
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  CUDA_CHECK(cudaFree(tmp));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+  CUDA_CHECK(cudaSetDevice(device));
+}
+
+/**
+ * Encodes the rows of a chunk that lives on another device on that device,
+ * then copies the codes, 2x or 4x smaller than the rows, to codes on the
+ * current device.
+ */
+void encodeChunkOnOwner(char *codes, const float *x, const float *scale,
+                        const float *offset, int n_rows, int D,
+                        KnnStorage storage, int owner) {
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  CUDA_CHECK(cudaSetDevice(owner));
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  size_t len = size_t(n_rows) * D;
+  size_t code_bytes = len * CompressedKnnIndex::codeBytes(storage);
+  float *affine;
+  CUDA_CHECK(cudaMalloc(&affine, 2 * D * sizeof(float) + code_bytes));
+  char *tmp = (char *)(affine + 2 * D);
+  CUDA_CHECK(cudaMemcpyPeerAsync(affine, owner, scale, device,
+                                 D * sizeof(float), stream));
+  CUDA_CHECK(cudaMemcpyPeerAsync(affine + D, owner, offset, device,
+                                 D * sizeof(float), stream));
+  encodeRows(tmp, x, affine, affine + D, len, D, storage, stream);
+  CUDA_CHECK(
+    cudaMemcpyPeerAsync(codes, device, tmp, owner, code_bytes, stream));
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  CUDA_CHECK(cudaFree(affine));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+  CUDA_CHECK(cudaSetDevice(device));
+}
+
+template <typename CodeT>
+void decodeRows(float *x, const CompressedKnnIndex &index, long row_start,
+                long n_rows, cudaStream_t stream) {
+  static const int TPB = 256;
+  size_t len = size_t(n_rows) * index.D;
+  const CodeT *codes =
+    (const CodeT *)index.codes.data() + size_t(row_start) * index.D;
+  decodeRowsKernel<CodeT><<<ceildiv<size_t>(len, TPB), TPB, 0, stream>>>(
+    x, codes, index.scale.data(), index.offset.data(), len, index.D);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+}  // anonymous namespace
+
+/**
+ * @brief Fills a compressed index from a series of device arrays, taken in
+ * order. The per-dimension affine maps are fitted on the range of the rows.
+ * The index lives on the current device; arrays on other devices (as spread
+ * by kNN::fit_from_host) are reduced and encoded on the device that owns
+ * them, and only their bounds and codes are copied over.
+ * @param index the index to fill, sized for the total number of rows
+ * @param input array of pointers to the row-major input arrays (device)
+ * @param sizes number of rows of each input array
+ * @param n_params number of input arrays
+ * @param stream cuda stream
+ */
+inline void compressKnnIndex(CompressedKnnIndex &index, float **input,
+                             int *sizes, int n_params, cudaStream_t stream) {
+  static const int TPB = 256;
+  int D = index.D;
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  auto allocator = index.codes.getAllocator();
+  device_buffer<float> mins(allocator, stream, D), maxs(allocator, stream, D);
+  device_buffer<float> bounds(allocator, stream, 2 * D);
+  bool first = true;
+  for (int p = 0; p < n_params; p++) {
+    if (sizes[p] == 0) continue;
+    const float *lo = input[p], *hi = input[p];
+    int n_rows = sizes[p];
+    int owner = ownerDevice(input[p], device);
+    if (owner != device) {
+      // bounds is still read by the reductions of the previous chunk
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      chunkBoundsOnOwner(bounds.data(), input[p], sizes[p], D, owner);
+      lo = bounds.data();
+      hi = bounds.data() + D;
+      n_rows = 1;
+    }
+    reduceColumns(mins.data(), lo, D, n_rows, FLT_MAX, !first, MinOp(), stream);
+    reduceColumns(maxs.data(), hi, D, n_rows, -FLT_MAX, !first, MaxOp(),
+                  stream);
+    first = false;
+  }
+  float code_max = index.storage == KnnStorageFp16 ? 1.f : 127.f;
+  affineFromRangeKernel<float><<<ceildiv(D, TPB), TPB, 0, stream>>>(
+    index.scale.data(), index.offset.data(), mins.data(), maxs.data(), D,
+    code_max);
+  CUDA_CHECK(cudaPeekAtLastError());
+
+  size_t row = 0;
+  size_t code_bytes = CompressedKnnIndex::codeBytes(index.storage);
+  for (int p = 0; p < n_params; p++) {
+    size_t len = size_t(sizes[p]) * D;
+    if (len == 0) continue;
+    char *codes = index.codes.data() + row * D * code_bytes;
+    int owner = ownerDevice(input[p], device);
+    if (owner != device) {
+      // scale and offset are read on the owner device
+      CUDA_CHECK(cudaStreamSynchronize(stream));
+      encodeChunkOnOwner(codes, input[p], index.scale.data(),
+                         index.offset.data(), sizes[p], D, index.storage,
+                         owner);
+    } else {
+      encodeRows(codes, input[p], index.scale.data(), index.offset.data(), len,
+                 D, index.storage, stream);
+    }
+    row += sizes[p];
+  }
+}
+
+/**
+ * @brief Search the k nearest neighbors of a set of query vectors in a
+ * compressed index.
+ *
+ * The index is decoded on the fly, tile_rows rows at a time, into an fp32
+ * tile which is searched by brute force; a running top-k per query is kept
+ * on device. Only the codes and one decoded tile are resident, so an index
+ * takes 2x (fp16) or 4x (int8) less device memory than its fp32 rows.
+ *
+ * When the original fp32 rows are retained on host (host_rows), the search
+ * keeps n_candidates > k candidates per query in the compressed space and
+ * re-ranks them with exact fp32 distances, so that neighbors whose order
+ * the quantization could not resolve are recovered.
+ *
+ * @param index the compressed index
+ * @param search_items set of vectors to query for neighbors (device)
+ * @param n number of items in search_items
+ * @param res_I pointer to device memory for returning k nearest indices
+ * @param res_D pointer to device memory for returning k nearest distances
+ * (squared L2; exact when re-ranked, else to the decoded rows)
+ * @param k number of neighbors to query
+ * @param host_rows the original row-major index rows in host memory, may
+ * be null to skip the re-ranking
+ * @param n_candidates number of candidates re-ranked per query, k <=
+ * n_candidates <= 1024 (ignored without host_rows)
+ * @param d_alloc device allocator
+ * @param h_alloc host allocator for the pinned re-ranking buffers
+ * @param stream cuda stream
+ * @param tile_rows number of index rows decoded at once
+ * @param batch_size number of queries searched at once
+ */
+inline void compressedKnn(const CompressedKnnIndex &index,
+                          const float *search_items, int n, long *res_I,
+                          float *res_D, int k, const float *host_rows,
+                          int n_candidates,
+                          std::shared_ptr<deviceAllocator> d_alloc,
+                          std::shared_ptr<hostAllocator> h_alloc,
+                          cudaStream_t stream, long tile_rows = 1 << 16,
+                          int batch_size = 1 << 12) {
+  static const int TPB = 256;
+  bool rerank = host_rows != nullptr;
+  int kc = rerank ? n_candidates : k;
+  ASSERT(k <= kc && kc <= 1024,
+         "compressedKnn: need k <= n_candidates <= 1024");
+  ASSERT(tile_rows > 0 && batch_size > 0,
+         "compressedKnn: tile_rows and batch_size must be > 0");
+  if (n == 0) return;
+  int D = index.D;
+  tile_rows = std::min(tile_rows, std::max(index.n_rows, 1L));
+  int nb = std::min(n, batch_size);
+
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  faiss::gpu::StandardGpuResources gpu_res;
+  gpu_res.noTempMemory();
+  gpu_res.setCudaMallocWarning(false);
+  gpu_res.setDefaultStream(device, stream);
+
+  size_t cand_len = size_t(nb) * kc;
+  device_buffer<float> tile(d_alloc, stream, size_t(tile_rows) * D);
+  device_buffer<float> tile_D(d_alloc, stream, cand_len);
+  device_buffer<long> tile_I(d_alloc, stream, cand_len);
+  device_buffer<float> cand_D(d_alloc, stream, cand_len);
+  device_buffer<long> cand_I(d_alloc, stream, cand_len);
+  device_buffer<float> tmp_D(d_alloc, stream, cand_len);
+  device_buffer<long> tmp_I(d_alloc, stream, cand_len);
+  // re-ranking gathers the fp32 rows of the candidates of a query batch
+  device_buffer<float> rows(d_alloc, stream, rerank ? cand_len * D : 0);
+  host_buffer<float> rows_h(h_alloc, stream, rerank ? cand_len * D : 0);
+  std::vector<long> cand_h(rerank ? cand_len : 0);
+  auto exec = thrust::cuda::par.on(stream);
+
+  for (int q0 = 0; q0 < n; q0 += nb) {
+    int qb = std::min(nb, n - q0);
+    const float *queries = search_items + size_t(q0) * D;
+    size_t len = size_t(qb) * kc;
+    float *cur_D = cand_D.data(), *nxt_D = tmp_D.data();
+    long *cur_I = cand_I.data(), *nxt_I = tmp_I.data();
+    thrust::fill(exec, cur_D, cur_D + len, FLT_MAX);
+    thrust::fill(exec, cur_I, cur_I + len, -1L);
+
+    for (long offset = 0; offset < index.n_rows; offset += tile_rows) {
+      long n_tile = std::min(tile_rows, index.n_rows - offset);
+      if (index.storage == KnnStorageFp16) {
+        decodeRows<__half>(tile.data(), index, offset, n_tile, stream);
+      } else {
+        decodeRows<int8_t>(tile.data(), index, offset, n_tile, stream);
+      }
+      int kb = std::min<long>(kc, n_tile);
+      faiss::gpu::bruteForceKnn(&gpu_res, faiss::METRIC_L2, tile.data(),
+                                n_tile, queries, qb, D, kb, tile_D.data(),
+                                tile_I.data());
+      knn_merge_sorted_kernel<<<ceildiv(qb, TPB), TPB, 0, stream>>>(
+        nxt_D, nxt_I, cur_D, cur_I, tile_D.data(), tile_I.data(), kb, offset,
+        qb, kc);
+      CUDA_CHECK(cudaPeekAtLastError());
+      std::swap(cur_D, nxt_D);
+      std::swap(cur_I, nxt_I);
+    }
+
+    long *out_I = res_I + size_t(q0) * k;
+    float *out_D = res_D + size_t(q0) * k;
+    if (!rerank) {
+      copy(out_I, cur_I, len, stream);
+      copy(out_D, cur_D, len, stream);
+      continue;
+    }
+
+    updateHost(cand_h.data(), cur_I, len, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    // the candidates of a query are gathered in the order of their ids, so
+    // that the refinement, which breaks exact ties by position, breaks them
+    // by id as the uncompressed search does
+    for (int q = 0; q < qb; q++) {
+      std::sort(cand_h.begin() + size_t(q) * kc,
+                cand_h.begin() + size_t(q + 1) * kc);
+    }
+    updateDevice(cur_I, cand_h.data(), len, stream);
+    for (size_t c = 0; c < len; c++) {
+      float *dst = rows_h.data() + c * D;
+      if (cand_h[c] >= 0) {
+        std::memcpy(dst, host_rows + cand_h[c] * D, D * sizeof(float));
+      } else {
+        std::memset(dst, 0, D * sizeof(float));
+      }
+    }
+    updateDevice(rows.data(), rows_h.data(), len * D, stream);
+    // candidates are referred to by their position in the gathered rows
+    long *local = nxt_I;
+    int nblks = ceildiv<size_t>(len, TPB);
+    localCandidatesKernel<<<nblks, TPB, 0, stream>>>(local, cur_I, len);
+    CUDA_CHECK(cudaPeekAtLastError());
+    Distance::refineKnnCandidates(queries, rows.data(), qb, D, local, kc, k,
+                                  tile_I.data(), out_D, false, stream);
+    globalCandidatesKernel<<<ceildiv<size_t>(size_t(qb) * k, TPB), TPB, 0,
+                             stream>>>(out_I, tile_I.data(), cur_I,
+                                       size_t(qb) * k);
+    CUDA_CHECK(cudaPeekAtLastError());
+  }
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+}
+
+};  // namespace Selection
+};  // namespace MLCommon
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "distance/distance_host.h"
+#include "utils.h"
+
+namespace MLCommon {
+namespace Selection {
+
+/**
+ * Orders (value, key) pairs from the best to the worst: by value, smallest
+ * or largest first, and by key for equal values.
+ */
+template <typename TypeV, typename TypeK>
+struct HostTopKOrder {
+  bool select_min;
+  bool operator()(const std::pair<TypeV, TypeK> &a,
+                  const std::pair<TypeV, TypeK> &b) const {
+    if (a.first != b.first)
+      return select_min ? a.first < b.first : a.first > b.first;
+    return a.second < b.second;
+  }
+};
+
+/** value given to the missing entries of a selection */
+template <typename TypeV>
+TypeV hostTopKNeutral(bool select_min) {
+  return select_min ? std::numeric_limits<TypeV>::max()
+                    : std::numeric_limits<TypeV>::lowest();
+}
+
+/**
+ * @brief Host (OpenMP) counterpart of warpTopK: selects the k smallest (or
+ * largest) values of every row of a row-major matrix, along with their
+ * column indices. Each thread keeps a bounded heap of the best k entries of
+ * its current row, so a row is read once whatever k.
+ * @tparam TypeV value type
+ * @tparam TypeK key type
+ * @param outV output values, rows x k, sorted from the best (may be nullptr)
+ * @param outK output column indices, rows x k (may be nullptr)
+ * @param arr input matrix, rows x cols (host)
+ * @param k number of values to select per row. When it exceeds cols, the
+ * trailing entries get the key -1 and the worst representable value.
+ * @param rows number of rows
+ * @param cols number of columns
+ * @param select_min whether to select the smallest values
+ */
+template <typename TypeV, typename TypeK>
+void selectKHost(TypeV *outV, TypeK *outK, const TypeV *arr, int k, int rows,
+                 TypeK cols, bool select_min = true) {
+  if (k <= 0) return;
+  typedef std::pair<TypeV, TypeK> Pair;
+  HostTopKOrder<TypeV, TypeK> better{select_min};
+  const TypeV neutral = hostTopKNeutral<TypeV>(select_min);
+#pragma omp parallel
+  {
+    std::vector<Pair> heap;
+    heap.reserve(k);
+#pragma omp for schedule(static)
+    for (int r = 0; r < rows; ++r) {
+      const TypeV *row = arr + (size_t)r * cols;
+      heap.clear();
+      // max-heap with respect to "better": the worst kept pair is on top
+      for (TypeK c = 0; c < cols; ++c) {
+        Pair p(row[c], c);
+        if ((int)heap.size() < k) {
+          heap.push_back(p);
+          std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(p, heap.front())) {
+          std::pop_heap(heap.begin(), heap.end(), better);
+          heap.back() = p;
+          std::push_heap(heap.begin(), heap.end(), better);
+        }
+      }
+      std::sort_heap(heap.begin(), heap.end(), better);
+      for (int j = 0; j < k; ++j) {
+        bool valid = j < (int)heap.size();
+        if (outV != nullptr)
+          outV[(size_t)r * k + j] = valid ? heap[j].first : neutral;
+        if (outK != nullptr)
+          outK[(size_t)r * k + j] = valid ? heap[j].second : TypeK(-1);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Host counterpart of merge_tables which does not depend on faiss:
+ * merges the sorted k-nearest neighbor lists computed on several shards of
+ * an index into a single list per query.
+ * @param n number of queries
+ * @param k number of neighbors per list
+ * @param nshard number of shards
+ * @param distances output distances, n x k
+ * @param labels output indices, n x k
+ * @param all_distances shard-stacked input distances, nshard x n x k, each
+ * list sorted from the best
+ * @param all_labels shard-stacked input indices, nshard x n x k. Negative
+ * indices mark the end of a list.
+ * @param translations offset added to the indices of each shard, size nshard
+ * @param select_min whether smaller distances are better
+ */
+template <typename T, typename IdxT = long>
+void mergeTablesHost(long n, long k, long nshard, T *distances, IdxT *labels,
+                     const T *all_distances, const IdxT *all_labels,
+                     const IdxT *translations, bool select_min = true) {
+  if (k <= 0) return;
+  typedef std::pair<T, long> Pair;
+  size_t stride = n * k;
+  // the heap holds the heads of the shards' lists, with the best one on top
+  HostTopKOrder<T, long> better{select_min};
+  auto worse = [&better](const Pair &a, const Pair &b) { return better(b, a); };
+  const T neutral = hostTopKNeutral<T>(select_min);
+#pragma omp parallel
+  {
+    std::vector<Pair> heap;
+    std::vector<long> pointer(nshard);
+    heap.reserve(nshard);
+#pragma omp for schedule(static)
+    for (long i = 0; i < n; ++i) {
+      const T *D_in = all_distances + i * k;
+      const IdxT *I_in = all_labels + i * k;
+      heap.clear();
+      for (long s = 0; s < nshard; ++s) {
+        pointer[s] = 0;
+        if (I_in[stride * s] >= 0) heap.push_back(Pair(D_in[stride * s], s));
+      }
+      std::make_heap(heap.begin(), heap.end(), worse);
+
+      T *D = distances + i * k;
+      IdxT *I = labels + i * k;
+      for (long j = 0; j < k; ++j) {
+        if (heap.empty()) {
+          D[j] = neutral;
+          I[j] = IdxT(-1);
+          continue;
+        }
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        long s = heap.back().second;
+        long &p = pointer[s];
+        D[j] = heap.back().first;
+        I[j] = I_in[stride * s + p] + translations[s];
+        heap.pop_back();
+        if (++p < k && I_in[stride * s + p] >= 0) {
+          heap.push_back(Pair(D_in[stride * s + p], s));
+          std::push_heap(heap.begin(), heap.end(), worse);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Host (OpenMP) brute-force k-nearest neighbors search. The index is
+ * split in tiles of at most index_tile rows: the distances of the queries
+ * to each tile are computed with pairwiseDistanceHost, reduced to the k best
+ * with selectKHost, and the per-tile lists are merged with mergeTablesHost.
+ * Queries are processed query_tile at a time, which bounds the temporary
+ * memory to query_tile x index_tile distances.
+ * @param index row-major n_index x D points to search (host)
+ * @param n_index number of points in the index
+ * @param D dimensionality
+ * @param search row-major n x D query points (host)
+ * @param n number of queries
+ * @param res_I output indices, n x k, sorted from the nearest
+ * @param res_D output distances, n x k
+ * @param k number of neighbors
+ * @param metric distance metric. EucExpandedCosine yields the largest
+ * cosine similarities.
+ * @param index_tile number of index rows per tile
+ * @param query_tile number of queries per tile
+ */
+template <typename T>
+void knnHost(const T *index, long n_index, int D, const T *search, long n,
+             long *res_I, T *res_D, int k,
+             Distance::DistanceType metric = Distance::EucUnexpandedL2,
+             long index_tile = 1 << 13, long query_tile = 1 << 10) {
+  ASSERT(index_tile > 0 && query_tile > 0,
+         "knnHost: tile sizes must be positive");
+  if (n <= 0 || k <= 0) return;
+  bool select_min = metric != Distance::EucExpandedCosine;
+  index_tile = std::min(index_tile, std::max(n_index, 1L));
+  query_tile = std::min(query_tile, n);
+  long nshard = (n_index + index_tile - 1) / index_tile;
+  std::vector<T> dist((size_t)query_tile * index_tile);
+  std::vector<T> all_D((size_t)std::max(nshard, 1L) * query_tile * k);
+  std::vector<long> all_I(all_D.size());
+  std::vector<long> translations(std::max(nshard, 1L));
+  for (long s = 0; s < nshard; ++s) translations[s] = s * index_tile;
+
+  for (long q = 0; q < n; q += query_tile) {
+    long nq = std::min(query_tile, n - q);
+    for (long s = 0; s < nshard; ++s) {
+      long ni = std::min(index_tile, n_index - s * index_tile);
+      Distance::pairwiseDistanceHost<T, long>(search + q * D,
+                                              index + s * index_tile * D,
+                                              dist.data(), nq, ni, D, metric);
+      selectKHost<T, long>(all_D.data() + s * nq * k,
+                           all_I.data() + s * nq * k, dist.data(), k, nq, ni,
+                           select_min);
+    }
+    if (nshard == 0) {
+      std::fill(res_D + q * k, res_D + (q + nq) * k,
+                hostTopKNeutral<T>(select_min));
+      std::fill(res_I + q * k, res_I + (q + nq) * k, -1L);
+      continue;
+    }
+    mergeTablesHost<T, long>(nq, k, nshard, res_D + q * k, res_I + q * k,
+                             all_D.data(), all_I.data(), translations.data(),
+                             select_min);
+  }
+}
+
+};  // end namespace Selection
+};  // end namespace MLCommon
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <thrust/device_ptr.h>
+#include <thrust/scan.h>
+#include <thrust/system/cuda/execution_policy.h>
+#include <algorithm>
+#include <cub/cub.cuh>
+#include <memory>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "distance/distance.h"
+
+namespace MLCommon {
+namespace Selection {
+
+/**
+ * Adds the number of entries within eps2 of each row of a query x index
+ * distance tile to counts (one block per query row).
+ */
+template <typename value_t, typename value_idx, int TPB>
+__global__ void radius_count_kernel(value_idx *counts, const value_t *dists,
+                                    int n_cols, value_t eps2) {
+  typedef cub::BlockReduce<int, TPB> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp;
+  const value_t *d = dists + (size_t)blockIdx.x * n_cols;
+  int cnt = 0;
+  for (int j = threadIdx.x; j < n_cols; j += TPB) cnt += d[j] <= eps2;
+  cnt = BlockReduce(temp).Sum(cnt);
+  if (threadIdx.x == 0) counts[blockIdx.x] += cnt;
+}
+
+/**
+ * Appends the entries within eps2 of each row of a query x index distance
+ * tile at the fill cursor of the row, in increasing index order (one block
+ * per query row).
+ */
+template <typename value_t, typename value_idx, int TPB>
+__global__ void radius_fill_kernel(value_idx *indices, value_t *distances,
+                                   value_idx *cursor, const value_t *dists,
+                                   int n_cols, value_t eps2,
+                                   value_idx col_offset) {
+  typedef cub::BlockScan<int, TPB> BlockScan;
+  __shared__ typename BlockScan::TempStorage temp;
+  __shared__ value_idx base;
+  const value_t *d = dists + (size_t)blockIdx.x * n_cols;
+  if (threadIdx.x == 0) base = cursor[blockIdx.x];
+  __syncthreads();
+  for (int j0 = 0; j0 < n_cols; j0 += TPB) {
+    int j = j0 + threadIdx.x;
+    value_t dist = j < n_cols ? d[j] : value_t(0);
+    int in = j < n_cols && dist <= eps2;
+    int pos, total;
+    BlockScan(temp).ExclusiveSum(in, pos, total);
+    if (in) {
+      indices[base + pos] = col_offset + j;
+      distances[base + pos] = dist;
+    }
+    __syncthreads();
+    if (threadIdx.x == 0) base += total;
+    __syncthreads();
+  }
+  if (threadIdx.x == 0) cursor[blockIdx.x] = base;
+}
+
+/**
+ * @brief Find all the rows of a (possibly partitioned) index within a
+ * radius eps of each query row, as a CSR matrix of n rows.
+ *
+ * The result is produced in two passes so that the caller can size the
+ * outputs. With indices == nullptr, only indptr is computed and the number
+ * of neighbors (nnz) is returned. Called again with the same indptr and
+ * indices/distances of size nnz, the neighbor lists are filled. Each list
+ * is sorted by index. Both passes work on batch_size_query x
+ * batch_size_index distance tiles, which bounds the workspace.
+ *
+ * @param input array of pointers to the row-major index partitions (device)
+ * @param sizes number of rows of each partition
+ * @param n_params number of partitions
+ * @param D dimensionality of the rows
+ * @param search_items row-major query rows (device)
+ * @param n number of query rows
+ * @param eps the radius, neighbors are the rows at a distance <= eps
+ * @param indptr the CSR row offsets, size n + 1 (device)
+ * @param indices the CSR column indices, as row positions in the
+ * concatenation of the partitions, size nnz (device)
+ * @param distances the squared L2 distances of the neighbors, size nnz
+ * (device)
+ * @param allocator device allocator for the distance tiles
+ * @param stream cuda stream
+ * @param batch_size_query number of query rows in a distance tile
+ * @param batch_size_index number of index rows in a distance tile
+ * @return the number of neighbors found over all the queries
+ */
+template <typename value_t, typename value_idx = long>
+value_idx radius_neighbors(value_t **input, int *sizes, int n_params, int D,
+                           const value_t *search_items, int n, value_t eps,
+                           value_idx *indptr, value_idx *indices,
+                           value_t *distances,
+                           std::shared_ptr<deviceAllocator> allocator,
+                           cudaStream_t stream, int batch_size_query = 2048,
+                           int batch_size_index = 16384) {
+  constexpr int TPB = 256;
+  ASSERT(batch_size_query > 0 && batch_size_index > 0,
+         "radius_neighbors: batch sizes must be > 0");
+  bool fill = indices != nullptr;
+  value_t eps2 = eps * eps;
+  int nb = std::max(1, std::min(n, batch_size_query));
+  int max_rows = 1;
+  for (int p = 0; p < n_params; p++) max_rows = std::max(max_rows, sizes[p]);
+  int mb = std::min(max_rows, batch_size_index);
+
+  device_buffer<value_t> tile(allocator, stream, (size_t)nb * mb);
+  device_buffer<char> workspace(allocator, stream);
+  device_buffer<value_idx> cursor(allocator, stream, fill ? n : 0);
+  if (fill) {
+    copy(cursor.data(), indptr, n, stream);
+  } else {
+    CUDA_CHECK(
+      cudaMemsetAsync(indptr, 0, (n + 1) * sizeof(value_idx), stream));
+  }
+
+  for (int q0 = 0; q0 < n; q0 += nb) {
+    int qb = std::min(nb, n - q0);
+    value_idx col_offset = 0;
+    for (int p = 0; p < n_params; p++) {
+      for (int i0 = 0; i0 < sizes[p]; i0 += mb) {
+        int ib = std::min(mb, sizes[p] - i0);
+        Distance::pairwiseDistance<value_t, int>(
+          search_items + (size_t)q0 * D, input[p] + (size_t)i0 * D,
+          tile.data(), qb, ib, D, workspace,
+          Distance::DistanceType::EucUnexpandedL2, stream);
+        if (fill) {
+          radius_fill_kernel<value_t, value_idx, TPB>
+            <<<qb, TPB, 0, stream>>>(indices, distances, cursor.data() + q0,
+                                     tile.data(), ib, eps2, col_offset + i0);
+        } else {
+          radius_count_kernel<value_t, value_idx, TPB>
+            <<<qb, TPB, 0, stream>>>(indptr + 1 + q0, tile.data(), ib, eps2);
+        }
+        CUDA_CHECK(cudaPeekAtLastError());
+      }
+      col_offset += sizes[p];
+    }
+  }
+
+  if (!fill) {
+    thrust::device_ptr<value_idx> d_indptr(indptr + 1);
+    thrust::inclusive_scan(thrust::cuda::par.on(stream), d_indptr,
+                           d_indptr + n, d_indptr);
+  }
+  value_idx nnz;
+  updateHost(&nnz, indptr + n, 1, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  return nnz;
+}
+
+};  // namespace Selection
+};  // namespace MLCommon
@@ -660,14 +660,19 @@ class WeakCCState {
   }
 };
 
-template <typename Type, int TPB_X = 32>
+/**
+ * Vertices that fail filter_op neither propagate their label nor have it
+ * taken by their neighbors; they only receive the smallest label of the
+ * neighbors that pass it.
+ */
+template <typename Type, int TPB_X = 32, typename Lambda>
 __global__ void weak_cc_label_device(Type *labels, Type *row_ind,
                                      Type *row_ind_ptr, Type nnz, bool *fa,
                                      bool *xa, bool *m, int startVertexId,
-                                     int batchSize) {
+                                     int batchSize, Lambda filter_op) {
   int tid = threadIdx.x + blockIdx.x * TPB_X;
   if (tid < batchSize) {
-    if (fa[tid + startVertexId]) {
+    if (fa[tid + startVertexId] && filter_op(tid + startVertexId)) {
       fa[tid + startVertexId] = false;
       int start = int(row_ind[tid]);
       Type ci, cj;
@@ -678,12 +683,13 @@ __global__ void weak_cc_label_device(Type *labels, Type *row_ind,
 
       for (int j = 0; j < int(degree);
            j++) {  // TODO: Can't this be calculated from the ex_scan?
-        cj = labels[row_ind_ptr[start + j]];
+        Type vj = row_ind_ptr[start + j];
+        cj = labels[vj];
         if (ci < cj) {
-          atomicMin(labels + row_ind_ptr[start + j], ci);
-          xa[row_ind_ptr[start + j]] = true;
+          atomicMin(labels + vj, ci);
+          xa[vj] = true;
           m[0] = true;
-        } else if (ci > cj) {
+        } else if (ci > cj && filter_op(vj)) {
           ci = cj;
           ci_mod = true;
         }
@@ -705,7 +711,8 @@ __global__ void weak_cc_init_label_kernel(Type *labels, int startVertexId,
   /** Cd in paper corresponds to db_cluster */
   int tid = threadIdx.x + blockIdx.x * TPB_X;
   if (tid < batchSize) {
-    if (filter_op(tid) && labels[tid + startVertexId] == MAX_LABEL)
+    if (filter_op(tid + startVertexId) &&
+        labels[tid + startVertexId] == MAX_LABEL)
       labels[startVertexId + tid] = Type(startVertexId + tid + 1);
   }
 }
@@ -742,7 +749,7 @@ void weak_cc_label_batched(Type *labels, Type *const row_ind,
     CUDA_CHECK(cudaMemsetAsync(state->m, false, sizeof(bool), stream));
     weak_cc_label_device<Type, TPB_X><<<blocks, threads, 0, stream>>>(
       labels, row_ind, row_ind_ptr, nnz, state->fa, state->xa, state->m,
-      startVertexId, batchSize);
+      startVertexId, batchSize, filter_op);
     CUDA_CHECK(cudaPeekAtLastError());
 
     //** swapping F1 and F2
@@ -780,8 +787,10 @@ void weak_cc_label_batched(Type *labels, Type *const row_ind,
  * @param batchSize number of vertices for current batch
  * @param state instance of inter-batch state management
  * @param stream the cuda stream to use
- * @param filter_op an optional filtering function to determine which points
- * should get considered for labeling.
+ * @param filter_op an optional filtering function, called with a vertex id in
+ * [0, N), to determine which points should get considered for labeling. The
+ * other points do not connect components: they only get the smallest label
+ * of their neighbors that pass the filter, if any.
  */
 template <typename Type = int, int TPB_X = 32,
           typename Lambda = auto(Type)->bool>
@@ -856,8 +865,10 @@ void weak_cc_batched(Type *labels, Type *const row_ind, Type *const row_ind_ptr,
  * @param nnz the size of row_ind_ptr array
  * @param N number of vertices
  * @param stream the cuda stream to use
- * @param filter_op an optional filtering function to determine which points
- * should get considered for labeling.
+ * @param filter_op an optional filtering function, called with a vertex id in
+ * [0, N), to determine which points should get considered for labeling. The
+ * other points do not connect components: they only get the smallest label
+ * of their neighbors that pass the filter, if any.
  */
 template <typename Type = int, int TPB_X = 32,
           typename Lambda = auto(Type)->bool>
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <thrust/fill.h>
+#include <thrust/system/cuda/execution_policy.h>
+#include <thrust/transform.h>
+#include <algorithm>
+#include <cfloat>
+#include <cub/cub.cuh>
+#include <memory>
+#include "common/cuml_allocator.hpp"
+#include "common/device_buffer.hpp"
+#include "cuda_utils.h"
+#include "selection/knn.h"
+
+namespace MLCommon {
+namespace Sparse {
+
+/** metrics of the sparse pairwise distances */
+enum SparseDistanceType {
+  /** inner product <a, b>, a similarity (larger is nearer) */
+  SparseInnerProduct = 0,
+  /** squared euclidean distance, expanded as |a|^2 + |b|^2 - 2 <a, b> */
+  SparseL2Expanded,
+  /** euclidean distance, expanded as above */
+  SparseL2SqrtExpanded,
+  /** cosine distance 1 - <a, b> / (|a| |b|) */
+  SparseCosine,
+  /** manhattan distance */
+  SparseL1,
+  /** jaccard distance 1 - |A & B| / |A | B| of the sets of nonzero columns */
+  SparseJaccard,
+};
+
+/** per row statistics the metrics are expanded with */
+template <typename value_t>
+struct SparseRowStats {
+  value_t sqnorm;
+  value_t l1norm;
+  int nnz;
+};
+
+/** per pair accumulators, computed in a single pass over the nonzeros */
+template <typename value_t>
+struct SparsePairAcc {
+  value_t dot;
+  /** l1 distance minus the l1 norm of the row that was not walked over */
+  value_t l1;
+  int inter;
+};
+
+/** the rows of a CSR matrix with sorted column indices */
+template <typename value_t>
+struct CsrRows {
+  const int *indptr;
+  const int *indices;
+  const value_t *data;
+
+  /** the walk is over the rows of this matrix, the l1 is relative to a */
+  static constexpr bool l1_from_a = true;
+
+  DI SparsePairAcc<value_t> accumulate(const int *a_cols,
+                                       const value_t *a_vals, int a_nnz,
+                                       int j) const {
+    SparsePairAcc<value_t> acc = {value_t(0), value_t(0), 0};
+    for (int p = indptr[j]; p < indptr[j + 1]; p++) {
+      int col = indices[p];
+      value_t b = data[p];
+      // binary search of the column in the sorted row a
+      int lo = 0, hi = a_nnz;
+      while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (a_cols[mid] < col)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      if (lo < a_nnz && a_cols[lo] == col) {
+        value_t a = a_vals[lo];
+        acc.dot += a * b;
+        acc.l1 += myAbs(a - b) - myAbs(a);
+        acc.inter += a != value_t(0) && b != value_t(0);
+      } else {
+        acc.l1 += myAbs(b);
+      }
+    }
+    return acc;
+  }
+};
+
+/** the rows of a dense row-major matrix */
+template <typename value_t>
+struct DenseRows {
+  const value_t *data;
+  int D;
+
+  /** the walk is over the nonzeros of a, the l1 is relative to b */
+  static constexpr bool l1_from_a = false;
+
+  DI SparsePairAcc<value_t> accumulate(const int *a_cols,
+                                       const value_t *a_vals, int a_nnz,
+                                       int j) const {
+    SparsePairAcc<value_t> acc = {value_t(0), value_t(0), 0};
+    const value_t *b_row = data + size_t(j) * D;
+    for (int p = 0; p < a_nnz; p++) {
+      value_t a = a_vals[p], b = b_row[a_cols[p]];
+      acc.dot += a * b;
+      acc.l1 += myAbs(a - b) - myAbs(b);
+      acc.inter += a != value_t(0) && b != value_t(0);
+    }
+    return acc;
+  }
+};
+
+namespace {
+
+/** number of nonzeros of a row of A staged in shared memory */
+static const int SparseSmemNnz = 1024;
+
+template <typename value_t>
+DI value_t finalizeDistance(SparseDistanceType metric,
+                            const SparsePairAcc<value_t> &acc,
+                            const SparseRowStats<value_t> &a,
+                            const SparseRowStats<value_t> &b,
+                            bool l1_from_a) {
+  switch (metric) {
+    case SparseInnerProduct:
+      return acc.dot;
+    case SparseL2Expanded:
+    case SparseL2SqrtExpanded: {
+      value_t d = a.sqnorm + b.sqnorm - value_t(2) * acc.dot;
+      d = d > value_t(0) ? d : value_t(0);
+      return metric == SparseL2Expanded ? d : mySqrt(d);
+    }
+    case SparseCosine: {
+      value_t norms = mySqrt(a.sqnorm) * mySqrt(b.sqnorm);
+      return norms > value_t(0) ? value_t(1) - acc.dot / norms : value_t(1);
+    }
+    case SparseL1:
+      return (l1_from_a ? a.l1norm : b.l1norm) + acc.l1;
+    default: {
+      int uni = a.nnz + b.nnz - acc.inter;
+      return uni > 0 ? value_t(1) - value_t(acc.inter) / value_t(uni)
+                     : value_t(0);
+    }
+  }
+}
+
+/**
+ * Stages row i of A in shared memory when it fits, and points cols/vals to
+ * the row (in shared or global memory). Must be called by the whole block.
+ */
+template <typename value_t>
+DI int loadRow(const int *&cols, const value_t *&vals, int *s_cols,
+               value_t *s_vals, const int *indptr, const int *indices,
+               const value_t *data, int i) {
+  int start = indptr[i], nnz = indptr[i + 1] - start;
+  // the previous row may still be in use
+  __syncthreads();
+  if (nnz <= SparseSmemNnz) {
+    for (int t = threadIdx.x; t < nnz; t += blockDim.x) {
+      s_cols[t] = indices[start + t];
+      s_vals[t] = data[start + t];
+    }
+    cols = s_cols;
+    vals = s_vals;
+  } else {
+    cols = indices + start;
+    vals = data + start;
+  }
+  __syncthreads();
+  return nnz;
+}
+
+template <typename value_t>
+__global__ void csrRowStatsKernel(SparseRowStats<value_t> *stats,
+                                  const int *indptr, const value_t *data,
+                                  int n_rows) {
+  int i = threadIdx.x + blockIdx.x * blockDim.x;
+  if (i >= n_rows) return;
+  SparseRowStats<value_t> s = {value_t(0), value_t(0), 0};
+  for (int p = indptr[i]; p < indptr[i + 1]; p++) {
+    value_t v = data[p];
+    s.sqnorm += v * v;
+    s.l1norm += myAbs(v);
+    s.nnz += v != value_t(0);
+  }
+  stats[i] = s;
+}
+
+/** one warp per row */
+template <typename value_t>
+__global__ void denseRowStatsKernel(SparseRowStats<value_t> *stats,
+                                    const value_t *data, int n_rows, int D) {
+  int i = (threadIdx.x + blockIdx.x * blockDim.x) / WarpSize;
+  int lane = threadIdx.x % WarpSize;
+  if (i >= n_rows) return;
+  const value_t *row = data + size_t(i) * D;
+  value_t sq = value_t(0), l1 = value_t(0);
+  int nnz = 0;
+  for (int c = lane; c < D; c += WarpSize) {
+    value_t v = row[c];
+    sq += v * v;
+    l1 += myAbs(v);
+    nnz += v != value_t(0);
+  }
+  for (int o = WarpSize / 2; o > 0; o /= 2) {
+    sq += shfl_xor(sq, o);
+    l1 += shfl_xor(l1, o);
+    nnz += shfl_xor(nnz, o);
+  }
+  if (lane == 0) stats[i] = SparseRowStats<value_t>{sq, l1, nnz};
+}
+
+template <typename value_t, typename Rows>
+__global__ void sparsePairwiseKernel(
+  value_t *out, const int *a_indptr, const int *a_indices,
+  const value_t *a_data, const SparseRowStats<value_t> *a_stats, int m,
+  Rows b, const SparseRowStats<value_t> *b_stats, int n,
+  SparseDistanceType metric) {
+  __shared__ int s_cols[SparseSmemNnz];
+  __shared__ value_t s_vals[SparseSmemNnz];
+  int j = threadIdx.x + blockIdx.x * blockDim.x;
+  for (int i = blockIdx.y; i < m; i += gridDim.y) {
+    const int *a_cols;
+    const value_t *a_vals;
+    int a_nnz = loadRow(a_cols, a_vals, s_cols, s_vals, a_indptr, a_indices,
+                        a_data, i);
+    if (j < n) {
+      SparsePairAcc<value_t> acc = b.accumulate(a_cols, a_vals, a_nnz, j);
+      out[size_t(i) * n + j] =
+        finalizeDistance(metric, acc, a_stats[i], b_stats[j], Rows::l1_from_a);
+    }
+  }
+}
+
+/**
+ * One block per row of A: the distances to a tile of rows of B are kept in
+ * registers, sorted with a block radix sort, and the kb nearest are written
+ * out. Similarities are negated, so that the nearest always come first.
+ */
+template <typename Rows, int TPB, int ITEMS>
+__global__ void sparseKnnTileKernel(
+  float *tile_D, long *tile_I, int kb, const int *a_indptr,
+  const int *a_indices, const float *a_data,
+  const SparseRowStats<float> *a_stats, int m, Rows b,
+  const SparseRowStats<float> *b_stats, int b_start, int n_tile,
+  SparseDistanceType metric) {
+  typedef cub::BlockRadixSort<float, TPB, ITEMS, int> BlockSort;
+  __shared__ typename BlockSort::TempStorage sort_temp;
+  __shared__ int s_cols[SparseSmemNnz];
+  __shared__ float s_vals[SparseSmemNnz];
+  float sign = metric == SparseInnerProduct ? -1.f : 1.f;
+  for (int i = blockIdx.x; i < m; i += gridDim.x) {
+    const int *a_cols;
+    const float *a_vals;
+    int a_nnz = loadRow(a_cols, a_vals, s_cols, s_vals, a_indptr, a_indices,
+                        a_data, i);
+    float keys[ITEMS];
+    int cols[ITEMS];
+#pragma unroll
+    for (int it = 0; it < ITEMS; it++) {
+      int c = threadIdx.x * ITEMS + it;
+      keys[it] = FLT_MAX;
+      cols[it] = c;
+      if (c < n_tile) {
+        int j = b_start + c;
+        SparsePairAcc<float> acc = b.accumulate(a_cols, a_vals, a_nnz, j);
+        keys[it] = sign * finalizeDistance(metric, acc, a_stats[i],
+                                           b_stats[j], Rows::l1_from_a);
+      }
+    }
+    BlockSort(sort_temp).Sort(keys, cols);
+#pragma unroll
+    for (int it = 0; it < ITEMS; it++) {
+      int r = threadIdx.x * ITEMS + it;
+      if (r < kb) {
+        tile_D[size_t(i) * kb + r] = keys[it];
+        tile_I[size_t(i) * kb + r] = cols[it];
+      }
+    }
+  }
+}
+
+template <typename value_t, typename Rows>
+void sparsePairwiseImpl(value_t *out, const int *a_indptr,
+                        const int *a_indices, const value_t *a_data, int m,
+                        Rows b, const SparseRowStats<value_t> *b_stats, int n,
+                        SparseDistanceType metric,
+                        std::shared_ptr<deviceAllocator> allocator,
+                        cudaStream_t stream) {
+  static const int TPB = 256;
+  if (m == 0 || n == 0) return;
+  device_buffer<SparseRowStats<value_t>> a_stats(allocator, stream, m);
+  csrRowStatsKernel<<<ceildiv(m, TPB), TPB, 0, stream>>>(
+    a_stats.data(), a_indptr, a_data, m);
+  dim3 grid(ceildiv(n, TPB), std::min(m, 65535));
+  sparsePairwiseKernel<<<grid, TPB, 0, stream>>>(
+    out, a_indptr, a_indices, a_data, a_stats.data(), m, b, b_stats, n,
+    metric);
+  CUDA_CHECK(cudaPeekAtLastError());
+}
+
+template <typename Rows>
+void sparseKnnImpl(long *res_I, float *res_D, int k, const int *a_indptr,
+                   const int *a_indices, const float *a_data, int m, Rows b,
+                   const SparseRowStats<float> *b_stats, int n,
+                   SparseDistanceType metric,
+                   std::shared_ptr<deviceAllocator> allocator,
+                   cudaStream_t stream) {
+  static const int TPB = 128, ITEMS = 16, TILE = TPB * ITEMS;
+  ASSERT(k > 0 && k <= 1024, "sparse knn: k must be in [1, 1024]");
+  if (m == 0) return;
+  size_t res_len = size_t(m) * k;
+  device_buffer<SparseRowStats<float>> a_stats(allocator, stream, m);
+  csrRowStatsKernel<<<ceildiv(m, TPB), TPB, 0, stream>>>(
+    a_stats.data(), a_indptr, a_data, m);
+  device_buffer<float> tile_D(allocator, stream, res_len);
+  device_buffer<long> tile_I(allocator, stream, res_len);
+  device_buffer<float> tmp_D(allocator, stream, res_len);
+  device_buffer<long> tmp_I(allocator, stream, res_len);
+  float *cur_D = res_D, *nxt_D = tmp_D.data();
+  long *cur_I = res_I, *nxt_I = tmp_I.data();
+  auto exec = thrust::cuda::par.on(stream);
+  thrust::fill(exec, cur_D, cur_D + res_len, FLT_MAX);
+  thrust::fill(exec, cur_I, cur_I + res_len, -1L);
+
+  int n_blks = std::min(m, 65535);
+  for (int b_start = 0; b_start < n; b_start += TILE) {
+    int n_tile = std::min(TILE, n - b_start);
+    int kb = std::min(k, n_tile);
+    sparseKnnTileKernel<Rows, TPB, ITEMS><<<n_blks, TPB, 0, stream>>>(
+      tile_D.data(), tile_I.data(), kb, a_indptr, a_indices, a_data,
+      a_stats.data(), m, b, b_stats, b_start, n_tile, metric);
+    Selection::knn_merge_sorted_kernel<<<ceildiv(m, TPB), TPB, 0, stream>>>(
+      nxt_D, nxt_I, cur_D, cur_I, tile_D.data(), tile_I.data(), kb, b_start,
+      m, k);
+    CUDA_CHECK(cudaPeekAtLastError());
+    std::swap(cur_D, nxt_D);
+    std::swap(cur_I, nxt_I);
+  }
+  if (cur_D != res_D) {
+    copy(res_D, cur_D, res_len, stream);
+    copy(res_I, cur_I, res_len, stream);
+  }
+  if (metric == SparseInnerProduct) {
+    thrust::transform(exec, res_D, res_D + res_len, res_D,
+                      [] __device__(float d) { return -d; });
+  }
+}
+
+}  // anonymous namespace
+
+/**
+ * @brief Pairwise distances between the rows of two CSR matrices
+ *
+ * Each pair is computed in a single pass over the nonzeros of the row of b,
+ * looking its columns up in the row of a (staged in shared memory): the dot
+ * product, the intersection size and the l1 terms give all the metrics
+ * together with the row norms. A tile of the full distance matrix is
+ * obtained by passing a row range of a and/or b, i.e. a_indptr + row_start
+ * (the offsets in indptr are not rebased).
+ *
+ * @param out output distances, row-major m x n (device)
+ * @param a_indptr row offsets of a, size m + 1
+ * @param a_indices column indices of a, sorted within each row
+ * @param a_data values of a
+ * @param m number of rows of a
+ * @param b_indptr row offsets of b, size n + 1
+ * @param b_indices column indices of b
+ * @param b_data values of b
+ * @param n number of rows of b
+ * @param metric the distance metric
+ * @param allocator device allocator
+ * @param stream cuda stream
+ */
+template <typename value_t>
+void pairwiseDistanceCsr(value_t *out, const int *a_indptr,
+                         const int *a_indices, const value_t *a_data, int m,
+                         const int *b_indptr, const int *b_indices,
+                         const value_t *b_data, int n,
+                         SparseDistanceType metric,
+                         std::shared_ptr<deviceAllocator> allocator,
+                         cudaStream_t stream) {
+  static const int TPB = 256;
+  if (m == 0 || n == 0) return;
+  device_buffer<SparseRowStats<value_t>> b_stats(allocator, stream, n);
+  csrRowStatsKernel<<<ceildiv(n, TPB), TPB, 0, stream>>>(
+    b_stats.data(), b_indptr, b_data, n);
+  CsrRows<value_t> b = {b_indptr, b_indices, b_data};
+  sparsePairwiseImpl(out, a_indptr, a_indices, a_data, m, b, b_stats.data(),
+                     n, metric, allocator, stream);
+}
+
+/**
+ * @brief Pairwise distances between the rows of a CSR matrix a and of a
+ * dense row-major matrix b (n x D). Parameters are the same as for
+ * pairwiseDistanceCsr; the a column indices need not be sorted here.
+ */
+template <typename value_t>
+void pairwiseDistanceCsrDense(value_t *out, const int *a_indptr,
+                              const int *a_indices, const value_t *a_data,
+                              int m, const value_t *b, int n, int D,
+                              SparseDistanceType metric,
+                              std::shared_ptr<deviceAllocator> allocator,
+                              cudaStream_t stream) {
+  static const int TPB = 256;
+  if (m == 0 || n == 0) return;
+  device_buffer<SparseRowStats<value_t>> b_stats(allocator, stream, n);
+  denseRowStatsKernel<<<ceildiv(n * WarpSize, TPB), TPB, 0, stream>>>(
+    b_stats.data(), b, n, D);
+  DenseRows<value_t> rows = {b, D};
+  sparsePairwiseImpl(out, a_indptr, a_indices, a_data, m, rows,
+                     b_stats.data(), n, metric, allocator, stream);
+}
+
+/**
+ * @brief k nearest rows of the CSR matrix b for each row of the CSR matrix
+ * a, with the top-k selection fused into the distance computation.
+ *
+ * The rows of b are processed in tiles of 2048: the distances of a row of a
+ * to a tile are sorted in shared memory and only the k nearest are merged
+ * into the running result, so no distance matrix is materialized. For
+ * SparseInnerProduct the k largest products are returned.
+ *
+ * @param res_I output neighbor indices, row-major m x k (device)
+ * @param res_D output distances, row-major m x k (device)
+ * @param k number of neighbors, at most 1024
+ * (other parameters as for pairwiseDistanceCsr)
+ */
+inline void knnCsr(long *res_I, float *res_D, int k, const int *a_indptr,
+                   const int *a_indices, const float *a_data, int m,
+                   const int *b_indptr, const int *b_indices,
+                   const float *b_data, int n, SparseDistanceType metric,
+                   std::shared_ptr<deviceAllocator> allocator,
+                   cudaStream_t stream) {
+  static const int TPB = 256;
+  device_buffer<SparseRowStats<float>> b_stats(allocator, stream,
+                                               std::max(n, 1));
+  if (n > 0) {
+    csrRowStatsKernel<<<ceildiv(n, TPB), TPB, 0, stream>>>(
+      b_stats.data(), b_indptr, b_data, n);
+  }
+  CsrRows<float> b = {b_indptr, b_indices, b_data};
+  sparseKnnImpl(res_I, res_D, k, a_indptr, a_indices, a_data, m, b,
+                b_stats.data(), n, metric, allocator, stream);
+}
+
+/**
+ * @brief k nearest rows of the dense row-major matrix b (n x D) for each row
+ * of the CSR matrix a, as knnCsr.
+ */
+inline void knnCsrDense(long *res_I, float *res_D, int k, const int *a_indptr,
+                        const int *a_indices, const float *a_data, int m,
+                        const float *b, int n, int D,
+                        SparseDistanceType metric,
+                        std::shared_ptr<deviceAllocator> allocator,
+                        cudaStream_t stream) {
+  static const int TPB = 256;
+  device_buffer<SparseRowStats<float>> b_stats(allocator, stream,
+                                               std::max(n, 1));
+  if (n > 0) {
+    denseRowStatsKernel<<<ceildiv(n * WarpSize, TPB), TPB, 0, stream>>>(
+      b_stats.data(), b, n, D);
+  }
+  DenseRows<float> rows = {b, D};
+  sparseKnnImpl(res_I, res_D, k, a_indptr, a_indices, a_data, m, rows,
+                b_stats.data(), n, metric, allocator, stream);
+}
+
+};  // namespace Sparse
+};  // namespace MLCommon
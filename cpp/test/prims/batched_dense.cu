@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "cuda_utils.h"
+#include "linalg/batched_dense.h"
+#include "linalg/cusolver_wrappers.h"
+#include "linalg/eig.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace LinAlg {
+
+template <typename T>
+struct BatchedDenseInputs {
+  T tolerance;
+  int n;
+  int batch_size;
+  unsigned long long int seed;
+};
+
+template <typename T>
+::std::ostream &operator<<(::std::ostream &os,
+                           const BatchedDenseInputs<T> &dims) {
+  return os;
+}
+
+template <typename T>
+class BatchedDenseTest
+  : public ::testing::TestWithParam<BatchedDenseInputs<T>> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<BatchedDenseInputs<T>>::GetParam();
+    CUSOLVER_CHECK(cusolverDnCreate(&cusolverH));
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+    int n = params.n, m = 2 * params.n, batch = params.batch_size;
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+
+    // SPD systems A = M * M^T + n * I with known solutions, and
+    // overdetermined consistent systems for least squares
+    std::vector<T> A_h(batch * n * n), B_h(batch * n), A_ls_h(batch * m * n),
+      B_ls_h(batch * m);
+    x_h.resize(batch * n);
+    for (int b = 0; b < batch; b++) {
+      std::vector<T> M(n * n);
+      for (auto &v : M) v = dist(gen);
+      T *A = &A_h[b * n * n];
+      for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+          T acc = i == j ? T(n) : T(0);
+          for (int k = 0; k < n; k++) acc += M[i + k * n] * M[j + k * n];
+          A[i + j * n] = acc;
+        }
+      }
+      T *x = &x_h[b * n];
+      for (int i = 0; i < n; i++) x[i] = dist(gen);
+      for (int i = 0; i < n; i++) {
+        T acc = T(0);
+        for (int j = 0; j < n; j++) acc += A[i + j * n] * x[j];
+        B_h[b * n + i] = acc;
+      }
+      T *A_ls = &A_ls_h[b * m * n];
+      for (int i = 0; i < m * n; i++) A_ls[i] = dist(gen);
+      for (int i = 0; i < m; i++) {
+        T acc = T(0);
+        for (int j = 0; j < n; j++) acc += A_ls[i + j * m] * x[j];
+        B_ls_h[b * m + i] = acc;
+      }
+    }
+
+    allocate(A, batch * n * n);
+    allocate(factors, batch * n * n);
+    allocate(x_chol, batch * n);
+    allocate(x_lu, batch * n);
+    allocate(pivots, batch * n);
+    allocate(info, batch);
+    allocate(eig_vals, batch * n);
+    allocate(eig_vectors, batch * n * n);
+    allocate(eig_vals_ref, batch * n);
+    allocate(eig_vectors_ref, batch * n * n);
+    allocate(A_ls, batch * m * n);
+    allocate(B_ls, batch * m);
+    allocate(x_ls, batch * n);
+    updateDevice(A, A_h.data(), A_h.size(), stream);
+    updateDevice(A_ls, A_ls_h.data(), A_ls_h.size(), stream);
+    updateDevice(B_ls, B_ls_h.data(), B_ls_h.size(), stream);
+
+    std::vector<int> info_h(batch);
+    copy(factors, A, batch * n * n, stream);
+    updateDevice(x_chol, B_h.data(), B_h.size(), stream);
+    batchedCholesky(factors, n, batch, info, stream);
+    batchedCholeskySolve(factors, x_chol, n, 1, batch, stream);
+    updateHost(info_h.data(), info, batch, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    for (int b = 0; b < batch; b++) info_sum += info_h[b];
+
+    copy(factors, A, batch * n * n, stream);
+    updateDevice(x_lu, B_h.data(), B_h.size(), stream);
+    batchedLU(factors, pivots, n, batch, info, stream);
+    batchedLUSolve(factors, pivots, info, x_lu, n, 1, batch, stream);
+    updateHost(info_h.data(), info, batch, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    for (int b = 0; b < batch; b++) info_sum += info_h[b];
+
+    batchedLstsq(A_ls, B_ls, x_ls, m, n, 1, batch, info, stream);
+    updateHost(info_h.data(), info, batch, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    for (int b = 0; b < batch; b++) info_sum += info_h[b];
+
+    // Batched Jacobi against a loop of cuSOLVER calls
+    batchedEigJacobi(A, eig_vectors, eig_vals, n, batch, T(1e-7), 15, stream);
+    for (int b = 0; b < batch; b++) {
+      eigDC(A + b * n * n, n, n, eig_vectors_ref + b * n * n,
+            eig_vals_ref + b * n, cusolverH, stream, allocator);
+    }
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(A));
+    CUDA_CHECK(cudaFree(factors));
+    CUDA_CHECK(cudaFree(x_chol));
+    CUDA_CHECK(cudaFree(x_lu));
+    CUDA_CHECK(cudaFree(pivots));
+    CUDA_CHECK(cudaFree(info));
+    CUDA_CHECK(cudaFree(eig_vals));
+    CUDA_CHECK(cudaFree(eig_vectors));
+    CUDA_CHECK(cudaFree(eig_vals_ref));
+    CUDA_CHECK(cudaFree(eig_vectors_ref));
+    CUDA_CHECK(cudaFree(A_ls));
+    CUDA_CHECK(cudaFree(B_ls));
+    CUDA_CHECK(cudaFree(x_ls));
+    CUSOLVER_CHECK(cusolverDnDestroy(cusolverH));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  BatchedDenseInputs<T> params;
+  std::vector<T> x_h;
+  T *A, *factors, *x_chol, *x_lu, *eig_vals, *eig_vectors, *eig_vals_ref,
+    *eig_vectors_ref, *A_ls, *B_ls, *x_ls;
+  int *pivots, *info;
+  int info_sum = 0;
+  cusolverDnHandle_t cusolverH = NULL;
+  cudaStream_t stream;
+};
+
+const std::vector<BatchedDenseInputs<float>> inputsf = {
+  {0.001f, 4, 1000, 1234ULL}, {0.001f, 16, 100, 1234ULL},
+  {0.005f, 48, 20, 1234ULL}};
+
+const std::vector<BatchedDenseInputs<double>> inputsd = {
+  {0.000001, 4, 1000, 1234ULL}, {0.000001, 16, 100, 1234ULL},
+  {0.000001, 48, 20, 1234ULL}};
+
+typedef BatchedDenseTest<float> BatchedDenseTestF;
+TEST_P(BatchedDenseTestF, Result) {
+  int len = params.n * params.batch_size;
+  CompareApprox<float> cmp(params.tolerance);
+  ASSERT_EQ(info_sum, 0);
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_chol, len, cmp, stream));
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_lu, len, cmp, stream));
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_ls, len, cmp, stream));
+  ASSERT_TRUE(devArrMatch(eig_vals_ref, eig_vals, len, cmp));
+}
+
+typedef BatchedDenseTest<double> BatchedDenseTestD;
+TEST_P(BatchedDenseTestD, Result) {
+  int len = params.n * params.batch_size;
+  CompareApprox<double> cmp(params.tolerance);
+  ASSERT_EQ(info_sum, 0);
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_chol, len, cmp, stream));
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_lu, len, cmp, stream));
+  ASSERT_TRUE(devArrMatchHost(x_h.data(), x_ls, len, cmp, stream));
+  ASSERT_TRUE(devArrMatch(eig_vals_ref, eig_vals, len, cmp));
+}
+
+INSTANTIATE_TEST_CASE_P(BatchedDenseTests, BatchedDenseTestF,
+                        ::testing::ValuesIn(inputsf));
+
+INSTANTIATE_TEST_CASE_P(BatchedDenseTests, BatchedDenseTestD,
+                        ::testing::ValuesIn(inputsd));
+
+TEST(BatchedLUTest, Singular) {
+  // A matrix with a zero column next to 2 * I, with the same right hand side
+  int n = 3, batch = 2;
+  std::vector<double> A_h = {1, 0, 0, 0, 0, 0, 0, 0, 1,
+                             2, 0, 0, 0, 2, 0, 0, 0, 2};
+  std::vector<double> B_h = {1, 2, 3, 1, 2, 3};
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  double *A, *B;
+  int *pivots, *info;
+  allocate(A, batch * n * n);
+  allocate(B, batch * n);
+  allocate(pivots, batch * n);
+  allocate(info, batch);
+  updateDevice(A, A_h.data(), A_h.size(), stream);
+  updateDevice(B, B_h.data(), B_h.size(), stream);
+  batchedLU(A, pivots, n, batch, info, stream);
+  batchedLUSolve(A, pivots, info, B, n, 1, batch, stream);
+  std::vector<int> info_h(batch);
+  updateHost(info_h.data(), info, batch, stream);
+  updateHost(B_h.data(), B, B_h.size(), stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+
+  // The zero pivot is reported 1-based, as by getrf, and its system skipped
+  ASSERT_EQ(2, info_h[0]);
+  ASSERT_EQ(0, info_h[1]);
+  std::vector<double> expected = {1, 2, 3, 0.5, 1, 1.5};
+  for (int i = 0; i < batch * n; i++) ASSERT_EQ(expected[i], B_h[i]);
+
+  CUDA_CHECK(cudaFree(A));
+  CUDA_CHECK(cudaFree(B));
+  CUDA_CHECK(cudaFree(pivots));
+  CUDA_CHECK(cudaFree(info));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+TEST(BatchedEigJacobiTest, MaxDimDouble) {
+  // The largest double matrices still fit the 48 KB of shared memory
+  int n = BATCHED_MAX_DIM, batch = 4;
+  std::mt19937 gen(1234ULL);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> A_h(batch * n * n);
+  for (int b = 0; b < batch; b++) {
+    double *A = &A_h[b * n * n];
+    for (int j = 0; j < n; j++) {
+      for (int i = 0; i <= j; i++) A[i + j * n] = A[j + i * n] = dist(gen);
+    }
+  }
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  cusolverDnHandle_t cusolverH;
+  CUSOLVER_CHECK(cusolverDnCreate(&cusolverH));
+  std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+  double *A, *eig_vals, *eig_vectors, *eig_vals_ref, *eig_vectors_ref;
+  allocate(A, batch * n * n);
+  allocate(eig_vals, batch * n);
+  allocate(eig_vectors, batch * n * n);
+  allocate(eig_vals_ref, batch * n);
+  allocate(eig_vectors_ref, batch * n * n);
+  updateDevice(A, A_h.data(), A_h.size(), stream);
+  batchedEigJacobi(A, eig_vectors, eig_vals, n, batch, 1e-10, 15, stream);
+  for (int b = 0; b < batch; b++) {
+    eigDC(A + b * n * n, n, n, eig_vectors_ref + b * n * n,
+          eig_vals_ref + b * n, cusolverH, stream, allocator);
+  }
+  std::vector<double> vals_h(batch * n), vecs_h(batch * n * n);
+  updateHost(vals_h.data(), eig_vals, vals_h.size(), stream);
+  updateHost(vecs_h.data(), eig_vectors, vecs_h.size(), stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+
+  ASSERT_TRUE(devArrMatch(eig_vals_ref, eig_vals, batch * n,
+                          CompareApprox<double>(1e-6)));
+  // Eigenvectors are only defined up to their sign: check A v = lambda v
+  for (int b = 0; b < batch; b++) {
+    const double *M = &A_h[b * n * n], *V = &vecs_h[b * n * n];
+    for (int k = 0; k < n; k++) {
+      for (int i = 0; i < n; i++) {
+        double acc = 0.0;
+        for (int j = 0; j < n; j++) acc += M[i + j * n] * V[j + k * n];
+        ASSERT_NEAR(vals_h[b * n + k] * V[i + k * n], acc, 1e-6);
+      }
+    }
+  }
+
+  CUDA_CHECK(cudaFree(A));
+  CUDA_CHECK(cudaFree(eig_vals));
+  CUDA_CHECK(cudaFree(eig_vectors));
+  CUDA_CHECK(cudaFree(eig_vals_ref));
+  CUDA_CHECK(cudaFree(eig_vectors_ref));
+  CUSOLVER_CHECK(cusolverDnDestroy(cusolverH));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+/**
+ * Timing of the batched prims against a loop of cuSOLVER calls, one per
+ * matrix. Disabled by default, run with --gtest_also_run_disabled_tests.
+ */
+TEST(BatchedDenseBench, DISABLED_BatchedVsLoop) {
+  typedef std::chrono::high_resolution_clock Clock;
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  cusolverDnHandle_t cusolverH;
+  CUSOLVER_CHECK(cusolverDnCreate(&cusolverH));
+  std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+
+  auto time = [&](const std::string &name, std::function<void()> f) {
+    f();  // warm up
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    auto start = Clock::now();
+    f();
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    std::chrono::duration<double, std::milli> ms = Clock::now() - start;
+    std::cout << name << ": " << ms.count() << " ms" << std::endl;
+  };
+
+  for (int n : {4, 16, 32, 64}) {
+    int batch = 10000;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    // Diagonally dominant symmetric matrices: SPD, and no zero pivot
+    std::vector<float> A_h((size_t)batch * n * n), B_h((size_t)batch * n);
+    for (int b = 0; b < batch; b++) {
+      float *A = &A_h[(size_t)b * n * n];
+      for (int j = 0; j < n; j++) {
+        for (int i = j; i < n; i++) {
+          A[i + j * n] = A[j + i * n] = i == j ? float(n) : dist(gen);
+        }
+      }
+    }
+    for (auto &v : B_h) v = dist(gen);
+
+    float *A, *factors, *B, *eig_vals, *eig_vectors, *workspace;
+    int *pivots, *info;
+    allocate(A, (size_t)batch * n * n);
+    allocate(factors, (size_t)batch * n * n);
+    allocate(B, (size_t)batch * n);
+    allocate(eig_vals, (size_t)batch * n);
+    allocate(eig_vectors, (size_t)batch * n * n);
+    allocate(pivots, (size_t)batch * n);
+    allocate(info, batch);
+    updateDevice(A, A_h.data(), A_h.size(), stream);
+    updateDevice(B, B_h.data(), B_h.size(), stream);
+    int lwork_lu, lwork_chol;
+    CUSOLVER_CHECK(
+      cusolverDngetrf_bufferSize(cusolverH, n, n, factors, n, &lwork_lu));
+    CUSOLVER_CHECK(cusolverDnpotrf_bufferSize(
+      cusolverH, CUBLAS_FILL_MODE_LOWER, n, factors, n, &lwork_chol));
+    allocate(workspace, std::max(lwork_lu, lwork_chol));
+    std::string dims = std::to_string(batch) + " matrices " +
+                       std::to_string(n) + "x" + std::to_string(n);
+
+    time("LU + solve, " + dims + ", batched", [&]() {
+      copy(factors, A, (size_t)batch * n * n, stream);
+      batchedLU(factors, pivots, n, batch, info, stream);
+      batchedLUSolve(factors, pivots, info, B, n, 1, batch, stream);
+    });
+    time("LU + solve, " + dims + ", cuSOLVER loop", [&]() {
+      copy(factors, A, (size_t)batch * n * n, stream);
+      for (int b = 0; b < batch; b++) {
+        size_t off = (size_t)b * n * n;
+        CUSOLVER_CHECK(cusolverDngetrf(cusolverH, n, n, factors + off, n,
+                                       workspace, pivots + b * n, info + b,
+                                       stream));
+        CUSOLVER_CHECK(cusolverDngetrs(
+          cusolverH, CUBLAS_OP_N, n, 1, factors + off, n, pivots + b * n,
+          B + b * n, n, info + b, stream));
+      }
+    });
+    time("Cholesky + solve, " + dims + ", batched", [&]() {
+      copy(factors, A, (size_t)batch * n * n, stream);
+      batchedCholesky(factors, n, batch, info, stream);
+      batchedCholeskySolve(factors, B, n, 1, batch, stream);
+    });
+    time("Cholesky + solve, " + dims + ", cuSOLVER loop", [&]() {
+      copy(factors, A, (size_t)batch * n * n, stream);
+      for (int b = 0; b < batch; b++) {
+        size_t off = (size_t)b * n * n;
+        CUSOLVER_CHECK(cusolverDnpotrf(cusolverH, CUBLAS_FILL_MODE_LOWER, n,
+                                       factors + off, n, workspace,
+                                       lwork_chol, info + b, stream));
+        CUSOLVER_CHECK(cusolverDnpotrs(cusolverH, CUBLAS_FILL_MODE_LOWER, n,
+                                       1, factors + off, n, B + b * n, n,
+                                       info + b, stream));
+      }
+    });
+    time("eig, " + dims + ", batched Jacobi", [&]() {
+      batchedEigJacobi(A, eig_vectors, eig_vals, n, batch, 1e-7f, 15, stream);
+    });
+    time("eig, " + dims + ", eigDC loop", [&]() {
+      for (int b = 0; b < batch; b++) {
+        eigDC(A + (size_t)b * n * n, n, n, eig_vectors + (size_t)b * n * n,
+              eig_vals + (size_t)b * n, cusolverH, stream, allocator);
+      }
+    });
+
+    CUDA_CHECK(cudaFree(A));
+    CUDA_CHECK(cudaFree(factors));
+    CUDA_CHECK(cudaFree(B));
+    CUDA_CHECK(cudaFree(eig_vals));
+    CUDA_CHECK(cudaFree(eig_vectors));
+    CUDA_CHECK(cudaFree(workspace));
+    CUDA_CHECK(cudaFree(pivots));
+    CUDA_CHECK(cudaFree(info));
+  }
+  CUSOLVER_CHECK(cusolverDnDestroy(cusolverH));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+}  // end namespace LinAlg
+}  // end namespace MLCommon
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "cuda_utils.h"
+#include "distance/mixed_precision.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Distance {
+
+struct DistMixedInputs {
+  float tolerance;
+  int m, n, k;
+  int n_neighbors;
+  float eps;
+  unsigned long long int seed;
+};
+
+::std::ostream &operator<<(::std::ostream &os, const DistMixedInputs &dims) {
+  return os;
+}
+
+class DistMixedTest : public ::testing::TestWithParam<DistMixedInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<DistMixedInputs>::GetParam();
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    CUBLAS_CHECK(cublasCreate(&cublasH));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+    int m = params.m, n = params.n, k = params.k, nn = params.n_neighbors;
+
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> x_h(m * k), y_h(n * k);
+    for (auto &v : x_h) v = dist(gen);
+    for (auto &v : y_h) v = dist(gen);
+
+    allocate(x, m * k);
+    allocate(y, n * k);
+    allocate(dist_ref, m * n);
+    allocate(dist_fp16, m * n);
+    allocate(adj_ref, m * n);
+    allocate(adj_fp16, m * n);
+    allocate(cand, m * n);
+    allocate(knn_idx, m * nn);
+    allocate(knn_dist, m * nn);
+    updateDevice(x, x_h.data(), m * k, stream);
+    updateDevice(y, y_h.data(), n * k, stream);
+
+    device_buffer<char> workspace(allocator, stream);
+    pairwiseDistanceMixed(x, y, dist_ref, m, n, k, workspace, EucExpandedL2,
+                          GemmFp32, cublasH, stream);
+    pairwiseDistanceMixed(x, y, dist_fp16, m, n, k, workspace, EucExpandedL2,
+                          GemmFp16, cublasH, stream);
+
+    // the refined fp16 neighborhood must be the exact fp32 one
+    constexpr auto exact_type = EucUnexpandedL2;
+    size_t worksize =
+      getWorkspaceSize<exact_type, float, float, bool>(x, y, m, n, k);
+    workspace.resize(worksize, stream);
+    epsilon_neighborhood<exact_type, float>(x, y, adj_ref, m, n, k,
+                                            params.eps, workspace.data(),
+                                            worksize, stream);
+    auto no_op = [] __device__(int c_idx, bool in_neigh) {};
+    epsilonNeighborhoodMixed(x, y, adj_fp16, m, n, k, params.eps, GemmFp16,
+                             workspace, cublasH, stream, no_op);
+
+    // every point of y as a candidate, in a shuffled order per query
+    std::vector<int> cand_h(m * n), row(n);
+    std::iota(row.begin(), row.end(), 0);
+    for (int i = 0; i < m; i++) {
+      std::shuffle(row.begin(), row.end(), gen);
+      std::copy(row.begin(), row.end(), cand_h.begin() + i * n);
+    }
+    updateDevice(cand, cand_h.data(), m * n, stream);
+    refineKnnCandidates(x, y, m, k, cand, n, nn, knn_idx, knn_dist, false,
+                        stream);
+
+    // host reference for the neighbors, ties broken by the smaller index
+    knn_idx_ref.resize(m * nn);
+    knn_dist_ref.resize(m * nn);
+    std::vector<float> d(n);
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < n; j++) {
+        float acc = 0.f;
+        for (int l = 0; l < k; l++) {
+          float diff = x_h[i * k + l] - y_h[j * k + l];
+          acc += diff * diff;
+        }
+        d[j] = acc;
+      }
+      std::iota(row.begin(), row.end(), 0);
+      std::stable_sort(row.begin(), row.end(),
+                       [&](int a, int b) { return d[a] < d[b]; });
+      for (int j = 0; j < nn; j++) {
+        knn_idx_ref[i * nn + j] = row[j];
+        knn_dist_ref[i * nn + j] = d[row[j]];
+      }
+    }
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(x));
+    CUDA_CHECK(cudaFree(y));
+    CUDA_CHECK(cudaFree(dist_ref));
+    CUDA_CHECK(cudaFree(dist_fp16));
+    CUDA_CHECK(cudaFree(adj_ref));
+    CUDA_CHECK(cudaFree(adj_fp16));
+    CUDA_CHECK(cudaFree(cand));
+    CUDA_CHECK(cudaFree(knn_idx));
+    CUDA_CHECK(cudaFree(knn_dist));
+    CUBLAS_CHECK(cublasDestroy(cublasH));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  DistMixedInputs params;
+  float *x, *y, *dist_ref, *dist_fp16, *knn_dist;
+  bool *adj_ref, *adj_fp16;
+  int *cand, *knn_idx;
+  std::vector<int> knn_idx_ref;
+  std::vector<float> knn_dist_ref;
+  cublasHandle_t cublasH;
+  cudaStream_t stream;
+};
+
+const std::vector<DistMixedInputs> inputs = {
+  {0.01f, 256, 200, 32, 10, 20.f, 1234ULL},
+  {0.01f, 100, 512, 64, 32, 40.f, 1234ULL},
+  {0.01f, 33, 129, 7, 5, 4.f, 1234ULL}};
+
+TEST_P(DistMixedTest, Result) {
+  int m = params.m, n = params.n, nn = params.n_neighbors;
+  ASSERT_TRUE(devArrMatch(dist_ref, dist_fp16, m * n,
+                          CompareApprox<float>(params.tolerance), stream));
+  ASSERT_TRUE(devArrMatch(adj_ref, adj_fp16, m * n, Compare<bool>(), stream));
+  ASSERT_TRUE(devArrMatchHost(knn_idx_ref.data(), knn_idx, m * nn,
+                              Compare<int>(), stream));
+  ASSERT_TRUE(devArrMatchHost(knn_dist_ref.data(), knn_dist, m * nn,
+                              CompareApprox<float>(0.0001f), stream));
+}
+
+INSTANTIATE_TEST_CASE_P(DistMixedTests, DistMixedTest,
+                        ::testing::ValuesIn(inputs));
+
+}  // end namespace Distance
+}  // end namespace MLCommon
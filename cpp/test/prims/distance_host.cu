@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "distance/distance.h"
+#include "distance/distance_host.h"
+#include "random/rng.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Distance {
+
+template <typename T>
+struct DistanceHostInputs {
+  T tolerance;
+  int m, n, k;
+  DistanceType metric;
+  bool isRowMajor;
+  unsigned long long int seed;
+};
+
+template <typename T>
+::std::ostream &operator<<(::std::ostream &os,
+                           const DistanceHostInputs<T> &dims) {
+  return os;
+}
+
+template <typename T>
+class DistanceHostTest
+  : public ::testing::TestWithParam<DistanceHostInputs<T>> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<DistanceHostInputs<T>>::GetParam();
+    int m = params.m, n = params.n, k = params.k;
+    Random::Rng r(params.seed);
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+    allocate(x, m * k);
+    allocate(y, n * k);
+    allocate(dist, m * n);
+    r.uniform(x, m * k, T(-1.0), T(1.0), stream);
+    r.uniform(y, n * k, T(-1.0), T(1.0), stream);
+
+    device_buffer<char> workspace(allocator, stream);
+    pairwiseDistance<T, int>(x, y, dist, m, n, k, workspace, params.metric,
+                             stream, params.isRowMajor);
+
+    std::vector<T> x_h(m * k), y_h(n * k);
+    updateHost(x_h.data(), x, m * k, stream);
+    updateHost(y_h.data(), y, n * k, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    dist_h.resize(m * n);
+    pairwiseDistanceHost<T, int>(x_h.data(), y_h.data(), dist_h.data(), m, n,
+                                 k, params.metric, params.isRowMajor);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(x));
+    CUDA_CHECK(cudaFree(y));
+    CUDA_CHECK(cudaFree(dist));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  DistanceHostInputs<T> params;
+  T *x, *y, *dist;
+  std::vector<T> dist_h;
+  cudaStream_t stream;
+};
+
+const std::vector<DistanceHostInputs<float>> inputsf = {
+  {0.001f, 1024, 1024, 32, EucExpandedL2, true, 1234ULL},
+  {0.001f, 1024, 1024, 32, EucExpandedL2Sqrt, true, 1234ULL},
+  {0.001f, 1024, 1024, 32, EucExpandedCosine, true, 1234ULL},
+  {0.001f, 1024, 1024, 32, EucUnexpandedL1, true, 1234ULL},
+  {0.001f, 1024, 1024, 32, EucUnexpandedL2, true, 1234ULL},
+  {0.001f, 1024, 1024, 32, EucUnexpandedL2Sqrt, true, 1234ULL},
+  {0.001f, 37, 211, 130, EucExpandedL2, false, 1234ULL},
+  {0.001f, 37, 211, 130, EucExpandedCosine, false, 1234ULL},
+  {0.001f, 37, 211, 130, EucUnexpandedL1, false, 1234ULL},
+  {0.001f, 37, 211, 130, EucUnexpandedL2Sqrt, false, 1234ULL}};
+
+const std::vector<DistanceHostInputs<double>> inputsd = {
+  {0.0001, 1024, 512, 32, EucExpandedL2Sqrt, true, 1234ULL},
+  {0.0001, 1024, 512, 32, EucExpandedCosine, true, 1234ULL},
+  {0.0001, 1024, 512, 32, EucUnexpandedL1, true, 1234ULL},
+  {0.0001, 77, 300, 19, EucUnexpandedL2, false, 1234ULL}};
+
+typedef DistanceHostTest<float> DistanceHostTestF;
+TEST_P(DistanceHostTestF, Result) {
+  ASSERT_TRUE(devArrMatchHost(dist_h.data(), dist, params.m * params.n,
+                              CompareApprox<float>(params.tolerance), stream));
+}
+
+typedef DistanceHostTest<double> DistanceHostTestD;
+TEST_P(DistanceHostTestD, Result) {
+  ASSERT_TRUE(devArrMatchHost(dist_h.data(), dist, params.m * params.n,
+                              CompareApprox<double>(params.tolerance),
+                              stream));
+}
+
+INSTANTIATE_TEST_CASE_P(DistanceHostTests, DistanceHostTestF,
+                        ::testing::ValuesIn(inputsf));
+
+INSTANTIATE_TEST_CASE_P(DistanceHostTests, DistanceHostTestD,
+                        ::testing::ValuesIn(inputsd));
+
+}  // end namespace Distance
+}  // end namespace MLCommon
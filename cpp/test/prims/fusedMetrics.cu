@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "score/fusedMetrics.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Score {
+
+struct FusedRegressionInputs {
+  int n, k;
+  unsigned long long seed;
+};
+
+template <typename T>
+class FusedRegressionTest
+  : public ::testing::TestWithParam<FusedRegressionInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<FusedRegressionInputs>::GetParam();
+    int n = params.n, k = params.k;
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<T> dist(-10, 10);
+    y.resize(n);
+    y_hat.resize(size_t(n) * k);
+    for (auto &v : y) v = dist(gen);
+    for (int j = 0; j < k; ++j) {
+      // prediction vectors of decreasing quality
+      for (int i = 0; i < n; ++i)
+        y_hat[size_t(j) * n + i] = y[i] + dist(gen) * T(j + 1) / T(k);
+    }
+
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    allocator.reset(new defaultDeviceAllocator);
+    allocate(d_y, n);
+    allocate(d_y_hat, size_t(n) * k);
+    updateDevice(d_y, y.data(), n, stream);
+    updateDevice(d_y_hat, y_hat.data(), size_t(n) * k, stream);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(d_y));
+    CUDA_CHECK(cudaFree(d_y_hat));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  /** the metrics of prediction vector j over [begin, end), on the host */
+  void reference(int j, int begin, int end, double *mse, double *mae,
+                 double *r2, double *median_ae) {
+    int n = params.n;
+    double sum_sq = 0, sum_abs = 0, mean = 0, ss_tot = 0;
+    std::vector<double> abs_err;
+    for (int i = begin; i < end; ++i) mean += y[i];
+    mean /= end - begin;
+    for (int i = begin; i < end; ++i) {
+      T err = y_hat[size_t(j) * n + i] - y[i];
+      sum_sq += double(err) * err;
+      sum_abs += std::abs(double(err));
+      ss_tot += (y[i] - mean) * (y[i] - mean);
+      abs_err.push_back(std::abs(double(err)));
+    }
+    *mse = sum_sq / (end - begin);
+    *mae = sum_abs / (end - begin);
+    *r2 = 1.0 - sum_sq / ss_tot;
+    std::sort(abs_err.begin(), abs_err.end());
+    size_t m = abs_err.size();
+    *median_ae = m % 2 == 1 ? abs_err[m / 2]
+                            : (abs_err[m / 2 - 1] + abs_err[m / 2]) / 2;
+  }
+
+  FusedRegressionInputs params;
+  std::vector<T> y, y_hat;
+  T *d_y = nullptr, *d_y_hat = nullptr;
+  std::shared_ptr<deviceAllocator> allocator;
+  cudaStream_t stream;
+};
+
+const std::vector<FusedRegressionInputs> regression_inputs = {
+  {1, 1, 1234ULL}, {10, 3, 1234ULL}, {1001, 4, 1234ULL},
+  {100000, 2, 1234ULL}, {257, 16, 1234ULL}};
+
+typedef FusedRegressionTest<float> FusedRegressionTestF;
+TEST_P(FusedRegressionTestF, Result) {
+  int n = params.n, k = params.k;
+  std::vector<RegressionStats> stats(k);
+  std::vector<double> median(k);
+  regressionStats(stats.data(), median.data(), d_y, d_y_hat, n, k, n,
+                  allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    double mse, mae, r2, median_ae;
+    reference(j, 0, n, &mse, &mae, &r2, &median_ae);
+    ASSERT_EQ(n, stats[j].count);
+    ASSERT_NEAR(mse, stats[j].mse(), 1e-6 * mse + 1e-9);
+    ASSERT_NEAR(mae, stats[j].mae(), 1e-6 * mae + 1e-9);
+    ASSERT_EQ(median_ae, median[j]);
+    if (n > 1) ASSERT_NEAR(r2, stats[j].r2(), 1e-6);
+  }
+}
+
+typedef FusedRegressionTest<double> FusedRegressionTestD;
+TEST_P(FusedRegressionTestD, Merge) {
+  // the partial results of two halves merge into those of the whole data
+  int n = params.n, k = params.k;
+  if (n < 2) return;
+  int half = n / 2;
+  std::vector<RegressionStats> whole(k), first(k), second(k);
+  regressionStats(whole.data(), nullptr, d_y, d_y_hat, n, k, n, allocator,
+                  stream);
+  regressionStats(first.data(), nullptr, d_y, d_y_hat, half, k, n, allocator,
+                  stream);
+  regressionStats(second.data(), nullptr, d_y + half, d_y_hat + half,
+                  n - half, k, n, allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    first[j].merge(second[j]);
+    double mse, mae, r2, median_ae;
+    reference(j, 0, n, &mse, &mae, &r2, &median_ae);
+    ASSERT_EQ(whole[j].count, first[j].count);
+    ASSERT_NEAR(whole[j].mse(), first[j].mse(), 1e-12 * mse);
+    ASSERT_NEAR(whole[j].mae(), first[j].mae(), 1e-12 * mae);
+    ASSERT_NEAR(r2, first[j].r2(), 1e-10);
+    ASSERT_NEAR(r2, whole[j].r2(), 1e-10);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(FusedMetricsTests, FusedRegressionTestF,
+                        ::testing::ValuesIn(regression_inputs));
+INSTANTIATE_TEST_CASE_P(FusedMetricsTests, FusedRegressionTestD,
+                        ::testing::ValuesIn(regression_inputs));
+
+struct FusedClassificationInputs {
+  int n, k, n_classes;
+  bool with_probs;
+  unsigned long long seed;
+};
+
+class FusedClassificationTest
+  : public ::testing::TestWithParam<FusedClassificationInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<FusedClassificationInputs>::GetParam();
+    int n = params.n, k = params.k, nc = params.n_classes;
+    std::mt19937 gen(params.seed);
+    std::uniform_int_distribution<int> label(0, nc - 1);
+    std::uniform_real_distribution<float> unif(0, 1);
+    y.resize(n);
+    y_pred.resize(size_t(n) * k);
+    for (auto &v : y) v = label(gen);
+    for (int j = 0; j < k; ++j) {
+      for (int i = 0; i < n; ++i)
+        y_pred[size_t(j) * n + i] = unif(gen) < 0.7f ? y[i] : label(gen);
+    }
+    if (params.with_probs) {
+      probs.resize(size_t(n) * nc * k);
+      for (size_t i = 0; i < size_t(n) * k; ++i) {
+        float sum = 0;
+        for (int c = 0; c < nc; ++c) sum += probs[i * nc + c] = unif(gen);
+        for (int c = 0; c < nc; ++c) probs[i * nc + c] /= sum;
+      }
+      // probabilities of 0 and 1, which are clipped
+      probs[0] = 0.0f;
+      probs[nc] = 1.0f;
+    }
+
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    allocator.reset(new defaultDeviceAllocator);
+    allocate(d_y, n);
+    allocate(d_y_pred, size_t(n) * k);
+    updateDevice(d_y, y.data(), n, stream);
+    updateDevice(d_y_pred, y_pred.data(), size_t(n) * k, stream);
+    if (params.with_probs) {
+      allocate(d_probs, probs.size());
+      updateDevice(d_probs, probs.data(), probs.size(), stream);
+    }
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(d_y));
+    CUDA_CHECK(cudaFree(d_y_pred));
+    if (d_probs != nullptr) CUDA_CHECK(cudaFree(d_probs));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  FusedClassificationInputs params;
+  std::vector<int> y, y_pred;
+  std::vector<float> probs;
+  int *d_y = nullptr, *d_y_pred = nullptr;
+  float *d_probs = nullptr;
+  std::shared_ptr<deviceAllocator> allocator;
+  cudaStream_t stream;
+};
+
+TEST_P(FusedClassificationTest, Result) {
+  int n = params.n, k = params.k, nc = params.n_classes;
+  const float eps = 1e-7f;
+  std::vector<ClassificationStats> stats(k);
+  classificationStats(stats.data(), d_y, d_y_pred, n, k, n, nc, d_probs,
+                      size_t(n) * nc, eps, allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    std::vector<unsigned long long> confusion(size_t(nc) * nc, 0);
+    int correct = 0;
+    double loss = 0;
+    for (int i = 0; i < n; ++i) {
+      int p = y_pred[size_t(j) * n + i];
+      confusion[size_t(y[i]) * nc + p]++;
+      correct += p == y[i];
+      if (params.with_probs) {
+        float prob = probs[(size_t(j) * n + i) * nc + y[i]];
+        prob = std::min(std::max(prob, eps), 1.0f - eps);
+        loss -= std::log(prob);
+      }
+    }
+    ASSERT_EQ(nc, stats[j].n_classes);
+    ASSERT_EQ(n, stats[j].count);
+    ASSERT_TRUE(confusion == stats[j].confusion);
+    ASSERT_EQ(double(correct) / n, stats[j].accuracy());
+    if (params.with_probs) {
+      ASSERT_NEAR(loss / n, stats[j].log_loss(), 1e-5 * loss / n);
+    } else {
+      ASSERT_EQ(0.0, stats[j].sum_log_loss);
+    }
+  }
+
+  // the partial results of two halves merge into those of the whole data
+  if (n < 2) return;
+  int half = n / 2;
+  std::vector<ClassificationStats> first(k), second(k);
+  classificationStats(first.data(), d_y, d_y_pred, half, k, n, nc, d_probs,
+                      size_t(n) * nc, eps, allocator, stream);
+  classificationStats(second.data(), d_y + half, d_y_pred + half, n - half, k,
+                      n, nc, d_probs != nullptr ? d_probs + half * nc : nullptr,
+                      size_t(n) * nc, eps, allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    first[j].merge(second[j]);
+    ASSERT_EQ(stats[j].count, first[j].count);
+    ASSERT_TRUE(stats[j].confusion == first[j].confusion);
+    ASSERT_NEAR(stats[j].sum_log_loss, first[j].sum_log_loss,
+                1e-5 * stats[j].sum_log_loss);
+  }
+}
+
+// 100 classes do not fit the confusion matrix in shared memory
+const std::vector<FusedClassificationInputs> classification_inputs = {
+  {1, 1, 2, true, 1234ULL},       {1000, 3, 2, true, 1234ULL},
+  {100000, 2, 10, true, 1234ULL}, {5000, 4, 7, false, 1234ULL},
+  {20000, 2, 100, true, 1234ULL}};
+
+INSTANTIATE_TEST_CASE_P(FusedMetricsTests, FusedClassificationTest,
+                        ::testing::ValuesIn(classification_inputs));
+
+TEST(FusedMetricsTests, CountMatches) {
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+  const int n = 12345;
+  std::vector<int> a(n), b(n);
+  unsigned long long want = 0;
+  for (int i = 0; i < n; ++i) {
+    a[i] = i % 7;
+    b[i] = i % 5;
+    want += a[i] == b[i];
+  }
+  int *d_a, *d_b;
+  allocate(d_a, n);
+  allocate(d_b, n);
+  updateDevice(d_a, a.data(), n, stream);
+  updateDevice(d_b, b.data(), n, stream);
+  ASSERT_EQ(want, countMatches(d_a, d_b, n, allocator, stream));
+  ASSERT_EQ(0ull, countMatches(d_a, d_b, 0, allocator, stream));
+  CUDA_CHECK(cudaFree(d_a));
+  CUDA_CHECK(cudaFree(d_b));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+}  // namespace Score
+}  // namespace MLCommon
@@ -20,6 +20,7 @@
 #include <cuda_utils.h>
 #include <test_utils.h>
 #include <iostream>
+#include <random>
 
 namespace MLCommon {
 namespace Selection {
@@ -109,5 +110,86 @@ TEST_F(KNNTestF, Fit) {
 			devArrMatch(d_ref_I, d_pred_I, n*n, Compare<long>()));
 }
 
+/**
+ * The out-of-core search streams a host index through small tiles and has to
+ * give the same result as the in-memory search.
+ */
+struct KNNHostInputs {
+  int n_index;
+  int n_queries;
+  int dim;
+  int k;
+  long tile_rows;
+};
+
+::std::ostream &operator<<(::std::ostream &os, const KNNHostInputs &dims) {
+  return os;
+}
+
+class KNNHostTest : public ::testing::TestWithParam<KNNHostInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<KNNHostInputs>::GetParam();
+    int m = params.n_index, n = params.n_queries, d = params.dim;
+    int k = params.k;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    CUDA_CHECK(cudaStreamCreate(&copy_stream));
+    std::shared_ptr<deviceAllocator> d_alloc(new defaultDeviceAllocator);
+    std::shared_ptr<hostAllocator> h_alloc(new defaultHostAllocator);
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    index_h.resize(m * d);
+    std::vector<float> queries_h(n * d);
+    for (auto &v : index_h) v = dist(gen);
+    for (auto &v : queries_h) v = dist(gen);
+    allocate(index, m * d);
+    allocate(queries, n * d);
+    updateDevice(index, index_h.data(), m * d, stream);
+    updateDevice(queries, queries_h.data(), n * d, stream);
+
+    allocate(ref_I, n * k);
+    allocate(ref_D, n * k);
+    allocate(pred_I, n * k);
+    allocate(pred_D, n * k);
+    int size = m;
+    brute_force_knn(&index, &size, 1, d, queries, n, ref_I, ref_D, k, stream);
+    brute_force_knn_host(index_h.data(), m, d, queries, n, pred_I, pred_D, k,
+                         d_alloc, h_alloc, stream, copy_stream,
+                         params.tile_rows);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(index));
+    CUDA_CHECK(cudaFree(queries));
+    CUDA_CHECK(cudaFree(ref_I));
+    CUDA_CHECK(cudaFree(ref_D));
+    CUDA_CHECK(cudaFree(pred_I));
+    CUDA_CHECK(cudaFree(pred_D));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+    CUDA_CHECK(cudaStreamDestroy(copy_stream));
+  }
+
+ protected:
+  KNNHostInputs params;
+  std::vector<float> index_h;
+  float *index, *queries, *ref_D, *pred_D;
+  long *ref_I, *pred_I;
+  cudaStream_t stream, copy_stream;
+};
+
+const std::vector<KNNHostInputs> inputs_host = {
+  {1000, 100, 8, 10, 1 << 20}, {1000, 100, 8, 10, 64}, {1000, 100, 8, 10, 7},
+  {5000, 333, 16, 32, 999},    {300, 50, 3, 1, 100}};
+
+TEST_P(KNNHostTest, Result) {
+  int len = params.n_queries * params.k;
+  ASSERT_TRUE(devArrMatch(ref_D, pred_D, len, CompareApprox<float>(1e-4)));
+  ASSERT_TRUE(devArrMatch(ref_I, pred_I, len, Compare<long>()));
+}
+
+INSTANTIATE_TEST_CASE_P(KNNHostTests, KNNHostTest,
+                        ::testing::ValuesIn(inputs_host));
+
 }; // end namespace Selection
 }; // end namespace ML
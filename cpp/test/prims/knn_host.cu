@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "distance/distance.h"
+#include "selection/knn.h"
+#include "selection/knn_host.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Selection {
+
+struct KnnHostInputs {
+  int n_index;
+  int n_queries;
+  int dim;
+  int k;
+  int n_parts;
+  long index_tile;
+};
+
+::std::ostream &operator<<(::std::ostream &os, const KnnHostInputs &dims) {
+  return os;
+}
+
+class KnnHostTest : public ::testing::TestWithParam<KnnHostInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<KnnHostInputs>::GetParam();
+    int n = params.n_index, q = params.n_queries, d = params.dim;
+    int k = params.k;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    index_h.resize(n * d);
+    queries_h.resize(q * d);
+    for (auto &v : index_h) v = dist(gen);
+    for (auto &v : queries_h) v = dist(gen);
+
+    // device search over n_parts partitions of the index
+    allocate(index, n * d);
+    allocate(queries, q * d);
+    allocate(res_I, q * k);
+    allocate(res_D, q * k);
+    updateDevice(index, index_h.data(), n * d, stream);
+    updateDevice(queries, queries_h.data(), q * d, stream);
+    std::vector<float *> ptrs;
+    std::vector<int> sizes;
+    int part = ceildiv(n, params.n_parts);
+    for (int start = 0; start < n; start += part) {
+      ptrs.push_back(index + start * d);
+      sizes.push_back(std::min(part, n - start));
+    }
+    brute_force_knn(ptrs.data(), sizes.data(), (int)ptrs.size(), d, queries,
+                    q, res_I, res_D, k, stream);
+    device_D.resize(q * k);
+    updateHost(device_D.data(), res_D, q * k, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+
+    host_I.resize(q * k);
+    host_D.resize(q * k);
+    knnHost(index_h.data(), n, d, queries_h.data(), q, host_I.data(),
+            host_D.data(), k, Distance::EucUnexpandedL2, params.index_tile);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(index));
+    CUDA_CHECK(cudaFree(queries));
+    CUDA_CHECK(cudaFree(res_I));
+    CUDA_CHECK(cudaFree(res_D));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  KnnHostInputs params;
+  float *index, *queries, *res_D;
+  long *res_I;
+  std::vector<float> index_h, queries_h, host_D, device_D;
+  std::vector<long> host_I;
+  cudaStream_t stream;
+};
+
+const std::vector<KnnHostInputs> inputs = {{1000, 100, 16, 10, 1, 1 << 13},
+                                           {1000, 100, 16, 10, 3, 128},
+                                           {5000, 257, 3, 32, 2, 333},
+                                           {40, 64, 50, 40, 4, 7}};
+
+TEST_P(KnnHostTest, MatchesDevice) {
+  int len = params.n_queries * params.k;
+  for (int i = 0; i < len; i++) {
+    // the distances identify the neighbors up to ties. The device evaluates
+    // them in the expanded form, hence the absolute error on small ones.
+    ASSERT_NEAR(device_D[i], host_D[i], 1e-4f * std::max(1.f, host_D[i]));
+    ASSERT_TRUE(host_I[i] >= 0 && host_I[i] < params.n_index);
+    if (i % params.k > 0) ASSERT_LE(host_D[i - 1], host_D[i]);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(KnnHostTests, KnnHostTest,
+                        ::testing::ValuesIn(inputs));
+
+TEST(SelectKHostTest, MatchesPartialSort) {
+  int rows = 33, cols = 517;
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> dist(-50, 50);
+  std::vector<float> arr(rows * cols);
+  for (auto &v : arr) v = dist(gen);
+  for (int select_min = 0; select_min < 2; select_min++) {
+    for (int k : {1, 16, 100, cols, cols + 5}) {
+      std::vector<float> outV(rows * k);
+      std::vector<int> outK(rows * k);
+      selectKHost(outV.data(), outK.data(), arr.data(), k, rows, cols,
+                  select_min == 1);
+      for (int r = 0; r < rows; r++) {
+        // reference: stable sort, so that ties are broken by index
+        const float *row = &arr[r * cols];
+        std::vector<int> order(cols);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+          return select_min ? row[a] < row[b] : row[a] > row[b];
+        });
+        for (int j = 0; j < k; j++) {
+          int expected = j < cols ? order[j] : -1;
+          ASSERT_EQ(expected, outK[r * k + j]);
+          if (j < cols) ASSERT_EQ(row[expected], outV[r * k + j]);
+        }
+      }
+    }
+  }
+}
+
+TEST(MergeTablesHostTest, MatchesMergeTables) {
+  long n = 50, k = 20, nshard = 5;
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<float> dist(0.f, 1.f);
+  std::vector<float> all_D(nshard * n * k);
+  std::vector<long> all_I(all_D.size()), translations(nshard);
+  for (long s = 0; s < nshard; s++) {
+    translations[s] = s * 1000;
+    for (long i = 0; i < n; i++) {
+      float *D = &all_D[(s * n + i) * k];
+      long *I = &all_I[(s * n + i) * k];
+      for (long j = 0; j < k; j++) D[j] = dist(gen);
+      std::sort(D, D + k);
+      std::iota(I, I + k, 0L);
+      // a shorter list on the last shard
+      if (s == nshard - 1) std::fill(I + k / 2, I + k, -1L);
+    }
+  }
+  std::vector<float> D(n * k), D_ref(n * k);
+  std::vector<long> I(n * k), I_ref(n * k);
+  mergeTablesHost(n, k, nshard, D.data(), I.data(), all_D.data(),
+                  all_I.data(), translations.data());
+  merge_tables<faiss::CMin<float, int>>(n, k, nshard, D_ref.data(),
+                                        I_ref.data(), all_D.data(),
+                                        all_I.data(), translations.data());
+  for (long i = 0; i < n * k; i++) {
+    ASSERT_EQ(I_ref[i], I[i]);
+    ASSERT_EQ(D_ref[i], D[i]);
+  }
+}
+
+/**
+ * Timing of the host backend against the device prims. Disabled by default,
+ * run with --gtest_also_run_disabled_tests.
+ */
+TEST(KnnHostBench, DISABLED_HostVsDevice) {
+  typedef std::chrono::high_resolution_clock Clock;
+  int n = 1 << 16, q = 1 << 12, d = 64, k = 32;
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  std::vector<float> index_h(n * d), queries_h(q * d);
+  for (auto &v : index_h) v = dist(gen);
+  for (auto &v : queries_h) v = dist(gen);
+  std::vector<float> dist_h((size_t)q * 1024);
+  std::vector<long> I_h(q * k);
+  std::vector<float> D_h(q * k);
+
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+  float *index, *queries, *dist_d, *D_d;
+  long *I_d;
+  allocate(index, n * d);
+  allocate(queries, q * d);
+  allocate(dist_d, q * 1024);
+  allocate(D_d, q * k);
+  allocate(I_d, q * k);
+  updateDevice(index, index_h.data(), n * d, stream);
+  updateDevice(queries, queries_h.data(), q * d, stream);
+  device_buffer<char> workspace(allocator, stream);
+
+  auto time = [&](const char *name, std::function<void()> f) {
+    f();  // warm up
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    auto start = Clock::now();
+    f();
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    std::chrono::duration<double, std::milli> ms = Clock::now() - start;
+    std::cout << name << ": " << ms.count() << " ms" << std::endl;
+  };
+  time("pairwise distance 4096x1024x64, host", [&]() {
+    Distance::pairwiseDistanceHost(queries_h.data(), index_h.data(),
+                                   dist_h.data(), q, 1024, d,
+                                   Distance::EucExpandedL2);
+  });
+  time("pairwise distance 4096x1024x64, device", [&]() {
+    Distance::pairwiseDistance(queries, index, dist_d, q, 1024, d, workspace,
+                               Distance::EucExpandedL2, stream);
+  });
+  time("top-32 of 4096x1024, host", [&]() {
+    selectKHost(D_h.data(), I_h.data(), dist_h.data(), k, q, 1024L);
+  });
+  time("knn 4096 queries, 65536 points, k=32, host", [&]() {
+    knnHost(index_h.data(), n, d, queries_h.data(), q, I_h.data(),
+            D_h.data(), k);
+  });
+  time("knn 4096 queries, 65536 points, k=32, device", [&]() {
+    int size = n;
+    brute_force_knn(&index, &size, 1, d, queries, q, I_d, D_d, k, stream);
+  });
+
+  CUDA_CHECK(cudaFree(index));
+  CUDA_CHECK(cudaFree(queries));
+  CUDA_CHECK(cudaFree(dist_d));
+  CUDA_CHECK(cudaFree(D_d));
+  CUDA_CHECK(cudaFree(I_d));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+}  // end namespace Selection
+}  // end namespace MLCommon
@@ -229,5 +229,26 @@ TEST_P(PermTestD, Result) {
 }
 INSTANTIATE_TEST_CASE_P(PermTests, PermTestD, ::testing::ValuesIn(inputsd));
 
+TEST(PermSeedTest, Reproducible) {
+  // A seeded permutation only depends on the seed and the subsequence
+  int N = 1000;
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  int *a, *b, *c;
+  allocate(a, N);
+  allocate(b, N);
+  allocate(c, N);
+  permute<float>(a, nullptr, nullptr, 1, N, false, 42ULL, 7ULL, stream);
+  permute<float>(b, nullptr, nullptr, 1, N, false, 42ULL, 7ULL, stream);
+  permute<float>(c, nullptr, nullptr, 1, N, false, 42ULL, 8ULL, stream);
+  ASSERT_TRUE(devArrMatchRange(a, N, 0, Compare<int>(), true, stream));
+  ASSERT_TRUE(devArrMatch(a, b, N, Compare<int>()));
+  ASSERT_FALSE(devArrMatch(a, c, N, Compare<int>()));
+  CUDA_CHECK(cudaFree(a));
+  CUDA_CHECK(cudaFree(b));
+  CUDA_CHECK(cudaFree(c));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
 }  // end namespace Random
 }  // end namespace MLCommon
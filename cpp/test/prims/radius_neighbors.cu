@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "selection/radius_neighbors.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Selection {
+
+struct RadiusNeighborsInputs {
+  int n_index;
+  int n_parts;
+  int n_queries;
+  int dim;
+  float eps;
+  int batch_size_query;
+  int batch_size_index;
+};
+
+::std::ostream &operator<<(::std::ostream &os,
+                           const RadiusNeighborsInputs &dims) {
+  return os;
+}
+
+class RadiusNeighborsTest
+  : public ::testing::TestWithParam<RadiusNeighborsInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<RadiusNeighborsInputs>::GetParam();
+    int m = params.n_index, n = params.n_queries, d = params.dim;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+
+    // points on a coarse grid, so that many distances are tied with eps
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> coord(0, 6);
+    std::vector<float> index_h(m * d), queries_h(n * d);
+    for (auto &v : index_h) v = 0.5f * coord(gen);
+    for (auto &v : queries_h) v = 0.5f * coord(gen);
+    allocate(index, m * d);
+    allocate(queries, n * d);
+    updateDevice(index, index_h.data(), m * d, stream);
+    updateDevice(queries, queries_h.data(), n * d, stream);
+
+    // reference CSR on host
+    float eps2 = params.eps * params.eps;
+    indptr_ref.assign(1, 0);
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < m; j++) {
+        float dist = 0.f;
+        for (int c = 0; c < d; c++) {
+          float diff = queries_h[i * d + c] - index_h[j * d + c];
+          dist += diff * diff;
+        }
+        if (dist <= eps2) {
+          indices_ref.push_back(j);
+          distances_ref.push_back(dist);
+        }
+      }
+      indptr_ref.push_back(indices_ref.size());
+    }
+
+    // split the index into n_parts partitions of (almost) equal sizes
+    std::vector<float *> ptrs;
+    std::vector<int> sizes;
+    for (int p = 0, start = 0; p < params.n_parts; p++) {
+      int end = (long)m * (p + 1) / params.n_parts;
+      ptrs.push_back(index + (size_t)start * d);
+      sizes.push_back(end - start);
+      start = end;
+    }
+
+    allocate(indptr, n + 1);
+    nnz = radius_neighbors<float, long>(
+      ptrs.data(), sizes.data(), params.n_parts, d, queries, n, params.eps,
+      indptr, (long *)nullptr, (float *)nullptr, allocator, stream,
+      params.batch_size_query, params.batch_size_index);
+    allocate(indices, std::max<long>(nnz, 1));
+    allocate(distances, std::max<long>(nnz, 1));
+    radius_neighbors<float, long>(
+      ptrs.data(), sizes.data(), params.n_parts, d, queries, n, params.eps,
+      indptr, indices, distances, allocator, stream, params.batch_size_query,
+      params.batch_size_index);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(index));
+    CUDA_CHECK(cudaFree(queries));
+    CUDA_CHECK(cudaFree(indptr));
+    CUDA_CHECK(cudaFree(indices));
+    CUDA_CHECK(cudaFree(distances));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  RadiusNeighborsInputs params;
+  float *index, *queries, *distances;
+  long *indptr, *indices, nnz;
+  std::vector<long> indptr_ref, indices_ref;
+  std::vector<float> distances_ref;
+  cudaStream_t stream;
+};
+
+const std::vector<RadiusNeighborsInputs> inputs = {
+  {500, 1, 300, 3, 1.0f, 2048, 16384}, {500, 3, 300, 3, 1.0f, 64, 100},
+  {1000, 2, 77, 5, 1.5f, 13, 37},      {200, 2, 50, 2, 0.f, 16, 16},
+  {300, 4, 120, 8, 2.5f, 50, 1 << 10}};
+
+TEST_P(RadiusNeighborsTest, Result) {
+  ASSERT_EQ(nnz, (long)indices_ref.size());
+  ASSERT_TRUE(devArrMatchHost(indptr_ref.data(), indptr,
+                              params.n_queries + 1, Compare<long>(), stream));
+  ASSERT_TRUE(
+    devArrMatchHost(indices_ref.data(), indices, nnz, Compare<long>(),
+                    stream));
+  ASSERT_TRUE(devArrMatchHost(distances_ref.data(), distances, nnz,
+                              CompareApprox<float>(1e-4), stream));
+}
+
+INSTANTIATE_TEST_CASE_P(RadiusNeighborsTests, RadiusNeighborsTest,
+                        ::testing::ValuesIn(inputs));
+
+}  // end namespace Selection
+}  // end namespace MLCommon
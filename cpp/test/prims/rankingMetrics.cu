@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "score/rankingMetrics.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Score {
+
+struct RankingInputs {
+  int n, k, ld;
+  // number of distinct scores, 0 for continuous scores
+  int levels;
+  unsigned long long seed;
+};
+
+/** ROC-AUC as the probability that a positive outscores a negative, with
+ *  ties counting for one half */
+double refRocAuc(const std::vector<int> &y, const float *s, int n) {
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return s[a] < s[b]; });
+  double pairs = 0, neg_below = 0;
+  long pos = 0, neg = 0;
+  for (int i = 0; i < n;) {
+    int end = i;
+    long p = 0, q = 0;
+    while (end < n && s[order[end]] == s[order[i]]) {
+      (y[order[end]] != 0 ? p : q)++;
+      ++end;
+    }
+    pairs += p * (neg_below + 0.5 * q);
+    neg_below += q;
+    pos += p;
+    neg += q;
+    i = end;
+  }
+  return pairs / (double(pos) * neg);
+}
+
+/** average precision over the distinct thresholds, as sklearn */
+double refAveragePrecision(const std::vector<int> &y, const float *s, int n) {
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return s[a] > s[b]; });
+  double tp = 0, fp = 0, sum = 0, total = 0;
+  for (int i = 0; i < n; ++i) total += y[i] != 0;
+  for (int i = 0; i < n;) {
+    double p = 0;
+    int end = i;
+    while (end < n && s[order[end]] == s[order[i]]) {
+      (y[order[end]] != 0 ? p : fp) += 1;
+      ++end;
+    }
+    tp += p;
+    sum += p / total * tp / (tp + fp);
+    i = end;
+  }
+  return sum;
+}
+
+class RankingTest : public ::testing::TestWithParam<RankingInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<RankingInputs>::GetParam();
+    int n = params.n, k = params.k, ld = params.ld;
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<float> unif(0, 1);
+    y.resize(n);
+    scores.assign(size_t(ld) * k, -1.0f);
+    for (int i = 0; i < n; ++i) y[i] = unif(gen) < 0.3f;
+    y[0] = 1;
+    y[n - 1] = 0;
+    for (int j = 0; j < k; ++j) {
+      // score vectors of decreasing quality
+      for (int i = 0; i < n; ++i) {
+        float s = (y[i] + 0.5f * (j + 1)) * unif(gen) / (1 + 0.5f * (j + 1));
+        if (params.levels > 0)
+          s = int(s * params.levels) / float(params.levels);
+        scores[size_t(j) * ld + i] = s;
+      }
+    }
+
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    allocator.reset(new defaultDeviceAllocator);
+    allocate(d_y, n);
+    allocate(d_scores, scores.size());
+    updateDevice(d_y, y.data(), n, stream);
+    updateDevice(d_scores, scores.data(), scores.size(), stream);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(d_y));
+    CUDA_CHECK(cudaFree(d_scores));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  RankingInputs params;
+  std::vector<int> y;
+  std::vector<float> scores;
+  int *d_y = nullptr;
+  float *d_scores = nullptr;
+  std::shared_ptr<deviceAllocator> allocator;
+  cudaStream_t stream;
+};
+
+TEST_P(RankingTest, Exact) {
+  int n = params.n, k = params.k, ld = params.ld;
+  std::vector<double> roc_auc(k), ap(k);
+  rankingScores(roc_auc.data(), ap.data(), d_y, d_scores, n, k, ld, allocator,
+                stream);
+  for (int j = 0; j < k; ++j) {
+    const float *s = scores.data() + size_t(j) * ld;
+    ASSERT_NEAR(refRocAuc(y, s, n), roc_auc[j], 1e-9);
+    ASSERT_NEAR(refAveragePrecision(y, s, n), ap[j], 1e-9);
+  }
+}
+
+TEST_P(RankingTest, Histogram) {
+  // the histogram is exact when the distinct scores fall in distinct bins,
+  // and close otherwise; it is accumulated over two chunks
+  int n = params.n, k = params.k, ld = params.ld;
+  int n_bins = params.levels > 0 ? 2 * params.levels : 4096;
+  std::vector<ScoreHistogram> hists(k, ScoreHistogram(0.0, 1.0, n_bins));
+  int half = n / 2;
+  scoreHistogram(hists.data(), d_y, d_scores, half, k, ld, allocator, stream);
+  scoreHistogram(hists.data(), d_y + half, d_scores + half, n - half, k, ld,
+                 allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    const float *s = scores.data() + size_t(j) * ld;
+    double tol = params.levels > 0 ? 1e-9 : 1e-3;
+    ASSERT_NEAR(refRocAuc(y, s, n), hists[j].roc_auc(), tol);
+    ASSERT_NEAR(refAveragePrecision(y, s, n), hists[j].average_precision(),
+                tol);
+  }
+}
+
+TEST_P(RankingTest, Calibration) {
+  int n = params.n, k = params.k, ld = params.ld;
+  const int n_bins = 10;
+  std::vector<double> prob_true(n_bins * k), prob_pred(n_bins * k);
+  std::vector<unsigned long long> counts(n_bins * k);
+  calibrationCurve(prob_true.data(), prob_pred.data(), counts.data(), d_y,
+                   d_scores, n, k, ld, n_bins, allocator, stream);
+  for (int j = 0; j < k; ++j) {
+    std::vector<unsigned long long> count(n_bins);
+    std::vector<double> pos(n_bins), sum(n_bins);
+    for (int i = 0; i < n; ++i) {
+      float s = scores[size_t(j) * ld + i];
+      int b = std::min(int(s * n_bins), n_bins - 1);
+      count[b] += 1;
+      pos[b] += y[i];
+      sum[b] += s;
+    }
+    for (int b = 0; b < n_bins; ++b) {
+      int idx = j * n_bins + b;
+      ASSERT_EQ(count[b], counts[idx]);
+      if (count[b] == 0) continue;
+      ASSERT_NEAR(pos[b] / double(count[b]), prob_true[idx], 1e-12);
+      ASSERT_NEAR(sum[b] / double(count[b]), prob_pred[idx], 1e-9);
+    }
+  }
+}
+
+const std::vector<RankingInputs> inputs = {
+  {2, 1, 2, 0, 1234ULL},       {100, 3, 100, 0, 1234ULL},
+  {1000, 4, 1003, 0, 1234ULL}, {100000, 2, 100000, 0, 1234ULL},
+  {5000, 3, 5000, 20, 1234ULL}, {20000, 2, 20011, 7, 1234ULL}};
+
+INSTANTIATE_TEST_CASE_P(RankingMetricsTests, RankingTest,
+                        ::testing::ValuesIn(inputs));
+
+TEST(RankingMetricsTests, OneClass) {
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+  const int n = 10;
+  int *d_y;
+  float *d_scores;
+  allocate(d_y, n, true);
+  allocate(d_scores, n, true);
+  double roc_auc;
+  ASSERT_THROW(rankingScores(&roc_auc, (double *)nullptr, d_y, d_scores, n, 1,
+                             n, allocator, stream),
+               MLCommon::Exception);
+  CUDA_CHECK(cudaFree(d_y));
+  CUDA_CHECK(cudaFree(d_scores));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+}  // namespace Score
+}  // namespace MLCommon
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "sparse/distance.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Sparse {
+
+struct SparseDistanceInputs {
+  int m;
+  int n;
+  int dim;
+  float density;
+  SparseDistanceType metric;
+  int k;
+};
+
+::std::ostream &operator<<(::std::ostream &os,
+                           const SparseDistanceInputs &dims) {
+  return os;
+}
+
+/** reference distance between two dense rows */
+float refDistance(const float *a, const float *b, int dim,
+                  SparseDistanceType metric) {
+  double dot = 0, na = 0, nb = 0, l1 = 0, l2 = 0;
+  int inter = 0, uni = 0;
+  for (int c = 0; c < dim; c++) {
+    dot += a[c] * b[c];
+    na += a[c] * a[c];
+    nb += b[c] * b[c];
+    l1 += std::abs(a[c] - b[c]);
+    l2 += (a[c] - b[c]) * (a[c] - b[c]);
+    inter += a[c] != 0.f && b[c] != 0.f;
+    uni += a[c] != 0.f || b[c] != 0.f;
+  }
+  switch (metric) {
+    case SparseInnerProduct:
+      return dot;
+    case SparseL2Expanded:
+      return l2;
+    case SparseL2SqrtExpanded:
+      return std::sqrt(l2);
+    case SparseCosine:
+      return na > 0 && nb > 0 ? 1 - dot / std::sqrt(na * nb) : 1;
+    case SparseL1:
+      return l1;
+    default:
+      return uni > 0 ? 1 - double(inter) / uni : 0;
+  }
+}
+
+class SparseDistanceTest
+  : public ::testing::TestWithParam<SparseDistanceInputs> {
+ protected:
+  void toCsr(const std::vector<float> &dense, int rows, int **indptr,
+             int **indices, float **data) {
+    std::vector<int> h_indptr(1, 0), h_indices;
+    std::vector<float> h_data;
+    for (int i = 0; i < rows; i++) {
+      for (int c = 0; c < params.dim; c++) {
+        if (dense[i * params.dim + c] != 0.f) {
+          h_indices.push_back(c);
+          h_data.push_back(dense[i * params.dim + c]);
+        }
+      }
+      h_indptr.push_back(h_indices.size());
+    }
+    int nnz = std::max<int>(h_indices.size(), 1);
+    allocate(*indptr, rows + 1);
+    allocate(*indices, nnz);
+    allocate(*data, nnz);
+    updateDevice(*indptr, h_indptr.data(), rows + 1, stream);
+    updateDevice(*indices, h_indices.data(), h_indices.size(), stream);
+    updateDevice(*data, h_data.data(), h_data.size(), stream);
+  }
+
+  void SetUp() override {
+    params = ::testing::TestWithParam<SparseDistanceInputs>::GetParam();
+    int m = params.m, n = params.n, d = params.dim, k = params.k;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+
+    // values on a coarse grid keep the distances exact in fp32
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> keep(0.f, 1.f);
+    std::uniform_int_distribution<int> value(-4, 4);
+    std::vector<float> a_h(m * d), b_h(n * d);
+    for (auto &v : a_h) v = keep(gen) < params.density ? 0.5f * value(gen) : 0;
+    for (auto &v : b_h) v = keep(gen) < params.density ? 0.5f * value(gen) : 0;
+
+    dist_ref.resize(m * n);
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < n; j++)
+        dist_ref[i * n + j] =
+          refDistance(&a_h[i * d], &b_h[j * d], d, params.metric);
+    }
+    // the k nearest (largest for the inner product), ties by index
+    knn_ref_D.resize(m * k);
+    for (int i = 0; i < m; i++) {
+      std::vector<int> order(n);
+      std::iota(order.begin(), order.end(), 0);
+      const float *row = &dist_ref[i * n];
+      bool larger = params.metric == SparseInnerProduct;
+      std::stable_sort(order.begin(), order.end(), [&](int x, int y) {
+        return larger ? row[x] > row[y] : row[x] < row[y];
+      });
+      for (int r = 0; r < k; r++) knn_ref_D[i * k + r] = row[order[r]];
+    }
+
+    toCsr(a_h, m, &a_indptr, &a_indices, &a_data);
+    toCsr(b_h, n, &b_indptr, &b_indices, &b_data);
+    allocate(b_dense, n * d);
+    updateDevice(b_dense, b_h.data(), n * d, stream);
+    allocate(dist_csr, m * n);
+    allocate(dist_dense, m * n);
+    allocate(knn_I, m * k);
+    allocate(knn_D, m * k);
+    allocate(knn_dense_I, m * k);
+    allocate(knn_dense_D, m * k);
+
+    pairwiseDistanceCsr(dist_csr, a_indptr, a_indices, a_data, m, b_indptr,
+                        b_indices, b_data, n, params.metric, allocator,
+                        stream);
+    pairwiseDistanceCsrDense(dist_dense, a_indptr, a_indices, a_data, m,
+                             b_dense, n, d, params.metric, allocator, stream);
+    knnCsr(knn_I, knn_D, k, a_indptr, a_indices, a_data, m, b_indptr,
+           b_indices, b_data, n, params.metric, allocator, stream);
+    knnCsrDense(knn_dense_I, knn_dense_D, k, a_indptr, a_indices, a_data, m,
+                b_dense, n, d, params.metric, allocator, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(a_indptr));
+    CUDA_CHECK(cudaFree(a_indices));
+    CUDA_CHECK(cudaFree(a_data));
+    CUDA_CHECK(cudaFree(b_indptr));
+    CUDA_CHECK(cudaFree(b_indices));
+    CUDA_CHECK(cudaFree(b_data));
+    CUDA_CHECK(cudaFree(b_dense));
+    CUDA_CHECK(cudaFree(dist_csr));
+    CUDA_CHECK(cudaFree(dist_dense));
+    CUDA_CHECK(cudaFree(knn_I));
+    CUDA_CHECK(cudaFree(knn_D));
+    CUDA_CHECK(cudaFree(knn_dense_I));
+    CUDA_CHECK(cudaFree(knn_dense_D));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  SparseDistanceInputs params;
+  int *a_indptr, *a_indices, *b_indptr, *b_indices;
+  float *a_data, *b_data, *b_dense, *dist_csr, *dist_dense;
+  float *knn_D, *knn_dense_D;
+  long *knn_I, *knn_dense_I;
+  std::vector<float> dist_ref, knn_ref_D;
+  cudaStream_t stream;
+};
+
+const std::vector<SparseDistanceInputs> inputs = {
+  {50, 70, 40, 0.2f, SparseInnerProduct, 5},
+  {50, 70, 40, 0.2f, SparseL2Expanded, 5},
+  {50, 70, 40, 0.2f, SparseL2SqrtExpanded, 5},
+  {50, 70, 40, 0.2f, SparseCosine, 5},
+  {50, 70, 40, 0.2f, SparseL1, 5},
+  {50, 70, 40, 0.2f, SparseJaccard, 5},
+  // rows of a larger than the shared memory stage, several b tiles
+  {20, 5000, 3000, 0.5f, SparseL2Expanded, 17},
+  {20, 5000, 3000, 0.5f, SparseL1, 17},
+  {64, 300, 20, 0.05f, SparseCosine, 300}};
+
+TEST_P(SparseDistanceTest, Result) {
+  int len = params.m * params.n, klen = params.m * params.k;
+  ASSERT_TRUE(devArrMatchHost(dist_ref.data(), dist_csr, len,
+                              CompareApprox<float>(1e-4), stream));
+  ASSERT_TRUE(devArrMatchHost(dist_ref.data(), dist_dense, len,
+                              CompareApprox<float>(1e-4), stream));
+  // the neighbor distances identify the neighbors up to ties
+  ASSERT_TRUE(devArrMatchHost(knn_ref_D.data(), knn_D, klen,
+                              CompareApprox<float>(1e-4), stream));
+  ASSERT_TRUE(devArrMatchHost(knn_ref_D.data(), knn_dense_D, klen,
+                              CompareApprox<float>(1e-4), stream));
+}
+
+INSTANTIATE_TEST_CASE_P(SparseDistanceTests, SparseDistanceTest,
+                        ::testing::ValuesIn(inputs));
+
+}  // end namespace Sparse
+}  // end namespace MLCommon
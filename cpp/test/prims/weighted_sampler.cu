@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+#include "common/cuml_allocator.hpp"
+#include "random/weighted_sampler.h"
+#include "test_utils.h"
+
+namespace MLCommon {
+namespace Random {
+
+struct WeightedSamplerInputs {
+  int n_rows;
+  int n_items;
+  int n_samples;
+  int n_samples_wor;
+  float zero_frac;
+  unsigned long long int seed;
+};
+
+::std::ostream &operator<<(::std::ostream &os,
+                           const WeightedSamplerInputs &dims) {
+  return os;
+}
+
+class WeightedSamplerTest
+  : public ::testing::TestWithParam<WeightedSamplerInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<WeightedSamplerInputs>::GetParam();
+    int r = params.n_rows, m = params.n_items;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    std::shared_ptr<deviceAllocator> allocator(new defaultDeviceAllocator);
+
+    // random weights with some zeros, the last row is all zeros
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<float> dist(0.f, 1.f);
+    wts_h.resize(r * m);
+    for (auto &w : wts_h) w = dist(gen) < params.zero_frac ? 0.f : dist(gen);
+    for (int j = 0; j < m; j++) wts_h[(r - 1) * m + j] = 0.f;
+    allocate(wts, r * m);
+    updateDevice(wts, wts_h.data(), r * m, stream);
+
+    allocate(out, r * params.n_samples);
+    allocate(out_wor, r * params.n_samples_wor);
+    WeightedSampler<float> sampler(allocator, stream, params.seed);
+    sampler.build(wts, r, m, stream);
+    sampler.sample(out, params.n_samples, stream);
+    sampler.sampleWithoutReplacement(out_wor, params.n_samples_wor, stream);
+    out_h.resize(r * params.n_samples);
+    out_wor_h.resize(r * params.n_samples_wor);
+    updateHost(out_h.data(), out, r * params.n_samples, stream);
+    updateHost(out_wor_h.data(), out_wor, r * params.n_samples_wor, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(wts));
+    CUDA_CHECK(cudaFree(out));
+    CUDA_CHECK(cudaFree(out_wor));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  WeightedSamplerInputs params;
+  float *wts;
+  int *out, *out_wor;
+  std::vector<float> wts_h;
+  std::vector<int> out_h, out_wor_h;
+  cudaStream_t stream;
+};
+
+const std::vector<WeightedSamplerInputs> inputs = {
+  {4, 10, 200000, 5, 0.3f, 1234ULL},
+  {3, 1000, 500000, 100, 0.5f, 4321ULL},
+  {65, 37, 20000, 37, 0.f, 42ULL}};
+
+TEST_P(WeightedSamplerTest, WithReplacement) {
+  int m = params.n_items, s = params.n_samples;
+  for (int i = 0; i < params.n_rows - 1; i++) {
+    const float *w = &wts_h[i * m];
+    double total = 0;
+    for (int j = 0; j < m; j++) total += w[j];
+    std::vector<int> counts(m, 0);
+    for (int k = 0; k < s; k++) {
+      int idx = out_h[i * s + k];
+      ASSERT_TRUE(idx >= 0 && idx < m);
+      ASSERT_GT(w[idx], 0.f);
+      counts[idx]++;
+    }
+    // empirical frequencies within 5 standard deviations of the weights
+    for (int j = 0; j < m; j++) {
+      double p = w[j] / total;
+      double sd = std::sqrt(p * (1 - p) / s);
+      ASSERT_LE(std::abs(double(counts[j]) / s - p), 5 * sd + 1e-6);
+    }
+  }
+  // distributions without mass only yield -1
+  for (int k = 0; k < s; k++)
+    ASSERT_EQ(-1, out_h[(params.n_rows - 1) * s + k]);
+}
+
+TEST_P(WeightedSamplerTest, WithoutReplacement) {
+  int m = params.n_items, s = params.n_samples_wor;
+  for (int i = 0; i < params.n_rows; i++) {
+    const float *w = &wts_h[i * m];
+    int nonzero = 0;
+    for (int j = 0; j < m; j++) nonzero += w[j] > 0.f;
+    std::set<int> seen;
+    for (int k = 0; k < s; k++) {
+      int idx = out_wor_h[i * s + k];
+      ASSERT_TRUE(idx >= 0 && idx < m);
+      ASSERT_TRUE(seen.insert(idx).second);
+      // items of zero weight come last
+      if (k < nonzero)
+        ASSERT_GT(w[idx], 0.f);
+      else
+        ASSERT_EQ(w[idx], 0.f);
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(WeightedSamplerTests, WeightedSamplerTest,
+                        ::testing::ValuesIn(inputs));
+
+}  // end namespace Random
+}  // end namespace MLCommon
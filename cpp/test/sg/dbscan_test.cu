@@ -17,11 +17,18 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <linalg/cublas_wrappers.h>
+#include <algorithm>
+#include <climits>
+#include <random>
 #include <vector>
+#include "datasets/make_blobs.hpp"
 #include "dbscan/dbscan.hpp"
+#include "dbscan/dbscan_mg.h"
 #include "ml_utils.h"
 #include "random/rng.h"
+#include "single_rank_comms.h"
 #include "test_utils.h"
+#include "thread_comms.h"
 
 namespace ML {
 
@@ -119,4 +126,213 @@ INSTANTIATE_TEST_CASE_P(DbscanTests, DbscanTestF,
 INSTANTIATE_TEST_CASE_P(DbscanTests, DbscanTestD,
                         ::testing::ValuesIn(inputsd2));
 
+/**
+ * The multi-rank fit on a single rank communicator against the single device
+ * fit, both with several batches.
+ */
+template <typename T>
+class DbscanMGTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    init_single_rank_comms(handle);
+  }
+
+  void TearDown() override { CUDA_CHECK(cudaStreamDestroy(stream)); }
+
+  /** Labels of the single device and of the multi-rank fits */
+  void fit(const std::vector<T>& data_h, int n_row, int n_col, T eps,
+           int min_pts, std::vector<int>& labels_h,
+           std::vector<int>& labels_mg_h) {
+    T* data;
+    int *labels, *labels_mg;
+    allocate(data, n_row * n_col);
+    allocate(labels, n_row);
+    allocate(labels_mg, n_row);
+    updateDevice(data, data_h.data(), n_row * n_col, stream);
+    // forces about four batches
+    size_t max_bytes_per_batch = n_row * n_row * sizeof(T) / 4;
+    dbscanFit(handle, data, n_row, n_col, eps, min_pts, labels,
+              max_bytes_per_batch);
+    dbscanFitMG(handle, data, n_row, n_col, eps, min_pts, labels_mg,
+                max_bytes_per_batch);
+    labels_h.resize(n_row);
+    labels_mg_h.resize(n_row);
+    updateHost(labels_h.data(), labels, n_row, stream);
+    updateHost(labels_mg_h.data(), labels_mg, n_row, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(labels_mg));
+  }
+
+  cumlHandle handle;
+  cudaStream_t stream;
+};
+
+typedef DbscanMGTest<float> DbscanMGTestF;
+
+TEST_F(DbscanMGTestF, Blobs) {
+  int n_row = 1000, n_col = 2;
+  float* data;
+  int* blob_labels;
+  allocate(data, n_row * n_col);
+  allocate(blob_labels, n_row);
+  Datasets::make_blobs(handle, data, blob_labels, n_row, n_col, 5, nullptr,
+                       nullptr, 1.f, true, -10.f, 10.f, 1234ULL);
+  std::vector<float> data_h(n_row * n_col);
+  updateHost(data_h.data(), data, n_row * n_col, stream);
+  CUDA_CHECK(cudaStreamSynchronize(stream));
+  CUDA_CHECK(cudaFree(data));
+  CUDA_CHECK(cudaFree(blob_labels));
+
+  std::vector<int> labels_h, labels_mg_h;
+  fit(data_h, n_row, n_col, 0.5f, 5, labels_h, labels_mg_h);
+  EXPECT_EQ(labels_h, labels_mg_h);
+  EXPECT_GT(*std::max_element(labels_h.begin(), labels_h.end()), 0);
+  EXPECT_GT(std::count(labels_h.begin(), labels_h.end(), -1), 0);
+}
+
+TEST_F(DbscanMGTestF, BorderBridge) {
+  // two squares of core points, a border point within eps of both and a
+  // noise point: the border point must not merge the two clusters
+  std::vector<float> data_h = {0.f, 0.f, 0.f, 1.f, 1.f, 0.f, 1.f, 1.f,
+                               4.f, 0.f, 4.f, 1.f, 5.f, 0.f, 5.f, 1.f,
+                               2.5f, 0.f, 10.f, 10.f};
+  std::vector<int> labels_h, labels_mg_h;
+  fit(data_h, 10, 2, 1.6f, 4, labels_h, labels_mg_h);
+  std::vector<int> expected = {0, 0, 0, 0, 1, 1, 1, 1, 0, -1};
+  EXPECT_EQ(labels_h, expected);
+  EXPECT_EQ(labels_mg_h, expected);
+}
+
+TEST(DbscanMGHostTest, Slabs) {
+  // a point is owned by the slab of the number of cuts <= it, and sent to
+  // the slabs of [v - eps, v + eps]
+  std::vector<float> cuts = {1.f, 2.f, 3.f};
+  EXPECT_EQ(0, Dbscan::MG::slabOf(0.5f, cuts.data(), 3));
+  EXPECT_EQ(1, Dbscan::MG::slabOf(1.f, cuts.data(), 3));
+  EXPECT_EQ(2, Dbscan::MG::slabOf(2.5f, cuts.data(), 3));
+  EXPECT_EQ(3, Dbscan::MG::slabOf(3.f, cuts.data(), 3));
+  EXPECT_EQ(3, Dbscan::MG::slabOf(10.f, cuts.data(), 3));
+  EXPECT_EQ(1, Dbscan::MG::slabOf(1.9f - 0.2f, cuts.data(), 3));
+  EXPECT_EQ(2, Dbscan::MG::slabOf(1.9f + 0.2f, cuts.data(), 3));
+  EXPECT_EQ(0, Dbscan::MG::slabOf(1.9f - 1.f, cuts.data(), 3));
+  EXPECT_EQ(0, Dbscan::MG::slabOf(5.f, cuts.data(), 0));
+}
+
+TEST(DbscanMGHostTest, MergeComponents) {
+  // (component, core gid) of the owned copy, then of the halo copy
+  std::vector<int64_t> edges = {20, 3, 10, 5,  //
+                                20, 3, 30, 7,  //
+                                50, 8, 40, 9,  //
+                                30, 7, 20, 3};
+  std::vector<int64_t> comps, core;
+  Dbscan::MG::mergeComponents(edges, comps, core);
+  EXPECT_EQ(std::vector<int64_t>({10, 20, 30, 40, 50}), comps);
+  EXPECT_EQ(std::vector<int64_t>({3, 3, 3, 8, 8}), core);
+
+  Dbscan::MG::mergeComponents(std::vector<int64_t>(), comps, core);
+  EXPECT_TRUE(comps.empty());
+  EXPECT_TRUE(core.empty());
+}
+
+/**
+ * Rows of three grids of points, every point of which is core except the
+ * corners, a border point between the first and third grids, and two noise
+ * points; shuffled. Returns the row of the border point.
+ */
+int grid_data(std::vector<float>& data) {
+  std::vector<std::pair<float, float>> points;
+  auto grid = [&points](float x0, int nx, float y0) {
+    for (int i = 0; i < nx; i++) {
+      for (int j = 0; j < 4; j++)
+        points.emplace_back(x0 + 0.25f * i, y0 + 0.25f * j);
+    }
+  };
+  grid(0.f, 40, 0.f);
+  grid(0.f, 40, 3.f);
+  grid(10.25f, 32, 0.f);
+  points.emplace_back(10.f, 0.25f);
+  points.emplace_back(5.f, 10.f);
+  points.emplace_back(15.f, -5.f);
+  std::vector<int> order(points.size());
+  for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+  std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+  data.clear();
+  int border = -1;
+  for (int i = 0; i < (int)order.size(); i++) {
+    data.push_back(points[order[i]].first);
+    data.push_back(points[order[i]].second);
+    if (order[i] == 40 * 4 * 2 + 32 * 4) border = i;
+  }
+  return border;
+}
+
+TEST(DbscanMGThreadTest, ThreeRanks) {
+  std::vector<float> data_h;
+  int border = grid_data(data_h);
+  const int n_row = data_h.size() / 2, n_col = 2, min_pts = 4, n_ranks = 3;
+  const float eps = 0.3f;
+
+  std::vector<int> labels_h(n_row);
+  {
+    cumlHandle handle;
+    cudaStream_t stream;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    float* data;
+    int* labels;
+    allocate(data, n_row * n_col);
+    allocate(labels, n_row);
+    updateDevice(data, data_h.data(), n_row * n_col, stream);
+    dbscanFit(handle, data, n_row, n_col, eps, min_pts, labels, 0);
+    updateHost(labels_h.data(), labels, n_row, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  // each rank fits a contiguous slice of the rows; the slabs cut through the
+  // grids, so their clusters are merged across ranks
+  std::vector<int> labels_mg_h(n_row);
+  run_ranks(n_ranks, [&](int rank, const cumlHandle& handle) {
+    cudaStream_t stream = handle.getStream();
+    int first = rank * n_row / n_ranks, last = (rank + 1) * n_row / n_ranks;
+    int n_local = last - first;
+    float* data;
+    int* labels;
+    allocate(data, n_local * n_col);
+    allocate(labels, n_local);
+    updateDevice(data, data_h.data() + first * n_col, n_local * n_col, stream);
+    dbscanFitMG(handle, data, n_local, n_col, eps, min_pts, labels, 0);
+    updateHost(labels_mg_h.data() + first, labels, n_local, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+  });
+
+  ASSERT_EQ(2, std::count(labels_h.begin(), labels_h.end(), -1));
+  ASSERT_EQ(2, *std::max_element(labels_h.begin(), labels_h.end()));
+  for (int i = 0; i < n_row; i++) {
+    if (i == border) continue;
+    ASSERT_EQ(labels_h[i], labels_mg_h[i]) << "row " << i;
+  }
+  // the border point joins either of the clusters it is next to
+  std::vector<int> next_to;
+  for (int i = 0; i < n_row; i++) {
+    float dx = data_h[2 * i] - data_h[2 * border];
+    float dy = data_h[2 * i + 1] - data_h[2 * border + 1];
+    if (i != border && dx * dx + dy * dy <= eps * eps)
+      next_to.push_back(labels_h[i]);
+  }
+  ASSERT_EQ(2u, next_to.size());
+  ASSERT_NE(next_to[0], next_to[1]);
+  ASSERT_TRUE(labels_mg_h[border] == next_to[0] ||
+              labels_mg_h[border] == next_to[1]);
+  ASSERT_EQ(labels_h[border], std::min(next_to[0], next_to[1]));
+}
+
 }  // end namespace ML
@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <test_utils.h>
+#include <treelite/c_api.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "fil/fil.h"
+#include "test_utils.h"
+
+namespace ML {
+
+using namespace MLCommon;
+
+struct FilLoadersParams {
+  fil::model_format_t format;
+  int num_trees;
+  int cols;
+  // maximum depth of the generated trees
+  int max_depth;
+  // probability for an inner node to become a leaf before max_depth
+  float leaf_prob;
+  // binary classification (sigmoid + threshold) or regression
+  bool classification;
+  // average the outputs of the trees (LightGBM random forests)
+  bool average;
+  int seed;
+};
+
+std::ostream& operator<<(std::ostream& os, const FilLoadersParams& ps) {
+  os << "format = " << ps.format << ", num_trees = " << ps.num_trees
+     << ", cols = " << ps.cols << ", max_depth = " << ps.max_depth
+     << ", leaf_prob = " << ps.leaf_prob
+     << ", classification = " << ps.classification
+     << ", average = " << ps.average << ", seed = " << ps.seed;
+  return os;
+}
+
+/** a tree in the form stored by XGBoost, with the root at index 0 */
+struct gen_tree {
+  // children, -1 for leaves
+  std::vector<int> left, right;
+  std::vector<int> fid;
+  std::vector<bool> def_left;
+  // split condition or leaf value
+  std::vector<float> val;
+  int depth = 0;
+};
+
+/** a file removed when the test ends */
+struct temp_file {
+  std::string name;
+  temp_file() {
+    char tmpl[] = "/tmp/fil_loaders_XXXXXX";
+    int fd = mkstemp(tmpl);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    name = tmpl;
+  }
+  ~temp_file() { remove(name.c_str()); }
+};
+
+class FilLoadersTest : public testing::TestWithParam<FilLoadersParams> {
+ protected:
+  void SetUp() override {
+    ps = testing::TestWithParam<FilLoadersParams>::GetParam();
+    gen.seed(ps.seed);
+    for (int t = 0; t < ps.num_trees; ++t) {
+      trees.push_back(gen_tree());
+      grow(&trees.back(), 0);
+    }
+    base_score = ps.classification ? 0.3f : 0.5f;
+    tl_params.algo = fil::algo_t::NAIVE;
+    tl_params.output_class = ps.classification;
+    tl_params.threshold = 0.5f;
+    write_model(ps.format, file.name);
+  }
+
+  int grow(gen_tree* tree, int depth) {
+    std::uniform_real_distribution<float> val(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> fid(0, ps.cols - 1);
+    std::bernoulli_distribution leaf(ps.leaf_prob), def_left(0.5);
+    int i = tree->left.size();
+    tree->left.push_back(-1);
+    tree->right.push_back(-1);
+    tree->fid.push_back(0);
+    tree->def_left.push_back(false);
+    tree->val.push_back(val(gen));
+    tree->depth = std::max(tree->depth, depth);
+    if (depth == ps.max_depth || (depth > 0 && leaf(gen))) return i;
+    tree->fid[i] = fid(gen);
+    tree->def_left[i] = def_left(gen);
+    int l = grow(tree, depth + 1);
+    int r = grow(tree, depth + 1);
+    tree->left[i] = l;
+    tree->right[i] = r;
+    return i;
+  }
+
+  template <typename T>
+  static void put(std::string* s, T value) {
+    s->append((const char*)&value, sizeof(value));
+  }
+
+  static void put_zeros(std::string* s, int n_ints) {
+    s->append(n_ints * sizeof(int), '\0');
+  }
+
+  void write_model(fil::model_format_t format, const std::string& name) {
+    std::string data;
+    switch (format) {
+      case fil::XGBOOST_BINARY:
+        data = xgboost_binary();
+        break;
+      case fil::XGBOOST_JSON:
+        data = xgboost_json();
+        break;
+      case fil::LIGHTGBM_TEXT:
+        data = lightgbm_text();
+        break;
+    }
+    std::ofstream out(name, std::ios::out | std::ios::binary);
+    out.write(data.data(), data.size());
+    ASSERT_TRUE(out.good());
+  }
+
+  std::string xgboost_objective() {
+    return ps.classification ? "binary:logistic" : "reg:squarederror";
+  }
+
+  std::string xgboost_binary() {
+    std::string s;
+    // learner parameters
+    put(&s, base_score);
+    put(&s, unsigned(ps.cols));
+    put_zeros(&s, 32);
+    for (std::string str : {xgboost_objective(), std::string("gbtree")}) {
+      put(&s, uint64_t(str.size()));
+      s += str;
+    }
+    // gbtree parameters
+    put(&s, ps.num_trees);
+    put(&s, 1);
+    put(&s, ps.cols);
+    put_zeros(&s, 1 + 2);
+    put(&s, 1);
+    put_zeros(&s, 1 + 32);
+    for (const gen_tree& tree : trees) {
+      int n = tree.left.size();
+      put(&s, 1);
+      put(&s, n);
+      put(&s, 0);
+      put(&s, tree.depth);
+      put(&s, ps.cols);
+      put_zeros(&s, 1 + 31);
+      std::vector<int> parent(n, -1);
+      for (int i = 0; i < n; ++i) {
+        if (tree.left[i] < 0) continue;
+        parent[tree.left[i]] = i | (1U << 31);
+        parent[tree.right[i]] = i;
+      }
+      for (int i = 0; i < n; ++i) {
+        put(&s, parent[i]);
+        put(&s, tree.left[i]);
+        put(&s, tree.right[i]);
+        put(&s, unsigned(tree.fid[i]) | (tree.def_left[i] ? 1U << 31 : 0U));
+        put(&s, tree.val[i]);
+      }
+      // node statistics
+      put_zeros(&s, n * 4);
+    }
+    // tree_info
+    put_zeros(&s, ps.num_trees);
+    return s;
+  }
+
+  template <typename T, typename F>
+  static std::string join(const std::vector<T>& v, const char* sep, F f) {
+    std::ostringstream os;
+    for (size_t i = 0; i < v.size(); ++i) {
+      if (i > 0) os << sep;
+      os << f(v[i]);
+    }
+    return os.str();
+  }
+
+  static std::string float_text(double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    return buf;
+  }
+
+  std::string xgboost_json() {
+    auto num = [](float v) { return float_text(v); };
+    auto same = [](int v) { return v; };
+    std::ostringstream os;
+    os << R"({"learner":{"attributes":{},"gradient_booster":{"model":)"
+       << R"({"gbtree_model_param":{"num_trees":")" << ps.num_trees
+       << R"(","size_leaf_vector":"0"},"tree_info":[)"
+       << join(std::vector<int>(ps.num_trees, 0), ",", same)
+       << R"(],"trees":[)";
+    for (int t = 0; t < ps.num_trees; ++t) {
+      const gen_tree& tree = trees[t];
+      int n = tree.left.size();
+      std::vector<int> def_left(tree.def_left.begin(), tree.def_left.end());
+      os << (t > 0 ? "," : "") << R"({"base_weights":[)"
+         << join(tree.val, ",", num) << R"(],"categories":[],)"
+         << R"("default_left":[)" << join(def_left, ",", same)
+         << R"(],"id":)" << t << R"(,"left_children":[)"
+         << join(tree.left, ",", same) << R"(],"right_children":[)"
+         << join(tree.right, ",", same) << R"(],"split_conditions":[)"
+         << join(tree.val, ",", num) << R"(],"split_indices":[)"
+         << join(tree.fid, ",", same) << R"(],"split_type":[)"
+         << join(std::vector<int>(n, 0), ",", same)
+         << R"(],"tree_param":{"num_deleted":"0","num_feature":")"
+         << ps.cols << R"(","num_nodes":")" << n
+         << R"(","size_leaf_vector":"0"}})";
+    }
+    os << R"(]},"name":"gbtree"},"learner_model_param":{"base_score":")"
+       << float_text(base_score) << R"(","num_class":"0","num_feature":")"
+       << ps.cols << R"("},"objective":{"name":")" << xgboost_objective()
+       << R"(","reg_loss_param":{"scale_pos_weight":"1"}}},)"
+       << R"("version":[1,0,0]})";
+    return os.str();
+  }
+
+  std::string lightgbm_text() {
+    auto num = [](float v) { return float_text(v); };
+    auto same = [](int v) { return v; };
+    std::ostringstream os;
+    os << "tree\nversion=v2\nnum_class=1\nnum_tree_per_iteration=1\n"
+       << "label_index=0\nmax_feature_idx=" << ps.cols - 1 << "\n"
+       << "objective="
+       << (ps.classification ? "binary sigmoid:1" : "regression") << "\n";
+    if (ps.average) os << "average_output\n";
+    os << "\n";
+    for (int t = 0; t < ps.num_trees; ++t) {
+      // inner nodes and leaves are numbered separately, and a leaf l is
+      // referred to as ~l
+      const gen_tree& tree = trees[t];
+      int n = tree.left.size();
+      std::vector<int> index(n);
+      std::vector<int> inner, leaves;
+      for (int i = 0; i < n; ++i) {
+        if (tree.left[i] < 0) {
+          index[i] = ~int(leaves.size());
+          leaves.push_back(i);
+        } else {
+          index[i] = inner.size();
+          inner.push_back(i);
+        }
+      }
+      std::vector<int> fid, decision_type, left, right;
+      std::vector<float> threshold, leaf_value;
+      for (int i : inner) {
+        fid.push_back(tree.fid[i]);
+        // missing values are NaNs, bit 1 is default_left
+        decision_type.push_back(8 | (tree.def_left[i] ? 2 : 0));
+        threshold.push_back(tree.val[i]);
+        left.push_back(index[tree.left[i]]);
+        right.push_back(index[tree.right[i]]);
+      }
+      for (int i : leaves) leaf_value.push_back(tree.val[i]);
+      os << "Tree=" << t << "\nnum_leaves=" << leaves.size()
+         << "\nnum_cat=0\nsplit_feature=" << join(fid, " ", same)
+         << "\nthreshold=" << join(threshold, " ", num)
+         << "\ndecision_type=" << join(decision_type, " ", same)
+         << "\nleft_child=" << join(left, " ", same)
+         << "\nright_child=" << join(right, " ", same)
+         << "\nleaf_value=" << join(leaf_value, " ", num)
+         << "\nshrinkage=1\n\n\n";
+    }
+    os << "end of trees\n";
+    return os.str();
+  }
+
+  /** the nodes expected from the conversion, as done by the treelite import */
+  void expected_nodes(std::vector<fil::dense_node_t>* nodes, int* depth) {
+    *depth = 0;
+    for (const gen_tree& tree : trees) *depth = std::max(*depth, tree.depth);
+    int tree_nodes = (1 << (*depth + 1)) - 1;
+    nodes->assign(ps.num_trees * tree_nodes, fil::dense_node_t{0, 0});
+    for (int t = 0; t < ps.num_trees; ++t) {
+      expected_subtree(trees[t], 0, 0, &(*nodes)[t * tree_nodes]);
+    }
+  }
+
+  void expected_subtree(const gen_tree& tree, int i, int pos,
+                        fil::dense_node_t* nodes) {
+    if (tree.left[i] < 0) {
+      fil::dense_node_init(&nodes[pos], tree.val[i], 0, 0, false, true);
+      return;
+    }
+    float thresh = tree.val[i];
+    // LightGBM splits are <= threshold
+    if (ps.format == fil::LIGHTGBM_TEXT)
+      thresh = nextafterf(thresh, std::numeric_limits<float>::infinity());
+    fil::dense_node_init(&nodes[pos], 0, thresh, tree.fid[i],
+                         tree.def_left[i], false);
+    expected_subtree(tree, tree.left[i], 2 * pos + 1, nodes);
+    expected_subtree(tree, tree.right[i], 2 * pos + 2, nodes);
+  }
+
+  FilLoadersParams ps;
+  std::mt19937 gen;
+  std::vector<gen_tree> trees;
+  float base_score;
+  fil::treelite_params_t tl_params;
+  temp_file file;
+};
+
+/** parsing the generated file produces the nodes of the treelite import */
+class ParseFilLoadersTest : public FilLoadersTest {
+ protected:
+  void compare() {
+    fil::parsed_model_t model;
+    fil::forest_params_t params;
+    fil::parse_model(&model, &params, file.name.c_str(), ps.format,
+                     &tl_params);
+    std::vector<fil::dense_node_t> nodes(fil::parsed_model_num_nodes(model));
+    fil::write_nodes(model, nodes.data());
+    fil::free_parsed_model(model);
+
+    std::vector<fil::dense_node_t> want_nodes;
+    int want_depth;
+    expected_nodes(&want_nodes, &want_depth);
+    ASSERT_EQ(want_depth, params.depth);
+    ASSERT_EQ(ps.num_trees, params.ntrees);
+    ASSERT_EQ(ps.cols, params.cols);
+    ASSERT_EQ(nullptr, params.nodes);
+    ASSERT_EQ(want_nodes.size(), nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      ASSERT_EQ(want_nodes[i].bits, nodes[i].bits) << "node " << i;
+      ASSERT_EQ(0, memcmp(&want_nodes[i].val, &nodes[i].val, sizeof(float)))
+        << "node " << i;
+    }
+
+    int output = ps.average ? fil::output_t::AVG : fil::output_t::RAW;
+    float global_bias = 0.0f;
+    if (ps.classification) {
+      output |= fil::output_t::SIGMOID | fil::output_t::THRESHOLD;
+    }
+    if (ps.format != fil::LIGHTGBM_TEXT) {
+      global_bias = ps.classification ? -logf(1.0f / base_score - 1.0f)
+                                      : base_score;
+    }
+    ASSERT_EQ(output, params.output);
+    ASSERT_EQ(global_bias, params.global_bias);
+    ASSERT_EQ(tl_params.algo, params.algo);
+    ASSERT_EQ(tl_params.threshold, params.threshold);
+  }
+};
+
+/** from_file() predicts the same as the treelite import of the same file */
+class TreeliteFilLoadersTest : public FilLoadersTest {
+ protected:
+  void compare() {
+    // XGBoost JSON is not read by treelite, use the equivalent binary model
+    temp_file tl_file;
+    fil::model_format_t tl_format = ps.format == fil::XGBOOST_JSON
+                                      ? fil::XGBOOST_BINARY
+                                      : ps.format;
+    write_model(tl_format, tl_file.name);
+    ModelHandle model;
+    if (tl_format == fil::LIGHTGBM_TEXT) {
+      ASSERT_EQ(0, TreeliteLoadLightGBMModel(tl_file.name.c_str(), &model));
+    } else {
+      ASSERT_EQ(0, TreeliteLoadXGBoostModel(tl_file.name.c_str(), &model));
+    }
+
+    cudaStream_t stream;
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    cumlHandle handle;
+    handle.setStream(stream);
+
+    // some of the data is NaN, to check the default directions
+    int rows = 5000;
+    std::vector<float> data_h(rows * ps.cols);
+    std::uniform_real_distribution<float> val(-1.0f, 1.0f);
+    std::bernoulli_distribution nan(0.05);
+    for (float& x : data_h) {
+      x = nan(gen) ? std::numeric_limits<float>::quiet_NaN() : val(gen);
+    }
+    float *data_d, *preds_d, *want_preds_d;
+    allocate(data_d, data_h.size());
+    allocate(preds_d, rows);
+    allocate(want_preds_d, rows);
+    updateDevice(data_d, data_h.data(), data_h.size(), stream);
+
+    fil::forest_t forest;
+    fil::from_treelite(handle, &forest, model, &tl_params);
+    fil::predict(handle, forest, want_preds_d, data_d, rows);
+    fil::free(handle, forest);
+    fil::from_file(handle, &forest, file.name.c_str(), ps.format, &tl_params);
+    fil::predict(handle, forest, preds_d, data_d, rows);
+    fil::free(handle, forest);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    ASSERT_EQ(0, TreeliteFreeModel(model));
+
+    ASSERT_TRUE(
+      devArrMatch(want_preds_d, preds_d, rows, Compare<float>(), stream));
+    CUDA_CHECK(cudaFree(data_d));
+    CUDA_CHECK(cudaFree(preds_d));
+    CUDA_CHECK(cudaFree(want_preds_d));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+};
+
+// format, num_trees, cols, max_depth, leaf_prob, classification, average,
+// seed
+std::vector<FilLoadersParams> loaders_inputs = {
+  {fil::XGBOOST_BINARY, 50, 20, 6, 0.2f, false, false, 42},
+  {fil::XGBOOST_BINARY, 30, 7, 10, 0.3f, true, false, 43},
+  {fil::XGBOOST_BINARY, 1, 3, 0, 0.0f, false, false, 44},
+  {fil::XGBOOST_JSON, 50, 20, 6, 0.2f, false, false, 42},
+  {fil::XGBOOST_JSON, 30, 7, 10, 0.3f, true, false, 43},
+  {fil::XGBOOST_JSON, 1, 3, 0, 0.0f, true, false, 44},
+  {fil::LIGHTGBM_TEXT, 50, 20, 6, 0.2f, false, false, 42},
+  {fil::LIGHTGBM_TEXT, 30, 7, 10, 0.3f, true, false, 43},
+  {fil::LIGHTGBM_TEXT, 20, 12, 8, 0.1f, false, true, 45},
+  {fil::LIGHTGBM_TEXT, 1, 3, 0, 0.0f, false, false, 44},
+};
+
+TEST_P(ParseFilLoadersTest, Parse) { compare(); }
+
+INSTANTIATE_TEST_CASE_P(FilLoadersTests, ParseFilLoadersTest,
+                        testing::ValuesIn(loaders_inputs));
+
+TEST_P(TreeliteFilLoadersTest, Import) { compare(); }
+
+INSTANTIATE_TEST_CASE_P(FilLoadersTests, TreeliteFilLoadersTest,
+                        testing::ValuesIn(loaders_inputs));
+
+TEST(FilLoadersErrorTest, Malformed) {
+  fil::treelite_params_t tl_params;
+  tl_params.algo = fil::algo_t::NAIVE;
+  tl_params.output_class = false;
+  tl_params.threshold = 0.5f;
+  fil::parsed_model_t model;
+  fil::forest_params_t params;
+  temp_file file;
+  const char* contents[] = {"binf\x01\x02", "{\"learner\":{}}",
+                            "tree\nobjective=multiclass num_class:3\n"};
+  fil::model_format_t formats[] = {fil::XGBOOST_BINARY, fil::XGBOOST_JSON,
+                                   fil::LIGHTGBM_TEXT};
+  for (int i = 0; i < 3; ++i) {
+    std::ofstream(file.name) << contents[i];
+    ASSERT_THROW(fil::parse_model(&model, &params, file.name.c_str(),
+                                  formats[i], &tl_params),
+                 MLCommon::Exception);
+  }
+  ASSERT_THROW(fil::parse_model(&model, &params, "/nonexistent/model",
+                                fil::XGBOOST_BINARY, &tl_params),
+               MLCommon::Exception);
+}
+
+}  // namespace ML
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <test_utils.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fil/registry.h"
+#include "test_utils.h"
+
+namespace ML {
+
+using namespace MLCommon;
+
+class FilRegistryTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    allocate(data_d, rows);
+    allocate(preds_d, rows);
+    CUDA_CHECK(cudaMemsetAsync(data_d, 0, rows * sizeof(float), stream));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(data_d));
+    CUDA_CHECK(cudaFree(preds_d));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  /** publishes a forest of ntrees single-leaf trees, which predicts
+      ntrees * value; its nodes take 8 * ntrees bytes */
+  void publish(fil::forest_registry* registry, const std::string& name,
+               int version, float value, int ntrees = 1) {
+    std::vector<fil::dense_node_t> nodes(ntrees);
+    for (auto& node : nodes)
+      fil::dense_node_init(&node, value, 0, 0, false, true);
+    fil::forest_params_t params;
+    params.nodes = nodes.data();
+    params.depth = 0;
+    params.ntrees = ntrees;
+    params.cols = 1;
+    params.algo = fil::algo_t::NAIVE;
+    params.output = fil::output_t::RAW;
+    params.threshold = 0.5f;
+    params.global_bias = 0.0f;
+    registry->publish(name, version, &params);
+  }
+
+  testing::AssertionResult predicts(const fil::forest_ref& forest,
+                                    float value) {
+    forest->predict(handle, preds_d, data_d, rows);
+    std::vector<float> want(rows, value);
+    return devArrMatchHost(want.data(), preds_d, rows, Compare<float>(),
+                           stream);
+  }
+
+  fil::registry_params_t params(size_t budget, fil::evict_t evict) {
+    fil::registry_params_t p;
+    p.device_budget = budget;
+    p.evict = evict;
+    return p;
+  }
+
+  const int rows = 100;
+  float *data_d = nullptr, *preds_d = nullptr;
+  cudaStream_t stream;
+  cumlHandle handle;
+};
+
+TEST_F(FilRegistryTest, Publish) {
+  fil::forest_registry registry(handle, params(0, fil::EVICT_TO_HOST));
+  publish(&registry, "a", 1, 1.0f);
+  publish(&registry, "b", 3, 2.0f, 2);
+  ASSERT_EQ(2u, registry.size());
+  ASSERT_EQ(1, registry.version("a"));
+  ASSERT_EQ(3, registry.version("b"));
+  ASSERT_EQ(-1, registry.version("c"));
+  ASSERT_EQ(3 * sizeof(fil::dense_node_t), registry.device_bytes());
+  ASSERT_TRUE(predicts(registry.get("a"), 1.0f));
+  ASSERT_TRUE(predicts(registry.get("b"), 4.0f));
+  ASSERT_THROW(registry.get("c"), MLCommon::Exception);
+}
+
+TEST_F(FilRegistryTest, HotSwap) {
+  fil::forest_registry registry(handle, params(0, fil::EVICT_TO_HOST));
+  publish(&registry, "a", 1, 1.0f);
+  fil::forest_ref v1 = registry.get("a");
+  publish(&registry, "a", 2, 2.0f);
+  ASSERT_THROW(publish(&registry, "a", 2, 3.0f), MLCommon::Exception);
+  fil::forest_ref v2 = registry.get("a");
+  ASSERT_EQ(1, v1->version());
+  ASSERT_EQ(2, v2->version());
+  ASSERT_EQ(2, registry.version("a"));
+  // the old version stays usable, but is no longer in the registry
+  ASSERT_TRUE(predicts(v1, 1.0f));
+  ASSERT_TRUE(predicts(v2, 2.0f));
+  ASSERT_EQ(sizeof(fil::dense_node_t), registry.device_bytes());
+
+  registry.remove("a");
+  ASSERT_EQ(0u, registry.size());
+  ASSERT_EQ(0u, registry.device_bytes());
+  ASSERT_TRUE(predicts(v2, 2.0f));
+  v1.reset();
+  v2.reset();
+}
+
+TEST_F(FilRegistryTest, Evict) {
+  size_t node = sizeof(fil::dense_node_t);
+  fil::forest_registry registry(handle, params(3 * node, fil::EVICT_TO_HOST));
+  publish(&registry, "a", 1, 1.0f);
+  publish(&registry, "b", 1, 2.0f);
+  publish(&registry, "c", 1, 3.0f, 2);
+  // a was the least recently used
+  ASSERT_FALSE(registry.is_loaded("a"));
+  ASSERT_TRUE(registry.is_loaded("b"));
+  ASSERT_TRUE(registry.is_loaded("c"));
+  ASSERT_EQ(3 * node, registry.device_bytes());
+
+  // using b makes c the least recently used
+  registry.get("b");
+  ASSERT_TRUE(predicts(registry.get("a"), 1.0f));
+  ASSERT_TRUE(registry.is_loaded("a"));
+  ASSERT_TRUE(registry.is_loaded("b"));
+  ASSERT_FALSE(registry.is_loaded("c"));
+  ASSERT_EQ(2 * node, registry.device_bytes());
+  ASSERT_TRUE(predicts(registry.get("c"), 6.0f));
+  ASSERT_EQ(3 * node, registry.device_bytes());
+
+  // a model larger than the budget is rejected
+  ASSERT_THROW(publish(&registry, "d", 1, 1.0f, 4), MLCommon::Exception);
+  ASSERT_EQ(-1, registry.version("d"));
+}
+
+TEST_F(FilRegistryTest, EvictDrop) {
+  // a single-leaf LightGBM model
+  char name[] = "/tmp/fil_registry_XXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::ofstream(name) << "tree\nversion=v2\nnum_class=1\n"
+                      << "num_tree_per_iteration=1\nmax_feature_idx=0\n"
+                      << "objective=regression\n\nTree=0\nnum_leaves=1\n"
+                      << "num_cat=0\nleaf_value=3\n\nend of trees\n";
+  fil::treelite_params_t tl_params;
+  tl_params.algo = fil::algo_t::NAIVE;
+  tl_params.output_class = false;
+  tl_params.threshold = 0.5f;
+
+  size_t node = sizeof(fil::dense_node_t);
+  fil::forest_registry registry(handle, params(node, fil::EVICT_DROP));
+  registry.publish("file", 1, name, fil::LIGHTGBM_TEXT, &tl_params);
+  publish(&registry, "nodes", 1, 1.0f);
+  ASSERT_FALSE(registry.is_loaded("file"));
+  // the file is parsed again
+  ASSERT_TRUE(predicts(registry.get("file"), 3.0f));
+  ASSERT_FALSE(registry.is_loaded("nodes"));
+  // the nodes were kept
+  ASSERT_TRUE(predicts(registry.get("nodes"), 1.0f));
+  std::remove(name);
+  ASSERT_THROW(registry.get("file"), MLCommon::Exception);
+}
+
+TEST_F(FilRegistryTest, ConcurrentHotSwap) {
+  // readers predict with a and b while new versions of a are published;
+  // with room for one model, every get() of the other one evicts and
+  // reloads, so loads, swaps and frees all race with each other. Version v
+  // of a predicts v and of b predicts -1: every prediction has to match the
+  // version it was made with
+  size_t node = sizeof(fil::dense_node_t);
+  fil::forest_registry registry(handle, params(node, fil::EVICT_TO_HOST));
+  publish(&registry, "a", 1, 1.0f);
+  publish(&registry, "b", 1, -1.0f);
+  const int n_readers = 4, n_iters = 50, n_versions = 20;
+  std::atomic<bool> done(false);
+  std::vector<std::exception_ptr> errors(n_readers);
+  std::vector<int> mismatches(n_readers, 0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < n_readers; t++) {
+    readers.emplace_back([&, t]() {
+      try {
+        cudaStream_t s;
+        CUDA_CHECK(cudaStreamCreate(&s));
+        float* preds;
+        allocate(preds, rows);
+        {
+          cumlHandle h;
+          h.setStream(s);
+          std::vector<float> preds_h(rows);
+          for (int i = 0; i < n_iters || !done; i++) {
+            fil::forest_ref forest = registry.get(i % 2 == 0 ? "a" : "b");
+            forest->predict(h, preds, data_d, rows);
+            updateHost(preds_h.data(), preds, rows, s);
+            CUDA_CHECK(cudaStreamSynchronize(s));
+            float want = forest->name() == "a" ? forest->version() : -1.0f;
+            for (float p : preds_h) mismatches[t] += p != want;
+          }
+        }
+        CUDA_CHECK(cudaFree(preds));
+        CUDA_CHECK(cudaStreamDestroy(s));
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  }
+  for (int v = 2; v <= n_versions; v++) publish(&registry, "a", v, float(v));
+  done = true;
+  for (auto& t : readers) t.join();
+  for (int t = 0; t < n_readers; t++) {
+    if (errors[t]) std::rethrow_exception(errors[t]);
+    ASSERT_EQ(0, mismatches[t]);
+  }
+  ASSERT_EQ(n_versions, registry.version("a"));
+  ASSERT_TRUE(predicts(registry.get("a"), float(n_versions)));
+  ASSERT_EQ(node, registry.device_bytes());
+}
+
+}  // namespace ML
@@ -24,6 +24,7 @@
 #include <limits>
 #include <memory>
 #include <utility>
+#include <vector>
 #include "fil/fil.h"
 #include "ml_utils.h"
 #include "random/rng.h"
@@ -503,4 +504,59 @@ TEST_P(TreeliteFilTest, Import) { compare(); }
 INSTANTIATE_TEST_CASE_P(FilTests, TreeliteFilTest,
                         testing::ValuesIn(import_inputs));
 
+/** single leaf forest predicting value for every row */
+fil::forest_t leaf_forest(const cumlHandle& h, float value) {
+  fil::dense_node_t node;
+  fil::dense_node_init(&node, value, 0.0f, 0, false, true);
+  fil::forest_params_t params;
+  params.nodes = &node;
+  params.depth = 0;
+  params.ntrees = 1;
+  params.cols = 1;
+  params.algo = fil::algo_t::NAIVE;
+  params.output = fil::output_t::RAW;
+  params.threshold = 0.0f;
+  params.global_bias = 0.0f;
+  fil::forest_t forest = nullptr;
+  fil::init_dense(h, &forest, &params);
+  return forest;
+}
+
+TEST(FilGraphTest, FreedForest) {
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  cumlHandle handle, other;
+  handle.setStream(stream);
+  handle.setGraphCapture(true);
+  other.setStream(stream);
+
+  const int rows = 4;
+  float *data, *preds;
+  allocate(data, rows, true);
+  allocate(preds, rows);
+  std::vector<float> want_a(rows, 1.0f), want_b(rows, 2.0f);
+
+  // the graph recorded for the first forest survives its free on the other
+  // handle, and must not be replayed for the next forest, which may get the
+  // same address
+  fil::forest_t forest = leaf_forest(other, 1.0f);
+  fil::predict(handle, forest, preds, data, rows);
+  ASSERT_TRUE(devArrMatchHost(want_a.data(), preds, rows,
+                              CompareApprox<float>(1e-6f), stream));
+  fil::free(other, forest);
+  forest = leaf_forest(other, 2.0f);
+  fil::predict(handle, forest, preds, data, rows);
+  ASSERT_TRUE(devArrMatchHost(want_b.data(), preds, rows,
+                              CompareApprox<float>(1e-6f), stream));
+  fil::predict(handle, forest, preds, data, rows);
+  ASSERT_TRUE(devArrMatchHost(want_b.data(), preds, rows,
+                              CompareApprox<float>(1e-6f), stream));
+  fil::free(other, forest);
+
+  handle.clearGraphs();
+  CUDA_CHECK(cudaFree(data));
+  CUDA_CHECK(cudaFree(preds));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
 }  // namespace ML
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cuda_utils.h>
+#include <gtest/gtest.h>
+#include <test_utils.h>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "gmm/gmm.hpp"
+
+namespace ML {
+namespace gmm {
+
+using namespace MLCommon;
+
+template <typename T>
+struct GmmInputs {
+  int n_row;
+  int n_col;
+  int n_components;
+  GMMParams::CovarianceType covariance_type;
+  int batch_size;
+  T tol;
+};
+
+template <typename T>
+::std::ostream &operator<<(::std::ostream &os, const GmmInputs<T> &dims) {
+  return os;
+}
+
+template <typename T>
+class GmmTest : public ::testing::TestWithParam<GmmInputs<T>> {
+ protected:
+  void basicTest() {
+    testparams = ::testing::TestWithParam<GmmInputs<T>>::GetParam();
+    int n = testparams.n_row, d = testparams.n_col;
+    int k = testparams.n_components;
+    params.n_components = k;
+    params.covariance_type = testparams.covariance_type;
+    params.batch_size = testparams.batch_size;
+    params.max_iter = 200;
+
+    // well separated axis aligned blobs of equal sizes, with a different
+    // spread per component
+    std::mt19937 gen(1234);
+    std::normal_distribution<T> normal(T(0), T(1));
+    std::vector<T> X_h(n * d);
+    labels_ref.resize(n);
+    centers_ref.resize(k * d);
+    for (int c = 0; c < k; c++) {
+      for (int j = 0; j < d; j++)
+        centers_ref[c * d + j] = T(8) * c * (j % 2 == 0 ? 1 : -1) + j;
+    }
+    for (int i = 0; i < n; i++) {
+      int c = i % k;
+      labels_ref[i] = c;
+      for (int j = 0; j < d; j++)
+        X_h[i * d + j] = centers_ref[c * d + j] + stddev(c) * normal(gen);
+    }
+
+    cov_len = k;
+    if (params.covariance_type == GMMParams::Full) cov_len = k * d * d;
+    if (params.covariance_type == GMMParams::Diag) cov_len = k * d;
+    allocate(X, n * d);
+    allocate(weights, k);
+    allocate(means, k * d);
+    allocate(covariances, cov_len);
+    allocate(labels, n);
+    allocate(probs, n * k);
+    allocate(log_prob, n);
+    updateDevice(X, X_h.data(), n * d, stream);
+
+    cumlHandle handle;
+    handle.setStream(stream);
+    fit(handle, params, X, n, d, weights, means, covariances, lower_bound,
+        n_iter);
+    predict(handle, params, weights, means, covariances, X, n, d, labels);
+    predict_proba(handle, params, weights, means, covariances, X, n, d, probs);
+    score_samples(handle, params, weights, means, covariances, X, n, d,
+                  log_prob);
+
+    weights_h.resize(k);
+    means_h.resize(k * d);
+    labels_h.resize(n);
+    probs_h.resize(n * k);
+    log_prob_h.resize(n);
+    covariances_h.resize(cov_len);
+    updateHost(weights_h.data(), weights, k, stream);
+    updateHost(means_h.data(), means, k * d, stream);
+    updateHost(labels_h.data(), labels, n, stream);
+    updateHost(probs_h.data(), probs, n * k, stream);
+    updateHost(log_prob_h.data(), log_prob, n, stream);
+    updateHost(covariances_h.data(), covariances, cov_len, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  // Standard deviation of every coordinate of the samples of component c
+  T stddev(int c) const { return T(0.5 + 0.5 * c); }
+
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    basicTest();
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(X));
+    CUDA_CHECK(cudaFree(weights));
+    CUDA_CHECK(cudaFree(means));
+    CUDA_CHECK(cudaFree(covariances));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(probs));
+    CUDA_CHECK(cudaFree(log_prob));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  void checkResult() {
+    int n = testparams.n_row, d = testparams.n_col;
+    int k = testparams.n_components;
+    T tol = testparams.tol;
+    ASSERT_GT(n_iter, 0);
+
+    // components are only identified up to a permutation
+    std::vector<int> perm(k, -1), used(k, 0);
+    for (int i = 0; i < n; i++) {
+      if (perm[labels_ref[i]] < 0) perm[labels_ref[i]] = labels_h[i];
+    }
+    for (int c = 0; c < k; c++) {
+      ASSERT_TRUE(perm[c] >= 0 && perm[c] < k);
+      ASSERT_EQ(used[perm[c]]++, 0);
+    }
+    int n_wrong = 0;
+    for (int i = 0; i < n; i++)
+      n_wrong += labels_h[i] != perm[labels_ref[i]];
+    ASSERT_LE(n_wrong, n / 100);
+
+    for (int c = 0; c < k; c++) {
+      ASSERT_NEAR(weights_h[perm[c]], T(1) / k, tol);
+      for (int j = 0; j < d; j++)
+        ASSERT_NEAR(means_h[perm[c] * d + j], centers_ref[c * d + j], 10 * tol);
+    }
+
+    // component c was drawn with covariance stddev(c)^2 * I; the sample
+    // estimates over n / k points are well within a quarter of it
+    for (int c = 0; c < k; c++) {
+      T var = stddev(c) * stddev(c);
+      T cov_tol = T(0.25) * var;
+      const T *cov = covariances_h.data();
+      switch (params.covariance_type) {
+        case GMMParams::Full:
+          cov += perm[c] * d * d;
+          for (int i = 0; i < d; i++) {
+            for (int j = 0; j < d; j++)
+              ASSERT_NEAR(cov[i * d + j], i == j ? var : T(0), cov_tol);
+          }
+          break;
+        case GMMParams::Diag:
+          cov += perm[c] * d;
+          for (int j = 0; j < d; j++) ASSERT_NEAR(cov[j], var, cov_tol);
+          break;
+        case GMMParams::Spherical:
+          ASSERT_NEAR(cov[perm[c]], var, cov_tol);
+          break;
+      }
+    }
+
+    T mean_log_prob = T(0);
+    for (int i = 0; i < n; i++) {
+      T row_sum = T(0);
+      for (int c = 0; c < k; c++) row_sum += probs_h[i * k + c];
+      ASSERT_NEAR(row_sum, T(1), T(1e-4));
+      mean_log_prob += log_prob_h[i] / n;
+    }
+    // EM never decreases the likelihood
+    ASSERT_GE(mean_log_prob, lower_bound - tol * (1 + std::abs(lower_bound)));
+  }
+
+ protected:
+  GmmInputs<T> testparams;
+  GMMParams params;
+  T *X, *weights, *means, *covariances, *probs, *log_prob;
+  int *labels;
+  T lower_bound;
+  int n_iter;
+  size_t cov_len;
+  std::vector<int> labels_ref, labels_h;
+  std::vector<T> centers_ref, weights_h, means_h, probs_h, log_prob_h,
+    covariances_h;
+  cudaStream_t stream;
+};
+
+const std::vector<GmmInputs<float>> inputsf = {
+  {3000, 2, 3, GMMParams::Full, 1 << 15, 0.02f},
+  {3000, 5, 3, GMMParams::Full, 512, 0.02f},
+  {3000, 5, 3, GMMParams::Diag, 512, 0.02f},
+  {3000, 5, 3, GMMParams::Spherical, 512, 0.02f},
+  {2000, 70, 2, GMMParams::Full, 300, 0.02f}};
+
+const std::vector<GmmInputs<double>> inputsd = {
+  {3000, 2, 3, GMMParams::Full, 1 << 15, 0.02},
+  {3000, 5, 3, GMMParams::Full, 512, 0.02},
+  {3000, 5, 3, GMMParams::Diag, 512, 0.02},
+  {3000, 5, 3, GMMParams::Spherical, 512, 0.02},
+  {2000, 70, 2, GMMParams::Full, 300, 0.02}};
+
+typedef GmmTest<float> GmmTestF;
+TEST_P(GmmTestF, Result) { checkResult(); }
+
+typedef GmmTest<double> GmmTestD;
+TEST_P(GmmTestD, Result) { checkResult(); }
+
+INSTANTIATE_TEST_CASE_P(GmmTests, GmmTestF, ::testing::ValuesIn(inputsf));
+
+INSTANTIATE_TEST_CASE_P(GmmTests, GmmTestD, ::testing::ValuesIn(inputsd));
+
+}  // end namespace gmm
+}  // end namespace ML
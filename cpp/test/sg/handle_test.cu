@@ -15,7 +15,14 @@
  */
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "common/batchFit.hpp"
+#include "cuML.hpp"
 #include "cuML_api.h"
 
 TEST(HandleTest, CreateHandleAndDestroy) {
@@ -55,3 +62,107 @@ TEST(HandleTest, SetStreamInvalidHandle) {
   cumlHandle_t handle = 12346;
   EXPECT_EQ(CUML_INVALID_HANDLE, cumlSetStream(handle, 0));
 }
+
+TEST(HandleTest, NumInternalStreams) {
+  ML::cumlHandle defaults;
+  EXPECT_EQ(ML::cumlHandle::getDefaultNumInternalStreams(),
+            defaults.getNumInternalStreams());
+  ML::cumlHandle none(0);
+  EXPECT_EQ(0, none.getNumInternalStreams());
+  ML::cumlHandle many(8);
+  EXPECT_EQ(8, many.getNumInternalStreams());
+}
+
+TEST(HandlePoolTest, CheckoutAndGiveBack) {
+  ML::cumlHandlePool pool(2, 1);
+  EXPECT_EQ(2, pool.size());
+  {
+    auto a = pool.checkout();
+    auto b = pool.checkout();
+    EXPECT_EQ(0, pool.available());
+    EXPECT_NE(&a.handle(), &b.handle());
+    EXPECT_NE(a.stream(), b.stream());
+    EXPECT_EQ(1, a.handle().getNumInternalStreams());
+    // the allocators are shared by the whole pool
+    EXPECT_EQ(a.handle().getDeviceAllocator(),
+              b.handle().getDeviceAllocator());
+    EXPECT_FALSE(pool.tryCheckout());
+  }
+  EXPECT_EQ(2, pool.available());
+
+  // a lease can order its work on a stream of its own
+  cudaStream_t stream;
+  ASSERT_EQ(cudaSuccess, cudaStreamCreate(&stream));
+  {
+    auto a = pool.checkout(stream);
+    EXPECT_EQ(stream, a.stream());
+  }
+  {
+    auto a = pool.tryCheckout();
+    ASSERT_TRUE(bool(a));
+    EXPECT_NE(stream, a.stream());
+  }
+  ASSERT_EQ(cudaSuccess, cudaStreamDestroy(stream));
+}
+
+TEST(HandlePoolTest, ConcurrentLeases) {
+  const int n_handles = 3, n_threads = 8, n_iters = 50;
+  ML::cumlHandlePool pool(n_handles);
+  std::atomic<int> in_use(0), max_in_use(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < n_iters; ++i) {
+        auto l = pool.checkout();
+        int now = ++in_use;
+        int prev = max_in_use.load();
+        while (now > prev && !max_in_use.compare_exchange_weak(prev, now)) {
+        }
+        auto allocator = l.handle().getDeviceAllocator();
+        void* p = allocator->allocate(256, l.stream());
+        EXPECT_EQ(cudaSuccess, cudaMemsetAsync(p, 0, 256, l.stream()));
+        allocator->deallocate(p, 256, l.stream());
+        EXPECT_EQ(cudaSuccess, cudaStreamSynchronize(l.stream()));
+        --in_use;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  EXPECT_LE(max_in_use.load(), n_handles);
+  EXPECT_EQ(n_handles, pool.available());
+}
+
+TEST(BatchFitTest, MemoryBudget) {
+  // 10 bytes per fit and a budget of 25: at most two fits at once
+  std::atomic<int> in_flight(0), max_in_flight(0);
+  ML::cumlHandle handle;
+  ML::batchFit(handle, 8,
+               [&](const ML::cumlHandle& h, int i) {
+                 int now = ++in_flight;
+                 int prev = max_in_flight.load();
+                 while (now > prev &&
+                        !max_in_flight.compare_exchange_weak(prev, now)) {
+                 }
+                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                 --in_flight;
+               },
+               4, 25, [](int i) { return std::size_t(10); });
+  EXPECT_LE(max_in_flight.load(), 2);
+}
+
+TEST(BatchFitTest, ErrorSkipsWaitingFits) {
+  // one fit at a time: the fits waiting for memory when the first one fails
+  // are skipped
+  std::atomic<int> started(0);
+  ML::cumlHandle handle;
+  EXPECT_THROW(ML::batchFit(handle, 6,
+                            [&](const ML::cumlHandle& h, int i) {
+                              ++started;
+                              std::this_thread::sleep_for(
+                                std::chrono::milliseconds(10));
+                              throw std::runtime_error("fit failed");
+                            },
+                            3, 10, [](int i) { return std::size_t(10); }),
+               std::runtime_error);
+  EXPECT_EQ(1, started.load());
+}
@@ -17,6 +17,7 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <test_utils.h>
+#include <cmath>
 #include <vector>
 #include "kmeans/kmeans.cu"
 
@@ -149,4 +150,125 @@ INSTANTIATE_TEST_CASE_P(KmeansTests, KmeansTestF,
 INSTANTIATE_TEST_CASE_P(KmeansTests, KmeansTestD,
                         ::testing::ValuesIn(inputsd2));
 
+TEST(KmeansSweepTest, MatchesSequentialFits) {
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  cumlHandle handle;
+  handle.setStream(stream);
+
+  // four well separated groups, fitted with 1 to 6 clusters from fixed
+  // initial centroids so that the fits are deterministic
+  const int n_samples = 400, n_features = 3, n_models = 6;
+  std::vector<float> h_X(n_samples * n_features);
+  for (int i = 0; i < n_samples; i++) {
+    for (int j = 0; j < n_features; j++) {
+      h_X[i * n_features + j] =
+        10.f * ((i % 4) == j) + 0.01f * ((i * 7 + j) % 13);
+    }
+  }
+  float *d_X;
+  allocate(d_X, n_samples * n_features);
+  updateDevice(d_X, h_X.data(), n_samples * n_features, stream);
+
+  std::vector<kmeans::KMeansParams> params(n_models);
+  std::vector<float *> centroids(n_models), centroids_ref(n_models);
+  std::vector<float> inertia(n_models), inertia_ref(n_models);
+  std::vector<int> n_iter(n_models), n_iter_ref(n_models);
+  for (int m = 0; m < n_models; m++) {
+    params[m].n_clusters = m + 1;
+    params[m].init = kmeans::KMeansParams::Array;
+    int len = params[m].n_clusters * n_features;
+    allocate(centroids[m], len);
+    allocate(centroids_ref[m], len);
+    // the first rows as initial centroids
+    copy(centroids[m], d_X, len, stream);
+    copy(centroids_ref[m], d_X, len, stream);
+  }
+
+  for (int m = 0; m < n_models; m++) {
+    kmeans::fit(handle, params[m], d_X, n_samples, n_features,
+                centroids_ref[m], inertia_ref[m], n_iter_ref[m]);
+  }
+  // the fits are estimated at 6.3 to 14.3 KB: no three fit in the budget,
+  // and the largest ones cannot run in pairs either, so fits have to wait
+  kmeans::fitSweep(handle, params.data(), n_models, d_X, n_samples,
+                   n_features, centroids.data(), inertia.data(),
+                   n_iter.data(), 3, 20 * 1024);
+
+  for (int m = 0; m < n_models; m++) {
+    ASSERT_TRUE(devArrMatch(centroids_ref[m], centroids[m],
+                            params[m].n_clusters * n_features,
+                            CompareApprox<float>(1e-4)));
+    ASSERT_NEAR(inertia_ref[m], inertia[m], 1e-3 * inertia_ref[m] + 1e-3);
+    ASSERT_EQ(n_iter_ref[m], n_iter[m]);
+    CUDA_CHECK(cudaFree(centroids[m]));
+    CUDA_CHECK(cudaFree(centroids_ref[m]));
+  }
+  CUDA_CHECK(cudaFree(d_X));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+TEST(KmeansHostTest, MatchesDevice) {
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  cumlHandle handle;
+  handle.setStream(stream);
+
+  const int n_samples = 1000, n_features = 8, n_clusters = 7;
+  std::vector<double> h_X(n_samples * n_features);
+  for (int i = 0; i < n_samples * n_features; i++)
+    h_X[i] = std::sin(0.37 * i) + 0.1 * (i % 11);
+  const double *h_centroids = h_X.data() + 100 * n_features;
+  double *d_X, *d_centroids, *d_transform;
+  int *d_labels;
+  allocate(d_X, n_samples * n_features);
+  allocate(d_centroids, n_clusters * n_features);
+  allocate(d_transform, n_samples * n_clusters);
+  allocate(d_labels, n_samples);
+  updateDevice(d_X, h_X.data(), n_samples * n_features, stream);
+  updateDevice(d_centroids, h_centroids, n_clusters * n_features, stream);
+
+  kmeans::KMeansParams params;
+  params.n_clusters = n_clusters;
+  params.metric = MLCommon::Distance::EucExpandedL2Sqrt;
+  // several batches of samples
+  params.batch_size = 300;
+  double inertia, inertia_host;
+  kmeans::predict(handle, params, d_centroids, d_X, n_samples, n_features,
+                  d_labels, inertia);
+  kmeans::transform(handle, params, d_centroids, d_X, n_samples, n_features,
+                    MLCommon::Distance::EucUnexpandedL1, d_transform);
+
+  // the same calls on host data, selected through the parameters
+  params.backend = kmeans::KMeansParams::Host;
+  std::vector<int> labels(n_samples);
+  std::vector<double> transformed(n_samples * n_clusters);
+  kmeans::predict(handle, params, h_centroids, h_X.data(), n_samples,
+                  n_features, labels.data(), inertia_host);
+  kmeans::transform(handle, params, h_centroids, h_X.data(), n_samples,
+                    n_features, MLCommon::Distance::EucUnexpandedL1,
+                    transformed.data());
+
+  ASSERT_TRUE(devArrMatchHost(labels.data(), d_labels, n_samples,
+                              Compare<int>(), stream));
+  ASSERT_NEAR(inertia, inertia_host, 1e-8 * inertia);
+  ASSERT_TRUE(devArrMatchHost(transformed.data(), d_transform,
+                              n_samples * n_clusters,
+                              CompareApprox<double>(1e-10), stream));
+
+  // without a handle
+  std::vector<int> labels2(n_samples);
+  double inertia2;
+  kmeans::predict(params, h_centroids, h_X.data(), n_samples, n_features,
+                  labels2.data(), inertia2);
+  ASSERT_EQ(labels, labels2);
+  ASSERT_NEAR(inertia_host, inertia2, 1e-8 * inertia_host);
+
+  CUDA_CHECK(cudaFree(d_X));
+  CUDA_CHECK(cudaFree(d_centroids));
+  CUDA_CHECK(cudaFree(d_transform));
+  CUDA_CHECK(cudaFree(d_labels));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
 }  // end namespace ML
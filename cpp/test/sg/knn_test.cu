@@ -17,7 +17,9 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <test_utils.h>
+#include <algorithm>
 #include <iostream>
+#include <random>
 #include <vector>
 #include "knn/knn.hpp"
 
@@ -102,4 +104,218 @@ TEST_F(KNNTestF, Fit) {
   ASSERT_TRUE(devArrMatch(d_ref_I, d_pred_I, n * n, Compare<long>()));
 }
 
+class KNNVoteTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    allocate(d_train_inputs, n * d);
+    allocate(d_y_class, n);
+    allocate(d_y_reg, n);
+    allocate(d_pred_class, n);
+    allocate(d_pred_class_w, n);
+    allocate(d_probs, n * n_classes);
+    allocate(d_pred_reg, n);
+    allocate(d_pred_reg_w, n);
+
+    std::vector<float> h_train_inputs = {1.0, 50.0, 51.0};
+    std::vector<int> h_y_class = {0, 1, 1};
+    std::vector<float> h_y_reg = {1.0, 2.0, 4.0};
+    updateDevice(d_train_inputs, h_train_inputs.data(), n * d, 0);
+    updateDevice(d_y_class, h_y_class.data(), n, 0);
+    updateDevice(d_y_reg, h_y_reg.data(), n, 0);
+
+    float *ptrs[1] = {d_train_inputs};
+    int sizes[1] = {n};
+
+    // a batch smaller than the number of queries exercises the chunking
+    knn_classify(handle, d_pred_class, d_probs, ptrs, sizes, 1, d, d_y_class,
+                 n_classes, d_train_inputs, n, k, false, 2);
+    knn_classify(handle, d_pred_class_w, nullptr, ptrs, sizes, 1, d,
+                 d_y_class, n_classes, d_train_inputs, n, k, true, 2);
+    knn_regress(handle, d_pred_reg, ptrs, sizes, 1, d, d_y_reg,
+                d_train_inputs, n, k, false, 2);
+    knn_regress(handle, d_pred_reg_w, ptrs, sizes, 1, d, d_y_reg,
+                d_train_inputs, n, k, true, 2);
+    CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(d_train_inputs));
+    CUDA_CHECK(cudaFree(d_y_class));
+    CUDA_CHECK(cudaFree(d_y_reg));
+    CUDA_CHECK(cudaFree(d_pred_class));
+    CUDA_CHECK(cudaFree(d_pred_class_w));
+    CUDA_CHECK(cudaFree(d_probs));
+    CUDA_CHECK(cudaFree(d_pred_reg));
+    CUDA_CHECK(cudaFree(d_pred_reg_w));
+  }
+
+ protected:
+  int n = 3;
+  int d = 1;
+  int k = 2;
+  int n_classes = 2;
+
+  float *d_train_inputs, *d_y_reg, *d_probs, *d_pred_reg, *d_pred_reg_w;
+  int *d_y_class, *d_pred_class, *d_pred_class_w;
+
+  cumlHandle handle;
+};
+
+TEST_F(KNNVoteTest, Predict) {
+  // ties are broken by the smaller class, exact matches take over the
+  // distance weighted votes
+  std::vector<int> class_ref = {0, 1, 1};
+  std::vector<float> probs_ref = {0.5, 0.5, 0.0, 1.0, 0.0, 1.0};
+  std::vector<float> reg_ref = {1.5, 3.0, 3.0};
+  std::vector<float> reg_w_ref = {1.0, 2.0, 4.0};
+  ASSERT_TRUE(
+    devArrMatchHost(class_ref.data(), d_pred_class, n, Compare<int>()));
+  ASSERT_TRUE(
+    devArrMatchHost(class_ref.data(), d_pred_class_w, n, Compare<int>()));
+  ASSERT_TRUE(devArrMatchHost(probs_ref.data(), d_probs, n * n_classes,
+                              CompareApprox<float>(1e-5)));
+  ASSERT_TRUE(devArrMatchHost(reg_ref.data(), d_pred_reg, n,
+                              CompareApprox<float>(1e-5)));
+  ASSERT_TRUE(devArrMatchHost(reg_w_ref.data(), d_pred_reg_w, n,
+                              CompareApprox<float>(1e-5)));
+}
+
+struct KNNCompressedInputs {
+  kNNStorage storage;
+  bool rerank;
+  // minimum fraction of the exact neighbors found
+  float min_recall;
+};
+
+::std::ostream &operator<<(::std::ostream &os,
+                           const KNNCompressedInputs &dims) {
+  return os;
+}
+
+class KNNCompressedTest
+  : public ::testing::TestWithParam<KNNCompressedInputs> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<KNNCompressedInputs>::GetParam();
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> dist(-3.f, 5.f);
+    h_index.resize(n * d);
+    std::vector<float> h_queries(n_queries * d);
+    for (auto &v : h_index) v = dist(gen);
+    for (auto &v : h_queries) v = dist(gen);
+    allocate(d_index, n * d);
+    allocate(d_queries, n_queries * d);
+    allocate(d_ref_I, n_queries * k);
+    allocate(d_ref_D, n_queries * k);
+    allocate(d_pred_I, n_queries * k);
+    allocate(d_pred_D, n_queries * k);
+    updateDevice(d_index, h_index.data(), n * d, 0);
+    updateDevice(d_queries, h_queries.data(), n_queries * d, 0);
+
+    float *ptrs[2] = {d_index, d_index + (n / 2) * d};
+    int sizes[2] = {n / 2, n - n / 2};
+    kNN exact(handle, d);
+    exact.fit(ptrs, sizes, 2);
+    exact.search(d_queries, n_queries, d_ref_I, d_ref_D, k);
+
+    kNN compressed(handle, d, false, params.storage);
+    compressed.fit(ptrs, sizes, 2);
+    if (params.rerank) compressed.set_rerank(h_index.data(), 4 * k);
+    compressed.search(d_queries, n_queries, d_pred_I, d_pred_D, k);
+    CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(d_index));
+    CUDA_CHECK(cudaFree(d_queries));
+    CUDA_CHECK(cudaFree(d_ref_I));
+    CUDA_CHECK(cudaFree(d_ref_D));
+    CUDA_CHECK(cudaFree(d_pred_I));
+    CUDA_CHECK(cudaFree(d_pred_D));
+  }
+
+ protected:
+  KNNCompressedInputs params;
+  int n = 3000, n_queries = 200, d = 16, k = 10;
+  std::vector<float> h_index;
+  float *d_index, *d_queries, *d_ref_D, *d_pred_D;
+  long *d_ref_I, *d_pred_I;
+  cumlHandle handle;
+};
+
+const std::vector<KNNCompressedInputs> compressed_inputs = {
+  {KNN_STORAGE_FLOAT16, false, 0.95f},
+  {KNN_STORAGE_INT8, false, 0.8f},
+  {KNN_STORAGE_FLOAT16, true, 1.f},
+  {KNN_STORAGE_INT8, true, 1.f}};
+
+TEST_P(KNNCompressedTest, Recall) {
+  int len = n_queries * k;
+  std::vector<long> ref_I(len), pred_I(len);
+  updateHost(ref_I.data(), d_ref_I, len, 0);
+  updateHost(pred_I.data(), d_pred_I, len, 0);
+  CUDA_CHECK(cudaDeviceSynchronize());
+  int found = 0;
+  for (int q = 0; q < n_queries; q++) {
+    for (int i = 0; i < k; i++) {
+      for (int j = 0; j < k; j++)
+        found += ref_I[q * k + i] == pred_I[q * k + j];
+    }
+  }
+  ASSERT_GE(found, params.min_recall * len);
+  // re-ranked neighbors have their exact distances, in order
+  if (params.rerank) {
+    ASSERT_TRUE(devArrMatch(d_ref_I, d_pred_I, len, Compare<long>()));
+    ASSERT_TRUE(
+      devArrMatch(d_ref_D, d_pred_D, len, CompareApprox<float>(1e-3)));
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(KNNCompressedTests, KNNCompressedTest,
+                        ::testing::ValuesIn(compressed_inputs));
+
+TEST(KNNCompressedTieTest, RerankBreaksTiesById) {
+  // the second chunk repeats the rows of the first one, so that every
+  // neighbor comes with an exact tie, which the re-ranking lists by id
+  int n = 1000, n_queries = 50, d = 8, k = 10;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  std::vector<float> h_index(n * d), h_queries(n_queries * d);
+  for (int i = 0; i < n / 2 * d; i++) h_index[i] = dist(gen);
+  std::copy(h_index.begin(), h_index.begin() + n / 2 * d,
+            h_index.begin() + n / 2 * d);
+  for (auto &v : h_queries) v = dist(gen);
+  cumlHandle handle;
+  float *d_index, *d_queries, *d_D;
+  long *d_I;
+  allocate(d_index, n * d);
+  allocate(d_queries, n_queries * d);
+  allocate(d_I, n_queries * k);
+  allocate(d_D, n_queries * k);
+  updateDevice(d_index, h_index.data(), n * d, 0);
+  updateDevice(d_queries, h_queries.data(), n_queries * d, 0);
+
+  float *ptrs[2] = {d_index, d_index + (n / 2) * d};
+  int sizes[2] = {n / 2, n / 2};
+  kNN compressed(handle, d, false, KNN_STORAGE_INT8);
+  compressed.fit(ptrs, sizes, 2);
+  compressed.set_rerank(h_index.data(), 4 * k);
+  compressed.search(d_queries, n_queries, d_I, d_D, k);
+  std::vector<long> I(n_queries * k);
+  updateHost(I.data(), d_I, I.size(), handle.getStream());
+  CUDA_CHECK(cudaStreamSynchronize(handle.getStream()));
+
+  for (int q = 0; q < n_queries; q++) {
+    for (int j = 0; j < k; j += 2) {
+      ASSERT_LT(I[q * k + j], n / 2);
+      ASSERT_EQ(I[q * k + j] + n / 2, I[q * k + j + 1]);
+    }
+  }
+
+  CUDA_CHECK(cudaFree(d_index));
+  CUDA_CHECK(cudaFree(d_queries));
+  CUDA_CHECK(cudaFree(d_I));
+  CUDA_CHECK(cudaFree(d_D));
+}
+
 }  // end namespace ML
@@ -17,7 +17,9 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <test_utils.h>
+#include <random>
 #include <vector>
+#include "glm/glm.hpp"
 #include "glm/ols.h"
 #include "ml_utils.h"
 
@@ -194,10 +196,12 @@ class OlsTest : public ::testing::TestWithParam<OlsInputs<T>> {
 };
 
 const std::vector<OlsInputs<float>> inputsf2 = {
-  {0.001f, 4, 2, 2, 0}, {0.001f, 4, 2, 2, 1}, {0.001f, 4, 2, 2, 2}};
+  {0.001f, 4, 2, 2, 0}, {0.001f, 4, 2, 2, 1}, {0.001f, 4, 2, 2, 2},
+  {0.001f, 4, 2, 2, 3}, {0.001f, 4, 2, 2, 4}};
 
 const std::vector<OlsInputs<double>> inputsd2 = {
-  {0.001, 4, 2, 2, 0}, {0.001, 4, 2, 2, 1}, {0.001, 4, 2, 2, 2}};
+  {0.001, 4, 2, 2, 0}, {0.001, 4, 2, 2, 1}, {0.001, 4, 2, 2, 2},
+  {0.001, 4, 2, 2, 3}, {0.001, 4, 2, 2, 4}};
 
 typedef OlsTest<float> OlsTestF;
 TEST_P(OlsTestF, Fit) {
@@ -251,5 +255,170 @@ INSTANTIATE_TEST_CASE_P(OlsTests, OlsTestF, ::testing::ValuesIn(inputsf2));
 
 INSTANTIATE_TEST_CASE_P(OlsTests, OlsTestD, ::testing::ValuesIn(inputsd2));
 
+template <typename T>
+struct OlsChunkedInputs {
+  T tol;
+  int n_row;
+  int n_col;
+  int batch_rows;
+  int algo;
+  bool fit_intercept;
+};
+
+template <typename T>
+class OlsChunkedTest : public ::testing::TestWithParam<OlsChunkedInputs<T>> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<OlsChunkedInputs<T>>::GetParam();
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    int n_row = params.n_row, n_col = params.n_col;
+
+    // host resident column major data with an exact linear relation, off
+    // center when fitting an intercept
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+    std::vector<T> data_h(n_row * n_col), labels_h(n_row);
+    coef_ref_h.resize(n_col);
+    T offset = params.fit_intercept ? T(10) : T(0);
+    for (auto &v : data_h) v = offset + dist(gen);
+    for (auto &v : coef_ref_h) v = dist(gen);
+    intercept_ref = params.fit_intercept ? T(3) : T(0);
+    for (int i = 0; i < n_row; i++) {
+      T acc = intercept_ref;
+      for (int j = 0; j < n_col; j++) {
+        acc += data_h[i + j * n_row] * coef_ref_h[j];
+      }
+      labels_h[i] = acc;
+    }
+
+    allocate(coef, n_col);
+    olsFitChunked(handle, data_h.data(), n_row, n_col, labels_h.data(), coef,
+                  &intercept, params.fit_intercept, params.algo,
+                  params.batch_rows);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(coef));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  OlsChunkedInputs<T> params;
+  std::vector<T> coef_ref_h;
+  T *coef;
+  T intercept, intercept_ref;
+  cumlHandle handle;
+  cudaStream_t stream;
+};
+
+const std::vector<OlsChunkedInputs<float>> inputsf_chunked = {
+  {0.01f, 1000, 5, 97, 3, true},   {0.01f, 1000, 5, 97, 4, true},
+  {0.01f, 1000, 5, 3, 3, false},   {0.01f, 1000, 5, 3, 4, false},
+  {0.01f, 1000, 5, 1000, 3, true}, {0.01f, 1000, 5, 1000, 4, true}};
+
+const std::vector<OlsChunkedInputs<double>> inputsd_chunked = {
+  {0.000001, 1000, 5, 97, 3, true},   {0.000001, 1000, 5, 97, 4, true},
+  {0.000001, 1000, 5, 3, 3, false},   {0.000001, 1000, 5, 3, 4, false},
+  {0.000001, 1000, 5, 1000, 3, true}, {0.000001, 1000, 5, 1000, 4, true}};
+
+typedef OlsChunkedTest<float> OlsChunkedTestF;
+TEST_P(OlsChunkedTestF, Fit) {
+  ASSERT_TRUE(devArrMatchHost(coef_ref_h.data(), coef, params.n_col,
+                              CompareApproxAbs<float>(params.tol), stream));
+  ASSERT_NEAR(intercept_ref, intercept, 20 * params.tol);
+}
+
+typedef OlsChunkedTest<double> OlsChunkedTestD;
+TEST_P(OlsChunkedTestD, Fit) {
+  ASSERT_TRUE(devArrMatchHost(coef_ref_h.data(), coef, params.n_col,
+                              CompareApproxAbs<double>(params.tol), stream));
+  ASSERT_NEAR(intercept_ref, intercept, 20 * params.tol);
+}
+
+INSTANTIATE_TEST_CASE_P(OlsChunkedTests, OlsChunkedTestF,
+                        ::testing::ValuesIn(inputsf_chunked));
+
+INSTANTIATE_TEST_CASE_P(OlsChunkedTests, OlsChunkedTestD,
+                        ::testing::ValuesIn(inputsd_chunked));
+
+TEST(OlsGraphTest, PredictReplay) {
+  cumlHandle handle;
+  cudaStream_t stream;
+  CUDA_CHECK(cudaStreamCreate(&stream));
+  handle.setStream(stream);
+  handle.setGraphCapture(true);
+
+  const int n_rows = 3, n_cols = 2;
+  std::vector<float> input_h = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+  std::vector<float> coef_a = {1.f, 2.f}, coef_b = {-1.f, 0.5f};
+  // column major input, preds = input * coef + intercept
+  std::vector<float> pred_a = {10.f, 13.f, 16.f}, pred_b = {2.f, 1.5f, 1.f};
+  std::vector<float> pred_c = {3.f, 2.5f, 2.f};
+  float *input, *coef, *preds;
+  allocate(input, n_rows * n_cols);
+  allocate(coef, n_cols);
+  allocate(preds, n_rows);
+  updateDevice(input, input_h.data(), n_rows * n_cols, stream);
+
+  // recorded on the first call, replayed on the second one, which must
+  // see the new contents of coef
+  updateDevice(coef, coef_a.data(), n_cols, stream);
+  olsPredict(handle, input, n_rows, n_cols, coef, 1.f, preds);
+  ASSERT_TRUE(devArrMatchHost(pred_a.data(), preds, n_rows,
+                              CompareApprox<float>(1e-5), stream));
+  updateDevice(coef, coef_b.data(), n_cols, stream);
+  olsPredict(handle, input, n_rows, n_cols, coef, 1.f, preds);
+  ASSERT_TRUE(devArrMatchHost(pred_b.data(), preds, n_rows,
+                              CompareApprox<float>(1e-5), stream));
+  // a different intercept is a different graph
+  olsPredict(handle, input, n_rows, n_cols, coef, 2.f, preds);
+  ASSERT_TRUE(devArrMatchHost(pred_c.data(), preds, n_rows,
+                              CompareApprox<float>(1e-5), stream));
+
+  handle.clearGraphs();
+  CUDA_CHECK(cudaFree(input));
+  CUDA_CHECK(cudaFree(coef));
+  CUDA_CHECK(cudaFree(preds));
+  CUDA_CHECK(cudaStreamDestroy(stream));
+}
+
+TEST(OlsGraphTest, StreamChange) {
+  cumlHandle handle;
+  cudaStream_t first, second;
+  CUDA_CHECK(cudaStreamCreate(&first));
+  CUDA_CHECK(cudaStreamCreate(&second));
+  handle.setGraphCapture(true);
+
+  const int n_rows = 3, n_cols = 2;
+  std::vector<float> input_h = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f};
+  std::vector<float> coef_h = {1.f, 2.f}, pred_h = {10.f, 13.f, 16.f};
+  float *input, *coef, *preds;
+  allocate(input, n_rows * n_cols);
+  allocate(coef, n_cols);
+  allocate(preds, n_rows);
+  updateDevice(input, input_h.data(), n_rows * n_cols, first);
+  updateDevice(coef, coef_h.data(), n_cols, first);
+  CUDA_CHECK(cudaStreamSynchronize(first));
+
+  // recorded on the first stream, replayed on the second one; the graph
+  // outlives the stream it was recorded on
+  handle.setStream(first);
+  olsPredict(handle, input, n_rows, n_cols, coef, 1.f, preds);
+  CUDA_CHECK(cudaStreamSynchronize(first));
+  CUDA_CHECK(cudaStreamDestroy(first));
+  handle.setStream(second);
+  CUDA_CHECK(cudaMemsetAsync(preds, 0, n_rows * sizeof(float), second));
+  olsPredict(handle, input, n_rows, n_cols, coef, 1.f, preds);
+  handle.clearGraphs();
+  ASSERT_TRUE(devArrMatchHost(pred_h.data(), preds, n_rows,
+                              CompareApprox<float>(1e-5), second));
+
+  CUDA_CHECK(cudaFree(input));
+  CUDA_CHECK(cudaFree(coef));
+  CUDA_CHECK(cudaFree(preds));
+  CUDA_CHECK(cudaStreamDestroy(second));
+}
+
 }  // namespace GLM
 }  // end namespace ML
@@ -17,8 +17,15 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <test_utils.h>
+#include <treelite/tree.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
 #include "ml_utils.h"
 #include "randomforest/randomforest.hpp"
+#include "randomforest/tree_serialization.h"
+#include "single_rank_comms.h"
+#include "thread_comms.h"
 
 namespace ML {
 
@@ -41,6 +48,7 @@ struct RfInputs {
   int min_rows_per_node;
   int n_streams;
   CRITERION split_criterion;
+  bool use_weights;  // fit with non uniform sample (and unit class) weights
 };
 
 template <typename T>
@@ -93,8 +101,22 @@ class RfClassifierTest : public ::testing::TestWithParam<RfInputs<T>> {
     cumlHandle handle;
     handle.setStream(stream);
 
+    T* sample_weight = nullptr;
+    T* class_weight = nullptr;
+    if (params.use_weights) {
+      std::vector<T> sample_weight_h = {1.0, 2.0, 0.5, 1.0};
+      sample_weight_h.resize(params.n_rows, 1.0);
+      std::vector<T> class_weight_h(labels_map.size(), 1.0);
+      allocate(sample_weight, params.n_rows);
+      allocate(class_weight, labels_map.size());
+      updateDevice(sample_weight, sample_weight_h.data(), params.n_rows,
+                   stream);
+      updateDevice(class_weight, class_weight_h.data(), labels_map.size(),
+                   stream);
+    }
+
     fit(handle, forest, data, params.n_rows, params.n_cols, labels,
-        labels_map.size(), rf_params);
+        labels_map.size(), rf_params, sample_weight, class_weight);
 
     CUDA_CHECK(cudaStreamSynchronize(stream));
 
@@ -109,8 +131,34 @@ class RfClassifierTest : public ::testing::TestWithParam<RfInputs<T>> {
     RF_metrics tmp =
       score(handle, forest, inference_data_d, labels, params.n_inference_rows,
             params.n_cols, predicted_labels, false);
+
+    // Class probabilities averaged over the trees, on device
+    int n_classes = labels_map.size();
+    T* probs;
+    allocate(probs, params.n_inference_rows * n_classes);
+    predict_proba(handle, forest, inference_data_d, params.n_inference_rows,
+                  params.n_cols, n_classes, probs);
+    std::vector<T> probs_h(params.n_inference_rows * n_classes);
+    std::vector<int> predicted_h(params.n_inference_rows);
+    updateHost(probs_h.data(), probs, probs_h.size(), stream);
+    updateHost(predicted_h.data(), predicted_labels, params.n_inference_rows,
+               stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    for (int i = 0; i < params.n_inference_rows; i++) {
+      T* row = &probs_h[i * n_classes];
+      T row_sum = std::accumulate(row, row + n_classes, T(0));
+      proba_sum_err = std::max(proba_sum_err, (float)std::abs(row_sum - 1));
+      int argmax = std::max_element(row, row + n_classes) - row;
+      proba_argmax_match = proba_argmax_match && (argmax == predicted_h[i]);
+    }
+    CUDA_CHECK(cudaFree(probs));
+
     CUDA_CHECK(cudaStreamSynchronize(stream));
     CUDA_CHECK(cudaStreamDestroy(stream));
+    if (params.use_weights) {
+      CUDA_CHECK(cudaFree(sample_weight));
+      CUDA_CHECK(cudaFree(class_weight));
+    }
 
     accuracy = tmp.accuracy;
   }
@@ -143,6 +191,8 @@ class RfClassifierTest : public ::testing::TestWithParam<RfInputs<T>> {
 
   RandomForestMetaData<T, int>* forest;
   float accuracy = -1.0f;  // overriden in each test SetUp and TearDown
+  float proba_sum_err = 0.0f;  // max deviation of a probability row sum from 1
+  bool proba_argmax_match = true;
 
   int* predicted_labels;
 };
@@ -192,7 +242,17 @@ class RfRegressorTest : public ::testing::TestWithParam<RfInputs<T>> {
     cumlHandle handle;
     handle.setStream(stream);
 
-    fit(handle, forest, data, params.n_rows, params.n_cols, labels, rf_params);
+    T* sample_weight = nullptr;
+    if (params.use_weights) {
+      std::vector<T> sample_weight_h = {1.0, 2.0, 0.5, 1.0};
+      sample_weight_h.resize(params.n_rows, 1.0);
+      allocate(sample_weight, params.n_rows);
+      updateDevice(sample_weight, sample_weight_h.data(), params.n_rows,
+                   stream);
+    }
+
+    fit(handle, forest, data, params.n_rows, params.n_cols, labels, rf_params,
+        sample_weight);
 
     CUDA_CHECK(cudaStreamSynchronize(stream));
 
@@ -209,6 +269,7 @@ class RfRegressorTest : public ::testing::TestWithParam<RfInputs<T>> {
             params.n_cols, predicted_labels, false);
     CUDA_CHECK(cudaStreamSynchronize(stream));
     CUDA_CHECK(cudaStreamDestroy(stream));
+    if (params.use_weights) CUDA_CHECK(cudaFree(sample_weight));
 
     mse = tmp.mean_squared_error;
   }
@@ -267,7 +328,17 @@ const std::vector<RfInputs<float>> inputsf2_clf = {
   {4, 2, 10, 0.8f, 0.8f, 4, 8, -1, true, false, 3, SPLIT_ALGO::HIST, 2, 2,
    CRITERION::ENTROPY},
   {4, 2, 10, 0.8f, 0.8f, 4, 8, -1, true, false, 3, SPLIT_ALGO::GLOBAL_QUANTILE,
-   2, 2, CRITERION::ENTROPY}};
+   2, 2, CRITERION::ENTROPY},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::GINI},
+  {4, 2, 10, 0.5f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2,
+   CRITERION::
+     GINI},  //forest with 10 trees, one of the two columns drawn per node
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::GINI, true},  // weighted histograms
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::ENTROPY, true}};
 
 const std::vector<RfInputs<double>> inputsd2_clf = {  // Same as inputsf2_clf
   {4, 2, 1, 1.0f, 1.0f, 4, -1, -1, false, false, 4, SPLIT_ALGO::HIST, 2, 2,
@@ -289,25 +360,37 @@ const std::vector<RfInputs<double>> inputsd2_clf = {  // Same as inputsf2_clf
   {4, 2, 10, 0.8f, 0.8f, 4, 8, -1, true, false, 3, SPLIT_ALGO::HIST, 2, 2,
    CRITERION::ENTROPY},
   {4, 2, 10, 0.8f, 0.8f, 4, 8, -1, true, false, 3, SPLIT_ALGO::GLOBAL_QUANTILE,
-   2, 2, CRITERION::ENTROPY}};
+   2, 2, CRITERION::ENTROPY},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::GINI},
+  {4, 2, 10, 0.5f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::GINI},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::GINI, true},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::ENTROPY, true}};
 
 typedef RfClassifierTest<float> RfClassifierTestF;
 TEST_P(RfClassifierTestF, Fit) {
   //print_rf_detailed(forest);  // Prints all trees in the forest. Leaf nodes use the remapped values from labels_map.
   if (!params.bootstrap && (params.max_features == 1.0f)) {
     ASSERT_TRUE(accuracy == 1.0f);
+    ASSERT_TRUE(proba_argmax_match);
   } else {
     ASSERT_TRUE(accuracy >= 0.75f);  // Empirically derived accuracy range
   }
+  ASSERT_TRUE(proba_sum_err <= 1e-5f);
 }
 
 typedef RfClassifierTest<double> RfClassifierTestD;
 TEST_P(RfClassifierTestD, Fit) {
   if (!params.bootstrap && (params.max_features == 1.0f)) {
     ASSERT_TRUE(accuracy == 1.0f);
+    ASSERT_TRUE(proba_argmax_match);
   } else {
     ASSERT_TRUE(accuracy >= 0.75f);
   }
+  ASSERT_TRUE(proba_sum_err <= 1e-5f);
 }
 
 INSTANTIATE_TEST_CASE_P(RfClassifierTests, RfClassifierTestF,
@@ -347,8 +430,14 @@ const std::vector<RfInputs<float>> inputsf2_reg = {
    CRITERION::MAE},
   {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
    2, 2, CRITERION::MAE},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MSE},
   {4, 2, 5, 1.0f, 1.0f, 4, 8, -1, true, false, 4, SPLIT_ALGO::HIST, 2, 2,
-   CRITERION::CRITERION_END}};
+   CRITERION::CRITERION_END},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MSE, true},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MAE, true}};
 
 const std::vector<RfInputs<double>> inputsd2_reg = {  // Same as inputsf2_reg
   {4, 2, 1, 1.0f, 1.0f, 4, -1, -1, false, false, 4, SPLIT_ALGO::HIST, 2, 2,
@@ -361,12 +450,636 @@ const std::vector<RfInputs<double>> inputsd2_reg = {  // Same as inputsf2_reg
    CRITERION::MAE},
   {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
    2, 2, CRITERION::MAE},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MSE},
   {4, 2, 5, 1.0f, 1.0f, 4, 8, -1, true, false, 4, SPLIT_ALGO::HIST, 2, 2,
-   CRITERION::CRITERION_END}};
+   CRITERION::CRITERION_END},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MSE, true},
+  {4, 2, 1, 1.0f, 1.0f, 4, 8, -1, false, false, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+   2, 2, CRITERION::MAE, true}};
 
 INSTANTIATE_TEST_CASE_P(RfRegressorTests, RfRegressorTestF,
                         ::testing::ValuesIn(inputsf2_reg));
 INSTANTIATE_TEST_CASE_P(RfRegressorTests, RfRegressorTestD,
                         ::testing::ValuesIn(inputsd2_reg));
 
+/** Whether two trees have the same splits and the same leaves */
+template <typename T, typename L>
+bool same_tree(const DecisionTree::TreeNode<T, L>* a,
+               const DecisionTree::TreeNode<T, L>* b) {
+  if (a == nullptr || b == nullptr) return a == b;
+  if ((a->left == nullptr) != (b->left == nullptr)) return false;
+  if (a->left == nullptr) {
+    return a->prediction == b->prediction && a->class_probs == b->class_probs;
+  }
+  return a->question.column == b->question.column &&
+         a->question.value == b->question.value &&
+         same_tree(a->left, b->left) && same_tree(a->right, b->right);
+}
+
+template <typename T, typename L>
+void delete_nodes(DecisionTree::TreeNode<T, L>* node) {
+  if (node == nullptr) return;
+  delete_nodes(node->left);
+  delete_nodes(node->right);
+  delete node;
+}
+
+template <typename T, typename L>
+bool same_forest(const RandomForestMetaData<T, L>* a,
+                 const RandomForestMetaData<T, L>* b) {
+  if (a->rf_params.n_trees != b->rf_params.n_trees) return false;
+  for (int i = 0; i < a->rf_params.n_trees; i++) {
+    if (!same_tree(a->trees[i].root, b->trees[i].root)) return false;
+  }
+  return true;
+}
+
+// Forests fitted on the same random data with different settings
+template <typename T>
+class RfCompareTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    // Integer valued features and targets, so that the class counts and the
+    // sums of targets do not depend on the order they are accumulated in
+    std::mt19937 gen(1234);
+    std::uniform_int_distribution<int> feature(0, 15), noise(0, 9);
+    std::vector<T> data_h(n_rows * n_cols), inference_h(n_rows * n_cols);
+    std::vector<T> targets_h(n_rows);
+    std::vector<int> labels_h(n_rows);
+    for (int i = 0; i < n_rows; i++) {
+      for (int j = 0; j < n_cols; j++) {
+        data_h[j * n_rows + i] = feature(gen);
+        inference_h[i * n_cols + j] = data_h[j * n_rows + i];
+      }
+      T x0 = data_h[i], x1 = data_h[n_rows + i], x2 = data_h[2 * n_rows + i];
+      labels_h[i] = (x0 > 7) + (x1 > 11);
+      if (noise(gen) == 0) labels_h[i] = (labels_h[i] + 1) % n_classes;
+      targets_h[i] = x0 + 2 * x2 + noise(gen);
+    }
+    allocate(data, n_rows * n_cols);
+    allocate(inference_data, n_rows * n_cols);
+    allocate(labels, n_rows);
+    allocate(targets, n_rows);
+    updateDevice(data, data_h.data(), n_rows * n_cols, stream);
+    updateDevice(inference_data, inference_h.data(), n_rows * n_cols, stream);
+    updateDevice(labels, labels_h.data(), n_rows, stream);
+    updateDevice(targets, targets_h.data(), n_rows, stream);
+  }
+
+  void TearDown() override {
+    for (auto forest : classifiers) {
+      delete[] forest->trees;
+      delete forest;
+    }
+    for (auto forest : regressors) {
+      delete[] forest->trees;
+      delete forest;
+    }
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(inference_data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(targets));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  RF_params make_params(int n_trees, float max_features, CRITERION criterion,
+                        bool hist_subtraction = true, uint64_t seed = 0) {
+    DecisionTree::DecisionTreeParams tree_params;
+    set_tree_params(tree_params, 8, -1, max_features, 16,
+                    SPLIT_ALGO::GLOBAL_QUANTILE, 2, false, criterion, false,
+                    hist_subtraction);
+    RF_params rf_params;
+    set_all_rf_params(rf_params, n_trees, true, 1.0f, 2, tree_params, seed);
+    return rf_params;
+  }
+
+  RandomForestMetaData<T, int>* fit_classifier(RF_params rf_params) {
+    RandomForestMetaData<T, int>* forest = new RandomForestMetaData<T, int>;
+    null_trees_ptr(forest);
+    classifiers.push_back(forest);
+    fit(handle, forest, data, n_rows, n_cols, labels, n_classes, rf_params);
+    return forest;
+  }
+
+  RandomForestMetaData<T, T>* fit_regressor(RF_params rf_params) {
+    RandomForestMetaData<T, T>* forest = new RandomForestMetaData<T, T>;
+    null_trees_ptr(forest);
+    regressors.push_back(forest);
+    fit(handle, forest, data, n_rows, n_cols, targets, rf_params);
+    return forest;
+  }
+
+  std::vector<T> predictions(const RandomForestMetaData<T, T>* forest) {
+    T* preds;
+    allocate(preds, n_rows);
+    predict(handle, forest, inference_data, n_rows, n_cols, preds);
+    std::vector<T> preds_h(n_rows);
+    updateHost(preds_h.data(), preds, n_rows, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(preds));
+    return preds_h;
+  }
+
+  /* Whether the trees of forest come out of pack_tree and unpack_tree
+     unchanged */
+  template <typename L>
+  bool round_trip(const RandomForestMetaData<T, L>* forest) {
+    std::vector<char> buffer;
+    for (int i = 0; i < forest->rf_params.n_trees; i++) {
+      pack_tree(&forest->trees[i], buffer);
+    }
+    bool same = true;
+    const char* packed = buffer.data();
+    for (int i = 0; i < forest->rf_params.n_trees; i++) {
+      DecisionTree::TreeMetaDataNode<T, L> tree;
+      packed = unpack_tree(packed, &tree);
+      same = same && same_tree(forest->trees[i].root, tree.root) &&
+             tree.depth_counter == forest->trees[i].depth_counter &&
+             tree.leaf_counter == forest->trees[i].leaf_counter;
+      delete_nodes(tree.root);
+    }
+    return same && packed == buffer.data() + buffer.size();
+  }
+
+  // A multiple of 8 * 16 rows: the quantiles merged from the per rank
+  // sketches of a multi-rank fit are then those of a single rank fit
+  const int n_rows = 512, n_cols = 4, n_classes = 3;
+  T *data, *inference_data, *targets;
+  int* labels;
+  cudaStream_t stream;
+  cumlHandle handle;
+  std::vector<RandomForestMetaData<T, int>*> classifiers;
+  std::vector<RandomForestMetaData<T, T>*> regressors;
+};
+
+typedef RfCompareTest<float> RfCompareTestF;
+TEST_F(RfCompareTestF, HistSubtraction) {
+  // Derived class histograms are exact, so histogram subtraction cannot
+  // change the trees, with or without per node column sampling
+  for (CRITERION criterion : {CRITERION::GINI, CRITERION::ENTROPY}) {
+    for (float max_features : {1.0f, 0.5f}) {
+      RF_params with = make_params(3, max_features, criterion, true);
+      RF_params without = make_params(3, max_features, criterion, false);
+      ASSERT_TRUE(same_forest(fit_classifier(with), fit_classifier(without)));
+    }
+  }
+}
+
+TEST_F(RfCompareTestF, Seed) {
+  // Row bootstrapping and per node column sampling only depend on the seed
+  // and the tree ids
+  for (CRITERION criterion : {CRITERION::GINI, CRITERION::ENTROPY}) {
+    RF_params rf_params = make_params(4, 0.5f, criterion, true, 42);
+    RandomForestMetaData<float, int>* forest = fit_classifier(rf_params);
+    ASSERT_TRUE(same_forest(forest, fit_classifier(rf_params)));
+    rf_params.seed = 43;
+    ASSERT_FALSE(same_forest(forest, fit_classifier(rf_params)));
+  }
+  // (seed, tree id) pairs do not share a random stream: the trees of a
+  // forest differ from each other, and from the trees of another seed
+  RandomForestMetaData<float, int>* a =
+    fit_classifier(make_params(2, 0.5f, CRITERION::GINI, true, 0));
+  RandomForestMetaData<float, int>* b =
+    fit_classifier(make_params(2, 0.5f, CRITERION::GINI, true, 1));
+  ASSERT_FALSE(same_tree(a->trees[0].root, a->trees[1].root));
+  ASSERT_FALSE(same_tree(a->trees[1].root, b->trees[0].root));
+  // Same for the row subsamples drawn without replacement, with every
+  // column considered so that only the rows tell the trees apart
+  RF_params rf_params = make_params(4, 1.0f, CRITERION::GINI, true, 42);
+  rf_params.bootstrap = false;
+  rf_params.rows_sample = 0.5f;
+  RandomForestMetaData<float, int>* forest = fit_classifier(rf_params);
+  ASSERT_TRUE(same_forest(forest, fit_classifier(rf_params)));
+  ASSERT_FALSE(same_tree(forest->trees[0].root, forest->trees[1].root));
+  rf_params.seed = 43;
+  ASSERT_FALSE(same_forest(forest, fit_classifier(rf_params)));
+}
+
+TEST_F(RfCompareTestF, PackTree) {
+  RF_params rf_params = make_params(3, 1.0f, CRITERION::GINI);
+  ASSERT_TRUE(round_trip(fit_classifier(rf_params)));
+  rf_params = make_params(3, 1.0f, CRITERION::MSE);
+  ASSERT_TRUE(round_trip(fit_regressor(rf_params)));
+}
+
+TEST_F(RfCompareTestF, FitMG) {
+  // On a single rank, a multi-rank fit is a single GPU fit
+  cumlHandle mg_handle;
+  mg_handle.setStream(stream);
+  init_single_rank_comms(mg_handle);
+  RF_params rf_params = make_params(4, 0.5f, CRITERION::GINI);
+  RandomForestMetaData<float, int>* forest = fit_classifier(rf_params);
+  RandomForestMetaData<float, int>* mg_forest =
+    new RandomForestMetaData<float, int>;
+  null_trees_ptr(mg_forest);
+  classifiers.push_back(mg_forest);
+  fit_mg(mg_handle, mg_forest, data, n_rows, n_cols, labels, n_classes,
+         rf_params);
+  ASSERT_TRUE(forest->quantiles == mg_forest->quantiles);
+  ASSERT_EQ(4, mg_forest->n_fitted_trees);
+  ASSERT_TRUE(same_forest(forest, mg_forest));
+
+  rf_params = make_params(4, 0.5f, CRITERION::MSE);
+  std::vector<float> preds = predictions(fit_regressor(rf_params));
+  RandomForestMetaData<float, float>* mg_regressor =
+    new RandomForestMetaData<float, float>;
+  null_trees_ptr(mg_regressor);
+  regressors.push_back(mg_regressor);
+  fit_mg(mg_handle, mg_regressor, data, n_rows, n_cols, targets, rf_params);
+  std::vector<float> mg_preds = predictions(mg_regressor);
+  for (int i = 0; i < n_rows; i++) {
+    ASSERT_NEAR(preds[i], mg_preds[i], 1e-4);
+  }
+}
+
+TEST_F(RfCompareTestF, FitMGUneven) {
+  // Ranks fitting 1, 3 and 2 trees on the same rows: the ids of a rank follow
+  // those of the lower ranks, so every rank gets the 6 trees of a single GPU
+  // fit of 6 trees, unpacked from the other ranks
+  const int n_ranks = 3;
+  int n_trees[n_ranks] = {1, 3, 2};
+  RandomForestMetaData<float, int>* forest =
+    fit_classifier(make_params(6, 0.5f, CRITERION::GINI));
+  std::vector<RandomForestMetaData<float, int>*> mg_forests(n_ranks);
+  for (auto& mg_forest : mg_forests) {
+    mg_forest = new RandomForestMetaData<float, int>;
+    null_trees_ptr(mg_forest);
+    classifiers.push_back(mg_forest);
+  }
+  run_ranks(n_ranks, [&](int rank, const cumlHandle& mg_handle) {
+    RF_params rf_params = make_params(n_trees[rank], 0.5f, CRITERION::GINI);
+    fit_mg(mg_handle, mg_forests[rank], data, n_rows, n_cols, labels,
+           n_classes, rf_params);
+  });
+  for (int r = 0; r < n_ranks; r++) {
+    ASSERT_TRUE(forest->quantiles == mg_forests[r]->quantiles);
+    ASSERT_EQ(6, mg_forests[r]->n_fitted_trees);
+    ASSERT_TRUE(same_forest(forest, mg_forests[r]));
+    ASSERT_TRUE(round_trip(mg_forests[r]));
+  }
+}
+
+typedef RfCompareTest<double> RfCompareTestD;
+TEST_F(RfCompareTestD, HistSubtraction) {
+  // The sums of targets are exact too; the regression metrics are
+  // accumulated in any order, so compare the predictions
+  for (CRITERION criterion : {CRITERION::MSE, CRITERION::MAE}) {
+    for (float max_features : {1.0f, 0.5f}) {
+      RF_params with = make_params(3, max_features, criterion, true);
+      RF_params without = make_params(3, max_features, criterion, false);
+      std::vector<double> preds_with = predictions(fit_regressor(with));
+      std::vector<double> preds_without = predictions(fit_regressor(without));
+      for (int i = 0; i < n_rows; i++) {
+        ASSERT_NEAR(preds_with[i], preds_without[i], 1e-6);
+      }
+    }
+  }
+  for (float max_features : {1.0f, 0.5f}) {
+    RF_params with = make_params(3, max_features, CRITERION::GINI, true);
+    RF_params without = make_params(3, max_features, CRITERION::GINI, false);
+    ASSERT_TRUE(same_forest(fit_classifier(with), fit_classifier(without)));
+  }
+}
+
+// One column taking values 0 to 3, with 5 rows of the majority class of each
+// value and 3 rows of the other class. Weighting the minority rows by 2 has
+// to give the same forest as duplicating them, and flips the leaves.
+template <typename T>
+class RfWeightsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    std::vector<T> data_h, dup_data_h, weights_h, targets_h, dup_targets_h;
+    std::vector<int> labels_h, dup_labels_h;
+    for (int v = 0; v < n_values; v++) {
+      for (int i = 0; i < 8; i++) {
+        bool minority = i >= 5;
+        int label = (v + minority) % 2;
+        T target = 10 * v + (minority ? 11 : 0);
+        data_h.push_back(v);
+        labels_h.push_back(label);
+        targets_h.push_back(target);
+        weights_h.push_back(minority ? 2 : 1);
+        for (int k = 0; k < (minority ? 2 : 1); k++) {
+          dup_data_h.push_back(v);
+          dup_labels_h.push_back(label);
+          dup_targets_h.push_back(target);
+        }
+      }
+    }
+    n_rows = data_h.size();
+    n_dup_rows = dup_data_h.size();
+    allocate(data, n_rows);
+    allocate(labels, n_rows);
+    allocate(targets, n_rows);
+    allocate(sample_weight, n_rows);
+    allocate(dup_data, n_dup_rows);
+    allocate(dup_labels, n_dup_rows);
+    allocate(dup_targets, n_dup_rows);
+    allocate(inference_data, n_values);
+    updateDevice(data, data_h.data(), n_rows, stream);
+    updateDevice(labels, labels_h.data(), n_rows, stream);
+    updateDevice(targets, targets_h.data(), n_rows, stream);
+    updateDevice(sample_weight, weights_h.data(), n_rows, stream);
+    updateDevice(dup_data, dup_data_h.data(), n_dup_rows, stream);
+    updateDevice(dup_labels, dup_labels_h.data(), n_dup_rows, stream);
+    updateDevice(dup_targets, dup_targets_h.data(), n_dup_rows, stream);
+    std::vector<T> inference_h = {0, 1, 2, 3};
+    updateDevice(inference_data, inference_h.data(), n_values, stream);
+
+    // 4 bins: the quantiles are the 4 values, with or without duplicates
+    DecisionTree::DecisionTreeParams tree_params;
+    set_tree_params(tree_params, 8, -1, 1.0f, n_values,
+                    SPLIT_ALGO::GLOBAL_QUANTILE, 2, false, CRITERION::GINI,
+                    false);
+    set_all_rf_params(rf_params, 1, false, 1.0f, 1, tree_params);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(targets));
+    CUDA_CHECK(cudaFree(sample_weight));
+    CUDA_CHECK(cudaFree(dup_data));
+    CUDA_CHECK(cudaFree(dup_labels));
+    CUDA_CHECK(cudaFree(dup_targets));
+    CUDA_CHECK(cudaFree(inference_data));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+  // Predictions and class probabilities of the 4 values
+  void classify(T* input, int n, int* y, const T* weights,
+                const T* class_weights, std::vector<int>& preds,
+                std::vector<T>& probs) {
+    RandomForestMetaData<T, int>* forest = new RandomForestMetaData<T, int>;
+    null_trees_ptr(forest);
+    fit(handle, forest, input, n, 1, y, n_classes, rf_params, weights,
+        class_weights);
+    int* d_preds;
+    T* d_probs;
+    allocate(d_preds, n_values);
+    allocate(d_probs, n_values * n_classes);
+    predict(handle, forest, inference_data, n_values, 1, d_preds);
+    predict_proba(handle, forest, inference_data, n_values, 1, n_classes,
+                  d_probs);
+    preds.resize(n_values);
+    probs.resize(n_values * n_classes);
+    updateHost(preds.data(), d_preds, n_values, stream);
+    updateHost(probs.data(), d_probs, n_values * n_classes, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(d_preds));
+    CUDA_CHECK(cudaFree(d_probs));
+    delete[] forest->trees;
+    delete forest;
+  }
+
+  std::vector<T> regress(T* input, int n, T* y, const T* weights) {
+    RandomForestMetaData<T, T>* forest = new RandomForestMetaData<T, T>;
+    null_trees_ptr(forest);
+    RF_params reg_params = rf_params;
+    reg_params.tree_params.split_criterion = CRITERION::MSE;
+    fit(handle, forest, input, n, 1, y, reg_params, weights);
+    T* d_preds;
+    allocate(d_preds, n_values);
+    predict(handle, forest, inference_data, n_values, 1, d_preds);
+    std::vector<T> preds(n_values);
+    updateHost(preds.data(), d_preds, n_values, stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(d_preds));
+    delete[] forest->trees;
+    delete forest;
+    return preds;
+  }
+
+  const int n_values = 4, n_classes = 2;
+  int n_rows, n_dup_rows;
+  T *data, *targets, *sample_weight, *dup_data, *dup_targets;
+  T* inference_data;
+  int *labels, *dup_labels;
+  cudaStream_t stream;
+  cumlHandle handle;
+  RF_params rf_params;
+};
+
+typedef RfWeightsTest<float> RfWeightsTestF;
+TEST_F(RfWeightsTestF, SampleWeights) {
+  std::vector<int> preds, weighted_preds, dup_preds;
+  std::vector<float> probs, weighted_probs, dup_probs;
+  classify(data, n_rows, labels, nullptr, nullptr, preds, probs);
+  classify(data, n_rows, labels, sample_weight, nullptr, weighted_preds,
+           weighted_probs);
+  classify(dup_data, n_dup_rows, dup_labels, nullptr, nullptr, dup_preds,
+           dup_probs);
+  for (int v = 0; v < n_values; v++) {
+    // 5 rows against 3 rows, weighted 5 against 6
+    ASSERT_EQ(v % 2, preds[v]);
+    ASSERT_EQ((v + 1) % 2, weighted_preds[v]);
+    ASSERT_EQ(dup_preds[v], weighted_preds[v]);
+    ASSERT_NEAR(6.0f / 11, weighted_probs[v * n_classes + (v + 1) % 2], 1e-5);
+    for (int c = 0; c < n_classes; c++) {
+      int idx = v * n_classes + c;
+      ASSERT_NEAR(dup_probs[idx], weighted_probs[idx], 1e-5);
+    }
+  }
+
+  std::vector<float> reg_preds = regress(data, n_rows, targets, nullptr);
+  std::vector<float> weighted_reg_preds =
+    regress(data, n_rows, targets, sample_weight);
+  std::vector<float> dup_reg_preds =
+    regress(dup_data, n_dup_rows, dup_targets, nullptr);
+  for (int v = 0; v < n_values; v++) {
+    ASSERT_NEAR(10 * v + 3 * 11 / 8.0f, reg_preds[v], 1e-4);
+    ASSERT_NEAR(10 * v + 6 * 11 / 11.0f, weighted_reg_preds[v], 1e-4);
+    ASSERT_NEAR(dup_reg_preds[v], weighted_reg_preds[v], 1e-4);
+  }
+}
+
+TEST_F(RfWeightsTestF, ClassWeights) {
+  // Weighting one class by 2 makes it the majority of every value
+  float* class_weight;
+  allocate(class_weight, n_classes);
+  for (int c = 0; c < n_classes; c++) {
+    std::vector<float> class_weight_h(n_classes, 1.0f);
+    class_weight_h[c] = 2.0f;
+    updateDevice(class_weight, class_weight_h.data(), n_classes, stream);
+    std::vector<int> preds;
+    std::vector<float> probs;
+    classify(data, n_rows, labels, nullptr, class_weight, preds, probs);
+    for (int v = 0; v < n_values; v++) {
+      ASSERT_EQ(c, preds[v]);
+    }
+  }
+  CUDA_CHECK(cudaFree(class_weight));
+}
+
+template <typename T>
+class RfWarmStartTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    // Same data as RfClassifierTest, twice; column major
+    std::vector<T> data_h = {30.0, 1.0, 2.0,  0.0,  30.0, 1.0, 2.0,  0.0,
+                             10.0, 20.0, 10.0, 40.0, 10.0, 20.0, 10.0, 40.0};
+    std::vector<int> labels_h = {0, 1, 0, 2, 0, 1, 0, 2};
+    allocate(data, n_rows * n_cols);
+    allocate(labels, n_rows);
+    allocate(predictions, n_rows);
+    updateDevice(data, data_h.data(), n_rows * n_cols, stream);
+    updateDevice(labels, labels_h.data(), n_rows, stream);
+    // row major for predict
+    std::vector<T> inference_h(n_rows * n_cols);
+    for (int i = 0; i < n_rows; i++) {
+      for (int j = 0; j < n_cols; j++)
+        inference_h[i * n_cols + j] = data_h[j * n_rows + i];
+    }
+    allocate(inference_data, n_rows * n_cols);
+    updateDevice(inference_data, inference_h.data(), n_rows * n_cols, stream);
+
+    DecisionTree::DecisionTreeParams tree_params;
+    set_tree_params(tree_params, 8, -1, 1.0f, 4, SPLIT_ALGO::GLOBAL_QUANTILE,
+                    2, false, CRITERION::GINI, false);
+    set_all_rf_params(rf_params, 3, false, 1.0f, 2, tree_params);
+    forest = new typename ML::RandomForestMetaData<T, int>;
+    null_trees_ptr(forest);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(predictions));
+    CUDA_CHECK(cudaFree(inference_data));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+    delete[] forest->trees;
+    delete forest;
+  }
+
+  float accuracy() {
+    RF_metrics metrics = score(handle, forest, inference_data, labels, n_rows,
+                               n_cols, predictions, false);
+    return metrics.accuracy;
+  }
+
+  std::vector<T> probabilities() {
+    T* probs;
+    allocate(probs, n_rows * n_classes);
+    predict_proba(handle, forest, inference_data, n_rows, n_cols, n_classes,
+                  probs);
+    std::vector<T> probs_h(n_rows * n_classes);
+    updateHost(probs_h.data(), probs, probs_h.size(), stream);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    CUDA_CHECK(cudaFree(probs));
+    return probs_h;
+  }
+
+  size_t treelite_trees() {
+    ModelHandle model;
+    build_treelite_forest(&model, forest, n_cols, n_classes);
+    size_t n = ((treelite::Model*)model)->trees.size();
+    EXPECT_EQ(0, TreeliteFreeModel(model));
+    return n;
+  }
+
+  const int n_rows = 8, n_cols = 2, n_classes = 3;
+  T *data, *inference_data;
+  int *labels, *predictions;
+  cudaStream_t stream;
+  cumlHandle handle;
+  RF_params rf_params;
+  RandomForestMetaData<T, int>* forest;
+};
+
+typedef RfWarmStartTest<float> RfWarmStartTestF;
+TEST_F(RfWarmStartTestF, Fit) {
+  fit(handle, forest, data, n_rows, n_cols, labels, n_classes, rf_params);
+  ASSERT_EQ(3, forest->rf_params.n_trees);
+  ASSERT_EQ(3, forest->n_fitted_trees);
+  ASSERT_EQ(n_cols, forest->n_cols);
+  ASSERT_EQ(4u * n_cols, forest->quantiles.size());
+  std::vector<float> quantiles = forest->quantiles;
+  std::vector<DecisionTree::TreeNode<float, int>*> roots;
+  for (int i = 0; i < 3; i++) roots.push_back(forest->trees[i].root);
+
+  // add 2 trees on the first half of the rows: the quantiles of the first
+  // fit are reused, and the existing trees are kept as they are
+  int n_half = n_rows / 2;
+  float* half_data;
+  allocate(half_data, n_half * n_cols);
+  for (int j = 0; j < n_cols; j++)
+    copy(half_data + j * n_half, data + j * n_rows, n_half, stream);
+  rf_params.n_trees = 2;
+  rf_params.n_streams = 2;
+  fit_warm_start(handle, forest, half_data, n_half, n_cols, labels, n_classes,
+                 rf_params);
+  CUDA_CHECK(cudaFree(half_data));
+  ASSERT_EQ(5, forest->rf_params.n_trees);
+  ASSERT_EQ(5, forest->n_fitted_trees);
+  ASSERT_TRUE(quantiles == forest->quantiles);
+  for (int i = 0; i < 3; i++) ASSERT_EQ(roots[i], forest->trees[i].root);
+  roots.push_back(forest->trees[3].root);
+  roots.push_back(forest->trees[4].root);
+  ASSERT_EQ(1.0f, accuracy());
+  ASSERT_EQ(5u, treelite_trees());
+
+  // add 2 more trees, keeping 4: the 3 oldest are dropped
+  fit_warm_start(handle, forest, data, n_rows, n_cols, labels, n_classes,
+                 rf_params, 4);
+  ASSERT_EQ(4, forest->rf_params.n_trees);
+  ASSERT_EQ(7, forest->n_fitted_trees);
+  ASSERT_EQ(roots[3], forest->trees[0].root);
+  ASSERT_EQ(roots[4], forest->trees[1].root);
+  ASSERT_EQ(1.0f, accuracy());
+  ASSERT_EQ(4u, treelite_trees());
+
+  // the binning changed: the quantiles are computed on the new data
+  rf_params.tree_params.n_bins = 3;
+  fit_warm_start(handle, forest, data, n_rows, n_cols, labels, n_classes,
+                 rf_params);
+  ASSERT_EQ(n_cols, forest->n_cols);
+  ASSERT_EQ(3u * n_cols, forest->quantiles.size());
+  ASSERT_EQ(6, forest->rf_params.n_trees);
+
+  // the columns, the number of classes and the criterion have to match
+  ASSERT_THROW(fit_warm_start(handle, forest, data, n_rows, 1, labels,
+                              n_classes, rf_params),
+               MLCommon::Exception);
+  ASSERT_THROW(fit_warm_start(handle, forest, data, n_rows, n_cols, labels,
+                              n_classes + 1, rf_params),
+               MLCommon::Exception);
+  rf_params.tree_params.split_criterion = CRITERION::ENTROPY;
+  ASSERT_THROW(fit_warm_start(handle, forest, data, n_rows, n_cols, labels,
+                              n_classes, rf_params),
+               MLCommon::Exception);
+  ASSERT_EQ(6, forest->rf_params.n_trees);
+}
+
+TEST_F(RfWarmStartTestF, ProbaCache) {
+  fit(handle, forest, data, n_rows, n_cols, labels, n_classes, rf_params);
+  ASSERT_EQ(nullptr, forest->flat_forest);
+
+  // the device copy of the trees is built once, then reused
+  std::vector<float> probs = probabilities();
+  ASSERT_NE(nullptr, forest->flat_forest);
+  auto* flat = forest->flat_forest.get();
+  ASSERT_TRUE(probs == probabilities());
+  ASSERT_EQ(flat, forest->flat_forest.get());
+
+  // adding trees drops it, and the next call sees all the trees
+  rf_params.n_trees = 2;
+  fit_warm_start(handle, forest, data, n_rows, n_cols, labels, n_classes,
+                 rf_params);
+  ASSERT_EQ(nullptr, forest->flat_forest);
+  probs = probabilities();
+  ASSERT_NE(nullptr, forest->flat_forest);
+  for (int i = 0; i < n_rows; i++) {
+    float* row = &probs[i * n_classes];
+    ASSERT_NEAR(1.0f, std::accumulate(row, row + n_classes, 0.0f), 1e-5);
+  }
+}
+
 }  // end namespace ML
@@ -17,6 +17,8 @@
 #include <cuda_utils.h>
 #include <gtest/gtest.h>
 #include <test_utils.h>
+#include <random>
+#include <vector>
 #include "glm/ridge.h"
 #include "ml_utils.h"
 
@@ -244,5 +246,96 @@ INSTANTIATE_TEST_CASE_P(RidgeTests, RidgeTestF, ::testing::ValuesIn(inputsf2));
 
 INSTANTIATE_TEST_CASE_P(RidgeTests, RidgeTestD, ::testing::ValuesIn(inputsd2));
 
+template <typename T>
+struct RidgeSweepInputs {
+  T tol;
+  int n_row;
+  int n_col;
+  int algo;
+  bool fit_intercept;
+  bool normalize;
+};
+
+template <typename T>
+class RidgeSweepTest
+  : public ::testing::TestWithParam<RidgeSweepInputs<T>> {
+ protected:
+  void SetUp() override {
+    params = ::testing::TestWithParam<RidgeSweepInputs<T>>::GetParam();
+    CUDA_CHECK(cudaStreamCreate(&stream));
+    handle.setStream(stream);
+    int n_row = params.n_row, n_col = params.n_col, len = n_row * n_col;
+    int n_alpha = alphas.size();
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+    data_h.resize(len);
+    labels_h.resize(n_row);
+    for (auto &v : data_h) v = T(2) + dist(gen);
+    for (auto &v : labels_h) v = T(1) + dist(gen);
+    allocate(data, len);
+    allocate(labels, n_row);
+    allocate(coef, n_col * n_alpha);
+    allocate(coef_ref, n_col * n_alpha);
+    updateDevice(data, data_h.data(), len, stream);
+    updateDevice(labels, labels_h.data(), n_row, stream);
+
+    // one model at a time, on fresh copies of the data
+    intercept_ref.resize(n_alpha);
+    for (int i = 0; i < n_alpha; i++) {
+      T alpha = alphas[i];
+      ridgeFit(handle.getImpl(), data, n_row, n_col, labels, &alpha, 1,
+               coef_ref + i * n_col, &intercept_ref[i], params.fit_intercept,
+               params.normalize, stream, params.algo);
+      updateDevice(data, data_h.data(), len, stream);
+      updateDevice(labels, labels_h.data(), n_row, stream);
+    }
+
+    intercept.resize(n_alpha);
+    ridgeFitSweep(handle.getImpl(), data, n_row, n_col, labels, alphas.data(),
+                  n_alpha, coef, intercept.data(), params.fit_intercept,
+                  params.normalize, stream, params.algo);
+  }
+
+  void TearDown() override {
+    CUDA_CHECK(cudaFree(data));
+    CUDA_CHECK(cudaFree(labels));
+    CUDA_CHECK(cudaFree(coef));
+    CUDA_CHECK(cudaFree(coef_ref));
+    CUDA_CHECK(cudaStreamDestroy(stream));
+  }
+
+ protected:
+  RidgeSweepInputs<T> params;
+  std::vector<T> alphas = {T(0.01), T(0.5), T(3), T(100)};
+  std::vector<T> data_h, labels_h, intercept, intercept_ref;
+  T *data, *labels, *coef, *coef_ref;
+  cumlHandle handle;
+  cudaStream_t stream;
+};
+
+const std::vector<RidgeSweepInputs<float>> inputsf_sweep = {
+  {0.001f, 50, 4, 0, false, false},
+  {0.001f, 50, 4, 0, true, false},
+  {0.001f, 50, 4, 1, true, true},
+  {0.001f, 30, 1, 0, true, false}};
+
+typedef RidgeSweepTest<float> RidgeSweepTestF;
+TEST_P(RidgeSweepTestF, Fit) {
+  int n_alpha = alphas.size();
+  ASSERT_TRUE(devArrMatch(coef_ref, coef, params.n_col * n_alpha,
+                          CompareApproxAbs<float>(params.tol)));
+  for (int i = 0; i < n_alpha; i++)
+    ASSERT_NEAR(intercept_ref[i], intercept[i], params.tol);
+  // the data is restored
+  ASSERT_TRUE(devArrMatchHost(data_h.data(), data, params.n_row * params.n_col,
+                              CompareApproxAbs<float>(params.tol), stream));
+  ASSERT_TRUE(devArrMatchHost(labels_h.data(), labels, params.n_row,
+                              CompareApproxAbs<float>(params.tol), stream));
+}
+
+INSTANTIATE_TEST_CASE_P(RidgeSweepTests, RidgeSweepTestF,
+                        ::testing::ValuesIn(inputsf_sweep));
+
 }  // namespace GLM
 }  // end namespace ML
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cuda_utils.h>
+#include <memory>
+#include "common/cumlHandle.hpp"
+#include "common/cuml_comms_iface.hpp"
+#include "cuML.hpp"
+
+namespace ML {
+
+/** Size in bytes of an element of datatype */
+inline size_t datatype_size(MLCommon::cumlCommunicator::datatype_t datatype) {
+  typedef MLCommon::cumlCommunicator::datatype_t datatype_t;
+  switch (datatype) {
+    case datatype_t::CHAR:
+      return sizeof(char);
+    case datatype_t::UINT8:
+      return sizeof(uint8_t);
+    case datatype_t::INT:
+      return sizeof(int);
+    case datatype_t::UINT:
+      return sizeof(unsigned int);
+    case datatype_t::INT64:
+      return sizeof(int64_t);
+    case datatype_t::UINT64:
+      return sizeof(uint64_t);
+    case datatype_t::FLOAT:
+      return sizeof(float);
+    case datatype_t::DOUBLE:
+      return sizeof(double);
+    default:
+      ASSERT(false, "unknown datatype");
+      return 0;
+  }
+}
+
+/**
+ * Communicator of a group holding only the calling process, so that the
+ * multi-rank code paths can be tested against the single GPU algorithms
+ * without MPI or NCCL. Collectives copy the send buffer to the receive buffer
+ * on the given stream; point to point operations are not supported.
+ */
+class SingleRankComms : public MLCommon::cumlCommunicator_iface {
+ public:
+  int getSize() const override { return 1; }
+  int getRank() const override { return 0; }
+
+  std::unique_ptr<MLCommon::cumlCommunicator_iface> commSplit(
+    int color, int key) const override {
+    return std::unique_ptr<MLCommon::cumlCommunicator_iface>(
+      new SingleRankComms());
+  }
+
+  void barrier() const override {}
+
+  status_t syncStream(cudaStream_t stream) const override {
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    return status_t::commStatusSuccess;
+  }
+
+  void isend(const void* buf, int size, int dest, int tag,
+             request_t* request) const override {
+    ASSERT(false, "SingleRankComms: isend is not supported");
+  }
+
+  void irecv(void* buf, int size, int source, int tag,
+             request_t* request) const override {
+    ASSERT(false, "SingleRankComms: irecv is not supported");
+  }
+
+  void waitall(int count, request_t array_of_requests[]) const override {}
+
+  void allreduce(const void* sendbuff, void* recvbuff, int count,
+                 datatype_t datatype, op_t op,
+                 cudaStream_t stream) const override {
+    copy(sendbuff, recvbuff, count, datatype, stream);
+  }
+
+  void bcast(void* buff, int count, datatype_t datatype, int root,
+             cudaStream_t stream) const override {}
+
+  void reduce(const void* sendbuff, void* recvbuff, int count,
+              datatype_t datatype, op_t op, int root,
+              cudaStream_t stream) const override {
+    copy(sendbuff, recvbuff, count, datatype, stream);
+  }
+
+  void allgather(const void* sendbuff, void* recvbuff, int sendcount,
+                 datatype_t datatype, cudaStream_t stream) const override {
+    copy(sendbuff, recvbuff, sendcount, datatype, stream);
+  }
+
+  void allgatherv(const void* sendbuf, void* recvbuf, const int recvcounts[],
+                  const int displs[], datatype_t datatype,
+                  cudaStream_t stream) const override {
+    size_t offset = displs[0] * datatype_size(datatype);
+    copy(sendbuf, static_cast<char*>(recvbuf) + offset, recvcounts[0],
+         datatype, stream);
+  }
+
+  void reducescatter(const void* sendbuff, void* recvbuff, int recvcount,
+                     datatype_t datatype, op_t op,
+                     cudaStream_t stream) const override {
+    copy(sendbuff, recvbuff, recvcount, datatype, stream);
+  }
+
+ private:
+  static void copy(const void* src, void* dst, int count, datatype_t datatype,
+                   cudaStream_t stream) {
+    if (src == dst || count == 0) return;
+    CUDA_CHECK(cudaMemcpyAsync(dst, src, count * datatype_size(datatype),
+                               cudaMemcpyDefault, stream));
+  }
+};
+
+/** Give handle a communicator of the calling process only */
+inline void init_single_rank_comms(cumlHandle& handle) {
+  handle.getImpl().setCommunicator(std::make_shared<MLCommon::cumlCommunicator>(
+    std::unique_ptr<MLCommon::cumlCommunicator_iface>(new SingleRankComms())));
+}
+
+}  // namespace ML
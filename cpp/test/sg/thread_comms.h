@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2019, NVIDIA CORPORATION.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cuda_utils.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "single_rank_comms.h"
+
+namespace ML {
+
+/**
+ * State shared by the ranks of a ThreadComms group: a barrier, the slots the
+ * ranks fill for a collective and the mailboxes of the point to point
+ * messages. Once a rank aborted, every wait throws.
+ */
+class ThreadCommsGroup {
+ public:
+  explicit ThreadCommsGroup(int size) : _size(size), _slots(size) {}
+
+  int size() const { return _size; }
+
+  void barrier() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    int generation = _generation;
+    if (++_arrived == _size) {
+      _arrived = 0;
+      ++_generation;
+      _cv.notify_all();
+      return;
+    }
+    _cv.wait(lock, [&] { return _aborted || _generation != generation; });
+    ASSERT(!_aborted, "ThreadComms: another rank failed");
+  }
+
+  /** The contributions of all the ranks to a collective, in rank order */
+  std::vector<std::vector<char>> gather(int rank, std::vector<char> data) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _slots[rank] = std::move(data);
+    }
+    barrier();
+    std::vector<std::vector<char>> all;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      all = _slots;
+    }
+    // no rank fills the slots of the next collective before all read them
+    barrier();
+    return all;
+  }
+
+  void send(int source, int dest, int tag, std::vector<char> msg) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _mailboxes[std::make_tuple(source, dest, tag)].push_back(std::move(msg));
+    _cv.notify_all();
+  }
+
+  std::vector<char> recv(int source, int dest, int tag) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto& mailbox = _mailboxes[std::make_tuple(source, dest, tag)];
+    _cv.wait(lock, [&] { return _aborted || !mailbox.empty(); });
+    ASSERT(!_aborted, "ThreadComms: another rank failed");
+    std::vector<char> msg = std::move(mailbox.front());
+    mailbox.pop_front();
+    return msg;
+  }
+
+  void abort() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _aborted = true;
+    _cv.notify_all();
+  }
+
+ private:
+  const int _size;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  int _arrived = 0;
+  int _generation = 0;
+  bool _aborted = false;
+  std::vector<std::vector<char>> _slots;
+  std::map<std::tuple<int, int, int>, std::deque<std::vector<char>>>
+    _mailboxes;
+};
+
+/**
+ * Communicator of a rank of a ThreadCommsGroup, so that the multi-rank code
+ * paths can be run on several ranks in one process, each rank being a thread
+ * with its own handle. Data goes through host memory; collectives and
+ * waitall block until the other ranks take part.
+ */
+class ThreadComms : public MLCommon::cumlCommunicator_iface {
+ public:
+  ThreadComms(std::shared_ptr<ThreadCommsGroup> group, int rank)
+    : _group(group), _rank(rank) {}
+
+  int getSize() const override { return _group->size(); }
+  int getRank() const override { return _rank; }
+
+  std::unique_ptr<MLCommon::cumlCommunicator_iface> commSplit(
+    int color, int key) const override {
+    ASSERT(false, "ThreadComms: commSplit is not supported");
+    return nullptr;
+  }
+
+  void barrier() const override { _group->barrier(); }
+
+  status_t syncStream(cudaStream_t stream) const override {
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    return status_t::commStatusSuccess;
+  }
+
+  void isend(const void* buf, int size, int dest, int tag,
+             request_t* request) const override {
+    std::vector<char> msg(size);
+    if (size > 0)
+      CUDA_CHECK(cudaMemcpy(msg.data(), buf, size, cudaMemcpyDefault));
+    _group->send(_rank, dest, tag, std::move(msg));
+    *request = _next_request++;
+  }
+
+  void irecv(void* buf, int size, int source, int tag,
+             request_t* request) const override {
+    *request = _next_request++;
+    _pending[*request] = pending_recv{buf, size, source, tag};
+  }
+
+  void waitall(int count, request_t array_of_requests[]) const override {
+    for (int i = 0; i < count; i++) {
+      auto it = _pending.find(array_of_requests[i]);
+      if (it == _pending.end()) continue;
+      const pending_recv& p = it->second;
+      std::vector<char> msg = _group->recv(p.source, _rank, p.tag);
+      ASSERT((int)msg.size() == p.size,
+             "ThreadComms: received %d bytes, expected %d", (int)msg.size(),
+             p.size);
+      if (p.size > 0)
+        CUDA_CHECK(cudaMemcpy(p.buf, msg.data(), p.size, cudaMemcpyDefault));
+      _pending.erase(it);
+    }
+  }
+
+  void allreduce(const void* sendbuff, void* recvbuff, int count,
+                 datatype_t datatype, op_t op,
+                 cudaStream_t stream) const override {
+    size_t bytes = count * datatype_size(datatype);
+    auto all = _group->gather(_rank, stage(sendbuff, bytes, stream));
+    unstage(recvbuff, reduce_all(all, count, datatype, op), stream);
+  }
+
+  void bcast(void* buff, int count, datatype_t datatype, int root,
+             cudaStream_t stream) const override {
+    size_t bytes = count * datatype_size(datatype);
+    auto all = _group->gather(
+      _rank, _rank == root ? stage(buff, bytes, stream) : std::vector<char>());
+    unstage(buff, all[root], stream);
+  }
+
+  void reduce(const void* sendbuff, void* recvbuff, int count,
+              datatype_t datatype, op_t op, int root,
+              cudaStream_t stream) const override {
+    size_t bytes = count * datatype_size(datatype);
+    auto all = _group->gather(_rank, stage(sendbuff, bytes, stream));
+    if (_rank == root)
+      unstage(recvbuff, reduce_all(all, count, datatype, op), stream);
+  }
+
+  void allgather(const void* sendbuff, void* recvbuff, int sendcount,
+                 datatype_t datatype, cudaStream_t stream) const override {
+    size_t bytes = sendcount * datatype_size(datatype);
+    auto all = _group->gather(_rank, stage(sendbuff, bytes, stream));
+    std::vector<char> out;
+    for (auto& part : all) out.insert(out.end(), part.begin(), part.end());
+    unstage(recvbuff, out, stream);
+  }
+
+  void allgatherv(const void* sendbuf, void* recvbuf, const int recvcounts[],
+                  const int displs[], datatype_t datatype,
+                  cudaStream_t stream) const override {
+    size_t size = datatype_size(datatype);
+    auto all =
+      _group->gather(_rank, stage(sendbuf, recvcounts[_rank] * size, stream));
+    for (int r = 0; r < getSize(); r++) {
+      unstage(static_cast<char*>(recvbuf) + displs[r] * size, all[r], stream);
+    }
+  }
+
+  void reducescatter(const void* sendbuff, void* recvbuff, int recvcount,
+                     datatype_t datatype, op_t op,
+                     cudaStream_t stream) const override {
+    size_t size = datatype_size(datatype);
+    auto all = _group->gather(
+      _rank, stage(sendbuff, recvcount * getSize() * size, stream));
+    std::vector<char> sum =
+      reduce_all(all, recvcount * getSize(), datatype, op);
+    std::vector<char> part(sum.begin() + _rank * recvcount * size,
+                           sum.begin() + (_rank + 1) * recvcount * size);
+    unstage(recvbuff, part, stream);
+  }
+
+ private:
+  struct pending_recv {
+    void* buf;
+    int size;
+    int source;
+    int tag;
+  };
+
+  static std::vector<char> stage(const void* buf, size_t bytes,
+                                 cudaStream_t stream) {
+    std::vector<char> data(bytes);
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+    if (bytes > 0)
+      CUDA_CHECK(cudaMemcpy(data.data(), buf, bytes, cudaMemcpyDefault));
+    return data;
+  }
+
+  static void unstage(void* buf, const std::vector<char>& data,
+                      cudaStream_t stream) {
+    if (data.empty()) return;
+    CUDA_CHECK(cudaMemcpyAsync(buf, data.data(), data.size(),
+                               cudaMemcpyDefault, stream));
+    CUDA_CHECK(cudaStreamSynchronize(stream));
+  }
+
+  template <typename T>
+  static void reduce_into(char* acc, const char* in, int count, op_t op) {
+    T* a = reinterpret_cast<T*>(acc);
+    const T* b = reinterpret_cast<const T*>(in);
+    for (int i = 0; i < count; i++) {
+      switch (op) {
+        case op_t::SUM:
+          a[i] = a[i] + b[i];
+          break;
+        case op_t::PROD:
+          a[i] = a[i] * b[i];
+          break;
+        case op_t::MIN:
+          a[i] = std::min(a[i], b[i]);
+          break;
+        case op_t::MAX:
+          a[i] = std::max(a[i], b[i]);
+          break;
+      }
+    }
+  }
+
+  static std::vector<char> reduce_all(
+    const std::vector<std::vector<char>>& all, int count, datatype_t datatype,
+    op_t op) {
+    std::vector<char> acc = all[0];
+    for (size_t r = 1; r < all.size(); r++) {
+      const char* in = all[r].data();
+      switch (datatype) {
+        case datatype_t::CHAR:
+          reduce_into<char>(acc.data(), in, count, op);
+          break;
+        case datatype_t::UINT8:
+          reduce_into<uint8_t>(acc.data(), in, count, op);
+          break;
+        case datatype_t::INT:
+          reduce_into<int>(acc.data(), in, count, op);
+          break;
+        case datatype_t::UINT:
+          reduce_into<unsigned int>(acc.data(), in, count, op);
+          break;
+        case datatype_t::INT64:
+          reduce_into<int64_t>(acc.data(), in, count, op);
+          break;
+        case datatype_t::UINT64:
+          reduce_into<uint64_t>(acc.data(), in, count, op);
+          break;
+        case datatype_t::FLOAT:
+          reduce_into<float>(acc.data(), in, count, op);
+          break;
+        case datatype_t::DOUBLE:
+          reduce_into<double>(acc.data(), in, count, op);
+          break;
+      }
+    }
+    return acc;
+  }
+
+  std::shared_ptr<ThreadCommsGroup> _group;
+  const int _rank;
+  mutable request_t _next_request = 0;
+  mutable std::map<request_t, pending_recv> _pending;
+};
+
+/**
+ * Run fn(rank, handle) for every rank of an n_ranks group on its own thread,
+ * with its own handle and stream, the handles being connected by
+ * ThreadComms. Rethrows the first failure of a rank.
+ */
+template <typename Fn>
+void run_ranks(int n_ranks, Fn fn) {
+  auto group = std::make_shared<ThreadCommsGroup>(n_ranks);
+  int device;
+  CUDA_CHECK(cudaGetDevice(&device));
+  std::vector<std::exception_ptr> errors(n_ranks);
+  std::vector<std::thread> threads;
+  for (int r = 0; r < n_ranks; r++) {
+    threads.emplace_back([&, r]() {
+      try {
+        CUDA_CHECK(cudaSetDevice(device));
+        cudaStream_t stream;
+        CUDA_CHECK(cudaStreamCreate(&stream));
+        {
+          cumlHandle handle;
+          handle.setStream(stream);
+          handle.getImpl().setCommunicator(
+            std::make_shared<MLCommon::cumlCommunicator>(
+              std::unique_ptr<MLCommon::cumlCommunicator_iface>(
+                new ThreadComms(group, r))));
+          fn(r, handle);
+          CUDA_CHECK(cudaStreamSynchronize(stream));
+        }
+        CUDA_CHECK(cudaStreamDestroy(stream));
+      } catch (...) {
+        errors[r] = std::current_exception();
+        group->abort();
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (auto& e : errors) {
+    if (e) std::rethrow_exception(e);
+  }
+}
+
+}  // namespace ML